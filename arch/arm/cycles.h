@@ -0,0 +1,117 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef ARM_CYCLES_H_
+#define ARM_CYCLES_H_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+#if defined(CONFIG_ARCH_ARMV7A) || defined(CONFIG_ARCH_ARMV7M)
+/** The core provides a free-running CPU cycle counter */
+#define ARCH_HAVE_CYCLE_COUNTER
+#endif
+
+#if defined(CONFIG_ARCH_ARMV7A)
+
+/* PMCR: E - enable all counters, C - reset cycle counter */
+#define CP15_PMCR_E (1u << 0)
+#define CP15_PMCR_C (1u << 2)
+
+/* PMCNTENSET: C - cycle counter enable */
+#define CP15_PMCNTENSET_C (1u << 31)
+
+#elif defined(CONFIG_ARCH_ARMV7M)
+
+#define ARMV7M_DEMCR        (*(volatile uint32_t*)0xE000EDFCu)
+#define ARMV7M_DEMCR_TRCENA (1u << 24)
+#define ARMV7M_DWT_CTRL     (*(volatile uint32_t*)0xE0001000u)
+#define ARMV7M_DWT_CTRL_CYCCNTENA (1u << 0)
+#define ARMV7M_DWT_CYCCNT   (*(volatile uint32_t*)0xE0001004u)
+
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Public functions
+ *----------------------------------------------------------------------------*/
+
+#if defined(CONFIG_ARCH_ARMV7A)
+
+/**
+ * \brief Reset and start the PMU cycle counter.
+ */
+static inline void arch_cycles_enable(void)
+{
+	uint32_t pmcr;
+	asm volatile("mrc p15, 0, %0, c9, c12, 0" : "=r"(pmcr));
+	pmcr |= CP15_PMCR_E | CP15_PMCR_C;
+	asm volatile("mcr p15, 0, %0, c9, c12, 0" :: "r"(pmcr));
+	asm volatile("mcr p15, 0, %0, c9, c12, 1" :: "r"(CP15_PMCNTENSET_C));
+}
+
+/**
+ * \brief Return the PMU cycle counter.
+ */
+static inline uint32_t arch_cycles_read(void)
+{
+	uint32_t cycles;
+	asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(cycles));
+	return cycles;
+}
+
+#elif defined(CONFIG_ARCH_ARMV7M)
+
+/**
+ * \brief Reset and start the DWT cycle counter.
+ */
+static inline void arch_cycles_enable(void)
+{
+	ARMV7M_DEMCR |= ARMV7M_DEMCR_TRCENA;
+	ARMV7M_DWT_CYCCNT = 0;
+	ARMV7M_DWT_CTRL |= ARMV7M_DWT_CTRL_CYCCNTENA;
+}
+
+/**
+ * \brief Return the DWT cycle counter.
+ */
+static inline uint32_t arch_cycles_read(void)
+{
+	return ARMV7M_DWT_CYCCNT;
+}
+
+#endif
+
+#endif /* ARM_CYCLES_H_ */
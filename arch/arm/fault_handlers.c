@@ -32,6 +32,7 @@
  *----------------------------------------------------------------------------*/
 
 #include "arm/fault_handlers.h"
+#include "serial/console.h"
 
 #include <stdio.h>
 #include <stdint.h>
@@ -101,6 +102,7 @@ static const char* _data_abort_status[32] = {
 void undefined_instruction_irq_handler(void)
 {
 #ifdef CONFIG_HAVE_FAULT_DEBUG
+	console_panic_flush();
 	printf("\r\n");
 	printf("#####################\r\n");
 	printf("Undefined Instruction\r\n");
@@ -120,6 +122,7 @@ void undefined_instruction_irq_handler(void)
 void software_interrupt_irq_handler(void)
 {
 #ifdef CONFIG_HAVE_FAULT_DEBUG
+	console_panic_flush();
 	printf("\r\n");
 	printf("##################\r\n");
 	printf("Software Interrupt\r\n");
@@ -143,6 +146,7 @@ void data_abort_irq_handler(void)
 	asm("mrc p15, 0, %0, c5, c0, 0" : "=r"(v1));
 	asm("mrc p15, 0, %0, c6, c0, 0" : "=r"(v2));
 
+	console_panic_flush();
 	printf("\r\n");
 	printf("####################\r\n");
 	dfsr = ((v1 >> 4) & 0x0F);
@@ -176,6 +180,7 @@ void prefetch_abort_irq_handler(void)
 	asm("mrc p15, 0, %0, c5, c0, 1" : "=r"(v1));
 	asm("mrc p15, 0, %0, c6, c0, 2" : "=r"(v2));
 
+	console_panic_flush();
 	printf("\r\n");
 	printf("####################\r\n");
 	ifsr = (((v1 & 0x400) >> 6) | (v1 & 0x0F));
@@ -39,6 +39,7 @@
 #include "callback.h"
 #include "chip.h"
 #include "dma/dma.h"
+#include "errno.h"
 #include "mm/cache.h"
 #include "trace.h"
 
@@ -487,6 +488,107 @@ bool audio_transfer_is_done(struct _audio_desc *desc)
 	}
 }
 
+int audio_start_stream(struct _audio_desc *desc, void *buffer, uint32_t size,
+		       uint32_t periods, struct _callback* cb)
+{
+	switch (desc->type) {
+#if defined(CONFIG_HAVE_CLASSD)
+	case AUDIO_DEVICE_CLASSD:
+		if (desc->direction == AUDIO_DEVICE_PLAY) {
+			struct _buffer tx = {
+				.data = (uint8_t*)buffer,
+				.size = size,
+				.attr = CLASSD_BUF_ATTR_WRITE,
+			};
+
+			return classd_start_stream(&desc->device.classd.desc, &tx, periods, cb);
+		}
+		break;
+#endif
+#if defined(CONFIG_HAVE_SSC)
+	case AUDIO_DEVICE_SSC:
+		{
+			struct _buffer buf = {
+				.data = (uint8_t*)buffer,
+				.size = size,
+				.attr = desc->direction == AUDIO_DEVICE_PLAY ? SSC_BUF_ATTR_WRITE : SSC_BUF_ATTR_READ,
+			};
+
+			return ssc_start_stream(&desc->device.ssc.desc, &buf, periods, cb);
+		}
+#endif
+#if defined(CONFIG_HAVE_PDMIC)
+	case AUDIO_DEVICE_PDMIC:
+		if (desc->direction == AUDIO_DEVICE_RECORD) {
+			struct _buffer rx = {
+				.data = (uint8_t*)buffer,
+				.size = size,
+				.attr = PDMIC_BUF_ATTR_READ,
+			};
+
+			return pdmic_start_stream(&desc->device.pdmic.desc, &rx, periods, cb);
+		}
+		break;
+#endif
+	default:
+		break;
+	}
+	return -ENOTSUP;
+}
+
+void audio_stop_stream(struct _audio_desc *desc, bool drain)
+{
+	switch (desc->type) {
+#if defined(CONFIG_HAVE_CLASSD)
+	case AUDIO_DEVICE_CLASSD:
+		classd_stop_stream(&desc->device.classd.desc, drain);
+		break;
+#endif
+#if defined(CONFIG_HAVE_SSC)
+	case AUDIO_DEVICE_SSC:
+		switch (desc->direction) {
+		case AUDIO_DEVICE_PLAY:
+			ssc_tx_stop_stream(&desc->device.ssc.desc, drain);
+			break;
+		case AUDIO_DEVICE_RECORD:
+			ssc_rx_stop_stream(&desc->device.ssc.desc);
+			break;
+		}
+		break;
+#endif
+#if defined(CONFIG_HAVE_PDMIC)
+	case AUDIO_DEVICE_PDMIC:
+		pdmic_stop_stream(&desc->device.pdmic.desc);
+		break;
+#endif
+	default:
+		return;
+	}
+}
+
+struct _dma_cyclic* audio_get_stream(struct _audio_desc *desc)
+{
+	switch (desc->type) {
+#if defined(CONFIG_HAVE_CLASSD)
+	case AUDIO_DEVICE_CLASSD:
+		return &desc->device.classd.desc.tx.stream;
+#endif
+#if defined(CONFIG_HAVE_SSC)
+	case AUDIO_DEVICE_SSC:
+		if (desc->direction == AUDIO_DEVICE_PLAY)
+			return &desc->device.ssc.desc.tx.stream;
+		else
+			return &desc->device.ssc.desc.rx.stream;
+#endif
+#if defined(CONFIG_HAVE_PDMIC)
+	case AUDIO_DEVICE_PDMIC:
+		return &desc->device.pdmic.desc.rx.stream;
+#endif
+	default:
+		return NULL;
+	}
+}
+
 void audio_sync_adjust(struct _audio_desc *desc, int32_t adjust)
 {
 #if defined(CONFIG_HAVE_SSC)
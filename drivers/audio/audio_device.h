@@ -52,6 +52,7 @@
 #endif /* CONFIG_HAVE_SSC */
 #include "callback.h"
 #include "dma/dma.h"
+#include "dma/dma_cyclic.h"
 #include "gpio/pio.h"
 
 #define AUDIO_PLAY_MAX_VOLUME    (100)
@@ -197,6 +198,32 @@ extern void audio_transfer(struct _audio_desc *desc, void *buffer, uint32_t size
  */
 extern bool audio_transfer_is_done(struct _audio_desc *desc);
 
+/**
+ * \brief Start a circular audio transfer that runs until stopped
+ * \param desc     Audio descriptor
+ * \param buffer   Data buffer, filled beforehand when playing
+ * \param size     Data buffer size
+ * \param periods  Number of periods the buffer is split into
+ * \param cb       Callback at end of each period, invoked with its index
+ * \return 0 on success, or an error code
+ */
+extern int audio_start_stream(struct _audio_desc *desc, void *buffer, uint32_t size,
+			      uint32_t periods, struct _callback* cb);
+
+/**
+ * \brief Stop a circular audio transfer
+ * \param desc     Audio descriptor
+ * \param drain    When playing, let the committed periods play out first
+ */
+extern void audio_stop_stream(struct _audio_desc *desc, bool drain);
+
+/**
+ * \brief Get the circular transfer of the device, to commit periods and
+ * read its position and statistics
+ * \param desc     Audio descriptor
+ */
+extern struct _dma_cyclic* audio_get_stream(struct _audio_desc *desc);
+
 /**
  * \brief Increase or decrease CODEC clock
  * \param desc     Audio descriptor
@@ -492,8 +492,46 @@ void classd_tx_stop(struct _classd_desc* desc)
 {
 	if (desc->transfer_mode == CLASSD_MODE_DMA) {
 		if (desc->tx.dma.channel){
+			dma_cyclic_stop(&desc->tx.stream, false);
 			dma_stop_transfer(desc->tx.dma.channel);
 			mutex_unlock(&desc->tx.mutex);
 		}
 	}
 }
+
+int classd_start_stream(struct _classd_desc* desc, struct _buffer* buf,
+			uint32_t periods, struct _callback* cb)
+{
+	struct _dma_cfg cfg_dma;
+	int err;
+
+	if ((buf == NULL) || (buf->size == 0) || (periods == 0))
+		return -EINVAL;
+
+	if (desc->transfer_mode != CLASSD_MODE_DMA)
+		return -ENOTSUP;
+
+	if (!mutex_try_lock(&desc->tx.mutex))
+		return -EBUSY;
+
+	cfg_dma = desc->tx.dma.cfg_dma;
+	if (desc->left_enable && desc->right_enable)
+		cfg_dma.data_width = DMA_DATA_WIDTH_WORD;
+	else
+		cfg_dma.data_width = DMA_DATA_WIDTH_HALF_WORD;
+	err = dma_cyclic_start(&desc->tx.stream, desc->tx.dma.channel,
+			       &cfg_dma, (void*)&desc->addr->CLASSD_THR,
+			       buf->data, buf->size / periods, periods, true, cb);
+	if (err < 0)
+		mutex_unlock(&desc->tx.mutex);
+
+	return err;
+}
+
+void classd_stop_stream(struct _classd_desc* desc, bool drain)
+{
+	if (dma_cyclic_is_running(&desc->tx.stream)) {
+		dma_cyclic_stop(&desc->tx.stream, drain);
+		mutex_unlock(&desc->tx.mutex);
+	}
+}
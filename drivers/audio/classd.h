@@ -42,6 +42,7 @@
 #include "callback.h"
 #include "chip.h"
 #include "dma/dma.h"
+#include "dma/dma_cyclic.h"
 #include "io.h"
 #include "mutex.h"
 
@@ -125,6 +126,7 @@ struct _classd_desc
 			struct _dma_cfg cfg_dma;
 			struct _dma_transfer_cfg cfg;
 		} dma;
+		struct _dma_cyclic stream;
 	} tx;
 };
 
@@ -158,6 +160,15 @@ extern bool classd_tx_transfer_is_done(struct _classd_desc* desc);
 
 extern void classd_tx_stop(struct _classd_desc* desc);
 
+/**
+ * \brief Start a circular DMA transfer that plays the buffer until
+ * stopped, see dma_cyclic.h. Requires CLASSD_MODE_DMA.
+ */
+extern int classd_start_stream(struct _classd_desc* desc, struct _buffer* buf,
+			       uint32_t periods, struct _callback* cb);
+
+extern void classd_stop_stream(struct _classd_desc* desc, bool drain);
+
 #endif /* CONFIG_HAVE_CLASSD */
 
 #endif /* _CLASSD_H */
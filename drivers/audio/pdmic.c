@@ -348,8 +348,46 @@ void pdmic_rx_stop(struct _pdmic_desc* desc)
 {
 	if (desc->transfer_mode == PDMIC_MODE_DMA) {
 		if (desc->rx.dma.channel){
+			dma_cyclic_stop(&desc->rx.stream, false);
 			dma_stop_transfer(desc->rx.dma.channel);
 			mutex_unlock(&desc->rx.mutex);
 		}
 	}
 }
+
+int pdmic_start_stream(struct _pdmic_desc* desc, struct _buffer* buf,
+		       uint32_t periods, struct _callback* cb)
+{
+	struct _dma_cfg cfg_dma;
+	int err;
+
+	if ((buf == NULL) || (buf->size == 0) || (periods == 0))
+		return -EINVAL;
+
+	if (desc->transfer_mode != PDMIC_MODE_DMA)
+		return -ENOTSUP;
+
+	if (!mutex_try_lock(&desc->rx.mutex))
+		return -EBUSY;
+
+	cfg_dma = desc->rx.dma.cfg_dma;
+	if (desc->dsp_size == PDMIC_CONVERTED_DATA_SIZE_32)
+		cfg_dma.data_width = DMA_DATA_WIDTH_WORD;
+	else
+		cfg_dma.data_width = DMA_DATA_WIDTH_HALF_WORD;
+	err = dma_cyclic_start(&desc->rx.stream, desc->rx.dma.channel,
+			       &cfg_dma, (void*)&desc->addr->PDMIC_CDR,
+			       buf->data, buf->size / periods, periods, false, cb);
+	if (err < 0)
+		mutex_unlock(&desc->rx.mutex);
+
+	return err;
+}
+
+void pdmic_stop_stream(struct _pdmic_desc* desc)
+{
+	if (dma_cyclic_is_running(&desc->rx.stream)) {
+		dma_cyclic_stop(&desc->rx.stream, false);
+		mutex_unlock(&desc->rx.mutex);
+	}
+}
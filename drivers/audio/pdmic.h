@@ -40,6 +40,7 @@
 #include "callback.h"
 #include "chip.h"
 #include "dma/dma.h"
+#include "dma/dma_cyclic.h"
 #include "io.h"
 #include "mutex.h"
 
@@ -107,6 +108,7 @@ struct _pdmic_desc {
 			struct _dma_cfg cfg_dma;
 			struct _dma_transfer_cfg cfg;
 		} dma;
+		struct _dma_cyclic stream;
 	} rx;
 };
 
@@ -134,4 +136,13 @@ extern void pdmic_rx_stop(struct _pdmic_desc* desc);
 
 extern bool pdmic_rx_transfer_is_done(struct _pdmic_desc* desc);
 
+/**
+ * \brief Start a circular DMA transfer that captures into the buffer until
+ * stopped, see dma_cyclic.h. Requires PDMIC_MODE_DMA.
+ */
+extern int pdmic_start_stream(struct _pdmic_desc* desc, struct _buffer* buf,
+			      uint32_t periods, struct _callback* cb);
+
+extern void pdmic_stop_stream(struct _pdmic_desc* desc);
+
 #endif /* _PDMIC_H */
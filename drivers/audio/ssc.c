@@ -81,6 +81,16 @@
  *       Local functions
  *----------------------------------------------------------------------------*/
 
+static uint8_t _ssc_get_data_width(struct _ssc_desc* desc)
+{
+	if (desc->slot_length == 8)
+		return DMA_DATA_WIDTH_BYTE;
+	else if (desc->slot_length == 16)
+		return DMA_DATA_WIDTH_HALF_WORD;
+	else
+		return DMA_DATA_WIDTH_WORD;
+}
+
 static int _ssc_dma_rx_callback(void* arg, void* arg2)
 {
 	struct _ssc_desc* desc = (struct _ssc_desc*)arg;
@@ -347,6 +357,7 @@ bool ssc_rx_transfer_is_done(struct _ssc_desc* desc)
 void ssc_tx_stop(struct _ssc_desc* desc)
 {
 	if (desc->tx.dma.channel) {
+		dma_cyclic_stop(&desc->tx.stream, false);
 		dma_stop_transfer(desc->tx.dma.channel);
 		mutex_unlock(&desc->tx.mutex);
 	}
@@ -355,7 +366,64 @@ void ssc_tx_stop(struct _ssc_desc* desc)
 void ssc_rx_stop(struct _ssc_desc* desc)
 {
 	if (desc->rx.dma.channel) {
+		dma_cyclic_stop(&desc->rx.stream, false);
 		dma_stop_transfer(desc->rx.dma.channel);
 		mutex_unlock(&desc->rx.mutex);
 	}
 }
+
+int ssc_start_stream(struct _ssc_desc* desc, struct _buffer* buf,
+		     uint32_t periods, struct _callback* cb)
+{
+	struct _dma_cfg cfg_dma;
+	int err;
+
+	if ((buf == NULL) || (buf->size == 0) || (periods == 0))
+		return -EINVAL;
+
+	if (buf->attr & SSC_BUF_ATTR_READ) {
+		if (!mutex_try_lock(&desc->rx.mutex))
+			return -EBUSY;
+
+		cfg_dma = desc->rx.dma.cfg_dma;
+		cfg_dma.data_width = _ssc_get_data_width(desc);
+		err = dma_cyclic_start(&desc->rx.stream, desc->rx.dma.channel,
+				       &cfg_dma, (void*)&desc->addr->SSC_RHR,
+				       buf->data, buf->size / periods, periods,
+				       false, cb);
+		if (err < 0)
+			mutex_unlock(&desc->rx.mutex);
+	} else if (buf->attr & SSC_BUF_ATTR_WRITE) {
+		if (!mutex_try_lock(&desc->tx.mutex))
+			return -EBUSY;
+
+		cfg_dma = desc->tx.dma.cfg_dma;
+		cfg_dma.data_width = _ssc_get_data_width(desc);
+		err = dma_cyclic_start(&desc->tx.stream, desc->tx.dma.channel,
+				       &cfg_dma, (void*)&desc->addr->SSC_THR,
+				       buf->data, buf->size / periods, periods,
+				       true, cb);
+		if (err < 0)
+			mutex_unlock(&desc->tx.mutex);
+	} else {
+		err = -EINVAL;
+	}
+
+	return err;
+}
+
+void ssc_tx_stop_stream(struct _ssc_desc* desc, bool drain)
+{
+	if (dma_cyclic_is_running(&desc->tx.stream)) {
+		dma_cyclic_stop(&desc->tx.stream, drain);
+		mutex_unlock(&desc->tx.mutex);
+	}
+}
+
+void ssc_rx_stop_stream(struct _ssc_desc* desc)
+{
+	if (dma_cyclic_is_running(&desc->rx.stream)) {
+		dma_cyclic_stop(&desc->rx.stream, false);
+		mutex_unlock(&desc->rx.mutex);
+	}
+}
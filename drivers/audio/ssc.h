@@ -46,6 +46,7 @@
 #include "callback.h"
 #include "chip.h"
 #include "dma/dma.h"
+#include "dma/dma_cyclic.h"
 #include "io.h"
 #include "mutex.h"
 
@@ -87,6 +88,7 @@ struct _ssc_desc {
 			struct _dma_cfg cfg_dma;
 			struct _dma_transfer_cfg cfg;
 		} dma;
+		struct _dma_cyclic stream;
 	} rx, tx;
 };
 
@@ -191,4 +193,19 @@ extern bool ssc_rx_transfer_is_done(struct _ssc_desc* desc);
 
 extern void ssc_rx_stop(struct _ssc_desc* desc);
 
+/**
+ * \brief Start a circular DMA transfer that runs until stopped, see
+ * dma_cyclic.h. The direction is given by the buffer attributes.
+ * \param desc  Pointer to an SSC instance.
+ * \param buf  Buffer split in periods, filled beforehand for playback.
+ * \param periods  Number of periods in the buffer.
+ * \param cb  Callback invoked with the index of each completed period.
+ */
+extern int ssc_start_stream(struct _ssc_desc* desc, struct _buffer* buf,
+			    uint32_t periods, struct _callback* cb);
+
+extern void ssc_tx_stop_stream(struct _ssc_desc* desc, bool drain);
+
+extern void ssc_rx_stop_stream(struct _ssc_desc* desc);
+
 #endif /* #ifndef _SSC_H */
@@ -0,0 +1,73 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2015, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _AES_SOFT_H_
+#define _AES_SOFT_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+/** Expanded key of the software AES block cipher */
+struct _aes_soft_ctx {
+	uint8_t round_key[240];  /*< up to 15 round keys of 16 bytes */
+	uint8_t rounds;          /*< 10, 12 or 14 */
+};
+
+/*------------------------------------------------------------------------------*/
+/*         Exported functions                                                   */
+/*------------------------------------------------------------------------------*/
+
+/**
+ * \brief Expands an AES key for use with aes_soft_encrypt().
+ * \param ctx  Context receiving the expanded key.
+ * \param key  Key bytes, in the same byte order as fed to the AES peripheral.
+ * \param len  Key length in bytes (16, 24 or 32).
+ * \return 0 on success, -EINVAL if the key length is not supported.
+ */
+extern int aes_soft_set_key(struct _aes_soft_ctx* ctx, const uint8_t* key, uint32_t len);
+
+/**
+ * \brief Encrypts one 16-byte block in software (FIPS-197 forward cipher).
+ * Only the forward cipher is provided: it is all CTR and GCM need, and
+ * it is meant for fragments too small to be worth a peripheral transfer.
+ * \param ctx  Context initialized by aes_soft_set_key().
+ * \param in   Plaintext block.
+ * \param out  Ciphertext block, may be the same as in.
+ */
+extern void aes_soft_encrypt(const struct _aes_soft_ctx* ctx,
+		const uint8_t* in, uint8_t* out);
+
+#endif /* _AES_SOFT_H_ */
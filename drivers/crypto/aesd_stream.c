@@ -0,0 +1,652 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2015, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * AES CTR streaming engine and GCM authenticated encryption.
+ *
+ * Whole blocks of large, aligned buffers are queued to the AES peripheral:
+ * buffers using consecutive counter values are chained in a single DMA
+ * run, and two runs are double buffered so that the next run is started
+ * from the completion interrupt of the previous one. Small buffers and
+ * partial blocks are processed with the software cipher, which avoids
+ * reprogramming the peripheral for a handful of bytes.
+ *
+ * GHASH is computed in software with 4-bit tables (Shoup's method), so
+ * GCM is also available on devices whose AES peripheral lacks it.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "callback.h"
+#include "chip.h"
+#include "crypto/aes.h"
+#include "crypto/aes_soft.h"
+#include "crypto/aesd.h"
+#include "crypto/aesd_stream.h"
+#include "dma/dma.h"
+#include "errno.h"
+#include "intmath.h"
+#include "irqflags.h"
+#include "mm/cache.h"
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/* Largest segment, in blocks, kept well within the DMA transfer length */
+#define AESD_STREAM_MAX_SEGMENT_BLOCKS 8192
+
+/* Blocks per cache line */
+#define AESD_STREAM_LINE_BLOCKS (L1_CACHE_BYTES / 16)
+
+/*----------------------------------------------------------------------------
+ *        Local constants
+ *----------------------------------------------------------------------------*/
+
+/* Reduction constants for the 4-bit GHASH multiplication */
+static const uint16_t _gcm_last4[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0,
+};
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static inline uint32_t _load_be32(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	       ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void _store_be32(uint8_t* p, uint32_t value)
+{
+	p[0] = (uint8_t)(value >> 24);
+	p[1] = (uint8_t)(value >> 16);
+	p[2] = (uint8_t)(value >> 8);
+	p[3] = (uint8_t)value;
+}
+
+static inline uint64_t _load_be64(const uint8_t* p)
+{
+	return ((uint64_t)_load_be32(p) << 32) | _load_be32(p + 4);
+}
+
+static inline void _store_be64(uint8_t* p, uint64_t value)
+{
+	_store_be32(p, (uint32_t)(value >> 32));
+	_store_be32(p + 4, (uint32_t)value);
+}
+
+static inline uint32_t _counter_low(const uint32_t* counter)
+{
+	return _load_be32((const uint8_t*)counter + 12);
+}
+
+static inline void _counter_add(uint32_t* counter, uint32_t blocks)
+{
+	_store_be32((uint8_t*)counter + 12, _counter_low(counter) + blocks);
+}
+
+static void _xor(uint8_t* out, const uint8_t* in, const uint8_t* ks, uint32_t len)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++)
+		out[i] = in[i] ^ ks[i];
+}
+
+static uint32_t _aesd_key_len(const struct _aesd_desc* desc)
+{
+	switch (desc->cfg.key_size) {
+	case AESD_AES128:
+		return 16;
+	case AESD_AES192:
+		return 24;
+	default:
+		return 32;
+	}
+}
+
+static void _stream_start_run(struct _aesd_stream* stream, uint8_t index);
+
+static int _stream_dma_callback(void* arg, void* arg2)
+{
+	struct _aesd_stream* stream = (struct _aesd_stream*)arg;
+	struct _aesd_stream_run* run = &stream->run[stream->active];
+	uint32_t i;
+
+	dma_reset_channel(stream->desc->xfer.dma.tx.channel);
+	dma_reset_channel(stream->desc->xfer.dma.rx.channel);
+
+	for (i = 0; i < run->segments; i++)
+		cache_invalidate_region(run->out[i].daddr, run->out[i].len * 4);
+
+	stream->stats.runs++;
+	stream->stats.hw_bytes += run->blocks * 16;
+
+	/* Keep the peripheral busy with the run built meanwhile. Starting it
+	 * from the interrupt is safe, the DMA item pool being IRQ-safe */
+	if (stream->ready >= 0) {
+		stream->active = stream->ready;
+		stream->ready = -1;
+		_stream_start_run(stream, stream->active);
+	} else {
+		stream->active = -1;
+	}
+
+	return 0;
+}
+
+static void _stream_start_run(struct _aesd_stream* stream, uint8_t index)
+{
+	struct _aesd_desc* desc = stream->desc;
+	struct _aesd_stream_run* run = &stream->run[index];
+	struct _dma_cfg cfg_dma;
+	struct _callback _cb;
+
+	aes_soft_reset();
+	aes_set_op_mode(AESD_MODE_CTR);
+	aes_set_key_size(desc->cfg.key_size);
+	aes_encrypt_enable(true);
+	aes_set_start_mode(AESD_TRANS_DMA);
+	aes_write_key(desc->cfg.key, _aesd_key_len(desc));
+	aes_set_vector(run->counter);
+
+	memset(&cfg_dma, 0, sizeof(cfg_dma));
+	cfg_dma.incr_saddr = true;
+	cfg_dma.incr_daddr = false;
+	cfg_dma.data_width = DMA_DATA_WIDTH_WORD;
+	cfg_dma.chunk_size = DMA_CHUNK_SIZE_4;
+	dma_configure_transfer(desc->xfer.dma.tx.channel, &cfg_dma,
+			run->in, run->segments);
+	dma_set_callback(desc->xfer.dma.tx.channel, NULL);
+
+	cfg_dma.incr_saddr = false;
+	cfg_dma.incr_daddr = true;
+	dma_configure_transfer(desc->xfer.dma.rx.channel, &cfg_dma,
+			run->out, run->segments);
+	callback_set(&_cb, _stream_dma_callback, (void*)stream);
+	dma_set_callback(desc->xfer.dma.rx.channel, &_cb);
+
+	dma_start_transfer(desc->xfer.dma.tx.channel);
+	dma_start_transfer(desc->xfer.dma.rx.channel);
+}
+
+/* Number of leading blocks worth handing to the peripheral, 0 if none */
+static uint32_t _stream_hw_blocks(struct _aesd_stream* stream,
+		const uint8_t* in, uint8_t* out, uint32_t blocks)
+{
+	/* Word accesses for the DMA, whole cache lines for the output so
+	 * that invalidating it cannot discard data written by the CPU */
+	if (((uint32_t)in & 3) || !IS_CACHE_ALIGNED(out))
+		return 0;
+
+	blocks -= blocks % AESD_STREAM_LINE_BLOCKS;
+	if (blocks * 16 < stream->sw_threshold)
+		return 0;
+
+	return blocks;
+}
+
+/* Queues blocks to the run being filled, returns the number queued */
+static uint32_t _stream_queue(struct _aesd_stream* stream,
+		const uint8_t* in, uint8_t* out, uint32_t blocks)
+{
+	struct _aesd_stream_run* run = &stream->run[stream->fill];
+	uint32_t room;
+
+	/* A run only covers consecutive counter values */
+	if (run->segments > 0 &&
+	    (run->segments == AESD_STREAM_MAX_SEGMENTS ||
+	     _counter_low(run->counter) + run->blocks != _counter_low(stream->counter))) {
+		aesd_stream_flush(stream);
+		run = &stream->run[stream->fill];
+	}
+
+	/* The peripheral only increments the low 16 bits of the counter */
+	room = 0x10000 - ((_counter_low(stream->counter) & 0xffff));
+	if (run->segments == 0)
+		memcpy(run->counter, stream->counter, sizeof(run->counter));
+	blocks = min_u32(blocks, min_u32(room, AESD_STREAM_MAX_SEGMENT_BLOCKS));
+
+	cache_clean_region(in, blocks * 16);
+	cache_clean_region(out, blocks * 16);
+
+	run->in[run->segments].saddr = (void*)in;
+	run->in[run->segments].daddr = (void*)AES->AES_IDATAR;
+	run->in[run->segments].len = blocks * 4;
+	run->out[run->segments].saddr = (void*)AES->AES_ODATAR;
+	run->out[run->segments].daddr = (void*)out;
+	run->out[run->segments].len = blocks * 4;
+	run->segments++;
+	run->blocks += blocks;
+	_counter_add(stream->counter, blocks);
+
+	/* Close the run where the peripheral counter wraps */
+	if (blocks == room)
+		aesd_stream_flush(stream);
+
+	return blocks;
+}
+
+static void _gcm_gen_table(struct _aesd_gcm* gcm, const uint8_t* h)
+{
+	uint64_t vh, vl;
+	uint32_t i, j, t;
+
+	vh = _load_be64(h);
+	vl = _load_be64(h + 8);
+
+	gcm->hl[0] = 0;
+	gcm->hh[0] = 0;
+	gcm->hl[8] = vl;
+	gcm->hh[8] = vh;
+
+	for (i = 4; i > 0; i >>= 1) {
+		t = (vl & 1) * 0xe1000000u;
+		vl = (vh << 63) | (vl >> 1);
+		vh = (vh >> 1) ^ ((uint64_t)t << 32);
+		gcm->hl[i] = vl;
+		gcm->hh[i] = vh;
+	}
+
+	for (i = 2; i <= 8; i *= 2) {
+		vh = gcm->hh[i];
+		vl = gcm->hl[i];
+		for (j = 1; j < i; j++) {
+			gcm->hh[i + j] = vh ^ gcm->hh[j];
+			gcm->hl[i + j] = vl ^ gcm->hl[j];
+		}
+	}
+}
+
+/* ghash = ghash * H */
+static void _gcm_mult(struct _aesd_gcm* gcm)
+{
+	uint64_t zh, zl;
+	uint8_t lo, hi, rem;
+	int i;
+
+	lo = gcm->ghash[15] & 0xf;
+	zh = gcm->hh[lo];
+	zl = gcm->hl[lo];
+
+	for (i = 15; i >= 0; i--) {
+		lo = gcm->ghash[i] & 0xf;
+		hi = (gcm->ghash[i] >> 4) & 0xf;
+
+		if (i != 15) {
+			rem = zl & 0xf;
+			zl = (zh << 60) | (zl >> 4);
+			zh = (zh >> 4) ^ ((uint64_t)_gcm_last4[rem] << 48);
+			zh ^= gcm->hh[lo];
+			zl ^= gcm->hl[lo];
+		}
+
+		rem = zl & 0xf;
+		zl = (zh << 60) | (zl >> 4);
+		zh = (zh >> 4) ^ ((uint64_t)_gcm_last4[rem] << 48);
+		zh ^= gcm->hh[hi];
+		zl ^= gcm->hl[hi];
+	}
+
+	_store_be64(gcm->ghash, zh);
+	_store_be64(gcm->ghash + 8, zl);
+}
+
+static void _gcm_hash(struct _aesd_gcm* gcm, const uint8_t* data, uint32_t len)
+{
+	uint32_t i;
+
+	while (len > 0) {
+		if (gcm->ghash_len == 0 && len >= 16) {
+			for (i = 0; i < 16; i++)
+				gcm->ghash[i] ^= data[i];
+			_gcm_mult(gcm);
+			data += 16;
+			len -= 16;
+			continue;
+		}
+
+		gcm->ghash[gcm->ghash_len++] ^= *data++;
+		len--;
+		if (gcm->ghash_len == 16) {
+			_gcm_mult(gcm);
+			gcm->ghash_len = 0;
+		}
+	}
+}
+
+/* Zero-pads the current GHASH block */
+static void _gcm_hash_pad(struct _aesd_gcm* gcm)
+{
+	if (gcm->ghash_len > 0) {
+		_gcm_mult(gcm);
+		gcm->ghash_len = 0;
+	}
+}
+
+/* Waits for the hardware and authenticates the produced ciphertext */
+static void _gcm_drain(struct _aesd_gcm* gcm)
+{
+	uint32_t i;
+
+	if (gcm->pending_count == 0)
+		return;
+
+	aesd_stream_wait(&gcm->stream);
+	for (i = 0; i < gcm->pending_count; i++)
+		_gcm_hash(gcm, gcm->pending[i].data, gcm->pending[i].len);
+	gcm->pending_count = 0;
+}
+
+static void _gcm_compute_tag(struct _aesd_gcm* gcm, uint8_t* tag)
+{
+	uint8_t len_block[16];
+
+	aesd_stream_wait(&gcm->stream);
+	_gcm_drain(gcm);
+	_gcm_hash_pad(gcm);
+
+	_store_be64(len_block, gcm->aad_len * 8);
+	_store_be64(len_block + 8, gcm->text_len * 8);
+	_gcm_hash(gcm, len_block, sizeof(len_block));
+
+	_xor(tag, gcm->ghash, gcm->ek_j0, 16);
+
+	aesd_stream_finish(&gcm->stream);
+	memset(gcm->hl, 0, sizeof(gcm->hl));
+	memset(gcm->hh, 0, sizeof(gcm->hh));
+	memset(gcm->ek_j0, 0, sizeof(gcm->ek_j0));
+}
+
+/*----------------------------------------------------------------------------
+ *        Public functions
+ *----------------------------------------------------------------------------*/
+
+int aesd_stream_init(struct _aesd_stream* stream, struct _aesd_desc* desc,
+		const uint8_t* counter)
+{
+	if (!mutex_try_lock(&desc->mutex))
+		return -EBUSY;
+
+	memset(stream, 0, sizeof(*stream));
+	if (aes_soft_set_key(&stream->soft, (const uint8_t*)desc->cfg.key,
+			_aesd_key_len(desc)) < 0) {
+		mutex_unlock(&desc->mutex);
+		return -EINVAL;
+	}
+
+	stream->desc = desc;
+	stream->sw_threshold = AESD_STREAM_SW_THRESHOLD;
+	memcpy(stream->counter, counter, sizeof(stream->counter));
+	stream->active = -1;
+	stream->ready = -1;
+	stream->open = true;
+
+	return 0;
+}
+
+void aesd_stream_set_threshold(struct _aesd_stream* stream, uint32_t size)
+{
+	stream->sw_threshold = size;
+}
+
+int aesd_stream_update(struct _aesd_stream* stream, const uint8_t* in,
+		uint8_t* out, uint32_t len)
+{
+	uint32_t n, blocks;
+
+	while (len > 0) {
+		if (stream->keystream_left > 0) {
+			/* Rest of the block started by the previous call */
+			n = min_u32(len, stream->keystream_left);
+			_xor(out, in, &stream->keystream[16 - stream->keystream_left], n);
+			stream->keystream_left -= n;
+			stream->stats.sw_bytes += n;
+		} else if (len < 16) {
+			/* Partial block, its keystream is kept for the next call */
+			aes_soft_encrypt(&stream->soft, (const uint8_t*)stream->counter,
+					stream->keystream);
+			_counter_add(stream->counter, 1);
+			stream->keystream_left = 16;
+			continue;
+		} else {
+			blocks = _stream_hw_blocks(stream, in, out, len / 16);
+			if (blocks > 0) {
+				n = 16 * _stream_queue(stream, in, out, blocks);
+			} else {
+				aes_soft_encrypt(&stream->soft,
+						(const uint8_t*)stream->counter,
+						stream->keystream);
+				_counter_add(stream->counter, 1);
+				_xor(out, in, stream->keystream, 16);
+				stream->stats.sw_bytes += 16;
+				n = 16;
+			}
+		}
+
+		in += n;
+		out += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+void aesd_stream_flush(struct _aesd_stream* stream)
+{
+	uint8_t index = stream->fill;
+	uint32_t flags;
+
+	if (stream->run[index].segments == 0)
+		return;
+
+	/* Only one run can wait for the peripheral */
+	while (stream->ready >= 0)
+		dma_poll();
+
+	flags = arch_irq_save();
+	if (stream->active < 0) {
+		stream->active = index;
+		arch_irq_restore(flags);
+		_stream_start_run(stream, index);
+	} else {
+		stream->ready = index;
+		arch_irq_restore(flags);
+	}
+
+	/* Build the next run in the other slot once it is released */
+	index ^= 1;
+	while (stream->active == index)
+		dma_poll();
+	stream->run[index].segments = 0;
+	stream->run[index].blocks = 0;
+	stream->fill = index;
+}
+
+void aesd_stream_wait(struct _aesd_stream* stream)
+{
+	aesd_stream_flush(stream);
+	while (stream->active >= 0 || stream->ready >= 0)
+		dma_poll();
+}
+
+void aesd_stream_finish(struct _aesd_stream* stream)
+{
+	if (!stream->open)
+		return;
+
+	aesd_stream_wait(stream);
+
+	memset(&stream->soft, 0, sizeof(stream->soft));
+	memset(stream->keystream, 0, sizeof(stream->keystream));
+	stream->keystream_left = 0;
+
+	stream->open = false;
+	mutex_unlock(&stream->desc->mutex);
+}
+
+int aesd_gcm_init(struct _aesd_gcm* gcm, struct _aesd_desc* desc,
+		const uint8_t* iv, uint32_t iv_len)
+{
+	uint8_t block[16];
+	int err;
+
+	if (iv_len == 0)
+		return -EINVAL;
+
+	memset(block, 0, sizeof(block));
+	err = aesd_stream_init(&gcm->stream, desc, block);
+	if (err < 0)
+		return err;
+
+	gcm->ghash_len = 0;
+	gcm->encrypt = desc->cfg.encrypt;
+	gcm->aad_done = false;
+	gcm->aad_len = 0;
+	gcm->text_len = 0;
+	gcm->pending_count = 0;
+	memset(gcm->ghash, 0, sizeof(gcm->ghash));
+
+	/* Hash subkey H = E(K, 0^128) */
+	aes_soft_encrypt(&gcm->stream.soft, block, block);
+	_gcm_gen_table(gcm, block);
+
+	/* Pre-counter block J0 */
+	if (iv_len == 12) {
+		memcpy(block, iv, 12);
+		_store_be32(block + 12, 1);
+	} else {
+		_gcm_hash(gcm, iv, iv_len);
+		_gcm_hash_pad(gcm);
+		memset(block, 0, 8);
+		_store_be64(block + 8, (uint64_t)iv_len * 8);
+		_gcm_hash(gcm, block, sizeof(block));
+		memcpy(block, gcm->ghash, sizeof(block));
+		memset(gcm->ghash, 0, sizeof(gcm->ghash));
+	}
+
+	aes_soft_encrypt(&gcm->stream.soft, block, gcm->ek_j0);
+
+	/* The message is encrypted from inc32(J0) on */
+	memcpy(gcm->stream.counter, block, sizeof(block));
+	_counter_add(gcm->stream.counter, 1);
+
+	return 0;
+}
+
+int aesd_gcm_update_aad(struct _aesd_gcm* gcm, const uint8_t* aad, uint32_t len)
+{
+	if (gcm->aad_done)
+		return -EINVAL;
+
+	_gcm_hash(gcm, aad, len);
+	gcm->aad_len += len;
+
+	return 0;
+}
+
+int aesd_gcm_update(struct _aesd_gcm* gcm, const uint8_t* in, uint8_t* out,
+		uint32_t len)
+{
+	uint32_t last;
+
+	if (!gcm->aad_done) {
+		_gcm_hash_pad(gcm);
+		gcm->aad_done = true;
+	}
+
+	if (len == 0)
+		return 0;
+
+	if (!gcm->encrypt)
+		_gcm_hash(gcm, in, len);
+
+	aesd_stream_update(&gcm->stream, in, out, len);
+	gcm->text_len += len;
+
+	if (gcm->encrypt) {
+		/* The ciphertext is hashed once the hardware produced it */
+		last = gcm->pending_count - 1;
+		if (gcm->pending_count > 0 &&
+		    gcm->pending[last].data + gcm->pending[last].len == out) {
+			gcm->pending[last].len += len;
+		} else {
+			if (gcm->pending_count == AESD_GCM_MAX_PENDING)
+				_gcm_drain(gcm);
+			gcm->pending[gcm->pending_count].data = out;
+			gcm->pending[gcm->pending_count].len = len;
+			gcm->pending_count++;
+		}
+	}
+
+	return 0;
+}
+
+int aesd_gcm_finish(struct _aesd_gcm* gcm, uint8_t* tag, uint32_t tag_len)
+{
+	uint8_t full_tag[16];
+
+	if (!gcm->stream.open || tag_len < 4 || tag_len > 16)
+		return -EINVAL;
+
+	_gcm_compute_tag(gcm, full_tag);
+	memcpy(tag, full_tag, tag_len);
+
+	return 0;
+}
+
+int aesd_gcm_verify(struct _aesd_gcm* gcm, const uint8_t* tag, uint32_t tag_len)
+{
+	uint8_t full_tag[16];
+	uint8_t diff = 0;
+	uint32_t i;
+
+	if (!gcm->stream.open || tag_len < 4 || tag_len > 16)
+		return -EINVAL;
+
+	_gcm_compute_tag(gcm, full_tag);
+
+	/* Constant time comparison */
+	for (i = 0; i < tag_len; i++)
+		diff |= full_tag[i] ^ tag[i];
+
+	return diff ? -EBADMSG : 0;
+}
@@ -0,0 +1,225 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2015, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef AESD_STREAM_HEADER__
+#define AESD_STREAM_HEADER__
+
+/*------------------------------------------------------------------------------
+ *        Header
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "crypto/aes_soft.h"
+#include "crypto/aesd.h"
+#include "dma/dma.h"
+
+/*------------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Number of buffers that can be chained in one hardware run */
+#ifndef AESD_STREAM_MAX_SEGMENTS
+#define AESD_STREAM_MAX_SEGMENTS 16
+#endif
+
+/** Default size (in bytes) under which data is processed in software */
+#ifndef AESD_STREAM_SW_THRESHOLD
+#define AESD_STREAM_SW_THRESHOLD 64
+#endif
+
+/** Number of ciphertext buffers awaiting authentication in GCM encryption */
+#ifndef AESD_GCM_MAX_PENDING
+#define AESD_GCM_MAX_PENDING 32
+#endif
+
+/*------------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+struct _aesd_stream_stats {
+	uint32_t hw_bytes;   /*< bytes processed by the AES peripheral */
+	uint32_t sw_bytes;   /*< bytes processed by the software cipher */
+	uint32_t runs;       /*< hardware runs completed */
+};
+
+/* Blocks with consecutive counter values, processed by a single DMA run */
+struct _aesd_stream_run {
+	struct _dma_transfer_cfg in[AESD_STREAM_MAX_SEGMENTS];
+	struct _dma_transfer_cfg out[AESD_STREAM_MAX_SEGMENTS];
+	uint32_t counter[4];   /*< counter block of the first block of the run */
+	uint32_t segments;
+	uint32_t blocks;
+};
+
+/* CTR keystream engine */
+struct _aesd_stream {
+	struct _aesd_desc* desc;
+	struct _aes_soft_ctx soft;
+	uint32_t sw_threshold;
+	bool open;                  /*< the driver is locked by this stream */
+
+	uint32_t counter[4];        /*< counter block of the next keystream block */
+	uint8_t keystream[16];      /*< last keystream block computed in software */
+	uint8_t keystream_left;     /*< unused bytes at the end of keystream[] */
+
+	struct _aesd_stream_run run[2];
+	uint8_t fill;               /*< index of the run being filled */
+	volatile int8_t active;     /*< run processed by the hardware, or -1 */
+	volatile int8_t ready;      /*< closed run waiting for the hardware, or -1 */
+
+	struct _aesd_stream_stats stats;
+};
+
+/* GCM authenticated encryption on top of the CTR engine */
+struct _aesd_gcm {
+	struct _aesd_stream stream;
+
+	uint64_t hl[16], hh[16];    /*< 4-bit multiplication table of the hash subkey */
+	uint8_t ek_j0[16];          /*< encrypted pre-counter block */
+	uint8_t ghash[16];
+	uint8_t ghash_len;          /*< bytes accumulated in the current GHASH block */
+	bool encrypt;
+	bool aad_done;
+	uint64_t aad_len;
+	uint64_t text_len;
+
+	/* ciphertext produced by the hardware, hashed once available */
+	struct {
+		const uint8_t* data;
+		uint32_t len;
+	} pending[AESD_GCM_MAX_PENDING];
+	uint32_t pending_count;
+};
+
+/*------------------------------------------------------------------------------
+ *        Functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Starts a CTR keystream on an initialized AES driver.
+ * The key and key size are taken from desc->cfg. The driver stays locked
+ * until aesd_stream_finish() is called.
+ * The rightmost 32 bits of the counter block are incremented (big-endian)
+ * for each block, as in GCM. The peripheral only has a 16-bit counter, so
+ * hardware runs are split where its low 16 bits wrap.
+ * \param stream  Stream to initialize.
+ * \param desc  AES driver descriptor.
+ * \param counter  Initial 16-byte counter block.
+ * \return 0 on success, -EBUSY if the driver is in use, -EINVAL if the key
+ * size is not supported.
+ */
+extern int aesd_stream_init(struct _aesd_stream* stream, struct _aesd_desc* desc,
+		const uint8_t* counter);
+
+/**
+ * \brief Sets the size under which contiguous blocks are processed in
+ * software instead of being queued to the peripheral.
+ */
+extern void aesd_stream_set_threshold(struct _aesd_stream* stream, uint32_t size);
+
+/**
+ * \brief Encrypts (or decrypts, CTR is symmetric) a buffer.
+ * Whole blocks of large enough, word-aligned buffers are queued to the
+ * peripheral and chained with the previously queued buffers; everything
+ * else is processed in software right away. The function returns without
+ * waiting for the hardware: the output must not be read (and neither
+ * buffer modified) until aesd_stream_wait() returns. Output buffers used
+ * by the hardware should be cache-line aligned.
+ * \return 0 on success.
+ */
+extern int aesd_stream_update(struct _aesd_stream* stream, const uint8_t* in,
+		uint8_t* out, uint32_t len);
+
+/**
+ * \brief Hands the buffers queued so far to the peripheral.
+ * Runs are double buffered: the next run can be built while the previous
+ * one is processed and is started from the completion interrupt.
+ */
+extern void aesd_stream_flush(struct _aesd_stream* stream);
+
+/**
+ * \brief Flushes the stream and waits for the peripheral to complete.
+ */
+extern void aesd_stream_wait(struct _aesd_stream* stream);
+
+/**
+ * \brief Waits for pending data, erases the key material and releases
+ * the AES driver. Does nothing if the stream is already finished.
+ */
+extern void aesd_stream_finish(struct _aesd_stream* stream);
+
+/**
+ * \brief Starts a GCM encryption or decryption (per desc->cfg.encrypt).
+ * \param gcm  GCM context to initialize.
+ * \param desc  AES driver descriptor, providing key and direction.
+ * \param iv  Initialization vector.
+ * \param iv_len  Length of the IV in bytes, 12 being the recommended size.
+ * \return 0 on success, or a negative error code of aesd_stream_init().
+ */
+extern int aesd_gcm_init(struct _aesd_gcm* gcm, struct _aesd_desc* desc,
+		const uint8_t* iv, uint32_t iv_len);
+
+/**
+ * \brief Authenticates additional data. All additional data must be given
+ * before the first call to aesd_gcm_update().
+ * \return 0 on success, -EINVAL if the message has already started.
+ */
+extern int aesd_gcm_update_aad(struct _aesd_gcm* gcm, const uint8_t* aad,
+		uint32_t len);
+
+/**
+ * \brief Encrypts or decrypts a part of the message, see
+ * aesd_stream_update() for the buffer requirements.
+ * \return 0 on success.
+ */
+extern int aesd_gcm_update(struct _aesd_gcm* gcm, const uint8_t* in,
+		uint8_t* out, uint32_t len);
+
+/**
+ * \brief Completes the message, computes the authentication tag and
+ * releases the AES driver.
+ * \param tag  Buffer receiving the tag.
+ * \param tag_len  Tag length in bytes (4 to 16).
+ * \return 0 on success, -EINVAL if the tag length is not supported or the
+ * message is already completed.
+ */
+extern int aesd_gcm_finish(struct _aesd_gcm* gcm, uint8_t* tag, uint32_t tag_len);
+
+/**
+ * \brief Completes a decryption and checks the received tag in constant
+ * time. On failure the decrypted data must be discarded.
+ * \return 0 if the tag matches, -EBADMSG if it does not, -EINVAL if the
+ * tag length is not supported or the message is already completed.
+ */
+extern int aesd_gcm_verify(struct _aesd_gcm* gcm, const uint8_t* tag,
+		uint32_t tag_len);
+
+#endif /* AESD_STREAM_HEADER__ */
@@ -0,0 +1,288 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2015, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * CTR_DRBG (NIST SP 800-90A, AES-256, no derivation function) seeded from
+ * an entropy pool that the TRNG interrupt keeps filled.
+ *
+ * The TRNG produces a word every 84 clock cycles, so its interrupt is only
+ * enabled while the pool has room: the handler disables it once the pool
+ * is full and the generator enables it again after consuming a seed.
+ * The DRBG owns the TRNG interrupt, other users of the raw TRNG values
+ * register with drbg_set_trng_callback() and keep it enabled.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chip.h"
+#include "crypto/aes_soft.h"
+#include "crypto/drbg.h"
+#include "crypto/trng.h"
+#include "intmath.h"
+#include "irqflags.h"
+#include "ring.h"
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+#define DRBG_KEY_LEN    32
+#define DRBG_BLOCK_LEN  16
+#define DRBG_SEED_LEN   (DRBG_KEY_LEN + DRBG_BLOCK_LEN)
+#define DRBG_SEED_WORDS (DRBG_SEED_LEN / 4)
+
+/* Largest generate request allowed by SP 800-90A (2^19 bits) */
+#define DRBG_MAX_REQUEST (64 * 1024)
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+static struct {
+	bool initialized;
+	struct _aes_soft_ctx aes;
+	uint8_t v[DRBG_BLOCK_LEN];
+	uint32_t reseed_counter;
+	struct _drbg_stats stats;
+} _drbg;
+
+static uint32_t _pool_buffer[DRBG_POOL_WORDS];
+static struct _ring _pool;
+static volatile bool _pool_filling;
+
+static trng_callback_t _client_callback;
+static void* _client_callback_arg;
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static void _trng_callback(uint32_t random_value, void* user_arg)
+{
+	if (!ring_is_full(&_pool))
+		ring_push(&_pool, &random_value);
+
+	if (_client_callback) {
+		_client_callback(random_value, _client_callback_arg);
+		return;
+	}
+
+	/* Stop the interrupt flow once the pool is full */
+	if (ring_is_full(&_pool)) {
+		trng_disable_it();
+		_pool_filling = false;
+	}
+}
+
+static void _pool_refill(void)
+{
+	if (!_pool_filling && (_client_callback || !ring_is_full(&_pool))) {
+		_pool_filling = true;
+		trng_enable_it(_trng_callback, NULL);
+	}
+}
+
+static void _pool_stop(void)
+{
+	trng_disable_it();
+	_pool_filling = false;
+}
+
+static void _increment_v(void)
+{
+	int i;
+
+	for (i = DRBG_BLOCK_LEN - 1; i >= 0; i--)
+		if (++_drbg.v[i] != 0)
+			break;
+}
+
+/* CTR_DRBG_Update: derive a new key and V, mixing in provided data */
+static void _drbg_update(const uint8_t* provided)
+{
+	uint8_t temp[DRBG_SEED_LEN];
+	uint32_t i;
+
+	for (i = 0; i < DRBG_SEED_LEN; i += DRBG_BLOCK_LEN) {
+		_increment_v();
+		aes_soft_encrypt(&_drbg.aes, _drbg.v, &temp[i]);
+	}
+
+	if (provided)
+		for (i = 0; i < DRBG_SEED_LEN; i++)
+			temp[i] ^= provided[i];
+
+	aes_soft_set_key(&_drbg.aes, temp, DRBG_KEY_LEN);
+	memcpy(_drbg.v, &temp[DRBG_KEY_LEN], DRBG_BLOCK_LEN);
+	memset(temp, 0, sizeof(temp));
+}
+
+static void _drbg_seed(const uint32_t* seed)
+{
+	_drbg_update((const uint8_t*)seed);
+	_drbg.reseed_counter = 1;
+}
+
+/* Reseeds from the pool when due, polling the TRNG for the missing words
+ * if the pool is too low */
+static void _drbg_reseed(void)
+{
+	uint32_t seed[DRBG_SEED_WORDS];
+	uint32_t count, flags;
+
+	if (_drbg.reseed_counter < DRBG_RESEED_INTERVAL)
+		return;
+
+	count = ring_count(&_pool);
+	if (count < DRBG_SEED_WORDS) {
+		/* The interrupt would race the polling for TRNG_ODATA */
+		flags = arch_irq_save();
+		_pool_stop();
+		arch_irq_restore(flags);
+
+		ring_pop_n(&_pool, seed, count);
+		for (; count < DRBG_SEED_WORDS; count++)
+			seed[count] = trng_get_random_data();
+		_drbg.stats.late_reseeds++;
+	} else {
+		ring_pop_n(&_pool, seed, DRBG_SEED_WORDS);
+	}
+
+	_drbg_seed(seed);
+	memset(seed, 0, sizeof(seed));
+	_drbg.stats.reseeds++;
+
+	_pool_refill();
+}
+
+/* CTR_DRBG_Generate for at most DRBG_MAX_REQUEST bytes */
+static void _drbg_generate(uint8_t* out, uint32_t len)
+{
+	uint8_t block[DRBG_BLOCK_LEN];
+	uint32_t n;
+
+	_drbg_reseed();
+
+	while (len > 0) {
+		_increment_v();
+		n = min_u32(len, DRBG_BLOCK_LEN);
+		if (n == DRBG_BLOCK_LEN) {
+			aes_soft_encrypt(&_drbg.aes, _drbg.v, out);
+		} else {
+			aes_soft_encrypt(&_drbg.aes, _drbg.v, block);
+			memcpy(out, block, n);
+		}
+		out += n;
+		len -= n;
+	}
+	memset(block, 0, sizeof(block));
+
+	/* Backtracking resistance */
+	_drbg_update(NULL);
+	_drbg.reseed_counter++;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+void drbg_init(void)
+{
+	uint8_t key[DRBG_KEY_LEN];
+	uint32_t seed[DRBG_SEED_WORDS];
+	uint32_t i;
+
+	trng_enable();
+	_pool_stop();
+	ring_init(&_pool, _pool_buffer, DRBG_POOL_WORDS, sizeof(uint32_t));
+
+	for (i = 0; i < DRBG_SEED_WORDS; i++)
+		seed[i] = trng_get_random_data();
+
+	/* Instantiate: Key = 0, V = 0, then update with the seed */
+	memset(&_drbg, 0, sizeof(_drbg));
+	memset(key, 0, sizeof(key));
+	aes_soft_set_key(&_drbg.aes, key, DRBG_KEY_LEN);
+	_drbg_seed(seed);
+	memset(seed, 0, sizeof(seed));
+	_drbg.initialized = true;
+
+	_pool_refill();
+}
+
+void random_bytes(void* buffer, uint32_t len)
+{
+	uint8_t* out = (uint8_t*)buffer;
+	uint32_t n;
+
+	if (!_drbg.initialized)
+		drbg_init();
+
+	while (len > 0) {
+		n = min_u32(len, DRBG_MAX_REQUEST);
+		_drbg_generate(out, n);
+		_drbg.stats.generated += n;
+		out += n;
+		len -= n;
+	}
+}
+
+uint32_t random_u32(void)
+{
+	uint32_t value;
+
+	random_bytes(&value, sizeof(value));
+	return value;
+}
+
+void drbg_set_trng_callback(trng_callback_t cb, void* user_arg)
+{
+	uint32_t flags;
+
+	flags = arch_irq_save();
+	_client_callback = cb;
+	_client_callback_arg = user_arg;
+	arch_irq_restore(flags);
+
+	if (cb)
+		_pool_refill();
+}
+
+void drbg_get_stats(struct _drbg_stats* stats)
+{
+	*stats = _drbg.stats;
+}
@@ -0,0 +1,113 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2015, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _DRBG_H_
+#define _DRBG_H_
+
+#ifdef CONFIG_HAVE_TRNG
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+#include "crypto/trng.h"
+
+/*------------------------------------------------------------------------------
+ *         Definitions
+ *------------------------------------------------------------------------------*/
+
+/** Size of the entropy pool filled by the TRNG interrupt, in 32-bit words */
+#ifndef DRBG_POOL_WORDS
+#define DRBG_POOL_WORDS 32
+#endif
+
+/** Number of generate requests between two reseeds */
+#ifndef DRBG_RESEED_INTERVAL
+#define DRBG_RESEED_INTERVAL 1024
+#endif
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+struct _drbg_stats {
+	uint32_t generated;     /*< bytes generated */
+	uint32_t reseeds;       /*< reseeds from the entropy pool */
+	uint32_t late_reseeds;  /*< reseeds that polled the TRNG, the pool being too low */
+};
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Instantiates the DRBG (CTR_DRBG, AES-256, NIST SP 800-90A without
+ * derivation function).
+ * The initial seed is read from the TRNG by polling, then the TRNG
+ * interrupt keeps the entropy pool filled for the next reseeds. Called
+ * implicitly by the first random_bytes() if needed.
+ */
+extern void drbg_init(void);
+
+/**
+ * \brief Fills a buffer with random bytes.
+ * When a reseed is due and the entropy pool is not full enough yet, the
+ * missing seed words are read from the TRNG by polling.
+ * \param buffer  Buffer to fill.
+ * \param len  Number of bytes.
+ * \note Not reentrant, calls from interrupt and thread context must be
+ * serialized by the caller.
+ */
+extern void random_bytes(void* buffer, uint32_t len);
+
+/**
+ * \brief Returns a random 32-bit value from the DRBG.
+ */
+extern uint32_t random_u32(void);
+
+/**
+ * \brief Registers a callback receiving every raw TRNG value.
+ * The DRBG owns the TRNG interrupt once initialized, trng_enable_it()
+ * must not be used then. While a callback is registered the interrupt
+ * stays enabled, the values also filling the entropy pool.
+ * \param cb  Callback, called from the TRNG interrupt, NULL to unregister.
+ * \param user_arg  Argument passed as-is to the callback.
+ */
+extern void drbg_set_trng_callback(trng_callback_t cb, void* user_arg);
+
+/**
+ * \brief Returns the DRBG statistics.
+ */
+extern void drbg_get_stats(struct _drbg_stats* stats);
+
+#endif /* CONFIG_HAVE_TRNG */
+
+#endif /* _DRBG_H_ */
@@ -0,0 +1,428 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2015, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Software implementation of SHA-1 and of the SHA-2 family, used for
+ * messages too small to be worth setting up the SHA peripheral, and for
+ * the short outer hash of HMAC.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "crypto/sha_soft.h"
+#include "crypto/shad.h"
+#include "errno.h"
+
+/*----------------------------------------------------------------------------
+ *        Local constants
+ *----------------------------------------------------------------------------*/
+
+static const uint32_t _sha1_init[5] = {
+	0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0,
+};
+
+static const uint32_t _sha224_init[8] = {
+	0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939,
+	0xffc00b31, 0x68581511, 0x64f98fa7, 0xbefa4fa4,
+};
+
+static const uint32_t _sha256_init[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static const uint64_t _sha384_init[8] = {
+	0xcbbb9d5dc1059ed8ull, 0x629a292a367cd507ull,
+	0x9159015a3070dd17ull, 0x152fecd8f70e5939ull,
+	0x67332667ffc00b31ull, 0x8eb44a8768581511ull,
+	0xdb0c2e0d64f98fa7ull, 0x47b5481dbefa4fa4ull,
+};
+
+static const uint64_t _sha512_init[8] = {
+	0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull,
+	0x3c6ef372fe94f82bull, 0xa54ff53a5f1d36f1ull,
+	0x510e527fade682d1ull, 0x9b05688c2b3e6c1full,
+	0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull,
+};
+
+static const uint32_t _sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint64_t _sha512_k[80] = {
+	0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full,
+	0xe9b5dba58189dbbcull, 0x3956c25bf348b538ull, 0x59f111f1b605d019ull,
+	0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull, 0xd807aa98a3030242ull,
+	0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+	0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull,
+	0xc19bf174cf692694ull, 0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull,
+	0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull, 0x2de92c6f592b0275ull,
+	0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+	0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full,
+	0xbf597fc7beef0ee4ull, 0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull,
+	0x06ca6351e003826full, 0x142929670a0e6e70ull, 0x27b70a8546d22ffcull,
+	0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+	0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull,
+	0x92722c851482353bull, 0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull,
+	0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull, 0xd192e819d6ef5218ull,
+	0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+	0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull,
+	0x34b0bcb5e19b48a8ull, 0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull,
+	0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull, 0x748f82ee5defb2fcull,
+	0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+	0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull,
+	0xc67178f2e372532bull, 0xca273eceea26619cull, 0xd186b8c721c0c207ull,
+	0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull, 0x06f067aa72176fbaull,
+	0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+	0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull,
+	0x431d67c49c100d4cull, 0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull,
+	0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull,
+};
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static inline uint32_t _rol32(uint32_t x, uint32_t n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t _ror32(uint32_t x, uint32_t n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+static inline uint64_t _ror64(uint64_t x, uint32_t n)
+{
+	return (x >> n) | (x << (64 - n));
+}
+
+static inline uint32_t _load_be32(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	       ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline uint64_t _load_be64(const uint8_t* p)
+{
+	return ((uint64_t)_load_be32(p) << 32) | _load_be32(p + 4);
+}
+
+static inline void _store_be32(uint8_t* p, uint32_t value)
+{
+	p[0] = (uint8_t)(value >> 24);
+	p[1] = (uint8_t)(value >> 16);
+	p[2] = (uint8_t)(value >> 8);
+	p[3] = (uint8_t)value;
+}
+
+static inline void _store_be64(uint8_t* p, uint64_t value)
+{
+	_store_be32(p, (uint32_t)(value >> 32));
+	_store_be32(p + 4, (uint32_t)value);
+}
+
+static uint32_t _sha_soft_block_size(enum _shad_algo algo)
+{
+	if (algo == ALGO_SHA_384 || algo == ALGO_SHA_512)
+		return 128;
+	else
+		return 64;
+}
+
+static void _sha1_block(uint32_t* state, const uint8_t* block)
+{
+	uint32_t w[16];
+	uint32_t a, b, c, d, e, f, k, t;
+	uint32_t i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = _load_be32(&block[4 * i]);
+
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+
+	for (i = 0; i < 80; i++) {
+		if (i >= 16) {
+			t = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15];
+			w[i & 15] = _rol32(t, 1);
+		}
+
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+
+		t = _rol32(a, 5) + f + e + k + w[i & 15];
+		e = d;
+		d = c;
+		c = _rol32(b, 30);
+		b = a;
+		a = t;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+
+static void _sha256_block(uint32_t* state, const uint8_t* block)
+{
+	uint32_t w[64];
+	uint32_t v[8];
+	uint32_t s0, s1, t1, t2;
+	uint32_t i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = _load_be32(&block[4 * i]);
+	for (i = 16; i < 64; i++) {
+		s0 = _ror32(w[i - 15], 7) ^ _ror32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		s1 = _ror32(w[i - 2], 17) ^ _ror32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	memcpy(v, state, sizeof(v));
+
+	for (i = 0; i < 64; i++) {
+		s1 = _ror32(v[4], 6) ^ _ror32(v[4], 11) ^ _ror32(v[4], 25);
+		t1 = v[7] + s1 + ((v[4] & v[5]) ^ (~v[4] & v[6])) + _sha256_k[i] + w[i];
+		s0 = _ror32(v[0], 2) ^ _ror32(v[0], 13) ^ _ror32(v[0], 22);
+		t2 = s0 + ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+		v[7] = v[6];
+		v[6] = v[5];
+		v[5] = v[4];
+		v[4] = v[3] + t1;
+		v[3] = v[2];
+		v[2] = v[1];
+		v[1] = v[0];
+		v[0] = t1 + t2;
+	}
+
+	for (i = 0; i < 8; i++)
+		state[i] += v[i];
+}
+
+static void _sha512_block(uint64_t* state, const uint8_t* block)
+{
+	uint64_t w[80];
+	uint64_t v[8];
+	uint64_t s0, s1, t1, t2;
+	uint32_t i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = _load_be64(&block[8 * i]);
+	for (i = 16; i < 80; i++) {
+		s0 = _ror64(w[i - 15], 1) ^ _ror64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+		s1 = _ror64(w[i - 2], 19) ^ _ror64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	memcpy(v, state, sizeof(v));
+
+	for (i = 0; i < 80; i++) {
+		s1 = _ror64(v[4], 14) ^ _ror64(v[4], 18) ^ _ror64(v[4], 41);
+		t1 = v[7] + s1 + ((v[4] & v[5]) ^ (~v[4] & v[6])) + _sha512_k[i] + w[i];
+		s0 = _ror64(v[0], 28) ^ _ror64(v[0], 34) ^ _ror64(v[0], 39);
+		t2 = s0 + ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+		v[7] = v[6];
+		v[6] = v[5];
+		v[5] = v[4];
+		v[4] = v[3] + t1;
+		v[3] = v[2];
+		v[2] = v[1];
+		v[1] = v[0];
+		v[0] = t1 + t2;
+	}
+
+	for (i = 0; i < 8; i++)
+		state[i] += v[i];
+}
+
+static void _sha_soft_block(struct _sha_soft_ctx* ctx, const uint8_t* block)
+{
+	switch (ctx->algo) {
+	case ALGO_SHA_1:
+		_sha1_block(ctx->state.w32, block);
+		break;
+	case ALGO_SHA_224:
+	case ALGO_SHA_256:
+		_sha256_block(ctx->state.w32, block);
+		break;
+	case ALGO_SHA_384:
+	case ALGO_SHA_512:
+		_sha512_block(ctx->state.w64, block);
+		break;
+	}
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+int sha_soft_start(struct _sha_soft_ctx* ctx, enum _shad_algo algo)
+{
+	switch (algo) {
+	case ALGO_SHA_1:
+		memcpy(ctx->state.w32, _sha1_init, sizeof(_sha1_init));
+		break;
+	case ALGO_SHA_224:
+		memcpy(ctx->state.w32, _sha224_init, sizeof(_sha224_init));
+		break;
+	case ALGO_SHA_256:
+		memcpy(ctx->state.w32, _sha256_init, sizeof(_sha256_init));
+		break;
+	case ALGO_SHA_384:
+		memcpy(ctx->state.w64, _sha384_init, sizeof(_sha384_init));
+		break;
+	case ALGO_SHA_512:
+		memcpy(ctx->state.w64, _sha512_init, sizeof(_sha512_init));
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	ctx->algo = algo;
+	ctx->buffered = 0;
+	ctx->length = 0;
+
+	return 0;
+}
+
+void sha_soft_update(struct _sha_soft_ctx* ctx, const uint8_t* data,
+		uint32_t len)
+{
+	const uint32_t block_size = _sha_soft_block_size(ctx->algo);
+	uint32_t n;
+
+	ctx->length += len;
+
+	if (ctx->buffered > 0) {
+		n = block_size - ctx->buffered;
+		if (n > len)
+			n = len;
+		memcpy(&ctx->buffer[ctx->buffered], data, n);
+		ctx->buffered += n;
+		data += n;
+		len -= n;
+		if (ctx->buffered < block_size)
+			return;
+		_sha_soft_block(ctx, ctx->buffer);
+		ctx->buffered = 0;
+	}
+
+	while (len >= block_size) {
+		_sha_soft_block(ctx, data);
+		data += block_size;
+		len -= block_size;
+	}
+
+	memcpy(ctx->buffer, data, len);
+	ctx->buffered = len;
+}
+
+void sha_soft_finish(struct _sha_soft_ctx* ctx, uint8_t* digest)
+{
+	const uint32_t block_size = _sha_soft_block_size(ctx->algo);
+	const uint32_t length_size = block_size / 8;
+	uint64_t bits = ctx->length * 8;
+	uint32_t i, size;
+
+	/* Append the "1" bit, zeros and the message length in bits */
+	ctx->buffer[ctx->buffered++] = 0x80;
+	if (ctx->buffered > block_size - length_size) {
+		memset(&ctx->buffer[ctx->buffered], 0, block_size - ctx->buffered);
+		_sha_soft_block(ctx, ctx->buffer);
+		ctx->buffered = 0;
+	}
+	memset(&ctx->buffer[ctx->buffered], 0, block_size - ctx->buffered);
+	_store_be64(&ctx->buffer[block_size - 8], bits);
+	_sha_soft_block(ctx, ctx->buffer);
+	ctx->buffered = 0;
+
+	size = (uint32_t)shad_get_output_size(ctx->algo);
+	if (block_size == 128) {
+		for (i = 0; i < size / 8; i++)
+			_store_be64(&digest[8 * i], ctx->state.w64[i]);
+	} else {
+		for (i = 0; i < size / 4; i++)
+			_store_be32(&digest[4 * i], ctx->state.w32[i]);
+	}
+}
+
+int sha_soft_digest(enum _shad_algo algo, const uint8_t* data, uint32_t len,
+		uint8_t* digest)
+{
+	struct _sha_soft_ctx ctx;
+	int err;
+
+	err = sha_soft_start(&ctx, algo);
+	if (err < 0)
+		return err;
+	sha_soft_update(&ctx, data, len);
+	sha_soft_finish(&ctx, digest);
+
+	return 0;
+}
@@ -0,0 +1,89 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2015, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _SHA_SOFT_H_
+#define _SHA_SOFT_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+#include "crypto/shad.h"
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+/** State of a software SHA computation */
+struct _sha_soft_ctx {
+	enum _shad_algo algo;
+	union {
+		uint32_t w32[8];
+		uint64_t w64[8];
+	} state;
+	uint8_t buffer[128];    /*< pending bytes of the current block */
+	uint32_t buffered;
+	uint64_t length;        /*< message length in bytes */
+};
+
+/*------------------------------------------------------------------------------*/
+/*         Exported functions                                                   */
+/*------------------------------------------------------------------------------*/
+
+/**
+ * \brief Starts a software SHA computation.
+ * \param ctx  Context to initialize.
+ * \param algo  SHA algorithm: ALGO_SHA_1..ALGO_SHA_512
+ * \return 0 on success, -EINVAL if the algorithm is not supported.
+ */
+extern int sha_soft_start(struct _sha_soft_ctx* ctx, enum _shad_algo algo);
+
+/**
+ * \brief Adds data to a software SHA computation.
+ */
+extern void sha_soft_update(struct _sha_soft_ctx* ctx, const uint8_t* data,
+		uint32_t len);
+
+/**
+ * \brief Completes a software SHA computation.
+ * \param digest  Buffer receiving shad_get_output_size(algo) bytes, in the
+ * same byte order as the output of the SHA peripheral.
+ */
+extern void sha_soft_finish(struct _sha_soft_ctx* ctx, uint8_t* digest);
+
+/**
+ * \brief Hashes a whole message in software.
+ * \return 0 on success, -EINVAL if the algorithm is not supported.
+ */
+extern int sha_soft_digest(enum _shad_algo algo, const uint8_t* data,
+		uint32_t len, uint8_t* digest);
+
+#endif /* _SHA_SOFT_H_ */
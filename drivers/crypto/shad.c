@@ -34,10 +34,12 @@
 
 #include "crypto/shad.h"
 #include "crypto/sha.h"
+#include "crypto/sha_soft.h"
 #include "dma/dma.h"
 #include "errno.h"
 #include "intmath.h"
 #include "irq/irq.h"
+#include "irqflags.h"
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
 #include "serial/console.h"
@@ -56,6 +58,10 @@
 CACHE_ALIGNED
 static uint8_t sha_buffer[SHA_MAX_PADDING_LEN];
 
+/* Message tails and padding of the two batch slots */
+CACHE_ALIGNED
+static uint8_t batch_buffer[2][SHA_MAX_PADDING_LEN];
+
 volatile static bool single_transfer_ready;
 
 /*----------------------------------------------------------------------------
@@ -327,6 +333,128 @@ static void _shad_update_polling(struct _shad_desc* desc, const uint8_t* data, u
 	callback_call(&desc->xfer.callback, NULL);
 }
 
+static void _shad_batch_start(struct _shad_desc* desc, uint8_t slot);
+
+static int _shad_batch_callback(void *arg, void* arg2)
+{
+	struct _shad_desc* desc = (struct _shad_desc*)arg;
+
+	dma_reset_channel(desc->dma_channel);
+
+	/* The digest is read once the DATRDY interrupt fires */
+	sha_enable_it(SHA_IER_DATRDY);
+
+	return 0;
+}
+
+static void _shad_handler(uint32_t source, void* user_arg)
+{
+	struct _shad_desc* desc = (struct _shad_desc*)user_arg;
+	struct _shad_msg* msg;
+
+	if (!(sha_get_status() & SHA_ISR_DATRDY))
+		return;
+	sha_disable_it(SHA_IDR_DATRDY);
+
+	if (desc->batch.active < 0)
+		return;
+	msg = desc->batch.msg[desc->batch.active];
+
+	sha_get_output(msg->digest, shad_get_output_size(desc->cfg.algo));
+
+	/* Start the message prepared meanwhile, if any */
+	if (desc->batch.ready >= 0) {
+		desc->batch.active = desc->batch.ready;
+		desc->batch.ready = -1;
+		_shad_batch_start(desc, desc->batch.active);
+	} else {
+		desc->batch.active = -1;
+	}
+}
+
+static void _shad_batch_start(struct _shad_desc* desc, uint8_t slot)
+{
+	struct _dma_cfg cfg_dma;
+	struct _callback _cb;
+
+	memset(&cfg_dma, 0, sizeof(cfg_dma));
+	cfg_dma.incr_saddr = true;
+	cfg_dma.incr_daddr = false;
+	cfg_dma.data_width = DMA_DATA_WIDTH_WORD;
+	cfg_dma.chunk_size = _shad_get_dma_chunk_size(desc->cfg.algo);
+
+	callback_set(&_cb, _shad_batch_callback, (void*)desc);
+	dma_set_callback(desc->dma_channel, &_cb);
+
+	/* Each message restarts from the initial hash values */
+	sha_first_block();
+
+	dma_configure_transfer(desc->dma_channel, &cfg_dma,
+			       desc->batch.sg[slot], desc->batch.sg_count[slot]);
+	dma_start_transfer(desc->dma_channel);
+}
+
+static void _shad_batch_queue_dma(struct _shad_desc* desc, struct _shad_msg* msg)
+{
+	const uint32_t block_size = _shad_get_block_size(desc->cfg.algo);
+	uint32_t body = msg->len & ~(block_size - 1);
+	uint32_t tail = msg->len - body;
+	uint32_t padding_len;
+	uint8_t slot;
+	uint8_t* buffer;
+	uint32_t flags;
+
+	/* Only one message can wait for the peripheral */
+	while (desc->batch.ready >= 0)
+		dma_poll();
+
+	/* Use the slot not being processed */
+	slot = desc->batch.active == 0 ? 1 : 0;
+	buffer = batch_buffer[slot];
+
+	/* Message tail and padding are sent from the slot buffer, the
+	 * complete blocks directly from the message */
+	memcpy(buffer, &msg->data[body], tail);
+	padding_len = _shad_fill_padding(desc->cfg.algo, msg->len, &buffer[tail],
+					 SHA_MAX_PADDING_LEN - tail);
+
+	desc->batch.sg_count[slot] = 0;
+	if (body > 0)
+		_shad_prepare_dma_sg(&desc->batch.sg[slot][desc->batch.sg_count[slot]++],
+				     msg->data, body);
+	_shad_prepare_dma_sg(&desc->batch.sg[slot][desc->batch.sg_count[slot]++],
+			     buffer, tail + padding_len);
+	desc->batch.msg[slot] = msg;
+
+	flags = arch_irq_save();
+	if (desc->batch.active < 0) {
+		desc->batch.active = slot;
+		arch_irq_restore(flags);
+		_shad_batch_start(desc, slot);
+	} else {
+		desc->batch.ready = slot;
+		arch_irq_restore(flags);
+	}
+}
+
+static void _shad_batch_polling(struct _shad_desc* desc, struct _shad_msg* msg)
+{
+	const uint32_t block_size = _shad_get_block_size(desc->cfg.algo);
+	uint32_t body = msg->len & ~(block_size - 1);
+	uint32_t tail = msg->len - body;
+	uint32_t padding_len;
+
+	sha_first_block();
+	_shad_process_blocks_polling(msg->data, body, block_size);
+
+	memcpy(sha_buffer, &msg->data[body], tail);
+	padding_len = _shad_fill_padding(desc->cfg.algo, msg->len, &sha_buffer[tail],
+					 ARRAY_SIZE(sha_buffer) - tail);
+	_shad_process_blocks_polling(sha_buffer, tail + padding_len, block_size);
+
+	sha_get_output(msg->digest, shad_get_output_size(desc->cfg.algo));
+}
+
 /*----------------------------------------------------------------------------
  *        Public functions
  *----------------------------------------------------------------------------*/
@@ -339,6 +467,11 @@ void shad_init(struct _shad_desc* desc)
 	/* Allocate one DMA channel for writing message blocks to SHA_IDATARx */
 	desc->dma_channel = dma_allocate_channel(DMA_PERIPH_MEMORY, ID_SHA);
 	assert(desc->dma_channel);
+
+	/* DATRDY completes the batch messages */
+	sha_disable_it(SHA_IDR_DATRDY);
+	irq_add_handler(ID_SHA, _shad_handler, desc);
+	irq_enable(ID_SHA);
 }
 
 int shad_get_output_size(enum _shad_algo algo)
@@ -491,3 +624,128 @@ void shad_wait_completion(struct _shad_desc* desc)
 			dma_poll();
 	}
 }
+
+int shad_batch(struct _shad_desc* desc, struct _shad_msg* msgs, uint32_t count)
+{
+	const bool dma = desc->cfg.transfer_mode == SHAD_TRANS_DMA;
+	struct _shad_msg* msg;
+	uint32_t i;
+	int err;
+
+	if (!mutex_try_lock(&desc->mutex)) {
+		trace_error("SHAD mutex already locked!\r\n");
+		return -EAGAIN;
+	}
+
+	err = shad_start(desc);
+	if (err < 0) {
+		mutex_unlock(&desc->mutex);
+		return err;
+	}
+
+	desc->batch.active = -1;
+	desc->batch.ready = -1;
+
+	for (i = 0; i < count; i++) {
+		msg = &msgs[i];
+
+		/* Small messages are hashed by the CPU while the peripheral
+		 * processes the previous ones */
+		if (msg->len < desc->cfg.sw_threshold ||
+		    (dma && (((uint32_t)msg->data) & 3)))
+			sha_soft_digest(desc->cfg.algo, msg->data, msg->len, msg->digest);
+		else if (dma)
+			_shad_batch_queue_dma(desc, msg);
+		else
+			_shad_batch_polling(desc, msg);
+	}
+
+	while (desc->batch.active >= 0 || desc->batch.ready >= 0)
+		dma_poll();
+
+	mutex_unlock(&desc->mutex);
+
+	return 0;
+}
+
+int shad_hmac_start(struct _shad_hmac* hmac, struct _shad_desc* desc,
+		    const uint8_t* key, uint32_t key_len)
+{
+	const uint32_t block_size = _shad_get_block_size(desc->cfg.algo);
+	struct _buffer buf = {
+		.data = hmac->ipad,
+		.size = block_size,
+	};
+	uint32_t i;
+	int err;
+
+	/* Keys longer than a block are replaced by their digest */
+	memset(hmac->key, 0, sizeof(hmac->key));
+	if (key_len > block_size) {
+		err = sha_soft_digest(desc->cfg.algo, key, key_len, hmac->key);
+		if (err < 0)
+			return err;
+	} else {
+		memcpy(hmac->key, key, key_len);
+	}
+	hmac->desc = desc;
+
+	err = shad_start(desc);
+	if (err < 0)
+		return err;
+
+	/* Inner hash starts with the key XORed with ipad */
+	for (i = 0; i < block_size; i++)
+		hmac->ipad[i] = hmac->key[i] ^ 0x36;
+	err = shad_update(desc, &buf, NULL);
+	if (err < 0)
+		return err;
+	shad_wait_completion(desc);
+	memset(hmac->ipad, 0, block_size);
+
+	return 0;
+}
+
+int shad_hmac_update(struct _shad_hmac* hmac, struct _buffer* buffer,
+		     struct _callback* cb)
+{
+	return shad_update(hmac->desc, buffer, cb);
+}
+
+int shad_hmac_finish(struct _shad_hmac* hmac, struct _buffer* buffer)
+{
+	const enum _shad_algo algo = hmac->desc->cfg.algo;
+	const uint32_t block_size = _shad_get_block_size(algo);
+	const int size = shad_get_output_size(algo);
+	struct _sha_soft_ctx ctx;
+	uint8_t inner[64];
+	uint8_t opad[128];
+	struct _buffer buf = {
+		.data = inner,
+		.size = size,
+	};
+	uint32_t i;
+	int err;
+
+	if (buffer->size != size)
+		return -EINVAL;
+
+	err = shad_finish(hmac->desc, &buf, NULL);
+	if (err < 0)
+		return err;
+	shad_wait_completion(hmac->desc);
+
+	/* Outer hash of two or three blocks, not worth the peripheral */
+	for (i = 0; i < block_size; i++)
+		opad[i] = hmac->key[i] ^ 0x5c;
+	sha_soft_start(&ctx, algo);
+	sha_soft_update(&ctx, opad, block_size);
+	sha_soft_update(&ctx, inner, size);
+	sha_soft_finish(&ctx, buffer->data);
+
+	memset(hmac->key, 0, sizeof(hmac->key));
+	memset(opad, 0, sizeof(opad));
+	memset(&ctx, 0, sizeof(ctx));
+
+	return 0;
+}
@@ -61,11 +61,19 @@ enum _shad_transfer_mode
 	SHAD_TRANS_DMA
 };
 
+/* One message of a batch, see shad_batch() */
+struct _shad_msg {
+	const uint8_t* data;
+	uint32_t len;
+	uint8_t* digest;    /* receives shad_get_output_size(algo) bytes */
+};
+
 struct _shad_desc {
 	/* structure to define SHA configuration */
 	struct {
 		enum _shad_transfer_mode transfer_mode;
 		enum _shad_algo algo;
+		uint32_t sw_threshold; /* batch messages shorter than this are hashed in software */
 	} cfg;
 
 	/* --- following fields are used internally --- */
@@ -80,6 +88,22 @@ struct _shad_desc {
 		uint32_t processed; /* cumulated data processed, value is included in padding data */
 		struct _buffer* buffer;
 	} xfer;
+
+	/* batch of independent messages, two slots being processed in turn */
+	struct {
+		struct _dma_transfer_cfg sg[2][2];
+		uint8_t sg_count[2];
+		struct _shad_msg* msg[2];
+		volatile int8_t active;  /* slot processed by the hardware, or -1 */
+		volatile int8_t ready;   /* slot waiting for the hardware, or -1 */
+	} batch;
+};
+
+/* HMAC computation over a SHA driver */
+struct _shad_hmac {
+	struct _shad_desc* desc;
+	uint8_t key[128];   /* key padded to the block size */
+	uint8_t ipad[128];  /* inner padded key, hashed first */
 };
 
 /*------------------------------------------------------------------------------
@@ -140,4 +164,49 @@ extern bool shad_is_busy(struct _shad_desc* desc);
  */
 extern void shad_wait_completion(struct _shad_desc* desc);
 
+/**
+ * \brief Hash a vector of independent messages with the configured algorithm.
+ * Messages are processed back to back: while the peripheral hashes one
+ * message, the padding and DMA descriptors of the next one are prepared and
+ * messages shorter than cfg.sw_threshold are hashed in software. The next
+ * message is started from the DMA completion interrupt of the previous one.
+ * Word-aligned message data is required for the DMA, other messages are
+ * hashed in software.
+ * \param desc a SHA driver descriptor
+ * \param msgs messages to hash
+ * \param count number of messages
+ * \return 0 on success, <0 on error
+ * \note This function blocks until all digests are available.
+ */
+extern int shad_batch(struct _shad_desc* desc, struct _shad_msg* msgs, uint32_t count);
+
+/**
+ * \brief Start a new HMAC computation (FIPS 198-1).
+ * The inner hash is computed by the peripheral, the short outer hash
+ * in software.
+ * \param hmac HMAC context
+ * \param desc a SHA driver descriptor, configured with the algorithm
+ * \param key HMAC key
+ * \param key_len key length in bytes
+ * \return 0 on success, <0 on error
+ */
+extern int shad_hmac_start(struct _shad_hmac* hmac, struct _shad_desc* desc,
+			   const uint8_t* key, uint32_t key_len);
+
+/**
+ * \brief Update the HMAC computation with some data, see shad_update().
+ * \return 0 on success, <0 on error
+ */
+extern int shad_hmac_update(struct _shad_hmac* hmac, struct _buffer* buffer,
+			    struct _callback* cb);
+
+/**
+ * \brief Finish the HMAC computation and get the resulting MAC.
+ * \param hmac HMAC context
+ * \param buffer data buffer to store the MAC, of the digest size
+ * \return 0 on success, <0 on error
+ * \note This function blocks until the MAC is available.
+ */
+extern int shad_hmac_finish(struct _shad_hmac* hmac, struct _buffer* buffer);
+
 #endif /* SHAD_H */
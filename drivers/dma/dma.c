@@ -47,8 +47,8 @@
 #include "dma/dma.h"
 #include "irq/irq.h"
 #include "errno.h"
+#include "irqflags.h"
 #include "mm/cache.h"
-#include "mutex.h"
 #include "peripherals/pmc.h"
 
 /*----------------------------------------------------------------------------
@@ -117,13 +117,12 @@ struct _dma_sg_desc {
 #endif
 };
 
+/** Pool of free linked list items, as a stack linked through the items.
+ * Transfers are configured from interrupt handlers too, so the pool is
+ * protected by masking interrupts. */
 struct _dma_sg_pool {
-	struct _dma_sg_desc desc[DMA_SG_ITEM_POOL_SIZE];
 	struct _dma_sg_desc* head;
-	struct _dma_sg_desc* tail;
-
-	uint16_t count; /* Count elements in list  */
-	mutex_t mutex;
+	uint32_t count; /* Count elements in list  */
 };
 
 
@@ -138,7 +137,13 @@ struct _dma_ctrl {
  *        Local variables
  *----------------------------------------------------------------------------*/
 
-CACHE_ALIGNED static struct _dma_sg_pool _dma_sg_pool;
+#ifdef DMA_SG_POOL_NOT_CACHED
+NOT_CACHED static struct _dma_sg_desc _dma_sg_items[DMA_SG_ITEM_POOL_SIZE];
+#else
+CACHE_ALIGNED static struct _dma_sg_desc _dma_sg_items[DMA_SG_ITEM_POOL_SIZE];
+#endif
+
+static struct _dma_sg_pool _dma_sg_pool;
 
 static struct _dma_ctrl _dma_ctrl;
 
@@ -157,88 +162,163 @@ static inline bool is_dest_periph(struct _dma_channel* channel)
 }
 
 /**
- * \brief Preinitialize all descriptors and pool and link them together
+ * \brief Push a chain of items on a stack.
  */
-static void _dma_sg_init(void)
+static inline void _dma_sg_push(struct _dma_sg_desc** head, uint32_t* count,
+				struct _dma_sg_desc* first,
+				struct _dma_sg_desc* last, uint32_t n)
 {
-	uint32_t i;
+	DMA_SG_DESC_SET_NEXT(last, *head);
+	*head = first;
+	*count += n;
+}
 
-	memset(&_dma_sg_pool, 0, sizeof(_dma_sg_pool));
+/**
+ * \brief Pop an item from a stack.
+ */
+static inline struct _dma_sg_desc* _dma_sg_pop(struct _dma_sg_desc** head,
+					       uint32_t* count)
+{
+	struct _dma_sg_desc* desc = *head;
 
-	mutex_lock(&_dma_sg_pool.mutex);
+	if (desc) {
+		*head = DMA_SG_DESC_GET_NEXT(desc);
+		(*count)--;
+	}
+	return desc;
+}
 
-	for (i = 0; i < ARRAY_SIZE(_dma_sg_pool.desc); i++)
-		DMA_SG_DESC_SET_NEXT(&_dma_sg_pool.desc[i], &_dma_sg_pool.desc[i + 1]);
-	DMA_SG_DESC_SET_NEXT(&_dma_sg_pool.desc[i - 1], 0);
+/**
+ * \brief Give a set of items to the pool
+ */
+static uint32_t _dma_sg_add_items(struct _dma_sg_desc* items, uint32_t count)
+{
+	uint32_t i, flags;
+
+	if (count == 0)
+		return 0;
+
+	for (i = 0; i < count - 1; i++)
+		DMA_SG_DESC_SET_NEXT(&items[i], &items[i + 1]);
 
-	_dma_sg_pool.head = _dma_sg_pool.desc;
-	_dma_sg_pool.tail = &_dma_sg_pool.desc[i - 1];
-	_dma_sg_pool.count = ARRAY_SIZE(_dma_sg_pool.desc);
+	flags = arch_irq_save();
+	_dma_sg_push(&_dma_sg_pool.head, &_dma_sg_pool.count,
+		     &items[0], &items[count - 1], count);
+	arch_irq_restore(flags);
 
-	mutex_unlock(&_dma_sg_pool.mutex);
+	return count;
 }
 
-static struct _dma_sg_desc* _dma_sg_desc_alloc(uint8_t count)
+/**
+ * \brief Preinitialize all descriptors and pool and link them together
+ */
+static void _dma_sg_init(void)
 {
-	struct _dma_sg_desc* list_head;
-	struct _dma_sg_desc* curr;
-	struct _dma_sg_desc* next;
-	uint8_t i;
+	memset(&_dma_sg_pool, 0, sizeof(_dma_sg_pool));
+	_dma_sg_add_items(_dma_sg_items, ARRAY_SIZE(_dma_sg_items));
+}
 
-	if (count == 0)
-		return NULL;
-	if (count > _dma_sg_pool.count)
-		return NULL;
+/**
+ * \brief Allocate an item for a channel, from its cache first, then from
+ * the shared pool.
+ */
+static struct _dma_sg_desc* _dma_sg_desc_alloc(struct _dma_channel* channel)
+{
+	struct _dma_sg_desc* desc;
+	uint32_t flags;
 
-	mutex_lock(&_dma_sg_pool.mutex);
+	desc = _dma_sg_pop(&channel->sg_cache, &channel->sg_cache_count);
+	if (desc)
+		return desc;
 
-	list_head = _dma_sg_pool.head;
-	curr = list_head;
-	for (i = 0; i < (count - 1); i++) {
-		curr = DMA_SG_DESC_GET_NEXT(curr);
-	}
-		next = DMA_SG_DESC_GET_NEXT(curr);
-	DMA_SG_DESC_SET_NEXT(curr, 0);
+	flags = arch_irq_save();
+	desc = _dma_sg_pop(&_dma_sg_pool.head, &_dma_sg_pool.count);
+	arch_irq_restore(flags);
 
-	_dma_sg_pool.count -= count;
-	_dma_sg_pool.head = next;
+	return desc;
+}
 
-	if (_dma_sg_pool.count == 0) {
-		_dma_sg_pool.head = NULL;
-		_dma_sg_pool.tail = NULL;
-	}
+/**
+ * \brief Release the linked list of a channel. Short lists are kept in the
+ * channel cache, longer ones return to the shared pool.
+ */
+static void _dma_sg_desc_free(struct _dma_channel* channel)
+{
+	uint32_t flags;
 
-	mutex_unlock(&_dma_sg_pool.mutex);
+	if (channel->sg_list == NULL)
+		return;
+
+	if (channel->sg_cache_count + channel->sg_count <= DMA_SG_CHANNEL_CACHE_SIZE) {
+		_dma_sg_push(&channel->sg_cache, &channel->sg_cache_count,
+			     channel->sg_list, channel->sg_tail, channel->sg_count);
+	} else {
+		flags = arch_irq_save();
+		_dma_sg_push(&_dma_sg_pool.head, &_dma_sg_pool.count,
+			     channel->sg_list, channel->sg_tail, channel->sg_count);
+		arch_irq_restore(flags);
+	}
 
-	return list_head;
+	channel->sg_list = NULL;
+	channel->sg_tail = NULL;
+	channel->sg_count = 0;
 }
 
-static void _dma_sg_desc_free(struct _dma_sg_desc* list_head)
+/**
+ * \brief Return the items cached by a channel to the shared pool.
+ */
+static void _dma_sg_flush_cache(struct _dma_channel* channel)
 {
-	struct _dma_sg_desc* curr = list_head;
-	struct _dma_sg_desc* tail;
+	struct _dma_sg_desc* tail = channel->sg_cache;
+	uint32_t i, flags;
 
-	if (list_head == NULL)
+	if (channel->sg_cache == NULL)
 		return;
 
-	do {
-		tail = curr;
-		curr = DMA_SG_DESC_GET_NEXT(curr);
-	} while ((curr != NULL) && (curr != list_head));
-	curr = list_head;
+	/* The cache is short, DMA_SG_CHANNEL_CACHE_SIZE items at most */
+	for (i = 1; i < channel->sg_cache_count; i++)
+		tail = DMA_SG_DESC_GET_NEXT(tail);
 
-	mutex_lock(&_dma_sg_pool.mutex);
+	flags = arch_irq_save();
+	_dma_sg_push(&_dma_sg_pool.head, &_dma_sg_pool.count,
+		     channel->sg_cache, tail, channel->sg_cache_count);
+	arch_irq_restore(flags);
 
-	if (_dma_sg_pool.head == NULL)
-		_dma_sg_pool.head = list_head;
+	channel->sg_cache = NULL;
+	channel->sg_cache_count = 0;
+}
 
-	if (_dma_sg_pool.tail != NULL)
-		DMA_SG_DESC_SET_NEXT(_dma_sg_pool.tail, list_head);
-	_dma_sg_pool.tail = tail;
-	DMA_SG_DESC_SET_NEXT(_dma_sg_pool.tail, 0);
+/**
+ * \brief Make an item visible to the DMA controller
+ */
+static inline void _dma_sg_desc_sync(struct _dma_sg_desc* desc)
+{
+#ifndef DMA_SG_POOL_NOT_CACHED
+	cache_clean_region(desc, sizeof(*desc));
+#endif
+}
 
-	mutex_unlock(&_dma_sg_pool.mutex);
+#if defined(CONFIG_HAVE_XDMAC)
+/**
+ * \brief Memory burst size matching a chunk size
+ *
+ * Memory-to-memory transfers are not synchronized on a peripheral, so the
+ * chunk size is only relevant as a hint for the AHB burst length.
+ */
+static uint32_t _dma_get_mbsize(struct _dma_cfg* cfg_dma)
+{
+	switch (cfg_dma->chunk_size) {
+	case DMA_CHUNK_SIZE_16:
+		return XDMAC_CC_MBSIZE_SIXTEEN;
+	case DMA_CHUNK_SIZE_8:
+		return XDMAC_CC_MBSIZE_EIGHT;
+	case DMA_CHUNK_SIZE_4:
+		return XDMAC_CC_MBSIZE_FOUR;
+	default:
+		return XDMAC_CC_MBSIZE_SINGLE;
+	}
 }
+#endif
 
 static int _dma_configure_transfer(struct _dma_channel* channel,
 				   struct _dma_cfg* cfg_dma,
@@ -254,8 +334,16 @@ static int _dma_configure_transfer(struct _dma_channel* channel,
 	struct _dmacd_cfg dma_cfg;
 #endif
 
+	if (channel->state == DMA_STATE_STARTED)
+		return -EBUSY;
+
+	/* Release the list of a previous scatter-gather transfer */
+	_dma_sg_desc_free(channel);
+
 	memset(&desc, 0, sizeof(desc));
 
+	channel->loop = false;
+
 	src_is_periph = is_source_periph(channel);
 	dst_is_periph = is_dest_periph(channel);
 
@@ -309,6 +397,7 @@ static int _dma_configure_transfer(struct _dma_channel* channel,
 	desc.cfg |= cfg_dma->incr_saddr ? XDMAC_CC_SAM_INCREMENTED_AM : XDMAC_CC_SAM_FIXED_AM;
 	desc.cfg |= cfg_dma->incr_daddr ? XDMAC_CC_DAM_INCREMENTED_AM : XDMAC_CC_DAM_FIXED_AM;
 	desc.cfg |= (src_is_periph || dst_is_periph) ? 0 : XDMAC_CC_SWREQ_SWR_CONNECTED;
+	desc.cfg |= (src_is_periph || dst_is_periph) ? 0 : _dma_get_mbsize(cfg_dma);
 	desc.ds = 0;
 	desc.sus = 0;
 	desc.dus = 0;
@@ -353,32 +442,46 @@ static int _dma_configure_transfer(struct _dma_channel* channel,
 
 static int _dma_sg_configure_transfer(struct _dma_channel* channel,
 				      struct _dma_cfg* cfg_dma,
-				      struct _dma_transfer_cfg* sg_list, uint8_t sg_list_size)
+				      struct _dma_transfer_cfg* sg_list, uint32_t sg_list_size)
 {
-	struct _dma_sg_desc* _sg_head;
+	struct _dma_sg_desc* _sg_head = NULL;
+	struct _dma_sg_desc* prev = NULL;
 	struct _dma_sg_desc* curr;
 	struct _dma_transfer_cfg* cfg;
 	bool src_is_periph, dst_is_periph;
-	uint8_t idx;
+	uint32_t idx;
 
 	if ((sg_list == NULL) || (sg_list_size == 0))
 		return -EINVAL;
 
-	src_is_periph = is_source_periph(channel);
-	dst_is_periph = is_dest_periph(channel);
+	if (channel->state == DMA_STATE_STARTED)
+		return -EBUSY;
 
-	_sg_head = _dma_sg_desc_alloc(sg_list_size);
-	if (_sg_head == NULL)
-		return -ENOMEM;
-	curr = _sg_head;
+	/* Release the list of the previous transfer, if not done yet */
+	_dma_sg_desc_free(channel);
 
 	src_is_periph = is_source_periph(channel);
 	dst_is_periph = is_dest_periph(channel);
 
-	/* Update linked list */
+	/* Update linked list, allocating its items on the fly */
 	for (idx = 0; idx < sg_list_size; idx++) {
 		cfg = &sg_list[idx];
 
+		curr = _dma_sg_desc_alloc(channel);
+		if (curr == NULL) {
+			channel->sg_list = _sg_head;
+			channel->sg_tail = prev;
+			channel->sg_count = idx;
+			_dma_sg_desc_free(channel);
+			return -ENOMEM;
+		}
+		if (prev) {
+			DMA_SG_DESC_SET_NEXT(prev, curr);
+			_dma_sg_desc_sync(prev);
+		} else {
+			_sg_head = curr;
+		}
+
 		DMA_SG_DESC_SET_SADDR(curr, cfg->saddr);
 		DMA_SG_DESC_SET_DADDR(curr, cfg->daddr);
 
@@ -390,7 +493,7 @@ static int _dma_sg_configure_transfer(struct _dma_channel* channel,
 			| XDMA_UBC_UBLEN(cfg->len);
 
 		if (!cfg_dma->loop) {
-			if (DMA_SG_DESC_GET_NEXT(curr) == 0)
+			if (idx == sg_list_size - 1)
 				curr->desc.mbr_ubc &= ~XDMA_UBC_NDE_FETCH_EN;
 		}
 
@@ -421,14 +524,15 @@ static int _dma_sg_configure_transfer(struct _dma_channel* channel,
 		curr->desc.ctrlb |= DMAC_CTRLB_SRC_DSCR_FETCH_FROM_MEM | DMAC_CTRLB_DST_DSCR_FETCH_FROM_MEM;
 
 #endif
-		if (DMA_SG_DESC_GET_NEXT(curr) == 0)
-			if (cfg_dma->loop)
-				DMA_SG_DESC_SET_NEXT(curr, _sg_head);
-		curr = DMA_SG_DESC_GET_NEXT(curr);
+		prev = curr;
 	}
-	channel->sg_list = _sg_head;
+	DMA_SG_DESC_SET_NEXT(prev, cfg_dma->loop ? _sg_head : NULL);
+	_dma_sg_desc_sync(prev);
 
-	cache_clean_region(_dma_sg_pool.desc, sizeof(_dma_sg_pool.desc));
+	channel->sg_list = _sg_head;
+	channel->sg_tail = prev;
+	channel->sg_count = sg_list_size;
+	channel->loop = cfg_dma->loop;
 
 	/* Update configuration */
 #if defined(CONFIG_HAVE_XDMAC)
@@ -444,6 +548,7 @@ static int _dma_sg_configure_transfer(struct _dma_channel* channel,
 	xdmacd_cfg.cfg |= cfg_dma->incr_saddr ? XDMAC_CC_SAM_INCREMENTED_AM : XDMAC_CC_SAM_FIXED_AM;
 	xdmacd_cfg.cfg |= cfg_dma->incr_daddr ? XDMAC_CC_DAM_INCREMENTED_AM : XDMAC_CC_DAM_FIXED_AM;
 	xdmacd_cfg.cfg |= (src_is_periph | dst_is_periph) ? 0 : XDMAC_CC_SWREQ_SWR_CONNECTED;
+	xdmacd_cfg.cfg |= (src_is_periph | dst_is_periph) ? 0 : _dma_get_mbsize(cfg_dma);
 	xdmacd_cfg.bc = 0;
 	xdmacd_cfg.ds = 0;
 	xdmacd_cfg.sus = 0;
@@ -454,7 +559,15 @@ static int _dma_sg_configure_transfer(struct _dma_channel* channel,
 	           | XDMAC_CNDC_NDSUP_SRC_PARAMS_UPDATED
 	           | XDMAC_CNDC_NDDUP_DST_PARAMS_UPDATED;
 
-	return xdmacd_configure_transfer(channel, &xdmacd_cfg, desc_ctrl, (void *)_sg_head);
+	int err = xdmacd_configure_transfer(channel, &xdmacd_cfg, desc_ctrl, (void *)_sg_head);
+	if (err < 0)
+		return err;
+
+	/* A looped list never ends: report the end of each item instead */
+	if (cfg_dma->loop)
+		xdmac_enable_channel_it(channel->hw, channel->id, XDMAC_CIE_BIE);
+
+	return 0;
 #elif defined(CONFIG_HAVE_DMAC)
 	struct _dmacd_cfg dmacd_cfg;
 
@@ -506,6 +619,9 @@ void dma_initialize(bool polling)
 			channel->dest_txif = 0;
 			channel->dest_rxif = 0;
 			channel->state = DMA_STATE_FREE;
+			channel->sg_list = NULL;
+			channel->sg_cache = NULL;
+			channel->sg_cache_count = 0;
 		}
 
 		if (!polling) {
@@ -527,6 +643,28 @@ void dma_poll(void)
 	}
 }
 
+uint32_t dma_sg_add_pool(void* buffer, uint32_t size)
+{
+	uint32_t addr = ROUND_UP_MULT((uint32_t)buffer, 4);
+
+	if (size < addr - (uint32_t)buffer)
+		return 0;
+	size -= addr - (uint32_t)buffer;
+
+	return _dma_sg_add_items((struct _dma_sg_desc*)addr,
+				 size / sizeof(struct _dma_sg_desc));
+}
+
+uint32_t dma_sg_get_free_count(void)
+{
+	return _dma_sg_pool.count;
+}
+
+bool dma_is_polling(void)
+{
+	return _dma_ctrl.polling;
+}
+
 struct _dma_channel* dma_allocate_channel(uint8_t src, uint8_t dest)
 {
 	uint32_t chan, ctrl;
@@ -559,6 +697,8 @@ struct _dma_channel* dma_allocate_channel(uint8_t src, uint8_t dest)
 				dma_prepare_channel(channel);
 
 				channel->sg_list = NULL;
+				channel->sg_tail = NULL;
+				channel->sg_count = 0;
 
 				return channel;
 			}
@@ -589,8 +729,8 @@ int dma_reset_channel(struct _dma_channel* channel)
 	dmac_disable_channel(channel->hw, channel->id);
 #endif
 
-	_dma_sg_desc_free(channel->sg_list);
-	channel->sg_list = NULL;
+	_dma_sg_desc_free(channel);
+	channel->loop = false;
 
 	/* Change state to 'allocated' */
 	channel->state = DMA_STATE_ALLOCATED;
@@ -606,8 +746,9 @@ int dma_free_channel(struct _dma_channel* channel)
 	case DMA_STATE_ALLOCATED:
 	case DMA_STATE_DONE:
 		channel->state = DMA_STATE_FREE;
-		_dma_sg_desc_free(channel->sg_list);
-		channel->sg_list = NULL;
+		channel->loop = false;
+		_dma_sg_desc_free(channel);
+		_dma_sg_flush_cache(channel);
 		break;
 	}
 	return 0;
@@ -701,7 +842,7 @@ void dma_fifo_flush(struct _dma_channel* channel)
 
 int dma_configure_transfer(struct _dma_channel* channel,
 			   struct _dma_cfg* cfg_dma,
-			   struct _dma_transfer_cfg* list, uint8_t list_size)
+			   struct _dma_transfer_cfg* list, uint32_t list_size)
 {
 	if (list_size == 0)
 		return -EINVAL;
@@ -721,6 +862,24 @@ uint32_t dma_get_transferred_data_len(struct _dma_channel* channel, uint8_t chun
 #endif
 }
 
+uint32_t dma_get_src_addr(struct _dma_channel* channel)
+{
+#if defined(CONFIG_HAVE_XDMAC)
+	return xdmac_get_channel_src_addr(channel->hw, channel->id);
+#elif defined(CONFIG_HAVE_DMAC)
+	return dmac_get_channel_src_addr(channel->hw, channel->id);
+#endif
+}
+
+uint32_t dma_get_dest_addr(struct _dma_channel* channel)
+{
+#if defined(CONFIG_HAVE_XDMAC)
+	return xdmac_get_channel_dest_addr(channel->hw, channel->id);
+#elif defined(CONFIG_HAVE_DMAC)
+	return dmac_get_channel_dest_addr(channel->hw, channel->id);
+#endif
+}
+
 int dma_set_callback(struct _dma_channel* channel, struct _callback* cb)
 {
 	if (channel->state == DMA_STATE_FREE)
@@ -100,10 +100,21 @@ enum {
 
 #endif
 
+/** Number of linked list items in the built-in pool, more items can be
+ * given at run time with dma_sg_add_pool() */
 #ifndef DMA_SG_ITEM_POOL_SIZE
 #define DMA_SG_ITEM_POOL_SIZE   64
 #endif
 
+/** Number of freed linked list items a channel keeps for its next transfer
+ * instead of returning them to the shared pool */
+#ifndef DMA_SG_CHANNEL_CACHE_SIZE
+#define DMA_SG_CHANNEL_CACHE_SIZE 16
+#endif
+
+/* Define DMA_SG_POOL_NOT_CACHED to place the built-in pool in non-cacheable
+ * memory, saving the cache maintenance of the linked list items. */
+
 #define DMA_DATA_WIDTH_IN_BYTE(w)   (1 << w)
 
 /*----------------------------------------------------------------------------
@@ -132,8 +143,13 @@ struct _dma_channel {
 	volatile uint32_t rep_count;/* repeat count in auto mode */
 #endif
 	volatile uint8_t state;		/* Channel State */
+	bool loop;			/* Linked list loops back to its head */
 
-	struct _dma_sg_desc* sg_list;
+	struct _dma_sg_desc* sg_list;	/* Linked list of the transfer */
+	struct _dma_sg_desc* sg_tail;	/* Last item of sg_list */
+	uint32_t sg_count;		/* Number of items in sg_list */
+	struct _dma_sg_desc* sg_cache;	/* Items kept for the next transfer */
+	uint32_t sg_cache_count;
 };
 
 struct _dma_transfer_cfg {
@@ -182,6 +198,11 @@ extern void dma_initialize(bool polling);
  */
 extern void dma_poll(void);
 
+/**
+ * \brief Tell whether the driver was initialized in polling mode.
+ */
+extern bool dma_is_polling(void);
+
 /**
  * \brief Enable clock of the DMA peripheral, Enable the peripheral,
  * setup configuration register for transfer.
@@ -223,7 +244,21 @@ extern int dma_set_callback(struct _dma_channel* channel, struct _callback* call
 extern int dma_configure_transfer(struct _dma_channel* channel,
 				  struct _dma_cfg* cfg_dma,
 				  struct _dma_transfer_cfg* list,
-				  uint8_t list_size);
+				  uint32_t list_size);
+
+/**
+ * \brief Give memory to the pool of linked list items.
+ * \param buffer Memory to use, placed in non-cacheable memory if
+ * DMA_SG_POOL_NOT_CACHED is defined, cache-line aligned otherwise
+ * \param size Size of the memory, in bytes
+ * \return Number of items added to the pool
+ */
+extern uint32_t dma_sg_add_pool(void* buffer, uint32_t size);
+
+/**
+ * \brief Return the number of free linked list items in the shared pool.
+ */
+extern uint32_t dma_sg_get_free_count(void);
 
 /**
  * \brief Stop DMA transfer.
@@ -275,6 +310,18 @@ extern void dma_fifo_flush(struct _dma_channel* channel);
  */
 extern uint32_t dma_get_transferred_data_len(struct _dma_channel* channel, uint8_t chunk_size, uint32_t len);
 
+/**
+ * \brief Current source address of the channel
+ * \param channel Channel pointer
+ */
+extern uint32_t dma_get_src_addr(struct _dma_channel* channel);
+
+/**
+ * \brief Current destination address of the channel
+ * \param channel Channel pointer
+ */
+extern uint32_t dma_get_dest_addr(struct _dma_channel* channel);
+
 /**
  * \brief DMA interrupt handler
  * \param source Peripheral ID of DMA controller
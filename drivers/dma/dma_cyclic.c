@@ -0,0 +1,316 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file
+ *
+ * Implementation of circular DMA streaming, see dma_cyclic.h.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "callback.h"
+#include "dma/dma.h"
+#include "dma/dma_cyclic.h"
+#include "errno.h"
+#include "irqflags.h"
+#include "mm/cache.h"
+#include "timer.h"
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static uint8_t* _dma_cyclic_period(const struct _dma_cyclic* cyc, uint32_t index)
+{
+	return cyc->buffer + index * cyc->period_size;
+}
+
+static void _dma_cyclic_silence(struct _dma_cyclic* cyc, uint32_t index)
+{
+	uint8_t* period = _dma_cyclic_period(cyc, index);
+
+	memset(period, 0, cyc->period_size);
+	cache_clean_region(period, cyc->period_size);
+}
+
+/**
+ * \brief Offset of the DMA in the buffer, read back from the channel
+ * address registers.
+ */
+static uint32_t _dma_cyclic_offset(const struct _dma_cyclic* cyc)
+{
+	uint32_t addr, offset;
+
+	addr = cyc->tx ? dma_get_src_addr(cyc->channel) : dma_get_dest_addr(cyc->channel);
+	offset = addr - (uint32_t)cyc->buffer;
+
+	/* At the end of the buffer, the first item is being loaded */
+	if (offset >= cyc->period_size * cyc->periods)
+		return 0;
+	return offset;
+}
+
+/**
+ * \brief End-of-item callback of the DMA channel. The completed periods
+ * are derived from the DMA position rather than counted, so that
+ * interrupts served late do not desynchronize the stream.
+ */
+static int _dma_cyclic_callback(void* arg, void* arg2)
+{
+	struct _dma_cyclic* cyc = (struct _dma_cyclic*)arg;
+	uint32_t index, count, done, i;
+
+	if (cyc->state == DMA_CYCLIC_STOPPED)
+		return 0;
+
+	index = _dma_cyclic_offset(cyc) / cyc->period_size;
+	count = (index + cyc->periods - cyc->hw_index) % cyc->periods;
+	if (count > 1)
+		cyc->stats.late++;
+
+	while (count--) {
+		done = cyc->hw_index;
+		cyc->hw_index = (done + 1) % cyc->periods;
+		cyc->hw_count++;
+		cyc->stats.periods++;
+
+		if (cyc->state == DMA_CYCLIC_DRAINING) {
+			_dma_cyclic_silence(cyc, done);
+			if (--cyc->drain == 0) {
+				dma_stop_transfer(cyc->channel);
+				cyc->state = DMA_CYCLIC_STOPPED;
+				return 0;
+			}
+			continue;
+		}
+
+		if (cyc->tx) {
+			if ((int32_t)(cyc->app_count - cyc->hw_count) <= 0) {
+				/* Underrun: silence the stale periods, the
+				 * application resumes with the completed one */
+				cyc->stats.xruns++;
+				for (i = 1; i < cyc->periods; i++)
+					_dma_cyclic_silence(cyc, (done + i) % cyc->periods);
+				cyc->app_count = cyc->hw_count + cyc->periods - 1;
+			}
+		} else {
+			cache_invalidate_region(_dma_cyclic_period(cyc, done), cyc->period_size);
+			if (cyc->hw_count - cyc->app_count >= cyc->periods) {
+				/* Overrun: drop the unread periods, the
+				 * application resumes with the completed one */
+				cyc->stats.xruns++;
+				cyc->app_count = cyc->hw_count - 1;
+			}
+		}
+
+		callback_call(&cyc->callback, (void*)done);
+	}
+
+	return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+int dma_cyclic_start(struct _dma_cyclic* cyc,
+		     struct _dma_channel* channel,
+		     const struct _dma_cfg* cfg_dma, void* periph,
+		     void* buffer, uint32_t period_size, uint32_t periods,
+		     bool tx, struct _callback* cb)
+{
+	struct _dma_transfer_cfg list[DMA_CYCLIC_MAX_PERIODS];
+	struct _dma_cfg cfg;
+	struct _callback dma_cb;
+	uint32_t i;
+	int err;
+
+	if (!cyc || !channel || !cfg_dma || !buffer)
+		return -EINVAL;
+	if (periods < 2 || periods > DMA_CYCLIC_MAX_PERIODS)
+		return -EINVAL;
+	if (period_size == 0 || (period_size & ((1 << cfg_dma->data_width) - 1)))
+		return -EINVAL;
+	if ((period_size >> cfg_dma->data_width) > DMA_MAX_BT_SIZE)
+		return -EINVAL;
+	if (!IS_CACHE_ALIGNED(buffer) || !IS_CACHE_ALIGNED(period_size))
+		return -EINVAL;
+	if (dma_cyclic_is_running(cyc))
+		return -EBUSY;
+
+	cyc->channel = channel;
+	cyc->buffer = (uint8_t*)buffer;
+	cyc->period_size = period_size;
+	cyc->periods = periods;
+	cyc->tx = tx;
+	cyc->hw_index = 0;
+	cyc->hw_count = 0;
+	/* For playback, the whole buffer has been filled by the caller */
+	cyc->app_count = tx ? periods : 0;
+	cyc->drain = 0;
+	memset(&cyc->stats, 0, sizeof(cyc->stats));
+	callback_copy(&cyc->callback, cb);
+
+	if (tx)
+		cache_clean_region(buffer, period_size * periods);
+	else
+		cache_invalidate_region(buffer, period_size * periods);
+
+	for (i = 0; i < periods; i++) {
+		list[i].saddr = tx ? _dma_cyclic_period(cyc, i) : periph;
+		list[i].daddr = tx ? periph : _dma_cyclic_period(cyc, i);
+		list[i].len = period_size >> cfg_dma->data_width;
+	}
+
+	cfg = *cfg_dma;
+	cfg.incr_saddr = tx;
+	cfg.incr_daddr = !tx;
+	cfg.loop = true;
+
+	err = dma_configure_transfer(channel, &cfg, list, periods);
+	if (err < 0)
+		return err;
+
+	callback_set(&dma_cb, _dma_cyclic_callback, cyc);
+	dma_set_callback(channel, &dma_cb);
+
+	cyc->state = DMA_CYCLIC_RUNNING;
+	err = dma_start_transfer(channel);
+	if (err < 0) {
+		cyc->state = DMA_CYCLIC_STOPPED;
+		dma_reset_channel(channel);
+	}
+
+	return err;
+}
+
+void dma_cyclic_stop(struct _dma_cyclic* cyc, bool drain)
+{
+	struct _timeout timeout;
+	uint32_t flags, i;
+
+	if (!dma_cyclic_is_running(cyc))
+		return;
+
+	if (drain && cyc->tx) {
+		flags = arch_irq_save();
+		/* Silence the periods not committed yet, then let the
+		 * whole buffer go round once, silencing it period by period */
+		for (i = 0; i < dma_cyclic_get_avail(cyc); i++)
+			_dma_cyclic_silence(cyc, (cyc->app_count + i) % cyc->periods);
+		cyc->drain = cyc->periods;
+		cyc->state = DMA_CYCLIC_DRAINING;
+		arch_irq_restore(flags);
+
+		timer_start_timeout(&timeout, DMA_CYCLIC_DRAIN_TIMEOUT);
+		while (cyc->state == DMA_CYCLIC_DRAINING) {
+			if (dma_is_polling())
+				dma_poll();
+			if (timer_timeout_reached(&timeout))
+				break;
+		}
+	}
+
+	flags = arch_irq_save();
+	if (cyc->state != DMA_CYCLIC_STOPPED) {
+		dma_stop_transfer(cyc->channel);
+		cyc->state = DMA_CYCLIC_STOPPED;
+	}
+	arch_irq_restore(flags);
+
+	dma_reset_channel(cyc->channel);
+}
+
+bool dma_cyclic_is_running(const struct _dma_cyclic* cyc)
+{
+	return cyc->state != DMA_CYCLIC_STOPPED;
+}
+
+int dma_cyclic_commit(struct _dma_cyclic* cyc, uint32_t count)
+{
+	uint32_t flags, i;
+	int err = 0;
+
+	flags = arch_irq_save();
+	if (count > dma_cyclic_get_avail(cyc)) {
+		err = -EINVAL;
+	} else {
+		if (cyc->tx) {
+			for (i = 0; i < count; i++)
+				cache_clean_region(_dma_cyclic_period(cyc, (cyc->app_count + i) % cyc->periods),
+						   cyc->period_size);
+		}
+		cyc->app_count += count;
+	}
+	arch_irq_restore(flags);
+
+	return err;
+}
+
+uint32_t dma_cyclic_get_avail(const struct _dma_cyclic* cyc)
+{
+	uint32_t pending;
+
+	if (cyc->tx) {
+		/* Committed periods not played yet, including the current one */
+		pending = cyc->app_count - cyc->hw_count;
+		return pending < cyc->periods ? cyc->periods - pending : 0;
+	} else {
+		return cyc->hw_count - cyc->app_count;
+	}
+}
+
+void* dma_cyclic_get_next(const struct _dma_cyclic* cyc)
+{
+	return _dma_cyclic_period(cyc, cyc->app_count % cyc->periods);
+}
+
+void* dma_cyclic_get_period(const struct _dma_cyclic* cyc, uint32_t index)
+{
+	return _dma_cyclic_period(cyc, index % cyc->periods);
+}
+
+uint32_t dma_cyclic_get_position(const struct _dma_cyclic* cyc)
+{
+	if (!dma_cyclic_is_running(cyc))
+		return 0;
+	return _dma_cyclic_offset(cyc);
+}
+
+void dma_cyclic_get_stats(const struct _dma_cyclic* cyc,
+			  struct _dma_cyclic_stats* stats)
+{
+	uint32_t flags = arch_irq_save();
+	*stats = cyc->stats;
+	arch_irq_restore(flags);
+}
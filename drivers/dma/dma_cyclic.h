@@ -0,0 +1,203 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file
+ *
+ * Circular DMA streaming between a memory buffer and a peripheral FIFO.
+ *
+ * The buffer is split into periods, each described by one item of a looped
+ * DMA linked list, so that the transfer never stops and the peripheral is
+ * fed (or drained) without any gap. The period callback is invoked as
+ * method(arg, index) from the DMA interrupt (or from dma_poll() in polling
+ * mode), index being the number of the period just completed.
+ *
+ * Usage for playback (tx):
+ *  -# Fill all the periods of the buffer, then call dma_cyclic_start().
+ *  -# Each time a period completes, fill it again and call
+ *     dma_cyclic_commit(). Doing it from the period callback is the simplest.
+ *  -# Call dma_cyclic_stop() with drain set to let the committed periods
+ *     play out followed by silence before the channel stops.
+ *
+ * Usage for capture (rx):
+ *  -# Call dma_cyclic_start().
+ *  -# Each time a period completes, read it and call dma_cyclic_commit().
+ *  -# Call dma_cyclic_stop().
+ *
+ * An xrun is counted when the DMA reaches a period the application did not
+ * fill yet (tx) or overwrites a period the application did not read yet
+ * (rx). The application is then resynchronized so that the next period to
+ * fill or read is the one reported by the callback; on playback the stale
+ * periods are silenced.
+ *
+ * Cache maintenance is done per period: committed periods are cleaned
+ * before playback, completed periods are invalidated before the callback
+ * on capture. The buffer and the period size must be aligned on cache
+ * lines.
+ */
+
+#ifndef _DMA_CYCLIC_H_
+#define _DMA_CYCLIC_H_
+
+/*----------------------------------------------------------------------------
+ *        Includes
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "callback.h"
+#include "dma/dma.h"
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Maximum number of periods in a buffer */
+#ifndef DMA_CYCLIC_MAX_PERIODS
+#define DMA_CYCLIC_MAX_PERIODS 16
+#endif
+
+/** Maximum time (in ms) to wait for the buffer to play out when draining */
+#ifndef DMA_CYCLIC_DRAIN_TIMEOUT
+#define DMA_CYCLIC_DRAIN_TIMEOUT 100
+#endif
+
+/** Stream states */
+enum {
+	DMA_CYCLIC_STOPPED = 0,
+	DMA_CYCLIC_RUNNING,
+	DMA_CYCLIC_DRAINING,
+};
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** Statistics of a stream */
+struct _dma_cyclic_stats {
+	uint32_t periods;   /* Periods completed by the DMA */
+	uint32_t xruns;     /* Underruns (tx) or overruns (rx) */
+	uint32_t late;      /* Interrupts that found several periods completed */
+};
+
+/** Circular stream. Owned by the caller, set up by dma_cyclic_start(). */
+struct _dma_cyclic {
+	struct _dma_channel* channel;
+	uint8_t* buffer;
+	uint32_t period_size;       /* in bytes */
+	uint32_t periods;
+	bool tx;
+	struct _callback callback;
+	volatile uint8_t state;
+	uint32_t hw_index;          /* Period being transferred by the DMA */
+	volatile uint32_t hw_count; /* Periods completed by the DMA, free-running */
+	volatile uint32_t app_count;/* Periods committed by the application */
+	uint32_t drain;             /* Periods left to silence before stopping */
+	struct _dma_cyclic_stats stats;
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Start a circular transfer between a buffer and a peripheral.
+ * \param cyc Stream instance, owned by the caller until stopped
+ * \param channel DMA channel, allocated for the peripheral
+ * \param cfg_dma DMA configuration (data width, chunk size); the address
+ * increments and the loop flag are set by this function
+ * \param periph Address of the peripheral data register
+ * \param buffer Buffer, periods * period_size bytes, filled for playback
+ * \param period_size Size of a period in bytes, multiple of the data width
+ * and of the cache line size
+ * \param periods Number of periods, 2 to DMA_CYCLIC_MAX_PERIODS
+ * \param tx true to transfer from the buffer to the peripheral
+ * \param cb Optional period callback
+ * \return 0 on success, -EINVAL on bad parameters, -EBUSY if the stream or
+ * the channel is already running, or an error code from the DMA driver
+ */
+extern int dma_cyclic_start(struct _dma_cyclic* cyc,
+			    struct _dma_channel* channel,
+			    const struct _dma_cfg* cfg_dma, void* periph,
+			    void* buffer, uint32_t period_size, uint32_t periods,
+			    bool tx, struct _callback* cb);
+
+/**
+ * \brief Stop a circular transfer.
+ * \param cyc Stream instance
+ * \param drain For playback, wait for the committed periods to play out and
+ * for the whole buffer to be silenced before stopping, so that the
+ * peripheral does not output a truncated period. Ignored for capture.
+ */
+extern void dma_cyclic_stop(struct _dma_cyclic* cyc, bool drain);
+
+/**
+ * \brief Tell whether a circular transfer is running.
+ */
+extern bool dma_cyclic_is_running(const struct _dma_cyclic* cyc);
+
+/**
+ * \brief Mark periods as filled (tx) or read (rx) by the application.
+ * Periods are committed in order, starting from the one returned by
+ * dma_cyclic_get_next().
+ * \param cyc Stream instance
+ * \param count Number of periods
+ * \return 0 on success, -EINVAL if more periods than available are committed
+ */
+extern int dma_cyclic_commit(struct _dma_cyclic* cyc, uint32_t count);
+
+/**
+ * \brief Number of periods the application can fill (tx) or read (rx).
+ */
+extern uint32_t dma_cyclic_get_avail(const struct _dma_cyclic* cyc);
+
+/**
+ * \brief Address of the next period to fill (tx) or read (rx).
+ */
+extern void* dma_cyclic_get_next(const struct _dma_cyclic* cyc);
+
+/**
+ * \brief Address of a period of the buffer.
+ */
+extern void* dma_cyclic_get_period(const struct _dma_cyclic* cyc, uint32_t index);
+
+/**
+ * \brief Current position of the DMA in the buffer.
+ * \return Offset in bytes from the start of the buffer. The DMA may have
+ * fetched (tx) or not yet written back (rx) a few bytes past this position.
+ */
+extern uint32_t dma_cyclic_get_position(const struct _dma_cyclic* cyc);
+
+/**
+ * \brief Get the statistics of a stream.
+ */
+extern void dma_cyclic_get_stats(const struct _dma_cyclic* cyc,
+				 struct _dma_cyclic_stats* stats);
+
+#endif /* _DMA_CYCLIC_H_ */
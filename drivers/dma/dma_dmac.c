@@ -175,7 +175,12 @@ void dma_irq_handler(uint32_t source, void* user_arg)
 			continue;
 		if (channel->state == DMA_STATE_FREE)
 			continue;
-		if (gis & (DMAC_EBCISR_CBTC0 << chan)) {
+		if (channel->loop) {
+			/* Looped list: the channel keeps running, report
+			 * each completed buffer without changing state */
+			if (gis & (DMAC_EBCISR_BTC0 << chan))
+				exec = 1;
+		} else if (gis & (DMAC_EBCISR_CBTC0 << chan)) {
 			if (channel->rep_count) {
 				if (channel->rep_count == 1) {
 					dmac_auto_clear(dmac, chan);
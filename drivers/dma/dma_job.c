@@ -0,0 +1,603 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file
+ *
+ * Implementation of the DMA job engine, see dma_job.h.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <string.h>
+
+#include "callback.h"
+#include "compiler.h"
+#include "cycles.h"
+#include "dma/dma.h"
+#include "dma/dma_job.h"
+#include "errno.h"
+#include "intmath.h"
+#include "irq/irq.h"
+#include "mm/cache.h"
+#include "peripherals/pmc.h"
+#include "timer.h"
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** Channel of the pool */
+struct _dma_job_channel {
+	struct _dma_channel* channel;
+	uint32_t pid;                 /* Peripheral ID of the controller */
+	struct _dma_job* batch;       /* Jobs being transferred */
+	uint32_t start;               /* Cycle count at the transfer start */
+	struct _dma_job_stats stats;
+};
+
+struct _dma_job_engine {
+	struct _dma_job_channel channels[DMA_JOB_MAX_CHANNELS];
+	uint8_t num_channels;
+	struct _dma_job* head;        /* Queued jobs */
+	struct _dma_job* tail;
+	uint32_t threshold;
+	struct _dma_job_stats cpu;
+	uint64_t reset_tick;
+};
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+static struct _dma_job_engine _engine;
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Read the CPU cycle counter, 0 on cores without one.
+ */
+static inline uint32_t _dma_job_cycles(void)
+{
+#ifdef ARCH_HAVE_CYCLE_COUNTER
+	return arch_cycles_read();
+#else
+	return 0;
+#endif
+}
+
+/**
+ * \brief CPU cycles since the statistics were reset, from the millisecond
+ * tick, in the unit of busy_cycles.
+ */
+static uint64_t _dma_job_elapsed_cycles(void)
+{
+	uint64_t ms = timer_get_interval(_engine.reset_tick, timer_get_tick());
+
+	return ms * (pmc_get_processor_clock() / 1000);
+}
+
+/**
+ * \brief Protect the queue against the DMA interrupts.
+ */
+static void _dma_job_lock(void)
+{
+	uint8_t i;
+
+	if (dma_is_polling())
+		return;
+	for (i = 0; i < _engine.num_channels; i++)
+		irq_disable(_engine.channels[i].pid);
+}
+
+static void _dma_job_unlock(void)
+{
+	uint8_t i;
+
+	if (dma_is_polling())
+		return;
+	for (i = 0; i < _engine.num_channels; i++)
+		irq_enable(_engine.channels[i].pid);
+}
+
+/**
+ * \brief Total number of bytes written by a job.
+ */
+static uint32_t _dma_job_size(struct _dma_job* job)
+{
+	uint32_t size = 0;
+	uint8_t i;
+
+	if (job->type != DMA_JOB_SG)
+		return job->len;
+	for (i = 0; i < job->list_size; i++)
+		size += job->list[i].len;
+	return size;
+}
+
+/**
+ * \brief Widest data width usable for a job.
+ */
+static uint8_t _dma_job_width(struct _dma_job* job)
+{
+	uint32_t bits = 0;
+	uint8_t i;
+
+	switch (job->type) {
+	case DMA_JOB_MEMCPY:
+		bits = (uint32_t)job->dest | (uint32_t)job->src | job->len;
+		break;
+	case DMA_JOB_MEMSET:
+		bits = (uint32_t)job->dest | job->len;
+		break;
+	case DMA_JOB_SG:
+		for (i = 0; i < job->list_size; i++)
+			bits |= (uint32_t)job->list[i].daddr
+			      | (uint32_t)job->list[i].saddr
+			      | job->list[i].len;
+		break;
+	}
+	return (bits & 3) ? DMA_DATA_WIDTH_BYTE : DMA_DATA_WIDTH_WORD;
+}
+
+/**
+ * \brief Append the descriptors of one copy to a transfer list, splitting it
+ * in blocks the controller can handle.
+ * \return Number of items appended, 0 if they do not fit.
+ */
+static uint8_t _dma_job_split(const void* saddr, bool incr_saddr, void* daddr,
+			      uint32_t len, uint8_t width,
+			      struct _dma_transfer_cfg* items, uint8_t max)
+{
+	const uint32_t max_len = DMA_MAX_BT_SIZE << width;
+	uint8_t count = 0;
+
+	while (len > 0) {
+		uint32_t chunk = min_u32(len, max_len);
+
+		if (count == max)
+			return 0;
+		items[count].saddr = saddr;
+		items[count].daddr = daddr;
+		items[count].len = chunk >> width;
+		count++;
+
+		if (incr_saddr)
+			saddr = (const uint8_t*)saddr + chunk;
+		daddr = (uint8_t*)daddr + chunk;
+		len -= chunk;
+	}
+	return count;
+}
+
+/**
+ * \brief Build the descriptors of a job.
+ * \return Number of items used, 0 if they do not fit.
+ */
+static uint8_t _dma_job_items(struct _dma_job* job, uint8_t width,
+			      struct _dma_transfer_cfg* items, uint8_t max)
+{
+	uint8_t i, n, count = 0;
+
+	switch (job->type) {
+	case DMA_JOB_MEMCPY:
+		return _dma_job_split(job->src, true, job->dest, job->len,
+				      width, items, max);
+	case DMA_JOB_MEMSET:
+		return _dma_job_split(&job->pattern, false, job->dest, job->len,
+				      width, items, max);
+	case DMA_JOB_SG:
+		for (i = 0; i < job->list_size; i++) {
+			n = _dma_job_split(job->list[i].saddr, true,
+					   job->list[i].daddr, job->list[i].len,
+					   width, items + count, max - count);
+			if (n == 0 && job->list[i].len > 0)
+				return 0;
+			count += n;
+		}
+		return count;
+	}
+	return 0;
+}
+
+/**
+ * \brief Invalidate the cache lines of the memory written by a job.
+ */
+static void _dma_job_invalidate(struct _dma_job* job)
+{
+	uint8_t i;
+
+	if (job->type != DMA_JOB_SG) {
+		cache_invalidate_region(job->dest, job->len);
+		return;
+	}
+	for (i = 0; i < job->list_size; i++)
+		cache_invalidate_region(job->list[i].daddr, job->list[i].len);
+}
+
+/**
+ * \brief Clean the cache lines of the memory accessed by a job.
+ */
+static void _dma_job_clean(struct _dma_job* job)
+{
+	uint8_t i;
+
+	switch (job->type) {
+	case DMA_JOB_MEMCPY:
+		cache_clean_region(job->src, job->len);
+		cache_clean_region(job->dest, job->len);
+		break;
+	case DMA_JOB_MEMSET:
+		cache_clean_region(&job->pattern, sizeof(job->pattern));
+		cache_clean_region(job->dest, job->len);
+		break;
+	case DMA_JOB_SG:
+		for (i = 0; i < job->list_size; i++) {
+			cache_clean_region(job->list[i].saddr, job->list[i].len);
+			cache_clean_region(job->list[i].daddr, job->list[i].len);
+		}
+		break;
+	}
+}
+
+/**
+ * \brief Do a job with the CPU.
+ */
+static void _dma_job_run_cpu(struct _dma_job* job)
+{
+	uint8_t i;
+
+	switch (job->type) {
+	case DMA_JOB_MEMCPY:
+		memcpy(job->dest, job->src, job->len);
+		break;
+	case DMA_JOB_MEMSET:
+		if (((uint32_t)job->dest | job->len) & 3) {
+			memset(job->dest, job->pattern & 0xff, job->len);
+		} else {
+			uint32_t* dest = (uint32_t*)job->dest;
+			uint32_t count = job->len >> 2;
+
+			while (count--)
+				*dest++ = job->pattern;
+		}
+		break;
+	case DMA_JOB_SG:
+		for (i = 0; i < job->list_size; i++)
+			memcpy(job->list[i].daddr, job->list[i].saddr,
+			       job->list[i].len);
+		break;
+	}
+}
+
+/**
+ * \brief Complete a list of jobs and invoke their callbacks.
+ */
+static void _dma_job_finish(struct _dma_job* job, int status,
+			    struct _dma_job_stats* stats)
+{
+	struct _dma_job* next;
+
+	while (job) {
+		/* The job may be reused by its callback */
+		next = job->next;
+		job->next = NULL;
+		if (status == 0) {
+			_dma_job_invalidate(job);
+			if (stats) {
+				stats->jobs++;
+				stats->bytes += _dma_job_size(job);
+			}
+		}
+		job->status = status;
+		callback_call(&job->callback, job);
+		job = next;
+	}
+}
+
+/**
+ * \brief Start queued jobs on the idle channels, chaining consecutive jobs
+ * that share the same configuration. Called with the queue locked.
+ * \param status Set to the error code of the failed jobs
+ * \return List of the jobs that could not be started
+ */
+static struct _dma_job* _dma_job_dispatch(int* status)
+{
+	struct _dma_transfer_cfg items[DMA_JOB_MAX_ITEMS];
+	struct _dma_job* failed = NULL;
+	uint8_t i;
+
+	for (i = 0; i < _engine.num_channels && _engine.head; i++) {
+		struct _dma_job_channel* ch = &_engine.channels[i];
+		struct _dma_job *job, *last = NULL;
+		uint8_t type, width, count = 0, n;
+		int rc;
+
+		if (ch->batch)
+			continue;
+
+		job = _engine.head;
+		type = job->type == DMA_JOB_MEMSET ? DMA_JOB_MEMSET : DMA_JOB_MEMCPY;
+		width = _dma_job_width(job);
+		while (job) {
+			if (last) {
+				uint8_t job_type = job->type == DMA_JOB_MEMSET ?
+					DMA_JOB_MEMSET : DMA_JOB_MEMCPY;
+				if (job_type != type || _dma_job_width(job) != width)
+					break;
+			}
+			n = _dma_job_items(job, width, items + count,
+					   DMA_JOB_MAX_ITEMS - count);
+			if (n == 0)
+				break;
+			count += n;
+			last = job;
+			job = job->next;
+		}
+		/* dma_job_submit() ensures a single job always fits */
+		assert(last);
+
+		ch->batch = _engine.head;
+		_engine.head = job;
+		if (!job)
+			_engine.tail = NULL;
+		last->next = NULL;
+
+		struct _dma_cfg cfg = {
+			.data_width = width,
+			.chunk_size = DMA_CHUNK_SIZE_1,
+			.incr_saddr = type != DMA_JOB_MEMSET,
+			.incr_daddr = true,
+			.loop = false,
+		};
+		rc = dma_configure_transfer(ch->channel, &cfg, items, count);
+		if (rc == 0) {
+			ch->start = _dma_job_cycles();
+			rc = dma_start_transfer(ch->channel);
+		}
+		if (rc < 0) {
+			dma_reset_channel(ch->channel);
+			last->next = failed;
+			failed = ch->batch;
+			ch->batch = NULL;
+			*status = rc;
+			continue;
+		}
+		ch->stats.transfers++;
+	}
+	return failed;
+}
+
+/**
+ * \brief DMA completion callback of a channel of the pool.
+ */
+static int _dma_job_complete(void* arg, void* arg2)
+{
+	struct _dma_job_channel* ch = (struct _dma_job_channel*)arg;
+	struct _dma_job *batch, *failed;
+	int status = 0;
+
+	_dma_job_lock();
+	batch = ch->batch;
+	ch->batch = NULL;
+	dma_reset_channel(ch->channel);
+	ch->stats.busy_cycles += _dma_job_cycles() - ch->start;
+	/* Keep the channel busy before running the callbacks */
+	failed = _dma_job_dispatch(&status);
+	_dma_job_unlock();
+
+	_dma_job_finish(batch, 0, &ch->stats);
+	_dma_job_finish(failed, status, NULL);
+	return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+int dma_job_initialize(uint8_t num_channels)
+{
+	struct _callback cb;
+	uint8_t i;
+
+	memset(&_engine, 0, sizeof(_engine));
+	_engine.threshold = DMA_JOB_CPU_THRESHOLD;
+	_engine.reset_tick = timer_get_tick();
+#ifdef ARCH_HAVE_CYCLE_COUNTER
+	arch_cycles_enable();
+#endif
+
+	num_channels = min_u32(num_channels, DMA_JOB_MAX_CHANNELS);
+	for (i = 0; i < num_channels; i++) {
+		struct _dma_job_channel* ch = &_engine.channels[i];
+
+		ch->channel = dma_allocate_channel(DMA_PERIPH_MEMORY,
+						   DMA_PERIPH_MEMORY);
+		if (!ch->channel)
+			break;
+#if defined(CONFIG_HAVE_XDMAC)
+		ch->pid = get_xdmac_id_from_addr(ch->channel->hw);
+#elif defined(CONFIG_HAVE_DMAC)
+		ch->pid = get_dmac_id_from_addr(ch->channel->hw);
+#endif
+		callback_set(&cb, _dma_job_complete, ch);
+		dma_set_callback(ch->channel, &cb);
+	}
+	_engine.num_channels = i;
+
+	return i > 0 ? i : -ENODEV;
+}
+
+void dma_job_set_cpu_threshold(uint32_t threshold)
+{
+	_engine.threshold = threshold;
+}
+
+int dma_job_submit(struct _dma_job* job)
+{
+	struct _dma_transfer_cfg items[DMA_JOB_MAX_ITEMS];
+	struct _dma_job* failed;
+	uint32_t size;
+	int status = 0;
+
+	if (job->type == DMA_JOB_SG &&
+	    (!job->list || job->list_size == 0 || job->list_size > DMA_JOB_MAX_ITEMS))
+		return -EINVAL;
+
+	job->next = NULL;
+	job->status = -EINPROGRESS;
+	size = _dma_job_size(job);
+
+	if (size == 0 || size < _engine.threshold || _engine.num_channels == 0) {
+		_dma_job_run_cpu(job);
+		_engine.cpu.jobs++;
+		_engine.cpu.bytes += size;
+		job->status = 0;
+		callback_call(&job->callback, job);
+		return 0;
+	}
+
+	if (_dma_job_items(job, _dma_job_width(job), items, DMA_JOB_MAX_ITEMS) == 0)
+		return -EINVAL;
+
+	_dma_job_clean(job);
+
+	_dma_job_lock();
+	if (_engine.tail)
+		_engine.tail->next = job;
+	else
+		_engine.head = job;
+	_engine.tail = job;
+	failed = _dma_job_dispatch(&status);
+	_dma_job_unlock();
+
+	_dma_job_finish(failed, status, NULL);
+	return 0;
+}
+
+int dma_memcpy_async(struct _dma_job* job, void* dest, const void* src,
+		     uint32_t len, struct _callback* cb)
+{
+	memset(job, 0, sizeof(*job));
+	job->type = DMA_JOB_MEMCPY;
+	job->dest = dest;
+	job->src = src;
+	job->len = len;
+	if (cb)
+		callback_copy(&job->callback, cb);
+	return dma_job_submit(job);
+}
+
+int dma_memset_async(struct _dma_job* job, void* dest, uint8_t value,
+		     uint32_t len, struct _callback* cb)
+{
+	memset(job, 0, sizeof(*job));
+	job->type = DMA_JOB_MEMSET;
+	job->dest = dest;
+	job->pattern = value * 0x01010101u;
+	job->len = len;
+	if (cb)
+		callback_copy(&job->callback, cb);
+	return dma_job_submit(job);
+}
+
+int dma_memset32_async(struct _dma_job* job, void* dest, uint32_t pattern,
+		       uint32_t len, struct _callback* cb)
+{
+	if (((uint32_t)dest | len) & 3)
+		return -EINVAL;
+
+	memset(job, 0, sizeof(*job));
+	job->type = DMA_JOB_MEMSET;
+	job->dest = dest;
+	job->pattern = pattern;
+	job->len = len;
+	if (cb)
+		callback_copy(&job->callback, cb);
+	return dma_job_submit(job);
+}
+
+int dma_sg_async(struct _dma_job* job, struct _dma_transfer_cfg* list,
+		 uint8_t list_size, struct _callback* cb)
+{
+	memset(job, 0, sizeof(*job));
+	job->type = DMA_JOB_SG;
+	job->list = list;
+	job->list_size = list_size;
+	if (cb)
+		callback_copy(&job->callback, cb);
+	return dma_job_submit(job);
+}
+
+bool dma_job_is_done(struct _dma_job* job)
+{
+	return job->status != -EINPROGRESS;
+}
+
+int dma_job_wait(struct _dma_job* job)
+{
+	while (!dma_job_is_done(job))
+		dma_poll();
+	return job->status;
+}
+
+int dma_job_get_stats(uint8_t index, struct _dma_job_stats* stats)
+{
+	if (index >= _engine.num_channels)
+		return -EINVAL;
+
+	_dma_job_lock();
+	*stats = _engine.channels[index].stats;
+	_dma_job_unlock();
+	stats->elapsed_cycles = _dma_job_elapsed_cycles();
+	return 0;
+}
+
+void dma_job_get_cpu_stats(struct _dma_job_stats* stats)
+{
+	*stats = _engine.cpu;
+	stats->elapsed_cycles = _dma_job_elapsed_cycles();
+}
+
+void dma_job_reset_stats(void)
+{
+	uint8_t i;
+
+	_dma_job_lock();
+	for (i = 0; i < _engine.num_channels; i++)
+		memset(&_engine.channels[i].stats, 0,
+		       sizeof(_engine.channels[i].stats));
+	memset(&_engine.cpu, 0, sizeof(_engine.cpu));
+	_engine.reset_tick = timer_get_tick();
+	_dma_job_unlock();
+}
@@ -0,0 +1,230 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file
+ *
+ * DMA job engine: a queue of memory-to-memory jobs (copy, fill,
+ * scatter-gather copy) served by a pool of DMA channels.
+ *
+ * Consecutive compatible jobs are chained into a single linked descriptor
+ * list, so that the controller runs them back to back with a single
+ * interrupt. Jobs smaller than a threshold are done by the CPU, the DMA
+ * setup costing more than the copy.
+ *
+ * Usage:
+ *  -# Call dma_job_initialize() once dma_initialize() has been called.
+ *  -# Start jobs with dma_memcpy_async(), dma_memset_async() or
+ *     dma_sg_async(). The job structure belongs to the caller and must stay
+ *     valid until completion.
+ *  -# Wait for dma_job_is_done() or use the completion callback, which is
+ *     invoked as method(arg, job) from the DMA interrupt (or from dma_poll()
+ *     in polling mode).
+ *
+ * Cache maintenance is done by the engine: source and destination are
+ * cleaned when the job is submitted, destination is invalidated before the
+ * callback. Destination buffers should thus be aligned on cache lines.
+ *
+ * Jobs may complete out of order: jobs done by the CPU complete immediately
+ * and several channels run in parallel.
+ */
+
+#ifndef _DMA_JOB_H_
+#define _DMA_JOB_H_
+
+/*----------------------------------------------------------------------------
+ *        Includes
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "callback.h"
+#include "dma/dma.h"
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Maximum number of channels in the pool */
+#ifndef DMA_JOB_MAX_CHANNELS
+#define DMA_JOB_MAX_CHANNELS 4
+#endif
+
+/** Maximum number of descriptors chained in one DMA transfer */
+#ifndef DMA_JOB_MAX_ITEMS
+#define DMA_JOB_MAX_ITEMS 16
+#endif
+
+/** Default size (in bytes) below which jobs are done by the CPU */
+#ifndef DMA_JOB_CPU_THRESHOLD
+#define DMA_JOB_CPU_THRESHOLD 256
+#endif
+
+/** Job types */
+enum {
+	DMA_JOB_MEMCPY = 0,
+	DMA_JOB_MEMSET,
+	DMA_JOB_SG,
+};
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** DMA job. Fill it with the dma_*_async() functions. */
+struct _dma_job {
+	uint8_t type;
+	void* dest;
+	const void* src;
+	uint32_t len;
+	uint32_t pattern;                   /* memset: 32-bit fill pattern */
+	struct _dma_transfer_cfg* list;     /* scatter-gather: list of copies */
+	uint8_t list_size;
+	struct _callback callback;
+	volatile int status;                /* -EINPROGRESS until completion */
+	struct _dma_job* next;
+};
+
+/** Statistics of a channel of the pool */
+struct _dma_job_stats {
+	uint32_t jobs;          /* Jobs completed */
+	uint32_t transfers;     /* DMA transfers, a transfer chains one or more jobs */
+	uint64_t bytes;         /* Bytes transferred */
+	uint64_t busy_cycles;   /* Time spent transferring, in CPU cycles (0 on
+				   cores without cycle counter) */
+	uint64_t elapsed_cycles; /* Time since the statistics were reset, in CPU
+				    cycles (millisecond resolution), so that
+				    busy_cycles / elapsed_cycles is the load */
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize the job engine and allocate its channels.
+ * \param num_channels Number of DMA channels to reserve (up to
+ * DMA_JOB_MAX_CHANNELS)
+ * \return Number of channels actually allocated, or -ENODEV if none
+ */
+extern int dma_job_initialize(uint8_t num_channels);
+
+/**
+ * \brief Set the size below which jobs are done by the CPU (0 to always use
+ * the DMA).
+ */
+extern void dma_job_set_cpu_threshold(uint32_t threshold);
+
+/**
+ * \brief Queue a job prepared by the caller.
+ * \return 0 on success, -EINVAL if the job is malformed
+ */
+extern int dma_job_submit(struct _dma_job* job);
+
+/**
+ * \brief Copy memory asynchronously.
+ * \param job Job instance, owned by the caller until completion
+ * \param dest Destination address
+ * \param src Source address
+ * \param len Number of bytes to copy
+ * \param cb Optional completion callback
+ * \return 0 on success, or an error code
+ */
+extern int dma_memcpy_async(struct _dma_job* job, void* dest, const void* src,
+			    uint32_t len, struct _callback* cb);
+
+/**
+ * \brief Fill memory asynchronously.
+ * \param job Job instance, owned by the caller until completion
+ * \param dest Destination address
+ * \param value Byte value to fill with
+ * \param len Number of bytes to fill
+ * \param cb Optional completion callback
+ * \return 0 on success, or an error code
+ */
+extern int dma_memset_async(struct _dma_job* job, void* dest, uint8_t value,
+			    uint32_t len, struct _callback* cb);
+
+/**
+ * \brief Fill memory with a 32-bit pattern asynchronously.
+ * \param job Job instance, owned by the caller until completion
+ * \param dest Destination address, word aligned
+ * \param pattern Word value to fill with
+ * \param len Number of bytes to fill, multiple of 4
+ * \param cb Optional completion callback
+ * \return 0 on success, -EINVAL if dest or len is not word aligned, or an
+ * error code
+ */
+extern int dma_memset32_async(struct _dma_job* job, void* dest,
+			      uint32_t pattern, uint32_t len,
+			      struct _callback* cb);
+
+/**
+ * \brief Run a list of memory copies asynchronously. The len field of each
+ * item is in bytes.
+ * \param job Job instance, owned by the caller until completion
+ * \param list List of copies, owned by the caller until completion
+ * \param list_size Number of copies, up to DMA_JOB_MAX_ITEMS
+ * \param cb Optional completion callback
+ * \return 0 on success, or an error code
+ */
+extern int dma_sg_async(struct _dma_job* job, struct _dma_transfer_cfg* list,
+			uint8_t list_size, struct _callback* cb);
+
+/**
+ * \brief Check whether a job is complete.
+ */
+extern bool dma_job_is_done(struct _dma_job* job);
+
+/**
+ * \brief Wait for the completion of a job.
+ * \return Completion status of the job
+ */
+extern int dma_job_wait(struct _dma_job* job);
+
+/**
+ * \brief Get the statistics of a channel of the pool.
+ * \param index Index of the channel in the pool
+ * \param stats Filled with the statistics
+ * \return 0 on success, -EINVAL if index is out of range
+ */
+extern int dma_job_get_stats(uint8_t index, struct _dma_job_stats* stats);
+
+/**
+ * \brief Get the statistics of the jobs done by the CPU (busy_cycles is not
+ * measured).
+ */
+extern void dma_job_get_cpu_stats(struct _dma_job_stats* stats);
+
+/**
+ * \brief Reset the statistics of all channels.
+ */
+extern void dma_job_reset_stats(void);
+
+#endif /* _DMA_JOB_H_ */
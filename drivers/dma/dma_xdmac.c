@@ -180,7 +180,12 @@ void dma_irq_handler(uint32_t source, void* user_arg)
 		if (channel->state == DMA_STATE_FREE)
 			continue;
 
-		if (!(gcs & (1 << chan))) {
+		if (channel->loop) {
+			/* Looped list: the channel keeps running, report
+			 * each completed item without changing state */
+			if (xdmac_get_channel_isr(xdmac, chan) & XDMAC_CIS_BIS)
+				exec = 1;
+		} else if (!(gcs & (1 << chan))) {
 			uint32_t cis = xdmac_get_channel_isr(xdmac, chan);
 
 			if (cis & XDMAC_CIS_BIS) {
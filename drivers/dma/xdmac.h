@@ -509,6 +509,14 @@ extern void xdmac_set_src_microblock_stride(Xdmac *xdmac, uint8_t channel, uint3
  */
 extern void xdmac_set_dest_microblock_stride(Xdmac *xdmac, uint8_t channel, uint32_t dubs);
 
+/**
+ * \brief Get the relevant channel's source address of given XDMA.
+ *
+ * \param xdmac Pointer to the XDMAC instance.
+ * \param channel Particular channel number.
+ */
+extern uint32_t xdmac_get_channel_src_addr(Xdmac *xdmac, uint8_t channel);
+
 /**
  * \brief Get the relevant channel's destination address of given XDMA.
  *
@@ -40,8 +40,20 @@
 #if defined(CONFIG_HAVE_NVIC)
 #include "irq/nvic.h"
 #endif
+#include "irqflags.h"
+
+#ifdef CONFIG_IRQ_FLAT_TABLE
+#include "mm/cache.h"
+#endif
+
+#ifdef CONFIG_IRQ_STATS
+#include "cycles.h"
+#include "peripherals/pmc.h"
+#include <stdio.h>
+#endif
 
 #include <assert.h>
+#include <string.h>
 
 /*------------------------------------------------------------------------------
  *         Local types
@@ -53,13 +65,39 @@ struct handler_entry {
 	struct handler_entry* next;
 };
 
+#ifdef CONFIG_IRQ_FLAT_TABLE
+/* Dispatch slot: the first handler of a source is called directly from the
+ * slot, additional handlers of a shared source are chained behind it. */
+struct _irq_vector {
+	irq_handler_t handler;
+	void* user_arg;
+	struct handler_entry* shared;
+} ALIGNED(16);
+#endif
+
 /*------------------------------------------------------------------------------
  *         Local variables
  *------------------------------------------------------------------------------*/
 
 static struct handler_entry  handlers_pool[ID_PERIPH_COUNT * 2];
 static struct handler_entry* next_free_handler;
+
+#ifdef CONFIG_IRQ_FLAT_TABLE
+static CACHE_ALIGNED struct _irq_vector vectors[ID_PERIPH_COUNT];
+#else
 static struct handler_entry* handlers[ID_PERIPH_COUNT];
+#endif
+
+#ifdef CONFIG_IRQ_STATS
+/** Per-source statistics, also readable from a debugger */
+struct _irq_stats irq_stats[ID_PERIPH_COUNT];
+
+/** Global statistics, also readable from a debugger */
+struct _irq_global_stats irq_global_stats;
+
+/** Counter ticks spent in nested handlers during the current handler */
+static uint32_t irq_preempted;
+#endif
 
 /*------------------------------------------------------------------------------
  *         Local functions
@@ -76,6 +114,10 @@ static void _initialize_handlers_pool(void)
 	handlers_pool[i - 1].next = NULL;
 
 	next_free_handler = &handlers_pool[0];
+
+#ifdef CONFIG_IRQ_FLAT_TABLE
+	memset(vectors, 0, sizeof(vectors));
+#endif
 }
 
 static struct handler_entry* _alloc_handler(void)
@@ -99,10 +141,70 @@ static void _free_handler(struct handler_entry* entry)
 	next_free_handler = entry;
 }
 
+#ifdef CONFIG_IRQ_STATS
+
+static inline uint32_t _irq_timestamp(void)
+{
+#ifdef ARCH_HAVE_CYCLE_COUNTER
+	return arch_cycles_read();
+#else
+	return 0;
+#endif
+}
+
+static void _irq_stats_clear(void)
+{
+	int i;
+
+	memset(irq_stats, 0, sizeof(irq_stats));
+	for (i = 0; i < ID_PERIPH_COUNT; i++)
+		irq_stats[i].min_cycles = UINT32_MAX;
+	irq_global_stats.unhandled = 0;
+	irq_global_stats.max_depth = irq_global_stats.depth;
+}
+
+#endif /* CONFIG_IRQ_STATS */
+
+/**
+ * \brief Call the handlers registered for a source.
+ * \return false if the source has no handler
+ */
+static inline bool _irq_dispatch(uint32_t source)
+{
+	struct handler_entry *entry;
+
+#ifdef CONFIG_IRQ_FLAT_TABLE
+	const struct _irq_vector* vector = &vectors[source];
+
+	if (!vector->handler)
+		return false;
+
+	vector->handler(source, vector->user_arg);
+	for (entry = vector->shared; entry; entry = entry->next)
+		entry->handler(source, entry->user_arg);
+#else
+	entry = handlers[source];
+	if (!entry)
+		return false;
+
+	while (entry) {
+		if (entry->handler)
+			entry->handler(source, entry->user_arg);
+		entry = entry->next;
+	}
+#endif
+	return true;
+}
+
 static void _default_irq_handler(void)
 {
 	uint32_t source;
-	struct handler_entry *entry;
+	bool handled;
+#ifdef CONFIG_IRQ_STATS
+	struct _irq_stats* stats;
+	uint32_t start, elapsed, cycles, preempted;
+	uint8_t depth;
+#endif
 
 #if defined(CONFIG_HAVE_AIC2) || defined(CONFIG_HAVE_AIC5)
 	source = aic_get_current_interrupt_source();
@@ -112,16 +214,44 @@ static void _default_irq_handler(void)
 #error Unknown IRQ controller!
 #endif
 
-	entry = handlers[source];
-	if (!entry) {
-		// no handler for interrupt, block
-		while (1);
-	}
+	if (source >= ID_PERIPH_COUNT)
+		return;
 
-	while (entry) {
-		if (entry->handler)
-			entry->handler(source, entry->user_arg);
-		entry = entry->next;
+#ifdef CONFIG_IRQ_STATS
+	depth = ++irq_global_stats.depth;
+	if (depth > irq_global_stats.max_depth)
+		irq_global_stats.max_depth = depth;
+	preempted = irq_preempted;
+	irq_preempted = 0;
+	start = _irq_timestamp();
+#endif
+
+	handled = _irq_dispatch(source);
+
+#ifdef CONFIG_IRQ_STATS
+	elapsed = _irq_timestamp() - start;
+	/* time spent in handlers that preempted this one is not ours */
+	cycles = elapsed - irq_preempted;
+	irq_preempted = preempted + elapsed;
+
+	stats = &irq_stats[source];
+	stats->count++;
+	stats->total_cycles += cycles;
+	if (cycles < stats->min_cycles)
+		stats->min_cycles = cycles;
+	if (cycles > stats->max_cycles)
+		stats->max_cycles = cycles;
+	if (depth > stats->max_depth)
+		stats->max_depth = depth;
+	if (!handled)
+		irq_global_stats.unhandled++;
+	irq_global_stats.depth--;
+#endif
+
+	if (!handled) {
+		/* no handler for interrupt: mask the source instead of
+		 * blocking or being interrupted again immediately */
+		irq_disable(source);
 	}
 }
 
@@ -133,6 +263,14 @@ void irq_initialize(void)
 {
 	_initialize_handlers_pool();
 
+#ifdef CONFIG_IRQ_STATS
+#ifdef ARCH_HAVE_CYCLE_COUNTER
+	arch_cycles_enable();
+#endif
+	irq_global_stats.depth = 0;
+	_irq_stats_clear();
+#endif
+
 #if defined(CONFIG_HAVE_AIC2) || defined(CONFIG_HAVE_AIC5)
 	aic_initialize(_default_irq_handler);
 #elif defined(CONFIG_HAVE_NVIC)
@@ -168,6 +306,33 @@ void irq_add_handler(uint32_t source, irq_handler_t handler, void* user_arg)
 {
 	struct handler_entry* entry;
 
+#ifdef CONFIG_IRQ_FLAT_TABLE
+	struct _irq_vector* vector = &vectors[source];
+
+	/* check if handler is already registered */
+	if (vector->handler == handler) {
+		vector->user_arg = user_arg;
+		return;
+	}
+	for (entry = vector->shared; entry; entry = entry->next) {
+		if (entry->handler == handler) {
+			entry->user_arg = user_arg;
+			return;
+		}
+	}
+
+	/* first handler goes in the slot, others are chained */
+	if (!vector->handler) {
+		vector->user_arg = user_arg;
+		vector->handler = handler;
+		return;
+	}
+	entry = _alloc_handler();
+	entry->handler = handler;
+	entry->user_arg = user_arg;
+	entry->next = vector->shared;
+	vector->shared = entry;
+#else
 	/* check if handler is already registered */
 	entry = handlers[source];
 	while (entry) {
@@ -184,6 +349,7 @@ void irq_add_handler(uint32_t source, irq_handler_t handler, void* user_arg)
 	entry->user_arg = user_arg;
 	entry->next = handlers[source];
 	handlers[source] = entry;
+#endif
 }
 
 void irq_remove_handler(uint32_t source, irq_handler_t handler)
@@ -191,6 +357,44 @@ void irq_remove_handler(uint32_t source, irq_handler_t handler)
 	struct handler_entry* prev;
 	struct handler_entry* cur;
 
+#ifdef CONFIG_IRQ_FLAT_TABLE
+	struct _irq_vector* vector = &vectors[source];
+	uint32_t flags;
+
+	/* _irq_dispatch() may be walking the chain of the source */
+	flags = arch_irq_save();
+	if (vector->handler == handler) {
+		/* promote the first chained handler to the slot */
+		cur = vector->shared;
+		if (cur) {
+			vector->handler = cur->handler;
+			vector->user_arg = cur->user_arg;
+			vector->shared = cur->next;
+			_free_handler(cur);
+		} else {
+			vector->handler = NULL;
+			vector->user_arg = NULL;
+		}
+		arch_irq_restore(flags);
+		return;
+	}
+
+	prev = NULL;
+	cur = vector->shared;
+	while (cur) {
+		if (cur->handler == handler) {
+			if (prev)
+				prev->next = cur->next;
+			else
+				vector->shared = cur->next;
+			_free_handler(cur);
+			break;
+		}
+		prev = cur;
+		cur = cur->next;
+	}
+	arch_irq_restore(flags);
+#else
 	/* remove handler from linked list */
 	prev = NULL;
 	cur = handlers[source];
@@ -198,11 +402,15 @@ void irq_remove_handler(uint32_t source, irq_handler_t handler)
 		if (cur->handler == handler) {
 			if (prev)
 				prev->next = cur->next;
+			else
+				handlers[source] = cur->next;
 			_free_handler(cur);
 			return;
 		}
+		prev = cur;
 		cur = cur->next;
 	}
+#endif
 }
 
 void irq_enable(uint32_t source)
@@ -226,3 +434,71 @@ void irq_disable(uint32_t source)
 #error Unknown IRQ controller!
 #endif
 }
+
+#ifdef CONFIG_IRQ_STATS
+
+void irq_stats_reset(void)
+{
+	uint32_t flags;
+
+	flags = arch_irq_save();
+	_irq_stats_clear();
+	arch_irq_restore(flags);
+}
+
+void irq_get_stats(uint32_t source, struct _irq_stats* stats)
+{
+	uint32_t flags;
+
+	assert(source < ID_PERIPH_COUNT);
+
+	flags = arch_irq_save();
+	*stats = irq_stats[source];
+	arch_irq_restore(flags);
+}
+
+void irq_get_global_stats(struct _irq_global_stats* stats)
+{
+	uint32_t flags;
+
+	flags = arch_irq_save();
+	*stats = irq_global_stats;
+	arch_irq_restore(flags);
+}
+
+uint32_t irq_stats_get_counter_freq(void)
+{
+#ifdef ARCH_HAVE_CYCLE_COUNTER
+	return pmc_get_processor_clock();
+#else
+	return 0;
+#endif
+}
+
+void irq_stats_print(void)
+{
+	struct _irq_global_stats global;
+	struct _irq_stats stats;
+	uint32_t freq = irq_stats_get_counter_freq() / 1000000;
+	uint32_t source;
+
+	irq_get_global_stats(&global);
+	printf("IRQ    count        min        max        avg   avg(us) depth\r\n");
+	for (source = 0; source < ID_PERIPH_COUNT; source++) {
+		uint32_t avg;
+
+		irq_get_stats(source, &stats);
+		if (!stats.count)
+			continue;
+		avg = (uint32_t)(stats.total_cycles / stats.count);
+		printf("%3u %8u %10u %10u %10u %9u %5u\r\n",
+		       (unsigned)source, (unsigned)stats.count,
+		       (unsigned)stats.min_cycles, (unsigned)stats.max_cycles,
+		       (unsigned)avg, freq ? (unsigned)(avg / freq) : 0u,
+		       (unsigned)stats.max_depth);
+	}
+	printf("unhandled: %u, max nesting depth: %u\r\n",
+	       (unsigned)global.unhandled, (unsigned)global.max_depth);
+}
+
+#endif /* CONFIG_IRQ_STATS */
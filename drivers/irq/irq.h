@@ -45,6 +45,26 @@ enum _irq_mode {
 	IRQ_MODE_NEGATIVE_EDGE,
 };
 
+#ifdef CONFIG_IRQ_STATS
+
+/** Per-source interrupt statistics (CONFIG_IRQ_STATS) */
+struct _irq_stats {
+	uint32_t count;        /**< Number of invocations */
+	uint32_t min_cycles;   /**< Shortest handler run, in counter ticks */
+	uint32_t max_cycles;   /**< Longest handler run, in counter ticks */
+	uint64_t total_cycles; /**< Sum of handler runs, in counter ticks */
+	uint8_t  max_depth;    /**< Deepest nesting level the source ran at */
+};
+
+/** Global interrupt statistics (CONFIG_IRQ_STATS) */
+struct _irq_global_stats {
+	uint32_t unhandled;    /**< Interrupts from sources without handler */
+	uint8_t  depth;        /**< Current nesting depth */
+	uint8_t  max_depth;    /**< Deepest nesting depth seen */
+};
+
+#endif /* CONFIG_IRQ_STATS */
+
 /*------------------------------------------------------------------------------
  *         Global functions
  *------------------------------------------------------------------------------*/
@@ -60,6 +80,11 @@ extern "C" {
  * and set the default handlers.
  *
  * It will also initialize the data structure used to handle shared IRQs.
+ * With CONFIG_IRQ_FLAT_TABLE, handlers are dispatched from a cache-aligned
+ * table indexed by source, the extra handlers of shared sources being chained
+ * behind the table entry.
+ *
+ * Interrupts from sources without handler are masked.
  */
 extern void irq_initialize(void);
 
@@ -92,7 +117,7 @@ extern void irq_configure_priority(uint32_t source, uint8_t priority);
 extern void irq_add_handler(uint32_t source, irq_handler_t handler, void* user_arg);
 
 /**
- * \brief Add a handler for a given interrupt source (ID_xxx).
+ * \brief Remove a handler for a given interrupt source (ID_xxx).
  *
  * If the handler is not configured for the interrupt source, this function
  * does nothing.
@@ -116,6 +141,43 @@ extern void irq_enable(uint32_t source);
  */
 extern void irq_disable(uint32_t source);
 
+#ifdef CONFIG_IRQ_STATS
+
+/**
+ * \brief Clear the interrupt statistics of all sources.
+ */
+extern void irq_stats_reset(void);
+
+/**
+ * \brief Get a snapshot of the statistics of a source (ID_xxx).
+ *
+ * Handler durations are measured with the CPU cycle counter and exclude the
+ * time spent in nested interrupts. On cores without cycle counter, only the
+ * counts and nesting depth are recorded.
+ *
+ * \param source  Interrupt source
+ * \param stats   Filled with the statistics of the source
+ */
+extern void irq_get_stats(uint32_t source, struct _irq_stats* stats);
+
+/**
+ * \brief Get a snapshot of the global interrupt statistics.
+ */
+extern void irq_get_global_stats(struct _irq_global_stats* stats);
+
+/**
+ * \brief Return the frequency of the counter used for handler durations, in
+ * Hz, or 0 if handler durations are not measured.
+ */
+extern uint32_t irq_stats_get_counter_freq(void);
+
+/**
+ * \brief Print the statistics of all sources that fired on the console.
+ */
+extern void irq_stats_print(void);
+
+#endif /* CONFIG_IRQ_STATS */
+
 #ifdef __cplusplus
 }
 #endif
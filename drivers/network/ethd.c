@@ -58,6 +58,21 @@
  *        Local functions
  *----------------------------------------------------------------------------*/
 
+static uint8_t _ethd_queue_frame(struct _ethd* ethd, uint8_t queue,
+		const struct _eth_sg_list* sgl, ethd_callback_t callback, bool copy);
+
+/**
+ * \brief Release RX descriptors to the hardware, from rx_head up to (but
+ * excluding) idx.
+ */
+static void _ethd_rx_release(struct _ethd_queue* q, uint32_t idx)
+{
+	while (q->rx_head != idx) {
+		q->rx_desc[q->rx_head].addr &= ~ETH_RX_ADDR_OWN;
+		RING_INC(q->rx_head, q->rx_size);
+	}
+}
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -104,6 +119,22 @@ uint8_t ethd_setup_queue(struct _ethd* ethd, uint8_t queue,
 }
 
 uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_list* sgl, ethd_callback_t callback)
+{
+	return _ethd_queue_frame(ethd, queue, sgl, callback, true);
+}
+
+uint8_t ethd_send_sg_nocopy(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_list* sgl, ethd_callback_t callback)
+{
+	return _ethd_queue_frame(ethd, queue, sgl, callback, false);
+}
+
+/**
+ * \brief Queue the buffers of a frame into the TX descriptor ring.
+ * When copy is true, buffers are copied into the TX buffers of the queue,
+ * otherwise the descriptors are pointed directly at the provided buffers.
+ */
+static uint8_t _ethd_queue_frame(struct _ethd* ethd, uint8_t queue,
+		const struct _eth_sg_list* sgl, ethd_callback_t callback, bool copy)
 {
 	void* eth = ethd->addr;
 	struct _ethd_queue* q = &ethd->queues[queue];
@@ -124,6 +155,17 @@ uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_lis
 		trace_error("ethd_send_sg: ethernet frame has too many buffers.\r\n");
 		return ETH_PARAM;
 	}
+	for (i = 0; i < sgl->size; i++) {
+		const struct _eth_sg *sg = &sgl->entries[i];
+		if (sg->size > (copy ? ETH_TX_UNITSIZE : ETH_RX_STATUS_LENGTH_MASK)) {
+			trace_error("ethd_send_sg: buffer size is too big.\r\n");
+			return ETH_PARAM;
+		}
+		if (!copy && !IS_CACHE_ALIGNED(sg->buffer)) {
+			trace_error("ethd_send_sg: buffer is not cache aligned.\r\n");
+			return ETH_PARAM;
+		}
+	}
 
 	/* Check available space */
 	if (RING_SPACE(q->tx_head, q->tx_tail, q->tx_size) < sgl->size) {
@@ -146,11 +188,6 @@ uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_lis
 		const struct _eth_sg *sg = &sgl->entries[i];
 		uint32_t status;
 
-		if (sg->size > ETH_TX_UNITSIZE) {
-			trace_error("ethd_send_sg: buffer size is too big.\r\n");
-			return ETH_PARAM;
-		}
-
 		RING_DEC(idx, q->tx_size);
 
 		/* Reset TX callback */
@@ -159,10 +196,21 @@ uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_lis
 
 		desc = &q->tx_desc[idx];
 
-		/* Copy data into transmittion buffer */
-		if (sg->buffer && sg->size) {
-			memcpy((void*)desc->addr, sg->buffer, sg->size);
-			cache_clean_region((void*)desc->addr, sg->size);
+		if (copy) {
+			/* Restore the queue buffer, a previous frame sent
+			 * without copy may have replaced it */
+			desc->addr = (uint32_t)q->tx_buffer + idx * ETH_TX_UNITSIZE;
+
+			/* Copy data into transmittion buffer */
+			if (sg->buffer && sg->size) {
+				memcpy((void*)desc->addr, sg->buffer, sg->size);
+				cache_clean_region((void*)desc->addr, sg->size);
+			}
+		} else {
+			/* Transmit directly from the caller buffer */
+			desc->addr = (uint32_t)sg->buffer;
+			if (sg->size)
+				cache_clean_region(sg->buffer, sg->size);
 		}
 
 		/* Compute buffer descriptor status word */
@@ -312,6 +360,87 @@ uint8_t ethd_poll(struct _ethd* ethd, uint8_t queue, uint8_t* buffer, uint32_t b
 	return ETH_RX_NULL;
 }
 
+uint8_t ethd_poll_sg(struct _ethd* ethd, uint8_t queue, struct _eth_sg_list* sgl, uint32_t* recv_size)
+{
+	struct _ethd_queue* q = &ethd->queues[queue];
+	struct _eth_desc *desc;
+	uint32_t idx, count, length, i;
+
+	if (!sgl || !sgl->size)
+		return ETH_PARAM;
+
+	/* Set the default return value */
+	*recv_size = 0;
+
+	/* Skip fragments received without SOF */
+	desc = &q->rx_desc[q->rx_head];
+	while ((desc->addr & ETH_RX_ADDR_OWN) &&
+	       (desc->status & ETH_RX_STATUS_SOF) == 0) {
+		desc->addr &= ~ETH_RX_ADDR_OWN;
+		RING_INC(q->rx_head, q->rx_size);
+		desc = &q->rx_desc[q->rx_head];
+	}
+
+	/* Look for the end of the frame starting at rx_head */
+	idx = q->rx_head;
+	count = 0;
+	for (;;) {
+		desc = &q->rx_desc[idx];
+		if ((desc->addr & ETH_RX_ADDR_OWN) == 0)
+			return ETH_RX_NULL;
+
+		/* A new frame started before EOF, drop previous fragments */
+		if (count && (desc->status & ETH_RX_STATUS_SOF)) {
+			_ethd_rx_release(q, idx);
+			count = 0;
+		}
+
+		count++;
+		if (desc->status & ETH_RX_STATUS_EOF)
+			break;
+
+		RING_INC(idx, q->rx_size);
+		if (idx == q->rx_head) {
+			trace_info("no EOF (buffers probably too small)\r\n");
+			do {
+				q->rx_desc[q->rx_head].addr &= ~ETH_RX_ADDR_OWN;
+				RING_INC(q->rx_head, q->rx_size);
+			} while (idx != q->rx_head);
+			return ETH_RX_NULL;
+		}
+	}
+
+	/* Not enough spare buffers: leave the frame in the ring */
+	if (count > sgl->size)
+		return ETH_SIZE_TOO_SMALL;
+
+	/* Frame size from the ETH */
+	*recv_size = desc->status & ETH_RX_STATUS_LENGTH_MASK;
+
+	/* Swap the descriptor buffers with the spare ones and give the
+	 * descriptors back to the hardware */
+	length = *recv_size;
+	for (i = 0; i < count; i++) {
+		struct _eth_sg *sg = &sgl->entries[i];
+		void* spare = sg->buffer;
+
+		desc = &q->rx_desc[q->rx_head];
+		sg->buffer = (void*)(desc->addr & ETH_RX_ADDR_MASK);
+		sg->size = length < ETH_RX_UNITSIZE ? length : ETH_RX_UNITSIZE;
+		length -= sg->size;
+		cache_invalidate_region(sg->buffer, ETH_RX_UNITSIZE);
+
+		cache_invalidate_region(spare, ETH_RX_UNITSIZE);
+		desc->addr = ((uint32_t)spare & ETH_RX_ADDR_MASK) |
+			(desc->addr & ETH_RX_ADDR_WRAP);
+		dsb();
+		RING_INC(q->rx_head, q->rx_size);
+	}
+	sgl->size = count;
+
+	return ETH_OK;
+}
+
 void ethd_set_rx_callback(struct _ethd *ethd, uint8_t queue, ethd_callback_t callback)
 {
 	ethd->op->set_rx_callback(ethd, queue, callback);
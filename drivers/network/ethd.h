@@ -94,6 +94,11 @@ enum _eth_speed {
 #define ETH_TX_STATUS_WRAP    (1u << 30)
 #define ETH_TX_STATUS_USED    (1u << 31)
 
+/* Bits contained in the RX status passed to the RX callback */
+#define ETH_RX_RSR_BNA (1u << 0)
+#define ETH_RX_RSR_REC (1u << 1)
+#define ETH_RX_RSR_OVR (1u << 2)
+
 /**@}*/
 
 /** \addtogroup eth_buf_size ETH(EMACD/GMACD) Default Buffer Size
@@ -276,6 +281,19 @@ extern uint8_t ethd_setup_queue(struct _ethd* ethd, uint8_t queue,
  */
 extern uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_list* sgl, ethd_callback_t callback);
 
+/**
+ * \brief Send a frame splitted into buffers without copying them into the
+ * TX buffers of the queue: the TX descriptors point directly at the provided
+ * buffers, which must stay untouched until the frame has been sent, as
+ * reported by the TX callback. The buffers are cleaned from the cache before
+ * the transfer so each one must start on a cache line boundary (see
+ * IS_CACHE_ALIGNED()), ETH_PARAM is returned otherwise.
+ *  \param ethd Pointer to ETH Driver instance.
+ *  \param sgl Pointer to a scatter-gather list describing the buffers of the ethernet frame.
+ *  \param callback Pointer to callback function.
+ */
+extern uint8_t ethd_send_sg_nocopy(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_list* sgl, ethd_callback_t callback);
+
 extern void ethd_start(struct _ethd* ethd);
 
 /**
@@ -303,6 +321,22 @@ extern uint32_t ethd_get_tx_load(struct _ethd* ethd, uint8_t queue);
  */
 extern uint8_t ethd_poll(struct _ethd* ethd, uint8_t queue, uint8_t* buffer, uint32_t buffer_size, uint32_t* recv_size);
 
+/**
+ * \brief Receive a frame without copying it.
+ * On entry, the scatter-gather list holds spare buffers of ETH_RX_UNITSIZE
+ * bytes (cache aligned). Each RX buffer of the received frame is swapped with
+ * a spare buffer, so that the descriptors can be given back to the hardware
+ * immediately. On return the list describes the buffers holding the frame and
+ * sgl->size is the number of entries used, unused spare buffers are left
+ * untouched.
+ *  \param ethd Pointer to ETH Driver instance.
+ *  \param sgl              Spare buffers on entry, frame buffers on exit
+ *  \param recv_size        Received size
+ *  \return                 OK, no data, or not enough spare buffers (the
+ *                          frame is then left in the queue)
+ */
+extern uint8_t ethd_poll_sg(struct _ethd* ethd, uint8_t queue, struct _eth_sg_list* sgl, uint32_t* recv_size);
+
 extern void ethd_set_rx_callback(struct _ethd *ethd, uint8_t queue, ethd_callback_t callback);
 
 /**
@@ -517,6 +517,37 @@ void gmac_enable_statistics_write(Gmac* gmac, bool enable)
 		gmac->GMAC_NCR &= ~GMAC_NCR_WESTAT;
 }
 
+#ifdef CONFIG_HAVE_GMAC_QUEUES
+void gmac_set_screening_dstc(Gmac* gmac, uint8_t index, uint8_t dstc, uint8_t queue)
+{
+	gmac->GMAC_ST1RPQ[index] = GMAC_ST1RPQ_QNB(queue) |
+		GMAC_ST1RPQ_DSTCM(dstc) | GMAC_ST1RPQ_DSTCE;
+}
+
+void gmac_set_screening_udp(Gmac* gmac, uint8_t index, uint16_t port, uint8_t queue)
+{
+	gmac->GMAC_ST1RPQ[index] = GMAC_ST1RPQ_QNB(queue) |
+		GMAC_ST1RPQ_UDPM(port) | GMAC_ST1RPQ_UDPE;
+}
+
+void gmac_set_screening_ethertype(Gmac* gmac, uint8_t index, uint16_t ethertype, uint8_t queue)
+{
+	gmac->GMAC_ST2ER[index] = GMAC_ST2ER_COMPVAL(ethertype);
+	gmac->GMAC_ST2RPQ[index] = GMAC_ST2RPQ_QNB(queue) |
+		GMAC_ST2RPQ_I2ETH(index) | GMAC_ST2RPQ_ETHE;
+}
+
+void gmac_clear_screening(Gmac* gmac)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(gmac->GMAC_ST1RPQ); i++)
+		gmac->GMAC_ST1RPQ[i] = 0;
+	for (i = 0; i < ARRAY_SIZE(gmac->GMAC_ST2RPQ); i++)
+		gmac->GMAC_ST2RPQ[i] = 0;
+}
+#endif /* CONFIG_HAVE_GMAC_QUEUES */
+
 void gmac_start_transmission(Gmac * gmac)
 {
 	gmac->GMAC_NCR |= GMAC_NCR_TSTART;
@@ -301,6 +301,33 @@ extern void gmac_start_transmission(Gmac* gmac);
  */
 extern void gmac_halt_transmission(Gmac* gmac);
 
+#ifdef CONFIG_HAVE_GMAC_QUEUES
+
+/**
+ *  \brief Route received IP frames whose DS/TC field (full TOS byte) matches
+ *  dstc to a priority queue, using screening type 1 register index.
+ */
+extern void gmac_set_screening_dstc(Gmac* gmac, uint8_t index, uint8_t dstc, uint8_t queue);
+
+/**
+ *  \brief Route received UDP frames with destination port to a priority
+ *  queue, using screening type 1 register index.
+ */
+extern void gmac_set_screening_udp(Gmac* gmac, uint8_t index, uint16_t port, uint8_t queue);
+
+/**
+ *  \brief Route received frames with ethertype to a priority queue, using
+ *  screening type 2 register and ethertype register index.
+ */
+extern void gmac_set_screening_ethertype(Gmac* gmac, uint8_t index, uint16_t ethertype, uint8_t queue);
+
+/**
+ *  \brief Disable all screening registers, all frames go to queue 0.
+ */
+extern void gmac_clear_screening(Gmac* gmac);
+
+#endif /* CONFIG_HAVE_GMAC_QUEUES */
+
 #ifdef __cplusplus
 }
 #endif
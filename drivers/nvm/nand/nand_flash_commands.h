@@ -44,6 +44,8 @@
 
 #define NAND_CMD_READ_1             0x00
 #define NAND_CMD_READ_2             0x30
+#define NAND_CMD_READ_CACHE         0x31
+#define NAND_CMD_READ_CACHE_END     0x3F
 #define NAND_CMD_READ_A             0x00
 #define NAND_CMD_READ_C             0x50
 #define NAND_CMD_COPYBACK_READ_1    0x00
@@ -146,6 +146,9 @@
 /** Invalid argument. */
 #define NAND_ERROR_INVALID_ARG        18
 
+/** Transfer stopped by the caller. */
+#define NAND_ERROR_ABORTED            19
+
 
 /**@}*/
 /**@}*/
@@ -53,6 +53,10 @@ static struct _dma_channel *nand_dma_tx_channel;
 /** DMA transfer completion notifier */
 static volatile bool transfer_complete = false;
 
+/** Destination of the current RX transfer */
+static uint32_t rx_address;
+static uint32_t rx_size;
+
 /*-------------------------------------------------------------------------
  *        Local functions
  *------------------------------------------------------------------------*/
@@ -137,14 +141,15 @@ uint8_t nand_dma_write(uint32_t src_address, uint32_t dest_address,
 }
 
 /**
- * \brief Configure the DMA Channels for RX.
+ * \brief Start a DMA transfer from the NAND, without waiting for its
+ * completion. nand_dma_wait_read() must be called before using the data.
  * \param src_address Source address to be transferred.
  * \param dest_address Destination address to be transferred.
  * \param size Transfer size in byte.
  * \returns 0 if the DMA channel configuration and transfer successfully;
  * otherwise returns NandCommon_ERROR_XXX.
  */
-uint8_t nand_dma_read(uint32_t src_address, uint32_t dest_address,
+uint8_t nand_dma_start_read(uint32_t src_address, uint32_t dest_address,
 		uint32_t size)
 {
 	struct _dma_cfg cfg_dma;
@@ -163,16 +168,43 @@ uint8_t nand_dma_read(uint32_t src_address, uint32_t dest_address,
 
 	dma_configure_transfer(nand_dma_rx_channel, &cfg_dma, &cfg, 1);
 
+	rx_address = dest_address;
+	rx_size = size;
+
 	/* Start transfer */
 	transfer_complete = false;
 	dma_start_transfer(nand_dma_rx_channel);
+	return 0;
+}
+
+/**
+ * \brief Wait for the completion of the transfer started by
+ * nand_dma_start_read().
+ */
+void nand_dma_wait_read(void)
+{
 	/* Wait for completion */
 	while (!transfer_complete) {
 		/* always call dma_poll, it will do nothing if polling mode
 		 * is disabled */
 		dma_poll();
 	}
-	cache_invalidate_region((uint32_t *)dest_address, size);
+	cache_invalidate_region((uint32_t *)rx_address, rx_size);
+}
+
+/**
+ * \brief Configure the DMA Channels for RX.
+ * \param src_address Source address to be transferred.
+ * \param dest_address Destination address to be transferred.
+ * \param size Transfer size in byte.
+ * \returns 0 if the DMA channel configuration and transfer successfully;
+ * otherwise returns NandCommon_ERROR_XXX.
+ */
+uint8_t nand_dma_read(uint32_t src_address, uint32_t dest_address,
+		uint32_t size)
+{
+	nand_dma_start_read(src_address, dest_address, size);
+	nand_dma_wait_read();
 	return 0;
 }
 
@@ -42,6 +42,7 @@
 #include "nand_flash.h"
 #include "nand_flash_common.h"
 #include "nand_flash_ecc.h"
+#include "nand_flash_onfi.h"
 
 #include "trace.h"
 
@@ -112,6 +113,97 @@ static uint8_t ecc_read_page_with_pmecc(const struct _nand_flash *nand,
 	return 0;
 }
 
+/**
+ * \brief Save the PMECC state of a page that has just been transferred, so that
+ * its correction can be deferred until the next page is being read.
+ * \param nand  Pointer to an EccNandFlash instance.
+ * \param req  Request being processed.
+ * \param page  Number of the page.
+ * \param data  Buffer holding the page data followed by its ECC bytes.
+ */
+static void ecc_save_page(const struct _nand_flash *nand,
+		struct _nand_ecc_read_req *req, uint16_t page, uint8_t *data)
+{
+	uint32_t status = pmecc_error_status();
+
+	req->pending.page = page;
+	req->pending.data = data;
+	req->pending.rem.status = 0;
+
+	if (status) {
+		/* Errors on a page whose ECC bytes are all 0xff means the page
+		 * is erased: they must not be corrected. The bytes must be
+		 * checked now, the next page may be transferred over them. */
+		uint32_t data_size = nand_model_get_page_data_size(&nand->model);
+		uint32_t i;
+
+		for (i = pmecc_get_ecc_start_address();
+		     i < pmecc_get_ecc_end_address(); i++) {
+			if (data[data_size + i] != 0xff)
+				break;
+		}
+		if (i != pmecc_get_ecc_end_address())
+			pmecc_save_remainders(status, &req->pending.rem);
+	}
+}
+
+/**
+ * \brief Correct the pending page and notify the caller.
+ * \param req  Request being processed.
+ * \return 0 if the page is valid, NAND_ERROR_CORRUPTEDDATA if it could not
+ * be corrected, or NAND_ERROR_ABORTED if the callback requested to stop.
+ */
+static uint8_t ecc_finish_page(struct _nand_ecc_read_req *req)
+{
+	struct _nand_ecc_page_status page_status;
+	uint8_t error = 0;
+
+	if (req->pending.rem.status &&
+	    pmecc_correction_saved(&req->pending.rem,
+				   (uint32_t)req->pending.data)) {
+		trace_error("nand_ecc_read_pages: at B%d.P%d Unrecoverable data\r\n",
+				req->block, req->pending.page);
+		error = NAND_ERROR_CORRUPTEDDATA;
+	}
+
+	page_status.block = req->block;
+	page_status.page = req->pending.page;
+	page_status.data = req->pending.data;
+	page_status.error = error;
+	if (callback_call(&req->callback, &page_status) > 0 && !error)
+		error = NAND_ERROR_ABORTED;
+
+	return error;
+}
+
+/**
+ * \brief Reads consecutive pages without pipelining, for configurations not
+ * supported by nand_ecc_read_pages().
+ */
+static uint8_t ecc_read_pages_serial(const struct _nand_flash *nand,
+		struct _nand_ecc_read_req *req)
+{
+	struct _nand_ecc_page_status page_status;
+	uint16_t i;
+
+	for (i = 0; i < req->count; i++) {
+		uint8_t *data = req->buffer[i & 1] + (i >> 1) * req->stride;
+		uint8_t error = nand_ecc_read_page(nand, req->block,
+				req->page + i, data, NULL);
+
+		page_status.block = req->block;
+		page_status.page = req->page + i;
+		page_status.data = data;
+		page_status.error = error;
+		if (callback_call(&req->callback, &page_status) > 0 && !error)
+			error = NAND_ERROR_ABORTED;
+		if (error)
+			return error;
+	}
+
+	return 0;
+}
+
 /**
  * \brief Writes the data area of a NANDFLASH page, The PMECC module generates
  * redundancy at encoding time. When a NAND write page operation is performed.
@@ -201,3 +293,180 @@ uint8_t nand_ecc_write_page(const struct _nand_flash *nand,
 
 	return NAND_ERROR_ECC_NOT_COMPATIBLE;
 }
+
+/**
+ * \brief Returns the area of the spare that is free for meta data, i.e. not
+ * used by the bad block marker nor by the ECC.
+ * \param nand  Pointer to an EccNandFlash instance.
+ * \param offset  Offset of the free area in the spare, always set.
+ * \return Size in bytes of the free area, 0 if the spare cannot hold meta data
+ * (spare protected by the PMECC).
+ */
+uint32_t nand_ecc_get_meta_area(const struct _nand_flash *nand,
+		uint32_t *offset)
+{
+	uint32_t spare_size = nand_model_get_page_spare_size(&nand->model);
+
+	if (nand_is_using_pmecc()) {
+		/* no free area: report an empty one at the end of the spare */
+		if (pmecc_auto_spare_en())
+			*offset = spare_size;
+		else
+			*offset = pmecc_get_ecc_end_address();
+	} else {
+		/* Skip the bad block marker of small and large block devices */
+		*offset = 8;
+	}
+
+	return *offset < spare_size ? spare_size - *offset : 0;
+}
+
+/**
+ * \brief Writes the data area of a page with its ECC, and meta data in the
+ * free area of the spare returned by nand_ecc_get_meta_area().
+ * \param nand Pointer to an EccNandFlash instance.
+ * \param block  Number of the block to write in.
+ * \param page  Number of the page to write inside the given block.
+ * \param data  Data area buffer.
+ * \param meta  Meta data buffer.
+ * \param meta_size  Size of the meta data.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_ecc_write_page_meta(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page, void *data,
+		const void *meta, uint32_t meta_size)
+{
+	uint32_t offset;
+
+	NAND_TRACE("nand_ecc_write_page_meta(B#%d:P#%d)\r\n", block, page);
+
+	if (meta_size > nand_ecc_get_meta_area(nand, &offset))
+		return NAND_ERROR_ECC_NOT_COMPATIBLE;
+
+	return nand_raw_write_page_meta(nand, block, page, data,
+			meta, offset, meta_size);
+}
+
+/**
+ * \brief Reads the meta data written by nand_ecc_write_page_meta().
+ * \param nand Pointer to an EccNandFlash instance.
+ * \param block  Number of the block to read from.
+ * \param page  Number of the page to read inside the given block.
+ * \param meta  Meta data buffer.
+ * \param meta_size  Size of the meta data.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_ecc_read_meta(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page, void *meta, uint32_t meta_size)
+{
+	uint32_t offset;
+	uint8_t error;
+
+	if (meta_size > nand_ecc_get_meta_area(nand, &offset))
+		return NAND_ERROR_ECC_NOT_COMPATIBLE;
+
+	error = nand_raw_read_page(nand, block, page, NULL, spare_buf);
+	if (error)
+		return error;
+
+	memcpy(meta, spare_buf + offset, meta_size);
+	return 0;
+}
+
+/**
+ * \brief Reads consecutive pages of a block with PMECC correction, overlapping
+ * the array read and transfer of each page with the correction of the previous
+ * one.
+ *
+ * Pages are read alternately into req->buffer[0] and req->buffer[1], each
+ * buffer pointer being advanced by req->stride bytes after use: a stride of 0
+ * gives a ping-pong between two page buffers, while buffer[1] = buffer[0] +
+ * page size and a stride of twice the page size fill a linear buffer. Each
+ * buffer must hold the page data followed by the spare area up to the end of
+ * the ECC bytes.
+ *
+ * req->callback is invoked with a struct _nand_ecc_page_status once each page
+ * has been corrected, before its buffer is reused. A positive return value
+ * stops the transfer. When the device reports ONFI read cache support, the
+ * next page is loaded into the device cache while the current one is
+ * transferred.
+ *
+ * \param nand  Pointer to an EccNandFlash instance.
+ * \param req  Read request.
+ * \return 0 if all pages have been read and are valid; otherwise returns the
+ * error of the first failing page.
+ */
+uint8_t nand_ecc_read_pages(const struct _nand_flash *nand,
+		struct _nand_ecc_read_req *req)
+{
+	uint32_t size;
+	bool cache, has_pending = false;
+	uint8_t error = 0;
+	uint16_t i;
+
+	assert(req->page + req->count <=
+	       nand_model_get_block_size_in_pages(&nand->model));
+
+	if (req->count == 0)
+		return 0;
+
+#ifdef CONFIG_HAVE_NFC
+	if (nand_is_nfc_sram_enabled())
+		return ecc_read_pages_serial(nand, req);
+#endif
+	if (!nand_is_using_pmecc())
+		return ecc_read_pages_serial(nand, req);
+
+	size = nand_model_get_page_data_size(&nand->model) +
+		pmecc_get_ecc_end_address();
+	cache = req->count > 1 && nand_onfi_has_read_cache();
+
+	nand_raw_read_page_cmd(nand, req->block, req->page);
+
+	for (i = 0; i < req->count; i++) {
+		uint8_t *data = req->buffer[i & 1] + (i >> 1) * req->stride;
+		bool last = i + 1 == req->count;
+
+		/* With read cache, the device loads page i+1 while page i is
+		 * transferred */
+		if (cache)
+			nand_raw_read_cache_cmd(nand, last);
+
+		nand_raw_read_data_start(nand, data, size);
+
+		/* Correct page i-1 while the DMA transfers page i */
+		if (has_pending) {
+			has_pending = false;
+			error = ecc_finish_page(req);
+			if (error) {
+				nand_raw_read_data_wait(nand);
+				if (cache && !last)
+					nand_raw_read_end(nand, true);
+				break;
+			}
+		}
+
+		nand_raw_read_data_wait(nand);
+		ecc_save_page(nand, req, req->page + i, data);
+		has_pending = true;
+
+		/* Without read cache, correct page i while the device reads
+		 * page i+1 */
+		if (!cache && !last) {
+			nand_raw_read_page_cmd(nand, req->block, req->page + i + 1);
+			has_pending = false;
+			error = ecc_finish_page(req);
+			if (error) {
+				nand_raw_read_end(nand, false);
+				break;
+			}
+		}
+	}
+
+	if (has_pending)
+		error = ecc_finish_page(req);
+
+	pmecc_auto_disable();
+	pmecc_disable();
+	return error;
+}
@@ -45,6 +45,10 @@
  * -# nand_ecc_read_page() is used to read a NANDFLASH page with ECC check, the function
  *      will read out data and spare first, then it calculates ECC with data and then compare with
  *      the readout ECC, and feedback the ECC check result to PMECC driver.
+ * -# nand_ecc_write_page_meta() and nand_ecc_read_meta() store a few bytes of meta data
+ *      in the spare area, next to the ECC.
+ * -# nand_ecc_read_pages() reads consecutive pages of a block, correcting each page while
+ *      the next one is read from the device.
 */
 
 #ifndef NAND_FLASH_ECC_H
@@ -56,7 +60,49 @@
 
 #include <stdint.h>
 
+#include "callback.h"
 #include "nand_flash_raw.h"
+#include "nvm/nand/pmecc.h"
+
+/*---------------------------------------------------------------------- */
+/*         Types                                                         */
+/*---------------------------------------------------------------------- */
+
+/** Multi-page read request for nand_ecc_read_pages() */
+struct _nand_ecc_read_req {
+	/** Block to read from */
+	uint16_t block;
+
+	/** First page to read inside the block */
+	uint16_t page;
+
+	/** Number of pages to read */
+	uint16_t count;
+
+	/** Buffers receiving even and odd pages */
+	uint8_t *buffer[2];
+
+	/** Increment applied to a buffer pointer after each use */
+	uint32_t stride;
+
+	/** Called with a struct _nand_ecc_page_status for each page */
+	struct _callback callback;
+
+	/** Page waiting for its correction, private to nand_ecc_read_pages() */
+	struct {
+		uint16_t page;
+		uint8_t *data;
+		struct _pmecc_remainders rem;
+	} pending;
+};
+
+/** Status of a page read by nand_ecc_read_pages() */
+struct _nand_ecc_page_status {
+	uint16_t block;
+	uint16_t page;
+	uint8_t *data;
+	uint8_t error;
+};
 
 /*---------------------------------------------------------------------- */
 /*         Exported functions                                            */
@@ -66,6 +112,19 @@ extern uint8_t nand_ecc_read_page(const struct _nand_flash *nand,
 		uint16_t block, uint16_t page,
 		void *data, void *spare);
 
+extern uint32_t nand_ecc_get_meta_area(const struct _nand_flash *nand,
+		uint32_t *offset);
+
+extern uint8_t nand_ecc_write_page_meta(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page, void *data,
+		const void *meta, uint32_t meta_size);
+
+extern uint8_t nand_ecc_read_meta(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page, void *meta, uint32_t meta_size);
+
+extern uint8_t nand_ecc_read_pages(const struct _nand_flash *nand,
+		struct _nand_ecc_read_req *req);
+
 extern uint8_t nand_ecc_write_page(const struct _nand_flash *nand,
 		uint16_t block, uint16_t page,
 		void *data, void *spare);
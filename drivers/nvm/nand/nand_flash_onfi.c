@@ -134,6 +134,8 @@ static bool nand_onfi_retrieve_param(const struct _nand_flash *nand)
 		onfi_parameter.onfi_compatible = true;
 		/* Bus width */
 		onfi_parameter.bus_width = (onfi_param_table[6] & 0x01) ? 16 : 8;
+		/* Optional commands supported */
+		onfi_parameter.opt_commands = onfi_param_table[8] | (onfi_param_table[9] << 8);
 		/* Manufacturer */
 		memcpy(onfi_parameter.manufacturer, &onfi_param_table[32], 12);
 		onfi_parameter.manufacturer[12] = 0;
@@ -243,6 +245,16 @@ uint8_t nand_onfi_get_ecc_correctability(void)
 	return onfi_parameter.ecc_correctability;
 }
 
+/**
+ * \brief Tell if the device supports the READ CACHE SEQUENTIAL and READ CACHE
+ * END commands.
+ */
+bool nand_onfi_has_read_cache(void)
+{
+	return onfi_parameter.onfi_compatible &&
+		(onfi_parameter.opt_commands & ONFI_OPT_CMD_READ_CACHE);
+}
+
 /**
  * \brief This function check if the NANDFLASH has an embedded ECC controller.
  * \return false if ONFI not compliant or internal ECC not supported, true if Internal ECC enabled.
@@ -46,6 +46,11 @@
 #define NAND_IO_RC_FAIL    1
 #define NAND_IO_RC_TIMEOUT 2
 
+/** ONFI optional commands */
+#define ONFI_OPT_CMD_PAGE_CACHE_PROGRAM (1 << 0)
+#define ONFI_OPT_CMD_READ_CACHE         (1 << 1)
+#define ONFI_OPT_CMD_GET_SET_FEATURES   (1 << 2)
+
 /** Describes memory organization block information in ONFI parameter page */
 struct _onfi_page_param {
 	/** ONFI compatible */
@@ -63,6 +68,9 @@ struct _onfi_page_param {
 	/** Bus width */
 	uint8_t bus_width;
 
+	/** Optional commands supported */
+	uint16_t opt_commands;
+
 	/** Number of data bytes per page. */
 	uint32_t page_size;
 
@@ -110,6 +118,8 @@ extern uint16_t nand_onfi_get_blocks_per_lun(void);
 
 extern uint8_t nand_onfi_get_ecc_correctability(void);
 
+extern bool nand_onfi_has_read_cache(void);
+
 extern bool nand_onfi_get_model(struct _nand_flash_model *model);
 
 #endif /* NAND_FLASH_ONFI_H */
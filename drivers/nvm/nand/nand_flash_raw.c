@@ -76,6 +76,8 @@
 
 CACHE_ALIGNED static uint8_t ecc_table[NAND_MAX_PMECC_BYTE_SIZE];
 
+CACHE_ALIGNED static uint8_t spare_table[NAND_MAX_PAGE_SPARE_SIZE];
+
 /*------------------------------------------------------------------------*/
 /*        Local Functions                                                 */
 /*------------------------------------------------------------------------*/
@@ -373,6 +375,21 @@ static uint8_t _nand_wait_ready(const struct _nand_flash *nand)
 	return _status_ready_pass(nand);
 }
 
+/**
+ * \brief Wait for the end of a busy period started by a READ command.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ */
+static void _wait_array_ready(const struct _nand_flash *nand)
+{
+#ifdef CONFIG_HAVE_NFC
+	if (nand_is_nfc_enabled()) {
+		nfc_wait_rb_busy();
+		return;
+	}
+#endif
+	_nand_wait_ready(nand);
+}
+
 /**
  * \brief Erases the specified block of the device. Returns 0 if the operation was
  * successful; otherwise returns an error code.
@@ -633,16 +650,21 @@ static uint8_t _write_page(const struct _nand_flash *nand,
 }
 
 /**
- * \brief Writes the data and/or the spare area of a page on a NandFlash chip. If one
- * of the buffer pointer is 0, the corresponding area is not written.
+ * \brief Writes the data area of a page on a NandFlash chip, with the ECC
+ * computed by the PMECC. Optional meta bytes are written in the spare area in
+ * the same program operation.
  * \param nand  Pointer to a struct _nand_flash instance.
  * \param block  Number of the block where the page to write resides.
  * \param page  Number of the page to write inside the given block.
  * \param data  Buffer containing the data area.
+ * \param meta  Bytes to write in the spare area, can be 0.
+ * \param meta_offset  Offset of the meta bytes in the spare area.
+ * \param meta_size  Number of meta bytes.
  * \return 0 if the write operation is successful; otherwise returns 1.
 */
 static uint8_t _write_page_with_pmecc(const struct _nand_flash *nand,
-	uint16_t block, uint16_t page, uint8_t *data)
+	uint16_t block, uint16_t page, uint8_t *data,
+	const uint8_t *meta, uint32_t meta_offset, uint32_t meta_size)
 {
 	uint8_t error = 0;
 	uint32_t data_size = nand_model_get_page_data_size(&nand->model);
@@ -706,6 +728,14 @@ static uint8_t _write_page_with_pmecc(const struct _nand_flash *nand,
 			ecc_table[i * ecc_bytes_per_sector + j] = pmecc_value(i, j);
 
 	_data_array_out(nand, false, ecc_table, pmecc_get_ecc_bytes_per_page(), 0);
+
+	if (meta) {
+		memcpy(spare_table, meta, meta_size);
+		_send_cle_ale(nand, CLE_WRITE_EN | ALE_COL_EN,
+		              NAND_CMD_RANDOM_IN, 0, data_size + meta_offset, 0);
+		_data_array_out(nand, false, spare_table, meta_size, 0);
+	}
+
 	_send_cle_ale(nand, CLE_WRITE_EN, NAND_CMD_WRITE_2, 0, 0, 0);
 
 #ifdef CONFIG_HAVE_NFC
@@ -856,6 +886,115 @@ uint8_t nand_raw_read_page(const struct _nand_flash *nand,
 	return NAND_ERROR_ECC_NOT_COMPATIBLE;
 }
 
+/**
+ * \brief Issue a READ PAGE command without waiting for the array read to
+ * complete. The page is then transferred with nand_raw_read_data_start(),
+ * possibly after a READ CACHE command.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param block  Number of the block where the page to read resides.
+ * \param page  Number of the page to read inside the given block.
+ */
+void nand_raw_read_page_cmd(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page)
+{
+	uint32_t row_address;
+
+	NAND_TRACE("nand_raw_read_page_cmd(B#%d:P#%d)\r\n", block, page);
+
+#ifdef CONFIG_HAVE_NFC
+	assert(!nand_is_nfc_sram_enabled());
+	if (nand_is_nfc_enabled()) {
+		uint32_t data_size = nand_model_get_page_data_size(&nand->model);
+		uint32_t spare_size = nand_model_get_page_spare_size(&nand->model);
+		nfc_configure(data_size, spare_size, true, false);
+	}
+#endif
+
+	row_address = block * nand_model_get_block_size_in_pages(&nand->model) + page;
+	_send_cle_ale(nand, ALE_COL_EN | ALE_ROW_EN | CLE_VCMD2_EN,
+	              NAND_CMD_READ_1, NAND_CMD_READ_2, 0, row_address);
+}
+
+/**
+ * \brief Wait for the previous READ PAGE or READ CACHE command to complete
+ * and issue a READ CACHE SEQUENTIAL command, or a READ CACHE END command for
+ * the last page of the sequence. The device then loads the next page while the
+ * current one is transferred.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param last  True to end the sequence after the current page.
+ */
+void nand_raw_read_cache_cmd(const struct _nand_flash *nand, bool last)
+{
+	_wait_array_ready(nand);
+	_send_cle_ale(nand, 0, last ? NAND_CMD_READ_CACHE_END : NAND_CMD_READ_CACHE,
+	              0, 0, 0);
+}
+
+/**
+ * \brief Wait for the page issued by nand_raw_read_page_cmd() or
+ * nand_raw_read_cache_cmd() to be available and start transferring it. When
+ * DMA is enabled, the function returns as soon as the transfer is started,
+ * nand_raw_read_data_wait() must then be called before using the data. The
+ * PMECC, if used, processes the transfer.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param data  Buffer where the page will be stored.
+ * \param size  Number of bytes to transfer.
+ */
+void nand_raw_read_data_start(const struct _nand_flash *nand,
+		uint8_t *data, uint32_t size)
+{
+	_wait_array_ready(nand);
+
+#ifdef CONFIG_HAVE_NFC
+	if (!nand_is_nfc_enabled())
+#endif
+	{
+		/* Return to data output mode after the status reads */
+		_send_cle_ale(nand, 0, NAND_CMD_READ_1, 0, 0, 0);
+	}
+
+	if (nand_is_using_pmecc()) {
+		pmecc_reset();
+		pmecc_enable_read();
+		if (!pmecc_auto_spare_en())
+			pmecc_auto_enable();
+		pmecc_reset();
+		pmecc_start_data_phase();
+	}
+
+	if (nand_is_dma_enabled())
+		nand_dma_start_read(nand->data_addr, (uint32_t)data, size);
+	else
+		_data_array_in(nand, false, data, size);
+}
+
+/**
+ * \brief Terminate a read sequence whose pending page will not be
+ * transferred.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param cache  True if the sequence uses READ CACHE commands.
+ */
+void nand_raw_read_end(const struct _nand_flash *nand, bool cache)
+{
+	if (cache)
+		nand_raw_read_cache_cmd(nand, true);
+	_wait_array_ready(nand);
+}
+
+/**
+ * \brief Wait for the end of the transfer started by
+ * nand_raw_read_data_start(), and for the PMECC to complete.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ */
+void nand_raw_read_data_wait(const struct _nand_flash *nand)
+{
+	if (nand_is_dma_enabled())
+		nand_dma_wait_read();
+
+	if (nand_is_using_pmecc())
+		pmecc_wait_ready();
+}
+
 /**
  * \brief Writes the data and/or the spare area of a page on a NandFlash chip. If one
  * of the buffer pointer is 0, the corresponding area is not written. Retries
@@ -877,7 +1016,41 @@ uint8_t nand_raw_write_page(const struct _nand_flash *nand,
 		return _write_page(nand, block, page, data, spare);
 
 	if (nand_is_using_pmecc())
-		return _write_page_with_pmecc(nand, block, page, data);
+		return _write_page_with_pmecc(nand, block, page, data, NULL, 0, 0);
 
 	return NAND_ERROR_ECC_NOT_COMPATIBLE;
 }
+
+/**
+ * \brief Writes the data area of a page and some meta bytes in its spare area
+ * in a single program operation. When the PMECC is used, the meta bytes are
+ * written after the ECC and are not covered by it.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param block  Number of the block where the page to write resides.
+ * \param page  Number of the page to write inside the given block.
+ * \param data  Buffer containing the data area.
+ * \param meta  Buffer containing the meta bytes.
+ * \param meta_offset  Offset of the meta bytes in the spare area.
+ * \param meta_size  Number of meta bytes.
+ * \return 0 if the write operation is successful; otherwise returns
+ * NAND_ERROR_CANNOTWRITE.
+ */
+uint8_t nand_raw_write_page_meta(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page, void *data,
+		const void *meta, uint32_t meta_offset, uint32_t meta_size)
+{
+	uint32_t spare_size = nand_model_get_page_spare_size(&nand->model);
+
+	NAND_TRACE("nand_raw_write_page_meta(B#%d:P#%d)\r\n", block, page);
+
+	assert(data && meta);
+	assert(meta_offset + meta_size <= spare_size);
+
+	if (nand_is_using_pmecc())
+		return _write_page_with_pmecc(nand, block, page, data,
+				meta, meta_offset, meta_size);
+
+	memset(spare_table, 0xff, spare_size);
+	memcpy(spare_table + meta_offset, meta, meta_size);
+	return _write_page(nand, block, page, data, spare_table);
+}
@@ -44,6 +44,9 @@
  * -# nand_raw_read_id() is used to read a NANDFLASH's id.
  * -# nand_raw_erase_block() is used to erase a certain NANDFLASH device's block.
  * -# nand_raw_read_page() and nand_raw_write_page is used to do read/write operation.
+ * -# nand_raw_read_page_cmd(), nand_raw_read_cache_cmd(), nand_raw_read_data_start() and
+ *      nand_raw_read_data_wait() split a page read in steps so that upper layers can
+ *      overlap the array read and transfer of a page with the processing of the previous one.
  * -# nand_raw_copy_page() is used to issue copy-page command to NANDFLASH device.
  * -# nand_raw_copy_block() calls nand_raw_copy_page to do a NANDFLASH block copy.
 */
@@ -57,6 +60,7 @@
 /*------------------------------------------------------------------------------ */
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "gpio/pio.h"
 
@@ -80,10 +84,27 @@ extern uint8_t nand_raw_read_page(const struct _nand_flash *nand,
 		uint16_t block, uint16_t page,
 		void *data, void *spare);
 
+extern void nand_raw_read_page_cmd(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page);
+
+extern void nand_raw_read_cache_cmd(const struct _nand_flash *nand,
+		bool last);
+
+extern void nand_raw_read_data_start(const struct _nand_flash *nand,
+		uint8_t *data, uint32_t size);
+
+extern void nand_raw_read_data_wait(const struct _nand_flash *nand);
+
+extern void nand_raw_read_end(const struct _nand_flash *nand, bool cache);
+
 extern uint8_t nand_raw_write_page(const struct _nand_flash *nand,
 		uint16_t block, uint16_t page,
 		void *data, void *spare);
 
+extern uint8_t nand_raw_write_page_meta(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page, void *data,
+		const void *meta, uint32_t meta_offset, uint32_t meta_size);
+
 extern uint8_t nand_raw_copy_page(const struct _nand_flash *nand,
 		uint16_t source_block, uint16_t source_page,
 		uint16_t dest_block, uint16_t dest_page);
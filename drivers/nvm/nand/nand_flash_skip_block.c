@@ -50,6 +50,11 @@
 
 CACHE_ALIGNED static uint8_t spare_buf[NAND_MAX_PAGE_SPARE_SIZE];
 
+/** Bounce buffer for the last page of a block, which is transferred with its
+ * ECC bytes */
+CACHE_ALIGNED static uint8_t page_buf[NAND_MAX_PAGE_DATA_SIZE +
+				      NAND_MAX_PAGE_SPARE_SIZE];
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -253,8 +258,8 @@ uint8_t nand_skipblock_read_page(const struct _nand_flash *nand,
 uint8_t nand_skipblock_read_block(const struct _nand_flash *nand,
 	uint16_t block, void *data)
 {
-	uint32_t num_pages_per_block, page_size;
-	uint16_t i;
+	struct _nand_ecc_read_req req;
+	uint32_t page_size, num_pages_per_block;
 	uint8_t error = 0;
 
 	/* Retrieve model information */
@@ -268,14 +273,28 @@ uint8_t nand_skipblock_read_block(const struct _nand_flash *nand,
 		return NAND_ERROR_BADBLOCK;
 	}
 
-	/* Read all the pages of the block */
-	for (i = 0; i < num_pages_per_block; i++) {
-		error = nand_ecc_read_page(nand, block, i, data, 0);
-		if (error) {
-			trace_error("nand_skipblock_read_block: Cannot read page %d of block %d.\r\n", i, block);
-			return error;
-		}
-		data = (void*)((uint8_t*)data + page_size);
+	/* Read all the pages of the block but the last one, back to back in
+	 * data: the ECC bytes transferred after each page land in the area of
+	 * the next page, which is read afterwards */
+	req.block = block;
+	req.page = 0;
+	req.count = num_pages_per_block - 1;
+	req.buffer[0] = (uint8_t*)data;
+	req.buffer[1] = (uint8_t*)data + page_size;
+	req.stride = 2 * page_size;
+	callback_set(&req.callback, NULL, NULL);
+	error = nand_ecc_read_pages(nand, &req);
+	if (!error) {
+		/* The ECC bytes of the last page would overflow data: read
+		 * it through the bounce buffer */
+		error = nand_ecc_read_page(nand, block, req.count, page_buf, NULL);
+		if (!error)
+			memcpy((uint8_t*)data + req.count * page_size, page_buf,
+			       page_size);
+	}
+	if (error) {
+		trace_error("nand_skipblock_read_block: Cannot read block %d.\r\n", block);
+		return error;
 	}
 
 	return 0;
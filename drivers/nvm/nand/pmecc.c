@@ -49,6 +49,9 @@
 /** defines the maximum value of the error correcting capability */
 #define PMECC_NB_ERROR_MAX (ARRAY_SIZE(PMERRLOC->PMERRLOC_EL) + 1)
 
+/** number of 4-bit slices needed to cover a remainder (mm <= 16) */
+#define PMECC_SYN_SLICES 4
+
 /*--------------------------------------------------------------------------- */
 /*         Local types                                                        */
 /*--------------------------------------------------------------------------- */
@@ -92,6 +95,18 @@ struct _pmecc_desc {
 	int16_t lmu[PMECC_NB_ERROR_MAX + 1];
 };
 
+/** Syndrome lookup tables, kept across pmecc_initialize() calls */
+struct _pmecc_syn_tables {
+	/** GF degree the tables were built for (0 if not built) */
+	int32_t mm;
+
+	/** number of odd syndromes the tables were built for */
+	int32_t tt;
+
+	/** odd syndrome 2i+1 contribution of each nibble of the remainder */
+	int16_t odd[PMECC_NB_ERROR_MAX][PMECC_SYN_SLICES][16];
+};
+
 /*--------------------------------------------------------------------------- */
 /*         Local variables                                                    */
 /*--------------------------------------------------------------------------- */
@@ -99,26 +114,95 @@ struct _pmecc_desc {
 /** Pmecc decriptor instance */
 static struct _pmecc_desc pmecc_desc;
 
+/** Syndrome lookup tables for the current GF/correction capability */
+static struct _pmecc_syn_tables pmecc_syn;
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
 
- /**
+/**
  * \brief Build the pseudo syndromes table
- * \param sector Targetted sector.
+ * \param remainder Remainders of the targetted sector.
  */
-static void gen_partial_syndromes(uint32_t sector)
+static void gen_partial_syndromes(const volatile int16_t *remainder)
 {
 	uint32_t i;
-	volatile int16_t *remainder;
-
-	remainder = (volatile int16_t*)&PMECC->PMECC_REM[sector];
 
 	/* Fill odd syndromes */
 	for (i = 0; i < pmecc_desc.tt; i++)
 		pmecc_desc.partial_syn[1 + (2 * i)] = remainder[i];
 }
 
+/**
+ * \brief Multiply two elements of GF(2**mm).
+ */
+static inline int16_t gf_mul(int16_t a, int16_t b)
+{
+	int32_t e;
+
+	if (a == 0 || b == 0)
+		return 0;
+	e = pmecc_desc.index_of[a] + pmecc_desc.index_of[b];
+	if (e >= pmecc_desc.nn)
+		e -= pmecc_desc.nn;
+	return pmecc_desc.alpha_to[e];
+}
+
+/**
+ * \brief Divide two elements of GF(2**mm), b must not be null.
+ */
+static inline int16_t gf_div(int16_t a, int16_t b)
+{
+	int32_t e;
+
+	if (a == 0)
+		return 0;
+	e = pmecc_desc.index_of[a] - pmecc_desc.index_of[b];
+	if (e < 0)
+		e += pmecc_desc.nn;
+	return pmecc_desc.alpha_to[e];
+}
+
+/**
+ * \brief Build the syndrome lookup tables for the current configuration.
+ *
+ * Odd syndrome i is the remainder evaluated at alpha^i, i.e. the sum of
+ * alpha^(i*j) over the bits j set in the remainder.  The tables hold that
+ * sum for every value of each 4-bit slice of the remainder, so that
+ * substitute() needs one lookup per nibble instead of one per bit.  They
+ * only depend on mm and tt and are not rebuilt when the configuration is
+ * unchanged.
+ */
+static void build_syndrome_tables(void)
+{
+	int32_t i, k, n, bit;
+	const int16_t *alpha_to = pmecc_desc.alpha_to;
+
+	if (pmecc_syn.mm == pmecc_desc.mm && pmecc_syn.tt == pmecc_desc.tt)
+		return;
+
+	for (i = 0; i < pmecc_desc.tt; i++) {
+		int32_t syn = 2 * i + 1;
+		for (k = 0; k < PMECC_SYN_SLICES; k++) {
+			int16_t *tab = pmecc_syn.odd[i][k];
+			tab[0] = 0;
+			for (n = 1; n < 16; n++) {
+				/* add the contribution of the lowest bit set */
+				for (bit = 0; !(n & (1 << bit)); bit++);
+				if (4 * k + bit < pmecc_desc.mm)
+					tab[n] = tab[n & (n - 1)] ^
+						alpha_to[syn * (4 * k + bit)];
+				else
+					tab[n] = tab[n & (n - 1)];
+			}
+		}
+	}
+
+	pmecc_syn.mm = pmecc_desc.mm;
+	pmecc_syn.tt = pmecc_desc.tt;
+}
+
 /**
  * \brief The substitute function evaluates the polynomial remainder,
  * with different values of the field primitive elements.
@@ -126,23 +210,21 @@ static void gen_partial_syndromes(uint32_t sector)
 static uint32_t substitute(void)
 {
 	int32_t i, j;
-	int16_t *si;
+	int16_t *si = pmecc_desc.si;
 	int16_t *partial_syn = pmecc_desc.partial_syn;
 	const int16_t *alpha_to = pmecc_desc.alpha_to;
 	const int16_t *index_of = pmecc_desc.index_of;
+	uint16_t mask = (1u << pmecc_desc.mm) - 1;
 
-	/* si[] is a table that holds the current syndrome value, an element of that table belongs to the field.*/
-	memset(pmecc_desc.si, 0, sizeof(pmecc_desc.si));
-	si = pmecc_desc.si;
+	si[0] = 0;
 
 	/* Computation 2t syndromes based on S(x) */
 	/* Odd syndromes */
-	for (i = 1; i <= 2 * pmecc_desc.tt - 1; i = i + 2) {
-		si[i] = 0;
-		for (j = 0; j < pmecc_desc.mm; j++) {
-			if (partial_syn[i] & ((uint16_t)0x1 << j))
-				si[i] = alpha_to[(i * j)] ^ si[i];
-		}
+	for (i = 0; i < pmecc_desc.tt; i++) {
+		const int16_t (*tab)[16] = pmecc_syn.odd[i];
+		uint16_t rem = partial_syn[2 * i + 1] & mask;
+		si[2 * i + 1] = tab[0][rem & 0xf] ^ tab[1][(rem >> 4) & 0xf] ^
+			tab[2][(rem >> 8) & 0xf] ^ tab[3][rem >> 12];
 	}
 	/* Even syndrome = (Odd syndrome) ** 2 */
 	for (i = 2; i <= 2 * pmecc_desc.tt; i = i + 2) {
@@ -150,12 +232,75 @@ static uint32_t substitute(void)
 		if (si[j] == 0) {
 			si[i] = 0;
 		} else {
-			si[i] = alpha_to[(2 * index_of[si[j]]) % pmecc_desc.nn];
+			int32_t e = 2 * index_of[si[j]];
+			if (e >= pmecc_desc.nn)
+				e -= pmecc_desc.nn;
+			si[i] = alpha_to[e];
 		}
 	}
 	return 0;
 }
 
+/**
+ * \brief Check that the syndromes are generated by the error location
+ * polynomial sigma of degree order, i.e. that for every j > order,
+ * S(j) + sigma(1).S(j-1) + ... + sigma(order).S(j-order) = 0.
+ */
+static bool check_sigma(const int16_t *sigma, int32_t order)
+{
+	int32_t j, k;
+	int16_t *si = pmecc_desc.si;
+
+	for (j = order + 1; j <= 2 * pmecc_desc.tt; j++) {
+		int16_t sum = si[j];
+		for (k = 1; k <= order; k++)
+			sum ^= gf_mul(sigma[k], si[j - k]);
+		if (sum)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * \brief Find the error location polynomial in closed form for one or two
+ * errors.
+ *
+ * With S1 != 0, a single error gives sigma(x) = 1 + S1.x and two errors
+ * give sigma(x) = 1 + S1.x + ((S3 + S1^3) / S1).x^2.  The candidate is only
+ * accepted if it generates all 2t syndromes, in which case it is the
+ * shortest such polynomial and matches what get_sigma() would return.
+ * \return true if sigma has been found, false to run the full algorithm.
+ */
+static bool get_sigma_fast(void)
+{
+	int16_t *si = pmecc_desc.si;
+	int16_t *sigma = pmecc_desc.smu[pmecc_desc.tt + 1];
+	int16_t s1_cube;
+
+	if (si[1] == 0)
+		return false;
+
+	memset(sigma, 0, sizeof(pmecc_desc.smu[0]));
+	sigma[0] = 1;
+	sigma[1] = si[1];
+
+	/* One error */
+	if (check_sigma(sigma, 1)) {
+		pmecc_desc.lmu[pmecc_desc.tt + 1] = 2;
+		return true;
+	}
+
+	/* Two errors */
+	s1_cube = gf_mul(si[2], si[1]);
+	sigma[2] = gf_div(si[3] ^ s1_cube, si[1]);
+	if (sigma[2] && check_sigma(sigma, 2)) {
+		pmecc_desc.lmu[pmecc_desc.tt + 1] = 4;
+		return true;
+	}
+
+	return false;
+}
+
 /**
  * \brief The substitute function finding the value of the error
  * location polynomial.
@@ -609,6 +754,7 @@ uint8_t pmecc_initialize(uint8_t sector_size, uint8_t ecc_errors_per_sector,
 
 	/* Real value of ECC bit number correction (2, 4, 8, 12, 24, 32) */
 	pmecc_desc.tt = ecc_errors_per_sector;
+	build_syndrome_tables();
 	pmecc_desc.ecc_size = ROUND_INT_DIV(pmecc_desc.mm * ecc_errors_per_sector, 8) * nb_sectors_per_page;
 
 	if (ecc_offset_in_spare < 2) {
@@ -749,12 +895,14 @@ uint32_t pmecc_get_ecc_end_address(void)
 }
 
 /**
- * \brief Launch error detection functions and correct corrupted bits.
- * \param pmecc_status Value of the PMECC status register.
- * \param page_buffer Base address of the buffer containing the page to be corrected.
+ * \brief Correct the flagged sectors of a page from their remainders.
+ * \param pmecc_status Sectors to correct, one bit per sector.
+ * \param page_buffer Base address of the buffer containing the page.
+ * \param saved Saved remainders, or NULL to use the PMECC registers.
  * \return 0 if all errors have been corrected, 1 if too many errors detected
  */
-uint32_t pmecc_correction(uint32_t pmecc_status, uint32_t page_buffer)
+static uint32_t correct_page(uint32_t pmecc_status, uint32_t page_buffer,
+		const struct _pmecc_remainders *saved)
 {
 	uint32_t sector, sector_count, sector_size;
 	uint32_t sector_base_address;
@@ -769,9 +917,13 @@ uint32_t pmecc_correction(uint32_t pmecc_status, uint32_t page_buffer)
 	for (sector = 0; sector < sector_count; sector++) {
 		if (pmecc_status & 1) {
 			sector_base_address = page_buffer + sector * sector_size;
-			gen_partial_syndromes(sector);
+			if (saved)
+				gen_partial_syndromes(saved->rem[sector]);
+			else
+				gen_partial_syndromes((volatile int16_t*)&PMECC->PMECC_REM[sector]);
 			substitute();
-			get_sigma();
+			if (!get_sigma_fast())
+				get_sigma();
 			error_nbr = error_location(sector_size * 8 + pmecc_desc.tt * pmecc_desc.mm); /* number of bits of the sector + ecc */
 			if (error_nbr == -1)
 				return 1;
@@ -783,3 +935,50 @@ uint32_t pmecc_correction(uint32_t pmecc_status, uint32_t page_buffer)
 
 	return 0;
 }
+
+/**
+ * \brief Launch error detection functions and correct corrupted bits.
+ * \param pmecc_status Value of the PMECC status register.
+ * \param page_buffer Base address of the buffer containing the page to be corrected.
+ * \return 0 if all errors have been corrected, 1 if too many errors detected
+ */
+uint32_t pmecc_correction(uint32_t pmecc_status, uint32_t page_buffer)
+{
+	return correct_page(pmecc_status, page_buffer, NULL);
+}
+
+/**
+ * \brief Save the remainders of the sectors flagged in pmecc_status, so that
+ * the page can be corrected with pmecc_correction_saved() once the PMECC has
+ * been reset to process another page.
+ * \param pmecc_status Value of the PMECC status register.
+ * \param saved Pointer to the structure receiving the PMECC state.
+ */
+void pmecc_save_remainders(uint32_t pmecc_status,
+		struct _pmecc_remainders *saved)
+{
+	uint32_t sector, i;
+
+	saved->status = pmecc_status;
+	for (sector = 0; pmecc_status; sector++, pmecc_status >>= 1) {
+		volatile int16_t *remainder;
+		if (!(pmecc_status & 1))
+			continue;
+		remainder = (volatile int16_t*)&PMECC->PMECC_REM[sector];
+		for (i = 0; i < pmecc_desc.tt; i++)
+			saved->rem[sector][i] = remainder[i];
+	}
+}
+
+/**
+ * \brief Correct corrupted bits of a page from remainders saved with
+ * pmecc_save_remainders().
+ * \param saved Saved PMECC state of the page.
+ * \param page_buffer Base address of the buffer containing the page to be corrected.
+ * \return 0 if all errors have been corrected, 1 if too many errors detected
+ */
+uint32_t pmecc_correction_saved(const struct _pmecc_remainders *saved,
+		uint32_t page_buffer)
+{
+	return correct_page(saved->status, page_buffer, saved);
+}
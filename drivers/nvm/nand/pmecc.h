@@ -46,6 +46,26 @@
 /** Start address of ECC cvalue in spare zone, this must not be 0 since Bad block tag are at 0. */
 #define PMECC_ECC_DEFAULT_START_ADDR   0x02
 
+/** Maximum number of sectors in a page */
+#define PMECC_MAX_SECTORS              8
+
+/** Maximum number of remainders per sector (one per correctable bit) */
+#define PMECC_MAX_REMAINDERS           32
+
+/*----------------------------------------------------------------------- */
+/*         Types                                                          */
+/*----------------------------------------------------------------------- */
+
+/** Copy of the PMECC state of a page, used to correct the page after the
+ * PMECC has been restarted for the next one */
+struct _pmecc_remainders {
+	/** Value of the PMECC status register, one bit per sector */
+	uint32_t status;
+
+	/** Remainders of the sectors flagged in status */
+	int16_t rem[PMECC_MAX_SECTORS][PMECC_MAX_REMAINDERS];
+};
+
 /*------------------------------------------------------------------------------ */
 /*         Exported functions                                                    */
 /*------------------------------------------------------------------------------ */
@@ -93,6 +113,12 @@ extern uint32_t pmecc_get_ecc_end_address(void);
 
 extern uint32_t pmecc_correction(uint32_t pmecc_status, uint32_t page_buffer);
 
+extern void pmecc_save_remainders(uint32_t pmecc_status,
+		struct _pmecc_remainders *saved);
+
+extern uint32_t pmecc_correction_saved(const struct _pmecc_remainders *saved,
+		uint32_t page_buffer);
+
 extern void pmecc_build_gf(uint32_t mm, int32_t *index_of, int32_t *alpha_to);
 
 #endif /* CONFIG_HAVE_PMECC */
@@ -345,6 +345,18 @@ int spi_flash_read(struct spi_flash *flash, size_t from, void *buf, size_t len)
 	return flash->read(flash, from, buf, len);
 }
 
+int spi_flash_read_async(struct spi_flash *flash, size_t from, void *buf, size_t len, struct _callback *cb)
+{
+	int rc;
+
+	if (flash->read_async)
+		return flash->read_async(flash, from, buf, len, cb);
+
+	rc = flash->read(flash, from, buf, len);
+	callback_call(cb, (void*)(intptr_t)rc);
+	return rc;
+}
+
 int spi_flash_write(struct spi_flash *flash, size_t to, const void *buf, size_t len)
 {
 	return flash->write(flash, to, buf, len);
@@ -399,3 +411,82 @@ int spi_flash_set_protection(struct spi_flash *flash, bool protect)
 
 	return 0;
 }
+
+int spi_flash_set_cache(struct spi_flash *flash, struct spi_flash_cache *cache, uint8_t *buffer, uint32_t line_size, uint8_t num_lines)
+{
+	int i;
+
+	if (!cache) {
+		flash->cache = NULL;
+		return 0;
+	}
+
+	if (!buffer || !IS_POWER_OF_TWO(line_size) ||
+	    num_lines == 0 || num_lines > SFLASH_CACHE_MAX_LINES)
+		return -EINVAL;
+
+	cache->buffer = buffer;
+	cache->line_size = line_size;
+	cache->num_lines = num_lines;
+	for (i = 0; i < num_lines; i++) {
+		cache->addr[i] = SFLASH_CACHE_INVALID;
+		cache->stamp[i] = 0;
+	}
+	cache->clock = 0;
+	cache->hits = 0;
+	cache->misses = 0;
+
+	flash->cache = cache;
+	return 0;
+}
+
+uint8_t *spi_flash_cache_lookup(struct spi_flash_cache *cache, uint32_t addr)
+{
+	int i;
+
+	for (i = 0; i < cache->num_lines; i++) {
+		if (cache->addr[i] == addr) {
+			cache->stamp[i] = ++cache->clock;
+			cache->hits++;
+			return cache->buffer + i * cache->line_size;
+		}
+	}
+
+	return NULL;
+}
+
+uint8_t *spi_flash_cache_alloc(struct spi_flash_cache *cache, uint32_t addr)
+{
+	int i, victim = 0;
+
+	/* Reuse an empty line, or evict the least recently used one */
+	for (i = 0; i < cache->num_lines; i++) {
+		if (cache->addr[i] == SFLASH_CACHE_INVALID) {
+			victim = i;
+			break;
+		}
+		if ((int32_t)(cache->stamp[i] - cache->stamp[victim]) < 0)
+			victim = i;
+	}
+
+	cache->addr[victim] = addr;
+	cache->stamp[victim] = ++cache->clock;
+	cache->misses++;
+	return cache->buffer + victim * cache->line_size;
+}
+
+void spi_flash_cache_invalidate(struct spi_flash_cache *cache, size_t offset, size_t len)
+{
+	int i;
+
+	if (!cache || !len)
+		return;
+
+	for (i = 0; i < cache->num_lines; i++) {
+		if (cache->addr[i] == SFLASH_CACHE_INVALID)
+			continue;
+		if (cache->addr[i] < offset + len &&
+		    offset < cache->addr[i] + cache->line_size)
+			cache->addr[i] = SFLASH_CACHE_INVALID;
+	}
+}
@@ -36,6 +36,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "callback.h"
 #include "compiler.h"
 #include "intmath.h"
 #include "peripherals/bus.h"
@@ -51,6 +52,12 @@
 #define SFLASH_MAX_ID_LEN      6
 #define SFLASH_DEFAULT_TIMEOUT 500000 /* 500 ms */
 
+/**
+ * Maximum number of lines of the read cache.
+ */
+#define SFLASH_CACHE_MAX_LINES 8
+#define SFLASH_CACHE_INVALID   0xFFFFFFFFUL
+
 /**
  * Manufacturer IDs.
  */
@@ -257,6 +264,9 @@ enum spi_flash_protocol {
  * @data_len:		Number of bytes to be sent during data clock cycles.
  * @tx_data:		Data sent to the SPI slave during data clock cycles.
  * @rx_data:		Data read from the SPI slave during data clock cycles.
+ * @callback:		Optional completion callback. When set, the controller
+ *			may return before the data phase is over and call it
+ *			later with the command status as second argument.
  */
 struct spi_flash_command {
 	enum spi_flash_protocol proto;
@@ -274,6 +284,30 @@ struct spi_flash_command {
 #ifdef CONFIG_HAVE_AESB
 	bool use_aesb;
 #endif
+	struct _callback callback;
+};
+
+/**
+ * struct spi_flash_cache - LRU read cache of SPI flash lines
+ * @buffer:		Storage for @num_lines lines of @line_size bytes, should
+ *			be cache aligned so that lines can be filled by DMA.
+ * @line_size:		Size of a line in bytes (power of two).
+ * @num_lines:		Number of lines (up to SFLASH_CACHE_MAX_LINES).
+ * @addr:		Flash address of each line, SFLASH_CACHE_INVALID if empty.
+ * @stamp:		Last access stamp of each line.
+ * @clock:		Access counter used to stamp the lines.
+ * @hits:		Number of line lookups served from the cache.
+ * @misses:		Number of line lookups that required a flash read.
+ */
+struct spi_flash_cache {
+	uint8_t *buffer;
+	uint32_t line_size;
+	uint8_t num_lines;
+	uint32_t addr[SFLASH_CACHE_MAX_LINES];
+	uint32_t stamp[SFLASH_CACHE_MAX_LINES];
+	uint32_t clock;
+	uint32_t hits;
+	uint32_t misses;
 };
 
 /**
@@ -373,8 +407,11 @@ struct spi_flash_hwcaps {
  * @size:		The total SPI flash size (in bytes).
  * @page_size:		The page size (in bytes).
  * @erase_map:		The erase map of the SPI flash.
+ * @cache:		Optional read cache, see spi_flash_set_cache().
  * @ops:		[DRIVER-SPECIFIC] The SPI controller interface.
  * @read:		[FLASH-SPECIFIC] Read data from the SPI flash.
+ * @read_async:		[FLASH-SPECIFIC] Start a read, completion is notified
+ *			through a callback.
  * @write:		[FLASH-SPECIFIC] Write data into the SPI flash.
  * @erase:		[FLASH-SPECIFIC] Erase data inside the SPI flash.
  */
@@ -401,6 +438,7 @@ struct spi_flash {
 	size_t size;
 	size_t page_size;
 	struct spi_flash_erase_map erase_map;
+	struct spi_flash_cache *cache;
 
 	const struct spi_ops *ops;
 
@@ -409,6 +447,7 @@ struct spi_flash {
 #endif
 
 	int (*read)(struct spi_flash *, size_t, uint8_t *, size_t);
+	int (*read_async)(struct spi_flash *, size_t, uint8_t *, size_t, struct _callback *);
 	int (*write)(struct spi_flash *, size_t, const uint8_t *, size_t);
 	int (*erase)(struct spi_flash *, size_t, size_t);
 	int (*enable_0_4_4)(struct spi_flash *, bool);
@@ -445,6 +484,18 @@ extern int spi_flash_exec(struct spi_flash *flash, const struct spi_flash_comman
 
 extern int spi_flash_read(struct spi_flash *flash, size_t from, void *buf, size_t len);
 
+/**
+ * Start reading data from the SPI flash.
+ *
+ * @flash:		Pointer to the SPI flash.
+ * @from:		Flash offset to read from.
+ * @buf:		Destination buffer, must stay valid until completion.
+ * @len:		Number of bytes to read.
+ * @cb:			Callback invoked on completion with the read status as
+ *			second argument (may be called before returning).
+ */
+extern int spi_flash_read_async(struct spi_flash *flash, size_t from, void *buf, size_t len, struct _callback *cb);
+
 extern int spi_flash_write(struct spi_flash *flash, size_t to, const void *buf, size_t len);
 
 extern int spi_flash_erase(struct spi_flash *flash, size_t offset, size_t len);
@@ -486,4 +537,22 @@ extern uint32_t spi_flash_div_by_erase_size(const struct spi_flash_erase_command
 
 extern int spi_flash_set_protection(struct spi_flash *flash, bool protect);
 
+/**
+ * Attach a read cache to a SPI flash. Reads shorter than a line are served
+ * from the cache, writes and erases invalidate the lines they overlap.
+ *
+ * @flash:		Pointer to the SPI flash.
+ * @cache:		Cache descriptor, NULL to disable caching.
+ * @buffer:		Line storage of @line_size * @num_lines bytes.
+ * @line_size:		Line size in bytes (power of two).
+ * @num_lines:		Number of lines (1 to SFLASH_CACHE_MAX_LINES).
+ */
+extern int spi_flash_set_cache(struct spi_flash *flash, struct spi_flash_cache *cache, uint8_t *buffer, uint32_t line_size, uint8_t num_lines);
+
+extern uint8_t *spi_flash_cache_lookup(struct spi_flash_cache *cache, uint32_t addr);
+
+extern uint8_t *spi_flash_cache_alloc(struct spi_flash_cache *cache, uint32_t addr);
+
+extern void spi_flash_cache_invalidate(struct spi_flash_cache *cache, size_t offset, size_t len);
+
 #endif /* _SPI_FLASH_H */
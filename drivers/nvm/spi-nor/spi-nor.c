@@ -294,6 +294,7 @@ static int spi_nor_probe(struct spi_flash *flash)
 	flash->read_proto = SFLASH_PROTO_1_1_1;
 	flash->write_proto = SFLASH_PROTO_1_1_1;
 	flash->read = spi_nor_read;
+	flash->read_async = spi_nor_read_async;
 	flash->write = spi_nor_write;
 	flash->erase = spi_nor_erase;
 	flash->flags = 0;
@@ -457,6 +458,13 @@ static int _bus_exec(union spi_flash_priv* priv, const struct spi_flash_command
 	bus_wait_transfer(priv->spi.bus);
 	bus_stop_transaction(priv->spi.bus);
 
+	if (cmd->callback.method) {
+		struct _callback cb;
+
+		callback_copy(&cb, (struct _callback*)&cmd->callback);
+		callback_call(&cb, (void*)(intptr_t)rc);
+	}
+
 	return rc;
 }
 
@@ -719,7 +727,7 @@ int spi_nor_configure(struct spi_flash *flash, const struct spi_flash_cfg *cfg)
 	return 0;
 }
 
-int spi_nor_read(struct spi_flash *flash, size_t from, uint8_t* buf, size_t len)
+static int _spi_nor_read(struct spi_flash *flash, size_t from, uint8_t* buf, size_t len, struct _callback* cb)
 {
 	struct spi_flash_command cmd;
 
@@ -734,9 +742,68 @@ int spi_nor_read(struct spi_flash *flash, size_t from, uint8_t* buf, size_t len)
 #ifdef CONFIG_HAVE_AESB
 	cmd.use_aesb = flash->use_aesb;
 #endif
+	if (cb)
+		callback_copy(&cmd.callback, cb);
 	return spi_flash_exec(flash, &cmd);
 }
 
+static int _spi_nor_read_cached(struct spi_flash *flash, size_t from, uint8_t* buf, size_t len)
+{
+	struct spi_flash_cache *cache = flash->cache;
+	int rc;
+
+	while (len) {
+		uint32_t line = from & ~(cache->line_size - 1);
+		uint32_t offset = from - line;
+		uint32_t count = min_u32(cache->line_size - offset, len);
+		uint8_t *data;
+
+		data = spi_flash_cache_lookup(cache, line);
+		if (!data) {
+			data = spi_flash_cache_alloc(cache, line);
+			rc = _spi_nor_read(flash, line, data, cache->line_size, NULL);
+			if (rc < 0) {
+				spi_flash_cache_invalidate(cache, line, cache->line_size);
+				return rc;
+			}
+		}
+
+		memcpy(buf, data + offset, count);
+		buf += count;
+		from += count;
+		len -= count;
+	}
+
+	return 0;
+}
+
+static bool _spi_nor_use_cache(struct spi_flash *flash, const uint8_t* buf, size_t len)
+{
+	/* Large reads would only thrash the cache */
+	return flash->cache && buf && len && len < flash->cache->line_size;
+}
+
+int spi_nor_read(struct spi_flash *flash, size_t from, uint8_t* buf, size_t len)
+{
+	if (_spi_nor_use_cache(flash, buf, len))
+		return _spi_nor_read_cached(flash, from, buf, len);
+
+	return _spi_nor_read(flash, from, buf, len, NULL);
+}
+
+int spi_nor_read_async(struct spi_flash *flash, size_t from, uint8_t* buf, size_t len, struct _callback* cb)
+{
+	int rc;
+
+	if (_spi_nor_use_cache(flash, buf, len)) {
+		rc = _spi_nor_read_cached(flash, from, buf, len);
+		callback_call(cb, (void*)(intptr_t)rc);
+		return rc;
+	}
+
+	return _spi_nor_read(flash, from, buf, len, cb);
+}
+
 int spi_nor_write(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t len)
 {
 	struct spi_flash_command cmd;
@@ -746,6 +813,8 @@ int spi_nor_write(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t
 	if (rc < 0)
 		return rc;
 
+	spi_flash_cache_invalidate(flash->cache, to, len);
+
 	spi_flash_command_init(&cmd, flash->write_inst, flash->addr_len, SFLASH_TYPE_WRITE);
 	cmd.proto = flash->write_proto;
 #ifdef CONFIG_HAVE_AESB
@@ -800,6 +869,8 @@ int spi_nor_erase(struct spi_flash *flash, size_t offset, size_t len)
 	if (rc < 0)
 		return rc;
 
+	spi_flash_cache_invalidate(flash->cache, offset, len);
+
 	spi_flash_command_init(&cmd, 0, flash->addr_len, SFLASH_TYPE_ERASE);
 	cmd.proto = flash->reg_proto;
 #ifdef CONFIG_HAVE_AESB
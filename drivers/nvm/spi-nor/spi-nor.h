@@ -113,6 +113,7 @@ extern const struct spi_nor_info spi_nor_ids[];
 
 int spi_nor_configure(struct spi_flash *flash, const struct spi_flash_cfg *cfg);
 int spi_nor_read(struct spi_flash *flash, size_t from, uint8_t* buf, size_t len);
+int spi_nor_read_async(struct spi_flash *flash, size_t from, uint8_t* buf, size_t len, struct _callback* cb);
 int spi_nor_write(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t len);
 int spi_nor_erase(struct spi_flash *flash, size_t offset, size_t len);
 
@@ -37,6 +37,9 @@
 #include "board.h"
 #include "chip.h"
 #include "console.h"
+#include "intmath.h"
+#include "irqflags.h"
+#include "ring.h"
 #ifdef CONFIG_HAVE_L1CACHE
 #include "mm/l1cache.h"
 #endif
@@ -49,14 +52,107 @@
 #include "peripherals/pmc.h"
 #include "serial/seriald.h"
 
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+#ifdef CONFIG_CONSOLE_TX_BUFFERED
+
+/** Size of the TX buffer enabled by console_configure() */
+#ifndef CONSOLE_TX_BUFFER_SIZE
+#define CONSOLE_TX_BUFFER_SIZE 1024
+#endif
+
+/** Full buffer policy of the TX buffer enabled by console_configure() */
+#ifndef CONSOLE_TX_POLICY
+#define CONSOLE_TX_POLICY CONSOLE_TX_BLOCK
+#endif
+
+#endif /* CONFIG_CONSOLE_TX_BUFFERED */
+
+/*----------------------------------------------------------------------------
+ *        Local types
+ *----------------------------------------------------------------------------*/
+
+struct _console_tx {
+	struct _ring ring;
+	bool enabled;
+	volatile bool panic;
+	enum _console_tx_policy policy;
+	uint32_t written;
+	uint32_t dropped;
+};
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
 static struct _seriald console;
 
+static struct _console_tx console_tx;
+
+#ifdef CONFIG_CONSOLE_TX_BUFFERED
+static uint8_t console_tx_buffer[CONSOLE_TX_BUFFER_SIZE];
+#endif
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Move characters from the TX buffer to the transmitter while it
+ * accepts them. Must be called with interrupts disabled.
+ */
+static void _console_tx_feed(void)
+{
+	const void* ptr;
+	const uint8_t* data;
+	uint32_t count, i;
+
+	while ((count = ring_read_acquire(&console_tx.ring, &ptr)) > 0) {
+		data = (const uint8_t*)ptr;
+		for (i = 0; i < count && seriald_is_tx_ready(&console); i++)
+			seriald_put_char(&console, data[i]);
+		ring_read_release(&console_tx.ring, i);
+		if (i < count)
+			return;
+	}
+
+	seriald_disable_tx_interrupt(&console);
+}
+
+static void _console_tx_handler(void)
+{
+	uint32_t flags = arch_irq_save();
+	_console_tx_feed();
+	arch_irq_restore(flags);
+}
+
+/**
+ * \brief Make room for \a count characters by discarding the oldest ones.
+ * Must be called with interrupts disabled.
+ */
+static void _console_tx_discard(uint32_t count)
+{
+	uint32_t space = ring_space(&console_tx.ring);
+
+	if (count > space) {
+		ring_read_release(&console_tx.ring, count - space);
+		console_tx.dropped += count - space;
+	}
+}
+
 /*------------------------------------------------------------------------------
  *         Exported functions
  *------------------------------------------------------------------------------*/
 
 void console_configure(const struct _console_cfg* config)
 {
+	bool buffered = console_tx.enabled;
+
+	if (buffered)
+		console_disable_tx_buffer();
+
 	if (config && config->addr && config->baudrate)
 	{
 		if (config->tx_pin.mask)
@@ -66,24 +162,167 @@ void console_configure(const struct _console_cfg* config)
 		seriald_configure(&console, config->addr, config->baudrate);
 	} else {
 		memset(&console, 0, sizeof(console));
+		return;
 	}
+
+	if (buffered)
+		console_enable_tx_buffer(console_tx.ring.buffer,
+				console_tx.ring.size, console_tx.policy);
+#ifdef CONFIG_CONSOLE_TX_BUFFERED
+	else
+		console_enable_tx_buffer(console_tx_buffer,
+				CONSOLE_TX_BUFFER_SIZE, CONSOLE_TX_POLICY);
+#endif
 }
 
 void console_put_char(char c)
 {
-	seriald_put_char(&console, *(uint8_t*)&c);
+	console_write(&c, 1);
 }
 
 void console_put_string(const char* str)
 {
-	seriald_put_string(&console, (const uint8_t*)str);
+	console_write(str, strlen(str));
+}
+
+uint32_t console_write(const char* data, uint32_t len)
+{
+	uint32_t flags, done, n;
+
+	if (!console_tx.enabled || console_tx.panic) {
+		for (done = 0; done < len; done++)
+			seriald_put_char(&console, (uint8_t)data[done]);
+		return len;
+	}
+
+	flags = arch_irq_save();
+	done = 0;
+	while (done < len) {
+		n = ring_push_n(&console_tx.ring, data + done, len - done);
+		console_tx.written += n;
+		done += n;
+		if (done == len)
+			break;
+
+		/* TX buffer is full */
+		if (console_tx.policy == CONSOLE_TX_DROP) {
+			console_tx.dropped += len - done;
+			break;
+		} else if (console_tx.policy == CONSOLE_TX_OVERWRITE) {
+			n = len - done;
+			if (n > console_tx.ring.size) {
+				/* only the end of the block can be kept */
+				console_tx.dropped += n - console_tx.ring.size;
+				done += n - console_tx.ring.size;
+				n = console_tx.ring.size;
+			}
+			_console_tx_discard(n);
+		} else {
+			/* drain by polling, this also works when called with
+			 * interrupts disabled */
+			_console_tx_feed();
+			arch_irq_restore(flags);
+			flags = arch_irq_save();
+		}
+	}
+
+	if (!ring_is_empty(&console_tx.ring))
+		seriald_enable_tx_interrupt(&console);
+	arch_irq_restore(flags);
+
+	return console_tx.policy == CONSOLE_TX_DROP ? done : len;
 }
 
 bool console_is_tx_empty(void)
 {
+	if (console_tx.enabled && !ring_is_empty(&console_tx.ring))
+		return false;
+
 	return seriald_is_tx_empty(&console);
 }
 
+int console_enable_tx_buffer(uint8_t* buffer, uint32_t size,
+		enum _console_tx_policy policy)
+{
+	int err;
+
+	if (!console.id)
+		return -ENODEV;
+
+	if (console_tx.enabled)
+		console_disable_tx_buffer();
+
+	err = ring_init(&console_tx.ring, buffer, size, 1);
+	if (err < 0)
+		return err;
+	console_tx.policy = policy;
+	console_tx.panic = false;
+	console_reset_tx_stats();
+
+	seriald_set_tx_handler(&console, _console_tx_handler);
+	console_tx.enabled = true;
+
+	return 0;
+}
+
+void console_disable_tx_buffer(void)
+{
+	if (!console_tx.enabled)
+		return;
+
+	console_flush();
+	console_tx.enabled = false;
+	seriald_set_tx_handler(&console, NULL);
+}
+
+void console_flush(void)
+{
+	uint32_t flags;
+
+	if (console_tx.enabled) {
+		while (!ring_is_empty(&console_tx.ring)) {
+			flags = arch_irq_save();
+			_console_tx_feed();
+			arch_irq_restore(flags);
+		}
+	}
+
+	while (!seriald_is_tx_empty(&console));
+}
+
+void console_panic_flush(void)
+{
+	uint32_t flags;
+	uint8_t c;
+
+	flags = arch_irq_save();
+	if (console_tx.enabled && !console_tx.panic) {
+		console_tx.panic = true;
+		seriald_disable_tx_interrupt(&console);
+		while (ring_pop(&console_tx.ring, &c))
+			seriald_put_char(&console, c);
+	}
+	while (!seriald_is_tx_empty(&console));
+	arch_irq_restore(flags);
+}
+
+void console_get_tx_stats(struct _console_tx_stats* stats)
+{
+	stats->written = console_tx.written;
+	stats->dropped = console_tx.dropped;
+	stats->peak = console_tx.ring.peak;
+	stats->size = console_tx.enabled ? console_tx.ring.size : 0;
+}
+
+void console_reset_tx_stats(void)
+{
+	uint32_t flags = arch_irq_save();
+	console_tx.written = 0;
+	console_tx.dropped = 0;
+	console_tx.ring.peak = ring_count(&console_tx.ring);
+	arch_irq_restore(flags);
+}
+
 char console_get_char(void)
 {
 	uint8_t c = seriald_get_char(&console);
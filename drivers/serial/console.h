@@ -53,6 +53,21 @@ struct _console_cfg {
 /** Handler for character reception using interrupts */
 typedef void (*console_rx_handler_t)(uint8_t received_char);
 
+/** Behavior of the buffered output when the TX buffer is full */
+enum _console_tx_policy {
+	CONSOLE_TX_BLOCK,     /**< wait until there is room */
+	CONSOLE_TX_DROP,      /**< discard the new characters */
+	CONSOLE_TX_OVERWRITE, /**< discard the oldest pending characters */
+};
+
+/** Buffered output statistics */
+struct _console_tx_stats {
+	uint32_t written; /**< characters queued in the TX buffer */
+	uint32_t dropped; /**< characters discarded because the buffer was full */
+	uint32_t peak;    /**< highest TX buffer occupancy */
+	uint32_t size;    /**< TX buffer size */
+};
+
 /* ----------------------------------------------------------------------------
  *         Global function
  * ---------------------------------------------------------------------------*/
@@ -68,7 +83,8 @@ extern void console_configure(const struct _console_cfg* config);
 /**
  * \brief Outputs a character on the CONSOLE.
  *
- * \note This function is synchronous (i.e. uses polling).
+ * \note This function is synchronous (i.e. uses polling) unless the TX
+ * buffer is enabled.
  * \param c  Character to send.
  */
 extern void console_put_char(char c);
@@ -76,16 +92,70 @@ extern void console_put_char(char c);
 /**
  * \brief Outputs a string on the CONSOLE.
  *
- * \note This function is synchronous (i.e. uses polling).
+ * \note This function is synchronous (i.e. uses polling) unless the TX
+ * buffer is enabled.
  * \param str  String to send.
  */
 extern void console_put_string(const char* str);
 
+/**
+ * \brief Outputs a block of characters on the CONSOLE.
+ *
+ * \param data  Characters to send.
+ * \param len   Number of characters.
+ * \return Number of characters sent or queued. Can be less than \a len
+ * when the TX buffer is full and the policy is CONSOLE_TX_DROP.
+ */
+extern uint32_t console_write(const char* data, uint32_t len);
+
 /**
  * \brief Check if any pending TX character has been sent
  */
 extern bool console_is_tx_empty(void);
 
+/**
+ * \brief Enable buffered output. Characters are queued in \a buffer and
+ * sent from the CONSOLE interrupt (transmitter ready).
+ *
+ * \param buffer  TX buffer
+ * \param size    TX buffer size, must be a power of two
+ * \param policy  Behavior when the TX buffer is full
+ * \return 0 on success, -ENODEV if the CONSOLE is not configured, -EINVAL
+ * if the buffer size is not a power of two.
+ */
+extern int console_enable_tx_buffer(uint8_t* buffer, uint32_t size,
+		enum _console_tx_policy policy);
+
+/**
+ * \brief Flush and disable buffered output.
+ */
+extern void console_disable_tx_buffer(void);
+
+/**
+ * \brief Wait until all the buffered characters have been sent.
+ *
+ * \note Can be called with interrupts disabled: the buffer is then drained
+ * by polling.
+ */
+extern void console_flush(void);
+
+/**
+ * \brief Synchronously send the buffered characters and switch the CONSOLE
+ * to synchronous output. Meant for fatal error paths, where interrupts may
+ * be disabled and never re-enabled.
+ */
+extern void console_panic_flush(void);
+
+/**
+ * \brief Get the buffered output statistics.
+ */
+extern void console_get_tx_stats(struct _console_tx_stats* stats);
+
+/**
+ * \brief Reset the buffered output statistics.
+ */
+extern void console_reset_tx_stats(void);
+
 /**
  * \brief Input a character from the CONSOLE line.
  *
@@ -108,6 +108,15 @@ extern uint32_t dbgu_get_char(Dbgu* dbgu)
 	return dbgu->DBGU_RHR;
 }
 
+/**
+ * \brief Check if the transmitter can accept a character
+ * \param dbgu  Pointer to the DBGU peripheral.
+ */
+bool dbgu_is_tx_ready(Dbgu* dbgu)
+{
+	return (dbgu->DBGU_SR & DBGU_SR_TXRDY) != 0;
+}
+
 /**
  * \brief Check is character has been sent
  * \param dbgu  Pointer to the DBGU peripheral.
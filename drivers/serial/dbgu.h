@@ -52,6 +52,7 @@
 
 extern void dbgu_configure(Dbgu* dbgu, uint32_t mode, uint32_t baudrate);
 extern void dbgu_put_char(Dbgu* dbgu, unsigned char c);
+extern bool dbgu_is_tx_ready(Dbgu* dbgu);
 extern bool dbgu_is_tx_empty(Dbgu* dbgu);
 extern bool dbgu_is_rx_ready(Dbgu* dbgu);
 extern uint32_t dbgu_get_char(Dbgu* dbgu);
@@ -65,6 +65,7 @@
 
 typedef void (*init_handler_t)(void*, uint32_t, uint32_t);
 typedef void (*put_char_handler_t)(void*, uint8_t);
+typedef bool (*tx_ready_handler_t)(void*);
 typedef bool (*tx_empty_handler_t)(void*);
 typedef uint8_t (*get_char_handler_t)(void*);
 typedef bool (*rx_ready_handler_t)(void*);
@@ -74,8 +75,10 @@ typedef void (*disable_it_handler_t)(void*, uint32_t);
 struct _seriald_ops {
 	uint32_t             mode;
 	uint32_t             rx_int_mask;
+	uint32_t             tx_int_mask;
 	init_handler_t       init;
 	put_char_handler_t   put_char;
+	tx_ready_handler_t   tx_ready;
 	tx_empty_handler_t   tx_empty;
 	get_char_handler_t   get_char;
 	rx_ready_handler_t   rx_ready;
@@ -91,8 +94,10 @@ struct _seriald_ops {
 static const struct _seriald_ops seriald_ops_usart = {
 	.mode = US_MR_CHMODE_NORMAL | US_MR_PAR_NO | US_MR_CHRL_8_BIT,
 	.rx_int_mask = US_IER_RXRDY,
+	.tx_int_mask = US_IER_TXRDY,
 	.init = (init_handler_t)usart_configure,
 	.put_char = (put_char_handler_t)usart_put_char,
+	.tx_ready = (tx_ready_handler_t)usart_is_tx_ready,
 	.tx_empty = (tx_empty_handler_t)usart_is_tx_empty,
 	.get_char = (get_char_handler_t)usart_get_char,
 	.rx_ready = (rx_ready_handler_t)usart_is_rx_ready,
@@ -105,8 +110,10 @@ static const struct _seriald_ops seriald_ops_usart = {
 static const struct _seriald_ops seriald_ops_uart = {
 	.mode = UART_MR_CHMODE_NORMAL | UART_MR_PAR_NO,
 	.rx_int_mask = UART_IER_RXRDY,
+	.tx_int_mask = UART_IER_TXRDY,
 	.init = (init_handler_t)uart_configure,
 	.put_char = (put_char_handler_t)uart_put_char,
+	.tx_ready = (tx_ready_handler_t)uart_is_tx_ready,
 	.tx_empty = (tx_empty_handler_t)uart_is_tx_empty,
 	.get_char = (get_char_handler_t)uart_get_char,
 	.rx_ready = (rx_ready_handler_t)uart_is_rx_ready,
@@ -119,8 +126,10 @@ static const struct _seriald_ops seriald_ops_uart = {
 static const struct _seriald_ops seriald_ops_dbgu = {
 	.mode = DBGU_MR_CHMODE_NORM | DBGU_MR_PAR_NONE,
 	.rx_int_mask = DBGU_IER_RXRDY,
+	.tx_int_mask = DBGU_IER_TXRDY,
 	.init = (init_handler_t)dbgu_configure,
 	.put_char = (put_char_handler_t)dbgu_put_char,
+	.tx_ready = (tx_ready_handler_t)dbgu_is_tx_ready,
 	.tx_empty = (tx_empty_handler_t)dbgu_is_tx_empty,
 	.get_char = (get_char_handler_t)dbgu_get_char,
 	.rx_ready = (rx_ready_handler_t)dbgu_is_rx_ready,
@@ -138,12 +147,31 @@ static void seriald_handler(uint32_t source, void* user_arg)
 	const struct _seriald* serial = (struct _seriald*)user_arg;
 	uint8_t c;
 
-	if (!seriald_is_rx_ready(serial))
+	if (serial->rx_enabled && seriald_is_rx_ready(serial)) {
+		c = seriald_get_char(serial);
+		if (serial->rx_handler)
+			serial->rx_handler(c);
+	}
+
+	if (serial->tx_enabled && serial->tx_handler &&
+	    seriald_is_tx_ready(serial))
+		serial->tx_handler();
+}
+
+static void seriald_attach_handler(const struct _seriald* serial)
+{
+	irq_add_handler(serial->id, seriald_handler, (void*)serial);
+	irq_enable(serial->id);
+}
+
+static void seriald_detach_handler(const struct _seriald* serial)
+{
+	/* keep the handler while either direction still uses it */
+	if (serial->rx_enabled || serial->tx_handler)
 		return;
 
-	c = seriald_get_char(serial);
-	if (serial->rx_handler)
-		serial->rx_handler(c);
+	irq_disable(serial->id);
+	irq_remove_handler(serial->id, seriald_handler);
 }
 
 /*------------------------------------------------------------------------------
@@ -217,6 +245,14 @@ void seriald_put_string(const struct _seriald* serial, const uint8_t* str)
 		serial->ops->put_char(serial->addr, *str++);
 }
 
+bool seriald_is_tx_ready(const struct _seriald* serial)
+{
+	if (!serial || !serial->id)
+		return true;
+
+	return serial->ops->tx_ready(serial->addr);
+}
+
 bool seriald_is_tx_empty(const struct _seriald* serial)
 {
 	if (!serial || !serial->id)
@@ -256,8 +292,9 @@ void seriald_enable_rx_interrupt(const struct _seriald* serial)
 	if (!serial || !serial->id)
 		return;
 
-	irq_add_handler(serial->id, seriald_handler, (void*)serial);
-	irq_enable(serial->id);
+	/* the interrupt state is driver bookkeeping, not configuration */
+	((struct _seriald*)serial)->rx_enabled = true;
+	seriald_attach_handler(serial);
 	serial->ops->enable_it(serial->addr, serial->ops->rx_int_mask);
 }
 
@@ -267,6 +304,39 @@ void seriald_disable_rx_interrupt(const struct _seriald* serial)
 		return;
 
 	serial->ops->disable_it(serial->addr, serial->ops->rx_int_mask);
-	irq_disable(serial->id);
-	irq_remove_handler(serial->id, seriald_handler);
+	((struct _seriald*)serial)->rx_enabled = false;
+	seriald_detach_handler(serial);
+}
+
+void seriald_set_tx_handler(struct _seriald* serial, seriald_tx_handler_t handler)
+{
+	if (!serial || !serial->id)
+		return;
+
+	if (handler) {
+		serial->tx_handler = handler;
+		seriald_attach_handler(serial);
+	} else {
+		seriald_disable_tx_interrupt(serial);
+		serial->tx_handler = NULL;
+		seriald_detach_handler(serial);
+	}
+}
+
+void seriald_enable_tx_interrupt(struct _seriald* serial)
+{
+	if (!serial || !serial->id)
+		return;
+
+	serial->tx_enabled = true;
+	serial->ops->enable_it(serial->addr, serial->ops->tx_int_mask);
+}
+
+void seriald_disable_tx_interrupt(struct _seriald* serial)
+{
+	if (!serial || !serial->id)
+		return;
+
+	serial->ops->disable_it(serial->addr, serial->ops->tx_int_mask);
+	serial->tx_enabled = false;
 }
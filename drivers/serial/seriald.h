@@ -45,6 +45,9 @@
 /** Handler for character reception using interrupts */
 typedef void (*seriald_rx_handler_t)(uint8_t received_char);
 
+/** Handler called from the interrupt when the transmitter is ready */
+typedef void (*seriald_tx_handler_t)(void);
+
 /** Forward declaration of internal structure */
 struct _seriald_ops;
 
@@ -53,6 +56,9 @@ struct _seriald {
 	uint32_t id; /* peripheral identifier */
 	void *addr; /* peripheral address */
 	seriald_rx_handler_t rx_handler; /* rx callback */
+	seriald_tx_handler_t tx_handler; /* tx callback */
+	volatile bool rx_enabled; /* rx interrupt enabled */
+	volatile bool tx_enabled; /* tx interrupt enabled */
 	const struct _seriald_ops* ops; /* low-level operations */
 };
 
@@ -84,6 +90,11 @@ extern void seriald_put_char(const struct _seriald* seriald, uint8_t c);
  */
 extern void seriald_put_string(const struct _seriald* seriald, const uint8_t* str);
 
+/**
+ * \brief Check if the transmitter can accept a new character
+ */
+extern bool seriald_is_tx_ready(const struct _seriald* seriald);
+
 /**
  * \brief Check if any pending TX character has been sent
  */
@@ -123,4 +134,23 @@ extern void seriald_enable_rx_interrupt(const struct _seriald* seriald);
  */
 extern void seriald_disable_rx_interrupt(const struct _seriald* seriald);
 
+/**
+ * \brief Set the handler function that will be called from the SERIAL
+ * interrupt while the TX interrupt is enabled and the transmitter is ready.
+ * The handler either writes a character or disables the TX interrupt.
+ *
+ * \param handler the SERIAL TX handler, NULL to release the interrupt
+ */
+extern void seriald_set_tx_handler(struct _seriald* seriald, seriald_tx_handler_t handler);
+
+/**
+ * \brief Enable the SERIAL TX (transmitter ready) interrupt.
+ */
+extern void seriald_enable_tx_interrupt(struct _seriald* seriald);
+
+/**
+ * \brief Disable the SERIAL TX (transmitter ready) interrupt.
+ */
+extern void seriald_disable_tx_interrupt(struct _seriald* seriald);
+
 #endif	/* _SERIAL_H_ */
@@ -146,6 +146,51 @@ static void _usartd_dma_write(uint8_t iface)
 	dma_start_transfer(desc->dma.tx.channel);
 }
 
+static int _usartd_stream_dma_callback(void* arg, void* arg2)
+{
+	struct _usart_desc* desc = (struct _usart_desc*)arg;
+
+	/* End of the looped block: the DMA wraps to the buffer start */
+	desc->stream.laps++;
+
+	return 0;
+}
+
+/* Producer side: publish the bytes written by the DMA, only moves head */
+static void _usartd_stream_update(struct _usart_desc* desc)
+{
+	struct _ring* ring = &desc->stream.ring;
+	uint32_t laps, pos, written, head, delta;
+
+	/* The DMA write position is the progress inside the looped block */
+	do {
+		laps = desc->stream.laps;
+		pos = dma_get_transferred_data_len(desc->dma.rx.channel, DMA_CHUNK_SIZE_1, ring->size) & ring->mask;
+	} while (laps != desc->stream.laps);
+
+	/* The block interrupt of a wrap may still be pending */
+	written = laps * ring->size + pos;
+	if ((int32_t)(written - ring->head) < 0)
+		written += ring->size;
+
+	delta = written - ring->head;
+	if (delta == 0)
+		return;
+
+	/* Only the last lap is still in the buffer */
+	head = ring->head & ring->mask;
+	if (delta >= ring->size) {
+		cache_invalidate_region(ring->buffer, ring->size);
+	} else if (head + delta <= ring->size) {
+		cache_invalidate_region(ring->buffer + head, delta);
+	} else {
+		cache_invalidate_region(ring->buffer + head, ring->size - head);
+		cache_invalidate_region(ring->buffer, head + delta - ring->size);
+	}
+	ring_write_commit(ring, delta);
+	desc->stream.stats.received += delta;
+}
+
 static void _usartd_handler(uint32_t source, void* user_arg)
 {
 	int iface;
@@ -171,6 +216,11 @@ static void _usartd_handler(uint32_t source, void* user_arg)
 	status = usart_get_masked_status(addr);
 	desc->rx.has_timeout = false;
 
+	if ((status & US_CSR_OVRE) && desc->stream.running) {
+		desc->stream.stats.overruns++;
+		usart_reset_status(addr);
+	}
+
 	if (USART_STATUS_RXRDY(status)) {
 		if (desc->rx.buffer.size) {
 			desc->rx.buffer.data[desc->rx.transferred] = usart_get_char(addr);
@@ -196,7 +246,11 @@ static void _usartd_handler(uint32_t source, void* user_arg)
 		}
 	}
 
-	if (USART_STATUS_TIMEOUT(status)) {
+	if (USART_STATUS_TIMEOUT(status) && desc->stream.running) {
+		/* Idle line: wait for the next character and notify */
+		desc->addr->US_CR = US_CR_STTTO;
+		callback_call(&desc->stream.callback, NULL);
+	} else if (USART_STATUS_TIMEOUT(status)) {
 		switch (desc->transfer_mode) {
 		case USARTD_MODE_ASYNC:
 			desc->addr->US_CR = US_CR_STTTO;
@@ -220,7 +274,7 @@ static void _usartd_handler(uint32_t source, void* user_arg)
 		usart_disable_it(addr, US_IDR_TXEMPTY);
 	}
 
-	if (_rx_stop) {
+	if (_rx_stop && !desc->stream.running) {
 		desc->addr->US_CR = US_CR_STTTO;
 		desc->rx.buffer.size = 0;
 		mutex_unlock(&desc->rx.mutex);
@@ -423,9 +477,9 @@ uint32_t usartd_transfer(uint8_t iface, struct _buffer* buf, struct _callback* c
 
 	case USARTD_MODE_DMA:
 		if (buf->attr & USARTD_BUF_ATTR_WRITE)
-			_usartd_dma_write(0);
+			_usartd_dma_write(iface);
 		if (buf->attr & USARTD_BUF_ATTR_READ)
-			_usartd_dma_read(0);
+			_usartd_dma_read(iface);
 		break;
 
 	default:
@@ -470,3 +524,105 @@ void usartd_wait_tx_transfer(const uint8_t iface)
 	assert(iface < USART_IFACE_COUNT);
 	while (mutex_is_locked(&_serial[iface]->tx.mutex));
 }
+
+uint32_t usartd_start_rx_stream(uint8_t iface, uint8_t* buffer, uint32_t size, struct _callback* cb)
+{
+	assert(iface < USART_IFACE_COUNT);
+	struct _usart_desc* desc = _serial[iface];
+	struct _dma_channel* channel = desc->dma.rx.channel;
+	struct _dma_transfer_cfg cfg;
+	struct _dma_cfg cfg_dma;
+	struct _callback _cb;
+
+	if (!IS_CACHE_ALIGNED(buffer) || !IS_CACHE_ALIGNED(size))
+		return USARTD_ERROR_INVALID;
+
+	if (!mutex_try_lock(&desc->rx.mutex))
+		return USARTD_ERROR_LOCK;
+
+	if (ring_init(&desc->stream.ring, buffer, size, 1) < 0) {
+		mutex_unlock(&desc->rx.mutex);
+		return USARTD_ERROR_INVALID;
+	}
+	memset(&desc->stream.stats, 0, sizeof(desc->stream.stats));
+	desc->stream.laps = 0;
+	callback_copy(&desc->stream.callback, cb);
+
+	/* A single looped block: the DMA is never re-armed, its end
+	 * interrupt counts the laps */
+	cfg_dma = desc->dma.rx.cfg_dma;
+	cfg_dma.loop = true;
+	cfg.saddr = (void *)&desc->addr->US_RHR;
+	cfg.daddr = buffer;
+	cfg.len = size;
+	if (dma_configure_transfer(channel, &cfg_dma, &cfg, 1) < 0) {
+		mutex_unlock(&desc->rx.mutex);
+		return USARTD_ERROR_INVALID;
+	}
+	callback_set(&_cb, _usartd_stream_dma_callback, desc);
+	dma_set_callback(channel, &_cb);
+
+	cache_invalidate_region(buffer, size);
+	usart_reset_status(desc->addr);
+	desc->stream.running = true;
+	usart_enable_it(desc->addr, US_IER_OVRE);
+	dma_start_transfer(channel);
+
+	/* Report partial data once the line goes idle */
+	if (desc->timeout > 0) {
+		desc->addr->US_CR = US_CR_STTTO;
+		usart_enable_it(desc->addr, US_IER_TIMEOUT);
+	}
+
+	return USARTD_SUCCESS;
+}
+
+void usartd_stop_rx_stream(uint8_t iface)
+{
+	assert(iface < USART_IFACE_COUNT);
+	struct _usart_desc* desc = _serial[iface];
+
+	if (!desc->stream.running)
+		return;
+
+	usart_disable_it(desc->addr, US_IDR_TIMEOUT | US_IDR_OVRE);
+	dma_stop_transfer(desc->dma.rx.channel);
+	dma_reset_channel(desc->dma.rx.channel);
+	desc->stream.running = false;
+
+	mutex_unlock(&desc->rx.mutex);
+}
+
+uint32_t usartd_rx_stream_get(uint8_t iface, const uint8_t** data)
+{
+	assert(iface < USART_IFACE_COUNT);
+	struct _usart_desc* desc = _serial[iface];
+	struct _ring* ring = &desc->stream.ring;
+	uint32_t count;
+
+	if (!desc->stream.running)
+		return 0;
+
+	_usartd_stream_update(desc);
+
+	/* The DMA went over unread data: skip the overwritten bytes */
+	count = ring_count(ring);
+	if (count > ring->size) {
+		ring_read_release(ring, count - ring->size);
+		desc->stream.stats.dropped += count - ring->size;
+	}
+
+	return ring_read_acquire(ring, (const void**)data);
+}
+
+void usartd_rx_stream_release(uint8_t iface, uint32_t len)
+{
+	assert(iface < USART_IFACE_COUNT);
+	ring_read_release(&_serial[iface]->stream.ring, len);
+}
+
+void usartd_rx_stream_get_stats(uint8_t iface, struct _usartd_stream_stats* stats)
+{
+	assert(iface < USART_IFACE_COUNT);
+	*stats = _serial[iface]->stream.stats;
+}
@@ -40,6 +40,7 @@
 #include "dma/dma.h"
 #include "io.h"
 #include "mutex.h"
+#include "ring.h"
 #include "serial/usart.h"
 
 /*----------------------------------------------------------------------------
@@ -52,6 +53,7 @@
 #define USARTD_ERROR_LOCK      (3)
 #define USARTD_ERROR_DUPLEX    (4)
 #define USARTD_ERROR_TIMEOUT   (5)
+#define USARTD_ERROR_INVALID   (6)
 
 /*----------------------------------------------------------------------------
  *        Type definitions
@@ -62,6 +64,13 @@ enum _usartd_buf_attr {
 	USARTD_BUF_ATTR_READ  = 0x02,
 };
 
+/** Counters of the continuous receive mode */
+struct _usartd_stream_stats {
+	uint32_t received;  /**< bytes received */
+	uint32_t dropped;   /**< bytes overwritten before being read */
+	uint32_t overruns;  /**< receiver overrun errors */
+};
+
 struct _usart_desc
 {
 	Usart*  addr;
@@ -81,6 +90,15 @@ struct _usart_desc
 		struct _callback callback;
 	} rx, tx;
 
+	/* continuous receive mode */
+	struct {
+		volatile bool running;
+		volatile uint32_t laps;
+		struct _ring ring;
+		struct _callback callback;
+		struct _usartd_stream_stats stats;
+	} stream;
+
 #ifdef CONFIG_HAVE_USART_FIFO
 	bool use_fifo;
 	struct {
@@ -125,6 +143,46 @@ extern void usartd_finish_tx_transfer(uint8_t iface);
 extern uint32_t usartd_tx_is_busy(const uint8_t iface);
 extern void usartd_wait_tx_transfer(const uint8_t iface);
 
+/**
+ * \brief Start continuous reception into a circular buffer
+ *
+ * The DMA runs without interruption, looping over \a buffer, until
+ * usartd_stop_rx_stream() is called. Received data is read with
+ * usartd_rx_stream_get() / usartd_rx_stream_release(). When the line
+ * stays idle for the descriptor timeout, \a cb is invoked from interrupt
+ * context so that partial data can be processed.
+ *
+ * \param iface   Interface index
+ * \param buffer  Cache-aligned buffer
+ * \param size    Buffer size, a power of two and a multiple of the cache
+ *                line size
+ * \param cb      Optional idle-line callback
+ * \return USARTD_SUCCESS, USARTD_ERROR_LOCK if a receive is in progress,
+ *         USARTD_ERROR_INVALID for an invalid buffer
+ */
+extern uint32_t usartd_start_rx_stream(uint8_t iface, uint8_t* buffer, uint32_t size, struct _callback* cb);
+extern void usartd_stop_rx_stream(uint8_t iface);
+
+/**
+ * \brief Get the oldest contiguous span of received data
+ *
+ * \param iface  Interface index
+ * \param data   Receives a pointer to the data, in the stream buffer
+ * \return Number of bytes available at \a data
+ */
+extern uint32_t usartd_rx_stream_get(uint8_t iface, const uint8_t** data);
+
+/**
+ * \brief Release \a len bytes returned by usartd_rx_stream_get()
+ */
+extern void usartd_rx_stream_release(uint8_t iface, uint32_t len);
+
+/**
+ * \brief Get the continuous receive counters, as of the last
+ * usartd_rx_stream_get()
+ */
+extern void usartd_rx_stream_get_stats(uint8_t iface, struct _usartd_stream_stats* stats);
+
 #endif /* CONFIG_HAVE_USART */
 
 #endif /* USARTD_H_ */
@@ -43,6 +43,7 @@
 #ifdef CONFIG_HAVE_QSPI_DMA
 #include "barriers.h"
 #include "dma/dma.h"
+#include "irq/irq.h"
 #include "mm/cache.h"
 #endif
 
@@ -56,40 +57,139 @@
  *        LOCAL FUNCTIONS
  *----------------------------------------------------------------------------*/
 
-static void * qspi_memcpy(union spi_flash_priv* priv, uint8_t *dst, const uint8_t *src, int count, bool use_dma)
+static int qspi_end_transfer(Qspi* qspi, uint32_t timeout)
+{
+	struct _timeout to;
+
+	/* Wait for INSTRuction End */
+	timer_start_timeout(&to, timeout);
+	while (!(qspi->QSPI_SR & QSPI_SR_INSTRE)) {
+		if (timer_timeout_reached(&to)) {
+			trace_debug("qspi_exec timeout reached\r\n");
+			return -ETIMEDOUT;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Notify the caller of a command submitted with a callback.
+ * \return rc
+ */
+static int qspi_exec_done(const struct spi_flash_command *cmd, int rc)
+{
+	if (cmd->callback.method) {
+		struct _callback cb;
+
+		callback_copy(&cb, (struct _callback*)&cmd->callback);
+		callback_call(&cb, (void*)(intptr_t)rc);
+	}
+
+	return rc;
+}
+
+#ifdef CONFIG_HAVE_QSPI_DMA
+static void qspi_irq_handler(uint32_t source, void* user_arg)
+{
+	union spi_flash_priv* priv = (union spi_flash_priv*)user_arg;
+	Qspi* qspi = priv->qspi.addr;
+	struct _callback cb;
+
+	/* Only INSTRE is enabled, by qspi_dma_callback() */
+	if (!(qspi->QSPI_SR & QSPI_SR_INSTRE))
+		return;
+	qspi->QSPI_IDR = QSPI_IDR_INSTRE;
+
+	callback_copy(&cb, &priv->qspi.async.callback);
+	priv->qspi.async.busy = false;
+	callback_call(&cb, (void*)0);
+}
+
+static int qspi_dma_callback(void* arg, void* arg2)
+{
+	union spi_flash_priv* priv = (union spi_flash_priv*)arg;
+	Qspi* qspi = priv->qspi.addr;
+
+	dma_reset_channel(priv->qspi.dma_ch);
+	dsb();
+	cache_invalidate_region(priv->qspi.async.rx_data, priv->qspi.async.rx_len);
+
+	/* Release the chip-select, the command completes on the instruction
+	 * end interrupt */
+	qspi->QSPI_CR = QSPI_CR_LASTXFER;
+	qspi->QSPI_IER = QSPI_IER_INSTRE;
+
+	return 0;
+}
+
+static void qspi_wait_async(union spi_flash_priv* priv)
+{
+	while (priv->qspi.async.busy)
+		dma_poll();
+}
+
+static void qspi_dma_memcpy(union spi_flash_priv* priv, uint8_t *dst, const uint8_t *src, int count, bool async)
+{
+	uint32_t rc;
+	struct _callback cb;
+	struct _dma_transfer_cfg cfg = {
+		.daddr = (void *)dst,
+		.saddr = (void *)src,
+		.len = count,
+	};
+	struct _dma_cfg dma_cfg = {
+		.incr_saddr = true,
+		.incr_daddr = true,
+		.data_width = DMA_DATA_WIDTH_BYTE,
+		.chunk_size = DMA_CHUNK_SIZE_1,
+		.loop = false,
+	};
+
+	/* Use word accesses and 16-beat bursts when alignment allows it */
+	if ((((uint32_t)dst | (uint32_t)src | (uint32_t)count) & 3) == 0) {
+		dma_cfg.data_width = DMA_DATA_WIDTH_WORD;
+		dma_cfg.chunk_size = DMA_CHUNK_SIZE_16;
+		cfg.len = count / 4;
+	}
+
+	callback_set(&cb, async ? qspi_dma_callback : NULL, priv);
+	dma_set_callback(priv->qspi.dma_ch, &cb);
+	dma_configure_transfer(priv->qspi.dma_ch, &dma_cfg, &cfg, 1);
+	rc = dma_start_transfer(priv->qspi.dma_ch);
+	if (rc != 0)
+		trace_fatal("Couldn't start xDMA transfer\n\r");
+	if (async)
+		return;
+
+	while (!dma_is_transfer_done(priv->qspi.dma_ch))
+		dma_poll();
+	dma_reset_channel(priv->qspi.dma_ch);
+	dsb();
+}
+#endif
+
+static void qspi_memcpy(union spi_flash_priv* priv, uint8_t *dst, const uint8_t *src, int count, bool use_dma)
 {
 #ifdef CONFIG_HAVE_QSPI_DMA
 	if (use_dma) {
-		uint32_t rc;
-		struct _dma_transfer_cfg cfg = {
-			.daddr = (void *)dst,
-			.saddr = (void *)src,
-			.len = count,
-		};
-		static struct _dma_cfg dma_cfg = {
-			.incr_saddr = true,
-			.incr_daddr = true,
-			.data_width = DMA_DATA_WIDTH_BYTE,
-			.chunk_size = DMA_CHUNK_SIZE_1,
-			.loop = false,
-		};
-		dma_configure_transfer(priv->qspi.dma_ch, &dma_cfg, &cfg, 1);
-		rc = dma_start_transfer(priv->qspi.dma_ch);
-		if (rc != 0)
-			trace_fatal("Couldn't start xDMA transfer\n\r");
-		while (!dma_is_transfer_done(priv->qspi.dma_ch))
-			dma_poll();
-		dma_reset_channel(priv->qspi.dma_ch);
-		dsb();
-
-		return dst;
+		qspi_dma_memcpy(priv, dst, src, count, false);
+		return;
 	}
 #endif
+	if ((((uint32_t)dst | (uint32_t)src | (uint32_t)count) & 3) == 0) {
+		uint32_t *dst32 = (uint32_t*)dst;
+		const uint32_t *src32 = (const uint32_t*)src;
+
+		for (count /= 4; count; count--)
+			*dst32++ = *src32++;
+		return;
+	}
+
 	while (count--) {
 		*dst++ = *src;
 		src++;
 	}
-	return 0;
 }
 
 static int qspi_set_freq(union spi_flash_priv* priv, uint32_t clock)
@@ -172,6 +272,11 @@ static int qspi_init(union spi_flash_priv* priv)
 	priv->qspi.dma_ch = dma_allocate_channel(DMA_PERIPH_MEMORY, DMA_PERIPH_MEMORY);
 	if (!priv->qspi.dma_ch)
 		trace_fatal("Couldn't allocate XDMA channel\n\r");
+	priv->qspi.async.busy = false;
+
+	qspi->QSPI_IDR = QSPI_IDR_INSTRE;
+	irq_add_handler(get_qspi_id_from_addr(qspi), qspi_irq_handler, priv);
+	irq_enable(get_qspi_id_from_addr(qspi));
 #endif
 
 	return 0;
@@ -181,6 +286,10 @@ static int qspi_cleanup(union spi_flash_priv* priv)
 {
 	Qspi* qspi = priv->qspi.addr;
 
+#ifdef CONFIG_HAVE_QSPI_DMA
+	qspi_wait_async(priv);
+#endif
+
 	qspi->QSPI_CR = QSPI_CR_QSPIDIS;
 	qspi->QSPI_CR = QSPI_CR_SWRST;
 
@@ -306,13 +415,19 @@ static int qspi_exec(union spi_flash_priv* priv, const struct spi_flash_command
 #ifdef QSPI_RICR_RDINST
 	bool icr_write = false;
 #endif
+	int rc;
+
+#ifdef CONFIG_HAVE_QSPI_DMA
+	/* Only one command can be on the bus at a time. */
+	qspi_wait_async(priv);
+#endif
 
 	iar = 0;
 	icr = 0;
 
 	/* Init ifr. */
 	if (qspi_init_ifr(cmd, &ifr))
-		return -1;
+		return qspi_exec_done(cmd, -1);
 
 	/* Compute instruction parameters. */
 #ifdef QSPI_RICR_RDINST
@@ -477,10 +592,10 @@ next:
 	(void)qspi->QSPI_IFR;
 
 #ifdef CONFIG_HAVE_QSPI_DMA
-	if (((cmd->flags == QSPI_IFR_TFRTYP_TRSFR_WRITE_MEMORY) &&
+	if ((((cmd->flags & SFLASH_TYPE_MASK) == SFLASH_TYPE_WRITE) &&
 	     IS_CACHE_ALIGNED(cmd->tx_data) &&
 	     IS_CACHE_ALIGNED(cmd->data_len)) ||
-	    ((cmd->flags == QSPI_IFR_TFRTYP_TRSFR_READ_MEMORY) &&
+	    (((cmd->flags & SFLASH_TYPE_MASK) == SFLASH_TYPE_READ) &&
 	     IS_CACHE_ALIGNED(cmd->rx_data) &&
 	     IS_CACHE_ALIGNED(cmd->data_len)))
 		use_dma = true;
@@ -510,6 +625,17 @@ next:
 #endif
 			ptr = priv->qspi.mem;
 
+#ifdef CONFIG_HAVE_QSPI_DMA
+		if (use_dma && cmd->callback.method) {
+			/* Completion is handled by qspi_dma_callback() */
+			priv->qspi.async.busy = true;
+			priv->qspi.async.rx_data = cmd->rx_data;
+			priv->qspi.async.rx_len = cmd->data_len;
+			callback_copy(&priv->qspi.async.callback, (struct _callback*)&cmd->callback);
+			qspi_dma_memcpy(priv, cmd->rx_data, ptr + offset, cmd->data_len, true);
+			return 0;
+		}
+#endif
 		qspi_memcpy(priv, cmd->rx_data, ptr + offset, cmd->data_len, use_dma);
 #ifdef CONFIG_HAVE_QSPI_DMA
 		if (use_dma)
@@ -517,24 +643,16 @@ next:
 #endif
 	} else {
 		/* Stop here for continuous read */
-		return 0;
+		return qspi_exec_done(cmd, 0);
 	}
 
 	/* Release the chip-select. */
 	qspi->QSPI_CR = QSPI_CR_LASTXFER;
 
 no_data:
-	{
-		/* Wait for INSTRuction End */
-		struct _timeout timeout;
-		timer_start_timeout(&timeout, cmd->timeout);
-		while (!(qspi->QSPI_SR & QSPI_SR_INSTRE)) {
-			if (timer_timeout_reached(&timeout)) {
-				trace_debug("qspi_exec timeout reached\r\n");
-				return -ETIMEDOUT;
-			}
-		}
-	}
+	rc = qspi_end_transfer(qspi, cmd->timeout);
+	if (rc < 0)
+		return qspi_exec_done(cmd, rc);
 
 #ifdef QSPI_VERBOSE_DEBUG
 	{
@@ -556,7 +674,8 @@ no_data:
 	}
 #endif /* QSPI_VERBOSE_DEBUG */
 
-	return 0;
+	/* Synchronous completion of a command submitted with a callback */
+	return qspi_exec_done(cmd, 0);
 }
 
 static const struct spi_ops qspi_ops = {
@@ -29,6 +29,7 @@
 #ifndef	QSPI_H_
 #define	QSPI_H_
 
+#include "callback.h"
 #ifdef CONFIG_HAVE_QSPI_DMA
 #include "dma/dma.h"
 #include "mm/cache.h"
@@ -50,6 +51,14 @@ struct qspi_priv {
 #endif
 #ifdef CONFIG_HAVE_QSPI_DMA
 	struct _dma_channel *dma_ch;
+
+	/* pending asynchronous read */
+	struct {
+		volatile bool busy;
+		void* rx_data;
+		size_t rx_len;
+		struct _callback callback;
+	} async;
 #endif
 };
 
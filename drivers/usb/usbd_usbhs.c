@@ -52,9 +52,12 @@
 
 #include "barriers.h"
 #include "chip.h"
+#include "intmath.h"
 #include "irq/irq.h"
+#include "irqflags.h"
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
+#include "timer.h"
 #include "trace.h"
 #include "usb/device/usbd_hal.h"
 
@@ -73,12 +76,21 @@
 /** Max size of the DMA FIFO */
 #define DMA_MAX_FIFO_SIZE     (32768)
 
+/** Max number of DMA descriptors for one payload (header and 3 banks) */
+#define PAYLOAD_MAX_DESCS     (4)
+
 /** FIFO space size in bytes */
 #define EPT_VIRTUAL_SIZE      (32768)
 
 /** Number of endpoints */
 #define USB_ENDPOINTS FIELD_ARRAY_SIZE(Usbhs, USBHS_DEVEPTCFG)
 
+/** Number of DMA channels (endpoints 1 to USB_DMA_CHANNELS) */
+#define USB_DMA_CHANNELS      FIELD_ARRAY_SIZE(Usbhs, USBHS_DEVDMA)
+
+/** NAK handshake flags of an endpoint */
+#define EPT_NAK_FLAGS         (USBHS_DEVEPTISR_NAKINI | USBHS_DEVEPTISR_NAKOUTI)
+
 /** Get Number of buffer in Multi-Buffer-List
  *  \param i    input index
  *  \param o    output index
@@ -201,6 +213,24 @@ struct _endpoint {
 
 	/** Special case for send a ZLP */
 	uint32_t send_zlp;
+
+	/** Terminate DMA IN transfers with a ZLP when they end on a packet
+	 *  boundary */
+	bool auto_zlp;
+
+	/** Number of descriptors in the DMA chain of the endpoint */
+	uint8_t dma_count;
+
+	/** Statistics, see usbd_hal_get_stats() */
+	struct {
+		uint32_t transfers;
+		uint32_t bytes;
+		uint32_t naks;
+		uint32_t rearms;
+		uint64_t gap_max;    /**< in raw timer ticks */
+		uint64_t gap_total;  /**< in raw timer ticks */
+		uint64_t idle_tick;  /**< end of the last transfer */
+	} stats;
 };
 
 /**
@@ -210,7 +240,7 @@ struct _usb_dma_desc {
 	void     *next;
 	void     *addr;
 	uint32_t  ctrl;
-	uint32_t  reserved; /** reverved (padding) */
+	uint32_t  length; /** buffer length, not used by the controller */
 };
 
 /*---------------------------------------------------------------------------
@@ -239,7 +269,28 @@ static struct _endpoint endpoints[USB_ENDPOINTS];
 static bool force_full_speed = false;
 
 /** DMA link list */
-CACHE_ALIGNED static struct _usb_dma_desc dma_desc[4];
+CACHE_ALIGNED static struct _usb_dma_desc dma_desc[USBD_HAL_MAX_PAYLOADS * PAYLOAD_MAX_DESCS];
+
+/** DMA descriptors of the looped payload chains */
+CACHE_ALIGNED static struct _usb_dma_desc chain_desc[USBD_HAL_MAX_CHAINS][USBD_HAL_MAX_PAYLOADS * PAYLOAD_MAX_DESCS];
+
+/** Payload chains looped on an isochronous IN endpoint, see
+ *  usbd_hal_start_payloads() */
+static struct {
+	/** Endpoint running the chains, 0 if none */
+	uint8_t ep;
+	/** Number of chains in the loop */
+	uint8_t chains;
+	/** Chain being processed by the DMA */
+	uint8_t current;
+	/** Number of descriptors of each chain */
+	uint8_t count[USBD_HAL_MAX_CHAINS];
+	/** Number of bytes of each chain */
+	uint32_t size[USBD_HAL_MAX_CHAINS];
+} payload_loop;
+
+/** DMA descriptor chains of the endpoints (single and list transfers) */
+CACHE_ALIGNED static struct _usb_dma_desc ep_dma_desc[USB_DMA_CHANNELS][USBD_HAL_MAX_BUFFERS];
 
 /*---------------------------------------------------------------------------
  *      Internal Functions
@@ -496,6 +547,28 @@ static void _usbd_hal_read_fifo_buffer(uint8_t ep, uint8_t* data, uint32_t size)
 		*(data++) = *(fifo++);
 }
 
+/**
+ * Account the gap before a new transfer on the given endpoint: if the host
+ * has been NAKed since the end of the previous transfer, the time spent
+ * idle is counted as a gap.
+ * \param ep Endpoint number.
+ */
+static void _usbd_hal_stats_start(uint8_t ep)
+{
+	struct _endpoint *endpoint = &endpoints[ep];
+	uint64_t gap;
+
+	if (ep == 0 || !(_usbd_hal_endpoint_get_status(ep) & EPT_NAK_FLAGS))
+		return;
+	_usbd_hal_endpoint_clear_status(ep, EPT_NAK_FLAGS);
+
+	gap = timer_get_interval(endpoint->stats.idle_tick, timer_get_raw_tick());
+	endpoint->stats.naks++;
+	endpoint->stats.gap_total += gap;
+	if (gap > endpoint->stats.gap_max)
+		endpoint->stats.gap_max = gap;
+}
+
 /**
  * Handles a completed transfer on the given endpoint, invoking the
  * configured callback if any.
@@ -524,7 +597,15 @@ static void _usbd_hal_end_of_transfer(uint8_t ep, uint8_t status)
 			if (endpoint->state == USB_HAL_ENDPOINT_SENDING)
 				endpoint->send_zlp = 0;
 
+			if (ep) {
+				endpoint->stats.transfers++;
+				endpoint->stats.bytes += transferred;
+				endpoint->stats.idle_tick = timer_get_raw_tick();
+				_usbd_hal_endpoint_clear_status(ep, EPT_NAK_FLAGS);
+			}
+
 			endpoint->state = USB_HAL_ENDPOINT_IDLE;
+			endpoint->dma_count = 0;
 			xfer->data = NULL;
 			xfer->transferred = -1;
 			xfer->buffered = -1;
@@ -887,25 +968,273 @@ static void _usbd_hal_endpoint_handler(uint8_t ep)
 }
 
 /**
- * DMA Single transfer
- * \param ep EP number
- * \param xfer Pointer to transfer instance
- * \param cfg DMA Control configuration (excluding length)
+ * Terminate a descriptor list and start the DMA.
+ * The end of buffer interrupt of the last descriptor ends the transfer.
+ * \param ep Endpoint number
+ * \param desc Descriptor list
+ * \param count Number of descriptors in the list
  */
-static void _usbd_hal_dma_single(uint8_t ep, struct _single_xfer *xfer, uint32_t cfg)
+static void _usbd_hal_dma_start_chain(uint8_t ep, struct _usb_dma_desc *desc,
+		uint32_t count)
 {
-	uint32_t start_addr = (uint32_t)&xfer->data[xfer->transferred];
+	struct _usb_dma_desc *last = &desc[count - 1];
 
-	/* Single transfer */
-	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMAADDRESS = start_addr;
-	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMASTATUS = USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMASTATUS;
+	last->next = NULL;
+	last->ctrl = (last->ctrl & ~USBHS_DEVDMACONTROL_LDNXT_DSC)
+		| USBHS_DEVDMACONTROL_END_BUFFIT;
 
-	/* DMA Configure */
-	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMACONTROL = 0;
-	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMACONTROL = cfg | USBHS_DEVDMACONTROL_BUFF_LENGTH(xfer->buffered);;
+	/* Flush DMA descriptors */
+	cache_clean_region(desc, count * sizeof(desc[0]));
 
 	/* Interrupt enable */
 	_usbd_hal_endpoint_dma_interrupt_enable(ep);
+
+	/* Start transfer with LLI */
+	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMANXTDSC = (uint32_t)desc;
+	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMACONTROL = 0;
+	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMACONTROL = USBHS_DEVDMACONTROL_LDNXT_DSC;
+}
+
+/**
+ * Append a buffer to the DMA chain of an endpoint, using one descriptor per
+ * DMA_MAX_FIFO_SIZE bytes.
+ * \param ep Endpoint number
+ * \param data Pointer to the buffer
+ * \param size Size of the buffer
+ * \param cfg DMA Control configuration (excluding length)
+ * \return Number of bytes queued, less than size if the chain is full
+ */
+static uint32_t _usbd_hal_dma_queue(uint8_t ep, void *data, uint32_t size,
+		uint32_t cfg)
+{
+	struct _endpoint *endpoint = &endpoints[ep];
+	struct _usb_dma_desc *desc;
+	uint8_t *ptr = (uint8_t*)data;
+	uint32_t len, queued = 0;
+
+	while (size > 0 && endpoint->dma_count < USBD_HAL_MAX_BUFFERS) {
+		len = min_u32(size, DMA_MAX_FIFO_SIZE);
+		desc = &ep_dma_desc[ep - 1][endpoint->dma_count];
+		if (endpoint->dma_count > 0)
+			desc[-1].next = desc;
+		desc->next = NULL;
+		desc->addr = ptr;
+		desc->ctrl = cfg | USBHS_DEVDMACONTROL_CHANN_ENB
+			| USBHS_DEVDMACONTROL_BUFF_LENGTH(len)
+			| USBHS_DEVDMACONTROL_LDNXT_DSC;
+		desc->length = len;
+		endpoint->dma_count++;
+		ptr += len;
+		size -= len;
+		queued += len;
+	}
+
+	return queued;
+}
+
+/**
+ * Start the DMA chain of an endpoint, queued with _usbd_hal_dma_queue.
+ * The last descriptor validates the bank at its end.
+ * \param ep Endpoint number
+ */
+static void _usbd_hal_dma_start_queue(uint8_t ep)
+{
+	struct _endpoint *endpoint = &endpoints[ep];
+
+	ep_dma_desc[ep - 1][endpoint->dma_count - 1].ctrl |= USBHS_DEVDMACONTROL_END_B_EN;
+	_usbd_hal_dma_start_chain(ep, ep_dma_desc[ep - 1], endpoint->dma_count);
+}
+
+/**
+ * DMA Single transfer: chain the remaining part of the transfer buffer
+ * (up to USBD_HAL_MAX_BUFFERS descriptors) and start the DMA.
+ * \param ep EP number
+ */
+static void _usbd_hal_dma_single(uint8_t ep)
+{
+	struct _endpoint *endpoint = &endpoints[ep];
+	struct _single_xfer *xfer = &endpoint->transfer.single;
+	uint32_t cfg = 0;
+
+	/* OUT: a short packet ends the transfer */
+	if (endpoint->state == USB_HAL_ENDPOINT_RECEIVING)
+		cfg = USBHS_DEVDMACONTROL_END_TR_EN | USBHS_DEVDMACONTROL_END_TR_IT;
+
+	endpoint->dma_count = 0;
+	xfer->buffered = _usbd_hal_dma_queue(ep,
+			&xfer->data[xfer->transferred], xfer->remaining, cfg);
+
+	_usbd_hal_dma_start_queue(ep);
+}
+
+/**
+ * Get the number of bytes transferred by the DMA chain of an endpoint.
+ * The descriptor being processed is found from the next descriptor
+ * address, the descriptors before it are complete.
+ * \param ep Endpoint number
+ * \param dma_status DMA status
+ * \return Number of bytes transferred
+ */
+static uint32_t _usbd_hal_dma_chain_transferred(uint8_t ep, uint32_t dma_status)
+{
+	struct _endpoint *endpoint = &endpoints[ep];
+	struct _usb_dma_desc *desc = ep_dma_desc[ep - 1];
+	struct _usb_dma_desc *next;
+	uint32_t i, current, transferred = 0;
+
+	next = (struct _usb_dma_desc*)USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMANXTDSC;
+	if (next > desc && next < &desc[endpoint->dma_count])
+		current = next - desc - 1;
+	else
+		current = endpoint->dma_count - 1;
+
+	for (i = 0; i < current; i++)
+		transferred += desc[i].length;
+
+	return transferred + desc[current].length
+		- ((dma_status & USBHS_DEVDMASTATUS_BUFF_COUNT_Msk)
+			>> USBHS_DEVDMASTATUS_BUFF_COUNT_Pos);
+}
+
+/**
+ * Invalidate the buffers of the DMA chain of an endpoint after reception
+ * \param ep Endpoint number
+ * \param size Number of bytes received
+ */
+static void _usbd_hal_dma_invalidate(uint8_t ep, uint32_t size)
+{
+	struct _endpoint *endpoint = &endpoints[ep];
+	struct _usb_dma_desc *desc = ep_dma_desc[ep - 1];
+	uint32_t i, len;
+
+	for (i = 0; i < endpoint->dma_count && size > 0; i++) {
+		len = min_u32(desc[i].length, size);
+		cache_invalidate_region(desc[i].addr, len);
+		size -= len;
+	}
+}
+
+/**
+ * Build the DMA descriptors sending one payload (header followed by data).
+ * On a high bandwidth isochronous endpoint the data is split so that the
+ * payload fills at most one bank per transaction of the micro-frame.
+ * The descriptors are linked to the next one, see _usbd_hal_dma_start_chain.
+ * \param ep Endpoint number
+ * \param desc First descriptor to fill (up to PAYLOAD_MAX_DESCS)
+ * \param header Pointer to header
+ * \param header_len Size of header
+ * \param data Pointer to the data
+ * \param data_len Size of the data
+ * \param queued Receives the number of bytes queued (header included)
+ * \return Number of descriptors used
+ */
+static uint32_t _usbd_hal_build_payload(uint8_t ep, struct _usb_dma_desc *desc,
+		const void *header, uint32_t header_len,
+		const void *data, uint32_t data_len, uint32_t *queued)
+{
+	struct _endpoint *endpoint = &endpoints[ep];
+	uint8_t nb_trans = (_usbd_hal_endpoint_get_config(ep) & USBHS_DEVEPTCFG_NBTRANS_Msk) >> USBHS_DEVEPTCFG_NBTRANS_Pos;
+	uint8_t *data_ptr = (uint8_t*)data;
+	uint32_t pkt_len, count = 0;
+
+	/* header - load to fifo without ending the bank */
+	if (header_len) {
+		desc[count].next = &desc[count + 1];
+		desc[count].addr = (void*)header;
+		desc[count].ctrl = USBHS_DEVDMACONTROL_CHANN_ENB
+			| USBHS_DEVDMACONTROL_BUFF_LENGTH(header_len)
+			| USBHS_DEVDMACONTROL_LDNXT_DSC;
+		desc[count].length = header_len;
+		count++;
+	}
+
+	if (nb_trans > 1) {
+		/* High bandwidth ISO EP, max size n*ep_size */
+		if (data_len > nb_trans * endpoint->size - header_len)
+			data_len = nb_trans * endpoint->size - header_len;
+		pkt_len = endpoint->size - header_len;
+	} else {
+		if (data_len > DMA_MAX_FIFO_SIZE - header_len)
+			data_len = DMA_MAX_FIFO_SIZE - header_len;
+		pkt_len = data_len;
+	}
+	*queued = header_len + data_len;
+
+	/* data - one descriptor per bank */
+	do {
+		if (pkt_len > data_len)
+			pkt_len = data_len;
+		desc[count].next = &desc[count + 1];
+		desc[count].addr = data_ptr;
+		desc[count].ctrl = USBHS_DEVDMACONTROL_CHANN_ENB
+			| USBHS_DEVDMACONTROL_BUFF_LENGTH(pkt_len)
+			| USBHS_DEVDMACONTROL_END_B_EN
+			| USBHS_DEVDMACONTROL_LDNXT_DSC;
+		desc[count].length = pkt_len;
+		count++;
+		data_ptr += pkt_len;
+		data_len -= pkt_len;
+		pkt_len = endpoint->size;
+	} while (data_len > 0);
+
+	return count;
+}
+
+/**
+ * Link the last descriptor of a payload chain to the first descriptor of the
+ * next chain of the loop. Its end of buffer interrupt reports the chain.
+ * \param chain Chain index
+ */
+static void _usbd_hal_dma_link_chain(uint8_t chain)
+{
+	struct _usb_dma_desc *last = &chain_desc[chain][payload_loop.count[chain] - 1];
+
+	last->next = chain_desc[(chain + 1) % payload_loop.chains];
+	last->ctrl |= USBHS_DEVDMACONTROL_LDNXT_DSC | USBHS_DEVDMACONTROL_END_BUFFIT;
+
+	/* Flush DMA descriptors */
+	cache_clean_region(chain_desc[chain],
+			payload_loop.count[chain] * sizeof(chain_desc[0][0]));
+}
+
+/**
+ * DMA interrupt of the looped payload chains: the transfer callback is
+ * invoked once for each chain completed since the previous interrupt.
+ * \param ep Endpoint number
+ */
+static void _usbd_hal_dma_loop_handler(uint8_t ep)
+{
+	struct _endpoint *endpoint = &endpoints[ep];
+	const uint32_t stride = ARRAY_SIZE(chain_desc[0]);
+	struct _usb_dma_desc *next;
+	uint32_t index;
+	uint8_t chain, current;
+
+	/* The DMA processes the descriptor before the next one: the chain of
+	 * the next descriptor, or the previous chain if it is the first one */
+	next = (struct _usb_dma_desc*)USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMANXTDSC;
+	if (next < chain_desc[0] || next >= chain_desc[payload_loop.chains])
+		return;
+	index = next - chain_desc[0];
+	current = index / stride;
+	if (index % stride == 0)
+		current = (current + payload_loop.chains - 1) % payload_loop.chains;
+
+	while (payload_loop.current != current) {
+		chain = payload_loop.current;
+		payload_loop.current = (chain + 1) % payload_loop.chains;
+
+		endpoint->stats.transfers++;
+		endpoint->stats.bytes += payload_loop.size[chain];
+
+		if (endpoint->transfer.callback)
+			endpoint->transfer.callback(endpoint->transfer.callback_arg,
+					USBD_STATUS_SUCCESS, payload_loop.size[chain], 0);
+
+		/* Stopped from the callback */
+		if (ep != payload_loop.ep)
+			break;
+	}
 }
 
 /**
@@ -917,12 +1246,18 @@ static void _usbd_hal_dma_handler(uint8_t ep)
 {
 	struct _endpoint *endpoint = &endpoints[ep];
 	struct _single_xfer *xfer = &endpoint->transfer.single;
-	uint32_t dma_status, remaining, transferred;
+	uint32_t dma_status, transferred;
 	uint8_t rc = USBD_STATUS_SUCCESS;
 
 	dma_status = USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMASTATUS;
 	USB_HAL_TRACE("iDma%d,%x ", ep, (unsigned)dma_status);
 
+	/* Looped payload chains */
+	if (ep == payload_loop.ep) {
+		_usbd_hal_dma_loop_handler(ep);
+		return;
+	}
+
 	/* Multi transfer */
 	if (endpoint->state == USB_HAL_ENDPOINT_SENDINGM ||
 		endpoint->state == USB_HAL_ENDPOINT_RECEIVINGM) {
@@ -934,49 +1269,37 @@ static void _usbd_hal_dma_handler(uint8_t ep)
 	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMACONTROL &=
 		~(USBHS_DEVDMACONTROL_END_TR_EN | USBHS_DEVDMACONTROL_END_B_EN);
 
-	if (dma_status & USBHS_DEVDMASTATUS_END_BF_ST) {
-		USB_HAL_TRACE("EoDmaB ");
+	if (dma_status & (USBHS_DEVDMASTATUS_END_BF_ST | USBHS_DEVDMASTATUS_END_TR_ST)) {
+		USB_HAL_TRACE("EoDma%s ",
+				dma_status & USBHS_DEVDMASTATUS_END_TR_ST ? "T" : "B");
 
-		/* BUFF_COUNT holds the number of untransmitted bytes.
-		   BUFF_COUNT is equal to zero in case of good transfer */
-		remaining = (dma_status & USBHS_DEVDMASTATUS_BUFF_COUNT_Msk)
-			>> USBHS_DEVDMASTATUS_BUFF_COUNT_Pos;
-
-		USB_HAL_TRACE("C%d ", (unsigned)remaining);
-		transferred = xfer->buffered - remaining;
+		if (endpoint->dma_count) {
+			transferred = _usbd_hal_dma_chain_transferred(ep, dma_status);
+			/* invalidate cache if receiving */
+			if (endpoint->state == USB_HAL_ENDPOINT_RECEIVING)
+				_usbd_hal_dma_invalidate(ep, transferred);
+		} else {
+			/* Payload list: BUFF_COUNT of the last descriptor */
+			transferred = xfer->buffered -
+				((dma_status & USBHS_DEVDMASTATUS_BUFF_COUNT_Msk)
+					>> USBHS_DEVDMASTATUS_BUFF_COUNT_Pos);
+		}
 
 		xfer->transferred += transferred;
-		xfer->buffered = remaining;
 		xfer->remaining -= transferred;
-
-		USB_HAL_TRACE("[B%d:T%d:R%d] ", (int)xfer->buffered,
-				   (int)xfer->transferred, (int)xfer->remaining);
-
-		/* There is still data */
-		if (xfer->remaining + xfer->buffered > 0) {
-			if (xfer->remaining > DMA_MAX_FIFO_SIZE) {
-				xfer->buffered = DMA_MAX_FIFO_SIZE;
-			} else {
-				xfer->buffered = xfer->remaining;
-			}
-
-			/* Single transfer again */
-			_usbd_hal_dma_single(ep, xfer,
-					USBHS_DEVDMACONTROL_END_TR_EN |
-					USBHS_DEVDMACONTROL_END_TR_IT |
-					USBHS_DEVDMACONTROL_END_B_EN |
-					USBHS_DEVDMACONTROL_END_BUFFIT |
-					USBHS_DEVDMACONTROL_CHANN_ENB);
+		xfer->buffered = 0;
+
+		USB_HAL_TRACE("[T%d:R%d] ", (int)xfer->transferred,
+				(int)xfer->remaining);
+
+		if (dma_status & USBHS_DEVDMASTATUS_END_TR_ST) {
+			/* Short packet received, end of transfer */
+			xfer->remaining = 0;
+		} else if (xfer->remaining > 0) {
+			/* The buffer did not fit in the chain, queue the rest */
+			endpoint->stats.rearms++;
+			_usbd_hal_dma_single(ep);
 		}
-	} else if (dma_status & USBHS_DEVDMASTATUS_END_TR_ST) {
-		USB_HAL_TRACE("EoDmaT ");
-
-		xfer->transferred = xfer->buffered -
-			((dma_status & USBHS_DEVDMASTATUS_BUFF_COUNT_Msk) >> USBHS_DEVDMASTATUS_BUFF_COUNT_Pos);
-		xfer->remaining = 0;
-
-		USB_HAL_TRACE("[B%d:T%d] ", (int)xfer->buffered,
-				   (int)xfer->transferred);
 	} else {
 		trace_error("_usbd_hal_dma_handler: ST 0x%x\n\r",
 				(unsigned)dma_status);
@@ -984,13 +1307,20 @@ static void _usbd_hal_dma_handler(uint8_t ep)
 		rc = USBD_STATUS_ABORTED;
 	}
 
+	/* The controller has no hardware ZLP: send it from the endpoint
+	 * interrupt, as for FIFO transfers */
+	if (xfer->remaining == 0 && rc == USBD_STATUS_SUCCESS &&
+	    endpoint->state == USB_HAL_ENDPOINT_SENDING && endpoint->auto_zlp &&
+	    xfer->transferred > 0 && xfer->transferred % endpoint->size == 0) {
+		endpoint->send_zlp = 1;
+		_usbd_hal_endpoint_interrupt_enable(ep);
+		_usbd_hal_endpoint_control_enable(ep, USBHS_DEVEPTIER_TXINES);
+		return;
+	}
+
 	/* Callback */
-	if (xfer->remaining == 0) {
-		/* invalidate cache if receiving */
-		if (endpoint->state == USB_HAL_ENDPOINT_RECEIVING && xfer->transferred)
-			cache_invalidate_region(xfer->data, xfer->transferred);
+	if (xfer->remaining == 0)
 		_usbd_hal_end_of_transfer(ep, rc);
-	}
 }
 
 /**
@@ -1034,22 +1364,15 @@ static uint8_t _usbd_hal_write(uint8_t ep,
 	xfer->buffered = 0;
 	xfer->transferred = 0;
 
+	_usbd_hal_stats_start(ep);
+
 	/* 1. DMA supported, 2. Not ZLP */
 	if (CHIP_USB_ENDPOINT_HAS_DMA(ep) && xfer->remaining > 0) {
 		/* Enable automatic bank switch for DMA */
 		_usbd_auto_switch_bank_enable(ep, true);
 
-		if (xfer->remaining > DMA_MAX_FIFO_SIZE) {
-			xfer->buffered = DMA_MAX_FIFO_SIZE;
-		} else {
-			xfer->buffered = xfer->remaining;
-		}
-
 		/* Single transfer */
-		_usbd_hal_dma_single(ep, xfer,
-				USBHS_DEVDMACONTROL_END_B_EN |
-				USBHS_DEVDMACONTROL_END_BUFFIT |
-				USBHS_DEVDMACONTROL_CHANN_ENB);
+		_usbd_hal_dma_single(ep);
 	} else {
 		/* Wait for the bank to be free before disabling the automatic bank switch in order
 		 * to transfer data in FIFO mode correctly when the last is done with DMA.
@@ -1201,21 +1524,12 @@ static uint8_t _usbd_hal_read(uint8_t ep, void *data, uint32_t data_len)
 	xfer->buffered = 0;
 	xfer->transferred = 0;
 
+	_usbd_hal_stats_start(ep);
+
 	/* If: 1. DMA supported, 2. Has data */
 	if (CHIP_USB_ENDPOINT_HAS_DMA(ep) && xfer->remaining > 0) {
-		/* DMA XFR size adjust */
-		if (xfer->remaining > DMA_MAX_FIFO_SIZE)
-			xfer->buffered = DMA_MAX_FIFO_SIZE;
-		else
-			xfer->buffered = xfer->remaining;
-
 		/* Single transfer */
-		_usbd_hal_dma_single(ep, xfer,
-				USBHS_DEVDMACONTROL_END_TR_EN |
-				USBHS_DEVDMACONTROL_END_TR_IT |
-				USBHS_DEVDMACONTROL_END_B_EN |
-				USBHS_DEVDMACONTROL_END_BUFFIT |
-				USBHS_DEVDMACONTROL_CHANN_ENB);
+		_usbd_hal_dma_single(ep);
 	} else {
 		/* Enable IT */
 		_usbd_hal_endpoint_interrupt_enable(ep);
@@ -1365,6 +1679,12 @@ void usbd_hal_reset_endpoints(uint32_t endpoint_bits, uint8_t status, bool keep_
 			/* save endpoint config */
 			ep_cfg = _usbd_hal_endpoint_get_config(ep);
 
+			/* Stop looped payload chains */
+			if (ep == payload_loop.ep) {
+				USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMACONTROL = 0;
+				payload_loop.ep = 0;
+			}
+
 			/* Reset endpoint */
 			_usbd_hal_endpoint_reset(ep);
 
@@ -1621,6 +1941,7 @@ uint8_t usbd_hal_write_with_header(uint8_t ep,
 {
 	struct _endpoint *endpoint = &endpoints[ep];
 	struct _single_xfer *xfer = &endpoint->transfer.single;
+	uint32_t count, queued;
 
 	if (header_len)
 		cache_clean_region(header, header_len);
@@ -1641,6 +1962,8 @@ uint8_t usbd_hal_write_with_header(uint8_t ep,
 
 	USB_HAL_TRACE("Wr%d(%d+%d) ", ep, (unsigned)header_len, (unsigned)data_len);
 
+	_usbd_hal_stats_start(ep);
+
 	/* Setup transfer descriptor */
 	endpoint->transfer.use_multi = false;
 	xfer->data = (void*)data;
@@ -1650,113 +1973,12 @@ uint8_t usbd_hal_write_with_header(uint8_t ep,
 
 	/* use DMA except for ZLP */
 	if (header_len + data_len > 0) {
-		uint8_t nb_trans = (_usbd_hal_endpoint_get_config(ep) & USBHS_DEVEPTCFG_NBTRANS_Msk) >> USBHS_DEVEPTCFG_NBTRANS_Pos;
-
-		if (xfer->remaining > DMA_MAX_FIFO_SIZE) {
-			/* Transfer the max */
-			xfer->buffered = DMA_MAX_FIFO_SIZE;
-		} else {
-			/* Good size, total size */
-			xfer->buffered = xfer->remaining;
-		}
-
-		/* LD1: header - load to fifo without interrupt */
-		/* Header discarded if exceed the DMA FIFO length */
-		//if (header_len > DMA_MAX_FIFO_SIZE) header_len = DMA_MAX_FIFO_SIZE;
-		dma_desc[0].next = &dma_desc[1];
-		dma_desc[0].addr = (void*)header;
-		dma_desc[0].ctrl = USBHS_DEVDMACONTROL_CHANN_ENB
-			| USBHS_DEVDMACONTROL_BUFF_LENGTH(header_len)
-			| USBHS_DEVDMACONTROL_LDNXT_DSC;
-		dma_desc[0].reserved = 0;
-
-		/* High bandwidth ISO EP, max size n*ep_size */
-		if (nb_trans > 1) {
-			uint8_t *data_ptr = (uint8_t*)data;
-			uint32_t max_size = nb_trans * endpoint->size;
-
-			data_len = xfer->buffered - header_len;
-			if (data_len > max_size)
-				data_len = max_size;
-
-			uint32_t pkt_len;
-
-			/* LD2: data   -  bank 0 */
-			pkt_len = endpoint->size - header_len;
-			if (pkt_len >= data_len) {
-				dma_desc[1].next = NULL;
-				dma_desc[1].addr = data_ptr;
-				dma_desc[1].ctrl = USBHS_DEVDMACONTROL_CHANN_ENB |
-					USBHS_DEVDMACONTROL_BUFF_LENGTH(data_len) |
-					USBHS_DEVDMACONTROL_END_B_EN |
-					USBHS_DEVDMACONTROL_END_BUFFIT;
-				dma_desc[1].reserved = 0;
-			} else {
-				dma_desc[1].next = &dma_desc[2];
-				dma_desc[1].addr = data_ptr;
-				dma_desc[1].ctrl = USBHS_DEVDMACONTROL_CHANN_ENB |
-					USBHS_DEVDMACONTROL_BUFF_LENGTH(pkt_len) |
-					USBHS_DEVDMACONTROL_END_B_EN |
-					USBHS_DEVDMACONTROL_LDNXT_DSC;
-				dma_desc[1].reserved = 0;
-				data_len -= pkt_len;
-				data_ptr += pkt_len;
-
-				/* LD3: data  - bank 1 */
-				pkt_len = endpoint->size;
-				if (pkt_len >= data_len) {
-					dma_desc[2].next = NULL;
-					dma_desc[2].addr = data_ptr;
-					dma_desc[2].ctrl = USBHS_DEVDMACONTROL_CHANN_ENB |
-						USBHS_DEVDMACONTROL_BUFF_LENGTH(data_len) |
-						USBHS_DEVDMACONTROL_END_B_EN |
-						USBHS_DEVDMACONTROL_END_BUFFIT;
-					dma_desc[2].reserved = 0;
-				} else {
-					dma_desc[2].next = &dma_desc[3];
-					dma_desc[2].addr = data_ptr;
-					dma_desc[2].ctrl = USBHS_DEVDMACONTROL_CHANN_ENB |
-						USBHS_DEVDMACONTROL_BUFF_LENGTH(pkt_len) |
-						USBHS_DEVDMACONTROL_END_B_EN |
-						USBHS_DEVDMACONTROL_LDNXT_DSC;
-					dma_desc[2].reserved = 0;
-					data_len -= pkt_len;
-					data_ptr += pkt_len;
-
-					/* LD4: data  - bank 2 */
-					dma_desc[3].next = NULL;
-					dma_desc[3].addr = data_ptr;
-					dma_desc[3].ctrl = USBHS_DEVDMACONTROL_CHANN_ENB |
-						USBHS_DEVDMACONTROL_BUFF_LENGTH(data_len) |
-						USBHS_DEVDMACONTROL_END_B_EN |
-						USBHS_DEVDMACONTROL_END_BUFFIT;
-					dma_desc[3].reserved = 0;
-				}
-			}
-		}
-		/* Normal, fill all data */
-		else {
-			/* LD2: data   -  load to fifo with interrupt */
-			data_len = xfer->buffered - header_len;
-			dma_desc[1].next = NULL;
-			dma_desc[1].addr = (void*)data;
-			dma_desc[1].ctrl = USBHS_DEVDMACONTROL_CHANN_ENB
-				| USBHS_DEVDMACONTROL_BUFF_LENGTH(data_len)
-				| USBHS_DEVDMACONTROL_END_B_EN
-				| USBHS_DEVDMACONTROL_END_BUFFIT;
-			dma_desc[1].reserved = 0;
-		}
-
-		/* Flush DMA descriptors */
-		cache_clean_region(dma_desc, sizeof(dma_desc));
-
-		/* Interrupt enable */
-		_usbd_hal_endpoint_dma_interrupt_enable(ep);
+		count = _usbd_hal_build_payload(ep, dma_desc, header, header_len,
+				data, data_len, &queued);
+		xfer->remaining = queued;
+		xfer->buffered = queued;
 
-		/* Start transfer with LLI */
-		USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMANXTDSC = (uint32_t)dma_desc;
-		USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMACONTROL = 0;
-		USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMACONTROL = USBHS_DEVDMACONTROL_LDNXT_DSC;
+		_usbd_hal_dma_start_chain(ep, dma_desc, count);
 	} else {
 		/* Enable IT */
 		_usbd_hal_endpoint_interrupt_enable(ep);
@@ -1768,6 +1990,302 @@ uint8_t usbd_hal_write_with_header(uint8_t ep,
 	return USBD_STATUS_SUCCESS;
 }
 
+/**
+ * Build the DMA descriptors of a payload chain, to be looped by
+ * usbd_hal_start_payloads(). Each payload is a header followed by data,
+ * sent as one (possibly high bandwidth) transaction.
+ *
+ * While the chains are running, a chain can be prepared again from the
+ * transfer callback reporting its completion: the DMA is then processing
+ * the following chains.
+ *
+ * The header and data buffers are not cleaned from the data cache, the
+ * caller is responsible for it (buffers filled by a DMA need no cleaning).
+ * They must be kept allocated until the chain has been sent.
+ *
+ * \param ep Endpoint number.
+ * \param chain Chain index (0 to USBD_HAL_MAX_CHAINS - 1).
+ * \param payloads Array of payloads.
+ * \param count Number of payloads (1 to USBD_HAL_MAX_PAYLOADS).
+ * \return USBD_STATUS_SUCCESS if the chain has been built;
+ *         otherwise, the corresponding error status code.
+ */
+uint8_t usbd_hal_prepare_payloads(uint8_t ep, uint8_t chain,
+		const struct _usbd_payload *payloads, uint32_t count)
+{
+	uint32_t i, desc_count, queued, total;
+
+	/* Return if DMA is not supported */
+	if (!CHIP_USB_ENDPOINT_HAS_DMA(ep))
+		return USBD_STATUS_HW_NOT_SUPPORTED;
+
+	if (chain >= USBD_HAL_MAX_CHAINS || count == 0 || count > USBD_HAL_MAX_PAYLOADS)
+		return USBD_STATUS_INVALID_PARAMETER;
+
+	desc_count = 0;
+	total = 0;
+	for (i = 0; i < count; i++) {
+		desc_count += _usbd_hal_build_payload(ep, &chain_desc[chain][desc_count],
+				payloads[i].header, payloads[i].header_len,
+				payloads[i].data, payloads[i].data_len, &queued);
+		total += queued;
+	}
+	payload_loop.count[chain] = desc_count;
+	payload_loop.size[chain] = total;
+
+	if (ep == payload_loop.ep)
+		_usbd_hal_dma_link_chain(chain);
+
+	return USBD_STATUS_SUCCESS;
+}
+
+/**
+ * Sends payload chains prepared with usbd_hal_prepare_payloads() through an
+ * isochronous IN endpoint. The chains are linked in a loop so the DMA never
+ * waits for the software: the transfer callback is invoked each time a chain
+ * has been loaded in the endpoint FIFO, in order, and the other chains stay
+ * queued while the completed one is prepared again.
+ *
+ * The loop runs until the endpoint is reset (see usbd_hal_reset_endpoints()),
+ * the transfer callback is then invoked with the reset status.
+ *
+ * \param ep Endpoint number.
+ * \param chains Number of chains, 2 to USBD_HAL_MAX_CHAINS.
+ * \return USBD_STATUS_SUCCESS if the transfer has been started;
+ *         otherwise, the corresponding error status code.
+ */
+uint8_t usbd_hal_start_payloads(uint8_t ep, uint8_t chains)
+{
+	struct _endpoint *endpoint = &endpoints[ep];
+	struct _single_xfer *xfer = &endpoint->transfer.single;
+	uint8_t i;
+
+	/* Return if DMA is not supported */
+	if (!CHIP_USB_ENDPOINT_HAS_DMA(ep))
+		return USBD_STATUS_HW_NOT_SUPPORTED;
+
+	if (chains < 2 || chains > USBD_HAL_MAX_CHAINS)
+		return USBD_STATUS_INVALID_PARAMETER;
+
+	/* Return if busy */
+	if (endpoint->state != USB_HAL_ENDPOINT_IDLE || payload_loop.ep)
+		return USBD_STATUS_LOCKED;
+
+	/* Sending state */
+	endpoint->state = USB_HAL_ENDPOINT_SENDING;
+	endpoint->send_zlp = 0;
+
+	USB_HAL_TRACE("WrL%d(%d) ", ep, (unsigned)chains);
+
+	_usbd_hal_stats_start(ep);
+
+	/* Setup transfer descriptor, the loop has no end */
+	endpoint->transfer.use_multi = false;
+	xfer->data = NULL;
+	xfer->remaining = 0;
+	xfer->buffered = 0;
+	xfer->transferred = 0;
+
+	payload_loop.chains = chains;
+	payload_loop.current = 0;
+	for (i = 0; i < chains; i++)
+		_usbd_hal_dma_link_chain(i);
+	payload_loop.ep = ep;
+
+	/* Interrupt enable */
+	_usbd_hal_endpoint_dma_interrupt_enable(ep);
+
+	/* Start transfer with LLI */
+	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMANXTDSC = (uint32_t)chain_desc[0];
+	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMACONTROL = 0;
+	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMACONTROL = USBHS_DEVDMACONTROL_LDNXT_DSC;
+
+	return USBD_STATUS_SUCCESS;
+}
+
+/**
+ * Check a buffer list and compute its total size.
+ * \param list Array of buffers.
+ * \param count Number of buffers.
+ * \return Total size in bytes, 0 if the list is empty or does not fit in
+ *         the DMA chain of an endpoint.
+ */
+static uint32_t _usbd_hal_list_size(const struct _usbd_buffer *list,
+		uint32_t count)
+{
+	uint32_t i, descs = 0, total = 0;
+
+	for (i = 0; i < count; i++) {
+		descs += (list[i].size + DMA_MAX_FIFO_SIZE - 1) / DMA_MAX_FIFO_SIZE;
+		total += list[i].size;
+	}
+
+	return descs <= USBD_HAL_MAX_BUFFERS ? total : 0;
+}
+
+/**
+ * Start a buffer list transfer on an endpoint: all the buffers are chained
+ * in the endpoint DMA descriptors, so the controller moves from one buffer
+ * to the next without software intervention.
+ * \param ep Endpoint number.
+ * \param list Array of buffers.
+ * \param count Number of buffers.
+ * \param state USB_HAL_ENDPOINT_SENDING or USB_HAL_ENDPOINT_RECEIVING.
+ * \return USBD_STATUS_SUCCESS if the transfer has been started;
+ *         otherwise, the corresponding error status code.
+ */
+static uint8_t _usbd_hal_list_transfer(uint8_t ep,
+		const struct _usbd_buffer *list, uint32_t count,
+		enum _endpoint_state state)
+{
+	struct _endpoint *endpoint = &endpoints[ep];
+	struct _single_xfer *xfer = &endpoint->transfer.single;
+	uint32_t i, total, cfg = 0;
+
+	/* Return if DMA is not supported */
+	if (!CHIP_USB_ENDPOINT_HAS_DMA(ep))
+		return USBD_STATUS_HW_NOT_SUPPORTED;
+
+	total = _usbd_hal_list_size(list, count);
+	if (total == 0)
+		return USBD_STATUS_INVALID_PARAMETER;
+
+	/* Return if busy */
+	if (endpoint->state != USB_HAL_ENDPOINT_IDLE ||
+	    endpoint->transfer.use_multi)
+		return USBD_STATUS_LOCKED;
+
+	if (state == USB_HAL_ENDPOINT_SENDING) {
+		for (i = 0; i < count; i++)
+			if (list[i].size)
+				cache_clean_region(list[i].data, list[i].size);
+	} else {
+		cfg = USBHS_DEVDMACONTROL_END_TR_EN | USBHS_DEVDMACONTROL_END_TR_IT;
+	}
+
+	endpoint->state = state;
+	endpoint->send_zlp = 0;
+
+	USB_HAL_TRACE("%sL%d(%d) ", state == USB_HAL_ENDPOINT_SENDING ?
+			"Wr" : "Rd", ep, (unsigned)total);
+
+	_usbd_hal_stats_start(ep);
+
+	/* Setup transfer descriptor */
+	xfer->data = list[0].data;
+	xfer->remaining = total;
+	xfer->buffered = total;
+	xfer->transferred = 0;
+
+	endpoint->dma_count = 0;
+	for (i = 0; i < count; i++)
+		_usbd_hal_dma_queue(ep, list[i].data, list[i].size, cfg);
+
+	/* Enable automatic bank switch for DMA */
+	if (state == USB_HAL_ENDPOINT_SENDING)
+		_usbd_auto_switch_bank_enable(ep, true);
+
+	_usbd_hal_dma_start_queue(ep);
+
+	return USBD_STATUS_SUCCESS;
+}
+
+/**
+ * Sends a list of buffers through a USB endpoint, as a single transfer.
+ * The list is processed by the endpoint DMA without gaps between the
+ * buffers. The transfer callback is invoked once, when all the buffers have
+ * been sent.
+ *
+ * The buffers must be kept allocated until the transfer is finished.
+ * \param ep Endpoint number (with DMA support).
+ * \param list Array of buffers.
+ * \param count Number of buffers, the list must fit in
+ *              USBD_HAL_MAX_BUFFERS descriptors of 32 KBytes.
+ * \return USBD_STATUS_SUCCESS if the transfer has been started;
+ *         otherwise, the corresponding error status code.
+ */
+uint8_t usbd_hal_write_list(uint8_t ep,
+		const struct _usbd_buffer *list, uint32_t count)
+{
+	return _usbd_hal_list_transfer(ep, list, count,
+			USB_HAL_ENDPOINT_SENDING);
+}
+
+/**
+ * Reads incoming data on a USB endpoint into a list of buffers, as a single
+ * transfer. The transfer finishes either when all the buffers are full, or
+ * when a short packet is received.
+ *
+ * The buffers must be kept allocated until the transfer is finished.
+ * \param ep Endpoint number (with DMA support).
+ * \param list Array of buffers.
+ * \param count Number of buffers, the list must fit in
+ *              USBD_HAL_MAX_BUFFERS descriptors of 32 KBytes.
+ * \return USBD_STATUS_SUCCESS if the read operation has been started;
+ *         otherwise, the corresponding error code.
+ */
+uint8_t usbd_hal_read_list(uint8_t ep,
+		const struct _usbd_buffer *list, uint32_t count)
+{
+	return _usbd_hal_list_transfer(ep, list, count,
+			USB_HAL_ENDPOINT_RECEIVING);
+}
+
+/**
+ * Enable or disable the automatic ZLP of an IN endpoint. When enabled,
+ * a DMA transfer whose size is a non-zero multiple of the endpoint size is
+ * terminated by a zero length packet, sent from the endpoint interrupt once
+ * the DMA has completed.
+ * \param ep Endpoint number.
+ * \param enable true to enable the automatic ZLP.
+ */
+void usbd_hal_set_auto_zlp(uint8_t ep, bool enable)
+{
+	endpoints[ep].auto_zlp = enable;
+}
+
+/**
+ * Get the statistics of an endpoint.
+ * \param ep Endpoint number.
+ * \param stats Receives the statistics.
+ */
+void usbd_hal_get_stats(uint8_t ep, struct _usbd_hal_stats *stats)
+{
+	struct _endpoint *endpoint = &endpoints[ep];
+	uint32_t freq = timer_get_raw_freq();
+	uint64_t gap_max, gap_total;
+	uint32_t flags;
+
+	flags = arch_irq_save();
+	stats->transfers = endpoint->stats.transfers;
+	stats->bytes = endpoint->stats.bytes;
+	stats->naks = endpoint->stats.naks;
+	stats->rearms = endpoint->stats.rearms;
+	gap_max = endpoint->stats.gap_max;
+	gap_total = endpoint->stats.gap_total;
+	arch_irq_restore(flags);
+
+	stats->gap_max = freq ? (gap_max * 1000000ull) / freq : 0;
+	stats->gap_total = freq ? (gap_total * 1000000ull) / freq : 0;
+}
+
+/**
+ * Reset the statistics of an endpoint.
+ * \param ep Endpoint number.
+ */
+void usbd_hal_reset_stats(uint8_t ep)
+{
+	struct _endpoint *endpoint = &endpoints[ep];
+	uint32_t flags;
+
+	flags = arch_irq_save();
+	memset(&endpoint->stats, 0, sizeof(endpoint->stats));
+	endpoint->stats.idle_tick = timer_get_raw_tick();
+	if (ep)
+		_usbd_hal_endpoint_clear_status(ep, EPT_NAK_FLAGS);
+	arch_irq_restore(flags);
+}
+
 /**
  * Get the size of data is available for read or write
  * \param ep Endpoint number
@@ -79,13 +79,18 @@
  *     -- Menu Choices for this example--
  *     \endcode
  * -# Input command according to the menu.
+ * -# Command 'g' checks the GCM streaming engine against a known answer and
+ *    measures the number of packets processed per second for several packet
+ *    sizes, with and without hardware offload.
  *
  * \section References
  * - aes/main.c
  * - aes.c
  * - aes.h
  * - aesd.c
- * - aesd.h */
+ * - aesd.h
+ * - aesd_stream.c
+ * - aesd_stream.h */
 
 /** \file
  *
@@ -107,10 +112,12 @@
 #include "chip.h"
 #include "crypto/aes.h"
 #include "crypto/aesd.h"
+#include "crypto/aesd_stream.h"
 #include "dma/dma.h"
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
 #include "serial/console.h"
+#include "timer.h"
 #include "trace.h"
 
 /*----------------------------------------------------------------------------
@@ -134,6 +141,9 @@
 #define AES_KEY_6		0x0000FFFF
 #define AES_KEY_7		0xFFFF0000
 
+#define BENCH_BUFFER_SIZE	4096
+#define BENCH_DURATION		1000 /* ms */
+
 /*----------------------------------------------------------------------------
  *        Local variables
  *----------------------------------------------------------------------------*/
@@ -164,8 +174,57 @@ CACHE_ALIGNED static uint32_t msg_in_clear[DATA_LEN_INWORD];
 CACHE_ALIGNED static uint32_t msg_encrypted[DATA_LEN_INWORD];
 CACHE_ALIGNED static uint32_t msg_decrypted[DATA_LEN_INWORD];
 
+CACHE_ALIGNED static uint8_t bench_in[BENCH_BUFFER_SIZE];
+CACHE_ALIGNED static uint8_t bench_out[BENCH_BUFFER_SIZE];
+
+static struct _aesd_gcm gcm;
+
 static volatile bool dma_rd_complete = false;
 
+/* GCM known answer (McGrew & Viega, test case 4) */
+static const uint8_t gcm_test_key[16] = {
+	0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c,
+	0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+};
+
+static const uint8_t gcm_test_iv[12] = {
+	0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad,
+	0xde, 0xca, 0xf8, 0x88,
+};
+
+static const uint8_t gcm_test_aad[20] = {
+	0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+	0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+	0xab, 0xad, 0xda, 0xd2,
+};
+
+static const uint8_t gcm_test_plain[60] = {
+	0xd9, 0x31, 0x32, 0x25, 0xf8, 0x84, 0x06, 0xe5,
+	0xa5, 0x59, 0x09, 0xc5, 0xaf, 0xf5, 0x26, 0x9a,
+	0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda,
+	0x2e, 0x4c, 0x30, 0x3d, 0x8a, 0x31, 0x8a, 0x72,
+	0x1c, 0x3c, 0x0c, 0x95, 0x95, 0x68, 0x09, 0x53,
+	0x2f, 0xcf, 0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25,
+	0xb1, 0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57,
+	0xba, 0x63, 0x7b, 0x39,
+};
+
+static const uint8_t gcm_test_cipher[60] = {
+	0x42, 0x83, 0x1e, 0xc2, 0x21, 0x77, 0x74, 0x24,
+	0x4b, 0x72, 0x21, 0xb7, 0x84, 0xd0, 0xd4, 0x9c,
+	0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0,
+	0x35, 0xc1, 0x7e, 0x23, 0x29, 0xac, 0xa1, 0x2e,
+	0x21, 0xd5, 0x14, 0xb2, 0x54, 0x66, 0x93, 0x1c,
+	0x7d, 0x8f, 0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05,
+	0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97,
+	0x3d, 0x58, 0xe0, 0x91,
+};
+
+static const uint8_t gcm_test_tag[16] = {
+	0x5b, 0xc9, 0x4f, 0xbc, 0x32, 0x21, 0xa5, 0xdb,
+	0x94, 0xfa, 0xe9, 0x5a, 0xe7, 0x12, 0x1a, 0x47,
+};
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -249,6 +308,127 @@ static void start_aes(void)
 	printf("\n\r");
 }
 
+/**
+ * \brief Check the GCM engine against the known answer, the payload being
+ * split between the AES peripheral and the software cipher.
+ */
+static bool gcm_self_test(void)
+{
+	uint8_t tag[16];
+	bool ok;
+
+	memcpy(bench_in, gcm_test_plain, sizeof(gcm_test_plain));
+
+	aesd.cfg.encrypt = true;
+	if (aesd_gcm_init(&gcm, &aesd, gcm_test_iv, sizeof(gcm_test_iv)) < 0)
+		return false;
+	aesd_stream_set_threshold(&gcm.stream, 0);
+	aesd_gcm_update_aad(&gcm, gcm_test_aad, sizeof(gcm_test_aad));
+	aesd_gcm_update(&gcm, bench_in, bench_out, sizeof(gcm_test_plain));
+	aesd_gcm_finish(&gcm, tag, sizeof(tag));
+	ok = !memcmp(bench_out, gcm_test_cipher, sizeof(gcm_test_cipher)) &&
+	     !memcmp(tag, gcm_test_tag, sizeof(tag));
+
+	aesd.cfg.encrypt = false;
+	if (aesd_gcm_init(&gcm, &aesd, gcm_test_iv, sizeof(gcm_test_iv)) < 0)
+		return false;
+	aesd_stream_set_threshold(&gcm.stream, 0);
+	aesd_gcm_update_aad(&gcm, gcm_test_aad, sizeof(gcm_test_aad));
+	aesd_gcm_update(&gcm, bench_out, bench_in, sizeof(gcm_test_cipher));
+	ok = ok && aesd_gcm_verify(&gcm, gcm_test_tag, sizeof(gcm_test_tag)) == 0 &&
+	     !memcmp(bench_in, gcm_test_plain, sizeof(gcm_test_plain));
+
+	return ok;
+}
+
+/**
+ * \brief Count the GCM packets of the given size encrypted in
+ * BENCH_DURATION milliseconds.
+ * \param size  Packet size in bytes.
+ * \param threshold  Software threshold of the streaming engine.
+ */
+static uint32_t gcm_bench_packets(uint32_t size, uint32_t threshold)
+{
+	uint8_t iv[12];
+	uint8_t tag[16];
+	uint32_t packets = 0;
+	uint64_t start;
+
+	memcpy(iv, gcm_test_iv, sizeof(iv));
+	aesd.cfg.encrypt = true;
+
+	start = timer_get_tick();
+	while (timer_get_interval(start, timer_get_tick()) < BENCH_DURATION) {
+		/* One IV per packet */
+		memcpy(iv, &packets, sizeof(packets));
+		aesd_gcm_init(&gcm, &aesd, iv, sizeof(iv));
+		aesd_stream_set_threshold(&gcm.stream, threshold);
+		aesd_gcm_update_aad(&gcm, gcm_test_aad, sizeof(gcm_test_aad));
+		aesd_gcm_update(&gcm, bench_in, bench_out, size);
+		aesd_gcm_finish(&gcm, tag, sizeof(tag));
+		packets++;
+	}
+
+	return packets * 1000 / BENCH_DURATION;
+}
+
+/**
+ * \brief Count the 64-byte packets of a CTR stream encrypted in
+ * BENCH_DURATION milliseconds, the packets of a buffer being chained in the
+ * same hardware runs.
+ */
+static uint32_t ctr_bench_chained(void)
+{
+	struct _aesd_stream* stream = &gcm.stream;
+	uint32_t packets = 0;
+	uint32_t offset;
+	uint64_t start;
+
+	if (aesd_stream_init(stream, &aesd, gcm_test_iv) < 0)
+		return 0;
+	aesd_stream_set_threshold(stream, 0);
+
+	start = timer_get_tick();
+	while (timer_get_interval(start, timer_get_tick()) < BENCH_DURATION) {
+		for (offset = 0; offset < BENCH_BUFFER_SIZE; offset += 64) {
+			aesd_stream_update(stream, &bench_in[offset],
+					&bench_out[offset], 64);
+			packets++;
+		}
+		aesd_stream_wait(stream);
+	}
+	aesd_stream_finish(stream);
+
+	return packets * 1000 / BENCH_DURATION;
+}
+
+/**
+ * \brief Run the GCM self test and throughput benchmark.
+ */
+static void benchmark_gcm(void)
+{
+	static const uint32_t sizes[] = { 64, 512, 4096 };
+	uint32_t i, hw, sw;
+
+	aesd.cfg.key_size = AESD_AES128;
+	memcpy(aesd.cfg.key, gcm_test_key, sizeof(gcm_test_key));
+
+	printf("-I- GCM known answer test: %s\n\r",
+	       gcm_self_test() ? "PASSED" : "FAILED");
+
+	memset(bench_in, 0x5a, sizeof(bench_in));
+	printf("-I- AES-128-GCM, 20-byte AAD, packets per second\n\r");
+	printf("    size      hw+sw    sw only\n\r");
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		hw = gcm_bench_packets(sizes[i], AESD_STREAM_SW_THRESHOLD);
+		sw = gcm_bench_packets(sizes[i], UINT32_MAX);
+		printf("    %4lu %10lu %10lu\n\r", sizes[i], hw, sw);
+	}
+
+	printf("-I- AES-128-CTR stream, chained 64-byte packets: %lu/s\n\r",
+	       ctr_bench_chained());
+}
+
 /**
  * \brief Display main menu.
  */
@@ -282,6 +462,7 @@ static void display_menu(void)
 	printf("   m: MANUAL_START[%c]  a: AUTO_START[%c]  d: DMA[%c]\n\r",
 		chk_box[0], chk_box[1], chk_box[2]);
 	printf("   p: Begin the encryption/decryption process\n\r");
+	printf("   g: GCM streaming self test and benchmark\n\r");
 	printf("   h: Display this menu\n\r");
 	printf("\n\r");
 }
@@ -375,6 +556,9 @@ int main(void)
 		case 'p':
 			start_aes();
 			break;
+		case 'g':
+			benchmark_gcm();
+			break;
 		}
 	}
 
@@ -85,6 +85,7 @@
  *     Press [o|t|l] to set one/multi-block or long message
  *     Press [m|a|d] to set Start Mode
  *        p: Start hash algorithm process
+ *        b: Check HMAC and benchmark batch hashing
  *        h: Display this menu
  *    \endcode
  * -# Press one of the keys listed in the menu to perform the corresponding action.
@@ -120,6 +121,7 @@
 #include "peripherals/pmc.h"
 #include "serial/console.h"
 #include "swab.h"
+#include "timer.h"
 #include "trace.h"
 
 /*----------------------------------------------------------------------------
@@ -143,6 +145,11 @@
 
 #define SHA_UPDATE_LEN (128 * 1024) /* buffer length when spliting long message */
 
+#define BENCH_DURATION    1000 /* ms */
+#define BENCH_SMALL_LEN   64
+#define BENCH_SMALL_COUNT 32
+#define BENCH_LARGE_LEN   (64 * 1024)
+
 /*----------------------------------------------------------------------------
  *        Local variables
  *----------------------------------------------------------------------------*/
@@ -268,8 +275,43 @@ static const uint32_t ref_digests_224[3][7] = {
 	  0x1948b2ee, 0x4ee7ad67 }
 };
 
+/* RFC 2202 / RFC 4231 HMAC test case 2: key "Jefe", message "what do ya
+ * want for nothing?" */
+static const uint8_t hmac_key[4] = "Jefe";
+static const uint8_t hmac_msg[28] = "what do ya want for nothing?";
+static const uint8_t ref_hmac[5][64] = {
+	{ 0xef, 0xfc, 0xdf, 0x6a, 0xe5, 0xeb, 0x2f, 0xa2,
+	  0xd2, 0x74, 0x16, 0xd5, 0xf1, 0x84, 0xdf, 0x9c,
+	  0x25, 0x9a, 0x7c, 0x79 },
+	{ 0xa3, 0x0e, 0x01, 0x09, 0x8b, 0xc6, 0xdb, 0xbf,
+	  0x45, 0x69, 0x0f, 0x3a, 0x7e, 0x9e, 0x6d, 0x0f,
+	  0x8b, 0xbe, 0xa2, 0xa3, 0x9e, 0x61, 0x48, 0x00,
+	  0x8f, 0xd0, 0x5e, 0x44 },
+	{ 0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e,
+	  0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+	  0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83,
+	  0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43 },
+	{ 0xaf, 0x45, 0xd2, 0xe3, 0x76, 0x48, 0x40, 0x31,
+	  0x61, 0x7f, 0x78, 0xd2, 0xb5, 0x8a, 0x6b, 0x1b,
+	  0x9c, 0x7e, 0xf4, 0x64, 0xf5, 0xa0, 0x1b, 0x47,
+	  0xe4, 0x2e, 0xc3, 0x73, 0x63, 0x22, 0x44, 0x5e,
+	  0x8e, 0x22, 0x40, 0xca, 0x5e, 0x69, 0xe2, 0xc7,
+	  0x8b, 0x32, 0x39, 0xec, 0xfa, 0xb2, 0x16, 0x49 },
+	{ 0x16, 0x4b, 0x7a, 0x7b, 0xfc, 0xf8, 0x19, 0xe2,
+	  0xe3, 0x95, 0xfb, 0xe7, 0x3b, 0x56, 0xe0, 0xa3,
+	  0x87, 0xbd, 0x64, 0x22, 0x2e, 0x83, 0x1f, 0xd6,
+	  0x10, 0x27, 0x0c, 0xd7, 0xea, 0x25, 0x05, 0x54,
+	  0x97, 0x58, 0xbf, 0x75, 0xc0, 0x5a, 0x99, 0x4a,
+	  0x6d, 0x03, 0x4f, 0x65, 0xf8, 0xf0, 0xe6, 0xfd,
+	  0xca, 0xea, 0xb1, 0xa3, 0x4d, 0x4a, 0x6b, 0x4b,
+	  0x63, 0x6e, 0x07, 0x0a, 0x38, 0xbc, 0xe7, 0x37 },
+};
+
 CACHE_ALIGNED_DDR static uint8_t message[BUF_SIZE];
 
+static struct _shad_msg bench_msgs[BENCH_SMALL_COUNT];
+static uint8_t bench_digests[BENCH_SMALL_COUNT][64];
+
 static uint32_t digest[MAX_DIGEST_SIZE_INWORD];
 static uint32_t block_mode;
 
@@ -368,6 +410,93 @@ static void start_sha(void)
 		printf("-I- Message digest result matched with the result in FIPS example\r\n");
 }
 
+/**
+ * \brief Check HMAC computation against the RFC test vector.
+ */
+static bool check_hmac(void)
+{
+	struct _shad_hmac hmac;
+	uint8_t mac[64];
+	int output_size = shad_get_output_size(shad.cfg.algo);
+	struct _buffer buf_in = {
+		.data = (uint8_t*)message,
+		.size = sizeof(hmac_msg),
+	};
+	struct _buffer buf_out = {
+		.data = mac,
+		.size = output_size,
+	};
+
+	memcpy(message, hmac_msg, sizeof(hmac_msg));
+	if (shad_hmac_start(&hmac, &shad, hmac_key, sizeof(hmac_key)) < 0)
+		return false;
+	shad_hmac_update(&hmac, &buf_in, NULL);
+	shad_wait_completion(&shad);
+	if (shad_hmac_finish(&hmac, &buf_out) < 0)
+		return false;
+
+	return memcmp(mac, ref_hmac[shad.cfg.algo], output_size) == 0;
+}
+
+/**
+ * \brief Hash batches of messages for BENCH_DURATION milliseconds.
+ * \param len  Length of each message.
+ * \param count  Number of messages per batch.
+ * \param threshold  Size under which messages are hashed in software.
+ * \return the number of messages hashed per second.
+ */
+static uint32_t bench_batch(uint32_t len, uint32_t count, uint32_t threshold)
+{
+	uint32_t i, hashes = 0;
+	uint64_t start;
+
+	for (i = 0; i < count; i++) {
+		bench_msgs[i].data = &message[i * len];
+		bench_msgs[i].len = len;
+		bench_msgs[i].digest = bench_digests[i];
+	}
+
+	shad.cfg.sw_threshold = threshold;
+	start = timer_get_tick();
+	while (timer_get_interval(start, timer_get_tick()) < BENCH_DURATION) {
+		shad_batch(&shad, bench_msgs, count);
+		hashes += count;
+	}
+	shad.cfg.sw_threshold = 0;
+
+	return hashes * 1000 / BENCH_DURATION;
+}
+
+/**
+ * \brief Check HMAC and report the throughput of every algorithm.
+ */
+static void benchmark_sha(void)
+{
+	enum _shad_algo algo = shad.cfg.algo;
+	static const char* names[] = { "SHA1", "SHA224", "SHA256", "SHA384", "SHA512" };
+	uint32_t hw, sw, large, i;
+
+	memset(message, 0xa5, BENCH_LARGE_LEN);
+
+	printf("-I- %s mode, %u-byte messages in batches of %u\r\n",
+	       shad.cfg.transfer_mode == SHAD_TRANS_DMA ? "DMA" : "polling",
+	       BENCH_SMALL_LEN, BENCH_SMALL_COUNT);
+	printf("    algo     HMAC   hw hash/s  sw hash/s  %ukB MB/s\r\n",
+	       BENCH_LARGE_LEN / 1024);
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		shad.cfg.algo = (enum _shad_algo)i;
+		hw = bench_batch(BENCH_SMALL_LEN, BENCH_SMALL_COUNT, 0);
+		sw = bench_batch(BENCH_SMALL_LEN, BENCH_SMALL_COUNT, UINT32_MAX);
+		large = bench_batch(BENCH_LARGE_LEN, 1, 0);
+		large = (uint32_t)(((uint64_t)large * BENCH_LARGE_LEN) / 100000);
+		printf("    %-6s %6s %11u %10u %7u.%u\r\n", names[i],
+		       check_hmac() ? "ok" : "FAIL", (unsigned)hw, (unsigned)sw,
+		       (unsigned)(large / 10), (unsigned)(large % 10));
+	}
+
+	shad.cfg.algo = algo;
+}
+
 /**
  * \brief Display main menu.
  */
@@ -393,6 +522,7 @@ static void display_menu(void)
 	chk_box[1] = (shad.cfg.transfer_mode == SHAD_TRANS_DMA) ? 'X' : ' ';
 	printf("   p: POLLING[%c] d: DMA[%c]\r\n", chk_box[0], chk_box[1]);
 	printf("   s: Start hash algorithm process \r\n");
+	printf("   b: Check HMAC and benchmark batch hashing\r\n");
 	printf("   h: Display this menu\r\n");
 	printf("\r\n");
 }
@@ -460,6 +590,9 @@ int main(void)
 			case 's':
 				start_sha();
 				break;
+			case 'b':
+				benchmark_sha();
+				break;
 		}
 	}
 
@@ -44,6 +44,10 @@
  * TRNG interrupt status DATRDY is set when a new random value is ready, it can be read
  * out on the 32-bit output data register (TRNG_ODATA)in TRNG interrupt routine.
  *
+ * Before streaming raw TRNG values, the example measures the throughput of
+ * the TRNG-seeded DRBG (random_bytes()) and of the xoshiro rand(), and runs
+ * frequency and byte distribution sanity checks on the DRBG output.
+ *
  * \section Usage
  *
  *  -# Build the program and download it inside the evaluation board. Please
@@ -76,6 +80,7 @@
  * - trng/main.c
  * - trng.h
  * - trng.h
+ * - drbg.h
  */
 
 /** \file
@@ -92,9 +97,28 @@
 
 #include "serial/console.h"
 
+#include "crypto/drbg.h"
 #include "crypto/trng.h"
 
+#include "rand.h"
+#include "timer.h"
+
 #include <stdio.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+#define BENCH_DURATION 1000 /* ms */
+#define STATS_BLOCKS   64   /* 64 x 4KB analysed */
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+static uint8_t random_buffer[4096];
+static uint32_t byte_count[256];
 
 /*----------------------------------------------------------------------------
  *        Local functions
@@ -105,6 +129,94 @@ static void trng_callback(uint32_t random_value, void* user_arg)
 	printf("0x%08x\n\r", (unsigned int)random_value);
 }
 
+static uint32_t popcount8(uint8_t value)
+{
+	uint32_t count = 0;
+
+	while (value) {
+		count += value & 1;
+		value >>= 1;
+	}
+	return count;
+}
+
+/**
+ * \brief Measure generator throughputs.
+ */
+static void bench_random(void)
+{
+	uint32_t count, sink = 0;
+	uint64_t start;
+
+	count = 0;
+	start = timer_get_tick();
+	while (timer_get_interval(start, timer_get_tick()) < BENCH_DURATION) {
+		random_bytes(random_buffer, sizeof(random_buffer));
+		count++;
+	}
+	printf("-I- random_bytes(): %u KB/s\n\r",
+	       (unsigned)(count * sizeof(random_buffer) / 1024 * 1000 / BENCH_DURATION));
+
+	count = 0;
+	start = timer_get_tick();
+	while (timer_get_interval(start, timer_get_tick()) < BENCH_DURATION) {
+		sink ^= random_u32();
+		count++;
+	}
+	printf("-I- random_u32(): %u calls/s\n\r",
+	       (unsigned)(count * 1000 / BENCH_DURATION));
+
+	count = 0;
+	start = timer_get_tick();
+	while (timer_get_interval(start, timer_get_tick()) < BENCH_DURATION) {
+		sink ^= rand();
+		count++;
+	}
+	printf("-I- rand(): %u calls/s (0x%08x)\n\r",
+	       (unsigned)(count * 1000 / BENCH_DURATION), (unsigned)sink);
+}
+
+/**
+ * \brief Frequency (monobit) and byte distribution (chi-square) checks of
+ * the DRBG output.
+ */
+static void check_random(void)
+{
+	const uint32_t bytes = STATS_BLOCKS * sizeof(random_buffer);
+	const uint32_t expected = bytes / 256;
+	uint32_t i, j, ones = 0, chi2 = 0;
+	int32_t diff;
+	struct _drbg_stats stats;
+
+	memset(byte_count, 0, sizeof(byte_count));
+	for (i = 0; i < STATS_BLOCKS; i++) {
+		random_bytes(random_buffer, sizeof(random_buffer));
+		for (j = 0; j < sizeof(random_buffer); j++) {
+			ones += popcount8(random_buffer[j]);
+			byte_count[random_buffer[j]]++;
+		}
+	}
+
+	for (i = 0; i < 256; i++) {
+		diff = (int32_t)byte_count[i] - (int32_t)expected;
+		chi2 += (uint32_t)(diff * diff);
+	}
+	chi2 /= expected;
+
+	/* Ones within ~4 sigma of one half, chi-square (255 degrees of
+	 * freedom) within the 0.01%..99.99% quantiles */
+	printf("-I- monobit: %u ones in %u bits: %s\n\r",
+	       (unsigned)ones, (unsigned)(bytes * 8),
+	       (ones > bytes * 4 - 3000 && ones < bytes * 4 + 3000) ? "ok" : "FAILED");
+	printf("-I- byte chi-square: %u: %s\n\r", (unsigned)chi2,
+	       (chi2 > 171 && chi2 < 339) ? "ok" : "FAILED");
+
+	drbg_get_stats(&stats);
+	printf("-I- DRBG: %u bytes, %u reseeds, %u polled\n\r",
+	       (unsigned)stats.generated, (unsigned)stats.reseeds,
+	       (unsigned)stats.late_reseeds);
+}
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -120,8 +232,12 @@ int main(void)
 	/* Output example information */
 	console_example_info("TRNG Example");
 
-	trng_enable();
-	trng_enable_it(&trng_callback, NULL);
+	drbg_init();
+	bench_random();
+	check_random();
+
+	/* Stream raw TRNG values, the DRBG keeps its pool filled from them */
+	drbg_set_trng_callback(&trng_callback, NULL);
 
 	while (1) ;
 }
@@ -11,6 +11,8 @@
 
 #define MEM_ALIGNMENT                   4
 
+#define LWIP_SUPPORT_CUSTOM_PBUF        1
+
 #define LWIP_ARP                        1
 #define LWIP_ETHERNET                   LWIP_ARP
 
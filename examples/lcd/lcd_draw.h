@@ -49,6 +49,9 @@
  *   - lcdc_draw_string()
  *   - lcdc_get_string_size()
  *
+ * Drawings are made visible to the LCDC by lcd_present(), which cleans the
+ * data cache for the areas changed since its last call.
+ *
  * \sa \ref lcdc_module, \ref lcdc_font
  */
 
@@ -62,8 +65,11 @@
  *        Headers
  *----------------------------------------------------------------------------*/
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "gfx/gfx.h"
+
 /*----------------------------------------------------------------------------
  *        Definitions
  *----------------------------------------------------------------------------*/
@@ -74,6 +80,12 @@
 
 	 /** \addtogroup lcdc_draw_func LCD Drawing Functions */
 /** @{*/
+extern struct _gfx_surface* lcd_get_surface(void);
+
+extern void lcd_present(void);
+
+extern void lcd_enable_dma(bool enable);
+
 extern void lcd_fill_white(void);
 
 extern void lcd_fill(uint32_t color);
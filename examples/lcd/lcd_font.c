@@ -31,6 +31,9 @@
  *
  * Implementation of draw font on LCD.
  *
+ * The fonts are described to the gfx library, which caches their glyphs as
+ * row bitmasks.
+ *
  */
 
 /*----------------------------------------------------------------------------
@@ -41,15 +44,88 @@
 #include "lcd_draw.h"
 
 #include "font.h"
+#include "gfx/gfx.h"
 
 #include <assert.h>
 
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Render a 10x14 glyph: two bytes per column, MSB on top.
+ */
+static void _render_10x14(const struct _gfx_font* font, uint8_t c,
+			  uint32_t* rows)
+{
+	const uint8_t* glyph = (const uint8_t*)font->data + (c - font->first) * 20;
+	uint32_t row, col;
+
+	for (col = 0; col < 10; col++) {
+		for (row = 0; row < 8; row++)
+			if ((glyph[col * 2] >> (7 - row)) & 0x1)
+				rows[row] |= 1u << col;
+		for (row = 0; row < 6; row++)
+			if ((glyph[col * 2 + 1] >> (7 - row)) & 0x1)
+				rows[row + 8] |= 1u << col;
+	}
+}
+
+/**
+ * Render a 10x8 glyph, drawn rotated: one byte per row of 8 pixels, LSB on
+ * the right.
+ */
+static void _render_10x8(const struct _gfx_font* font, uint8_t c,
+			 uint32_t* rows)
+{
+	const uint8_t* glyph = (const uint8_t*)font->data + (c - font->first) * 10;
+	uint32_t row, bit;
+
+	for (row = 0; row < 10; row++)
+		for (bit = 0; bit < 8; bit++)
+			if ((glyph[row] >> bit) & 0x1)
+				rows[row] |= 1u << (7 - bit);
+}
+
+/**
+ * Render a 8x8 glyph: one byte per row, LSB on the left.
+ */
+static void _render_8x8(const struct _gfx_font* font, uint8_t c,
+			uint32_t* rows)
+{
+	const uint8_t* glyph = (const uint8_t*)font->data + (c - font->first) * 8;
+	uint32_t row;
+
+	for (row = 0; row < 8; row++)
+		rows[row] = glyph[row];
+}
+
+/**
+ * Render a 6x8 glyph: one byte per column, LSB on top.
+ */
+static void _render_6x8(const struct _gfx_font* font, uint8_t c,
+			uint32_t* rows)
+{
+	const uint8_t* glyph = (const uint8_t*)font->data + (c - font->first) * 6;
+	uint32_t row, col;
+
+	for (col = 0; col < 6; col++)
+		for (row = 0; row < 8; row++)
+			if ((glyph[col] >> row) & 0x1)
+				rows[row] |= 1u << col;
+}
+
 /*----------------------------------------------------------------------------
  *        Local variables
  *----------------------------------------------------------------------------*/
 
-/** Global variable describing the font being instanced. */
-//const Font gFont = { 10, 14 };
+/** Fonts of font_param[] for the gfx library, as drawn on screen */
+static const struct _gfx_font _fonts[NB_FONT] = {
+	[FONT10x14] = { 10, 14, 2, 0x20, 0x7F, pCharset10x14, _render_10x14 },
+	[FONT10x8] = { 8, 10, 1, 0x20, 0x7F, pCharset10x8, _render_10x8 },
+	[FONT8x8] = { 8, 8, 1, 0x20, 0x7F, pCharset8x8, _render_8x8 },
+	[FONT6x8] = { 6, 8, 0, 0x20, 0x7F, pCharset6x8, _render_6x8 },
+};
 
 static uint8_t font_sel = FONT10x14;
 
@@ -68,61 +144,17 @@ uint8_t lcd_get_selected_font (void)
 	return font_sel;
 }
 
-void lcd_draw_char(uint32_t x, uint32_t y, uint8_t c, uint32_t color)
+const struct _gfx_font* lcd_get_font(void)
 {
-	uint32_t row, col;
-	uint8_t Ch;
-	uint8_t width = font_param[font_sel].width ;
-    uint8_t height = font_param[font_sel].height;
-	const uint8_t* pfont = font_param[font_sel].pfont;
+	return &_fonts[font_sel];
+}
 
+void lcd_draw_char(uint32_t x, uint32_t y, uint8_t c, uint32_t color)
+{
 	assert((c >= 0x20) && (c <= 0x7F));
 
-    switch (font_sel)
-    {
-      case FONT10x14:
-        for (col=0 ; col < width ; col++ ) {
-          for (row=0 ; row<8 ; row++ ) {
-            Ch = (pfont[((c - 0x20) * 20) + col * 2] >> (7 - row)) & 0x1;
-            if (Ch) lcd_draw_pixel( x+col, y+row, color) ;
-          }
-          for (row=0; row<6; row++ ) {
-            Ch = (pfont[((c - 0x20) * 20) + col * 2 + 1] >> (7 - row)) & 0x1;
-            if (Ch) lcd_draw_pixel( x+col, y+row+8, color) ;
-          }
-        }
-        break;
-
-       case FONT10x8:
-        for (col=0 ; col < width ; col++ ) {
-          Ch = pfont[((c-0x20)*width)+ col];
-		  if (Ch) {
-            for (row=0 ; row < height; row++ ) {
-              if ((Ch>>row)&0x1) {
-                  lcd_draw_pixel( x+(height-row), y+col, color) ;
-              }
-            }
-          }
-        }
-        break;
-
-      case FONT8x8:
-      case FONT6x8:
-        for (col=0 ; col < width ; col++ ) {
-          Ch = pfont[((c-0x20)*width)+ col];
-          if (Ch) {
-            for (row=0 ; row < height; row++ ) {
-              if ((Ch>>row)&0x1)  {
-                if (font_sel == FONT8x8)
-                  lcd_draw_pixel( x+row, y+col, color) ;
-                else
-                  lcd_draw_pixel( x+col, y+row, color) ;
-              }
-            }
-          }
-        }
-        break;
-    }
+	gfx_draw_char(lcd_get_surface(), lcd_get_font(), x, y, c, color, 0,
+		      false);
 }
 
 /**
@@ -137,68 +169,8 @@ void lcd_draw_char(uint32_t x, uint32_t y, uint8_t c, uint32_t color)
 void lcd_draw_char_with_bgcolor(uint32_t x, uint32_t y, uint8_t c, uint32_t fontColor,
 			 uint32_t bgColor)
 {
-	uint32_t row, col;
-	uint8_t Ch;
-	uint8_t width = font_param[font_sel].width ;
-    uint8_t height = font_param[font_sel].height;
-	const uint8_t* pfont = font_param[font_sel].pfont;
-
 	assert((c >= 0x20) && (c <= 0x7F));
 
-    switch (font_sel)
-    {
-      case FONT10x14:
-        for (col=0 ; col < width ; col++ ) {
-          for (row=0 ; row<8 ; row++ ) {
-            Ch = (pfont[((c - 0x20) * 20) + col * 2] >> (7 - row)) & 0x1;
-            if (Ch) lcd_draw_pixel( x+col, y+row, fontColor) ;
-			else lcd_draw_pixel( x+col, y+row, bgColor) ;
-          }
-          for (row=0; row<6; row++ ) {
-            Ch = (pfont[((c - 0x20) * 20) + col * 2 + 1] >> (7 - row)) & 0x1;
-            if (Ch) lcd_draw_pixel( x+col, y+row+8, fontColor) ;
-			else lcd_draw_pixel( x+col, y+row+8, bgColor) ;
-          }
-        }
-        break;
-
-       case FONT10x8:
-        for (col=0 ; col < width ; col++ ) {
-          Ch = pfont[((c-0x20)*width)+ col];
-		  if (Ch) {
-            for (row=0 ; row < height; row++ ) {
-              if ((Ch>>row)&0x1) {
-                  lcd_draw_pixel( x+(height-row), y+col, fontColor) ;
-			  }
-			  else {
-				  lcd_draw_pixel( x+(height-row), y+col, bgColor) ;
-			  }
-            }
-          }
-        }
-        break;
-
-      case FONT8x8:
-      case FONT6x8:
-        for (col=0 ; col < width ; col++ ) {
-          Ch = pfont[((c-0x20)*width)+ col];
-          if (Ch) {
-            for (row=0 ; row < height; row++ ) {
-              if ((Ch>>row)&0x1)  {
-                if (font_sel == FONT8x8)
-                  lcd_draw_pixel( x+row, y+col, fontColor) ;
-                else
-                  lcd_draw_pixel( x+col, y+row, fontColor) ;
-              }
-			  else {
-				  if (font_sel == FONT8x8)
-                  lcd_draw_pixel( x+row, y+col, bgColor) ;
-                else
-                  lcd_draw_pixel( x+col, y+row, bgColor) ;
-			  }
-            }
-          }
-        }
-        break;
-    }
+	gfx_draw_char(lcd_get_surface(), lcd_get_font(), x, y, c, fontColor,
+		      bgColor, true);
 }
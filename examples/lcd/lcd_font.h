@@ -72,6 +72,7 @@
  *----------------------------------------------------------------------------*/
 
 #include "font.h"
+#include "gfx/gfx.h"
 
 #include <stdint.h>
 
@@ -103,6 +104,8 @@ extern struct _font_parameters* lcd_select_font (_FONT_enum font);
 
 extern uint8_t lcd_get_selected_font (void);
 
+extern const struct _gfx_font* lcd_get_font(void);
+
 extern void lcd_draw_char(uint32_t x, uint32_t y, uint8_t c, uint32_t color);
 
 extern void lcd_draw_char_with_bgcolor(uint32_t x, uint32_t y, uint8_t c,
@@ -94,6 +94,8 @@
 #include "chip.h"
 
 #include "display/lcdc.h"
+#include "dma/dma_job.h"
+#include "gfx/gfx.h"
 #include "peripherals/pmc.h"
 #include "gpio/pio.h"
 
@@ -167,6 +169,12 @@
 /** Number of blocks in horizontal */
 #define N_BLK_HOR     6
 
+/** Duration of each benchmark test, in milliseconds */
+#define BENCH_TIME    250
+
+/** Size of the rectangles drawn by the benchmark */
+#define BENCH_SIZE    64
+
 
 /*----------------------------------------------------------------------------
  *        Local variables
@@ -261,6 +269,19 @@ volatile uint32_t time_stamp = 0;
 #define NB_TAB_COLOR N_BLK_HOR*N_BLK_VERT
 uint8_t ncolor = 0;
 
+/** DMA job engine available for drawing */
+static bool dma_enabled = false;
+
+/** Surface of the drawing benchmark */
+static struct _gfx_surface bench_surface;
+
+/** Drawing benchmark test */
+struct _bench_test {
+	const char *name;
+	bool dma;
+	void (*draw)(struct _gfx_surface *surface, uint32_t i);
+};
+
 /*----------------------------------------------------------------------------
  *        Functions
  *----------------------------------------------------------------------------*/
@@ -317,7 +338,7 @@ static void _LcdOn(void)
 	lcdc_create_canvas(LCDC_HEO, _heo_buffer_yuv, heo_bpp, 0, 0,
 						heo_img_w, heo_img_h);
 	lcd_fill_yuv422();
-	cache_clean_region(_heo_buffer_yuv, sizeof(_heo_buffer_yuv));
+	lcd_present();
 #endif
 	/* Show magnified 'F' for rotate test */
 	heo_img_w = 20 * EXAMPLE_LCD_SCALE;
@@ -340,7 +361,7 @@ static void _LcdOn(void)
 				   13 * EXAMPLE_LCD_SCALE,
 				   13 * EXAMPLE_LCD_SCALE, COLOR_BLACK);
 
-	cache_clean_region(_heo_buffer_rgb, sizeof(_heo_buffer_rgb));
+	lcd_present();
 	lcdc_put_image_rotated(LCDC_HEO, _heo_buffer_rgb, heo_bpp, SCR_X(heo_x),
 			      SCR_Y(heo_y), heo_w, heo_h, heo_img_w,
 			      heo_img_h, 0);
@@ -360,7 +381,7 @@ static void _LcdOn(void)
 	/* Display message font 8x8 */
 	lcd_select_font(FONT8x8);
 	lcd_draw_string(8, 56, "ATMEL RFO", COLOR_BLACK);
-	cache_clean_region(_ovr2_buffer, sizeof(_ovr2_buffer));
+	lcd_present();
 #endif /* CONFIG_HAVE_LCDC_OVR2 */
 
 #ifdef CONFIG_HAVE_LCDC_OVR1
@@ -372,7 +393,7 @@ static void _LcdOn(void)
 	lcdc_create_canvas(LCDC_OVR1, _ovr1_buffer, 24, SCR_X(ovr1_x),
 			   SCR_Y(ovr1_y), orv1_w, ovr1_h);
 	lcd_fill(OVR1_BG);
-	cache_clean_region(_ovr1_buffer, sizeof(_ovr1_buffer));
+	lcd_present();
 #endif /* CONFIG_HAVE_LCDC_OVR1 */
 
 	printf("- LCD ON\r\n");
@@ -536,6 +557,7 @@ static void _rotates(void)
 #ifdef LCDC_HEOCFG1_YUVEN
 		printf(" Use 'a' to change HEO YUV or RGB\r\n");
 #endif
+		printf(" Use 'b' to run the drawing benchmark\r\n");
 		printf("------------------------------------\r\n");
 	}
 }
@@ -604,11 +626,115 @@ static void _draws(void)
 			"graphic functionnalities\n"
 			"       on a SAMA5", COLOR_BLACK);
 
-	cache_clean_region(_ovr1_buffer, sizeof(_ovr1_buffer));
+	lcd_present();
 }
 
 #endif /* CONFIG_HAVE_LCDC_OVR1 */
 
+static void _bench_fill(struct _gfx_surface *surface, uint32_t i)
+{
+	gfx_fill_rect(surface, (i * 7) % (surface->width - BENCH_SIZE),
+		      (i * 5) % (surface->height - BENCH_SIZE),
+		      BENCH_SIZE, BENCH_SIZE, test_colors[i % NB_TAB_COLOR]);
+}
+
+static void _bench_fill_screen(struct _gfx_surface *surface, uint32_t i)
+{
+	gfx_fill(surface, test_colors[i % NB_TAB_COLOR]);
+}
+
+static void _bench_line(struct _gfx_surface *surface, uint32_t i)
+{
+	gfx_draw_line(surface, i % surface->width, 0,
+		      surface->width - 1 - i % surface->width,
+		      surface->height - 1, test_colors[i % NB_TAB_COLOR]);
+}
+
+static void _bench_circle(struct _gfx_surface *surface, uint32_t i)
+{
+	gfx_fill_circle(surface, surface->width / 2, surface->height / 2,
+			BENCH_SIZE / 2, test_colors[i % NB_TAB_COLOR]);
+}
+
+static void _bench_blend(struct _gfx_surface *surface, uint32_t i)
+{
+	gfx_blend_rect(surface, (i * 7) % (surface->width - BENCH_SIZE),
+		       (i * 5) % (surface->height - BENCH_SIZE),
+		       BENCH_SIZE, BENCH_SIZE, test_colors[i % NB_TAB_COLOR], 0x80);
+}
+
+static void _bench_blit(struct _gfx_surface *surface, uint32_t i)
+{
+	gfx_blit(surface, (i * 7) % (surface->width - BENCH_SIZE),
+		 (i * 5) % (surface->height - BENCH_SIZE), _heo_buffer_rgb,
+		 BENCH_SIZE * surface->bpp / 8, BENCH_SIZE, BENCH_SIZE);
+}
+
+static void _bench_text(struct _gfx_surface *surface, uint32_t i)
+{
+	gfx_draw_string(surface, lcd_get_font(), (i * 7) % (surface->width / 2),
+			(i * 5) % (surface->height - 16), "Drawing benchmark",
+			test_colors[i % NB_TAB_COLOR], 0, false);
+}
+
+static void _bench_present(struct _gfx_surface *surface, uint32_t i)
+{
+	_bench_fill(surface, i);
+	gfx_present(surface);
+}
+
+/**
+ * Measure the number of primitives drawn per second, on an off-screen
+ * surface over the base layer buffer, for each RGB pixel size.
+ */
+static void _benchmark(void)
+{
+	static const struct _bench_test tests[] = {
+		{ "fill 64x64", false, _bench_fill },
+		{ "fill screen", false, _bench_fill_screen },
+		{ "fill screen (DMA)", true, _bench_fill_screen },
+		{ "line", false, _bench_line },
+		{ "filled circle r32", false, _bench_circle },
+		{ "blend 64x64", false, _bench_blend },
+		{ "blit 64x64", false, _bench_blit },
+		{ "text 17 chars", false, _bench_text },
+		{ "fill 64x64+present", false, _bench_present },
+	};
+	static const uint8_t bpps[] = { 16, 24, 32 };
+	uint64_t start, elapsed;
+	uint32_t count;
+	uint8_t t, b;
+
+	lcd_select_font(FONT10x14);
+	printf("\r\n-- Drawing benchmark, primitives/s --\r\n");
+	printf("%-20s %8s %8s %8s\r\n", "", "16bpp", "24bpp", "32bpp");
+	for (t = 0; t < ARRAY_SIZE(tests); t++) {
+		if (tests[t].dma && !dma_enabled)
+			continue;
+		printf("%-20s", tests[t].name);
+		for (b = 0; b < ARRAY_SIZE(bpps); b++) {
+			gfx_init_surface(&bench_surface, _base_buffer,
+					 BOARD_LCD_WIDTH, BOARD_LCD_HEIGHT,
+					 bpps[b]);
+			gfx_enable_dma(&bench_surface, tests[t].dma, 0);
+			count = 0;
+			start = timer_get_tick();
+			do {
+				tests[t].draw(&bench_surface, count++);
+				elapsed = timer_get_interval(start, timer_get_tick());
+			} while (elapsed < BENCH_TIME);
+			gfx_sync(&bench_surface);
+			elapsed = timer_get_interval(start, timer_get_tick());
+			printf(" %8u", (unsigned)(count * 1000 / elapsed));
+		}
+		printf("\r\n");
+	}
+
+	/* Restore the base layer */
+	test_pattern_24RGB(_base_buffer);
+	cache_clean_region(_base_buffer, sizeof(_base_buffer));
+}
+
 /**
  * Move layers.
  */
@@ -687,6 +813,9 @@ static void dbg_events(void)
 										heo_img_h, 0);
 				break;
 #endif
+			case 'b': /* Drawing benchmark */
+				_benchmark();
+				break;
 		}
 	}
 }
@@ -711,6 +840,12 @@ extern int main(void)
 	/* Output example information */
 	console_example_info("LCD Example");
 
+	/* Draw large areas with the DMA */
+	if (dma_job_initialize(1) > 0) {
+		dma_enabled = true;
+		lcd_enable_dma(true);
+	}
+
 	/* Configure LCD */
 	_LcdOn();
 
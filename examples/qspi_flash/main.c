@@ -70,7 +70,9 @@
  *     -- SAMxxxxx-xx
  *     -- Compiled: xxx xx xxxx xx:xx:xx --
  *    \endcode
- * -# Choose an item in the menu to test.
+ * -# The example erases, writes and reads back a flash block, then reports
+ *    the read bandwidth for several transfer sizes, with and without the
+ *    read cache.
  *
  * \section References
  * - qspi_flash/main.c
@@ -95,14 +97,38 @@
 #include "peripherals/pmc.h"
 #include "serial/console.h"
 #include "spi/qspi.h"
+#include "timer.h"
 #include "trace.h"
 
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** Number of bytes read for each bandwidth measurement */
+#define BENCH_TOTAL_SIZE (256 * 1024)
+
+/** Size of the flash area targeted by random reads */
+#define BENCH_RANDOM_AREA (8 * 1024)
+
+#define READ_CACHE_LINE_SIZE 1024
+#define READ_CACHE_LINES 8
+
 /*----------------------------------------------------------------------------
  *        Local variables
  *----------------------------------------------------------------------------*/
 
 CACHE_ALIGNED static uint8_t buf[768];
 
+CACHE_ALIGNED static uint8_t bench_buf[4096];
+
+CACHE_ALIGNED static uint8_t read_cache_buffer[READ_CACHE_LINES * READ_CACHE_LINE_SIZE];
+
+static struct spi_flash_cache read_cache;
+
+static const uint32_t bench_sizes[] = { 16, 64, 256, 1024, 4096 };
+
+static volatile bool read_done;
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -120,6 +146,72 @@ static void _display_buf(uint8_t *buffer, uint32_t size)
 	printf("\r\n");
 }
 
+static int _read_callback(void* arg, void* arg2)
+{
+	read_done = true;
+	return 0;
+}
+
+static void _display_bandwidth(const char* label, uint32_t size, uint32_t total, uint64_t ms)
+{
+	if (ms == 0)
+		ms = 1;
+	printf("  %-8s %5u bytes: %6u KB/s\r\n", label, (unsigned)size,
+	       (unsigned)((uint64_t)total * 1000 / (ms * 1024)));
+}
+
+static void _bench_sequential(struct spi_flash *flash, uint32_t start)
+{
+	struct _callback cb;
+	uint32_t i, j, count;
+	uint64_t tick;
+
+	callback_set(&cb, _read_callback, NULL);
+
+	printf("sequential reads:\r\n");
+	for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		count = BENCH_TOTAL_SIZE / bench_sizes[i];
+		tick = timer_get_tick();
+		for (j = 0; j < count; j++) {
+			read_done = false;
+			spi_flash_read_async(flash, start + j * bench_sizes[i], bench_buf, bench_sizes[i], &cb);
+			while (!read_done) { }
+		}
+		_display_bandwidth("async", bench_sizes[i], BENCH_TOTAL_SIZE,
+				   timer_get_interval(tick, timer_get_tick()));
+	}
+}
+
+static void _bench_random(struct spi_flash *flash, uint32_t start, const char* label)
+{
+	const uint32_t size = 32;
+	const uint32_t count = BENCH_TOTAL_SIZE / 64;
+	uint32_t i, seed = 1;
+	uint64_t tick;
+
+	tick = timer_get_tick();
+	for (i = 0; i < count; i++) {
+		seed = seed * 1103515245 + 12345;
+		spi_flash_read(flash, start + (seed >> 8) % (BENCH_RANDOM_AREA - size), bench_buf, size);
+	}
+	_display_bandwidth(label, size, count * size,
+			   timer_get_interval(tick, timer_get_tick()));
+}
+
+static void _bench_read(struct spi_flash *flash, uint32_t start)
+{
+	_bench_sequential(flash, start);
+
+	printf("random reads:\r\n");
+	_bench_random(flash, start, "uncached");
+	spi_flash_set_cache(flash, &read_cache, read_cache_buffer,
+			    READ_CACHE_LINE_SIZE, READ_CACHE_LINES);
+	_bench_random(flash, start, "cached");
+	printf("  cache: %u hits, %u misses\r\n",
+	       (unsigned)read_cache.hits, (unsigned)read_cache.misses);
+	spi_flash_set_cache(flash, NULL, NULL, 0, 0);
+}
+
 /*----------------------------------------------------------------------------
  *        Global functions
  *----------------------------------------------------------------------------*/
@@ -167,5 +259,7 @@ int main(void)
 	printf("read returns %d\r\n", rc);
 	_display_buf(buf, sizeof(buf));
 
+	_bench_read(flash, start);
+
 	while (1) { }
 }
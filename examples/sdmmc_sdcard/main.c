@@ -295,6 +295,10 @@ CACHE_ALIGNED_DDR static uint8_t data_buf[BLOCK_CNT_MAX * 512ul];
 NOT_CACHED static FATFS fs_header;
 NOT_CACHED static FIL f_header;
 
+/* Cluster link map of the file being read (fast seek).
+ * Two entries per fragment of the file, plus two. */
+static DWORD f_clmt[34];
+
 #ifdef CONFIG_HAVE_SHA
 static struct _shad_desc shad;
 static uint32_t hash[5] = { 0 };
@@ -498,6 +502,15 @@ static bool read_file(uint8_t slot_ix, sSdCard *pSd, FATFS *fs)
 		printf("Failed to open \"%s\", error %d\n\r", file_path, res);
 		return false;
 	}
+	/* Map the cluster chain once, so that f_read does not walk the FAT */
+	f_clmt[0] = ARRAY_SIZE(f_clmt);
+	f_header.cltbl = f_clmt;
+	res = f_lseek(&f_header, CREATE_LINKMAP);
+	if (res != FR_OK) {
+		/* File too fragmented for the map, keep on using the FAT */
+		f_header.cltbl = NULL;
+		res = FR_OK;
+	}
 #ifdef CONFIG_HAVE_SHA
 	shad_start(&shad);
 #endif
@@ -96,6 +96,7 @@
 #include "serial/console.h"
 #include "serial/usart.h"
 #include "serial/usartd.h"
+#include "timer.h"
 
 
 #ifdef VARIANT_DDRAM
@@ -106,6 +107,15 @@
 #define READ_BUFFER_SIZE  256
 #endif
 
+/** Continuous receive buffer used by the loopback test */
+#define STREAM_BUFFER_SIZE 4096
+
+/** Number of bytes sent at each baudrate by the loopback test */
+#define STREAM_TEST_SIZE (64 * 1024)
+
+/** Abort the loopback test after this many ms without data */
+#define STREAM_TEST_IDLE 200
+
 #if defined(CONFIG_BOARD_SAMA5D2_PTC_EK)
 #define USART_ADDR FLEXUSART4
 #define USART_PINS PINS_FLEXCOM4_USART_IOS3
@@ -170,6 +180,10 @@ static const struct _pin usart_pins[] = USART_PINS;
 
 CACHE_ALIGNED static uint8_t cmd_buffer[CMD_BUFFER_SIZE];
 CACHE_ALIGNED static uint8_t read_buffer[READ_BUFFER_SIZE];
+CACHE_ALIGNED static uint8_t stream_buffer[STREAM_BUFFER_SIZE];
+CACHE_ALIGNED static uint8_t stream_pattern[1024];
+
+static const uint32_t stream_baudrates[] = { 115200, 460800, 921600, 3000000 };
 
 typedef void (*_parser)(const uint8_t*, uint32_t);
 
@@ -269,6 +283,86 @@ static void _usart_write_arg_parser(const uint8_t* buffer, uint32_t len)
 	usartd_wait_tx_transfer(0);
 }
 
+static void _usart_stream_test_baudrate(uint32_t baudrate)
+{
+	struct _usartd_stream_stats stats;
+	struct _buffer tx = {
+		.data = stream_pattern,
+		.size = sizeof(stream_pattern),
+		.attr = USARTD_BUF_ATTR_WRITE,
+	};
+	struct _callback _cb = {
+		.method = _usart_finish_tx_transfer_callback,
+		.arg = 0,
+	};
+	const uint8_t* data;
+	uint32_t sent = 0, checked = 0, errors = 0, len, i;
+	uint8_t expected = 0;
+	uint64_t start, last;
+
+	usart_set_async_baudrate(usart_desc.addr, baudrate);
+	usart_set_rx_timeout(usart_desc.addr, baudrate, usart_desc.timeout);
+
+	if (usartd_start_rx_stream(0, stream_buffer, sizeof(stream_buffer), NULL) != USARTD_SUCCESS) {
+		printf("Cannot start continuous reception\r\n");
+		return;
+	}
+
+	start = last = timer_get_tick();
+	while (checked < STREAM_TEST_SIZE) {
+		if (sent < STREAM_TEST_SIZE && !usartd_tx_is_busy(0)) {
+			usartd_transfer(0, &tx, &_cb);
+			sent += tx.size;
+		}
+
+		len = usartd_rx_stream_get(0, &data);
+		if (len) {
+			for (i = 0; i < len; i++) {
+				if (data[i] != expected)
+					errors++;
+				/* resynchronize after dropped bytes */
+				expected = data[i] + 1;
+			}
+			usartd_rx_stream_release(0, len);
+			checked += len;
+			last = timer_get_tick();
+		} else if (timer_get_interval(last, timer_get_tick()) > STREAM_TEST_IDLE) {
+			break;
+		}
+	}
+	last = timer_get_interval(start, last);
+
+	usartd_rx_stream_get_stats(0, &stats);
+	usartd_stop_rx_stream(0);
+	usartd_wait_tx_transfer(0);
+
+	printf("%8u baud: %6u bytes in %5u ms, %7u B/s, "
+	       "dropped %u, overruns %u, errors %u\r\n",
+	       (unsigned)baudrate, (unsigned)checked, (unsigned)last,
+	       last ? (unsigned)(checked * 1000ull / last) : 0,
+	       (unsigned)(stats.dropped + STREAM_TEST_SIZE - stats.received),
+	       (unsigned)stats.overruns, (unsigned)errors);
+}
+
+static void _usart_stream_test(void)
+{
+	uint8_t mode = usart_desc.transfer_mode;
+	int i;
+
+	printf("Continuous reception loopback test, TX and RX must be connected\r\n");
+
+	for (i = 0; i < sizeof(stream_pattern); i++)
+		stream_pattern[i] = i;
+
+	usart_desc.transfer_mode = USARTD_MODE_DMA;
+	for (i = 0; i < ARRAY_SIZE(stream_baudrates); i++)
+		_usart_stream_test_baudrate(stream_baudrates[i]);
+	usart_desc.transfer_mode = mode;
+
+	usart_set_async_baudrate(usart_desc.addr, usart_desc.baudrate);
+	usart_set_rx_timeout(usart_desc.addr, usart_desc.baudrate, usart_desc.timeout);
+}
+
 static void print_menu(void)
 {
 	printf("\r\n\r\nUSART transfer mode: ");
@@ -294,6 +388,8 @@ static void print_menu(void)
 	       "| m async                                               |\r\n"
 	       "| m dma                                                 |\r\n"
 	       "|      Select transfer mode                             |\r\n"
+	       "| s                                                     |\r\n"
+	       "|      Continuous reception loopback test (TX on RX)    |\r\n"
 #ifdef CONFIG_HAVE_USART_FIFO
 	       "| f fifo                                                |\r\n"
 	       "|      Toggle FIFO feature                              |\r\n"
@@ -342,6 +438,10 @@ static void _usart_cmd_parser(const uint8_t* buffer, uint32_t len)
 		print_menu();
 		return;
 	}
+	if (*buffer == 's') {
+		_usart_stream_test();
+		return;
+	}
 	if (*(buffer+1) != ' ') {
 		printf("Commands can only be one caracter size\r\n");
 		printf("%c%c\r\n", *buffer, *(buffer+1));
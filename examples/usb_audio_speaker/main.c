@@ -53,6 +53,15 @@
  *  amplifier. At the same time, the audio stream received is also sent
  *  back to host from EK for recording.
  *
+ *  The audio stream goes through the audio mixer library (lib/audio): the
+ *  USB frames are queued in a ring buffer and resampled to the clock of the
+ *  DAC by an adaptive sample-rate converter that follows the fill level of
+ *  the ring, so the drift between the host and the DAC clocks does not
+ *  cause under- or overruns. The DAC is fed by a circular DMA transfer over
+ *  a few periods, each rendered by the mixer as soon as it has been played,
+ *  and is never stopped (silence is played when there is no stream).
+ *  A test tone can be mixed with the USB stream.
+ *
  *  \section Usage
  *
  *  -# Build the program and download it inside the evaluation board. Please
@@ -84,6 +93,9 @@
  *     device list.
  *  -# You can play sound in host side through the USB Audio Device, and it
  *     can be heard from the speaker connected to the EK.
+ *  -# Input 't' to mix a 1 kHz test tone with the USB stream, 's' to display
+ *     the fill level, clock correction, under/overruns of the streams and
+ *     the mixer load.
  *
  *  \section References
  *  - usb_audio_speaker/main.c
@@ -112,14 +124,18 @@
 #include <string.h>
 
 #include "audio/audio_device.h"
+#include "audio/audio_mixer.h"
 #include "board.h"
 #include "chip.h"
 #include "compiler.h"
 #include "dma/dma.h"
+#include "dma/dma_cyclic.h"
 #include "led/led.h"
 #include "main_descriptors.h"
 #include "mm/cache.h"
+#include "peripherals/pmc.h"
 #include "serial/console.h"
+#include "timer.h"
 #include "trace.h"
 #include "../usb_common/main_usb_common.h"
 #include "usb/device/audio/audd_speaker_driver.h"
@@ -150,15 +166,27 @@
  *         Definitions
  *----------------------------------------------------------------------------*/
 
-/**  Number of available audio buffers. */
-#define BUFFERS (32)
+/** Number of frames of the USB stream ring (power of two) */
+#define STREAM_FRAMES (1024)
+
+/** Number of frames of the test tone ring (power of two) */
+#define TONE_FRAMES (256)
+
+/** Mixer streams */
+#define STREAM_USB  (0)
+#define STREAM_TONE (1)
+
+/** Number of frames of one DAC period */
+#define PERIOD_FRAMES (96)
 
-/**  Size of one buffer in bytes. */
-#define BUFFER_SIZE ROUND_UP_MULT(AUDDSpeakerDriver_BYTESPERFRAME, L1_CACHE_BYTES)
+/** Number of periods of the DAC buffer */
+#define PERIOD_COUNT (3)
 
-/**  Delay (in number of buffers) before starting the DAC transmission
-     after data has been received. */
-#define BUFFER_THRESHOLD (8)
+/** Size of one DAC period in bytes */
+#define PERIOD_SIZE (PERIOD_FRAMES * AUDDSpeakerDriver_BYTESPERSUBFRAME)
+
+/** Size of the USB receive buffer */
+#define USB_BUFFER_SIZE ROUND_UP_MULT(AUDDSpeakerDriver_BYTESPERFRAME, L1_CACHE_BYTES)
 
 /*----------------------------------------------------------------------------
  *         External variables
@@ -171,33 +199,40 @@ extern const USBDDriverDescriptors audd_speaker_driver_descriptors;
  *         Internal variables
  *----------------------------------------------------------------------------*/
 
-/**  Data buffers for receiving audio frames from the USB host. */
-CACHE_ALIGNED static uint8_t _buffer[BUFFERS][BUFFER_SIZE];
-
-/**  Number of samples stored in each data buffer. */
-static uint32_t _samples[BUFFERS];
+/**  Data buffer for receiving audio frames from the USB host. */
+CACHE_ALIGNED static uint8_t _usb_buffer[USB_BUFFER_SIZE];
+
+/**  DAC buffer, played in a loop; periods are rendered once played.
+ *   PERIOD_SIZE must be a multiple of the cache line size. */
+CACHE_ALIGNED static int16_t _dac_buffer[PERIOD_COUNT * PERIOD_SIZE / sizeof(int16_t)];
+
+/**  Mixer and its stream rings */
+static struct _audio_mixer _mixer;
+static int16_t _stream_ring[STREAM_FRAMES * AUDDSpeakerDriver_NUMCHANNELS];
+static int16_t _tone_ring[TONE_FRAMES * AUDDSpeakerDriver_NUMCHANNELS];
+
+/**  One period of a 1 kHz tone at 48 kHz, -12 dB */
+static const int16_t _tone[48] = {
+	0, 1069, 2120, 3135, 4096, 4987, 5793, 6499,
+	7094, 7568, 7913, 8122, 8192, 8122, 7913, 7568,
+	7094, 6499, 5793, 4987, 4096, 3135, 2120, 1069,
+	0, -1069, -2120, -3135, -4096, -4987, -5793, -6499,
+	-7094, -7568, -7913, -8122, -8192, -8122, -7913, -7568,
+	-7094, -6499, -5793, -4987, -4096, -3135, -2120, -1069,
+};
 
 /**  Audio context */
 static struct _audio_ctx {
-	uint32_t* samples;
-	uint32_t threshold;
-	struct {
-		uint16_t rx;
-		uint16_t tx;
-		uint32_t count;
-	} circ;
 	uint8_t volume;
-	bool playing;
+	volatile bool tone;
+	struct {
+		uint32_t periods;
+		uint64_t ticks;
+		uint32_t max_ticks;
+	} load;
 } _audio_ctx = {
-	.samples = _samples,
-	.threshold = BUFFER_THRESHOLD,
-	.circ = {
-		.rx = 0,
-		.tx = 0,
-		.count = 0,
-	},
 	.volume =  (AUDIO_PLAY_MAX_VOLUME * 80) / 100,
-	.playing = false,
+	.tone = false,
 };
 
 #ifdef PINS_PUSHBUTTONS
@@ -210,76 +245,119 @@ static const struct _pin button_pins[] = PINS_PUSHBUTTONS;
  *----------------------------------------------------------------------------*/
 
 /**
- *  \brief Audio TX callback
+ *  \brief Render a DAC period and account for the time spent.
  */
-static int _audio_transfer_callback(void* arg, void* arg2)
+static void _render_period(int16_t* period)
 {
-	struct _audio_desc* desc = (struct _audio_desc*)arg;
-	struct _callback _cb;
+	uint64_t start = timer_get_raw_tick();
+	uint32_t ticks;
 
-	if (_audio_ctx.circ.count > 0) {
-		_audio_ctx.circ.tx = (_audio_ctx.circ.tx + 1) % BUFFERS;
-		_audio_ctx.circ.count--;
-		/* Load next buffer */
-		callback_set(&_cb, _audio_transfer_callback, desc);
-		audio_transfer(desc,
-			       _buffer[_audio_ctx.circ.tx],
-			       _audio_ctx.samples[_audio_ctx.circ.tx],
-			       &_cb);
-	} else {
-		_audio_ctx.playing = false;
-		audio_enable(desc, false);
-	}
+	audio_mixer_render(&_mixer, period, PERIOD_FRAMES);
+
+	ticks = (uint32_t)timer_get_interval(start, timer_get_raw_tick());
+	_audio_ctx.load.ticks += ticks;
+	_audio_ctx.load.periods++;
+	if (ticks > _audio_ctx.load.max_ticks)
+		_audio_ctx.load.max_ticks = ticks;
+}
+
+/**
+ *  \brief Audio period callback
+ *
+ *  Render the next samples in the period just played, while the DMA goes
+ *  on with the following ones.
+ */
+static int _audio_period_callback(void* arg, void* arg2)
+{
+	struct _dma_cyclic* stream = (struct _dma_cyclic*)arg;
+	uint32_t index = (uint32_t)arg2;
+
+	_render_period((int16_t*)dma_cyclic_get_period(stream, index));
+	dma_cyclic_commit(stream, 1);
 
 	return 0;
 }
 
+/**
+ *  \brief Start the DAC on a buffer of silence.
+ */
+static void _audio_start(struct _audio_desc* desc)
+{
+	struct _callback _cb;
+
+	memset(_dac_buffer, 0, sizeof(_dac_buffer));
+	audio_enable(desc, true);
+	callback_set(&_cb, _audio_period_callback, audio_get_stream(desc));
+	if (audio_start_stream(desc, _dac_buffer, sizeof(_dac_buffer),
+			       PERIOD_COUNT, &_cb) < 0)
+		printf("-E- Cannot start the DAC stream\r\n");
+}
+
 /**
  *  Invoked when a frame has been received.
  */
 static void _usb_frame_recv_callback(void* arg, uint8_t status, uint32_t transferred, uint32_t remaining)
 {
-	struct _audio_desc* desc = (struct _audio_desc*)arg;
-
 	if (status == USBD_STATUS_SUCCESS) {
-		if (_audio_ctx.circ.count >= (BUFFERS - 1)) {
-			_audio_ctx.circ.tx = (_audio_ctx.circ.tx + 1) % BUFFERS;
-			_audio_ctx.circ.count--;
-		}
-
-		_audio_ctx.samples[_audio_ctx.circ.rx] = transferred;
-		_audio_ctx.circ.rx = (_audio_ctx.circ.rx + 1) % BUFFERS;
-		_audio_ctx.circ.count++;
-
-		if (_audio_ctx.circ.count >= _audio_ctx.threshold) {
-			if (!_audio_ctx.playing) {
-				audio_enable(desc, true);
-				_audio_ctx.playing = true;
-			}
-			if (audio_transfer_is_done(&audio_device)) {
-				struct _callback _cb;
-
-				/* Start DAC transmission if necessary */
-				callback_set(&_cb, _audio_transfer_callback, desc);
-				audio_transfer(desc,
-					       _buffer[_audio_ctx.circ.tx],
-					       _audio_ctx.samples[_audio_ctx.circ.tx],
-					       &_cb);
-				_audio_ctx.circ.tx = (_audio_ctx.circ.tx + 1) % BUFFERS;
-				_audio_ctx.circ.count--;
-			}
-		}
-	} else if (status == USBD_STATUS_ABORTED) {
-		/* Error , ABORT, add NULL buffer */
-		_audio_ctx.samples[_audio_ctx.circ.rx] = 0;
+		audio_mixer_stream_write(&_mixer, STREAM_USB,
+				(const int16_t*)_usb_buffer,
+				transferred / AUDDSpeakerDriver_BYTESPERSUBFRAME);
 	} else {
 		/* Packet is discarded */
 	}
 
 	/* Receive next packet */
-	audd_speaker_driver_read(_buffer[_audio_ctx.circ.rx],
-				 AUDDSpeakerDriver_BYTESPERFRAME,
-				 _usb_frame_recv_callback, desc);
+	audd_speaker_driver_read(_usb_buffer, AUDDSpeakerDriver_BYTESPERFRAME,
+				 _usb_frame_recv_callback, arg);
+}
+
+/**
+ *  \brief Keep the test tone ring filled.
+ */
+static void _tone_fill(void)
+{
+	int16_t frames[ARRAY_SIZE(_tone) * AUDDSpeakerDriver_NUMCHANNELS];
+	unsigned i;
+
+	if (audio_mixer_stream_level(&_mixer, STREAM_TONE) + ARRAY_SIZE(_tone) > TONE_FRAMES)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(_tone); i++) {
+		frames[2 * i] = _tone[i];
+		frames[2 * i + 1] = _tone[i];
+	}
+	audio_mixer_stream_write(&_mixer, STREAM_TONE, frames, ARRAY_SIZE(_tone));
+}
+
+/**
+ *  \brief Display the stream statistics and the mixer load.
+ */
+static void _show_stats(void)
+{
+	struct _audio_mixer_stats stats;
+	struct _dma_cyclic_stats dac;
+	uint32_t periods = _audio_ctx.load.periods;
+	uint32_t freq = timer_get_raw_freq();
+	uint32_t cpu = pmc_get_processor_clock() / 1000;
+	uint32_t avg, max;
+
+	audio_mixer_stream_get_stats(&_mixer, STREAM_USB, &stats);
+	printf("USB: level %u/%u frames, %d ppm, %u underruns, %u overruns\r\n",
+	       (unsigned)audio_mixer_stream_level(&_mixer, STREAM_USB),
+	       (unsigned)STREAM_FRAMES, (int)stats.ppm,
+	       (unsigned)stats.underruns, (unsigned)stats.overruns);
+
+	dma_cyclic_get_stats(audio_get_stream(&audio_device), &dac);
+	printf("DAC: %u periods, %u underruns, %u late interrupts, position %u\r\n",
+	       (unsigned)dac.periods, (unsigned)dac.xruns, (unsigned)dac.late,
+	       (unsigned)dma_cyclic_get_position(audio_get_stream(&audio_device)));
+
+	if (periods && freq) {
+		/* CPU cycles per output frame */
+		avg = (uint32_t)((_audio_ctx.load.ticks * cpu * 1000 / freq) / periods / PERIOD_FRAMES);
+		max = (uint32_t)(((uint64_t)_audio_ctx.load.max_ticks * cpu * 1000 / freq) / PERIOD_FRAMES);
+		printf("Mixer: %u cycles/frame, max %u\r\n", (unsigned)avg, (unsigned)max);
+	}
 }
 
 static void console_handler(uint8_t key)
@@ -316,6 +394,18 @@ static void console_handler(uint8_t key)
 		audio_mute(&audio_device, true);
 		break;
 
+	case 't':
+	case 'T':
+		/* the tone stream is opened/closed by the main loop */
+		_audio_ctx.tone = !_audio_ctx.tone;
+		printf("Test tone %s\r\n", _audio_ctx.tone ? "on" : "off");
+		break;
+
+	case 's':
+	case 'S':
+		_show_stats();
+		break;
+
 	default:
 		break;
 	}
@@ -423,12 +513,8 @@ void audd_speaker_driver_mute_changed(uint8_t channel, uint8_t muted)
  */
 void audd_speaker_driver_stream_setting_changed(uint8_t new_setting)
 {
-	if (new_setting) {
-		audio_stop(&audio_device);
-		_audio_ctx.circ.count = 0;
-		_audio_ctx.circ.tx = 0;
-		_audio_ctx.circ.rx = 0;
-	}
+	if (new_setting)
+		audio_mixer_stream_flush(&_mixer, STREAM_USB);
 }
 
 /*----------------------------------------------------------------------------
@@ -443,9 +529,7 @@ void audd_speaker_driver_stream_setting_changed(uint8_t new_setting)
 int main(void)
 {
 	bool usb_conn = false;
-
-	int32_t jitter = 0, _jitter_curr;
-	int8_t clock_adjust = 0;
+	bool tone = false;
 
 	console_set_rx_handler(console_handler);
 	console_enable_rx_interrupt();
@@ -462,6 +546,13 @@ int main(void)
 	/* Configure audio play volume */
 	audio_set_volume(&audio_device, _audio_ctx.volume);
 
+	/* Mix the USB stream, resampled to the DAC clock */
+	audio_mixer_init(&_mixer, AUDDSpeakerDriver_NUMCHANNELS,
+			AUDDSpeakerDriver_SAMPLERATE);
+	audio_mixer_stream_open(&_mixer, STREAM_USB, _stream_ring,
+			STREAM_FRAMES, AUDDSpeakerDriver_SAMPLERATE);
+	_audio_start(&audio_device);
+
 #ifdef PINS_PUSHBUTTONS
 	configure_buttons();
 #endif
@@ -476,35 +567,32 @@ int main(void)
 	printf("Input '+' or '-' to increase or decrease volume\n\r");
 	printf("Input '0' or '1' to set volume to min / max\n\r");
 	printf("Input 'm' or 'u' to mute or unmute sound\n\r");
+	printf("Input 't' to toggle the test tone, 's' for statistics\n\r");
 	printf("=========================================================\n\r");
 
 	/* Infinite loop */
 	while (1) {
+		/* Test tone, produced by the main loop */
+		if (tone != _audio_ctx.tone) {
+			tone = _audio_ctx.tone;
+			if (tone)
+				audio_mixer_stream_open(&_mixer, STREAM_TONE, _tone_ring,
+						TONE_FRAMES, AUDDSpeakerDriver_SAMPLERATE);
+			else
+				audio_mixer_stream_close(&_mixer, STREAM_TONE);
+		}
+		if (tone)
+			_tone_fill();
+
 		if (usbd_get_state() < USBD_STATE_CONFIGURED) {
 			usb_conn = false;
 			continue;
 		}
 
-		_jitter_curr = (_audio_ctx.circ.count - _audio_ctx.threshold);
-
-		if (jitter != _jitter_curr) {
-			jitter = _jitter_curr;
-			if (jitter > 0 && clock_adjust != 1) {
-				/* USB too fast or SSC too slow: faster clock */
-				clock_adjust = 1;
-				audio_sync_adjust(&audio_device, clock_adjust);
-			}
-			if (jitter < 0 && clock_adjust != -1) {
-				/* USB too slow or SSC too fast: slower clock */
-				clock_adjust = -1;
-				audio_sync_adjust(&audio_device, clock_adjust);
-			}
-		}
-
 		if (!usb_conn) {
 			trace_info("USB connected\r\n");
 			/* Start Reading the incoming audio stream */
-			audd_speaker_driver_read(_buffer[_audio_ctx.circ.rx],
+			audd_speaker_driver_read(_usb_buffer,
 					AUDDSpeakerDriver_BYTESPERFRAME,
 					_usb_frame_recv_callback, &audio_device);
 
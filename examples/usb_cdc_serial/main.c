@@ -49,9 +49,14 @@
  * USB cable, the board appears as a serial COM port for the host, after driver
  * installation with the offered 6119.inf. Then the host can send or receive
  * data through the port with host software. The data stream from the host is
- * then sent to the board, and forward to USART port of AT91SAM chips. The USART
- * port of the board is monitored by the timer and the incoming data will be sent
- * to the host.
+ * then sent to the board, and forward to USART port of AT91SAM chips. The data
+ * received on the USART port of the board is sent to the host.
+ *
+ * The USB side uses the CDC streaming layer (cdcd_stream.h): received data
+ * is stored by the USB DMA in a ring buffer and sent to the USART by DMA
+ * straight from this ring; data received on the USART by the continuous DMA
+ * receive mode is sent to the host straight from the USART ring. When the
+ * USART ring fills up, RTS is deasserted.
  *
  * \section Usage
  *
@@ -85,6 +90,11 @@
  *    hardware device list.
  * -# You can run hyperterminal to send data to the port. And it can be seen
  *    at the other hyperterminal connected to the USART port of the boad.
+ * -# Press 't' on the console to run the throughput self-test: the board
+ *    streams TEST_TOTAL_SIZE bytes to the host in small writes (read them on
+ *    the host, e.g. "cat /dev/ttyACM0 > /dev/null") and reports the
+ *    throughput in MB/s and the write to host latency percentiles.
+ * -# Press 's' to display the stream statistics.
  *
  * \section References
  * - usb_cdc_serial/main.c
@@ -114,6 +124,10 @@
 
 #include "trace.h"
 #include "compiler.h"
+#include "intmath.h"
+#include "ring.h"
+#include "timer.h"
+#include "timer_wheel.h"
 
 #include "mm/cache.h"
 #include "serial/console.h"
@@ -127,6 +141,7 @@
 #include "serial/usart.h"
 
 #include "usb/device/cdc/cdcd_serial_driver.h"
+#include "usb/device/cdc/cdcd_stream.h"
 #include "usb/device/usbd.h"
 #include "usb/device/usbd_hal.h"
 
@@ -141,20 +156,24 @@
  *      Definitions
  *----------------------------------------------------------------------------*/
 
-/** Size in bytes of the packet used for reading data from the USB & USART */
-#define DATAPACKETSIZE (64)
+/** Size of the CDC stream RX and TX ring buffers */
+#define STREAM_RX_SIZE      (16*1024)
+#define STREAM_TX_SIZE      (16*1024)
 
-/** Size in bytes of the buffer used for reading data from the USB & USART */
-#define DATABUFFERSIZE (DATAPACKETSIZE+2)
+/** Max delay of a partial packet sent to the host */
+#define STREAM_LATENCY_US   (1000)
 
-/** Basic asynchronous mode, i.e. 8 bits no parity.*/
-#define USART_MODE_ASYNCHRONOUS        (US_MR_CHMODE_NORMAL | US_MR_CHRL_8_BIT | US_MR_PAR_NO)
+/** Size of the USART receive ring buffer */
+#define USART_RX_SIZE       (4*1024)
 
-/** test buffer size */
-#define TEST_BUFFER_SIZE    (2*1024)
+/** Self-test: bytes sent to the host and size of each write */
+#define TEST_TOTAL_SIZE     (16*1024*1024)
+#define TEST_CHUNK_SIZE     (100)
 
-/** write loop count */
-#define TEST_COUNT          (1)
+/** Self-test: number of in-flight latency samples and histogram buckets
+ *  (bucket n counts latencies below 2^n microseconds) */
+#define TEST_SAMPLES        (256)
+#define TEST_BUCKETS        (24)
 
 /** define the peripherals and pins used for USART */
 #if defined(CONFIG_BOARD_SAMA5D2_PTC_EK)
@@ -229,8 +248,12 @@ extern const USBDDriverDescriptors cdcd_serial_driver_descriptors;
 
 static const struct _pin usart_pins[] = USART_PINS;
 
-/** Buffer for storing incoming USB data. */
-CACHE_ALIGNED static uint8_t usb_buffer[DATABUFFERSIZE];
+/** CDC stream ring buffers */
+CACHE_ALIGNED static uint8_t stream_rx_buffer[STREAM_RX_SIZE];
+CACHE_ALIGNED static uint8_t stream_tx_buffer[STREAM_TX_SIZE];
+
+/** USART receive ring buffer */
+CACHE_ALIGNED static uint8_t usart_rx_buffer[USART_RX_SIZE];
 
 /** Serial Port ON/OFF */
 static uint8_t is_cdc_serial_on = 0;
@@ -238,48 +261,34 @@ static uint8_t is_cdc_serial_on = 0;
 /** CDC Echo back ON/OFF */
 static uint8_t is_cdc_echo_on = 0;
 
-/** USB Tx flag */
-static volatile uint8_t tx_done_flag = 0;
-/** Test buffer */
-CACHE_ALIGNED static uint8_t test_buffer[TEST_BUFFER_SIZE];
+/** Bytes in flight from the stream RX ring to the USART, and from the
+ *  USART ring to the USB */
+static volatile uint32_t usart_tx_len = 0;
+static volatile uint32_t usb_tx_len = 0;
+
+/** RTS deasserted (USART ring above its high watermark) */
+static bool usart_rts_off = false;
+
+/** Self-test buffer */
+static uint8_t test_buffer[TEST_CHUNK_SIZE];
+
+/** Self-test latency samples: stream offset of the end of a write and
+ *  time of the write */
+static struct {
+	uint32_t end;
+	uint64_t tick;
+} test_samples[TEST_SAMPLES];
+
+static uint32_t test_histogram[TEST_BUCKETS];
 
 static struct _usart_desc usart_desc = {
 	.addr           = USART_ADDR,
 	.baudrate       = 115200,
 	.mode           = US_MR_CHMODE_NORMAL | US_MR_PAR_NO | US_MR_CHRL_8_BIT,
-	.transfer_mode = USARTD_MODE_DMA,
+	.transfer_mode  = USARTD_MODE_DMA,
+	.timeout        = 1,
 };
 
-static volatile bool usart_rx_flag = false;
-static volatile uint8_t char_recv;
-
-/*----------------------------------------------------------------------------
- *         Internal Prototypes
- *----------------------------------------------------------------------------*/
-
-/*----------------------------------------------------------------------------
- *  Interrupt handlers
- *----------------------------------------------------------------------------*/
-
-/**
- * USART interrupt handler
- */
-static void usart_irq_handler(uint32_t source, void* user_arg)
-{
-	assert(source == get_usart_id_from_addr(usart_desc.addr));
-
-	Usart* p_us = usart_desc.addr;
-
-	/* If USB device is not configured, do nothing */
-	if (!is_cdc_serial_on) {
-		usart_disable_it(p_us, 0xFFFFFFFF);
-		return;
-	}
-	char_recv = usart_get_char(p_us);
-	usart_rx_flag = true;
-	p_us->US_CR = US_CR_RSTSTA;
-}
-
 /*-----------------------------------------------------------------------------
  *         Callback re-implementation
  *-----------------------------------------------------------------------------*/
@@ -307,65 +316,93 @@ void usbd_callbacks_request_received(const USBGenericRequest *request)
  *         Internal functions
  *----------------------------------------------------------------------------*/
 
-static int _usart_finish_tx_transfer_callback(void* arg, void* arg2)
+/**
+ * Callback invoked when the USART has sent data of the stream RX ring
+ */
+static int _usart_tx_done(void* arg, void* arg2)
 {
-	usartd_finish_tx_transfer(0);
+	uint32_t len = usart_tx_len;
+
+	usart_tx_len = 0;
+	cdcd_stream_read_release(len);
 	return 0;
 }
 
 /**
- *  \brief Send single buffer data through DMA
+ * Callback invoked when the USB has sent data of the USART ring
  */
-static void _usart_dma_tx(const uint8_t* buffer, uint32_t len )
+static void _usb_tx_done(void *arg, uint8_t status,
+		uint32_t transferred, uint32_t remaining)
 {
+	uint32_t len = usb_tx_len;
 
-	struct _buffer tx = {
-		.data = (unsigned char*)buffer,
-		.size = len,
-		.attr = USARTD_BUF_ATTR_WRITE,
-	};
-	struct _callback _cb = {
-		.method = _usart_finish_tx_transfer_callback,
-		.arg = 0,
-	};
-	usartd_transfer(0, &tx, &_cb);
-
+	usb_tx_len = 0;
+	usartd_rx_stream_release(0, len);
 }
 
 /**
- * Callback invoked when data has been received on the USB.
+ * Forward data between the USB and the USART, without copy
  */
-static void _usb_data_received(void *read, uint8_t status,
-		uint32_t received, uint32_t remaining)
+static void _bridge_forward(void)
 {
-	/* Check that data has been received successfully */
-	if (status == USBD_STATUS_SUCCESS) {
-		*(uint8_t *)read = 1;
-		/* Send back CDC data */
-		if (is_cdc_echo_on){
-
-			cdcd_serial_driver_write(usb_buffer, received, 0, 0);
-		}
-		/* Send data through USART */
-		if (is_cdc_serial_on) {
-
-			_usart_dma_tx( usb_buffer, received );
+	const void* data;
+	const uint8_t* usart_data;
+	uint32_t len;
+
+	/* USB -> USART, from the stream RX ring */
+	if (usart_tx_len == 0) {
+		len = cdcd_stream_read_acquire(&data);
+		if (len) {
+			struct _buffer tx = {
+				.data = (uint8_t*)data,
+				.size = len,
+				.attr = USARTD_BUF_ATTR_WRITE,
+			};
+			struct _callback cb = {
+				.method = _usart_tx_done,
+				.arg = 0,
+			};
+			usart_tx_len = len;
+			if (usartd_transfer(0, &tx, &cb) != USARTD_SUCCESS)
+				usart_tx_len = 0;
 		}
+	}
 
-		/* Check if bytes have been discarded */
-		if ((received == DATAPACKETSIZE) && (remaining > 0)) {
-
-			trace_warning(
-				"_usb_data_received: %u bytes discarded\n\r",
-					(unsigned int)remaining);
+	/* USART -> USB, from the USART ring */
+	if (usb_tx_len == 0) {
+		len = usartd_rx_stream_get(0, &usart_data);
+		if (len) {
+			usb_tx_len = len;
+			if (cdcd_stream_send(usart_data, len, _usb_tx_done, NULL)
+					!= USBD_STATUS_SUCCESS)
+				usb_tx_len = 0;
 		}
-	} else {
+	}
 
-		trace_warning( "_usb_data_received: Transfer error\n\r");
+	/* Flow control: deassert RTS while the USART ring is nearly full */
+	if (!usart_rts_off && ring_is_high(&usart_desc.stream.ring)) {
+		usart_desc.addr->US_CR = US_CR_RTSDIS;
+		usart_rts_off = true;
+	} else if (usart_rts_off && ring_is_low(&usart_desc.stream.ring)) {
+		usart_desc.addr->US_CR = US_CR_RTSEN;
+		usart_rts_off = false;
 	}
 }
 
+/**
+ * Echo the data received on the USB back to the host
+ */
+static void _echo_forward(void)
+{
+	const void* data;
+	uint32_t len;
 
+	len = cdcd_stream_read_acquire(&data);
+	if (len) {
+		len = cdcd_stream_write(data, len);
+		cdcd_stream_read_release(len);
+	}
+}
 
 /**
  * console help dump
@@ -373,63 +410,145 @@ static void _usb_data_received(void *read, uint8_t status,
 static void _debug_help(void)
 {
 	printf("-- ESC to Enable/Disable ECHO on cdc serial --\n\r");
-	printf("-- Press 't' to test trasfer --\n\r");
+	printf("-- Press 't' to run the throughput self-test --\n\r");
+	printf("-- Press 's' to display the stream statistics --\n\r");
 }
 
-
 /**
- * Callback invoked when data has been sent.
+ * Display the CDC stream and USART statistics
  */
-static void _usb_data_sent(void *arg, uint8_t status, uint32_t transferred, uint32_t remaining)
+static void _show_stats(void)
 {
-	tx_done_flag = 1;
+	struct _cdcd_stream_stats stats;
+	struct _usartd_stream_stats usart_stats;
+
+	cdcd_stream_get_stats(&stats);
+	usartd_rx_stream_get_stats(0, &usart_stats);
+
+	printf("-- USB RX: %u bytes, %u transfers, %u stalls\n\r",
+			(unsigned)stats.rx_bytes, (unsigned)stats.rx_transfers,
+			(unsigned)stats.rx_stalls);
+	printf("-- USB TX: %u bytes, %u transfers, %u timeouts, %u full\n\r",
+			(unsigned)stats.tx_bytes, (unsigned)stats.tx_transfers,
+			(unsigned)stats.tx_timeouts, (unsigned)stats.tx_full);
+	printf("-- USART RX: %u bytes, %u dropped, %u overruns\n\r",
+			(unsigned)usart_stats.received, (unsigned)usart_stats.dropped,
+			(unsigned)usart_stats.overruns);
 }
 
-
 /**
- * Configure USART to work @ 115200
+ * Get the latency below which \a percent % of the self-test samples fall
+ * \return Bucket upper bound in microseconds
  */
-static void _configure_usart(void)
+static uint32_t _test_percentile(uint32_t count, uint32_t percent)
 {
-	Usart* usart = usart_desc.addr;
-	uint32_t id = get_usart_id_from_addr(usart);
-	/* Driver initialize */
-	usartd_configure(0, &usart_desc);
-	pio_configure(usart_pins, ARRAY_SIZE(usart_pins));
-	usart_enable_it(usart, US_IER_RXRDY);
-	irq_add_handler(id, usart_irq_handler, NULL);
-	irq_enable(id);
+	uint32_t i, sum = 0, target = (count * percent + 99) / 100;
+
+	for (i = 0; i < TEST_BUCKETS; i++) {
+		sum += test_histogram[i];
+		if (sum >= target)
+			break;
+	}
+	return 1u << min_u32(i, TEST_BUCKETS - 1);
 }
 
 /**
- * Test USB CDC Serial
+ * Throughput self-test: stream TEST_TOTAL_SIZE bytes to the host in
+ * TEST_CHUNK_SIZE writes and measure the time until each write has been
+ * sent to the host.
  */
-static void _send_text(void)
+static void _stream_test(void)
 {
-	uint32_t i, test_cnt;
-
-	if (!is_cdc_serial_on) {
+	struct _cdcd_stream_stats stats;
+	uint32_t i, written = 0, samples = 0, in = 0, out = 0;
+	uint64_t start, end, now, latency;
+	uint32_t freq = timer_get_raw_freq();
+	uint32_t us, rate;
 
+	if (!cdcd_stream_is_running()) {
 		printf("\n\r!! Host serial program not ready!\n\r");
 		return;
 	}
-	printf("\n\r- USB CDC Serial writing ...\n\r");
-
-	/* Test data initialize */
-	for (i = 0; i < TEST_BUFFER_SIZE; i ++) test_buffer[i] = (i % 10) + '0';
+	printf("\n\r- Streaming %u bytes to the host...\n\r",
+			(unsigned)TEST_TOTAL_SIZE);
+
+	for (i = 0; i < TEST_CHUNK_SIZE; i++)
+		test_buffer[i] = (i % 10) + '0';
+	memset(test_histogram, 0, sizeof(test_histogram));
+
+	/* Wait for the bridge traffic to drain */
+	while (usb_tx_len);
+	cdcd_stream_reset_stats();
+
+	start = timer_get_raw_tick();
+	while (out < in || written < TEST_TOTAL_SIZE) {
+		if (written < TEST_TOTAL_SIZE && in - out < TEST_SAMPLES &&
+		    cdcd_stream_tx_space() >= TEST_CHUNK_SIZE) {
+			written += cdcd_stream_write(test_buffer, TEST_CHUNK_SIZE);
+			test_samples[in % TEST_SAMPLES].end = written;
+			test_samples[in % TEST_SAMPLES].tick = timer_get_raw_tick();
+			in++;
+		}
 
-	printf("- Send 0,1,2 ... to host:\n\r");
-	for (test_cnt = 0; test_cnt < TEST_COUNT; test_cnt ++) {
+		cdcd_stream_get_stats(&stats);
+		now = timer_get_raw_tick();
+		while (out < in && stats.tx_bytes >= test_samples[out % TEST_SAMPLES].end) {
+			latency = timer_get_interval(test_samples[out % TEST_SAMPLES].tick, now);
+			us = freq ? (latency * 1000000ull) / freq : 0;
+			test_histogram[min_u32(32 - __builtin_clz(us | 1), TEST_BUCKETS - 1)]++;
+			samples++;
+			out++;
+		}
 
-		tx_done_flag = 0;
-		cdcd_serial_driver_write(test_buffer, TEST_BUFFER_SIZE,
-				_usb_data_sent, NULL);
-		while(!tx_done_flag);
+		if (!cdcd_stream_is_running()) {
+			printf("!! Stream stopped\n\r");
+			return;
+		}
 	}
+	end = timer_get_raw_tick();
+
+	us = freq ? (timer_get_interval(start, end) * 1000000ull) / freq : 0;
+	rate = us ? (uint32_t)(((uint64_t)written * 100) / us) : 0;
+	printf("- %u bytes in %u ms: %u.%02u MB/s\n\r", (unsigned)written,
+			(unsigned)(us / 1000), (unsigned)(rate / 100),
+			(unsigned)(rate % 100));
+	printf("- Latency p50 < %u us, p90 < %u us, p99 < %u us, max < %u us\n\r",
+			(unsigned)_test_percentile(samples, 50),
+			(unsigned)_test_percentile(samples, 90),
+			(unsigned)_test_percentile(samples, 99),
+			(unsigned)_test_percentile(samples, 100));
+	_show_stats();
+}
+
+/**
+ * Configure USART to work @ 115200, receiving in continuous mode
+ */
+static void _configure_usart(void)
+{
+	/* Driver initialize */
+	usartd_configure(0, &usart_desc);
+	pio_configure(usart_pins, ARRAY_SIZE(usart_pins));
+	usartd_start_rx_stream(0, usart_rx_buffer, USART_RX_SIZE, NULL);
+	ring_set_watermarks(&usart_desc.stream.ring, USART_RX_SIZE / 4,
+			USART_RX_SIZE * 3 / 4);
+}
+
+/**
+ * Configure the CDC stream
+ */
+static void _configure_stream(void)
+{
+	struct _cdcd_stream_cfg cfg = {
+		.rx_buffer = stream_rx_buffer,
+		.rx_size = STREAM_RX_SIZE,
+		.tx_buffer = stream_tx_buffer,
+		.tx_size = STREAM_TX_SIZE,
+		.rx_transfer = 0,
+		.latency_us = STREAM_LATENCY_US,
+	};
 
-	/* Finish sending */
-	cdcd_serial_driver_write(NULL, 0, NULL, NULL);
-	_usart_dma_tx(test_buffer, TEST_BUFFER_SIZE);
+	timer_wheel_init();
+	cdcd_stream_init(&cfg);
 }
 
 /*----------------------------------------------------------------------------
@@ -443,9 +562,6 @@ static void _send_text(void)
  */
 int main(void)
 {
-	uint8_t is_usb_connected = 0;
-	uint8_t usb_serial_read = 1;
-
 	/* Output example information */
 	console_example_info("USB Device CDC Serial Example");
 
@@ -457,6 +573,7 @@ int main(void)
 
 	/* CDC serial driver initialization */
 	cdcd_serial_driver_initialize(&cdcd_serial_driver_descriptors);
+	_configure_stream();
 
 	/* Help informaiton */
 	_debug_help();
@@ -466,40 +583,28 @@ int main(void)
 
 	/* Driver loop */
 	while (1) {
+#ifdef CONFIG_TIMER_POLLING
+		timer_wheel_poll();
+#endif
 
-		/* Device is not configured */
-		if (usbd_get_state() < USBD_STATE_CONFIGURED) {
-
-			if (is_usb_connected) {
-				is_usb_connected = 0;
-				is_cdc_serial_on  = 0;
-			}
-
-		} else if (is_usb_connected == 0) {
-				is_usb_connected = 1;
-		}
-
-		/* Serial port ON/OFF */
-		if (cdcd_serial_driver_get_control_line_state()
-					& CDCControlLineState_DTR) {
+		/* Serial port ON/OFF: device configured and port opened */
+		if (usbd_get_state() >= USBD_STATE_CONFIGURED &&
+		    (cdcd_serial_driver_get_control_line_state()
+					& CDCControlLineState_DTR)) {
 			if (!is_cdc_serial_on) {
 				is_cdc_serial_on = 1;
-				}
-			if(usb_serial_read == 1) {
-				usb_serial_read = 0;
-				/* Start receiving data on the USB */
-				cdcd_serial_driver_read(usb_buffer, DATAPACKETSIZE,
-							_usb_data_received, &usb_serial_read);
-			}
-			if(usart_rx_flag == true) {
-				usart_rx_flag = false;
-				cdcd_serial_driver_write((void *)&char_recv, 1, 0, 0);
-				if(is_cdc_echo_on) {
-					_usart_dma_tx((uint8_t*)&char_recv, 1);
-				}
+				cdcd_stream_start();
 			}
 		} else if (is_cdc_serial_on) {
 			is_cdc_serial_on = 0;
+			cdcd_stream_stop();
+		}
+
+		if (is_cdc_serial_on) {
+			if (is_cdc_echo_on)
+				_echo_forward();
+			else
+				_bridge_forward();
 		}
 
 		if (console_is_rx_ready()) {
@@ -512,14 +617,16 @@ int main(void)
 				is_cdc_echo_on = !is_cdc_echo_on;
 
 			} else if (key == 't') {
-				/* 't': Test CDC writing  */
-				_send_text();
+				/* 't': Test CDC streaming */
+				_stream_test();
+
+			} else if (key == 's') {
+				_show_stats();
 
 			} else {
 				printf("Alive\n\r");
-				cdcd_serial_driver_write((char*)"Alive\n\r", 8,
-						NULL, NULL);
-				_usart_dma_tx((uint8_t*)"Alive\n\r", 8);
+				cdcd_stream_write("Alive\n\r", 7);
+				cdcd_stream_flush();
 				_debug_help();
 			}
 		}
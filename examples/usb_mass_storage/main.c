@@ -209,9 +209,21 @@
   #define RAMDISK_SIZE        (8*1024*1024)
 #endif
 
-/** Size of the MSD IO buffer in bytes (more the better). */
+/** Size of the MSD IO buffer in bytes (more the better). The buffer is used
+ * as two slots, so that the media access overlaps with the USB transfer. */
 #define MSD_BUFFER_SIZE (128 * BLOCK_SIZE)
 
+/** Simulated access time of the RAM disk in us, 0 for none. Useful to
+ * reproduce the timings of a slow media. */
+#ifndef RAMDISK_LATENCY_US
+#define RAMDISK_LATENCY_US  0
+#endif
+
+/** Simulated transfer time of the RAM disk in us per block */
+#ifndef RAMDISK_BLOCK_US
+#define RAMDISK_BLOCK_US    0
+#endif
+
 /*----------------------------------------------------------------------------
  *        Global variables
  *----------------------------------------------------------------------------*/
@@ -302,6 +314,21 @@ CACHE_ALIGNED_DDR static uint32_t sd_dma_table1[DMADL_CNT_MAX * SDMMC_DMADL_SIZE
 /** Total data write to disk */
 static uint32_t msd_write_total = 0;
 
+/** Transfer statistics of the current period, indexed by direction */
+static struct {
+	uint32_t bytes;
+	uint32_t null_count;
+	uint32_t full_count;
+} msd_stats[2];
+
+#if RAMDISK_LATENCY_US || RAMDISK_BLOCK_US
+/** Simulated RAM disk access time */
+static struct _ramdisk_latency ramdisk_latency = {
+	.access_us = RAMDISK_LATENCY_US,
+	.block_us = RAMDISK_BLOCK_US,
+};
+#endif
+
 /** Delay TO event */
 static uint8_t msd_refresh = 0;
 
@@ -347,6 +374,31 @@ static void msd_callbacks_data(uint8_t flow_direction, uint32_t data_length,
 	if (!flow_direction) {
 		msd_write_total += data_length;
 	}
+
+	msd_stats[flow_direction].bytes += data_length;
+	msd_stats[flow_direction].null_count += fifo_null_count;
+	msd_stats[flow_direction].full_count += fifo_full_count;
+}
+
+/**
+ * Display the throughput and the FIFO stalls of the last period.
+ * \param period Length of the period in ms
+ */
+static void msd_show_stats(uint32_t period)
+{
+	static const char * const dir[2] = { "Write", "Read" };
+	uint8_t i;
+
+	for (i = 0; i < 2; i++) {
+		if (msd_stats[i].bytes == 0)
+			continue;
+		printf("%s: %u.%02u MB/s, null %u, full %u\r\n", dir[i],
+			(unsigned)(msd_stats[i].bytes / 1000 / period),
+			(unsigned)(msd_stats[i].bytes / 10 / period % 100),
+			(unsigned)msd_stats[i].null_count,
+			(unsigned)msd_stats[i].full_count);
+	}
+	memset(msd_stats, 0, sizeof(msd_stats));
 }
 
 /*----------------------------------------------------------------------------
@@ -451,6 +503,13 @@ static void ramdisk_init(void)
 			RAMDISK_SIZE / BLOCK_SIZE,
 			BLOCK_SIZE);
 
+#if RAMDISK_LATENCY_US || RAMDISK_BLOCK_US
+	timer_wheel_init();
+	media_ramdisk_set_latency(&medias[DRV_RAMDISK], &ramdisk_latency);
+	trace_info("RamDisk latency %uus + %uus/block\n\r",
+			RAMDISK_LATENCY_US, RAMDISK_BLOCK_US);
+#endif
+
 	lun_init(&(luns[DRV_RAMDISK]),
 			&(medias[DRV_RAMDISK]),
 			ram_buffer, MSD_BUFFER_SIZE,
@@ -541,6 +600,8 @@ static void _MemoriesInitialize(void)
  */
 int main(void)
 {
+	uint64_t stats_tick, now;
+
 	console_example_info("USB Device Mass Storage Example");
 
 	/* Initialize all USB power (off) */
@@ -558,7 +619,18 @@ int main(void)
 	/* connect if needed */
 	usb_vbus_configure();
 
+	stats_tick = timer_get_tick();
 	while (1) {
+#if (RAMDISK_LATENCY_US || RAMDISK_BLOCK_US) && defined(CONFIG_TIMER_POLLING)
+		timer_wheel_poll();
+#endif
+		/* Display the throughput every second */
+		now = timer_get_tick();
+		if (timer_get_interval(stats_tick, now) >= 1000) {
+			msd_show_stats(timer_get_interval(stats_tick, now));
+			stats_tick = now;
+		}
+
 		/* Mass storage state machine */
 		if (usbd_get_state() >= USBD_STATE_CONFIGURED) {
 			msd_driver_state_machine();
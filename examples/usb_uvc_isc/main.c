@@ -261,9 +261,14 @@ void usbd_driver_callbacks_interface_setting_changed(uint8_t interface, uint8_t
 #ifdef FRAME_DEBUG_ENABLED
 static int _tc_counter_callback(void* arg, void* arg2)
 {
-	printf("ISC %d frames, UVC %d frames per second\r\n",_isc_frame_count, uvc_get_frame_count());
+	struct _uvc_stream_stats stats;
+
+	uvc_function_get_stats(&stats);
+	printf("ISC %d frames, UVC %u fps (%u dropped, %u repeated, %u underruns)\r\n",
+	       _isc_frame_count, (unsigned)stats.fps, (unsigned)stats.dropped,
+	       (unsigned)stats.repeated, (unsigned)stats.underruns);
 	_isc_frame_count = 0;
-	uvc_reset_frame_count();
+	uvc_function_reset_stats();
 	return 0;
 }
 
@@ -350,7 +355,7 @@ extern int main( void )
 				memset(stream_buffers, 0, sizeof(stream_buffers));
 				cache_clean_region(stream_buffers, sizeof(stream_buffers));
 				start_preview();
-				uvc_function_payload_sent(NULL, USBD_STATUS_SUCCESS, 0, 0);
+				uvc_function_start_stream();
 				printf("vidS\r\n");
 			}
 		}
@@ -300,7 +300,7 @@ extern int main( void )
 				memset(stream_buffers, 0, sizeof(stream_buffers));
 				cache_clean_region(stream_buffers, sizeof(stream_buffers));
 				start_preview();
-				uvc_function_payload_sent(NULL, USBD_STATUS_SUCCESS, 0, 0);
+				uvc_function_start_stream();
 				printf("vidS\r\n");
 			}
 		}
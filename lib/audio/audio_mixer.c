@@ -0,0 +1,246 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "errno.h"
+#include "intmath.h"
+#include "ring.h"
+#include "audio/audio_mixer.h"
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static inline int16_t _sat16(int32_t value)
+{
+	if (value > INT16_MAX)
+		return INT16_MAX;
+	if (value < INT16_MIN)
+		return INT16_MIN;
+	return (int16_t)value;
+}
+
+/**
+ * Resample up to \a frames frames from the ring of a stream.
+ * \return Number of frames produced, less than \a frames on underrun
+ */
+static uint32_t _stream_pull(struct _audio_mixer_stream* s, int16_t* out,
+		uint32_t frames, uint32_t channels)
+{
+	uint32_t produced = 0;
+
+	while (produced < frames) {
+		const void* data;
+		uint32_t avail, used;
+
+		avail = ring_read_acquire(&s->ring, &data);
+		used = avail;
+		produced += audio_src_process(&s->src, (const int16_t*)data, &used,
+				out + produced * channels, frames - produced);
+		ring_read_release(&s->ring, used);
+		if (avail == 0)
+			break;
+	}
+
+	return produced;
+}
+
+/**
+ * Drop the frames of a stream and restart it from silence.
+ */
+static void _stream_drop(struct _audio_mixer_stream* s)
+{
+	ring_read_release(&s->ring, ring_count(&s->ring));
+	audio_src_reset(&s->src);
+	s->playing = false;
+	s->flush = false;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+int audio_mixer_init(struct _audio_mixer* mixer, uint8_t channels,
+		uint32_t rate)
+{
+	if (channels == 0 || channels > AUDIO_SRC_MAX_CHANNELS || rate == 0)
+		return -EINVAL;
+
+	memset(mixer, 0, sizeof(*mixer));
+	mixer->channels = channels;
+	mixer->rate = rate;
+	return 0;
+}
+
+int audio_mixer_stream_open(struct _audio_mixer* mixer, uint8_t stream,
+		int16_t* buffer, uint32_t frames, uint32_t rate)
+{
+	struct _audio_mixer_stream* s;
+	int err;
+
+	if (stream >= AUDIO_MIXER_MAX_STREAMS)
+		return -EINVAL;
+	s = &mixer->streams[stream];
+
+	s->active = false;
+	err = ring_init(&s->ring, buffer, frames,
+			mixer->channels * sizeof(int16_t));
+	if (err < 0)
+		return err;
+	err = audio_src_init(&s->src, mixer->channels, rate, mixer->rate);
+	if (err < 0)
+		return err;
+
+	s->target = frames / 2;
+	s->gain = AUDIO_MIXER_GAIN_UNITY;
+	s->flush = false;
+	s->playing = false;
+	memset(&s->stats, 0, sizeof(s->stats));
+	s->active = true;
+	return 0;
+}
+
+void audio_mixer_stream_close(struct _audio_mixer* mixer, uint8_t stream)
+{
+	if (stream < AUDIO_MIXER_MAX_STREAMS)
+		mixer->streams[stream].active = false;
+}
+
+void audio_mixer_stream_flush(struct _audio_mixer* mixer, uint8_t stream)
+{
+	if (stream < AUDIO_MIXER_MAX_STREAMS)
+		mixer->streams[stream].flush = true;
+}
+
+void audio_mixer_stream_set_gain(struct _audio_mixer* mixer,
+		uint8_t stream, uint16_t gain)
+{
+	if (stream < AUDIO_MIXER_MAX_STREAMS)
+		mixer->streams[stream].gain = gain;
+}
+
+uint32_t audio_mixer_stream_write(struct _audio_mixer* mixer,
+		uint8_t stream, const int16_t* data, uint32_t frames)
+{
+	struct _audio_mixer_stream* s;
+	uint32_t count;
+
+	if (stream >= AUDIO_MIXER_MAX_STREAMS)
+		return 0;
+	s = &mixer->streams[stream];
+	if (!s->active)
+		return 0;
+
+	count = ring_push_n(&s->ring, data, frames);
+	s->stats.frames_in += count;
+	if (count < frames)
+		s->stats.overruns++;
+	return count;
+}
+
+uint32_t audio_mixer_stream_level(struct _audio_mixer* mixer, uint8_t stream)
+{
+	if (stream >= AUDIO_MIXER_MAX_STREAMS)
+		return 0;
+	return ring_count(&mixer->streams[stream].ring);
+}
+
+void audio_mixer_render(struct _audio_mixer* mixer, int16_t* out,
+		uint32_t frames)
+{
+	const uint32_t channels = mixer->channels;
+	uint32_t rendered[AUDIO_MIXER_MAX_STREAMS] = { 0 };
+	uint32_t i, n, done;
+	int st;
+
+	while (frames > 0) {
+		n = min_u32(frames, AUDIO_MIXER_BLOCK);
+		memset(mixer->acc, 0, n * channels * sizeof(mixer->acc[0]));
+
+		for (st = 0; st < AUDIO_MIXER_MAX_STREAMS; st++) {
+			struct _audio_mixer_stream* s = &mixer->streams[st];
+			int32_t gain = s->gain;
+
+			if (!s->active)
+				continue;
+			if (s->flush)
+				_stream_drop(s);
+
+			/* (re)start when the ring is half full */
+			if (!s->playing) {
+				if (ring_count(&s->ring) < s->target)
+					continue;
+				s->playing = true;
+			}
+
+			done = _stream_pull(s, mixer->block, n, channels);
+			for (i = 0; i < done * channels; i++)
+				mixer->acc[i] += mixer->block[i] * gain;
+			s->stats.frames_out += done;
+			rendered[st] += done;
+
+			if (done < n) {
+				s->stats.underruns++;
+				s->playing = false;
+			}
+		}
+
+		for (i = 0; i < n * channels; i++)
+			out[i] = _sat16((mixer->acc[i] + (1 << (AUDIO_MIXER_GAIN_SHIFT - 1)))
+					>> AUDIO_MIXER_GAIN_SHIFT);
+
+		out += n * channels;
+		frames -= n;
+	}
+
+	/* trim the ratios once per period, so that the fill levels are
+	 * always sampled at the same point of the period */
+	for (st = 0; st < AUDIO_MIXER_MAX_STREAMS; st++) {
+		struct _audio_mixer_stream* s = &mixer->streams[st];
+		int32_t error;
+
+		if (!s->active || !s->playing || rendered[st] == 0)
+			continue;
+		error = (int32_t)ring_count(&s->ring) - (int32_t)s->target;
+		s->stats.ppm = audio_src_feedback(&s->src, error, rendered[st]);
+	}
+}
+
+void audio_mixer_stream_get_stats(struct _audio_mixer* mixer,
+		uint8_t stream, struct _audio_mixer_stats* stats)
+{
+	if (stream < AUDIO_MIXER_MAX_STREAMS)
+		memcpy(stats, &mixer->streams[stream].stats, sizeof(*stats));
+}
@@ -0,0 +1,192 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * \section Purpose
+ * Audio mixer with per-stream sample-rate conversion.
+ *
+ * Each stream owns a ring buffer of 16-bit interleaved frames, filled by a
+ * producer (e.g. the USB isochronous endpoint callback) with
+ * audio_mixer_stream_write(). The consumer (e.g. the callback of the audio
+ * output DMA) calls audio_mixer_render() to produce the next period: every
+ * active stream is resampled to the output rate, scaled by its gain and
+ * summed with saturation. After each period the ratio of every converter
+ * is trimmed from the fill level of its ring, which absorbs the drift
+ * between the clock of the producers and the output clock.
+ *
+ * A stream starts playing when its ring is half full. On underrun the
+ * missing frames are replaced by silence and the stream waits again for
+ * its ring to be half full, so the output never stops.
+ *
+ * One producer per stream and one consumer may run in different contexts
+ * (interrupt handlers) without locking.
+ */
+
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ring.h"
+#include "audio/audio_src.h"
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Maximum number of streams */
+#define AUDIO_MIXER_MAX_STREAMS  4
+
+/** Frames processed at once by audio_mixer_render() */
+#define AUDIO_MIXER_BLOCK        64
+
+/** Gain is Q4.12: 0x1000 is unity */
+#define AUDIO_MIXER_GAIN_SHIFT   12
+#define AUDIO_MIXER_GAIN_UNITY   (1 << AUDIO_MIXER_GAIN_SHIFT)
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+struct _audio_mixer_stats {
+	uint32_t frames_in;     /**< Frames written by the producer */
+	uint32_t frames_out;    /**< Frames rendered */
+	uint32_t overruns;      /**< Writes truncated because the ring was full */
+	uint32_t underruns;     /**< Periods completed with silence */
+	int32_t ppm;            /**< Current correction of the ratio */
+};
+
+struct _audio_mixer_stream {
+	struct _ring ring;
+	struct _audio_src src;
+	uint32_t target;        /**< Fill level followed by the converter */
+	volatile uint16_t gain;
+	volatile bool active;
+	volatile bool flush;    /**< Drop request, handled by the consumer */
+	bool playing;
+	struct _audio_mixer_stats stats;
+};
+
+struct _audio_mixer {
+	uint8_t channels;
+	uint32_t rate;
+	struct _audio_mixer_stream streams[AUDIO_MIXER_MAX_STREAMS];
+
+	/* render scratch */
+	int16_t block[AUDIO_MIXER_BLOCK * AUDIO_SRC_MAX_CHANNELS];
+	int32_t acc[AUDIO_MIXER_BLOCK * AUDIO_SRC_MAX_CHANNELS];
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize a mixer, all the streams closed.
+ * \param mixer     Mixer
+ * \param channels  Number of interleaved channels of the output and of
+ *                  every stream (1..AUDIO_SRC_MAX_CHANNELS)
+ * \param rate      Output sample rate in Hz
+ * \return 0 on success, -EINVAL if a parameter is out of range
+ */
+extern int audio_mixer_init(struct _audio_mixer* mixer, uint8_t channels,
+		uint32_t rate);
+
+/**
+ * \brief Open a stream.
+ * \param mixer   Mixer
+ * \param stream  Stream index (0..AUDIO_MIXER_MAX_STREAMS-1)
+ * \param buffer  Ring storage, frames * channels 16-bit samples
+ * \param frames  Capacity of the ring in frames (power of two)
+ * \param rate    Sample rate of the stream in Hz, at most 1.1 times the
+ *                output rate (see AUDIO_SRC_MAX_STEP)
+ * \return 0 on success, -EINVAL if a parameter is out of range
+ */
+extern int audio_mixer_stream_open(struct _audio_mixer* mixer, uint8_t stream,
+		int16_t* buffer, uint32_t frames, uint32_t rate);
+
+/**
+ * \brief Close a stream. The stream is not rendered anymore.
+ */
+extern void audio_mixer_stream_close(struct _audio_mixer* mixer, uint8_t stream);
+
+/**
+ * \brief Drop the content of a stream, e.g. when the producer restarts.
+ *
+ * The frames are dropped by the next audio_mixer_render(), so this function
+ * can be called from the producer context.
+ */
+extern void audio_mixer_stream_flush(struct _audio_mixer* mixer, uint8_t stream);
+
+/**
+ * \brief Set the gain of a stream.
+ * \param gain  Q4.12 gain, AUDIO_MIXER_GAIN_UNITY for 0 dB
+ */
+extern void audio_mixer_stream_set_gain(struct _audio_mixer* mixer,
+		uint8_t stream, uint16_t gain);
+
+/**
+ * \brief Queue frames on a stream (producer side).
+ * \param data    16-bit interleaved frames
+ * \param frames  Number of frames
+ * \return Number of frames queued, less than \a frames on overrun
+ */
+extern uint32_t audio_mixer_stream_write(struct _audio_mixer* mixer,
+		uint8_t stream, const int16_t* data, uint32_t frames);
+
+/**
+ * \brief Get the number of frames queued on a stream.
+ */
+extern uint32_t audio_mixer_stream_level(struct _audio_mixer* mixer,
+		uint8_t stream);
+
+/**
+ * \brief Render frames from all the active streams (consumer side).
+ *
+ * Always fills \a frames frames, with silence if no stream is playing.
+ * \param out     Output frames
+ * \param frames  Number of frames
+ */
+extern void audio_mixer_render(struct _audio_mixer* mixer, int16_t* out,
+		uint32_t frames);
+
+/**
+ * \brief Get the statistics of a stream.
+ */
+extern void audio_mixer_stream_get_stats(struct _audio_mixer* mixer,
+		uint8_t stream, struct _audio_mixer_stats* stats);
+
+#endif /* AUDIO_MIXER_H */
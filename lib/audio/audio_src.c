@@ -0,0 +1,333 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "errno.h"
+#include "audio/audio_src.h"
+
+/*----------------------------------------------------------------------------
+ *        Local constants
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Polyphase filter, Q15, one row per phase plus one row for the next input
+ * frame (interpolation of the last phase). Row p holds the taps of phase p
+ * from the oldest to the newest frame of the window.
+ *
+ * Kaiser-windowed sinc (beta 8), 2048 taps prototype, cutoff 0.86 times the
+ * input Nyquist frequency, each phase normalized to unity DC gain.
+ */
+static const int16_t _src_filter[AUDIO_SRC_PHASES + 1][AUDIO_SRC_TAPS] = {
+	{ 2, 2, -20, 61, -124, 195, -233, 177, 44, -486, 1161, -2020, 2949, -3789, 4377, 28181, 4377, -3789, 2949, -2020, 1161, -486, 44, 177, -233, 195, -124, 61, -20, 2, 2, -1 },
+	{ 2, 3, -21, 62, -124, 191, -222, 157, 73, -520, 1189, -2023, 2896, -3622, 3917, 28172, 4843, -3953, 2998, -2014, 1131, -451, 15, 197, -244, 199, -125, 60, -19, 1, 2, -1 },
+	{ 1, 4, -22, 63, -123, 186, -211, 137, 102, -552, 1215, -2022, 2837, -3451, 3465, 28147, 5316, -4112, 3043, -2004, 1098, -414, -15, 217, -254, 203, -125, 58, -18, 1, 3, -1 },
+	{ 1, 4, -23, 63, -122, 182, -200, 117, 130, -584, 1238, -2018, 2775, -3277, 3021, 28104, 5795, -4266, 3082, -1990, 1063, -377, -46, 236, -264, 206, -124, 57, -17, 0, 3, -1 },
+	{ 1, 5, -24, 64, -121, 176, -188, 97, 158, -614, 1258, -2009, 2708, -3100, 2585, 28045, 6280, -4416, 3116, -1972, 1025, -338, -76, 256, -274, 209, -124, 55, -15, -1, 3, -1 },
+	{ 1, 5, -25, 64, -120, 171, -176, 77, 185, -642, 1276, -1998, 2637, -2920, 2157, 27969, 6771, -4560, 3145, -1951, 985, -298, -107, 275, -283, 212, -123, 54, -14, -2, 4, -1 },
+	{ 0, 6, -26, 65, -118, 166, -164, 57, 211, -669, 1292, -1983, 2563, -2738, 1738, 27877, 7266, -4698, 3169, -1925, 943, -257, -138, 294, -292, 214, -122, 52, -12, -2, 4, -2 },
+	{ 0, 7, -27, 65, -117, 160, -152, 38, 237, -695, 1305, -1964, 2485, -2555, 1328, 27767, 7766, -4831, 3187, -1896, 899, -216, -169, 313, -301, 216, -121, 50, -11, -3, 4, -2 },
+	{ 0, 7, -27, 65, -115, 154, -140, 18, 262, -719, 1316, -1942, 2403, -2369, 928, 27642, 8269, -4957, 3200, -1863, 853, -173, -200, 331, -309, 217, -120, 48, -9, -4, 5, -2 },
+	{ 0, 8, -28, 65, -113, 148, -128, -1, 286, -741, 1324, -1917, 2318, -2183, 537, 27499, 8777, -5076, 3207, -1827, 804, -130, -231, 349, -316, 219, -118, 46, -8, -5, 5, -2 },
+	{ -1, 8, -28, 65, -110, 141, -115, -20, 309, -762, 1329, -1889, 2230, -1996, 156, 27341, 9287, -5189, 3209, -1786, 754, -86, -262, 366, -323, 219, -116, 43, -6, -6, 5, -2 },
+	{ -1, 8, -29, 65, -108, 135, -103, -39, 332, -781, 1333, -1858, 2139, -1808, -214, 27167, 9800, -5294, 3204, -1742, 702, -41, -293, 383, -330, 220, -114, 41, -4, -7, 6, -2 },
+	{ -1, 9, -29, 64, -105, 128, -90, -58, 354, -799, 1333, -1823, 2046, -1620, -574, 26977, 10315, -5391, 3194, -1694, 648, 4, -323, 400, -336, 220, -111, 38, -3, -8, 6, -2 },
+	{ -1, 9, -29, 64, -103, 121, -78, -76, 374, -815, 1332, -1786, 1950, -1432, -923, 26771, 10832, -5480, 3178, -1643, 592, 50, -354, 416, -341, 219, -109, 36, -1, -9, 6, -2 },
+	{ -1, 10, -30, 63, -100, 114, -65, -94, 394, -829, 1328, -1746, 1852, -1245, -1261, 26550, 11350, -5562, 3155, -1588, 534, 96, -384, 431, -346, 218, -106, 33, 1, -9, 7, -2 },
+	{ -2, 10, -30, 62, -97, 107, -53, -111, 413, -841, 1321, -1704, 1751, -1058, -1588, 26314, 11868, -5634, 3127, -1529, 475, 143, -414, 446, -351, 217, -103, 30, 3, -10, 7, -2 },
+	{ -2, 10, -30, 61, -94, 100, -41, -128, 431, -852, 1313, -1658, 1649, -873, -1904, 26062, 12387, -5698, 3093, -1467, 414, 189, -443, 460, -354, 215, -99, 27, 5, -11, 7, -2 },
+	{ -2, 10, -30, 61, -90, 93, -28, -145, 448, -862, 1302, -1611, 1545, -689, -2208, 25796, 12905, -5753, 3052, -1401, 352, 236, -472, 474, -358, 213, -96, 24, 7, -12, 8, -2 },
+	{ -2, 11, -30, 60, -87, 86, -16, -161, 464, -869, 1288, -1561, 1440, -506, -2500, 25516, 13422, -5798, 3006, -1333, 288, 283, -500, 487, -360, 211, -92, 21, 9, -13, 8, -3 },
+	{ -2, 11, -30, 58, -83, 78, -4, -176, 479, -875, 1273, -1508, 1333, -326, -2781, 25222, 13938, -5833, 2953, -1260, 223, 330, -528, 499, -362, 208, -88, 17, 11, -14, 8, -3 },
+	{ -2, 11, -30, 57, -80, 71, 8, -191, 493, -880, 1256, -1454, 1225, -147, -3050, 24914, 14452, -5859, 2894, -1185, 157, 377, -555, 510, -363, 204, -83, 14, 13, -15, 9, -3 },
+	{ -2, 11, -30, 56, -76, 64, 19, -206, 506, -882, 1236, -1397, 1117, 28, -3306, 24593, 14964, -5875, 2829, -1107, 90, 424, -582, 521, -364, 201, -79, 10, 15, -16, 9, -3 },
+	{ -3, 11, -30, 55, -72, 56, 31, -220, 518, -884, 1214, -1339, 1007, 201, -3551, 24259, 15472, -5880, 2758, -1026, 22, 471, -607, 530, -364, 196, -74, 7, 17, -17, 9, -3 },
+	{ -3, 11, -29, 53, -69, 49, 42, -233, 529, -883, 1191, -1279, 898, 371, -3783, 23912, 15977, -5874, 2681, -942, -46, 517, -632, 539, -363, 192, -69, 3, 19, -18, 9, -3 },
+	{ -3, 11, -29, 52, -65, 41, 53, -246, 538, -881, 1165, -1217, 788, 538, -4003, 23552, 16479, -5858, 2598, -855, -116, 563, -656, 547, -362, 187, -64, -1, 21, -19, 10, -3 },
+	{ -3, 12, -29, 50, -61, 34, 64, -258, 547, -877, 1138, -1154, 678, 701, -4210, 23181, 16975, -5830, 2509, -765, -186, 608, -679, 554, -360, 181, -58, -5, 23, -19, 10, -3 },
+	{ -3, 12, -28, 48, -57, 27, 74, -270, 554, -872, 1109, -1090, 568, 861, -4405, 22798, 17467, -5792, 2414, -673, -256, 653, -701, 560, -357, 175, -53, -8, 25, -20, 10, -3 },
+	{ -3, 12, -28, 47, -53, 20, 85, -281, 561, -865, 1079, -1024, 458, 1016, -4588, 22405, 17953, -5742, 2314, -579, -327, 696, -722, 565, -354, 169, -47, -12, 27, -21, 10, -3 },
+	{ -3, 12, -27, 45, -49, 12, 95, -291, 566, -857, 1046, -957, 349, 1168, -4758, 22000, 18433, -5680, 2207, -483, -398, 740, -742, 570, -349, 162, -41, -16, 29, -22, 11, -3 },
+	{ -3, 11, -27, 43, -45, 5, 104, -301, 570, -847, 1012, -889, 241, 1315, -4916, 21585, 18907, -5607, 2096, -384, -469, 782, -761, 573, -345, 155, -35, -20, 31, -23, 11, -3 },
+	{ -3, 11, -26, 41, -41, -2, 114, -310, 573, -836, 977, -820, 133, 1457, -5062, 21161, 19374, -5522, 1978, -284, -540, 823, -778, 575, -339, 147, -28, -24, 33, -23, 11, -3 },
+	{ -3, 11, -25, 39, -37, -8, 123, -318, 575, -824, 941, -751, 27, 1595, -5195, 20727, 19833, -5425, 1856, -182, -610, 863, -795, 576, -333, 139, -22, -28, 35, -24, 11, -3 },
+	{ -3, 11, -25, 37, -32, -15, 131, -326, 576, -810, 903, -681, -78, 1728, -5316, 20284, 20284, -5316, 1728, -78, -681, 903, -810, 576, -326, 131, -15, -32, 37, -25, 11, -3 },
+	{ -3, 11, -24, 35, -28, -22, 139, -333, 576, -795, 863, -610, -182, 1856, -5425, 19833, 20727, -5195, 1595, 27, -751, 941, -824, 575, -318, 123, -8, -37, 39, -25, 11, -3 },
+	{ -3, 11, -23, 33, -24, -28, 147, -339, 575, -778, 823, -540, -284, 1978, -5522, 19374, 21161, -5062, 1457, 133, -820, 977, -836, 573, -310, 114, -2, -41, 41, -26, 11, -3 },
+	{ -3, 11, -23, 31, -20, -35, 155, -345, 573, -761, 782, -469, -384, 2096, -5607, 18907, 21585, -4916, 1315, 241, -889, 1012, -847, 570, -301, 104, 5, -45, 43, -27, 11, -3 },
+	{ -3, 11, -22, 29, -16, -41, 162, -349, 570, -742, 740, -398, -483, 2207, -5680, 18433, 22000, -4758, 1168, 349, -957, 1046, -857, 566, -291, 95, 12, -49, 45, -27, 12, -3 },
+	{ -3, 10, -21, 27, -12, -47, 169, -354, 565, -722, 696, -327, -579, 2314, -5742, 17953, 22405, -4588, 1016, 458, -1024, 1079, -865, 561, -281, 85, 20, -53, 47, -28, 12, -3 },
+	{ -3, 10, -20, 25, -8, -53, 175, -357, 560, -701, 653, -256, -673, 2414, -5792, 17467, 22798, -4405, 861, 568, -1090, 1109, -872, 554, -270, 74, 27, -57, 48, -28, 12, -3 },
+	{ -3, 10, -19, 23, -5, -58, 181, -360, 554, -679, 608, -186, -765, 2509, -5830, 16975, 23181, -4210, 701, 678, -1154, 1138, -877, 547, -258, 64, 34, -61, 50, -29, 12, -3 },
+	{ -3, 10, -19, 21, -1, -64, 187, -362, 547, -656, 563, -116, -855, 2598, -5858, 16479, 23552, -4003, 538, 788, -1217, 1165, -881, 538, -246, 53, 41, -65, 52, -29, 11, -3 },
+	{ -3, 9, -18, 19, 3, -69, 192, -363, 539, -632, 517, -46, -942, 2681, -5874, 15977, 23912, -3783, 371, 898, -1279, 1191, -883, 529, -233, 42, 49, -69, 53, -29, 11, -3 },
+	{ -3, 9, -17, 17, 7, -74, 196, -364, 530, -607, 471, 22, -1026, 2758, -5880, 15472, 24259, -3551, 201, 1007, -1339, 1214, -884, 518, -220, 31, 56, -72, 55, -30, 11, -3 },
+	{ -3, 9, -16, 15, 10, -79, 201, -364, 521, -582, 424, 90, -1107, 2829, -5875, 14964, 24593, -3306, 28, 1117, -1397, 1236, -882, 506, -206, 19, 64, -76, 56, -30, 11, -2 },
+	{ -3, 9, -15, 13, 14, -83, 204, -363, 510, -555, 377, 157, -1185, 2894, -5859, 14452, 24914, -3050, -147, 1225, -1454, 1256, -880, 493, -191, 8, 71, -80, 57, -30, 11, -2 },
+	{ -3, 8, -14, 11, 17, -88, 208, -362, 499, -528, 330, 223, -1260, 2953, -5833, 13938, 25222, -2781, -326, 1333, -1508, 1273, -875, 479, -176, -4, 78, -83, 58, -30, 11, -2 },
+	{ -3, 8, -13, 9, 21, -92, 211, -360, 487, -500, 283, 288, -1333, 3006, -5798, 13422, 25516, -2500, -506, 1440, -1561, 1288, -869, 464, -161, -16, 86, -87, 60, -30, 11, -2 },
+	{ -2, 8, -12, 7, 24, -96, 213, -358, 474, -472, 236, 352, -1401, 3052, -5753, 12905, 25796, -2208, -689, 1545, -1611, 1302, -862, 448, -145, -28, 93, -90, 61, -30, 10, -2 },
+	{ -2, 7, -11, 5, 27, -99, 215, -354, 460, -443, 189, 414, -1467, 3093, -5698, 12387, 26062, -1904, -873, 1649, -1658, 1313, -852, 431, -128, -41, 100, -94, 61, -30, 10, -2 },
+	{ -2, 7, -10, 3, 30, -103, 217, -351, 446, -414, 143, 475, -1529, 3127, -5634, 11868, 26314, -1588, -1058, 1751, -1704, 1321, -841, 413, -111, -53, 107, -97, 62, -30, 10, -2 },
+	{ -2, 7, -9, 1, 33, -106, 218, -346, 431, -384, 96, 534, -1588, 3155, -5562, 11350, 26550, -1261, -1245, 1852, -1746, 1328, -829, 394, -94, -65, 114, -100, 63, -30, 10, -1 },
+	{ -2, 6, -9, -1, 36, -109, 219, -341, 416, -354, 50, 592, -1643, 3178, -5480, 10832, 26771, -923, -1432, 1950, -1786, 1332, -815, 374, -76, -78, 121, -103, 64, -29, 9, -1 },
+	{ -2, 6, -8, -3, 38, -111, 220, -336, 400, -323, 4, 648, -1694, 3194, -5391, 10315, 26977, -574, -1620, 2046, -1823, 1333, -799, 354, -58, -90, 128, -105, 64, -29, 9, -1 },
+	{ -2, 6, -7, -4, 41, -114, 220, -330, 383, -293, -41, 702, -1742, 3204, -5294, 9800, 27167, -214, -1808, 2139, -1858, 1333, -781, 332, -39, -103, 135, -108, 65, -29, 8, -1 },
+	{ -2, 5, -6, -6, 43, -116, 219, -323, 366, -262, -86, 754, -1786, 3209, -5189, 9287, 27341, 156, -1996, 2230, -1889, 1329, -762, 309, -20, -115, 141, -110, 65, -28, 8, -1 },
+	{ -2, 5, -5, -8, 46, -118, 219, -316, 349, -231, -130, 804, -1827, 3207, -5076, 8777, 27499, 537, -2183, 2318, -1917, 1324, -741, 286, -1, -128, 148, -113, 65, -28, 8, 0 },
+	{ -2, 5, -4, -9, 48, -120, 217, -309, 331, -200, -173, 853, -1863, 3200, -4957, 8269, 27642, 928, -2369, 2403, -1942, 1316, -719, 262, 18, -140, 154, -115, 65, -27, 7, 0 },
+	{ -2, 4, -3, -11, 50, -121, 216, -301, 313, -169, -216, 899, -1896, 3187, -4831, 7766, 27767, 1328, -2555, 2485, -1964, 1305, -695, 237, 38, -152, 160, -117, 65, -27, 7, 0 },
+	{ -2, 4, -2, -12, 52, -122, 214, -292, 294, -138, -257, 943, -1925, 3169, -4698, 7266, 27877, 1738, -2738, 2563, -1983, 1292, -669, 211, 57, -164, 166, -118, 65, -26, 6, 0 },
+	{ -1, 4, -2, -14, 54, -123, 212, -283, 275, -107, -298, 985, -1951, 3145, -4560, 6771, 27969, 2157, -2920, 2637, -1998, 1276, -642, 185, 77, -176, 171, -120, 64, -25, 5, 1 },
+	{ -1, 3, -1, -15, 55, -124, 209, -274, 256, -76, -338, 1025, -1972, 3116, -4416, 6280, 28045, 2585, -3100, 2708, -2009, 1258, -614, 158, 97, -188, 176, -121, 64, -24, 5, 1 },
+	{ -1, 3, 0, -17, 57, -124, 206, -264, 236, -46, -377, 1063, -1990, 3082, -4266, 5795, 28104, 3021, -3277, 2775, -2018, 1238, -584, 130, 117, -200, 182, -122, 63, -23, 4, 1 },
+	{ -1, 3, 1, -18, 58, -125, 203, -254, 217, -15, -414, 1098, -2004, 3043, -4112, 5316, 28147, 3465, -3451, 2837, -2022, 1215, -552, 102, 137, -211, 186, -123, 63, -22, 4, 1 },
+	{ -1, 2, 1, -19, 60, -125, 199, -244, 197, 15, -451, 1131, -2014, 2998, -3953, 4843, 28172, 3917, -3622, 2896, -2023, 1189, -520, 73, 157, -222, 191, -124, 62, -21, 3, 2 },
+	{ -1, 2, 2, -20, 61, -124, 195, -233, 177, 44, -486, 1161, -2020, 2949, -3789, 4377, 28181, 4377, -3789, 2949, -2020, 1161, -486, 44, 177, -233, 195, -124, 61, -20, 2, 2 },
+};
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static inline int16_t _sat16(int32_t value)
+{
+	if (value > INT16_MAX)
+		return INT16_MAX;
+	if (value < INT16_MIN)
+		return INT16_MIN;
+	return (int16_t)value;
+}
+
+/**
+ * Compute the output of phases \a p and \a p + 1 over a window of
+ * AUDIO_SRC_TAPS frames.
+ */
+static inline void _src_dot(const int16_t* x, const int16_t* h0,
+		const int16_t* h1, int32_t* acc0, int32_t* acc1)
+{
+	int32_t a0 = 0, a1 = 0;
+	int i;
+
+#if defined(__GNUC__) && defined(__ARM_FEATURE_SIMD32)
+	/* two 16-bit products per instruction, the window may be unaligned */
+	for (i = 0; i < AUDIO_SRC_TAPS; i += 2) {
+		uint32_t xx, c0, c1;
+		memcpy(&xx, &x[i], sizeof(xx));
+		memcpy(&c0, &h0[i], sizeof(c0));
+		memcpy(&c1, &h1[i], sizeof(c1));
+		asm("smlad %0, %1, %2, %0" : "+r"(a0) : "r"(xx), "r"(c0));
+		asm("smlad %0, %1, %2, %0" : "+r"(a1) : "r"(xx), "r"(c1));
+	}
+#else
+	for (i = 0; i < AUDIO_SRC_TAPS; i++) {
+		a0 += (int32_t)x[i] * h0[i];
+		a1 += (int32_t)x[i] * h1[i];
+	}
+#endif
+
+	*acc0 = a0;
+	*acc1 = a1;
+}
+
+static int _src_compute_step(uint32_t in_rate, uint32_t out_rate,
+		uint32_t* step)
+{
+	uint64_t value;
+
+	if (in_rate == 0 || out_rate == 0)
+		return -EINVAL;
+
+	/* accept 1/8 to 1.1 input frames per output frame: the cutoff of the
+	 * filter is fixed relative to the input rate, so stronger downsampling
+	 * would fold the top of the input band back into the output */
+	value = ((uint64_t)in_rate << AUDIO_SRC_FRAC_BITS) / out_rate;
+	if (value < (AUDIO_SRC_ONE >> 3) || value > AUDIO_SRC_MAX_STEP)
+		return -EINVAL;
+
+	*step = (uint32_t)value;
+	return 0;
+}
+
+static void _src_apply_correction(struct _audio_src* src)
+{
+	int64_t delta = ((int64_t)src->step_nominal * src->feedback.ppm) / 1000000;
+
+	src->step = (uint32_t)((int64_t)src->step_nominal + delta);
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+int audio_src_init(struct _audio_src* src, uint8_t channels,
+		uint32_t in_rate, uint32_t out_rate)
+{
+	int err;
+
+	if (channels == 0 || channels > AUDIO_SRC_MAX_CHANNELS)
+		return -EINVAL;
+
+	memset(src, 0, sizeof(*src));
+	src->channels = channels;
+	src->feedback.kp = AUDIO_SRC_DEFAULT_KP;
+	src->feedback.ki = AUDIO_SRC_DEFAULT_KI;
+	src->feedback.max_ppm = AUDIO_SRC_DEFAULT_MAX_PPM;
+
+	err = audio_src_set_rates(src, in_rate, out_rate);
+	if (err < 0)
+		return err;
+
+	audio_src_reset(src);
+	return 0;
+}
+
+void audio_src_reset(struct _audio_src* src)
+{
+	memset(src->history, 0, sizeof(src->history));
+	src->index = 0;
+	src->pos = 0;
+	src->feedback.error = 0;
+	src->feedback.integral = 0;
+	src->feedback.ppm = 0;
+	src->step = src->step_nominal;
+}
+
+int audio_src_set_rates(struct _audio_src* src,
+		uint32_t in_rate, uint32_t out_rate)
+{
+	uint32_t step;
+	int err;
+
+	err = _src_compute_step(in_rate, out_rate, &step);
+	if (err < 0)
+		return err;
+
+	src->out_rate = out_rate;
+	src->step_nominal = step;
+	_src_apply_correction(src);
+	return 0;
+}
+
+uint32_t audio_src_process(struct _audio_src* src,
+		const int16_t* in, uint32_t* in_frames,
+		int16_t* out, uint32_t out_frames)
+{
+	const uint32_t channels = src->channels;
+	const uint32_t in_count = *in_frames;
+	uint32_t consumed = 0, produced = 0;
+	uint32_t pos = src->pos;
+	uint32_t index = src->index;
+	uint32_t c;
+
+	while (produced < out_frames) {
+		const int16_t *h0, *h1;
+		uint32_t phase, weight;
+
+		/* shift the input frames up to the current position in the
+		 * delay lines */
+		while (pos >= AUDIO_SRC_ONE) {
+			if (consumed == in_count)
+				goto done;
+			for (c = 0; c < channels; c++) {
+				int16_t sample = in[consumed * channels + c];
+				src->history[c][index] = sample;
+				src->history[c][index + AUDIO_SRC_TAPS] = sample;
+			}
+			index = (index + 1) & (AUDIO_SRC_TAPS - 1);
+			consumed++;
+			pos -= AUDIO_SRC_ONE;
+		}
+
+		phase = pos >> (AUDIO_SRC_FRAC_BITS - AUDIO_SRC_PHASE_BITS);
+		weight = (pos >> (AUDIO_SRC_FRAC_BITS - AUDIO_SRC_PHASE_BITS - 15)) & 0x7fff;
+		h0 = _src_filter[phase];
+		h1 = _src_filter[phase + 1];
+
+		for (c = 0; c < channels; c++) {
+			int32_t acc0, acc1;
+			int64_t value;
+
+			/* the oldest frame of the window is at index */
+			_src_dot(&src->history[c][index], h0, h1, &acc0, &acc1);
+			value = acc0 + ((((int64_t)acc1 - acc0) * weight) >> 15);
+			out[produced * channels + c] = _sat16((int32_t)((value + (1 << 14)) >> 15));
+		}
+		produced++;
+		pos += src->step;
+	}
+
+done:
+	src->pos = pos;
+	src->index = index;
+	*in_frames = consumed;
+	return produced;
+}
+
+void audio_src_set_feedback(struct _audio_src* src,
+		int32_t kp, int32_t ki, int32_t max_ppm)
+{
+	src->feedback.kp = kp;
+	src->feedback.ki = ki;
+	src->feedback.max_ppm = max_ppm;
+}
+
+int32_t audio_src_feedback(struct _audio_src* src, int32_t error,
+		uint32_t frames)
+{
+	const int32_t max = src->feedback.max_ppm << 8;
+	int32_t integral, ppm;
+
+	/* low-pass the error (Q8) to smooth the packet granularity of the
+	 * producer */
+	src->feedback.error += ((error << 8) - src->feedback.error) >> 5;
+
+	integral = src->feedback.integral + (int32_t)(((int64_t)src->feedback.ki *
+			src->feedback.error * frames) / src->out_rate);
+	if (integral > max)
+		integral = max;
+	else if (integral < -max)
+		integral = -max;
+	src->feedback.integral = integral;
+
+	ppm = (src->feedback.kp * src->feedback.error + integral) >> 8;
+	if (ppm > src->feedback.max_ppm)
+		ppm = src->feedback.max_ppm;
+	else if (ppm < -src->feedback.max_ppm)
+		ppm = -src->feedback.max_ppm;
+	src->feedback.ppm = ppm;
+
+	_src_apply_correction(src);
+	return ppm;
+}
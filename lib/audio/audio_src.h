@@ -0,0 +1,184 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * \section Purpose
+ * Asynchronous sample-rate converter.
+ *
+ * 16-bit interleaved frames are resampled by a polyphase FIR filter
+ * (AUDIO_SRC_TAPS taps, AUDIO_SRC_PHASES phases, linear interpolation
+ * between adjacent phases). The conversion ratio is kept in Q8.24 fixed
+ * point and can be trimmed while running: audio_src_feedback() implements
+ * a PI controller that follows the fill level of the buffer feeding the
+ * converter, so that a producer and a consumer running from different
+ * clocks (e.g. USB host and SSC/CLASSD) never under- or overrun.
+ *
+ * The filter is designed for ratios close to or above 1 (same rate or
+ * upsampling); its cutoff is 0.86 times the input Nyquist frequency, so
+ * downsampling is limited to AUDIO_SRC_MAX_STEP (e.g. 48 kHz to 44.1 kHz).
+ *
+ * The module has no hardware dependency and can be built for the host.
+ * On cores with the DSP extension (__ARM_FEATURE_SIMD32) the filter uses
+ * dual 16-bit multiply-accumulate instructions.
+ */
+
+#ifndef AUDIO_SRC_H
+#define AUDIO_SRC_H
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Maximum number of interleaved channels */
+#define AUDIO_SRC_MAX_CHANNELS  2
+
+/** Number of filter taps per phase */
+#define AUDIO_SRC_TAPS          32
+
+/** Number of filter phases (log2) */
+#define AUDIO_SRC_PHASE_BITS    6
+#define AUDIO_SRC_PHASES        (1 << AUDIO_SRC_PHASE_BITS)
+
+/** Fractional bits of the conversion ratio and position */
+#define AUDIO_SRC_FRAC_BITS     24
+#define AUDIO_SRC_ONE           (1u << AUDIO_SRC_FRAC_BITS)
+
+/** Largest nominal ratio (input frames per output frame), 1.1 */
+#define AUDIO_SRC_MAX_STEP      (AUDIO_SRC_ONE + AUDIO_SRC_ONE / 10)
+
+/** Group delay of the filter in input frames */
+#define AUDIO_SRC_DELAY         (AUDIO_SRC_TAPS / 2)
+
+/** Default feedback gains and correction range, in ppm (critically damped
+ *  for a 48 kHz input, settles in a few seconds) */
+#define AUDIO_SRC_DEFAULT_KP        40
+#define AUDIO_SRC_DEFAULT_KI        40
+#define AUDIO_SRC_DEFAULT_MAX_PPM   1000
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+struct _audio_src {
+	uint8_t channels;
+	uint32_t out_rate;
+
+	uint32_t step_nominal;  /**< Input frames per output frame (Q8.24) */
+	uint32_t step;          /**< Trimmed ratio (Q8.24) */
+	uint32_t pos;           /**< Position after the newest input (Q8.24) */
+
+	/** Delay lines, written twice so that a window of AUDIO_SRC_TAPS
+	 *  frames is always contiguous */
+	uint32_t index;
+	int16_t history[AUDIO_SRC_MAX_CHANNELS][2 * AUDIO_SRC_TAPS];
+
+	struct {
+		int32_t kp;         /**< ppm per frame of error */
+		int32_t ki;         /**< ppm per frame of error per second */
+		int32_t max_ppm;    /**< Correction limit */
+		int32_t error;      /**< Filtered error (frames, Q8) */
+		int32_t integral;   /**< Integral term (ppm, Q8) */
+		int32_t ppm;        /**< Current correction */
+	} feedback;
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize a sample-rate converter.
+ * \param src       Converter
+ * \param channels  Number of interleaved channels (1..AUDIO_SRC_MAX_CHANNELS)
+ * \param in_rate   Input sample rate in Hz
+ * \param out_rate  Output sample rate in Hz
+ * \return 0 on success, -EINVAL if a parameter is out of range
+ */
+extern int audio_src_init(struct _audio_src* src, uint8_t channels,
+		uint32_t in_rate, uint32_t out_rate);
+
+/**
+ * \brief Clear the filter history and the feedback state.
+ */
+extern void audio_src_reset(struct _audio_src* src);
+
+/**
+ * \brief Change the nominal conversion ratio, keeping the filter history.
+ * \return 0 on success, -EINVAL if the ratio is out of range
+ */
+extern int audio_src_set_rates(struct _audio_src* src,
+		uint32_t in_rate, uint32_t out_rate);
+
+/**
+ * \brief Convert samples.
+ *
+ * Consumes input frames and produces output frames until either the input
+ * is exhausted or the output is full.
+ * \param src       Converter
+ * \param in        Input frames
+ * \param in_frames In: number of input frames, out: number consumed
+ * \param out       Output frames
+ * \param out_frames Room in the output buffer, in frames
+ * \return Number of output frames produced
+ */
+extern uint32_t audio_src_process(struct _audio_src* src,
+		const int16_t* in, uint32_t* in_frames,
+		int16_t* out, uint32_t out_frames);
+
+/**
+ * \brief Set the gains of the feedback controller.
+ * \param kp       Proportional gain in ppm per frame of error
+ * \param ki       Integral gain in ppm per frame of error per second
+ * \param max_ppm  Maximum correction of the ratio
+ */
+extern void audio_src_set_feedback(struct _audio_src* src,
+		int32_t kp, int32_t ki, int32_t max_ppm);
+
+/**
+ * \brief Trim the conversion ratio from the fill level of the input buffer.
+ *
+ * To be called once per processed block with the difference between the
+ * fill level of the buffer feeding the converter and its target. A
+ * positive error (input accumulating) speeds up the consumption of input.
+ * \param error   Fill level minus target, in input frames
+ * \param frames  Output frames produced since the previous call
+ * \return Current correction in ppm
+ */
+extern int32_t audio_src_feedback(struct _audio_src* src, int32_t error,
+		uint32_t frames);
+
+#endif /* AUDIO_SRC_H */
@@ -0,0 +1,1091 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "chip.h"
+#include "compiler.h"
+#include "errno.h"
+#include "intmath.h"
+#include "mm/cache.h"
+#include "gfx/gfx.h"
+
+/*----------------------------------------------------------------------------
+ *        Local types
+ *----------------------------------------------------------------------------*/
+
+/** Entry of the glyph cache */
+struct _gfx_glyph {
+	const struct _gfx_font* font;
+	uint8_t c;
+	uint32_t rows[GFX_GLYPH_MAX_HEIGHT];
+};
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+static struct _gfx_glyph _glyph_cache[GFX_GLYPH_CACHE_SIZE];
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static inline int32_t _min(int32_t a, int32_t b)
+{
+	return a < b ? a : b;
+}
+
+static inline int32_t _max(int32_t a, int32_t b)
+{
+	return a > b ? a : b;
+}
+
+static inline uint8_t* _gfx_addr(const struct _gfx_surface* surface,
+		int32_t x, int32_t y)
+{
+	return surface->buffer + y * surface->stride + x * (surface->bpp >> 3);
+}
+
+static inline uint32_t _gfx_load(const uint8_t* p, uint8_t bpp)
+{
+	switch (bpp) {
+	case 16:
+		return *(const uint16_t*)p;
+	case 24:
+		return p[0] | (p[1] << 8) | (p[2] << 16);
+	default:
+		return *(const uint32_t*)p;
+	}
+}
+
+static inline void _gfx_store(uint8_t* p, uint8_t bpp, uint32_t pixel)
+{
+	switch (bpp) {
+	case 16:
+		*(uint16_t*)p = (uint16_t)pixel;
+		break;
+	case 24:
+		p[0] = (uint8_t)pixel;
+		p[1] = (uint8_t)(pixel >> 8);
+		p[2] = (uint8_t)(pixel >> 16);
+		break;
+	default:
+		*(uint32_t*)p = pixel;
+		break;
+	}
+}
+
+/**
+ * Store a pixel if it lies within the surface.
+ */
+static inline void _gfx_put(struct _gfx_surface* surface, int32_t x, int32_t y,
+		uint32_t pixel)
+{
+	if (x < 0 || y < 0 || x >= surface->width || y >= surface->height)
+		return;
+	_gfx_store(_gfx_addr(surface, x, y), surface->bpp, pixel);
+}
+
+/**
+ * Clip a rectangle to the surface.
+ * \return false if nothing is left
+ */
+static bool _gfx_clip(const struct _gfx_surface* surface, int32_t* x,
+		int32_t* y, int32_t* w, int32_t* h)
+{
+	if (!surface->buffer)
+		return false;
+	if (*x < 0) {
+		*w += *x;
+		*x = 0;
+	}
+	if (*y < 0) {
+		*h += *y;
+		*y = 0;
+	}
+	if (*x + *w > surface->width)
+		*w = surface->width - *x;
+	if (*y + *h > surface->height)
+		*h = surface->height - *y;
+	return *w > 0 && *h > 0;
+}
+
+static inline uint32_t _gfx_area(const struct _gfx_rect* r)
+{
+	return r->w * r->h;
+}
+
+static bool _gfx_overlap(const struct _gfx_rect* r, int32_t x, int32_t y,
+		int32_t w, int32_t h)
+{
+	return x < r->x + r->w && r->x < x + w &&
+	       y < r->y + r->h && r->y < y + h;
+}
+
+/**
+ * Grow a rectangle to include another one. An empty rectangle is replaced.
+ */
+static void _gfx_union(struct _gfx_rect* r, int32_t x, int32_t y, int32_t w,
+		int32_t h)
+{
+	if (r->w && r->h) {
+		int32_t x2 = _max(r->x + r->w, x + w);
+		int32_t y2 = _max(r->y + r->h, y + h);
+
+		x = _min(r->x, x);
+		y = _min(r->y, y);
+		w = x2 - x;
+		h = y2 - y;
+	}
+	r->x = x;
+	r->y = y;
+	r->w = w;
+	r->h = h;
+}
+
+static uint32_t _gfx_union_area(const struct _gfx_rect* r, int32_t x,
+		int32_t y, int32_t w, int32_t h)
+{
+	struct _gfx_rect u = *r;
+
+	_gfx_union(&u, x, y, w, h);
+	return _gfx_area(&u);
+}
+
+/**
+ * Wait for the DMA jobs if they write to an area about to be accessed by
+ * the CPU.
+ */
+static void _gfx_wait(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, int32_t h)
+{
+	if (surface->busy.w && _gfx_overlap(&surface->busy, x, y, w, h))
+		gfx_sync(surface);
+}
+
+/**
+ * Record an area written by DMA jobs.
+ */
+static void _gfx_add_busy(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, int32_t h)
+{
+	/* The destination is invalidated from the cache when the jobs
+	 * complete: the CPU must not write to the cache lines it shares with
+	 * its neighbours before. */
+	int32_t margin = L1_CACHE_BYTES / (surface->bpp >> 3);
+
+	_gfx_union(&surface->busy, x - margin, y - 1, w + 2 * margin, h + 2);
+}
+
+/**
+ * Prepare the drawing of a primitive by the CPU: clip its area, wait for
+ * the DMA jobs writing to it and mark it dirty.
+ * \return false if the area is outside the surface
+ */
+static bool _gfx_begin(struct _gfx_surface* surface, int32_t* x, int32_t* y,
+		int32_t* w, int32_t* h)
+{
+	if (!_gfx_clip(surface, x, y, w, h))
+		return false;
+	_gfx_wait(surface, *x, *y, *w, *h);
+	gfx_mark_dirty(surface, *x, *y, *w, *h);
+	surface->stats.primitives++;
+	return true;
+}
+
+static void _gfx_fill_words(uint32_t* dest, uint32_t count, uint32_t value)
+{
+	while (count >= 8) {
+		dest[0] = value;
+		dest[1] = value;
+		dest[2] = value;
+		dest[3] = value;
+		dest[4] = value;
+		dest[5] = value;
+		dest[6] = value;
+		dest[7] = value;
+		dest += 8;
+		count -= 8;
+	}
+	while (count--)
+		*dest++ = value;
+}
+
+/**
+ * Fill \a count pixels with word stores, aligning the start with single
+ * pixel stores.
+ */
+static void _gfx_fill_span(uint8_t* dest, uint32_t count, uint8_t bpp,
+		uint32_t pixel)
+{
+	switch (bpp) {
+	case 16:
+		if (((uint32_t)dest & 2) && count) {
+			*(uint16_t*)dest = (uint16_t)pixel;
+			dest += 2;
+			count--;
+		}
+		_gfx_fill_words((uint32_t*)dest, count >> 1, pixel | (pixel << 16));
+		if (count & 1)
+			*(uint16_t*)(dest + (count - 1) * 2) = (uint16_t)pixel;
+		break;
+	case 24:
+		while (((uint32_t)dest & 3) && count) {
+			_gfx_store(dest, 24, pixel);
+			dest += 3;
+			count--;
+		}
+		if (count >= 4) {
+			/* 4 pixels are 3 words: BGRB GRBG RBGR */
+			const uint32_t w0 = pixel | (pixel << 24);
+			const uint32_t w1 = (pixel >> 8) | (pixel << 16);
+			const uint32_t w2 = (pixel >> 16) | (pixel << 8);
+			uint32_t* d = (uint32_t*)dest;
+			uint32_t n = count >> 2;
+
+			for (; n >= 2; n -= 2, d += 6) {
+				d[0] = w0;
+				d[1] = w1;
+				d[2] = w2;
+				d[3] = w0;
+				d[4] = w1;
+				d[5] = w2;
+			}
+			if (n) {
+				d[0] = w0;
+				d[1] = w1;
+				d[2] = w2;
+				d += 3;
+			}
+			dest = (uint8_t*)d;
+			count &= 3;
+		}
+		while (count--) {
+			_gfx_store(dest, 24, pixel);
+			dest += 3;
+		}
+		break;
+	case 32:
+		_gfx_fill_words((uint32_t*)dest, count, pixel);
+		break;
+	}
+}
+
+/**
+ * Fill a horizontal span, clipped to the surface but not marked dirty.
+ */
+static void _gfx_span(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, uint32_t pixel)
+{
+	if (y < 0 || y >= surface->height)
+		return;
+	if (x < 0) {
+		w += x;
+		x = 0;
+	}
+	if (x + w > surface->width)
+		w = surface->width - x;
+	if (w > 0)
+		_gfx_fill_span(_gfx_addr(surface, x, y), w, surface->bpp, pixel);
+}
+
+/**
+ * Get the next DMA job slot of a surface, waiting for its previous job.
+ */
+static struct _gfx_job* _gfx_next_job(struct _gfx_surface* surface)
+{
+	struct _gfx_job* slot = &surface->jobs[surface->next_job];
+
+	dma_job_wait(&slot->job);
+	surface->next_job = (surface->next_job + 1) % GFX_MAX_JOBS;
+	return slot;
+}
+
+/**
+ * Copy rows to the surface with the DMA, DMA_JOB_MAX_ITEMS rows per job.
+ * Rows of a job that cannot be started are copied by the CPU.
+ * \param src_stride Bytes between two source rows, 0 to replicate one row
+ */
+static void _gfx_dma_rows(struct _gfx_surface* surface, uint8_t* dest,
+		const uint8_t* src, uint32_t src_stride, uint32_t len, int32_t rows)
+{
+	while (rows > 0) {
+		struct _gfx_job* slot = _gfx_next_job(surface);
+		uint8_t i, n = (uint8_t)_min(rows, DMA_JOB_MAX_ITEMS);
+
+		for (i = 0; i < n; i++) {
+			slot->rows[i].saddr = src;
+			slot->rows[i].daddr = dest;
+			slot->rows[i].len = len;
+			src += src_stride;
+			dest += surface->stride;
+		}
+		if (dma_sg_async(&slot->job, slot->rows, n, NULL) < 0) {
+			for (i = 0; i < n; i++)
+				memcpy(slot->rows[i].daddr, slot->rows[i].saddr, len);
+		} else {
+			surface->stats.dma_jobs++;
+		}
+		rows -= n;
+	}
+}
+
+/**
+ * Fill a clipped rectangle with the DMA.
+ */
+static void _gfx_dma_fill(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, int32_t h, uint32_t pixel)
+{
+	uint8_t* dest = _gfx_addr(surface, x, y);
+
+	if (x == 0 && w == surface->width && surface->bpp != 24) {
+		/* Whole rows: one memset, row padding included */
+		struct _gfx_job* slot = _gfx_next_job(surface);
+		uint32_t pattern = surface->bpp == 16 ? pixel | (pixel << 16) : pixel;
+
+		if (dma_memset32_async(&slot->job, dest, pattern,
+				h * surface->stride, NULL) == 0) {
+			surface->stats.dma_jobs++;
+			_gfx_add_busy(surface, x, y, w, h);
+			return;
+		}
+	}
+
+	/* Write the first row and replicate it */
+	_gfx_fill_span(dest, w, surface->bpp, pixel);
+	_gfx_dma_rows(surface, dest + surface->stride, dest, 0,
+			w * (surface->bpp >> 3), h - 1);
+	_gfx_add_busy(surface, x, y, w, h);
+}
+
+/**
+ * Fill a rectangle with a pixel value, with the DMA if it is large enough.
+ */
+static void _gfx_fill(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, int32_t h, uint32_t pixel)
+{
+	uint8_t* row;
+
+	if (!_gfx_clip(surface, &x, &y, &w, &h))
+		return;
+	_gfx_wait(surface, x, y, w, h);
+	gfx_mark_dirty(surface, x, y, w, h);
+
+	if (surface->dma && h > 1 &&
+	    (uint32_t)(w * h * (surface->bpp >> 3)) >= surface->dma_threshold) {
+		_gfx_dma_fill(surface, x, y, w, h, pixel);
+		return;
+	}
+
+	row = _gfx_addr(surface, x, y);
+	for (; h > 0; h--, row += surface->stride)
+		_gfx_fill_span(row, w, surface->bpp, pixel);
+}
+
+/**
+ * Blend two pixels of 8-bit channels, two channels per multiplication.
+ * \param alpha Weight of \a src, 0 to 256
+ */
+static inline uint32_t _gfx_blend_8888(uint32_t dst, uint32_t src,
+		uint32_t alpha)
+{
+	uint32_t rb = (src & 0xff00ff) * alpha + (dst & 0xff00ff) * (256 - alpha);
+	uint32_t ag = ((src >> 8) & 0xff00ff) * alpha +
+	              ((dst >> 8) & 0xff00ff) * (256 - alpha);
+
+	return ((rb >> 8) & 0xff00ff) | (ag & 0xff00ff00);
+}
+
+/**
+ * Spread a RGB 565 pixel as 0x0GG0RB0B, leaving room for the products.
+ */
+static inline uint32_t _gfx_spread_565(uint32_t pixel)
+{
+	return (pixel | (pixel << 16)) & 0x07e0f81f;
+}
+
+/**
+ * Blend a RGB 565 pixel with a spread one.
+ * \param alpha Weight of \a src, 0 to 32
+ */
+static inline uint32_t _gfx_blend_565(uint32_t dst, uint32_t src,
+		uint32_t alpha)
+{
+	uint32_t d = _gfx_spread_565(dst);
+
+	d = ((src * alpha + d * (32 - alpha)) >> 5) & 0x07e0f81f;
+	return (d | (d >> 16)) & 0xffff;
+}
+
+/**
+ * Blend a 0xAARRGGBB color over a pixel of the surface.
+ */
+static inline uint32_t _gfx_blend_pixel(const struct _gfx_surface* surface,
+		uint32_t dst, uint32_t color, uint8_t alpha)
+{
+	if (surface->bpp == 16)
+		return _gfx_blend_565(dst, _gfx_spread_565(gfx_pixel(surface, color)),
+				(alpha + 4) >> 3);
+	return _gfx_blend_8888(dst, color | 0xff000000, alpha + (alpha >> 7));
+}
+
+/**
+ * Get the row bitmasks of a glyph from the cache, rendering it on a miss.
+ */
+static const uint32_t* _gfx_get_glyph(struct _gfx_surface* surface,
+		const struct _gfx_font* font, uint8_t c)
+{
+	uint32_t index = (c + ((uint32_t)font >> 2) * 37) &
+	                 (GFX_GLYPH_CACHE_SIZE - 1);
+	struct _gfx_glyph* glyph = &_glyph_cache[index];
+
+	if (glyph->font == font && glyph->c == c) {
+		surface->stats.glyph_hits++;
+		return glyph->rows;
+	}
+
+	memset(glyph->rows, 0, sizeof(glyph->rows));
+	font->render(font, c, glyph->rows);
+	glyph->font = font;
+	glyph->c = c;
+	surface->stats.glyph_misses++;
+	return glyph->rows;
+}
+
+/**
+ * Draw a glyph as runs of foreground (and background) pixels. The area is
+ * neither waited for nor marked dirty.
+ */
+static void _gfx_draw_glyph(struct _gfx_surface* surface,
+		const struct _gfx_font* font, int32_t x, int32_t y, uint8_t c,
+		uint32_t fg, uint32_t bg, bool opaque)
+{
+	const uint32_t bytes = surface->bpp >> 3;
+	const uint32_t* rows;
+	int32_t row, row_end, col, col_start, col_end, start;
+	uint8_t* dest;
+
+	if (c < font->first || c > font->last)
+		return;
+
+	row = _max(0, -y);
+	row_end = _min(font->height, surface->height - y);
+	col_start = _max(0, -x);
+	col_end = _min(font->width, surface->width - x);
+	if (row >= row_end || col_start >= col_end)
+		return;
+
+	rows = _gfx_get_glyph(surface, font, c);
+	dest = _gfx_addr(surface, x + col_start, y + row);
+	for (; row < row_end; row++, dest += surface->stride) {
+		uint32_t mask = rows[row];
+
+		for (col = col_start; col < col_end;) {
+			uint32_t set = (mask >> col) & 1;
+
+			start = col;
+			do {
+				col++;
+			} while (col < col_end && ((mask >> col) & 1) == set);
+			if (set || opaque)
+				_gfx_fill_span(dest + (start - col_start) * bytes,
+						col - start, surface->bpp, set ? fg : bg);
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+int gfx_init_surface(struct _gfx_surface* surface, void* buffer,
+		uint16_t width, uint16_t height, uint8_t bpp)
+{
+	memset(surface, 0, sizeof(*surface));
+	if (!buffer || ((uint32_t)buffer & 3) || !width || !height)
+		return -EINVAL;
+	if (bpp != 16 && bpp != 24 && bpp != 32)
+		return -EINVAL;
+
+	surface->buffer = (uint8_t*)buffer;
+	surface->width = width;
+	surface->height = height;
+	surface->bpp = bpp;
+	surface->stride = ROUND_UP_MULT(width * (bpp >> 3), 4);
+	surface->dma_threshold = GFX_DMA_THRESHOLD;
+	return 0;
+}
+
+int gfx_init_canvas(struct _gfx_surface* surface,
+		const struct _lcdc_layer* canvas)
+{
+	int err;
+
+	if (!canvas) {
+		memset(surface, 0, sizeof(*surface));
+		return -EINVAL;
+	}
+
+	err = gfx_init_surface(surface, canvas->buffer, canvas->width,
+			canvas->height, canvas->bpp);
+	if (err < 0)
+		return err;
+	surface->layer_id = canvas->layer_id;
+	return 0;
+}
+
+void gfx_enable_dma(struct _gfx_surface* surface, bool enable,
+		uint32_t threshold)
+{
+	if (!enable)
+		gfx_sync(surface);
+	surface->dma = enable;
+	surface->dma_threshold = threshold ? threshold : GFX_DMA_THRESHOLD;
+}
+
+void gfx_sync(struct _gfx_surface* surface)
+{
+	uint8_t i;
+
+	if (!surface->busy.w)
+		return;
+	for (i = 0; i < GFX_MAX_JOBS; i++)
+		dma_job_wait(&surface->jobs[i].job);
+	surface->busy.w = 0;
+	surface->busy.h = 0;
+}
+
+uint32_t gfx_pixel(const struct _gfx_surface* surface, uint32_t color)
+{
+	switch (surface->bpp) {
+	case 16:
+		return ((color >> 8) & 0xf800) | ((color >> 5) & 0x07e0) |
+		       ((color >> 3) & 0x001f);
+	case 24:
+		return color & 0xffffff;
+	default:
+		return color;
+	}
+}
+
+void gfx_mark_dirty(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, int32_t h)
+{
+	uint32_t area, best_growth = UINT32_MAX;
+	uint8_t i, best = 0;
+
+	if (!_gfx_clip(surface, &x, &y, &w, &h))
+		return;
+	area = w * h;
+
+	for (i = 0; i < surface->num_dirty; i++) {
+		struct _gfx_rect* r = &surface->dirty[i];
+		uint32_t sum = _gfx_area(r) + area;
+		uint32_t u = _gfx_union_area(r, x, y, w, h);
+
+		/* Merge when the union is not much larger than both */
+		if (u <= sum + sum / 4) {
+			_gfx_union(r, x, y, w, h);
+			return;
+		}
+		if (u - _gfx_area(r) < best_growth) {
+			best_growth = u - _gfx_area(r);
+			best = i;
+		}
+	}
+
+	if (surface->num_dirty < GFX_MAX_DIRTY)
+		best = surface->num_dirty++;
+	_gfx_union(&surface->dirty[best], x, y, w, h);
+}
+
+void gfx_present(struct _gfx_surface* surface)
+{
+	const uint32_t bytes = surface->bpp >> 3;
+	uint8_t i;
+
+	gfx_sync(surface);
+	for (i = 0; i < surface->num_dirty; i++) {
+		struct _gfx_rect* r = &surface->dirty[i];
+		const uint8_t* start = _gfx_addr(surface, r->x, r->y);
+		uint32_t len = r->w * bytes;
+		uint16_t row;
+
+		if (2 * len >= surface->stride) {
+			/* Wide rectangle: one pass, row gaps included */
+			len += (r->h - 1) * surface->stride;
+			cache_clean_region(start, len);
+			surface->stats.cleaned += len;
+		} else {
+			for (row = 0; row < r->h; row++, start += surface->stride)
+				cache_clean_region(start, len);
+			surface->stats.cleaned += len * r->h;
+		}
+		r->w = 0;
+		r->h = 0;
+	}
+	surface->num_dirty = 0;
+	surface->stats.presents++;
+}
+
+void gfx_fill(struct _gfx_surface* surface, uint32_t color)
+{
+	gfx_fill_rect(surface, 0, 0, surface->width, surface->height, color);
+}
+
+void gfx_fill_rect(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, int32_t h, uint32_t color)
+{
+	surface->stats.primitives++;
+	_gfx_fill(surface, x, y, w, h, gfx_pixel(surface, color));
+}
+
+void gfx_draw_pixel(struct _gfx_surface* surface, int32_t x, int32_t y,
+		uint32_t color)
+{
+	int32_t w = 1, h = 1;
+
+	if (_gfx_begin(surface, &x, &y, &w, &h))
+		_gfx_store(_gfx_addr(surface, x, y), surface->bpp,
+				gfx_pixel(surface, color));
+}
+
+uint32_t gfx_read_pixel(struct _gfx_surface* surface, int32_t x, int32_t y)
+{
+	int32_t w = 1, h = 1;
+
+	if (!_gfx_clip(surface, &x, &y, &w, &h))
+		return 0;
+	_gfx_wait(surface, x, y, 1, 1);
+	return _gfx_load(_gfx_addr(surface, x, y), surface->bpp);
+}
+
+void gfx_draw_hline(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, uint32_t color)
+{
+	gfx_fill_rect(surface, x, y, w, 1, color);
+}
+
+void gfx_draw_vline(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t h, uint32_t color)
+{
+	gfx_fill_rect(surface, x, y, 1, h, color);
+}
+
+void gfx_draw_line(struct _gfx_surface* surface, int32_t x1, int32_t y1,
+		int32_t x2, int32_t y2, uint32_t color)
+{
+	int32_t dx, dy, sx, sy, err, e2, x, y, w, h;
+	uint32_t pixel;
+
+	if (y1 == y2) {
+		gfx_draw_hline(surface, _min(x1, x2), y1, abs_u32(x2 - x1) + 1, color);
+		return;
+	}
+	if (x1 == x2) {
+		gfx_draw_vline(surface, x1, _min(y1, y2), abs_u32(y2 - y1) + 1, color);
+		return;
+	}
+
+	dx = abs_u32(x2 - x1);
+	dy = -(int32_t)abs_u32(y2 - y1);
+	x = _min(x1, x2);
+	y = _min(y1, y2);
+	w = dx + 1;
+	h = 1 - dy;
+	if (!_gfx_begin(surface, &x, &y, &w, &h))
+		return;
+
+	/* Bresenham */
+	pixel = gfx_pixel(surface, color);
+	sx = x1 < x2 ? 1 : -1;
+	sy = y1 < y2 ? 1 : -1;
+	err = dx + dy;
+	for (;;) {
+		_gfx_put(surface, x1, y1, pixel);
+		if (x1 == x2 && y1 == y2)
+			break;
+		e2 = 2 * err;
+		if (e2 >= dy) {
+			err += dy;
+			x1 += sx;
+		}
+		if (e2 <= dx) {
+			err += dx;
+			y1 += sy;
+		}
+	}
+}
+
+void gfx_draw_rect(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, int32_t h, uint32_t color)
+{
+	uint32_t pixel = gfx_pixel(surface, color);
+
+	if (w <= 0 || h <= 0)
+		return;
+	surface->stats.primitives++;
+	_gfx_fill(surface, x, y, w, 1, pixel);
+	_gfx_fill(surface, x, y + h - 1, w, 1, pixel);
+	_gfx_fill(surface, x, y + 1, 1, h - 2, pixel);
+	_gfx_fill(surface, x + w - 1, y + 1, 1, h - 2, pixel);
+}
+
+void gfx_draw_circle(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t r, uint32_t color)
+{
+	int32_t bx = x - r, by = y - r, bw = 2 * r + 1, bh = 2 * r + 1;
+	int32_t px = r, py = 0, err = 1 - r;
+	uint32_t pixel;
+
+	if (r < 0 || !_gfx_begin(surface, &bx, &by, &bw, &bh))
+		return;
+
+	/* Midpoint circle, one octant mirrored 8 times */
+	pixel = gfx_pixel(surface, color);
+	while (px >= py) {
+		_gfx_put(surface, x + px, y + py, pixel);
+		_gfx_put(surface, x - px, y + py, pixel);
+		_gfx_put(surface, x + px, y - py, pixel);
+		_gfx_put(surface, x - px, y - py, pixel);
+		_gfx_put(surface, x + py, y + px, pixel);
+		_gfx_put(surface, x - py, y + px, pixel);
+		_gfx_put(surface, x + py, y - px, pixel);
+		_gfx_put(surface, x - py, y - px, pixel);
+		py++;
+		if (err < 0) {
+			err += 2 * py + 1;
+		} else {
+			px--;
+			err += 2 * (py - px) + 1;
+		}
+	}
+}
+
+void gfx_fill_circle(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t r, uint32_t color)
+{
+	int32_t bx = x - r, by = y - r, bw = 2 * r + 1, bh = 2 * r + 1;
+	int32_t px = r, py = 0, err = 1 - r;
+	uint32_t pixel;
+
+	if (r < 0 || !_gfx_begin(surface, &bx, &by, &bw, &bh))
+		return;
+
+	pixel = gfx_pixel(surface, color);
+	while (px >= py) {
+		_gfx_span(surface, x - px, y + py, 2 * px + 1, pixel);
+		_gfx_span(surface, x - px, y - py, 2 * px + 1, pixel);
+		_gfx_span(surface, x - py, y + px, 2 * py + 1, pixel);
+		_gfx_span(surface, x - py, y - px, 2 * py + 1, pixel);
+		py++;
+		if (err < 0) {
+			err += 2 * py + 1;
+		} else {
+			px--;
+			err += 2 * (py - px) + 1;
+		}
+	}
+}
+
+void gfx_draw_rounded_rect(struct _gfx_surface* surface, int32_t x,
+		int32_t y, int32_t w, int32_t h, int32_t r, uint32_t color)
+{
+	int32_t bx = x, by = y, bw = w, bh = h;
+	int32_t px, py = 0, err, row, left, right, top, bottom;
+	uint32_t pixel;
+
+	r = _max(0, _min(r, _min(w, h) / 2));
+	if (!_gfx_begin(surface, &bx, &by, &bw, &bh))
+		return;
+
+	pixel = gfx_pixel(surface, color);
+	_gfx_span(surface, x + r, y, w - 2 * r, pixel);
+	_gfx_span(surface, x + r, y + h - 1, w - 2 * r, pixel);
+	for (row = y + r; row < y + h - r; row++) {
+		_gfx_put(surface, x, row, pixel);
+		_gfx_put(surface, x + w - 1, row, pixel);
+	}
+
+	/* Corners: quarters of a circle around the inner corners */
+	left = x + r;
+	right = x + w - 1 - r;
+	top = y + r;
+	bottom = y + h - 1 - r;
+	px = r;
+	err = 1 - r;
+	while (px >= py) {
+		_gfx_put(surface, right + px, bottom + py, pixel);
+		_gfx_put(surface, right + py, bottom + px, pixel);
+		_gfx_put(surface, left - px, bottom + py, pixel);
+		_gfx_put(surface, left - py, bottom + px, pixel);
+		_gfx_put(surface, right + px, top - py, pixel);
+		_gfx_put(surface, right + py, top - px, pixel);
+		_gfx_put(surface, left - px, top - py, pixel);
+		_gfx_put(surface, left - py, top - px, pixel);
+		py++;
+		if (err < 0) {
+			err += 2 * py + 1;
+		} else {
+			px--;
+			err += 2 * (py - px) + 1;
+		}
+	}
+}
+
+void gfx_fill_rounded_rect(struct _gfx_surface* surface, int32_t x,
+		int32_t y, int32_t w, int32_t h, int32_t r, uint32_t color)
+{
+	int32_t bx = x, by = y, bw = w, bh = h;
+	int32_t px, py = 0, err, top, bottom, inner;
+	uint32_t pixel;
+
+	r = _max(0, _min(r, _min(w, h) / 2));
+	if (!_gfx_begin(surface, &bx, &by, &bw, &bh))
+		return;
+
+	/* Rows of the corners, drawn by the CPU before the middle rows which
+	 * may go to the DMA */
+	pixel = gfx_pixel(surface, color);
+	top = y + r;
+	bottom = y + h - 1 - r;
+	inner = w - 2 * r;
+	px = r;
+	err = 1 - r;
+	while (px >= py) {
+		_gfx_span(surface, x + r - px, top - py, inner + 2 * px, pixel);
+		_gfx_span(surface, x + r - py, top - px, inner + 2 * py, pixel);
+		_gfx_span(surface, x + r - px, bottom + py, inner + 2 * px, pixel);
+		_gfx_span(surface, x + r - py, bottom + px, inner + 2 * py, pixel);
+		py++;
+		if (err < 0) {
+			err += 2 * py + 1;
+		} else {
+			px--;
+			err += 2 * (py - px) + 1;
+		}
+	}
+	_gfx_fill(surface, x, top + 1, w, bottom - top - 1, pixel);
+}
+
+void gfx_blend_rect(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, int32_t h, uint32_t color, uint8_t alpha)
+{
+	uint8_t* row;
+	int32_t i;
+
+	if (alpha == 0)
+		return;
+	if (alpha == 0xff) {
+		gfx_fill_rect(surface, x, y, w, h, color);
+		return;
+	}
+	if (!_gfx_begin(surface, &x, &y, &w, &h))
+		return;
+
+	row = _gfx_addr(surface, x, y);
+	if (surface->bpp == 16) {
+		uint32_t src = _gfx_spread_565(gfx_pixel(surface, color));
+		uint32_t a = (alpha + 4) >> 3;
+
+		for (; h > 0; h--, row += surface->stride) {
+			uint16_t* p = (uint16_t*)row;
+
+			for (i = 0; i < w; i++)
+				p[i] = _gfx_blend_565(p[i], src, a);
+		}
+	} else if (surface->bpp == 24) {
+		uint32_t a = alpha + (alpha >> 7);
+
+		for (; h > 0; h--, row += surface->stride) {
+			uint8_t* p = row;
+
+			for (i = 0; i < w; i++, p += 3)
+				_gfx_store(p, 24, _gfx_blend_8888(_gfx_load(p, 24),
+						color, a));
+		}
+	} else {
+		uint32_t a = alpha + (alpha >> 7);
+
+		color |= 0xff000000;
+		for (; h > 0; h--, row += surface->stride) {
+			uint32_t* p = (uint32_t*)row;
+
+			for (i = 0; i < w; i++)
+				p[i] = _gfx_blend_8888(p[i], color, a);
+		}
+	}
+}
+
+void gfx_blit(struct _gfx_surface* surface, int32_t x, int32_t y,
+		const void* src, uint32_t src_stride, int32_t w, int32_t h)
+{
+	const uint32_t bytes = surface->bpp >> 3;
+	const uint8_t* s = (const uint8_t*)src;
+	int32_t x0 = x, y0 = y;
+	uint32_t len;
+	uint8_t* dest;
+
+	if (!_gfx_clip(surface, &x, &y, &w, &h))
+		return;
+	s += (y - y0) * src_stride + (x - x0) * bytes;
+	_gfx_wait(surface, x, y, w, h);
+	gfx_mark_dirty(surface, x, y, w, h);
+	surface->stats.primitives++;
+
+	dest = _gfx_addr(surface, x, y);
+	len = w * bytes;
+	if (surface->dma && len * h >= surface->dma_threshold) {
+		if (len == surface->stride && src_stride == len) {
+			struct _gfx_job* slot = _gfx_next_job(surface);
+
+			if (dma_memcpy_async(&slot->job, dest, s, len * h, NULL) < 0)
+				memcpy(dest, s, len * h);
+			else
+				surface->stats.dma_jobs++;
+		} else {
+			_gfx_dma_rows(surface, dest, s, src_stride, len, h);
+		}
+		_gfx_add_busy(surface, x, y, w, h);
+		return;
+	}
+
+	for (; h > 0; h--, dest += surface->stride, s += src_stride)
+		memcpy(dest, s, len);
+}
+
+void gfx_blit_argb(struct _gfx_surface* surface, int32_t x, int32_t y,
+		const uint32_t* src, uint32_t src_stride, int32_t w, int32_t h)
+{
+	const uint32_t bytes = surface->bpp >> 3;
+	int32_t x0 = x, y0 = y, i;
+	uint8_t* row;
+
+	if (!_gfx_begin(surface, &x, &y, &w, &h))
+		return;
+	src += (y - y0) * src_stride + (x - x0);
+
+	row = _gfx_addr(surface, x, y);
+	for (; h > 0; h--, row += surface->stride, src += src_stride) {
+		uint8_t* p = row;
+
+		for (i = 0; i < w; i++, p += bytes) {
+			uint32_t color = src[i];
+			uint8_t alpha = color >> 24;
+
+			if (alpha == 0xff)
+				_gfx_store(p, surface->bpp, gfx_pixel(surface, color));
+			else if (alpha)
+				_gfx_store(p, surface->bpp, _gfx_blend_pixel(surface,
+						_gfx_load(p, surface->bpp), color, alpha));
+		}
+	}
+}
+
+void gfx_draw_char(struct _gfx_surface* surface,
+		const struct _gfx_font* font, int32_t x, int32_t y, uint8_t c,
+		uint32_t color, uint32_t bg_color, bool opaque)
+{
+	int32_t bx = x, by = y, bw = font->width, bh = font->height;
+
+	if (!_gfx_begin(surface, &bx, &by, &bw, &bh))
+		return;
+	_gfx_draw_glyph(surface, font, x, y, c, gfx_pixel(surface, color),
+			gfx_pixel(surface, bg_color), opaque);
+}
+
+void gfx_draw_string(struct _gfx_surface* surface,
+		const struct _gfx_font* font, int32_t x, int32_t y, const char* str,
+		uint32_t color, uint32_t bg_color, bool opaque)
+{
+	const int32_t x0 = x;
+	uint32_t fg, bg, w, h;
+	int32_t bx = x, by = y, bw, bh;
+
+	gfx_get_string_size(font, str, &w, &h);
+	bw = w;
+	bh = h;
+	if (!_gfx_begin(surface, &bx, &by, &bw, &bh))
+		return;
+
+	fg = gfx_pixel(surface, color);
+	bg = gfx_pixel(surface, bg_color);
+	for (; *str; str++) {
+		if (*str == '\n') {
+			x = x0;
+			y += font->height + font->char_space;
+		} else {
+			_gfx_draw_glyph(surface, font, x, y, *str, fg, bg, opaque);
+			x += font->width + font->char_space;
+		}
+	}
+}
+
+void gfx_get_string_size(const struct _gfx_font* font, const char* str,
+		uint32_t* width, uint32_t* height)
+{
+	uint32_t line = 0, max_line = 0, lines = 1;
+
+	for (; *str; str++) {
+		if (*str == '\n') {
+			lines++;
+			line = 0;
+			continue;
+		}
+		line += font->width + font->char_space;
+		max_line = max_u32(max_line, line);
+	}
+
+	if (width)
+		*width = max_line ? max_line - font->char_space : 0;
+	if (height)
+		*height = lines * (font->height + font->char_space) - font->char_space;
+}
+
+void gfx_flush_glyph_cache(void)
+{
+	memset(_glyph_cache, 0, sizeof(_glyph_cache));
+}
+
+void gfx_get_stats(const struct _gfx_surface* surface,
+		struct _gfx_stats* stats)
+{
+	*stats = surface->stats;
+}
+
+void gfx_reset_stats(struct _gfx_surface* surface)
+{
+	memset(&surface->stats, 0, sizeof(surface->stats));
+}
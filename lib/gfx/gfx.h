@@ -0,0 +1,323 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * \section Purpose
+ * 2D drawing on LCDC canvases and off-screen buffers.
+ *
+ * A surface describes a frame buffer in one of the RGB formats of the LCDC
+ * (16 bpp RGB 565, 24 bpp packed RGB 888, 32 bpp ARGB 8888), usually the
+ * canvas returned by lcdc_get_canvas(). Colors are always given as
+ * 0xAARRGGBB and converted to the format of the surface; the alpha byte is
+ * only stored on 32 bpp surfaces.
+ *
+ * Spans are filled a word at a time (and 8 words per iteration), whatever
+ * the pixel size. When enabled with gfx_enable_dma(), large fills and
+ * blits are handed to the DMA job engine (dma_job.h): a full-width fill is
+ * a 32-bit memset, other fills write their first row with the CPU and
+ * replicate it, a blit copies row by row. DMA jobs run in the background
+ * until the CPU accesses the area they write, or until gfx_sync().
+ *
+ * Every primitive records the area it touched. gfx_present() cleans the
+ * data cache for these dirty rectangles only, making the changes visible to
+ * the LCDC which scans the buffer continuously.
+ *
+ * Text uses fonts described by struct _gfx_font. Glyphs are rendered once
+ * into row bitmasks by the font and kept in a cache shared by all
+ * surfaces.
+ *
+ * \section Usage
+ * -# Call gfx_init_canvas() on the layer returned by lcdc_get_canvas(), or
+ *    gfx_init_surface() on an off-screen buffer.
+ * -# Optionally call dma_job_initialize() then gfx_enable_dma().
+ * -# Draw, then call gfx_present() once per frame.
+ */
+
+#ifndef GFX_H
+#define GFX_H
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "display/lcdc.h"
+#include "dma/dma.h"
+#include "dma/dma_job.h"
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Maximum number of dirty rectangles tracked per surface */
+#ifndef GFX_MAX_DIRTY
+#define GFX_MAX_DIRTY        8
+#endif
+
+/** Maximum number of DMA jobs in flight per surface */
+#ifndef GFX_MAX_JOBS
+#define GFX_MAX_JOBS         8
+#endif
+
+/** Default size (in bytes) from which fills and blits use the DMA */
+#ifndef GFX_DMA_THRESHOLD
+#define GFX_DMA_THRESHOLD    8192
+#endif
+
+/** Number of entries of the glyph cache (power of two) */
+#ifndef GFX_GLYPH_CACHE_SIZE
+#define GFX_GLYPH_CACHE_SIZE 128
+#endif
+
+/** Maximum glyph height; glyphs are at most 32 pixels wide */
+#ifndef GFX_GLYPH_MAX_HEIGHT
+#define GFX_GLYPH_MAX_HEIGHT 16
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** Rectangle, in pixels */
+struct _gfx_rect {
+	int16_t x;
+	int16_t y;
+	uint16_t w;
+	uint16_t h;
+};
+
+struct _gfx_font;
+
+/**
+ * Renders a glyph of a font: one bitmask per row, bit 0 being the leftmost
+ * pixel. Rows are cleared by the caller.
+ */
+typedef void (*gfx_glyph_render_t)(const struct _gfx_font* font, uint8_t c,
+		uint32_t* rows);
+
+/** Bitmap font */
+struct _gfx_font {
+	uint8_t width;       /* Glyph width in pixels, up to 32 */
+	uint8_t height;      /* Glyph height in pixels, up to GFX_GLYPH_MAX_HEIGHT */
+	uint8_t char_space;  /* Space between two characters */
+	uint8_t first;       /* First character of the font */
+	uint8_t last;        /* Last character of the font */
+	const void* data;    /* Font data, for the render function */
+	gfx_glyph_render_t render;
+};
+
+/** Drawing statistics of a surface */
+struct _gfx_stats {
+	uint32_t primitives;    /* Primitives drawn */
+	uint32_t dma_jobs;      /* Fills and blits handed to the DMA */
+	uint32_t glyph_hits;    /* Glyphs found in the cache */
+	uint32_t glyph_misses;  /* Glyphs rendered by their font */
+	uint32_t presents;      /* Calls to gfx_present() */
+	uint64_t cleaned;       /* Bytes cleaned from the data cache */
+};
+
+/** DMA job of a surface, with its row list */
+struct _gfx_job {
+	struct _dma_job job;
+	struct _dma_transfer_cfg rows[DMA_JOB_MAX_ITEMS];
+};
+
+/** Drawing surface */
+struct _gfx_surface {
+	uint8_t* buffer;
+	uint16_t width;
+	uint16_t height;
+	uint32_t stride;       /* Bytes per row, rows are word aligned */
+	uint8_t bpp;
+	uint8_t layer_id;      /* LCDC layer, 0 for off-screen buffers */
+
+	struct _gfx_rect dirty[GFX_MAX_DIRTY];
+	uint8_t num_dirty;
+
+	bool dma;
+	uint32_t dma_threshold;
+	struct _gfx_job jobs[GFX_MAX_JOBS];
+	uint8_t next_job;      /* Next slot of jobs[], used round-robin */
+	struct _gfx_rect busy; /* Area written by the DMA jobs in flight */
+
+	struct _gfx_stats stats;
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Set up a surface on a buffer.
+ * \param surface Surface to set up
+ * \param buffer Frame buffer, word aligned
+ * \param width Width in pixels
+ * \param height Height in pixels
+ * \param bpp Bits per pixel: 16, 24 or 32
+ * \return 0 on success, -EINVAL on unsupported parameters
+ */
+extern int gfx_init_surface(struct _gfx_surface* surface, void* buffer,
+		uint16_t width, uint16_t height, uint8_t bpp);
+
+/**
+ * \brief Set up a surface on an LCDC canvas (see lcdc_get_canvas()).
+ * \return 0 on success, -EINVAL if the canvas has no RGB buffer
+ */
+extern int gfx_init_canvas(struct _gfx_surface* surface,
+		const struct _lcdc_layer* canvas);
+
+/**
+ * \brief Use the DMA job engine for fills and blits of at least
+ * \a threshold bytes (0 for GFX_DMA_THRESHOLD). dma_job_initialize() must
+ * have been called.
+ */
+extern void gfx_enable_dma(struct _gfx_surface* surface, bool enable,
+		uint32_t threshold);
+
+/**
+ * \brief Wait for the DMA jobs of the surface.
+ */
+extern void gfx_sync(struct _gfx_surface* surface);
+
+/**
+ * \brief Convert a 0xAARRGGBB color to the pixel format of the surface.
+ */
+extern uint32_t gfx_pixel(const struct _gfx_surface* surface, uint32_t color);
+
+/**
+ * \brief Add a rectangle to the dirty area of the surface. Called by all
+ * primitives; needed only after writing to the buffer directly.
+ */
+extern void gfx_mark_dirty(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, int32_t h);
+
+/**
+ * \brief Make the changes visible to the LCDC: wait for the DMA jobs,
+ * clean the data cache for the dirty rectangles and clear them.
+ */
+extern void gfx_present(struct _gfx_surface* surface);
+
+extern void gfx_fill(struct _gfx_surface* surface, uint32_t color);
+
+extern void gfx_fill_rect(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, int32_t h, uint32_t color);
+
+extern void gfx_draw_pixel(struct _gfx_surface* surface, int32_t x, int32_t y,
+		uint32_t color);
+
+/**
+ * \brief Read a pixel.
+ * \return Raw pixel value in the format of the surface, 0 if outside
+ */
+extern uint32_t gfx_read_pixel(struct _gfx_surface* surface, int32_t x, int32_t y);
+
+extern void gfx_draw_hline(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, uint32_t color);
+
+extern void gfx_draw_vline(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t h, uint32_t color);
+
+extern void gfx_draw_line(struct _gfx_surface* surface, int32_t x1, int32_t y1,
+		int32_t x2, int32_t y2, uint32_t color);
+
+extern void gfx_draw_rect(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, int32_t h, uint32_t color);
+
+extern void gfx_draw_circle(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t r, uint32_t color);
+
+extern void gfx_fill_circle(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t r, uint32_t color);
+
+extern void gfx_draw_rounded_rect(struct _gfx_surface* surface, int32_t x,
+		int32_t y, int32_t w, int32_t h, int32_t r, uint32_t color);
+
+extern void gfx_fill_rounded_rect(struct _gfx_surface* surface, int32_t x,
+		int32_t y, int32_t w, int32_t h, int32_t r, uint32_t color);
+
+/**
+ * \brief Blend a color over a rectangle.
+ * \param alpha Opacity of the color, 0 (none) to 255 (opaque)
+ */
+extern void gfx_blend_rect(struct _gfx_surface* surface, int32_t x, int32_t y,
+		int32_t w, int32_t h, uint32_t color, uint8_t alpha);
+
+/**
+ * \brief Copy an image in the format of the surface. When the copy is done
+ * by the DMA, the image must not change until gfx_sync().
+ * \param src Top-left pixel of the image
+ * \param src_stride Bytes per row of the image
+ */
+extern void gfx_blit(struct _gfx_surface* surface, int32_t x, int32_t y,
+		const void* src, uint32_t src_stride, int32_t w, int32_t h);
+
+/**
+ * \brief Blend an ARGB 8888 image using its alpha channel.
+ * \param src Top-left pixel of the image
+ * \param src_stride Pixels per row of the image
+ */
+extern void gfx_blit_argb(struct _gfx_surface* surface, int32_t x, int32_t y,
+		const uint32_t* src, uint32_t src_stride, int32_t w, int32_t h);
+
+/**
+ * \brief Draw a character.
+ * \param bg_color Background color, ignored if \a opaque is false
+ */
+extern void gfx_draw_char(struct _gfx_surface* surface,
+		const struct _gfx_font* font, int32_t x, int32_t y, uint8_t c,
+		uint32_t color, uint32_t bg_color, bool opaque);
+
+/**
+ * \brief Draw a string, honoring line breaks.
+ */
+extern void gfx_draw_string(struct _gfx_surface* surface,
+		const struct _gfx_font* font, int32_t x, int32_t y, const char* str,
+		uint32_t color, uint32_t bg_color, bool opaque);
+
+/**
+ * \brief Size of a string drawn with gfx_draw_string().
+ */
+extern void gfx_get_string_size(const struct _gfx_font* font, const char* str,
+		uint32_t* width, uint32_t* height);
+
+/**
+ * \brief Empty the glyph cache, e.g. after changing font data.
+ */
+extern void gfx_flush_glyph_cache(void);
+
+extern void gfx_get_stats(const struct _gfx_surface* surface,
+		struct _gfx_stats* stats);
+
+extern void gfx_reset_stats(struct _gfx_surface* surface);
+
+#endif /* GFX_H */
@@ -52,6 +52,22 @@
  *        Definitions
  *----------------------------------------------------------------------------*/
 
+/**
+ * Size of the sector cache, in sectors. The cache holds either the sectors
+ * read ahead of a sequential read stream, or the single-sector writes
+ * coalesced before being issued as one multiple-block write.
+ * Requests of this size or larger bypass the cache.
+ * Set to 0 (e.g. from ffconf.h) to disable the cache.
+ */
+#ifndef SDMMC_FF_CACHE_SECTORS
+#define SDMMC_FF_CACHE_SECTORS 32
+#endif
+
+/** Content of the sector cache */
+#define CACHE_EMPTY 0
+#define CACHE_READ  1
+#define CACHE_WRITE 2
+
 /**
  *  \brief Access the SD/MMC Library instances owned by the application.
  *  Used upon calls from the FatFs Module.
@@ -60,6 +76,169 @@
  */
 extern bool SD_GetInstance(uint8_t index, sSdCard **holder);
 
+#if SDMMC_FF_CACHE_SECTORS > 0
+struct _sector_cache {
+	uint8_t slot;       /**< Drive the cached sectors belong to */
+	uint8_t state;      /**< CACHE_EMPTY, CACHE_READ or CACHE_WRITE */
+	uint32_t start;     /**< First cached sector */
+	uint32_t count;     /**< Number of cached sectors */
+	uint32_t next;      /**< Sector following the last read request */
+	uint8_t next_slot;  /**< Drive of the last read request */
+};
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+#if SDMMC_FF_CACHE_SECTORS > 0
+static struct _sector_cache cache;
+
+/* Filled by the DMA, align it on cache lines */
+ALIGNED(L1_CACHE_BYTES) static uint8_t cache_buf[SDMMC_FF_CACHE_SECTORS * _MAX_SS];
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Translate a library return code into a FatFs result code.
+ */
+static DRESULT _translate_rc(uint8_t rc)
+{
+	if (rc == SDMMC_OK || rc == SDMMC_CHANGED)
+		return RES_OK;
+	else if (rc == SDMMC_ERR_IO || rc == SDMMC_ERR_RESP || rc == SDMMC_ERR)
+		return RES_ERROR;
+	else if (rc == SDMMC_NO_RESPONSE || rc == SDMMC_BUSY
+	    || rc == SDMMC_NOT_INITIALIZED || rc == SDMMC_LOCKED
+	    || rc == SDMMC_STATE || rc == SDMMC_USER_CANCEL)
+		return RES_NOTRDY;
+	else if (rc == SDMMC_PARAM || rc == SDMMC_NOT_SUPPORTED)
+		return RES_PARERR;
+	else
+		return RES_ERROR;
+}
+
+/**
+ * \brief Read sectors from the device, using a multiple-block command if
+ * more than one device block is involved.
+ */
+static DRESULT _read_sectors(sSdCard *lib, BYTE* buff, DWORD sector,
+		UINT count)
+{
+	uint32_t blk_size, addr = sector, len = count;
+	uint8_t rc;
+
+	blk_size = SD_GetBlockSize(lib);
+	if (blk_size == 0)
+		return RES_NOTRDY;
+	if (blk_size < _MIN_SS) {
+		if (_MIN_SS % blk_size)
+			return RES_PARERR;
+		addr = sector * (_MIN_SS / blk_size);
+		len  = count * (_MIN_SS / blk_size);
+	}
+	if (len <= 1)
+		rc = SD_ReadBlocks(lib, addr, buff, len);
+	else
+		rc = SD_Read(lib, addr, buff, len, NULL, NULL);
+	return _translate_rc(rc);
+}
+
+#if !_FS_READONLY
+/**
+ * \brief Write sectors to the device, using a multiple-block command if
+ * more than one device block is involved.
+ */
+static DRESULT _write_sectors(sSdCard *lib, const BYTE* buff, DWORD sector,
+		UINT count)
+{
+	uint32_t blk_size, addr = sector, len = count;
+	uint8_t rc;
+
+	blk_size = SD_GetBlockSize(lib);
+	if (blk_size == 0)
+		return RES_NOTRDY;
+	if (blk_size < _MIN_SS) {
+		if (_MIN_SS % blk_size)
+			return RES_PARERR;
+		addr = sector * (_MIN_SS / blk_size);
+		len  = count * (_MIN_SS / blk_size);
+	}
+	if (len <= 1)
+		rc = SD_WriteBlocks(lib, addr, buff, len);
+	else
+		rc = SD_Write(lib, addr, buff, len, NULL, NULL);
+	return _translate_rc(rc);
+}
+#endif /* _FS_READONLY */
+
+/**
+ * \brief Return the number of sectors of the device.
+ */
+static uint32_t _get_sector_count(sSdCard *lib)
+{
+	uint32_t blk_size = SD_GetBlockSize(lib);
+	uint32_t blk_count = SD_GetNumberBlocks(lib);
+
+	if (blk_size == 0)
+		return 0;
+	if (blk_size < _MIN_SS)
+		return blk_count / (_MIN_SS / blk_size);
+	return blk_count;
+}
+
+#if SDMMC_FF_CACHE_SECTORS > 0
+static bool _cache_overlaps(BYTE slot, DWORD sector, UINT count)
+{
+	return cache.state != CACHE_EMPTY && cache.slot == slot
+	    && sector < cache.start + cache.count
+	    && sector + count > cache.start;
+}
+
+/**
+ * \brief Issue the coalesced writes, if any.
+ */
+static DRESULT _cache_flush(void)
+{
+#if !_FS_READONLY
+	sSdCard *lib = NULL;
+	DRESULT res;
+
+	if (cache.state != CACHE_WRITE)
+		return RES_OK;
+	cache.state = CACHE_EMPTY;
+	if (!SD_GetInstance(cache.slot, &lib))
+		return RES_PARERR;
+	res = _write_sectors(lib, cache_buf, cache.start, cache.count);
+	if (res != RES_OK)
+		trace_error("sdmmc_ff: failed to write back sectors %lu-%lu\n\r",
+		    cache.start, cache.start + cache.count - 1);
+	return res;
+#else
+	return RES_OK;
+#endif
+}
+
+/**
+ * \brief Drop the cached sectors of a drive, writing back pending writes.
+ */
+static DRESULT _cache_invalidate(BYTE slot)
+{
+	DRESULT res = RES_OK;
+
+	if (cache.slot == slot) {
+		res = _cache_flush();
+		cache.state = CACHE_EMPTY;
+	}
+	if (cache.next_slot == slot)
+		cache.next_slot = 0xff;
+	return res;
+}
+#endif /* SDMMC_FF_CACHE_SECTORS */
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -77,6 +256,9 @@ DSTATUS disk_initialize(BYTE slot)
 	if (!SD_GetInstance(slot, &lib))
 		return STA_NOINIT;
 	assert(lib);
+#if SDMMC_FF_CACHE_SECTORS > 0
+	_cache_invalidate(slot);
+#endif
 	rc = SD_GetStatus(lib);
 	if (rc == SDMMC_NOT_SUPPORTED)
 		return STA_NODISK | STA_NOINIT;
@@ -111,6 +293,11 @@ DSTATUS disk_status(BYTE slot)
 
 /**
  * \brief Read Sector(s).
+ *
+ * Small reads continuing the previous read request are taken as a sequential
+ * stream: SDMMC_FF_CACHE_SECTORS sectors are then read at once, and the
+ * following requests are served from the cache.
+ *
  * \param slot  Physical drive number (0..).
  * \param buff  Data buffer to store read data.
  * \param sector  Sector address in LBA.
@@ -120,39 +307,56 @@ DSTATUS disk_status(BYTE slot)
 DRESULT disk_read(BYTE slot, BYTE* buff, DWORD sector, UINT count)
 {
 	sSdCard *lib = NULL;
+#if SDMMC_FF_CACHE_SECTORS > 0
 	DRESULT res;
-	uint32_t blk_size, addr = sector, len = count;
-	uint8_t rc;
+	uint32_t total;
+	bool sequential;
+#endif
 
 	if (!SD_GetInstance(slot, &lib))
 		return RES_PARERR;
 	assert(lib);
-	blk_size = SD_GetBlockSize(lib);
-	if (blk_size == 0)
-		return RES_NOTRDY;
-	if (blk_size < _MIN_SS) {
-		if (_MIN_SS % blk_size)
-			return RES_PARERR;
-		addr = sector * (_MIN_SS / blk_size);
-		len  = count * (_MIN_SS / blk_size);
+#if SDMMC_FF_CACHE_SECTORS > 0
+	sequential = cache.next_slot == slot && cache.next == sector;
+	cache.next_slot = slot;
+	cache.next = sector + count;
+
+	if (_cache_overlaps(slot, sector, count)) {
+		if (cache.state == CACHE_READ && sector >= cache.start
+		    && sector + count <= cache.start + cache.count) {
+			memcpy(buff, cache_buf + (sector - cache.start) * _MIN_SS,
+			    count * _MIN_SS);
+			return RES_OK;
+		}
+		/* Make the device up to date before reading it */
+		res = _cache_flush();
+		if (res != RES_OK)
+			return res;
 	}
-	if (count <= 1)
-		rc = SD_ReadBlocks(lib, addr, buff, len);
-	else
-		rc = SD_Read(lib, addr, buff, len, NULL, NULL);
-	if (rc == SDMMC_OK || rc == SDMMC_CHANGED)
-		res = RES_OK;
-	else if (rc == SDMMC_ERR_IO || rc == SDMMC_ERR_RESP || rc == SDMMC_ERR)
-		res = RES_ERROR;
-	else if (rc == SDMMC_NO_RESPONSE || rc == SDMMC_BUSY
-	    || rc == SDMMC_NOT_INITIALIZED || rc == SDMMC_LOCKED
-	    || rc == SDMMC_STATE || rc == SDMMC_USER_CANCEL)
-		res = RES_NOTRDY;
-	else if (rc == SDMMC_PARAM || rc == SDMMC_NOT_SUPPORTED)
-		res = RES_PARERR;
-	else
-		res = RES_ERROR;
-	return res;
+
+	if (!sequential || count >= SDMMC_FF_CACHE_SECTORS
+	    || cache.state == CACHE_WRITE)
+		return _read_sectors(lib, buff, sector, count);
+
+	/* Read ahead */
+	total = _get_sector_count(lib);
+	if (sector + count > total)
+		return RES_PARERR;
+	cache.state = CACHE_EMPTY;
+	cache.slot = slot;
+	cache.start = sector;
+	cache.count = total - sector;
+	if (cache.count > SDMMC_FF_CACHE_SECTORS)
+		cache.count = SDMMC_FF_CACHE_SECTORS;
+	res = _read_sectors(lib, cache_buf, cache.start, cache.count);
+	if (res != RES_OK)
+		return res;
+	cache.state = CACHE_READ;
+	memcpy(buff, cache_buf, count * _MIN_SS);
+	return RES_OK;
+#else
+	return _read_sectors(lib, buff, sector, count);
+#endif
 }
 
 #if !_FS_READONLY
@@ -170,41 +374,57 @@ DRESULT disk_read(BYTE slot, BYTE* buff, DWORD sector, UINT count)
  * the multiple sector transfer properly. Do not translate it into
  * multiple single sector transfers to the media, or the data read/write
  * performance may be drastically decreased.
+ * Small writes to consecutive sectors are coalesced in the sector cache, and
+ * issued as one multiple-block write when the run ends, when the cache is
+ * full, or upon CTRL_SYNC.
  */
 DRESULT disk_write(BYTE slot, const BYTE* buff, DWORD sector, UINT count)
 {
 	sSdCard *lib = NULL;
+#if SDMMC_FF_CACHE_SECTORS > 0
 	DRESULT res;
-	uint32_t blk_size, addr = sector, len = count;
-	uint8_t rc;
+#endif
 
 	if (!SD_GetInstance(slot, &lib))
 		return RES_PARERR;
 	assert(lib);
-	blk_size = SD_GetBlockSize(lib);
-	if (blk_size < _MIN_SS) {
-		if (_MIN_SS % blk_size)
-			return RES_PARERR;
-		addr = sector * (_MIN_SS / blk_size);
-		len  = count * (_MIN_SS / blk_size);
+#if SDMMC_FF_CACHE_SECTORS > 0
+	if (cache.state == CACHE_WRITE && cache.slot == slot) {
+		/* Rewrite of a pending sector, or continuation of the run */
+		if (sector >= cache.start && sector + count
+		    <= cache.start + SDMMC_FF_CACHE_SECTORS
+		    && sector <= cache.start + cache.count) {
+			memcpy(cache_buf + (sector - cache.start) * _MIN_SS, buff,
+			    count * _MIN_SS);
+			if (sector + count > cache.start + cache.count)
+				cache.count = sector + count - cache.start;
+			return RES_OK;
+		}
 	}
-	if (count <= 1)
-		rc = SD_WriteBlocks(lib, addr, buff, len);
-	else
-		rc = SD_Write(lib, addr, buff, len, NULL, NULL);
-	if (rc == SDMMC_OK || rc == SDMMC_CHANGED)
-		res = RES_OK;
-	else if (rc == SDMMC_ERR_IO || rc == SDMMC_ERR_RESP || rc == SDMMC_ERR)
-		res = RES_ERROR;
-	else if (rc == SDMMC_NO_RESPONSE || rc == SDMMC_BUSY
-	    || rc == SDMMC_NOT_INITIALIZED || rc == SDMMC_LOCKED
-	    || rc == SDMMC_STATE || rc == SDMMC_USER_CANCEL)
-		res = RES_NOTRDY;
-	else if (rc == SDMMC_PARAM || rc == SDMMC_NOT_SUPPORTED)
-		res = RES_PARERR;
-	else
-		res = RES_ERROR;
-	return res;
+	if (cache.state == CACHE_WRITE) {
+		res = _cache_flush();
+		if (res != RES_OK)
+			return res;
+	} else if (_cache_overlaps(slot, sector, count)) {
+		cache.state = CACHE_EMPTY;
+	}
+
+	if (count >= SDMMC_FF_CACHE_SECTORS)
+		return _write_sectors(lib, buff, sector, count);
+
+	if (sector + count > _get_sector_count(lib))
+		return RES_PARERR;
+	if (cache.state == CACHE_READ)
+		cache.state = CACHE_EMPTY;
+	memcpy(cache_buf, buff, count * _MIN_SS);
+	cache.slot = slot;
+	cache.start = sector;
+	cache.count = count;
+	cache.state = CACHE_WRITE;
+	return RES_OK;
+#else
+	return _write_sectors(lib, buff, sector, count);
+#endif
 }
 #endif /* _FS_READONLY */
 
@@ -221,7 +441,7 @@ DRESULT disk_ioctl(BYTE slot, BYTE cmd, void* buff)
 	DRESULT res;
 	DWORD *param_u32 = (DWORD *)buff;
 	WORD *param_u16 = (WORD *)buff;
-	uint32_t blk_size, blk_count;
+	uint32_t blk_size;
 
 	if (!SD_GetInstance(slot, &lib))
 		return RES_PARERR;
@@ -230,27 +450,27 @@ DRESULT disk_ioctl(BYTE slot, BYTE cmd, void* buff)
 	{
 	case CTRL_SYNC:
 		/* SD/MMC devices do not seem to cache data beyond completion
-		 * of the write commands. Note that if _FS_READONLY is enabled,
-		 * this command is not needed. */
+		 * of the write commands, only the writes coalesced by this
+		 * layer have to be issued. Note that if _FS_READONLY is
+		 * enabled, this command is not needed. */
+#if SDMMC_FF_CACHE_SECTORS > 0
+		res = cache.slot == slot ? _cache_flush() : RES_OK;
+#else
 		res = RES_OK;
+#endif
 		break;
 
 	case GET_SECTOR_COUNT:
 		if (!buff)
 			return RES_PARERR;
 		blk_size = SD_GetBlockSize(lib);
-		blk_count = SD_GetNumberBlocks(lib);
-		if (blk_size < _MIN_SS)
-		{
-			if (_MIN_SS % blk_size)
-				return RES_PARERR;
-			*param_u32 = blk_count / (_MIN_SS / blk_size);
-		}
-		else
-			*param_u32 = blk_count;
+		if (blk_size == 0)
+			return RES_NOTRDY;
+		if (blk_size < _MIN_SS && (_MIN_SS % blk_size))
+			return RES_PARERR;
+		*param_u32 = _get_sector_count(lib);
 		res = RES_OK;
 		break;
-
 	case GET_SECTOR_SIZE:
 		/* Note that if _MAX_SS equals _MIN_SS i.e. the drive does not
 		 * have to support several sector sizes, this command is not
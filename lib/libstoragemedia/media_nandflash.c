@@ -0,0 +1,999 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file */
+
+/*---------------------------------------------------------------------------
+ *         Headers
+ *---------------------------------------------------------------------------*/
+
+#include "trace.h"
+
+#include "media.h"
+#include "media_nandflash.h"
+#include "media_private.h"
+
+#include "nvm/nand/nand_flash_ecc.h"
+#include "nvm/nand/nand_flash_skip_block.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+/*---------------------------------------------------------------------------
+ *         Local definitions
+ *---------------------------------------------------------------------------*/
+
+/** Unmapped logical page */
+#define FTL_NO_PAGE 0xffffffffu
+
+/** No block */
+#define FTL_NO_BLOCK 0xffff
+
+/** Block states */
+#define FTL_BLOCK_FREE 0
+#define FTL_BLOCK_USED 1
+#define FTL_BLOCK_BAD  2
+
+/** Start background garbage collection below this number of free blocks */
+#define FTL_GC_SOFT_THRESHOLD 4
+
+/** Run garbage collection before writing below this number of free blocks */
+#define FTL_GC_HARD_THRESHOLD 2
+
+/** Number of erases between two static wear leveling checks */
+#define FTL_WL_PERIOD 64
+
+/** Erase count difference triggering the move of cold data */
+#define FTL_WL_THRESHOLD 64
+
+/** Logical page of the page programmed after each erase to record the
+ * erase count of free blocks */
+#define FTL_ERASE_MARK 0xfffffffeu
+
+/** Copies of the meta data in the spare area */
+#define FTL_META_COPIES 2
+
+/** Results of _read_meta() */
+#define FTL_META_VALID   0
+#define FTL_META_ERASED  1
+#define FTL_META_CORRUPT 2
+
+/*---------------------------------------------------------------------------
+ *         Local types
+ *---------------------------------------------------------------------------*/
+
+/** Meta data stored in the spare area of each page. The spare area past
+ * the ECC bytes is not covered by the PMECC, so each page holds
+ * FTL_META_COPIES copies, each one protected by a CRC-32. */
+struct _ftl_meta {
+	uint32_t lpage;        /**< Logical page, or FTL_ERASE_MARK */
+	uint32_t seq;          /**< Write sequence number */
+	uint16_t erase_count;  /**< Erase count of the block */
+	uint16_t reserved;     /**< 0xffff */
+	uint32_t crc;          /**< CRC-32 of the above */
+};
+
+/*---------------------------------------------------------------------------
+ *         Local functions
+ *---------------------------------------------------------------------------*/
+
+/**
+ * \brief CRC-32 (IEEE 802.3) of the meta data, crc field excluded.
+ */
+static uint32_t _meta_crc(const struct _ftl_meta *meta)
+{
+	const uint8_t *p = (const uint8_t *)meta;
+	uint32_t crc = 0xffffffffu;
+	uint32_t i;
+	int bit;
+
+	for (i = 0; i < offsetof(struct _ftl_meta, crc); i++) {
+		crc ^= p[i];
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xedb88320u & -(crc & 1));
+	}
+	return ~crc;
+}
+
+static inline uint16_t _ppage_block(struct _nand_ftl *ftl, uint32_t ppage)
+{
+	return ppage / ftl->pages_per_block;
+}
+
+static inline uint16_t _ppage_page(struct _nand_ftl *ftl, uint32_t ppage)
+{
+	return ppage % ftl->pages_per_block;
+}
+
+/**
+ * \brief Read the meta data of a physical page. The first copy with a valid
+ * CRC is returned. When a copy is damaged but another one is valid, the block
+ * is scheduled for garbage collection so that the page gets rewritten.
+ * \return FTL_META_VALID, FTL_META_ERASED if the page has not been
+ * programmed, or FTL_META_CORRUPT if no copy is valid.
+ */
+static uint8_t _read_meta(struct _nand_ftl *ftl, uint16_t block, uint16_t page,
+		struct _ftl_meta *meta)
+{
+	struct _ftl_meta copies[FTL_META_COPIES];
+	const uint8_t *raw = (const uint8_t *)copies;
+	uint32_t i;
+
+	if (nand_ecc_read_meta(ftl->nand, ftl->first_block + block, page,
+			copies, sizeof(copies)))
+		return FTL_META_CORRUPT;
+
+	for (i = 0; i < FTL_META_COPIES; i++) {
+		if (copies[i].crc != _meta_crc(&copies[i]))
+			continue;
+		*meta = copies[i];
+		if (i > 0) {
+			ftl->stats.meta_repaired++;
+			if (ftl->refresh == FTL_NO_BLOCK)
+				ftl->refresh = block;
+		}
+		return FTL_META_VALID;
+	}
+
+	for (i = 0; i < sizeof(copies); i++) {
+		if (raw[i] != 0xff)
+			return FTL_META_CORRUPT;
+	}
+	return FTL_META_ERASED;
+}
+
+/**
+ * \brief Program a physical page with all the copies of its meta data.
+ */
+static uint8_t _write_meta(struct _nand_ftl *ftl, uint16_t block, uint16_t page,
+		uint8_t *buffer, uint32_t lpage)
+{
+	struct _ftl_meta copies[FTL_META_COPIES];
+	uint32_t i;
+
+	copies[0].lpage = lpage;
+	copies[0].seq = ++ftl->seq;
+	copies[0].erase_count = ftl->blocks[block].erase_count;
+	copies[0].reserved = 0xffff;
+	copies[0].crc = _meta_crc(&copies[0]);
+	for (i = 1; i < FTL_META_COPIES; i++)
+		copies[i] = copies[0];
+
+	return nand_ecc_write_page_meta(ftl->nand, ftl->first_block + block,
+			page, buffer, copies, sizeof(copies));
+}
+
+/**
+ * \brief Read the data of a physical page.
+ */
+static uint8_t _read_page(struct _nand_ftl *ftl, uint32_t ppage,
+		uint8_t *buffer)
+{
+	return nand_ecc_read_page(ftl->nand,
+			ftl->first_block + _ppage_block(ftl, ppage),
+			_ppage_page(ftl, ppage), buffer, NULL);
+}
+
+/**
+ * \brief Update the erase count statistics.
+ */
+static void _update_erase_stats(struct _nand_ftl *ftl)
+{
+	uint16_t b, min = 0xffff, max = 0;
+
+	for (b = 0; b < ftl->num_blocks; b++) {
+		if (ftl->blocks[b].state == FTL_BLOCK_BAD)
+			continue;
+		if (ftl->blocks[b].erase_count < min)
+			min = ftl->blocks[b].erase_count;
+		if (ftl->blocks[b].erase_count > max)
+			max = ftl->blocks[b].erase_count;
+	}
+	ftl->stats.erase_count_min = min;
+	ftl->stats.erase_count_max = max;
+}
+
+/**
+ * \brief Mark a block as bad and stop using it.
+ */
+static void _retire_block(struct _nand_ftl *ftl, uint16_t block)
+{
+	trace_warning("media_nandflash: retiring block %u\r\n",
+			ftl->first_block + block);
+
+	if (ftl->blocks[block].state == FTL_BLOCK_FREE)
+		ftl->free_blocks--;
+	ftl->blocks[block].state = FTL_BLOCK_BAD;
+	ftl->blocks[block].valid = 0;
+	ftl->stats.bad_blocks++;
+	if (ftl->active == block)
+		ftl->active = FTL_NO_BLOCK;
+
+	nand_skipblock_tag_block(ftl->nand, ftl->first_block + block, true);
+}
+
+/**
+ * \brief Erase a block and return it to the free pool.
+ * \return 0 if successful, the NAND error code if the block went bad.
+ */
+static uint8_t _erase_block(struct _nand_ftl *ftl, uint16_t block)
+{
+	uint8_t error;
+
+	error = nand_raw_erase_block(ftl->nand, ftl->first_block + block);
+	if (error) {
+		_retire_block(ftl, block);
+		return error;
+	}
+
+	ftl->blocks[block].erase_count++;
+	ftl->blocks[block].valid = 0;
+	ftl->blocks[block].written = 0;
+	ftl->stats.erases++;
+	ftl->wl_erases++;
+
+	/* Record the erase count in the first page, free blocks have no other
+	 * meta data. The page content is never read back, any buffer does. */
+	error = _write_meta(ftl, block, 0, ftl->gc_buffer, FTL_ERASE_MARK);
+	if (error) {
+		_retire_block(ftl, block);
+		return error;
+	}
+	ftl->blocks[block].written = 1;
+
+	if (ftl->blocks[block].state != FTL_BLOCK_FREE)
+		ftl->free_blocks++;
+	ftl->blocks[block].state = FTL_BLOCK_FREE;
+
+	if (ftl->blocks[block].erase_count > ftl->stats.erase_count_max)
+		ftl->stats.erase_count_max = ftl->blocks[block].erase_count;
+	return 0;
+}
+
+static uint8_t _collect_block(struct _nand_ftl *ftl, uint16_t victim);
+
+/**
+ * \brief Select the block receiving the next pages: the free block with the
+ * lowest erase count (dynamic wear leveling).
+ * \return 0 if successful, 1 if no free block is left.
+ */
+static uint8_t _open_block(struct _nand_ftl *ftl)
+{
+	uint16_t b, best = FTL_NO_BLOCK;
+
+	for (b = 0; b < ftl->num_blocks; b++) {
+		if (ftl->blocks[b].state != FTL_BLOCK_FREE)
+			continue;
+		if (best == FTL_NO_BLOCK ||
+		    ftl->blocks[b].erase_count < ftl->blocks[best].erase_count)
+			best = b;
+	}
+	if (best == FTL_NO_BLOCK)
+		return 1;
+
+	/* written is left after the erase mark, if any */
+	ftl->blocks[best].state = FTL_BLOCK_USED;
+	ftl->blocks[best].valid = 0;
+	ftl->free_blocks--;
+	ftl->active = best;
+	return 0;
+}
+
+/**
+ * \brief Select the block to reclaim.
+ *
+ * Every FTL_WL_PERIOD erases, if the erase counts have drifted by more than
+ * FTL_WL_THRESHOLD, the least erased used block is selected so that its
+ * (cold) data moves and the block returns to the pool (static wear leveling).
+ * Otherwise the used block with the fewest valid pages is selected.
+ * \return The victim block, or FTL_NO_BLOCK if no block can be reclaimed.
+ */
+static uint16_t _select_victim(struct _nand_ftl *ftl)
+{
+	uint16_t b, victim = FTL_NO_BLOCK;
+
+	if (ftl->wl_erases >= FTL_WL_PERIOD) {
+		uint16_t cold = FTL_NO_BLOCK;
+
+		ftl->wl_erases = 0;
+		_update_erase_stats(ftl);
+		for (b = 0; b < ftl->num_blocks; b++) {
+			if (ftl->blocks[b].state != FTL_BLOCK_USED || b == ftl->active)
+				continue;
+			if (cold == FTL_NO_BLOCK ||
+			    ftl->blocks[b].erase_count < ftl->blocks[cold].erase_count)
+				cold = b;
+		}
+		if (cold != FTL_NO_BLOCK &&
+		    ftl->stats.erase_count_max - ftl->blocks[cold].erase_count > FTL_WL_THRESHOLD)
+			return cold;
+	}
+
+	for (b = 0; b < ftl->num_blocks; b++) {
+		if (ftl->blocks[b].state != FTL_BLOCK_USED || b == ftl->active)
+			continue;
+		if (victim == FTL_NO_BLOCK ||
+		    ftl->blocks[b].valid < ftl->blocks[victim].valid)
+			victim = b;
+	}
+
+	/* Nothing to gain from a block full of valid pages (but the erase
+	 * mark) */
+	if (victim != FTL_NO_BLOCK &&
+	    ftl->blocks[victim].valid >= ftl->pages_per_block - 1)
+		return FTL_NO_BLOCK;
+
+	return victim;
+}
+
+/**
+ * \brief Program a logical page at the end of the log.
+ * \param ftl  Pointer to the FTL instance.
+ * \param lpage  Logical page.
+ * \param buffer  Page data.
+ * \return 0 if successful; otherwise returns 1.
+ */
+static uint8_t _program_page(struct _nand_ftl *ftl, uint32_t lpage,
+		uint8_t *buffer)
+{
+	uint32_t ppage, old;
+	uint16_t block, page;
+
+	for (;;) {
+		if (ftl->active == FTL_NO_BLOCK ||
+		    ftl->blocks[ftl->active].written == ftl->pages_per_block) {
+			/* Reclaim blocks before taking the last free ones, they
+			 * are kept for the garbage collector */
+			while (!ftl->in_gc &&
+			       ftl->free_blocks <= FTL_GC_HARD_THRESHOLD) {
+				uint16_t victim = _select_victim(ftl);
+				if (victim == FTL_NO_BLOCK)
+					break;
+				_collect_block(ftl, victim);
+			}
+			if (ftl->active == FTL_NO_BLOCK ||
+			    ftl->blocks[ftl->active].written == ftl->pages_per_block) {
+				if (_open_block(ftl)) {
+					trace_error("media_nandflash: no free block\r\n");
+					return 1;
+				}
+			}
+		}
+
+		block = ftl->active;
+		page = ftl->blocks[block].written++;
+
+		if (!_write_meta(ftl, block, page, buffer, lpage))
+			break;
+
+		/* Program failure: move the valid pages of the block away
+		 * and retire it, then retry in another block */
+		ftl->active = FTL_NO_BLOCK;
+		ftl->blocks[block].written = ftl->pages_per_block;
+		if (!_collect_block(ftl, block))
+			_retire_block(ftl, block);
+	}
+
+	ppage = block * ftl->pages_per_block + page;
+	old = ftl->map[lpage];
+	if (old != FTL_NO_PAGE)
+		ftl->blocks[_ppage_block(ftl, old)].valid--;
+	ftl->map[lpage] = ppage;
+	ftl->blocks[block].valid++;
+
+	ftl->stats.pages_written++;
+	if (ftl->in_gc)
+		ftl->stats.gc_pages_written++;
+	return 0;
+}
+
+/**
+ * \brief Move the valid pages of a block to the end of the log and erase it.
+ * \param ftl  Pointer to the FTL instance.
+ * \param victim  Block to reclaim.
+ * \return 0 if successful; otherwise returns 1.
+ */
+static uint8_t _collect_block(struct _nand_ftl *ftl, uint16_t victim)
+{
+	struct _ftl_meta meta;
+	uint16_t page;
+	uint8_t error = 0;
+	bool nested = ftl->in_gc;
+
+	ftl->in_gc = true;
+
+	for (page = 0; page < ftl->blocks[victim].written &&
+	               ftl->blocks[victim].valid > 0; page++) {
+		uint32_t ppage = victim * ftl->pages_per_block + page;
+
+		if (_read_meta(ftl, victim, page, &meta) != FTL_META_VALID)
+			continue;
+		if (meta.lpage >= ftl->num_lpages || ftl->map[meta.lpage] != ppage)
+			continue;
+
+		if (_read_page(ftl, ppage, ftl->gc_buffer)) {
+			trace_error("media_nandflash: cannot read page %u of block %u\r\n",
+					page, ftl->first_block + victim);
+			error = 1;
+			continue;
+		}
+		if (_program_page(ftl, meta.lpage, ftl->gc_buffer)) {
+			error = 1;
+			break;
+		}
+	}
+
+	ftl->in_gc = nested;
+
+	/* Keep the block if some data could not be moved */
+	if (error)
+		return error;
+
+	if (ftl->refresh == victim)
+		ftl->refresh = FTL_NO_BLOCK;
+	if (ftl->active == victim)
+		ftl->active = FTL_NO_BLOCK;
+	return _erase_block(ftl, victim);
+}
+
+/**
+ * \brief Find a logical page in the cache.
+ * \return Cache entry, or NULL if not cached.
+ */
+static struct _nand_ftl_cache *_cache_lookup(struct _nand_ftl *ftl,
+		uint32_t lpage)
+{
+	int i;
+
+	for (i = 0; i < MEDIA_NANDFLASH_CACHE_PAGES; i++) {
+		struct _nand_ftl_cache *entry = &ftl->cache[i];
+		if (entry->valid && entry->lpage == lpage) {
+			entry->stamp = ++ftl->stamp;
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * \brief Write back a cache entry if it is dirty.
+ */
+static uint8_t _cache_clean(struct _nand_ftl *ftl, struct _nand_ftl_cache *entry)
+{
+	if (!entry->valid || !entry->dirty)
+		return 0;
+	if (_program_page(ftl, entry->lpage, entry->buffer))
+		return 1;
+	entry->dirty = false;
+	return 0;
+}
+
+/**
+ * \brief Get a cache entry for a logical page, evicting the least recently
+ * used one if needed.
+ * \param ftl  Pointer to the FTL instance.
+ * \param lpage  Logical page.
+ * \param fill  Load the current content of the page.
+ * \return Cache entry, or NULL on error.
+ */
+static struct _nand_ftl_cache *_cache_get(struct _nand_ftl *ftl,
+		uint32_t lpage, bool fill)
+{
+	struct _nand_ftl_cache *entry;
+	int i;
+
+	entry = _cache_lookup(ftl, lpage);
+	if (entry) {
+		ftl->stats.cache_hits++;
+		return entry;
+	}
+	ftl->stats.cache_misses++;
+
+	entry = &ftl->cache[0];
+	for (i = 1; i < MEDIA_NANDFLASH_CACHE_PAGES; i++) {
+		if (!entry->valid)
+			break;
+		if (!ftl->cache[i].valid || ftl->cache[i].stamp < entry->stamp)
+			entry = &ftl->cache[i];
+	}
+	if (_cache_clean(ftl, entry))
+		return NULL;
+
+	entry->valid = false;
+	if (fill) {
+		if (ftl->map[lpage] == FTL_NO_PAGE)
+			memset(entry->buffer, 0xff, ftl->sectors_per_page * MEDIA_NANDFLASH_SECTOR_SIZE);
+		else if (_read_page(ftl, ftl->map[lpage], entry->buffer))
+			return NULL;
+	}
+	entry->lpage = lpage;
+	entry->stamp = ++ftl->stamp;
+	entry->dirty = false;
+	entry->valid = true;
+	return entry;
+}
+
+/**
+ * \brief Rebuild the mapping table from the meta data of the pages.
+ *
+ * A page whose meta data is damaged in all its copies is only accepted at
+ * the end of the programmed pages of a block, where it comes from a program
+ * or erase interrupted by a reset. Anywhere else, it may hold the most recent
+ * copy of a logical page: the mount fails rather than silently falling back
+ * to an older copy.
+ * \return 0 if successful; otherwise returns 1.
+ */
+static uint8_t _mount(struct _nand_ftl *ftl)
+{
+	struct _ftl_meta meta, other;
+	uint32_t erase_sum = 0, lpage;
+	uint32_t active_seq = 0;
+	uint16_t b, page, known_blocks = 0;
+
+	memset(ftl->map, 0xff, ftl->num_lpages * sizeof(uint32_t));
+	ftl->seq = 0;
+	ftl->active = FTL_NO_BLOCK;
+	ftl->refresh = FTL_NO_BLOCK;
+	ftl->free_blocks = 0;
+
+	for (b = 0; b < ftl->num_blocks; b++) {
+		struct _nand_ftl_block *blk = &ftl->blocks[b];
+		uint32_t block_seq = 0;
+		uint16_t corrupt = FTL_NO_BLOCK;
+		bool marked = false, known = false;
+
+		memset(blk, 0, sizeof(*blk));
+		if (nand_skipblock_check_block(ftl->nand, ftl->first_block + b) != GOODBLOCK) {
+			blk->state = FTL_BLOCK_BAD;
+			ftl->stats.bad_blocks++;
+			continue;
+		}
+
+		/* Pages are programmed in order, stop at the first erased one */
+		for (page = 0; page < ftl->pages_per_block; page++) {
+			uint32_t ppage = b * ftl->pages_per_block + page;
+			uint8_t rc = _read_meta(ftl, b, page, &meta);
+
+			if (rc == FTL_META_ERASED)
+				break;
+			if (rc == FTL_META_CORRUPT) {
+				if (corrupt == FTL_NO_BLOCK)
+					corrupt = page;
+				continue;
+			}
+			if (corrupt != FTL_NO_BLOCK) {
+				trace_error("media_nandflash: corrupted meta data at B%u.P%u\r\n",
+						(unsigned)(ftl->first_block + b),
+						(unsigned)corrupt);
+				return 1;
+			}
+
+			if (!known) {
+				blk->erase_count = meta.erase_count;
+				known = true;
+			}
+			if (meta.seq > ftl->seq)
+				ftl->seq = meta.seq;
+			if (meta.seq > block_seq)
+				block_seq = meta.seq;
+			if (page == 0 && meta.lpage == FTL_ERASE_MARK)
+				marked = true;
+			if (meta.lpage >= ftl->num_lpages)
+				continue;
+
+			/* Keep the most recent copy of each logical page */
+			if (ftl->map[meta.lpage] != FTL_NO_PAGE) {
+				uint32_t old = ftl->map[meta.lpage];
+				if (_read_meta(ftl, _ppage_block(ftl, old),
+				               _ppage_page(ftl, old), &other) == FTL_META_VALID &&
+				    other.seq > meta.seq)
+					continue;
+			}
+			ftl->map[meta.lpage] = ppage;
+		}
+		blk->written = page;
+
+		if (page == 0 || (page == 1 && marked)) {
+			blk->state = FTL_BLOCK_FREE;
+			ftl->free_blocks++;
+		} else {
+			blk->state = FTL_BLOCK_USED;
+			/* Resume writing in the last block being filled, unless
+			 * it ends with an interrupted program */
+			if (page < ftl->pages_per_block && block_seq > active_seq &&
+			    corrupt == FTL_NO_BLOCK) {
+				active_seq = block_seq;
+				ftl->active = b;
+			}
+		}
+		/* valid is rebuilt below, meanwhile it flags the blocks
+		 * whose erase count is unknown */
+		if (known) {
+			erase_sum += blk->erase_count;
+			known_blocks++;
+		} else {
+			blk->valid = 1;
+		}
+	}
+
+	/* Other partially written blocks are left to the garbage collector */
+	for (b = 0; b < ftl->num_blocks; b++) {
+		if (ftl->blocks[b].state == FTL_BLOCK_USED && b != ftl->active)
+			ftl->blocks[b].written = ftl->pages_per_block;
+	}
+
+	/* Blocks without erase count (never erased by the FTL, or damaged
+	 * meta data) get the average */
+	for (b = 0; b < ftl->num_blocks; b++) {
+		if (ftl->blocks[b].state == FTL_BLOCK_BAD)
+			continue;
+		if (ftl->blocks[b].valid && known_blocks)
+			ftl->blocks[b].erase_count = erase_sum / known_blocks;
+		ftl->blocks[b].valid = 0;
+	}
+
+	for (lpage = 0; lpage < ftl->num_lpages; lpage++) {
+		if (ftl->map[lpage] != FTL_NO_PAGE)
+			ftl->blocks[_ppage_block(ftl, ftl->map[lpage])].valid++;
+	}
+
+	_update_erase_stats(ftl);
+	return 0;
+}
+
+/**
+ * \brief Reads sectors from the NAND flash media.
+ * \param media Pointer to a Media instance
+ * \param address First sector to read
+ * \param data Pointer to the buffer in which to store the retrieved data
+ * \param length Number of sectors to read
+ * \param callback Optional pointer to a callback function to invoke when
+ *                 the operation is finished
+ * \param callback_arg Optional pointer to an argument for the callback
+ * \return Operation result code
+ */
+static uint8_t media_nandflash_read(struct _media *media,
+		uint32_t address, void *data, uint32_t length,
+		media_callback_t callback, void *callback_arg)
+{
+	struct _nand_ftl *ftl = (struct _nand_ftl *)media->interface;
+	uint8_t *dest = (uint8_t*)data;
+	uint8_t status = MEDIA_STATUS_SUCCESS;
+
+	if (media->state != MEDIA_STATE_READY)
+		return MEDIA_STATUS_BUSY;
+
+	if ((address + length) > media->size)
+		return MEDIA_STATUS_ERROR;
+
+	media->state = MEDIA_STATE_BUSY;
+
+	while (length > 0) {
+		uint32_t lpage = address / ftl->sectors_per_page;
+		uint32_t first = address % ftl->sectors_per_page;
+		uint32_t count = ftl->sectors_per_page - first;
+		struct _nand_ftl_cache *entry;
+		uint8_t *source;
+
+		if (count > length)
+			count = length;
+
+		entry = _cache_lookup(ftl, lpage);
+		if (entry) {
+			ftl->stats.cache_hits++;
+			source = entry->buffer;
+		} else if (ftl->map[lpage] == FTL_NO_PAGE) {
+			memset(dest, 0xff, count * MEDIA_NANDFLASH_SECTOR_SIZE);
+			source = NULL;
+		} else if (count < ftl->sectors_per_page) {
+			/* Partial page reads are usually metadata (FAT, directory),
+			 * keep them in the cache */
+			entry = _cache_get(ftl, lpage, true);
+			if (!entry) {
+				status = MEDIA_STATUS_ERROR;
+				break;
+			}
+			source = entry->buffer;
+		} else {
+			ftl->stats.cache_misses++;
+			if (_read_page(ftl, ftl->map[lpage], ftl->gc_buffer)) {
+				status = MEDIA_STATUS_ERROR;
+				break;
+			}
+			source = ftl->gc_buffer;
+		}
+
+		if (source)
+			memcpy(dest, source + first * MEDIA_NANDFLASH_SECTOR_SIZE,
+					count * MEDIA_NANDFLASH_SECTOR_SIZE);
+
+		ftl->stats.sectors_read += count;
+		dest += count * MEDIA_NANDFLASH_SECTOR_SIZE;
+		address += count;
+		length -= count;
+	}
+
+	media->state = MEDIA_STATE_READY;
+
+	if (callback)
+		callback(callback_arg, status, 0, 0);
+
+	return status;
+}
+
+/**
+ * \brief Writes sectors on the NAND flash media. The data goes through the
+ * write-back page cache, use media_flush() to commit it to the NAND.
+ * \param media Pointer to a Media instance
+ * \param address First sector to write
+ * \param data Pointer to the data to write
+ * \param length Number of sectors to write
+ * \param callback Optional pointer to a callback function to invoke when
+ *                 the write operation terminates
+ * \param callback_arg Optional argument for the callback function
+ * \return Operation result code
+ */
+static uint8_t media_nandflash_write(struct _media *media,
+		uint32_t address, void *data, uint32_t length,
+		media_callback_t callback, void *callback_arg)
+{
+	struct _nand_ftl *ftl = (struct _nand_ftl *)media->interface;
+	uint8_t *source = (uint8_t*)data;
+	uint8_t status = MEDIA_STATUS_SUCCESS;
+
+	if (media->state != MEDIA_STATE_READY)
+		return MEDIA_STATUS_BUSY;
+
+	if ((address + length) > media->size)
+		return MEDIA_STATUS_ERROR;
+
+	media->state = MEDIA_STATE_BUSY;
+
+	while (length > 0) {
+		uint32_t lpage = address / ftl->sectors_per_page;
+		uint32_t first = address % ftl->sectors_per_page;
+		uint32_t count = ftl->sectors_per_page - first;
+		struct _nand_ftl_cache *entry;
+
+		if (count > length)
+			count = length;
+
+		/* No need to read the page back if it is fully overwritten */
+		entry = _cache_get(ftl, lpage, count < ftl->sectors_per_page);
+		if (!entry) {
+			status = MEDIA_STATUS_ERROR;
+			break;
+		}
+
+		memcpy(entry->buffer + first * MEDIA_NANDFLASH_SECTOR_SIZE,
+				source, count * MEDIA_NANDFLASH_SECTOR_SIZE);
+		entry->dirty = true;
+
+		ftl->stats.sectors_written += count;
+		source += count * MEDIA_NANDFLASH_SECTOR_SIZE;
+		address += count;
+		length -= count;
+	}
+
+	media->state = MEDIA_STATE_READY;
+
+	if (callback)
+		callback(callback_arg, status, 0, 0);
+
+	return status;
+}
+
+/**
+ * \brief Writes back all the dirty pages of the cache.
+ * \param media Pointer to a Media instance
+ * \return Operation result code
+ */
+static uint8_t media_nandflash_flush(struct _media *media)
+{
+	struct _nand_ftl *ftl = (struct _nand_ftl *)media->interface;
+	uint8_t status = MEDIA_STATUS_SUCCESS;
+	int i;
+
+	if (media->state != MEDIA_STATE_READY)
+		return MEDIA_STATUS_BUSY;
+
+	media->state = MEDIA_STATE_BUSY;
+	for (i = 0; i < MEDIA_NANDFLASH_CACHE_PAGES; i++) {
+		if (_cache_clean(ftl, &ftl->cache[i]))
+			status = MEDIA_STATUS_ERROR;
+	}
+	media->state = MEDIA_STATE_READY;
+
+	return status;
+}
+
+/**
+ * \brief Background work: reclaim one block when free blocks get low.
+ * \param media Pointer to a Media instance
+ */
+static void media_nandflash_handler(struct _media *media)
+{
+	struct _nand_ftl *ftl = (struct _nand_ftl *)media->interface;
+	uint16_t victim;
+
+	if (media->state != MEDIA_STATE_READY)
+		return;
+	/* Rewrite first the block whose meta data has been repaired */
+	victim = ftl->refresh;
+	if (victim != FTL_NO_BLOCK &&
+	    (ftl->blocks[victim].state != FTL_BLOCK_USED || victim == ftl->active))
+		victim = FTL_NO_BLOCK;
+
+	if (victim == FTL_NO_BLOCK) {
+		if (ftl->free_blocks >= FTL_GC_SOFT_THRESHOLD &&
+		    ftl->wl_erases < FTL_WL_PERIOD)
+			return;
+		victim = _select_victim(ftl);
+	}
+	if (victim == FTL_NO_BLOCK)
+		return;
+
+	media->state = MEDIA_STATE_BUSY;
+	_collect_block(ftl, victim);
+	media->state = MEDIA_STATE_READY;
+}
+
+/*---------------------------------------------------------------------------
+ *      Exported Functions
+ *---------------------------------------------------------------------------*/
+
+/**
+ * \brief Initializes a media on a partition of a NAND flash and mounts the
+ * flash translation layer.
+ *
+ * The logical size of the media is the size of the partition minus a reserve
+ * of about 3% (plus a few blocks) used by the garbage collector and to
+ * replace blocks going bad.
+ *
+ * \param media Pointer to the Media instance to initialize
+ * \param ftl Pointer to the FTL instance
+ * \param nand Pointer to the NAND flash device, with its ECC configured
+ * \param first_block First block of the partition
+ * \param num_blocks Number of blocks of the partition
+ * \param map Mapping table, num_blocks * pages-per-block entries
+ * \param buffers Cache aligned buffer of MEDIA_NANDFLASH_BUFFER_SIZE() bytes
+ * \return 0 if successful; otherwise returns 1.
+ */
+uint8_t media_nandflash_initialize(struct _media *media,
+		struct _nand_ftl *ftl, struct _nand_flash *nand,
+		uint16_t first_block, uint16_t num_blocks,
+		uint32_t *map, uint8_t *buffers)
+{
+	uint32_t page_size = nand_model_get_page_data_size(&nand->model);
+	uint32_t buffer_size = page_size + nand_model_get_page_spare_size(&nand->model);
+	uint32_t meta_offset;
+	uint16_t reserved;
+	int i;
+
+	memset(media, 0, sizeof(*media));
+	memset(ftl, 0, sizeof(*ftl));
+
+	assert(num_blocks <= NAND_MAXNUM_BLOCKS);
+
+	if (nand_ecc_get_meta_area(nand, &meta_offset) <
+			FTL_META_COPIES * sizeof(struct _ftl_meta)) {
+		trace_error("media_nandflash: no room for meta data in spare\r\n");
+		return 1;
+	}
+
+	ftl->nand = nand;
+	ftl->first_block = first_block;
+	ftl->num_blocks = num_blocks;
+	ftl->pages_per_block = nand_model_get_block_size_in_pages(&nand->model);
+	ftl->sectors_per_page = page_size / MEDIA_NANDFLASH_SECTOR_SIZE;
+	ftl->map = map;
+
+	reserved = num_blocks / 32 + FTL_GC_SOFT_THRESHOLD + 2;
+	if (num_blocks <= reserved) {
+		trace_error("media_nandflash: partition too small\r\n");
+		return 1;
+	}
+	/* The first page of each block holds the erase mark */
+	ftl->num_lpages = (uint32_t)(num_blocks - reserved) * (ftl->pages_per_block - 1);
+
+	for (i = 0; i < MEDIA_NANDFLASH_CACHE_PAGES; i++)
+		ftl->cache[i].buffer = buffers + i * buffer_size;
+	ftl->gc_buffer = buffers + MEDIA_NANDFLASH_CACHE_PAGES * buffer_size;
+
+	if (_mount(ftl))
+		return 1;
+
+	media->write = media_nandflash_write;
+	media->read = media_nandflash_read;
+	media->flush = media_nandflash_flush;
+	media->handler = media_nandflash_handler;
+	media->interface = ftl;
+
+	media->block_size = MEDIA_NANDFLASH_SECTOR_SIZE;
+	media->base_address = 0;
+	media->size = ftl->num_lpages * ftl->sectors_per_page;
+
+	media->mapped_read = false;
+	media->mapped_write = false;
+	media->removable = false;
+	media->state = MEDIA_STATE_READY;
+
+	trace_info("media_nandflash: %u blocks (%u bad, %u free), %u sectors\r\n",
+			(unsigned)num_blocks, (unsigned)ftl->stats.bad_blocks,
+			(unsigned)ftl->free_blocks, (unsigned)media->size);
+	return 0;
+}
+
+/**
+ * \brief Erases all the good blocks of the partition, discarding its content.
+ * \param media Pointer to a Media instance
+ * \return Operation result code
+ */
+uint8_t media_nandflash_format(struct _media *media)
+{
+	struct _nand_ftl *ftl = (struct _nand_ftl *)media->interface;
+	uint16_t b;
+	int i;
+
+	if (media->state != MEDIA_STATE_READY)
+		return MEDIA_STATUS_BUSY;
+
+	media->state = MEDIA_STATE_BUSY;
+
+	for (i = 0; i < MEDIA_NANDFLASH_CACHE_PAGES; i++)
+		ftl->cache[i].valid = false;
+
+	ftl->active = FTL_NO_BLOCK;
+	ftl->refresh = FTL_NO_BLOCK;
+	ftl->seq = 0;
+	for (b = 0; b < ftl->num_blocks; b++) {
+		if (ftl->blocks[b].state != FTL_BLOCK_BAD)
+			_erase_block(ftl, b);
+	}
+	memset(ftl->map, 0xff, ftl->num_lpages * sizeof(uint32_t));
+
+	media->state = MEDIA_STATE_READY;
+	return MEDIA_STATUS_SUCCESS;
+}
+
+/**
+ * \brief Returns the FTL statistics. The write amplification is
+ * pages_written * sectors per page / sectors_written.
+ * \param media Pointer to a Media instance
+ * \param stats Pointer to the structure receiving the statistics
+ */
+void media_nandflash_get_stats(struct _media *media,
+		struct _nand_ftl_stats *stats)
+{
+	struct _nand_ftl *ftl = (struct _nand_ftl *)media->interface;
+
+	ftl->stats.free_blocks = ftl->free_blocks;
+	*stats = ftl->stats;
+}
@@ -0,0 +1,158 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ *  \file
+ *
+ *  \section Purpose
+ *
+ *  Media layer for NAND flash, through a flash translation layer (FTL).
+ *
+ *  The FTL exposes the NAND as an array of 512-byte sectors that can be
+ *  rewritten individually. Sectors are grouped in logical pages, which are
+ *  written in sequence in the NAND blocks (log-structured): rewriting a page
+ *  programs a new physical page and invalidates the previous one. Blocks
+ *  with few valid pages are reclaimed by a garbage collector, which runs
+ *  from media_handler() when the number of free blocks gets low, and
+ *  synchronously before a write when no free block is left.
+ *
+ *  The logical page of each physical page is stored in the spare area, next
+ *  to the ECC, so that the mapping can be rebuilt when the media is
+ *  initialized. This area is not covered by the ECC: it holds two copies of
+ *  the meta data, each one with a CRC-32 and the write sequence number. The
+ *  first page of each erased block records its erase count.
+ *
+ *  \section Usage
+ *  -# Initialize the NAND flash (nand_raw_initialize(), pmecc_initialize()...).
+ *  -# Call media_nandflash_initialize() with a struct _nand_ftl instance, a
+ *     mapping table and buffers for the page cache.
+ *  -# Call media_handler() periodically to run the background garbage
+ *     collection, and media_flush() to write back the page cache.
+ */
+
+#ifndef MEDIA_NANDFLASH_H
+#define MEDIA_NANDFLASH_H
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include "libstoragemedia/media.h"
+#include "nvm/nand/nand_flash.h"
+
+/*------------------------------------------------------------------------------
+ *      Definitions
+ *------------------------------------------------------------------------------*/
+
+/** Size of the sectors exposed by the media */
+#define MEDIA_NANDFLASH_SECTOR_SIZE 512
+
+/** Number of pages in the write-back cache */
+#define MEDIA_NANDFLASH_CACHE_PAGES 4
+
+/** Size of the buffer area to give to media_nandflash_initialize(): one
+ * buffer per cached page plus one for the garbage collector, each holding the
+ * page data and spare */
+#define MEDIA_NANDFLASH_BUFFER_SIZE(page_size, spare_size) \
+	((MEDIA_NANDFLASH_CACHE_PAGES + 1) * ((page_size) + (spare_size)))
+
+/*------------------------------------------------------------------------------
+ *      Types
+ *------------------------------------------------------------------------------*/
+
+/** FTL statistics */
+struct _nand_ftl_stats {
+	uint32_t sectors_written;  /**< Sectors written by the host */
+	uint32_t sectors_read;     /**< Sectors read by the host */
+	uint32_t pages_written;    /**< Pages programmed, host and GC */
+	uint32_t gc_pages_written; /**< Pages moved by the garbage collector */
+	uint32_t erases;           /**< Blocks erased */
+	uint32_t cache_hits;       /**< Accesses served by the page cache */
+	uint32_t cache_misses;     /**< Accesses that needed a NAND read */
+	uint32_t meta_repaired;    /**< Pages read from their second meta copy */
+	uint16_t bad_blocks;       /**< Bad blocks in the partition */
+	uint16_t free_blocks;      /**< Blocks currently erased */
+	uint16_t erase_count_min;  /**< Lowest erase count of the good blocks */
+	uint16_t erase_count_max;  /**< Highest erase count of the good blocks */
+};
+
+/** State of a NAND block */
+struct _nand_ftl_block {
+	uint16_t erase_count; /**< Number of erases */
+	uint16_t valid;       /**< Number of pages holding current data */
+	uint16_t written;     /**< Number of pages programmed since the erase */
+	uint8_t  state;       /**< Free, used or bad */
+};
+
+/** Page of the write-back cache */
+struct _nand_ftl_cache {
+	uint32_t lpage;  /**< Logical page held */
+	uint32_t stamp;  /**< Last access, for LRU replacement */
+	uint8_t *buffer; /**< Page data */
+	bool     valid;  /**< Buffer holds lpage */
+	bool     dirty;  /**< Buffer must be written back */
+};
+
+/** Flash translation layer instance */
+struct _nand_ftl {
+	struct _nand_flash *nand;   /**< NAND flash device */
+	uint16_t first_block;       /**< First block of the partition */
+	uint16_t num_blocks;        /**< Number of blocks in the partition */
+	uint16_t pages_per_block;   /**< Pages per block */
+	uint16_t sectors_per_page;  /**< Sectors per page */
+	uint32_t num_lpages;        /**< Number of logical pages */
+	uint32_t *map;              /**< Logical to physical page table */
+	uint32_t seq;               /**< Sequence number of the last page written */
+	uint16_t active;            /**< Block being filled */
+	uint16_t refresh;           /**< Block with repaired meta data to rewrite */
+	uint16_t free_blocks;       /**< Number of erased blocks */
+	uint16_t wl_erases;         /**< Erases since the last wear leveling check */
+	bool     in_gc;             /**< Garbage collection in progress */
+	uint8_t *gc_buffer;         /**< Page buffer of the garbage collector */
+	uint32_t stamp;             /**< Cache access counter */
+	struct _nand_ftl_cache cache[MEDIA_NANDFLASH_CACHE_PAGES];
+	struct _nand_ftl_block blocks[NAND_MAXNUM_BLOCKS];
+	struct _nand_ftl_stats stats;
+};
+
+/*------------------------------------------------------------------------------
+ *      Exported functions
+ *------------------------------------------------------------------------------*/
+
+extern uint8_t media_nandflash_initialize(struct _media *media,
+		struct _nand_ftl *ftl, struct _nand_flash *nand,
+		uint16_t first_block, uint16_t num_blocks,
+		uint32_t *map, uint8_t *buffers);
+
+extern uint8_t media_nandflash_format(struct _media *media);
+
+extern void media_nandflash_get_stats(struct _media *media,
+		struct _nand_ftl_stats *stats);
+
+#endif /* MEDIA_NANDFLASH_H */
@@ -43,6 +43,47 @@
  *      Internal Functions
  *---------------------------------------------------------------------------*/
 
+/**
+ * \brief Completes the pending transfer of a RAM disk with latency
+ */
+static int media_ramdisk_complete(void *arg, void *arg2)
+{
+	struct _media *media = (struct _media*)arg;
+
+	media->state = MEDIA_STATE_READY;
+	if (media->transfer.callback)
+		media->transfer.callback(media->transfer.callback_arg,
+				MEDIA_STATUS_SUCCESS, media->transfer.length, 0);
+	return 0;
+}
+
+/**
+ * \brief Ends a RAM disk transfer, now or after the simulated latency
+ */
+static void media_ramdisk_done(struct _media *media, uint32_t length,
+		media_callback_t callback, void *callback_arg)
+{
+	struct _ramdisk_latency *latency =
+		(struct _ramdisk_latency*)media->interface;
+
+	if (latency) {
+		// Stay busy until the access time has elapsed
+		media->transfer.length = length;
+		media->transfer.callback = callback;
+		media->transfer.callback_arg = callback_arg;
+		timer_wheel_add(&latency->event,
+				latency->access_us + length * latency->block_us, 0);
+		return;
+	}
+
+	// Leave the Busy state
+	media->state = MEDIA_STATE_READY;
+
+	// Invoke callback
+	if (callback)
+		callback(callback_arg, MEDIA_STATUS_SUCCESS, 0, 0);
+}
+
 /**
  * \brief Reads a specified amount of data from a RAM Disk memory
  * \param media Pointer to a Media instance
@@ -73,14 +114,9 @@ static uint8_t media_ramdisk_read(struct _media *media,
 
 	// Copy data
 	source = (uint8_t*)((media->base_address + address) * media->block_size);
-	memcpy(data, source, length);
+	memcpy(data, source, length * media->block_size);
 
-	// Leave the Busy state
-	media->state = MEDIA_STATE_READY;
-
-	// Invoke callback
-	if (callback)
-		callback(callback_arg, MEDIA_STATUS_SUCCESS, 0, 0);
+	media_ramdisk_done(media, length, callback, callback_arg);
 
 	return MEDIA_STATUS_SUCCESS;
 }
@@ -115,14 +151,9 @@ static uint8_t media_ramdisk_write(struct _media *media,
 
 	// Copy data
 	dest = (uint8_t*)((media->base_address + address) * media->block_size);
-	memcpy(dest, data, length);
+	memcpy(dest, data, length * media->block_size);
 
-	// Leave the Busy state
-	media->state = MEDIA_STATE_READY;
-
-	// Invoke the callback if it exists
-	if (callback)
-		callback(callback_arg, MEDIA_STATUS_SUCCESS, 0, 0);
+	media_ramdisk_done(media, length, callback, callback_arg);
 
 	return MEDIA_STATUS_SUCCESS;
 }
@@ -150,3 +181,24 @@ void media_ramdisk_init(struct _media *media, uint32_t base_address, uint32_t si
 	media->mapped_write  = true;
 	media->state = MEDIA_STATE_READY;
 }
+
+/**
+ * \brief Simulate the access time of a slow media.
+ *
+ * Requests still complete immediately but the media stays busy and the
+ * callback is delayed until the access time has elapsed, from the timer wheel
+ * (which must be initialized). Memory mapped access is disabled while a
+ * latency is set.
+ * \param media    Pointer to a RAM disk Media instance
+ * \param latency  Access time, NULL to go back to immediate completion
+ */
+void media_ramdisk_set_latency(struct _media *media,
+		struct _ramdisk_latency *latency)
+{
+	if (latency)
+		timer_event_init(&latency->event, media_ramdisk_complete, media);
+
+	media->interface = latency;
+	media->mapped_read = (latency == NULL);
+	media->mapped_write = (latency == NULL);
+}
@@ -41,6 +41,19 @@
  *------------------------------------------------------------------------------*/
 
 #include "libstoragemedia/media.h"
+#include "timer_wheel.h"
+
+/*------------------------------------------------------------------------------
+ *      Types
+ *------------------------------------------------------------------------------*/
+
+/** Simulated access time of a RAM disk, used to test the upper layers with
+ * the timings of a slow media */
+struct _ramdisk_latency {
+	uint32_t access_us;          /**< Fixed delay of each request */
+	uint32_t block_us;           /**< Additional delay per media block */
+	struct _timer_event event;   /**< Completion of the pending request */
+};
 
 /*------------------------------------------------------------------------------
  *      Exported functions
@@ -49,4 +62,7 @@
 extern void media_ramdisk_init(struct _media *media,
 		uint32_t block_size, uint32_t base_address, uint32_t size);
 
+extern void media_ramdisk_set_latency(struct _media *media,
+		struct _ramdisk_latency *latency);
+
 #endif /* MEDIA_RAMDISK_H */
@@ -68,6 +68,13 @@
     #error "This compiler does not support."
 #endif
 
+/* Random numbers (TCP initial sequence numbers, local ports, DNS ids) from
+ * the TRNG-seeded DRBG when available, from rand() otherwise */
+#ifdef CONFIG_HAVE_TRNG
+#include "crypto/drbg.h"
+#define LWIP_RAND() random_u32()
+#endif
+
 /* No assert */
 #define LWIP_NOASSERT
 
@@ -34,17 +34,43 @@
  *        Headers
  *----------------------------------------------------------------------------*/
 
+#include "chip.h"
+
 #include "lwip/netif.h"
 #include "lwip/ip_addr.h"
 #include "lwip/err.h"
 #include "netif/etharp.h"
 
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/* Per RX queue counters */
+struct _ethif_queue_stats {
+	uint32_t frames;    /* frames passed to lwIP */
+	uint32_t drops;     /* frames dropped by the interface or lwIP */
+	uint32_t overruns;  /* RX overrun or buffer not available events */
+	uint32_t batches;   /* interrupts/polls that moved at least one frame */
+	uint32_t batch_max; /* largest number of frames moved at once */
+};
+
+/* Interface counters */
+struct _ethif_stats {
+	/* Frames handled with or without copy */
+	uint32_t tx_nocopy;
+	uint32_t tx_copied;
+	uint32_t rx_nocopy;
+	uint32_t rx_copied;
+	struct _ethif_queue_stats queues[ETH_QUEUE_COUNT];
+};
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
 
 err_t ethif_init(struct netif * netif);
 void ethif_poll(struct netif * netif);
+void ethif_get_stats(struct netif * netif, struct _ethif_stats * stats);
 
 #endif  /* _ETHIF_H */
 
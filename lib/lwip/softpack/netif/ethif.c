@@ -45,11 +45,19 @@
 #include "board_eth.h"
 #include "chip.h"
 #include "compiler.h"
+#include "barriers.h"
+#include "irqflags.h"
 #include "gpio/pio.h"
+#include "mm/cache.h"
+#include "ring.h"
 #include "lwip/opt.h"
 #include "netif/etharp.h"
 #include "netif/ethif.h"
 #include "network/ethd.h"
+#ifdef CONFIG_HAVE_GMAC_QUEUES
+#include "network/gmac.h"
+#include "network/gmacd.h"
+#endif
 #include "network/phy.h"
 #include "lwip/def.h"
 #if LWIP_DHCP
@@ -70,6 +78,50 @@
 #define IFNAME0 'e'
 #define IFNAME1 'n'
 
+/* RX buffers are lent to lwIP as custom pbufs when the stack supports them
+ * and no padding has to be inserted in front of the frame */
+#if LWIP_SUPPORT_CUSTOM_PBUF && (ETH_PAD_SIZE == 0)
+#define ETHIF_RX_NOCOPY 1
+#else
+#define ETHIF_RX_NOCOPY 0
+#endif
+
+/* Number of RX buffers, shared by the spare rings of all the RX queues and
+ * the pbufs held by lwIP */
+#ifndef ETHIF_RX_PBUF_COUNT
+#define ETHIF_RX_PBUF_COUNT 64
+#endif
+
+/* Size of the per-queue rings of spare and received buffers (power of 2) */
+#define ETHIF_RX_RING_SIZE 16
+
+/* Maximum number of frames processed per queue in one IRQ or poll */
+#ifndef ETHIF_RX_BATCH
+#define ETHIF_RX_BATCH 8
+#endif
+
+/* Number of RX queues used: with GMAC priority queues, ARP and network
+ * control traffic (DS CS6/CS7) goes to the last queue and expedited
+ * forwarding (DS EF) to queue 1, bulk data stays on queue 0 */
+#ifdef CONFIG_HAVE_GMAC_QUEUES
+#define ETHIF_RX_QUEUE_COUNT GMAC_QUEUE_COUNT
+#else
+#define ETHIF_RX_QUEUE_COUNT 1
+#endif
+#define ETHIF_RX_QUEUE_CONTROL (ETHIF_RX_QUEUE_COUNT - 1)
+#define ETHIF_RX_QUEUE_EF      (ETHIF_RX_QUEUE_COUNT > 2 ? 1 : 0)
+
+/* Maximum number of RX buffers for a frame */
+#define ETHIF_RX_SG_MAX (ETH_MAX_FRAME_LENGTH / ETH_RX_UNITSIZE)
+
+/* Maximum number of pbufs in a chain sent without copy */
+#ifndef ETHIF_TX_SG_MAX
+#define ETHIF_TX_SG_MAX 4
+#endif
+
+/* Maximum number of frames queued for transmission */
+#define ETHIF_TX_PENDING 16
+
 /*----------------------------------------------------------------------------
  *        Types
  *----------------------------------------------------------------------------*/
@@ -81,6 +133,52 @@ typedef struct _timers_info {
 	void (*timer_func)(void);
 } timers_info;
 
+/* Frame queued for transmission */
+struct _ethif_tx_pending {
+	struct pbuf *p;     /* pbuf referenced until sent, NULL if copied */
+};
+
+#if ETHIF_RX_NOCOPY
+/* RX buffer wrapped into a custom pbuf */
+struct _ethif_rx_pbuf {
+	struct pbuf_custom     pc; /* must be first */
+	uint8_t               *buffer;
+	uint16_t               len;
+	bool                   last; /* last buffer of the frame */
+	struct _ethif_rx_pbuf *next;
+};
+
+/* RX queue state, shared between the ETH interrupt and ethif_poll().
+ * Both rings are single-producer/single-consumer with free-running
+ * indexes: spare buffers are produced by ethif_poll() and consumed by the
+ * interrupt, received buffers the other way round. */
+struct _ethif_rx_queue {
+	struct _ethif_rx_pbuf *spare[ETHIF_RX_RING_SIZE];
+	volatile uint32_t      spare_head;
+	volatile uint32_t      spare_tail;
+	struct _ethif_rx_pbuf *recv[ETHIF_RX_RING_SIZE];
+	volatile uint32_t      recv_head;
+	volatile uint32_t      recv_tail;
+	volatile bool          starved; /* frames left in the ETH queue */
+};
+#endif
+
+/* Per-interface state */
+struct _ethif_state {
+	struct netif *netif;
+	struct _ethif_tx_pending tx_pending[ETHIF_TX_PENDING];
+	uint16_t tx_head;
+	uint16_t tx_tail;
+	volatile uint32_t tx_done; /* frames sent, counted by the TX callback */
+	uint32_t tx_reclaimed;     /* frames released by ethif_tx_reclaim() */
+#if ETHIF_RX_NOCOPY
+	struct _ethif_rx_queue rx_queues[ETHIF_RX_QUEUE_COUNT];
+#else
+	uint8_t rx_frame[ETH_MAX_FRAME_LENGTH];
+#endif
+	struct _ethif_stats stats;
+};
+
 /*---------------------------------------------------------------------------
  *         Variables
  *---------------------------------------------------------------------------*/
@@ -103,6 +201,19 @@ static timers_info timers_table[] = {
 #endif
 };
 
+static struct _ethif_state _ethif_states[ETH_IFACE_COUNT];
+
+#if ETHIF_RX_NOCOPY
+/* RX buffers, either free, lent to lwIP or owned by the ETH RX queue */
+CACHE_ALIGNED_DDR
+static uint8_t _ethif_rx_buffers[ETHIF_RX_PBUF_COUNT][ETH_RX_UNITSIZE];
+
+static struct _ethif_rx_pbuf _ethif_rx_pbufs[ETHIF_RX_PBUF_COUNT];
+
+/* List of free RX pbufs */
+static struct _ethif_rx_pbuf *_ethif_rx_free;
+#endif
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -139,7 +250,6 @@ static void timers_update(void)
 }
 
 /* Forward declarations. */
-static void  ethif_input(struct netif *netif);
 static err_t ethif_output(struct netif *netif, struct pbuf *p, ip4_addr_t *ipaddr);
 
 static void glow_level_init(struct netif *netif, struct _ethd* ethd)
@@ -157,11 +267,262 @@ static void glow_level_init(struct netif *netif, struct _ethd* ethd)
 	netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET| NETIF_FLAG_LINK_UP;
 }
 
+/**
+ * ETH TX interrupt callback, called once per sent frame. Frames complete in
+ * queue order, so counting them is enough to know which pending entries can
+ * be released.
+ */
+static void ethif_tx_callback0(uint8_t queue, uint32_t status)
+{
+	_ethif_states[0].tx_done++;
+}
+
+#if ETH_IFACE_COUNT > 1
+static void ethif_tx_callback1(uint8_t queue, uint32_t status)
+{
+	_ethif_states[1].tx_done++;
+}
+#endif
+
+static const ethd_callback_t _ethif_tx_callbacks[] = {
+	ethif_tx_callback0,
+#if ETH_IFACE_COUNT > 1
+	ethif_tx_callback1,
+#endif
+};
+
+/**
+ * Release the pbufs of the frames reported sent by the TX callback since the
+ * last call. Done from the polling context so that pbufs are never freed
+ * from interrupt context.
+ */
+static void ethif_tx_reclaim(struct netif *netif)
+{
+	struct _ethif_state *state = &_ethif_states[netif->num];
+	struct _ethif_tx_pending *pending;
+	uint32_t done = state->tx_done;
+
+	dmb();
+	while (state->tx_reclaimed != done) {
+		pending = &state->tx_pending[state->tx_tail];
+		if (pending->p)
+			pbuf_free(pending->p);
+		pending->p = NULL;
+		RING_INC(state->tx_tail, ETHIF_TX_PENDING);
+		state->tx_reclaimed++;
+	}
+}
+
+#if ETHIF_RX_NOCOPY
+/**
+ * Custom pbuf free function: put the RX buffer back into the free list.
+ */
+static void ethif_rx_pbuf_free(struct pbuf *p)
+{
+	struct _ethif_rx_pbuf *rx = (struct _ethif_rx_pbuf *)p;
+	SYS_ARCH_DECL_PROTECT(old_level);
+
+	SYS_ARCH_PROTECT(old_level);
+	rx->next = _ethif_rx_free;
+	_ethif_rx_free = rx;
+	SYS_ARCH_UNPROTECT(old_level);
+}
+
+/**
+ * Set up the pool of RX pbufs shared by the interfaces, once, whichever
+ * interface comes up first.
+ */
+static void ethif_rx_pbuf_init(void)
+{
+	static bool initialized = false;
+	int i;
+
+	if (initialized)
+		return;
+	initialized = true;
+
+	_ethif_rx_free = NULL;
+	for (i = 0; i < ETHIF_RX_PBUF_COUNT; i++) {
+		_ethif_rx_pbufs[i].pc.custom_free_function = ethif_rx_pbuf_free;
+		_ethif_rx_pbufs[i].buffer = _ethif_rx_buffers[i];
+		_ethif_rx_pbufs[i].next = _ethif_rx_free;
+		_ethif_rx_free = &_ethif_rx_pbufs[i];
+	}
+}
+
+/**
+ * Top up the spare ring of an RX queue from the free list.
+ */
+static void ethif_rx_refill(struct _ethif_rx_queue *rxq)
+{
+	uint32_t head = rxq->spare_head;
+	SYS_ARCH_DECL_PROTECT(old_level);
+
+	SYS_ARCH_PROTECT(old_level);
+	while (head - rxq->spare_tail < ETHIF_RX_RING_SIZE && _ethif_rx_free) {
+		rxq->spare[head & (ETHIF_RX_RING_SIZE - 1)] = _ethif_rx_free;
+		_ethif_rx_free = _ethif_rx_free->next;
+		head++;
+	}
+	SYS_ARCH_UNPROTECT(old_level);
+
+	dmb();
+	rxq->spare_head = head;
+}
+
+/**
+ * Move up to ETHIF_RX_BATCH frames from an ETH RX queue to the ring of
+ * received buffers, swapping the ETH buffers with spare ones. Runs from the
+ * ETH interrupt, or from ethif_poll() with interrupts disabled.
+ */
+static void ethif_rx_drain(struct _ethif_state *state, uint8_t queue)
+{
+	struct _ethif_rx_queue *rxq = &state->rx_queues[queue];
+	struct _ethif_queue_stats *qstats = &state->stats.queues[queue];
+	struct _ethd *ethd = board_get_eth(state->netif->num);
+	struct _eth_sg sg[ETHIF_RX_SG_MAX];
+	struct _eth_sg_list sgl;
+	uint32_t spare_tail = rxq->spare_tail;
+	uint32_t recv_head = rxq->recv_head;
+	uint32_t frames, count, i, frmlen;
+	uint8_t rc;
+
+	for (frames = 0; frames < ETHIF_RX_BATCH; frames++) {
+		/* Number of spare buffers that can be swapped */
+		count = rxq->spare_head - spare_tail;
+		i = ETHIF_RX_RING_SIZE - (recv_head - rxq->recv_tail);
+		if (count > i)
+			count = i;
+		if (count > ETHIF_RX_SG_MAX)
+			count = ETHIF_RX_SG_MAX;
+		if (count == 0) {
+			rxq->starved = true;
+			break;
+		}
+		dmb();
+
+		for (i = 0; i < count; i++) {
+			sg[i].size = ETH_RX_UNITSIZE;
+			sg[i].buffer = rxq->spare[(spare_tail + i) & (ETHIF_RX_RING_SIZE - 1)]->buffer;
+			sg[i].next = NULL;
+		}
+		sgl.size = count;
+		sgl.entries = sg;
+
+		rc = ethd_poll_sg(ethd, queue, &sgl, &frmlen);
+		if (rc == ETH_SIZE_TOO_SMALL) {
+			rxq->starved = true;
+			break;
+		}
+		if (rc != ETH_OK)
+			break;
+
+		for (i = 0; i < sgl.size; i++) {
+			struct _ethif_rx_pbuf *rx = rxq->spare[spare_tail & (ETHIF_RX_RING_SIZE - 1)];
+			rx->buffer = sg[i].buffer;
+			rx->len = sg[i].size;
+			rx->last = (i == sgl.size - 1);
+			rxq->recv[recv_head & (ETHIF_RX_RING_SIZE - 1)] = rx;
+			spare_tail++;
+			recv_head++;
+		}
+	}
+
+	/* Publish the received frames */
+	dmb();
+	rxq->spare_tail = spare_tail;
+	rxq->recv_head = recv_head;
+
+	if (frames) {
+		qstats->batches++;
+		if (frames > qstats->batch_max)
+			qstats->batch_max = frames;
+	}
+}
+
+/**
+ * ETH RX interrupt callback.
+ */
+static void ethif_rx_callback(uint8_t iface, uint8_t queue, uint32_t status)
+{
+	struct _ethif_state *state = &_ethif_states[iface];
+
+	if (status & (ETH_RX_RSR_BNA | ETH_RX_RSR_OVR))
+		state->stats.queues[queue].overruns++;
+
+	if (state->netif)
+		ethif_rx_drain(state, queue);
+}
+
+static void ethif_rx_callback0(uint8_t queue, uint32_t status)
+{
+	ethif_rx_callback(0, queue, status);
+}
+
+#if ETH_IFACE_COUNT > 1
+static void ethif_rx_callback1(uint8_t queue, uint32_t status)
+{
+	ethif_rx_callback(1, queue, status);
+}
+#endif
+
+static const ethd_callback_t _ethif_rx_callbacks[] = {
+	ethif_rx_callback0,
+#if ETH_IFACE_COUNT > 1
+	ethif_rx_callback1,
+#endif
+};
+
+/**
+ * Take a received frame from the ring of an RX queue.
+ *
+ * @return a chain of custom pbufs, NULL if no frame is available
+ */
+static struct pbuf *glow_level_input_nocopy(struct _ethif_rx_queue *rxq)
+{
+	struct _ethif_rx_pbuf *rx[ETHIF_RX_SG_MAX];
+	struct pbuf *p, *q;
+	uint32_t tail = rxq->recv_tail;
+	uint32_t count = 0;
+
+	if (tail == rxq->recv_head)
+		return NULL;
+	dmb();
+
+	/* Frames are published as a whole by ethif_rx_drain() */
+	do {
+		rx[count] = rxq->recv[tail & (ETHIF_RX_RING_SIZE - 1)];
+		tail++;
+	} while (!rx[count++]->last);
+
+	dmb();
+	rxq->recv_tail = tail;
+
+	/* Wrap the received buffers, last one first so that the chain is
+	 * built without walking it */
+	p = NULL;
+	while (count--) {
+		q = pbuf_alloced_custom(PBUF_RAW, rx[count]->len, PBUF_REF,
+				&rx[count]->pc, rx[count]->buffer, ETH_RX_UNITSIZE);
+		if (p)
+			pbuf_cat(q, p);
+		p = q;
+	}
+	return p;
+}
+#endif /* ETHIF_RX_NOCOPY */
+
 /**
  * This function should do the actual transmission of the packet. The packet is
  * contained in the pbuf that is passed to the function. This pbuf
  * might be chained.
  *
+ * The pbufs are handed to the ETH queue without copy and referenced until
+ * the frame has been sent. Long chains are merged into a single pbuf, and
+ * PBUF_REF payloads (which may be reused by the caller as soon as this
+ * function returns) are copied into the ETH TX buffers, except for our own
+ * RX custom pbufs.
+ *
  * @param netif the lwip network interface structure for this ethif
  * @param p the MAC packet to send (e.g. IP packet including MAC addresses and type)
  * @return ERR_OK if the packet could be sent
@@ -169,101 +530,140 @@ static void glow_level_init(struct netif *netif, struct _ethd* ethd)
  */
 static err_t glow_level_output(struct netif *netif, struct pbuf *p)
 {
-
-    struct pbuf *q;
-    uint8_t buf[1514];
-    uint8_t *bufptr = &buf[0];
-    uint8_t rc;
+	struct _ethif_state *state = &_ethif_states[netif->num];
+	struct _ethif_tx_pending *pending;
+	struct _eth_sg sg[ETHIF_TX_SG_MAX];
+	struct _eth_sg_list sgl;
+	struct pbuf *q;
+	bool copy = false;
+	err_t err = ERR_OK;
+	uint8_t rc;
+
+	ethif_tx_reclaim(netif);
+	if (RING_SPACE(state->tx_head, state->tx_tail, ETHIF_TX_PENDING) == 0)
+		return ERR_BUF;
 
 #if ETH_PAD_SIZE
-    pbuf_header(p, -ETH_PAD_SIZE);    /* drop the padding word */
+	pbuf_header(p, -ETH_PAD_SIZE);    /* drop the padding word */
 #endif
 
-    for(q = p; q != NULL; q = q->next) {
-        /* Send the data from the pbuf to the interface, one pbuf at a
-        time. The size of the data in each pbuf is kept in the ->len
-        variable. */
-
-        /* send data from(q->payload, q->len); */
-        memcpy(bufptr, q->payload, q->len);
-        bufptr += q->len;
-    }
-
-    /* signal that packet should be sent(); */
-    rc = ethd_send(board_get_eth(netif->num), 0, buf, p->tot_len, NULL);
-    if (rc != ETH_OK) {
-        return ERR_BUF;
-    }
-#if ETH_PAD_SIZE
-    pbuf_header(p, ETH_PAD_SIZE);     /* reclaim the padding word */
-#endif
+	/* Build the scatter-gather list from the pbuf chain */
+	sgl.size = 0;
+	sgl.entries = sg;
+	for (q = p; q != NULL; q = q->next) {
+		if (q->len == 0)
+			continue;
+		if (sgl.size == ETHIF_TX_SG_MAX)
+			break;
+		if (q->type == PBUF_REF && !(q->flags & PBUF_FLAG_IS_CUSTOM))
+			copy = true;
+		/* DMA from pbufs only when their lines can be cleaned alone */
+		if (!IS_CACHE_ALIGNED(q->payload))
+			copy = true;
+		sg[sgl.size].size = q->len;
+		sg[sgl.size].buffer = q->payload;
+		sg[sgl.size].next = NULL;
+		sgl.size++;
+	}
 
-    LINK_STATS_INC(link.xmit);
-    return ERR_OK;
+	pending = &state->tx_pending[state->tx_head];
+	if (q != NULL) {
+		/* Too many pbufs, merge them into a single one */
+		pending->p = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_RAM);
+		if (pending->p == NULL || pbuf_copy(pending->p, p) != ERR_OK) {
+			err = ERR_MEM;
+			goto exit;
+		}
+		sg[0].size = pending->p->len;
+		sg[0].buffer = pending->p->payload;
+		sgl.size = 1;
+		copy = !IS_CACHE_ALIGNED(sg[0].buffer);
+		state->stats.tx_copied++;
+	} else if (copy) {
+		pending->p = NULL;
+		state->stats.tx_copied++;
+	} else {
+		pending->p = p;
+		pbuf_ref(p);
+		state->stats.tx_nocopy++;
+	}
 
+	if (copy)
+		rc = ethd_send_sg(board_get_eth(netif->num), 0, &sgl,
+				  _ethif_tx_callbacks[netif->num]);
+	else
+		rc = ethd_send_sg_nocopy(board_get_eth(netif->num), 0, &sgl,
+					 _ethif_tx_callbacks[netif->num]);
+	if (rc != ETH_OK) {
+		err = ERR_BUF;
+		goto exit;
+	}
+
+	RING_INC(state->tx_head, ETHIF_TX_PENDING);
+	LINK_STATS_INC(link.xmit);
+
+exit:
+	if (err != ERR_OK && pending->p) {
+		pbuf_free(pending->p);
+		pending->p = NULL;
+	}
+#if ETH_PAD_SIZE
+	pbuf_header(p, ETH_PAD_SIZE);     /* reclaim the padding word */
+#endif
+	return err;
 }
 
+#if !ETHIF_RX_NOCOPY
 /**
  * Should allocate a pbuf and transfer the bytes of the incoming
  * packet from the interface into the pbuf.
  *
  * @param netif the lwip network interface structure for this ethif
+ * @param queue the ETH queue to read from
  * @return a pbuf filled with the received packet (including MAC header)
  *         NULL on memory error
  */
-static struct pbuf *glow_level_input(struct netif *netif)
+static struct pbuf *glow_level_input(struct netif *netif, uint8_t queue)
 {
-    struct pbuf *p, *q;
-    u16_t len;
-    uint8_t buf[1514];
-    uint8_t *bufptr = &buf[0];
-
-    uint32_t frmlen;
-    uint8_t rc;
-
-    /* Obtain the size of the packet and put it into the "len"
-       variable. */
-    rc = ethd_poll(board_get_eth(netif->num), 0, buf, (uint32_t)sizeof(buf), (uint32_t*)&frmlen);
-    if (rc != ETH_OK)
-    {
-      return NULL;
-    }
-    len = frmlen;
+	struct _ethif_state *state = &_ethif_states[netif->num];
+	struct pbuf *p;
+	u16_t len;
+	uint32_t frmlen;
+	uint8_t rc;
+
+	/* Obtain the size of the packet and put it into the "len"
+	   variable. */
+	rc = ethd_poll(board_get_eth(netif->num), queue, state->rx_frame,
+		       sizeof(state->rx_frame), &frmlen);
+	if (rc != ETH_OK)
+		return NULL;
+	len = frmlen;
 
 #if ETH_PAD_SIZE
-    len += ETH_PAD_SIZE;      /* allow room for Ethernet padding */
+	len += ETH_PAD_SIZE;      /* allow room for Ethernet padding */
 #endif
 
-    /* We allocate a pbuf chain of pbufs from the pool. */
-    p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+	/* We allocate a pbuf chain of pbufs from the pool. */
+	p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
 
-    if (p != NULL) {
+	if (p != NULL) {
 #if ETH_PAD_SIZE
-        pbuf_header(p, -ETH_PAD_SIZE);          /* drop the padding word */
+		pbuf_header(p, -ETH_PAD_SIZE);          /* drop the padding word */
 #endif
-        /* We iterate over the pbuf chain until we have read the entire
-         * packet into the pbuf. */
-        for(q = p; q != NULL; q = q->next) {
-            /* Read enough bytes to fill this pbuf in the chain. The
-             * available data in the pbuf is given by the q->len
-             * variable. */
-            /* read data into(q->payload, q->len); */
-            memcpy(q->payload, bufptr, q->len);
-            bufptr += q->len;
-        }
-        /* acknowledge that packet has been read(); */
-
+		pbuf_take(p, state->rx_frame, frmlen);
 #if ETH_PAD_SIZE
-        pbuf_header(p, ETH_PAD_SIZE);           /* reclaim the padding word */
+		pbuf_header(p, ETH_PAD_SIZE);           /* reclaim the padding word */
 #endif
-        LINK_STATS_INC(link.recv);
-    } else {
-        /* drop packet(); */
-        LINK_STATS_INC(link.memerr);
-        LINK_STATS_INC(link.drop);
-    }
-    return p;
+		state->stats.rx_copied++;
+	} else {
+		/* drop packet(); */
+		LINK_STATS_INC(link.memerr);
+		LINK_STATS_INC(link.drop);
+		state->stats.queues[queue].drops++;
+	}
+	return p;
 }
+#endif /* !ETHIF_RX_NOCOPY */
 
 /**
  * This function is called by the TCP/IP stack when an IP packet
@@ -278,46 +678,111 @@ static err_t ethif_output(struct netif *netif, struct pbuf *p, ip4_addr_t *ipadd
 }
 /**
  * This function should be called when a packet is ready to be read
- * from the interface. It uses the function low_level_input() that
- * should handle the actual reception of bytes from the network
- * interface. Then the type of the received packet is determined and
- * the appropriate input function is called.
+ * from the interface. Then the type of the received packet is determined
+ * and the appropriate input function is called.
  *
  * @param netif the lwip network interface structure for this ethif
+ * @param queue the ETH queue the frame was received on
+ * @param p the received frame
  */
+static void ethif_input(struct netif *netif, uint8_t queue, struct pbuf *p)
+{
+	struct _ethif_state *state = &_ethif_states[netif->num];
+	struct eth_hdr *ethhdr;
+	err_t err;
+
+	LINK_STATS_INC(link.recv);
+	state->stats.queues[queue].frames++;
+
+	/* points to packet payload, which starts with an Ethernet header */
+	ethhdr = p->payload;
+
+	switch (htons(ethhdr->type)) {
+	/* IP packet? */
+	case ETHTYPE_IP:
+		/* skip Ethernet header */
+		pbuf_header(p, -(s16_t)sizeof(struct eth_hdr));
+		/* pass to network layer */
+		err = netif->input(p, netif);
+		break;
+
+	case ETHTYPE_ARP:
+		/* pass p to ARP module  */
+		err = ethernet_input(p, netif);
+		break;
+
+	default:
+		err = ERR_VAL;
+		break;
+	}
 
-static void ethif_input(struct netif *netif)
+	if (err != ERR_OK) {
+		pbuf_free(p);
+		state->stats.queues[queue].drops++;
+	}
+}
+
+/**
+ * Process the frames received on all the RX queues, highest priority queue
+ * first, at most ETHIF_RX_BATCH frames per queue.
+ */
+static void ethif_rx_process(struct netif *netif)
 {
-    struct eth_hdr *ethhdr;
-    struct pbuf *p;
-
-    /* move received packet into a new pbuf */
-    p = glow_level_input(netif);
-    /* no packet could be read, silently ignore this */
-    if (p == NULL) return;
-    /* points to packet payload, which starts with an Ethernet header */
-    ethhdr = p->payload;
-
-    switch (htons(ethhdr->type)) {
-        /* IP packet? */
-        case ETHTYPE_IP:
-            /* skip Ethernet header */
-            pbuf_header(p, -(s16_t)sizeof(struct eth_hdr));
-            /* pass to network layer */
-            netif->input(p, netif);
-            break;
-
-        case ETHTYPE_ARP:
-            /* pass p to ARP module  */
-		  	ethernet_input(p, netif);
-            break;
-        default:
-            pbuf_free(p);
-            p = NULL;
-            break;
-        }
+	struct pbuf *p;
+	int queue, frames;
+#if ETHIF_RX_NOCOPY
+	struct _ethif_state *state = &_ethif_states[netif->num];
+	struct _ethif_rx_queue *rxq;
+
+	for (queue = ETHIF_RX_QUEUE_COUNT - 1; queue >= 0; queue--) {
+		rxq = &state->rx_queues[queue];
+
+		/* Give spare buffers to the interrupt, and take over if it
+		 * had to leave frames in the ETH queue */
+		ethif_rx_refill(rxq);
+		if (rxq->starved) {
+			rxq->starved = false;
+			arch_irq_disable();
+			ethif_rx_drain(state, queue);
+			arch_irq_enable();
+		}
+
+		for (frames = 0; frames < ETHIF_RX_BATCH; frames++) {
+			p = glow_level_input_nocopy(rxq);
+			if (p == NULL)
+				break;
+			state->stats.rx_nocopy++;
+			ethif_input(netif, queue, p);
+		}
+	}
+#else
+	for (queue = ETHIF_RX_QUEUE_COUNT - 1; queue >= 0; queue--) {
+		for (frames = 0; frames < ETHIF_RX_BATCH; frames++) {
+			p = glow_level_input(netif, queue);
+			if (p == NULL)
+				break;
+			ethif_input(netif, queue, p);
+		}
+	}
+#endif
+}
 
+#ifdef CONFIG_HAVE_GMAC_QUEUES
+/**
+ * Steer traffic classes to the GMAC priority queues
+ */
+static void ethif_setup_screening(struct _ethd *ethd)
+{
+	if (ethd->op != &_gmac_op)
+		return;
+
+	gmac_clear_screening(ethd->gmac);
+	gmac_set_screening_ethertype(ethd->gmac, 0, ETHTYPE_ARP, ETHIF_RX_QUEUE_CONTROL);
+	gmac_set_screening_dstc(ethd->gmac, 0, 0xc0, ETHIF_RX_QUEUE_CONTROL); /* CS6 */
+	gmac_set_screening_dstc(ethd->gmac, 1, 0xe0, ETHIF_RX_QUEUE_CONTROL); /* CS7 */
+	gmac_set_screening_dstc(ethd->gmac, 2, 0xb8, ETHIF_RX_QUEUE_EF);      /* EF */
 }
+#endif
 
 /*----------------------------------------------------------------------------
  *        Exported functions
@@ -331,12 +796,34 @@ static void ethif_input(struct netif *netif)
  */
 err_t ethif_init(struct netif *netif)
 {
+	struct _ethif_state *state = &_ethif_states[netif->num];
+	struct _ethd *ethd = board_get_eth(netif->num);
+#if ETHIF_RX_NOCOPY
+	int queue;
+#endif
+
 	netif->name[0] = IFNAME0;
 	netif->name[1] = IFNAME1;
 	netif->output = (netif_output_fn) ethif_output;
 	netif->linkoutput = glow_level_output;
-	glow_level_init(netif, board_get_eth(netif->num));
+	memset(state, 0, sizeof(*state));
+	glow_level_init(netif, ethd);
 	etharp_init();
+
+#ifdef CONFIG_HAVE_GMAC_QUEUES
+	ethif_setup_screening(ethd);
+#endif
+
+#if ETHIF_RX_NOCOPY
+	ethif_rx_pbuf_init();
+	for (queue = 0; queue < ETHIF_RX_QUEUE_COUNT; queue++) {
+		ethif_rx_refill(&state->rx_queues[queue]);
+		state->rx_queues[queue].starved = true;
+		ethd_set_rx_callback(ethd, queue, _ethif_rx_callbacks[netif->num]);
+	}
+#endif
+	state->netif = netif;
+
 	return ERR_OK;
 }
 
@@ -350,5 +837,17 @@ void ethif_poll(struct netif *netif)
 	/* Run periodic tasks */
 	timers_update();
 
-	ethif_input(netif);
+	/* Release frames sent since last poll */
+	ethif_tx_reclaim(netif);
+
+	ethif_rx_process(netif);
+}
+
+/**
+ * Get the copy statistics of an interface
+ *
+ */
+void ethif_get_stats(struct netif *netif, struct _ethif_stats *stats)
+{
+	*stats = _ethif_states[netif->num].stats;
 }
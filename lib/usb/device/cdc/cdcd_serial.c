@@ -170,6 +170,24 @@ uint32_t cdcd_serial_write(void *data, uint32_t size,
 			callback, callback_arg);
 }
 
+/**
+ * Returns the bulk IN endpoint of the serial port (0 if not configured).
+ */
+uint8_t cdcd_serial_get_bulk_in_endpoint(void)
+{
+	CDCDSerialPort *p_cdcd = &cdcd_serial;
+	return p_cdcd->bBulkInPIPE;
+}
+
+/**
+ * Returns the bulk OUT endpoint of the serial port (0 if not configured).
+ */
+uint8_t cdcd_serial_get_bulk_out_endpoint(void)
+{
+	CDCDSerialPort *p_cdcd = &cdcd_serial;
+	return p_cdcd->bBulkOutPIPE;
+}
+
 /**
  * Returns the current control line state of the RS-232 line.
  */
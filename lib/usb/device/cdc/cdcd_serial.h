@@ -76,6 +76,10 @@ extern uint32_t cdcd_serial_write(void *data, uint32_t size,
 extern uint32_t cdcd_serial_read(void *data, uint32_t size,
 		usbd_xfer_cb_t callback, void *callback_arg);
 
+extern uint8_t cdcd_serial_get_bulk_in_endpoint(void);
+
+extern uint8_t cdcd_serial_get_bulk_out_endpoint(void);
+
 extern void cdcd_serial_get_line_coding(CDCLineCoding *line_coding);
 
 extern uint8_t cdcd_serial_get_control_line_state(void);
@@ -0,0 +1,445 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**\file
+ * Implementation of the CDC serial streaming layer.
+ */
+
+/** \addtogroup usbd_cdc
+ *@{
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <string.h>
+
+#include "intmath.h"
+#include "irqflags.h"
+#include "ring.h"
+#include "timer_wheel.h"
+#include "trace.h"
+
+#include "usb/device/cdc/cdcd_serial.h"
+#include "usb/device/cdc/cdcd_serial_port.h"
+#include "usb/device/cdc/cdcd_stream.h"
+#include "usb/device/usbd_hal.h"
+
+/*------------------------------------------------------------------------------
+ *         Internal variables
+ *------------------------------------------------------------------------------*/
+
+static struct {
+	struct _ring rx;
+	struct _ring tx;
+	uint32_t rx_transfer;
+	uint32_t latency_us;
+
+	/** Endpoints and packet size, set by cdcd_stream_start() */
+	uint8_t ep_in;
+	uint8_t ep_out;
+	uint32_t packet_size;
+
+	volatile bool running;
+	volatile bool rx_armed;
+	bool rx_stalled;
+	volatile bool tx_busy;
+
+	/** Size of the IN transfer in progress (TX ring data) */
+	uint32_t tx_len;
+
+	/** Completion of a cdcd_stream_send() transfer */
+	usbd_xfer_cb_t send_callback;
+	void *send_callback_arg;
+
+	/** Latency bound of partial packets */
+	struct _timer_event tx_timer;
+
+	struct _cdcd_stream_stats stats;
+} stream;
+
+/*------------------------------------------------------------------------------
+ *         Internal functions
+ *------------------------------------------------------------------------------*/
+
+static void _cdcd_stream_rx_arm(void);
+static void _cdcd_stream_tx_kick(bool flush);
+
+/**
+ * Split the next \a size bytes of a ring, starting at \a ptr (head or
+ * tail position), in up to two buffers around the end of the ring.
+ * \return Number of buffers
+ */
+static uint32_t _cdcd_stream_split(struct _ring *ring, void *ptr,
+		uint32_t contiguous, uint32_t size, struct _usbd_buffer *list)
+{
+	list[0].data = ptr;
+	list[0].size = min_u32(contiguous, size);
+	if (list[0].size == size)
+		return 1;
+
+	list[1].data = ring->buffer;
+	list[1].size = size - list[0].size;
+	return 2;
+}
+
+/**
+ * Callback invoked when an OUT transfer completes
+ */
+static void _cdcd_stream_rx_done(void *arg, uint8_t status,
+		uint32_t transferred, uint32_t remaining)
+{
+	stream.rx_armed = false;
+
+	if (status != USBD_STATUS_SUCCESS) {
+		LIBUSB_TRACE("CdcS:rx%d ", status);
+		return;
+	}
+
+	ring_write_commit(&stream.rx, transferred);
+	stream.stats.rx_bytes += transferred;
+	stream.stats.rx_transfers++;
+
+	_cdcd_stream_rx_arm();
+}
+
+/**
+ * Start an OUT transfer in the free space of the RX ring. The transfer
+ * size is a multiple of the packet size, so that the host is NAKed rather
+ * than overflowing the ring.
+ */
+static void _cdcd_stream_rx_arm(void)
+{
+	struct _usbd_buffer list[2];
+	uint32_t flags, size, contiguous, count;
+	uint8_t rc;
+	void *ptr;
+
+	flags = arch_irq_save();
+
+	if (!stream.running || stream.rx_armed) {
+		arch_irq_restore(flags);
+		return;
+	}
+
+	size = min_u32(ring_space(&stream.rx), stream.rx_transfer);
+	size -= size % stream.packet_size;
+	if (size == 0) {
+		if (!stream.rx_stalled)
+			stream.stats.rx_stalls++;
+		stream.rx_stalled = true;
+		arch_irq_restore(flags);
+		return;
+	}
+	stream.rx_stalled = false;
+
+	contiguous = ring_write_reserve(&stream.rx, &ptr);
+	count = _cdcd_stream_split(&stream.rx, ptr, contiguous, size, list);
+
+	stream.rx_armed = true;
+	rc = usbd_read_list(stream.ep_out, list, count,
+			_cdcd_stream_rx_done, NULL);
+	if (rc == USBD_STATUS_HW_NOT_SUPPORTED) {
+		/* No DMA on the endpoint: contiguous packets only */
+		size = list[0].size - list[0].size % stream.packet_size;
+		rc = USBD_STATUS_LOCKED;
+		if (size)
+			rc = usbd_read(stream.ep_out, list[0].data, size,
+					_cdcd_stream_rx_done, NULL);
+	}
+	if (rc != USBD_STATUS_SUCCESS)
+		stream.rx_armed = false;
+
+	arch_irq_restore(flags);
+}
+
+/**
+ * Callback invoked when an IN transfer of TX ring data completes
+ */
+static void _cdcd_stream_tx_done(void *arg, uint8_t status,
+		uint32_t transferred, uint32_t remaining)
+{
+	/* Data is dropped on error (bus reset, halt) */
+	ring_read_release(&stream.tx, stream.tx_len);
+	stream.tx_busy = false;
+
+	if (status != USBD_STATUS_SUCCESS) {
+		LIBUSB_TRACE("CdcS:tx%d ", status);
+		return;
+	}
+
+	stream.stats.tx_bytes += transferred;
+	stream.stats.tx_transfers++;
+
+	_cdcd_stream_tx_kick(stream.latency_us == 0);
+}
+
+/**
+ * Callback invoked when a cdcd_stream_send() transfer completes
+ */
+static void _cdcd_stream_send_done(void *arg, uint8_t status,
+		uint32_t transferred, uint32_t remaining)
+{
+	stream.tx_busy = false;
+
+	if (status == USBD_STATUS_SUCCESS) {
+		stream.stats.tx_bytes += transferred;
+		stream.stats.tx_transfers++;
+	}
+
+	if (stream.send_callback)
+		stream.send_callback(stream.send_callback_arg, status,
+				transferred, remaining);
+
+	if (status == USBD_STATUS_SUCCESS)
+		_cdcd_stream_tx_kick(stream.latency_us == 0);
+}
+
+/**
+ * Latency bound expired: send the partial packet
+ */
+static int _cdcd_stream_tx_timeout(void *arg, void *arg2)
+{
+	stream.stats.tx_timeouts++;
+	_cdcd_stream_tx_kick(true);
+	return 0;
+}
+
+/**
+ * Start an IN transfer with the data of the TX ring if the endpoint is
+ * idle. Without \a flush only full packets are sent, a remaining partial
+ * packet is sent by the latency timer.
+ * \param flush true to send a partial packet too
+ */
+static void _cdcd_stream_tx_kick(bool flush)
+{
+	struct _usbd_buffer list[2];
+	uint32_t flags, count, size, contiguous, nb;
+	uint8_t rc;
+	const void *ptr;
+
+	flags = arch_irq_save();
+
+	count = ring_count(&stream.tx);
+	if (!stream.running || stream.tx_busy || count == 0) {
+		arch_irq_restore(flags);
+		return;
+	}
+
+	if (count < stream.packet_size && !flush) {
+		if (!timer_event_pending(&stream.tx_timer))
+			timer_wheel_add(&stream.tx_timer, stream.latency_us, 0);
+		arch_irq_restore(flags);
+		return;
+	}
+	timer_wheel_cancel(&stream.tx_timer);
+
+	size = min_u32(count, CDCD_STREAM_TX_TRANSFER);
+	if (!flush || size < count)
+		size -= size % stream.packet_size;
+
+	contiguous = ring_read_acquire(&stream.tx, &ptr);
+	nb = _cdcd_stream_split(&stream.tx, (void*)ptr, contiguous, size, list);
+
+	/* Terminate the transfer with a ZLP when no data follows, so that
+	 * the host does not wait for more */
+	usbd_hal_set_auto_zlp(stream.ep_in, size == count);
+
+	stream.tx_busy = true;
+	stream.tx_len = size;
+	rc = usbd_write_list(stream.ep_in, list, nb,
+			_cdcd_stream_tx_done, NULL);
+	if (rc == USBD_STATUS_HW_NOT_SUPPORTED) {
+		/* No DMA on the endpoint: contiguous data only */
+		stream.tx_len = list[0].size;
+		rc = usbd_write(stream.ep_in, list[0].data, list[0].size,
+				_cdcd_stream_tx_done, NULL);
+	}
+	if (rc != USBD_STATUS_SUCCESS)
+		stream.tx_busy = false;
+
+	arch_irq_restore(flags);
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+int cdcd_stream_init(const struct _cdcd_stream_cfg *cfg)
+{
+	if (cfg->rx_transfer % CDCDSerialPort_BULK_MAXPACKETSIZE_HS)
+		return -EINVAL;
+	if (cfg->rx_size < CDCDSerialPort_BULK_MAXPACKETSIZE_HS)
+		return -EINVAL;
+	if (ring_init(&stream.rx, cfg->rx_buffer, cfg->rx_size, 1) < 0)
+		return -EINVAL;
+	if (ring_init(&stream.tx, cfg->tx_buffer, cfg->tx_size, 1) < 0)
+		return -EINVAL;
+
+	stream.rx_transfer = cfg->rx_transfer ?
+		cfg->rx_transfer : CDCD_STREAM_RX_TRANSFER;
+	stream.latency_us = cfg->latency_us;
+	stream.running = false;
+	stream.rx_armed = false;
+	stream.tx_busy = false;
+	timer_event_init(&stream.tx_timer, _cdcd_stream_tx_timeout, NULL);
+	memset(&stream.stats, 0, sizeof(stream.stats));
+
+	return 0;
+}
+
+void cdcd_stream_start(void)
+{
+	if (stream.running)
+		return;
+
+	stream.ep_in = cdcd_serial_get_bulk_in_endpoint();
+	stream.ep_out = cdcd_serial_get_bulk_out_endpoint();
+	stream.packet_size = usbd_is_high_speed() ?
+		CDCDSerialPort_BULK_MAXPACKETSIZE_HS :
+		CDCDSerialPort_BULK_MAXPACKETSIZE_FS;
+
+	/* Transfers of a previous session are over (bus reset or stop) */
+	if (!stream.rx_armed)
+		ring_reset(&stream.rx);
+	if (!stream.tx_busy)
+		ring_reset(&stream.tx);
+	stream.rx_stalled = false;
+	stream.running = true;
+
+	LIBUSB_TRACE("CdcS:start%d,%d ", stream.ep_in, stream.ep_out);
+
+	_cdcd_stream_rx_arm();
+}
+
+void cdcd_stream_stop(void)
+{
+	stream.running = false;
+	timer_wheel_cancel(&stream.tx_timer);
+}
+
+bool cdcd_stream_is_running(void)
+{
+	return stream.running;
+}
+
+uint32_t cdcd_stream_write(const void *data, uint32_t size)
+{
+	uint32_t queued = ring_push_n(&stream.tx, data, size);
+
+	if (queued < size)
+		stream.stats.tx_full++;
+	_cdcd_stream_tx_kick(stream.latency_us == 0);
+	return queued;
+}
+
+uint32_t cdcd_stream_write_reserve(void **ptr)
+{
+	return ring_write_reserve(&stream.tx, ptr);
+}
+
+void cdcd_stream_write_commit(uint32_t count)
+{
+	ring_write_commit(&stream.tx, count);
+	_cdcd_stream_tx_kick(stream.latency_us == 0);
+}
+
+uint32_t cdcd_stream_tx_space(void)
+{
+	return ring_space(&stream.tx);
+}
+
+void cdcd_stream_flush(void)
+{
+	_cdcd_stream_tx_kick(true);
+}
+
+uint8_t cdcd_stream_send(const void *data, uint32_t size,
+		usbd_xfer_cb_t callback, void *callback_arg)
+{
+	uint32_t flags;
+	uint8_t rc;
+
+	flags = arch_irq_save();
+
+	if (!stream.running || stream.tx_busy || !ring_is_empty(&stream.tx)) {
+		arch_irq_restore(flags);
+		return USBD_STATUS_LOCKED;
+	}
+
+	stream.send_callback = callback;
+	stream.send_callback_arg = callback_arg;
+	usbd_hal_set_auto_zlp(stream.ep_in, true);
+
+	stream.tx_busy = true;
+	rc = usbd_write(stream.ep_in, data, size, _cdcd_stream_send_done, NULL);
+	if (rc != USBD_STATUS_SUCCESS)
+		stream.tx_busy = false;
+
+	arch_irq_restore(flags);
+	return rc;
+}
+
+uint32_t cdcd_stream_read(void *data, uint32_t size)
+{
+	uint32_t count = ring_pop_n(&stream.rx, data, size);
+
+	if (count)
+		_cdcd_stream_rx_arm();
+	return count;
+}
+
+uint32_t cdcd_stream_read_acquire(const void **ptr)
+{
+	return ring_read_acquire(&stream.rx, ptr);
+}
+
+void cdcd_stream_read_release(uint32_t count)
+{
+	ring_read_release(&stream.rx, count);
+	_cdcd_stream_rx_arm();
+}
+
+void cdcd_stream_get_stats(struct _cdcd_stream_stats *stats)
+{
+	uint32_t flags = arch_irq_save();
+	*stats = stream.stats;
+	arch_irq_restore(flags);
+}
+
+void cdcd_stream_reset_stats(void)
+{
+	uint32_t flags = arch_irq_save();
+	memset(&stream.stats, 0, sizeof(stream.stats));
+	arch_irq_restore(flags);
+}
+
+/**@}*/
@@ -0,0 +1,191 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Streaming layer over the CDC serial port function.
+ *
+ * Data received from the host is stored in an RX ring buffer by the USB
+ * DMA: an OUT transfer is kept armed as long as the ring has room for a
+ * packet, otherwise the host is NAKed until the application releases data.
+ * Data written by the application is coalesced in a TX ring buffer and sent
+ * in max-size packets; a partial packet is sent when no more data has been
+ * written within the configured latency.
+ *
+ * The latency bound uses the timer wheel, which must be initialized by the
+ * application (timer_wheel_init()) when a non-zero latency is configured.
+ */
+
+#ifndef CDCD_STREAM_H
+#define CDCD_STREAM_H
+
+/** \addtogroup usbd_cdc
+ *@{
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "usb/device/usbd.h"
+
+/*------------------------------------------------------------------------------
+ *         Definitions
+ *------------------------------------------------------------------------------*/
+
+/** Default max size of an OUT transfer */
+#define CDCD_STREAM_RX_TRANSFER     (4096)
+
+/** Max size of an IN transfer */
+#define CDCD_STREAM_TX_TRANSFER     (65536)
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+/** Stream configuration */
+struct _cdcd_stream_cfg {
+	/** RX ring buffer (cache aligned, size a power of two) */
+	uint8_t *rx_buffer;
+	uint32_t rx_size;
+
+	/** TX ring buffer (size a power of two) */
+	uint8_t *tx_buffer;
+	uint32_t tx_size;
+
+	/** Max size of an OUT transfer, 0 for CDCD_STREAM_RX_TRANSFER. A small
+	 *  value reduces the delay before received data is available. */
+	uint32_t rx_transfer;
+
+	/** Max delay (us) of a partial IN packet once the endpoint is idle,
+	 *  0 to send written data immediately */
+	uint32_t latency_us;
+};
+
+/** Stream counters */
+struct _cdcd_stream_stats {
+	uint32_t rx_bytes;      /**< Bytes received from the host */
+	uint32_t rx_transfers;  /**< OUT transfers completed */
+	uint32_t rx_stalls;     /**< Host NAKed because the RX ring was full */
+	uint32_t tx_bytes;      /**< Bytes sent to the host */
+	uint32_t tx_transfers;  /**< IN transfers completed */
+	uint32_t tx_timeouts;   /**< Partial packets sent by the latency bound */
+	uint32_t tx_full;       /**< Writes truncated because the TX ring was full */
+};
+
+/*------------------------------------------------------------------------------
+ *      Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize the stream
+ * \return 0 on success, -EINVAL for an invalid configuration
+ */
+extern int cdcd_stream_init(const struct _cdcd_stream_cfg *cfg);
+
+/**
+ * \brief Empty the rings and start the transfers. To be called once the
+ * device is configured (and the host has opened the port).
+ */
+extern void cdcd_stream_start(void);
+
+/**
+ * \brief Stop the stream. Transfers in progress complete normally, no new
+ * transfer is started.
+ */
+extern void cdcd_stream_stop(void);
+
+extern bool cdcd_stream_is_running(void);
+
+/**
+ * \brief Queue data for the host
+ * \return Number of bytes queued, less than \a size if the TX ring is full
+ */
+extern uint32_t cdcd_stream_write(const void *data, uint32_t size);
+
+/**
+ * \brief Get the contiguous free area of the TX ring (zero-copy write)
+ * \return Number of bytes that can be written at \a ptr
+ */
+extern uint32_t cdcd_stream_write_reserve(void **ptr);
+
+/**
+ * \brief Queue \a count bytes written in the area from
+ * cdcd_stream_write_reserve()
+ */
+extern void cdcd_stream_write_commit(uint32_t count);
+
+/** Free space of the TX ring */
+extern uint32_t cdcd_stream_tx_space(void);
+
+/**
+ * \brief Send the queued data now, including a partial packet
+ */
+extern void cdcd_stream_flush(void);
+
+/**
+ * \brief Send a buffer to the host without copying it to the TX ring
+ *
+ * The buffer is sent when the TX ring is empty and no IN transfer is in
+ * progress. It must be kept allocated until \a callback is invoked.
+ * \return USBD_STATUS_SUCCESS if the transfer has been started,
+ *         USBD_STATUS_LOCKED if the IN endpoint is busy
+ */
+extern uint8_t cdcd_stream_send(const void *data, uint32_t size,
+		usbd_xfer_cb_t callback, void *callback_arg);
+
+/**
+ * \brief Copy received data
+ * \return Number of bytes copied to \a data
+ */
+extern uint32_t cdcd_stream_read(void *data, uint32_t size);
+
+/**
+ * \brief Get the oldest contiguous received data (zero-copy read)
+ * \return Number of bytes available at \a ptr
+ */
+extern uint32_t cdcd_stream_read_acquire(const void **ptr);
+
+/**
+ * \brief Release \a count bytes obtained with cdcd_stream_read_acquire().
+ * May be called from interrupt context (e.g. a DMA completion callback).
+ */
+extern void cdcd_stream_read_release(uint32_t count);
+
+extern void cdcd_stream_get_stats(struct _cdcd_stream_stats *stats);
+
+extern void cdcd_stream_reset_stats(void);
+
+/**@}*/
+
+#endif /* CDCD_STREAM_H */
@@ -36,6 +36,9 @@
  *         Headers
  *------------------------------------------------------------------------------*/
 
+#include "intmath.h"
+#include "timer.h"
+
 #include "usb/device/msd/msd_io_fifo.h"
 
 /*------------------------------------------------------------------------------
@@ -70,6 +73,78 @@ void msd_io_fifo_init(MSDIOFifo *p_fifo,
 
 	p_fifo->fullCnt = 0;
 	p_fifo->nullCnt = 0;
+	p_fifo->startTick = 0;
+	p_fifo->elapsed = 0;
+}
+
+/**
+ * \brief  Prepares a MSDIOFifo instance for a new READ/WRITE command.
+ *
+ * The buffer is split in two slots so that the media access of one chunk
+ * overlaps with the USB transfer of the other one. Commands that fit in one
+ * slot are split in two halves, unless they are shorter than twice
+ * MSDIO_MIN_CHUNK_SIZE.
+ * \param  p_fifo      Pointer to the MSDIOFifo instance
+ * \param  data_total  Total size of the command data in bytes
+ * \param  block_size  Size of a block in bytes
+ * \param  max_chunk   Upper limit of the chunk size in bytes
+ */
+void msd_io_fifo_start(MSDIOFifo *p_fifo, unsigned int data_total,
+					 unsigned short block_size, unsigned int max_chunk)
+{
+	uint32_t slot, chunk;
+
+	/* Two slots of whole blocks, or a single one for small buffers */
+	slot = (p_fifo->bufferSize / 2) / block_size * block_size;
+	if (slot == 0)
+		slot = p_fifo->bufferSize / block_size * block_size;
+
+	chunk = max_u32(block_size, min_u32(slot, max_chunk));
+	if (data_total <= chunk) {
+		if (data_total >= 2 * MSDIO_MIN_CHUNK_SIZE)
+			chunk = (data_total / 2 + block_size - 1)
+				/ block_size * block_size;
+		else
+			chunk = max_u32(block_size, data_total);
+	}
+
+	p_fifo->dataTotal = data_total;
+	p_fifo->blockSize = block_size;
+	p_fifo->chunkSize = chunk;
+
+	p_fifo->inputNdx = 0;
+	p_fifo->outputNdx = 0;
+	p_fifo->inputTotal = 0;
+	p_fifo->outputTotal = 0;
+
+	p_fifo->inputState = MSDIO_IDLE;
+	p_fifo->outputState = MSDIO_IDLE;
+
+	p_fifo->fullCnt = 0;
+	p_fifo->nullCnt = 0;
+	p_fifo->startTick = (uint32_t)timer_get_tick();
+}
+
+/**
+ * \brief  Records the end of the current READ/WRITE command.
+ * \param  p_fifo  Pointer to the MSDIOFifo instance
+ */
+void msd_io_fifo_stop(MSDIOFifo *p_fifo)
+{
+	p_fifo->elapsed = (uint32_t)timer_get_tick() - p_fifo->startTick;
+}
+
+/**
+ * \brief  Returns the throughput of the last completed command.
+ * \param  p_fifo  Pointer to the MSDIOFifo instance
+ * \return Throughput in kB/s (1000 bytes per second), 0 if the command was
+ *         too short to be measured or if the system timer is not running
+ */
+unsigned int msd_io_fifo_get_throughput(const MSDIOFifo *p_fifo)
+{
+	if (p_fifo->elapsed == 0)
+		return 0;
+	return p_fifo->dataTotal / p_fifo->elapsed;
 }
 
 /**@}*/
@@ -70,6 +70,9 @@
 #define MSDIO_WRITE10_CHUNK_SIZE    (128 * 512)
 #endif
 
+/** Commands shorter than twice this size are not split in two chunks */
+#define MSDIO_MIN_CHUNK_SIZE        (8 * 512)
+
 /*------------------------------------------------------------------------------
  *         Types
  *------------------------------------------------------------------------------*/
@@ -98,11 +101,9 @@ typedef struct _MSDIOFifo {
 	unsigned int    dataTotal;
 	/** The size of the block in bytes */
 	unsigned short  blockSize;
-#if  defined(MSDIO_READ10_CHUNK_SIZE) || defined(MSDIO_WRITE10_CHUNK_SIZE)
 	/** The size of one chunk */
 	/** (1 block, or several blocks for large amount data R/W) */
 	unsigned int    chunkSize;
-#endif
 	/** State of input & output */
 	unsigned char   inputState;
 	unsigned char   outputState;
@@ -113,6 +114,10 @@ typedef struct _MSDIOFifo {
 	unsigned short  nullCnt;
 	/** Times when fifo can not load more input data */
 	unsigned short  fullCnt;
+	/** Tick (ms) when the current command started */
+	unsigned int    startTick;
+	/** Duration (ms) of the last completed command */
+	unsigned int    elapsed;
 } MSDIOFifo, *PMSDIOFifo;
 
 /*------------------------------------------------------------------------------
@@ -126,9 +131,17 @@ typedef struct _MSDIOFifo {
  * \param bufSize      The ring buffer size
  *------------------------------------------------------------------------------*/
 #define MSDIOFifo_IncNdx(ndx, sectSize, bufSize) \
-	if ((ndx) >= (bufSize) - (sectSize)) (ndx) = 0; \
+	if ((ndx) + 2 * (sectSize) > (bufSize)) (ndx) = 0; \
 	else (ndx) += (sectSize)
 
+/*------------------------------------------------------------------------------
+ * Check if the ring buffer has a free slot for one more chunk of input data
+ * \param pFifo        Pointer to the MSDIOFifo instance
+ *------------------------------------------------------------------------------*/
+#define MSDIOFifo_HasRoom(pFifo) \
+	((pFifo)->inputTotal - (pFifo)->outputTotal + (pFifo)->chunkSize \
+	 <= (pFifo)->bufferSize)
+
 
 /*------------------------------------------------------------------------------
  *         Exported Functions
@@ -138,6 +151,13 @@ typedef struct _MSDIOFifo {
 extern void msd_io_fifo_init(MSDIOFifo *pFifo,
 						   void * pBuffer, unsigned int bufferSize);
 
+extern void msd_io_fifo_start(MSDIOFifo *pFifo, unsigned int dataTotal,
+							unsigned short blockSize, unsigned int maxChunk);
+
+extern void msd_io_fifo_stop(MSDIOFifo *pFifo);
+
+extern unsigned int msd_io_fifo_get_throughput(const MSDIOFifo *pFifo);
+
 /**@}*/
 
 #endif /* _MSDIOFIFO_H */
@@ -161,7 +161,7 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 	MSDTransfer *transfer = &(command_state->transfer);
 	MSDTransfer *disktransfer = &(command_state->disktransfer);
 	MSDIOFifo *fifo = &lun->ioFifo;
-	uint32_t lba, old_chunk_size, new_chunk_size;
+	uint32_t lba, block_size, chunk;
 
 	/* Init command state */
 	if (command_state->state == 0) {
@@ -173,31 +173,27 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 		}
 		else {
 			/* Initialize FIFO */
-			fifo->dataTotal = command_state->length;
-			fifo->blockSize = lun->blockSize *
+			block_size = lun->blockSize *
 				media_get_block_size(lun->media);
 #ifdef MSDIO_WRITE10_CHUNK_SIZE
-			fifo->chunkSize = max_u32(fifo->blockSize,
-						  MSDIO_WRITE10_CHUNK_SIZE);
+			msd_io_fifo_start(fifo, command_state->length,
+					block_size, MSDIO_WRITE10_CHUNK_SIZE);
+#else
+			msd_io_fifo_start(fifo, command_state->length,
+					block_size, block_size);
 #endif
-			fifo->fullCnt = 0;
-			fifo->nullCnt = 0;
 
 			/* Initialize FIFO output (Disk) */
-			fifo->outputNdx = 0;
-			fifo->outputTotal = 0;
-			fifo->outputState = MSDIO_IDLE;
 			transfer->semaphore = 0;
 
 			/* Initialize FIFO input (USB) */
-			fifo->inputNdx = 0;
-			fifo->inputTotal = 0;
 			fifo->inputState = MSDIO_START;
 			disktransfer->semaphore = 0;
 		}
 	}
 
 	if (command_state->length == 0) {
+		msd_io_fifo_stop(fifo);
 		/* Perform the callback! */
 		if (lun->dataMonitor) {
 			lun->dataMonitor(0, fifo->dataTotal, fifo->nullCnt, fifo->fullCnt);
@@ -205,17 +201,13 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 		return MSDD_STATUS_SUCCESS;
 	}
 
-	old_chunk_size = fifo->chunkSize;
-	if ((fifo->dataTotal - fifo->inputTotal) < fifo->chunkSize) {
-		new_chunk_size = fifo->dataTotal - fifo->inputTotal;
-		fifo->chunkSize = new_chunk_size;
-	}
-
 	/* USB receive task */
+	chunk = min_u32(fifo->chunkSize, fifo->dataTotal - fifo->inputTotal);
+
 	switch(fifo->inputState) {
 	case MSDIO_IDLE:
 		if (fifo->inputTotal < fifo->dataTotal &&
-				fifo->inputTotal - fifo->outputTotal < fifo->bufferSize) {
+				MSDIOFifo_HasRoom(fifo)) {
 			fifo->inputState = MSDIO_START;
 		}
 		break;
@@ -248,16 +240,10 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 						msd_driver_callback, transfer);
 			}
 		} else {
-			/* Read block to buffer */
-#ifdef MSDIO_WRITE10_CHUNK_SIZE
-			status = usbd_read(command_state->pipeOUT,
-					&fifo->pBuffer[fifo->inputNdx], fifo->chunkSize,
-					msd_driver_callback, transfer);
-#else
+			/* Read chunk to buffer */
 			status = usbd_read(command_state->pipeOUT,
-					&fifo->pBuffer[fifo->inputNdx], fifo->blockSize,
+					&fifo->pBuffer[fifo->inputNdx], chunk,
 					msd_driver_callback, transfer);
-#endif
 		}
 
 		/* Check operation result code */
@@ -300,15 +286,9 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 				fifo->inputState = MSDIO_IDLE;
 			} else {
 				/* Update input index */
-#ifdef MSDIO_WRITE10_CHUNK_SIZE
 				MSDIOFifo_IncNdx(fifo->inputNdx, fifo->chunkSize,
 						fifo->bufferSize);
-				fifo->inputTotal += fifo->chunkSize;
-#else
-				MSDIOFifo_IncNdx(fifo->inputNdx, fifo->blockSize,
-						fifo->bufferSize);
-				fifo->inputTotal += fifo->blockSize;
-#endif
+				fifo->inputTotal += chunk;
 
 				/* Start Next block */
 
@@ -317,7 +297,7 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 					fifo->inputState = MSDIO_IDLE;
 				}
 				/* - Buffer full? */
-				else if (fifo->inputNdx == fifo->outputNdx) {
+				else if (!MSDIOFifo_HasRoom(fifo)) {
 					fifo->inputState = MSDIO_IDLE;
 					fifo->fullCnt++;
 					LIBUSB_TRACE("ufFull%d ", fifo->inputNdx);
@@ -338,11 +318,7 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 	}
 
 	/* Disk write task */
-	fifo->chunkSize = old_chunk_size;
-	if ((fifo->dataTotal - fifo->outputTotal) < fifo->chunkSize) {
-		new_chunk_size = fifo->dataTotal - fifo->outputTotal;
-		fifo->chunkSize = new_chunk_size;
-	}
+	chunk = min_u32(fifo->chunkSize, fifo->dataTotal - fifo->outputTotal);
 
 	switch(fifo->outputState) {
 	case MSDIO_IDLE:
@@ -357,16 +333,10 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 			msd_driver_callback(disktransfer, MEDIA_STATUS_SUCCESS, 0, 0);
 			status = LUN_STATUS_SUCCESS;
 		} else {
-#ifdef MSDIO_WRITE10_CHUNK_SIZE
 			status = lun_write(lun, DWORDB(command->pLogicalBlockAddress),
 					&fifo->pBuffer[fifo->outputNdx],
-					fifo->chunkSize / fifo->blockSize,
-					msd_driver_callback, disktransfer);
-#else
-			status = lun_write(lun, DWORDB(command->pLogicalBlockAddress),
-					&fifo->pBuffer[fifo->outputNdx], 1,
+					chunk / fifo->blockSize,
 					msd_driver_callback, disktransfer);
-#endif
 		}
 
 		/* Check operation result code */
@@ -398,7 +368,7 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 
 	case MSDIO_NEXT:
 		/* Check operation result code */
-		if (transfer->status != USBD_STATUS_SUCCESS) {
+		if (disktransfer->status != USBD_STATUS_SUCCESS) {
 			trace_warning("RBC_Write10: Failed to write\n\r");
 			sbc_update_sense_data(lun->requestSenseData,
 					SBC_SENSE_KEY_RECOVERED_ERROR,
@@ -417,17 +387,10 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 			} else {
 				/* Update output index */
 				lba = DWORDB(command->pLogicalBlockAddress);
-#ifdef MSDIO_WRITE10_CHUNK_SIZE
-				lba += fifo->chunkSize / fifo->blockSize;
+				lba += chunk / fifo->blockSize;
 				MSDIOFifo_IncNdx(fifo->outputNdx, fifo->chunkSize,
 						fifo->bufferSize);
-				fifo->outputTotal += fifo->chunkSize;
-#else
-				lba++;
-				MSDIOFifo_IncNdx(fifo->outputNdx, fifo->blockSize,
-						fifo->bufferSize);
-				fifo->outputTotal += fifo->blockSize;
-#endif
+				fifo->outputTotal += chunk;
 				STORE_DWORDB(lba, command->pLogicalBlockAddress);
 
 				/* Start Next block */
@@ -481,7 +444,7 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 	MSDTransfer *transfer = &(command_state->transfer);
 	MSDTransfer *disktransfer = &(command_state->disktransfer);
 	MSDIOFifo   *fifo = &lun->ioFifo;
-	uint32_t lba, old_chunk_size, new_chunk_size;
+	uint32_t lba, block_size, chunk;
 
 	/* Init command state */
 	if (command_state->state == 0) {
@@ -492,16 +455,15 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 		}
 		else {
 			/* Initialize FIFO */
-
-			fifo->dataTotal = command_state->length;
-			fifo->blockSize = lun->blockSize *
+			block_size = lun->blockSize *
 				media_get_block_size(lun->media);
 #ifdef MSDIO_READ10_CHUNK_SIZE
-			fifo->chunkSize = max_u32(fifo->blockSize,
-						  MSDIO_READ10_CHUNK_SIZE);
+			msd_io_fifo_start(fifo, command_state->length,
+					block_size, MSDIO_READ10_CHUNK_SIZE);
+#else
+			msd_io_fifo_start(fifo, command_state->length,
+					block_size, block_size);
 #endif
-			fifo->fullCnt = 0;
-			fifo->nullCnt = 0;
 
 #ifdef MSDIO_FIFO_OFFSET
 			/* Enable offset if total size >= 2*bufferSize */
@@ -512,14 +474,9 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 #endif
 
 			/* Initialize FIFO output (USB) */
-			fifo->outputNdx = 0;
-			fifo->outputTotal = 0;
-			fifo->outputState = MSDIO_IDLE;
 			transfer->semaphore = 0;
 
 			/* Initialize FIFO input (Disk) */
-			fifo->inputNdx = 0;
-			fifo->inputTotal = 0;
 			fifo->inputState = MSDIO_START;
 			disktransfer->semaphore = 0;
 		}
@@ -527,6 +484,7 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 
 	/* Check length */
 	if (command_state->length == 0) {
+		msd_io_fifo_stop(fifo);
 		/* Perform the callback! */
 		if (lun->dataMonitor) {
 			lun->dataMonitor(1, fifo->dataTotal, fifo->nullCnt, fifo->fullCnt);
@@ -535,16 +493,12 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 	}
 
 	/* Disk reading task */
-	old_chunk_size = fifo->chunkSize;
-	if ((fifo->dataTotal - fifo->inputTotal) < fifo->chunkSize) {
-		new_chunk_size = fifo->dataTotal - fifo->inputTotal;
-		fifo->chunkSize = new_chunk_size;
-	}
+	chunk = min_u32(fifo->chunkSize, fifo->dataTotal - fifo->inputTotal);
 
 	switch(fifo->inputState) {
 	case MSDIO_IDLE:
 		if (fifo->inputTotal < fifo->dataTotal &&
-				fifo->inputTotal - fifo->outputTotal < fifo->bufferSize) {
+				MSDIOFifo_HasRoom(fifo)) {
 			fifo->inputState = MSDIO_START;
 		}
 		break;
@@ -562,16 +516,10 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 					? MEDIA_STATUS_SUCCESS
 					: MEDIA_STATUS_ERROR, 0, 0);
 		} else {
-#ifdef MSDIO_READ10_CHUNK_SIZE
 			status = lun_read(lun, DWORDB(command->pLogicalBlockAddress),
 					&fifo->pBuffer[fifo->inputNdx],
-					fifo->chunkSize / fifo->blockSize,
-					msd_driver_callback, disktransfer);
-#else
-			status = lun_read(lun, DWORDB(command->pLogicalBlockAddress),
-					&fifo->pBuffer[fifo->inputNdx], 1,
+					chunk / fifo->blockSize,
 					msd_driver_callback, disktransfer);
-#endif
 		}
 
 		/* Check operation result code */
@@ -621,17 +569,10 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 			} else {
 				/* Update block address, and input index */
 				lba = DWORDB(command->pLogicalBlockAddress);
-#ifdef MSDIO_READ10_CHUNK_SIZE
-				lba += fifo->chunkSize / fifo->blockSize;
+				lba += chunk / fifo->blockSize;
 				MSDIOFifo_IncNdx(fifo->inputNdx, fifo->chunkSize,
 						fifo->bufferSize);
-				fifo->inputTotal += fifo->chunkSize;
-#else
-				lba++;
-				MSDIOFifo_IncNdx(fifo->inputNdx, fifo->blockSize,
-						fifo->bufferSize);
-				fifo->inputTotal += fifo->blockSize;
-#endif
+				fifo->inputTotal += chunk;
 				STORE_DWORDB(lba, command->pLogicalBlockAddress);
 
 				/* Start Next block */
@@ -642,7 +583,7 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 					fifo->inputState = MSDIO_IDLE;
 				}
 				/* - Buffer full? */
-				else if (fifo->inputNdx == fifo->outputNdx) {
+				else if (!MSDIOFifo_HasRoom(fifo)) {
 					LIBUSB_TRACE("dfFull%d ", (int)fifo->inputNdx);
 					fifo->inputState = MSDIO_IDLE;
 					fifo->fullCnt ++;
@@ -660,13 +601,8 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 		break;
 	}
 
-	fifo->chunkSize = old_chunk_size;
-
 	/* USB sending task */
-	if ((fifo->dataTotal - fifo->outputTotal) < fifo->chunkSize) {
-		new_chunk_size = fifo->dataTotal - fifo->outputTotal;
-		fifo->chunkSize = new_chunk_size;
-	}
+	chunk = min_u32(fifo->chunkSize, fifo->dataTotal - fifo->outputTotal);
 
 	switch(fifo->outputState) {
 	case MSDIO_IDLE:
@@ -699,15 +635,9 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 					(void*)mappedAddr, command_state->length,
 					msd_driver_callback, transfer);
 		} else {
-#ifdef MSDIO_READ10_CHUNK_SIZE
-			status = usbd_write(command_state->pipeIN,
-					&fifo->pBuffer[fifo->outputNdx], fifo->chunkSize,
-					msd_driver_callback, transfer);
-#else
 			status = usbd_write(command_state->pipeIN,
-					&fifo->pBuffer[fifo->outputNdx], fifo->blockSize,
+					&fifo->pBuffer[fifo->outputNdx], chunk,
 					msd_driver_callback, transfer);
-#endif
 		}
 
 		/* Check operation result code */
@@ -747,15 +677,9 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 				command_state->length = 0;
 			} else {
 				/* Update output index */
-#ifdef MSDIO_READ10_CHUNK_SIZE
 				MSDIOFifo_IncNdx(fifo->outputNdx, fifo->chunkSize,
 						fifo->bufferSize);
-				fifo->outputTotal += fifo->chunkSize;
-#else
-				MSDIOFifo_IncNdx(fifo->outputNdx, fifo->blockSize,
-						fifo->bufferSize);
-				fifo->outputTotal += fifo->blockSize;
-#endif
+				fifo->outputTotal += chunk;
 
 				/* Start Next block */
 
@@ -766,7 +690,7 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 					LIBUSB_TRACE("uDone ");
 				}
 				/* - Buffer Null? */
-				else if (fifo->inputNdx == fifo->outputNdx) {
+				else if (fifo->outputTotal >= fifo->inputTotal) {
 					LIBUSB_TRACE("ufNull%d ", (int)fifo->outputNdx);
 					fifo->outputState = MSDIO_IDLE;
 					fifo->nullCnt ++;
@@ -226,6 +226,53 @@ uint8_t usbd_read(uint8_t endpoint, void *data, uint32_t length,
 	return usbd_hal_read(endpoint, data, length);
 }
 
+/**
+ * Sends a list of buffers through an USB endpoint, as a single transfer.
+ * The buffers are chained in the endpoint DMA descriptors so that the
+ * endpoint does not NAK between them.
+ *
+ * *The buffers must be kept allocated until the transfer is finished*;
+ *  the list itself is not referenced after the call.
+ * \param endpoint Endpoint number (with DMA support).
+ * \param list Array of buffers.
+ * \param count Number of buffers in the list.
+ * \param callback Optional callback function to invoke when the transfer is
+ *        complete.
+ * \param callback_arg Optional argument to the callback function.
+ * \return USBD_STATUS_SUCCESS if the transfer has been started;
+ *         otherwise, the corresponding error status code.
+ */
+uint8_t usbd_write_list(uint8_t endpoint,
+		const struct _usbd_buffer *list, uint32_t count,
+		usbd_xfer_cb_t callback, void *callback_arg)
+{
+	usbd_hal_set_transfer_callback(endpoint, callback, callback_arg);
+	return usbd_hal_write_list(endpoint, list, count);
+}
+
+/**
+ * Reads incoming data on an USB endpoint into a list of buffers, as a single
+ * transfer. The transfer finishes either when all the buffers are full, or
+ * a short packet is received.
+ *
+ * *The buffers must be kept allocated until the transfer is finished*.
+ * \param endpoint Endpoint number (with DMA support).
+ * \param list Array of buffers.
+ * \param count Number of buffers in the list.
+ * \param callback Optional callback function to invoke when the transfer is
+ *        complete.
+ * \param callback_arg Optional argument to the callback function.
+ * \return USBD_STATUS_SUCCESS if the read operation has been started;
+ *         otherwise, the corresponding error code.
+ */
+uint8_t usbd_read_list(uint8_t endpoint,
+		const struct _usbd_buffer *list, uint32_t count,
+		usbd_xfer_cb_t callback, void *callback_arg)
+{
+	usbd_hal_set_transfer_callback(endpoint, callback, callback_arg);
+	return usbd_hal_read_list(endpoint, list, count);
+}
+
 /**
  * Sets the HALT feature on the given endpoint (if not already in this state).
  * \param b_endpoint Endpoint number.
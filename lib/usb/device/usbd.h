@@ -131,6 +131,15 @@
  */
 typedef void (*usbd_xfer_cb_t)(void *arg, uint8_t status, uint32_t transferred, uint32_t remaining);
 
+/**
+ * Buffer of a list transfer (usbd_write_list & usbd_read_list). The buffers
+ * of a list are transferred back to back, as a single transfer.
+ */
+struct _usbd_buffer {
+	void *data;     /**< Pointer to the buffer */
+	uint32_t size;  /**< Size of the buffer in bytes */
+};
+
 /**@}*/
 
 /*------------------------------------------------------------------------------
@@ -153,6 +162,14 @@ extern uint16_t usbd_get_data_size(uint8_t endpoint);
 extern uint8_t usbd_read(uint8_t endpoint, void *data, uint32_t length,
 		usbd_xfer_cb_t callback, void *callback_arg);
 
+extern uint8_t usbd_write_list(uint8_t endpoint,
+		const struct _usbd_buffer *list, uint32_t count,
+		usbd_xfer_cb_t callback, void *callback_arg);
+
+extern uint8_t usbd_read_list(uint8_t endpoint,
+		const struct _usbd_buffer *list, uint32_t count,
+		usbd_xfer_cb_t callback, void *callback_arg);
+
 extern uint8_t usbd_stall(uint8_t endpoint);
 
 extern void usbd_halt(uint8_t endpoint);
@@ -50,6 +50,20 @@
 #include "usb/common/usb_requests.h"
 #include "usb/device/usbd.h"
 
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Max number of payloads of a chain, see usbd_hal_prepare_payloads() */
+#define USBD_HAL_MAX_PAYLOADS 8
+
+/** Max number of payload chains looped by usbd_hal_start_payloads() */
+#define USBD_HAL_MAX_CHAINS 3
+
+/** Max number of DMA descriptors of a buffer list transfer (each descriptor
+ * holds up to 64 KBytes with UDPHS, 32 KBytes with USBHS) */
+#define USBD_HAL_MAX_BUFFERS 8
+
 /*----------------------------------------------------------------------------
  *        Types
  *----------------------------------------------------------------------------*/
@@ -67,6 +81,32 @@ struct _usbd_transfer_buffer {
 	uint16_t remaining;   /**< Bytes remaining */
 };
 
+/**
+ * \brief Payload for usbd_hal_prepare_payloads(): a header followed by data,
+ * sent as one isochronous transaction.
+ */
+struct _usbd_payload {
+	const void *header;   /**< Pointer to header */
+	uint32_t header_len;  /**< Size of header */
+	const void *data;     /**< Pointer to data */
+	uint32_t data_len;    /**< Size of data */
+};
+
+/**
+ * \brief Endpoint statistics, see usbd_hal_get_stats().
+ *
+ * A gap is the time between the end of a transfer and the start of the next
+ * one during which the host was NAKed by the endpoint.
+ */
+struct _usbd_hal_stats {
+	uint32_t transfers;   /**< Completed transfers */
+	uint32_t bytes;       /**< Bytes transferred */
+	uint32_t naks;        /**< Gaps during which the host was NAKed */
+	uint32_t rearms;      /**< DMA re-arms inside a transfer */
+	uint32_t gap_max;     /**< Longest gap (us) */
+	uint32_t gap_total;   /**< Sum of the gaps (us) */
+};
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -110,11 +150,28 @@ extern uint8_t usbd_hal_write_with_header(uint8_t endpoint,
 		const void *header, uint32_t header_length,
 		const void *data, uint32_t data_length);
 
+extern uint8_t usbd_hal_prepare_payloads(uint8_t endpoint, uint8_t chain,
+		const struct _usbd_payload *payloads, uint32_t count);
+
+extern uint8_t usbd_hal_start_payloads(uint8_t endpoint, uint8_t chains);
+
+extern uint8_t usbd_hal_write_list(uint8_t endpoint,
+		const struct _usbd_buffer *list, uint32_t count);
+
 extern uint16_t usbd_hal_get_data_size(uint8_t endpoint);
 
 extern uint8_t usbd_hal_read(uint8_t endpoint,
 		void *data, uint32_t length);
 
+extern uint8_t usbd_hal_read_list(uint8_t endpoint,
+		const struct _usbd_buffer *list, uint32_t count);
+
+extern void usbd_hal_set_auto_zlp(uint8_t endpoint, bool enable);
+
+extern void usbd_hal_get_stats(uint8_t endpoint, struct _usbd_hal_stats *stats);
+
+extern void usbd_hal_reset_stats(uint8_t endpoint);
+
 extern uint8_t usbd_hal_stall(uint8_t endpoint);
 
 extern bool usbd_hal_halt(uint8_t endpoint);
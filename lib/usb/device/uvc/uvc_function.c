@@ -32,6 +32,7 @@
  *------------------------------------------------------------------------------*/
 #include "chip.h"
 
+#include "intmath.h"
 #include "trace.h"
 #include "mm/cache.h"
 #include "usb/common/uvc/usb_video.h"
@@ -80,13 +81,107 @@ static uint32_t frm_max_pkt_size = FRAME_PACKET_SIZE_HS * (ISO_HIGH_BW_MODE + 1)
 /** Buffer for USB requests data */
 CACHE_ALIGNED static uint8_t control_buffer[64];
 
-CACHE_ALIGNED static uint8_t stream_header[32];
-
 static struct _uvc_driver *uvc_driver;
 
-static volatile uint32_t frame_buffer_addr;
+/** Payload headers of the DMA chains */
+CACHE_ALIGNED static USBVideoPayloadHeader stream_headers[UVC_CHAINS][UVC_CHAIN_PAYLOADS];
+
+/** Video streaming state */
+static struct {
+	/** Payloads of the DMA chains, looped on the endpoint */
+	struct _usbd_payload payloads[UVC_CHAINS][UVC_CHAIN_PAYLOADS];
+	/** Number of frames ended by each chain */
+	uint8_t frames[UVC_CHAINS];
+	/** Next chain to be completed */
+	uint8_t done;
+	volatile bool running;
+	uint32_t frame_size;
+	/** Max data per payload */
+	uint32_t payload_size;
+	/** Frame being sent, NULL between two frames */
+	const uint8_t *frame;
+	/** Capture count when the last frame was selected */
+	uint32_t capture_seq;
+} stream;
+
+/** Number of frames captured (VD callbacks) */
+static volatile uint32_t captured_frames;
+
+static struct _uvc_stream_stats stream_stats;
+
+/** Tick of the last statistics reset */
+static uint32_t stats_start;
+/*-----------------------------------------------------------------------------
+ *      Internal functions
+ *-----------------------------------------------------------------------------*/
+
+/**
+ * Select the frame to send: the last one completed by the capture.
+ */
+static const uint8_t* _uvc_next_frame(void)
+{
+	uint32_t captured = captured_frames;
+	uint32_t idx = uvc_driver->stream_frm_index;
+
+	if (captured == stream.capture_seq)
+		stream_stats.repeated++;
+	else
+		stream_stats.dropped += captured - stream.capture_seq - 1;
+	stream.capture_seq = captured;
+
+	/* the capture is filling buffer idx, the previous one is complete */
+	idx = (idx == 0) ? (uvc_driver->multi_buffers - 1) : (idx - 1);
+	return (const uint8_t*)(uvc_driver->buf_start_addr + idx * stream.frame_size);
+}
+
+/**
+ * Fill the payloads (headers and data pointers) of a DMA chain, the data is
+ * sent directly from the frame buffers.
+ */
+static void _uvc_build_chain(uint8_t chain)
+{
+	USBVideoPayloadHeader *header = stream_headers[chain];
+	struct _usbd_payload *payload = stream.payloads[chain];
+	uint32_t i, len;
+
+	stream.frames[chain] = 0;
+	for (i = 0; i < UVC_CHAIN_PAYLOADS; i++, header++, payload++) {
+		if (!stream.frame) {
+			stream.frame = _uvc_next_frame();
+			uvc_driver->frm_offset = 0;
+			uvc_driver->is_frame_xfring = 1;
+		}
+		len = min_u32(stream.frame_size - uvc_driver->frm_offset,
+				stream.payload_size);
+
+		header->bHeaderLength = FRAME_PAYLOAD_HDR_SIZE;
+		header->bmHeaderInfo.B = 0;
+		header->bmHeaderInfo.bm.FID = (uvc_driver->frm_count & 1);
+		header->bmHeaderInfo.bm.EOH = 1;
+
+		payload->header = header;
+		payload->header_len = FRAME_PAYLOAD_HDR_SIZE;
+		payload->data = &stream.frame[uvc_driver->frm_offset];
+		payload->data_len = len;
+
+		uvc_driver->frm_offset += len;
+		if (uvc_driver->frm_offset >= stream.frame_size) {
+			header->bmHeaderInfo.bm.EoF = 1;
+			uvc_driver->frm_count++;
+			uvc_driver->frm_offset = 0;
+			uvc_driver->is_frame_xfring = 0;
+			stream.frame = NULL;
+			stream.frames[chain]++;
+		}
+	}
+
+	cache_clean_region(stream_headers[chain], sizeof(stream_headers[chain]));
+
+	if (usbd_hal_prepare_payloads(VIDCAMD_IsoInEndpointNum, chain,
+			stream.payloads[chain], UVC_CHAIN_PAYLOADS) != USBD_STATUS_SUCCESS)
+		stream_stats.underruns++;
+}
 
-static uint32_t uvc_frame_count = 0;
 /*-----------------------------------------------------------------------------
  *      Exported functions
  *-----------------------------------------------------------------------------*/
@@ -272,55 +367,75 @@ void uvc_function_get_res(const USBGenericRequest *request)
 
 void uvc_reset_frame_count(void)
 {
-	uvc_frame_count = 0;
+	uvc_function_reset_stats();
 }
 
 uint32_t uvc_get_frame_count(void)
 {
-	return uvc_frame_count;
+	return stream_stats.frames;
+}
+
+void uvc_function_reset_stats(void)
+{
+	memset(&stream_stats, 0, sizeof(stream_stats));
+	stats_start = timer_get_tick();
+}
+
+void uvc_function_get_stats(struct _uvc_stream_stats *stats)
+{
+	uint32_t elapsed = timer_get_tick() - stats_start;
+
+	*stats = stream_stats;
+	stats->fps = elapsed ? (stats->frames * 1000 + elapsed / 2) / elapsed : 0;
 }
 
 /**
- * Callback that invoked when USB packet is sent.
+ * Callback invoked when a chain of payloads has been sent: the other chains
+ * are still queued on the endpoint, refill the completed one.
  */
 void uvc_function_payload_sent(void *arg, uint8_t state,
 		uint32_t transferred, uint32_t remaining)
 {
-	uint32_t dma_transfer_size;
-	uint32_t frame_size = FRAME_BUFFER_SIZEC(frm_width, frm_height);
-	uint8_t *uncompressed_stream = (uint8_t*)(uvc_driver->buf_start_addr +
-									frame_buffer_addr * FRAME_BUFFER_SIZEC(frm_width, frm_height));
-	USBVideoPayloadHeader *header = (USBVideoPayloadHeader*)stream_header;
-	uint32_t max_pkt_size = usbd_is_high_speed() ? frm_max_pkt_size : FRAME_PACKET_SIZE_FS;
-	if (remaining){
+	uint8_t done = stream.done;
 
+	if (!stream.running)
+		return;
+
+	/* streaming stopped (alternate setting 0) or endpoint reset */
+	if (state != USBD_STATUS_SUCCESS || !uvc_driver->is_video_on) {
+		stream.running = false;
+		uvc_driver->is_frame_xfring = 0;
 		return;
 	}
-	dma_transfer_size = frame_size - uvc_driver->frm_offset;
-	header->bHeaderLength = FRAME_PAYLOAD_HDR_SIZE;
-	header->bmHeaderInfo.B = 0;
-	if (dma_transfer_size > max_pkt_size - header->bHeaderLength)
-		dma_transfer_size = max_pkt_size - header->bHeaderLength;
-	uncompressed_stream = &uncompressed_stream[uvc_driver->frm_offset];
-	uvc_driver->frm_offset += dma_transfer_size;
-	header->bmHeaderInfo.bm.FID = (uvc_driver->frm_count & 1);
-	if (uvc_driver->frm_offset >= frame_size) {
-		uvc_driver->frm_count++;
-		uvc_driver->frm_offset = 0;
-		header->bmHeaderInfo.bm.EoF = 1;
-		uvc_frame_count++;
-		frame_buffer_addr = uvc_driver ->stream_frm_index;
-		frame_buffer_addr = (frame_buffer_addr == 0) ?
-							(uvc_driver->multi_buffers - 1): (frame_buffer_addr -1);
-		if (uvc_driver->is_frame_xfring)
-			uvc_driver->is_frame_xfring = 0;
-	} else {
-		header->bmHeaderInfo.bm.EoF = 0;
+
+	stream_stats.frames += stream.frames[done];
+	stream.done = (done + 1) % UVC_CHAINS;
+
+	_uvc_build_chain(done);
+}
+
+void uvc_function_start_stream(void)
+{
+	uint32_t max_pkt_size = usbd_is_high_speed() ? frm_max_pkt_size : FRAME_PACKET_SIZE_FS;
+	uint8_t i;
+
+	stream.running = false;
+	stream.frame_size = FRAME_BUFFER_SIZEC(frm_width, frm_height);
+	stream.payload_size = max_pkt_size - FRAME_PAYLOAD_HDR_SIZE;
+	stream.frame = NULL;
+	stream.capture_seq = captured_frames - 1;
+	uvc_driver->frm_offset = 0;
+	uvc_driver->is_frame_xfring = 0;
+
+	for (i = 0; i < UVC_CHAINS; i++)
+		_uvc_build_chain(i);
+	stream.done = 0;
+	stream.running = true;
+
+	if (usbd_hal_start_payloads(VIDCAMD_IsoInEndpointNum, UVC_CHAINS) != USBD_STATUS_SUCCESS) {
+		stream_stats.underruns++;
+		stream.running = false;
 	}
-	header->bmHeaderInfo.bm.EOH =  1;
-	usleep(500);
-	usbd_hal_write_with_header(VIDCAMD_IsoInEndpointNum, header,
-		header->bHeaderLength, uncompressed_stream, dma_transfer_size);
 }
 
 void uvc_function_initialize(struct _uvc_driver* uvc_drv)
@@ -342,6 +457,7 @@ uint8_t uvc_function_get_frame_format(void)
 void uvc_function_update_frame_idx(uint32_t idx)
 {
 	uvc_driver->stream_frm_index = idx;
+	captured_frames++;
 }
 
 /**@}*/
@@ -43,8 +43,33 @@
  *------------------------------------------------------------------------------*/
 
 #include <stdint.h>
+#include "usb/device/usbd_hal.h"
 #include "usb/device/uvc/uvc_driver.h"
 
+/*------------------------------------------------------------------------------
+ *         Definitions
+ *------------------------------------------------------------------------------*/
+
+/** Number of payloads chained in one isochronous DMA transfer */
+#define UVC_CHAIN_PAYLOADS USBD_HAL_MAX_PAYLOADS
+
+/** Number of payload chains looped on the endpoint, all but the one being
+ *  refilled stay queued */
+#define UVC_CHAINS USBD_HAL_MAX_CHAINS
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+/** Video streaming statistics */
+struct _uvc_stream_stats {
+	uint32_t frames;    /**< Frames sent */
+	uint32_t dropped;   /**< Captured frames that were never sent */
+	uint32_t repeated;  /**< Frames sent again, no new capture was ready */
+	uint32_t underruns; /**< Payload chains that could not be prepared or started */
+	uint32_t fps;       /**< Frames sent per second since the last reset */
+};
+
 /*------------------------------------------------------------------------------
  *      Global functions
  *------------------------------------------------------------------------------*/
@@ -61,6 +86,9 @@ extern void uvc_function_set_cur(const USBGenericRequest *request);
 extern uint8_t uvc_function_is_video_on(void);
 extern uint8_t uvc_function_get_frame_format(void);
 extern void uvc_function_update_frame_idx(uint32_t idx);
+extern void uvc_function_start_stream(void);
+extern void uvc_function_get_stats(struct _uvc_stream_stats *stats);
+extern void uvc_function_reset_stats(void);
 extern void uvc_reset_frame_count(void);
 extern uint32_t uvc_get_frame_count(void);
 /**@}*/
@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+# ----------------------------------------------------------------------------
+#         SAM Software Package License
+# ----------------------------------------------------------------------------
+# Copyright (c) 2016, Atmel Corporation
+#
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# - Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the disclaimer below.
+#
+# Atmel's name may not be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+# IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+# DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+# NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+# EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# ----------------------------------------------------------------------------
+
+"""Decode deferred traces (CONFIG_TRACE_DEFERRED).
+
+The format table is read from the application ELF file: every trace call
+site owns a static '_trace_fmt' descriptor (level, argument count, format
+string address). A binary dump produced by trace_dump() is a sequence of
+records made of the bytes 0xA5 0x5A followed by a 32-byte entry: descriptor
+address, timestamp in ms and six 32-bit arguments. 64-bit ELF files (host
+builds of the trace code) are also accepted, their entries then start with
+a 64-bit address and are padded to 40 bytes.
+
+usage: trace_decode.py <app.elf> --table
+       trace_decode.py <app.elf> <dump.bin>
+"""
+
+import re
+import struct
+import sys
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+SHF_ALLOC = 2
+STT_OBJECT = 1
+
+SYNC = b"\xa5\x5a"
+ENTRY32 = struct.Struct("<II6I")
+ENTRY64 = struct.Struct("<QI6I4x")
+
+LEVELS = {1: "F", 2: "E", 3: "W", 4: "I", 5: "D"}
+
+CONV = re.compile(r"%([-+ #0]*)(\d+)?(?:\.(\d+))?(hh|h|ll|l|z|t|j)?([diouxXcsp%])")
+
+
+class Elf(object):
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if (self.data[:4] != b"\x7fELF" or self.data[4] not in (1, 2)
+                or self.data[5] != 1):
+            raise ValueError("%s: not a little-endian ELF file" % path)
+        self.is64 = self.data[4] == 2
+        if self.is64:
+            (shoff,) = struct.unpack_from("<Q", self.data, 0x28)
+            shentsize, shnum = struct.unpack_from("<HH", self.data, 0x3a)
+            header = "<IIQQQQIIQQ"
+        else:
+            (shoff,) = struct.unpack_from("<I", self.data, 0x20)
+            shentsize, shnum = struct.unpack_from("<HH", self.data, 0x2e)
+            header = "<IIIIIIIIII"
+        self.sections = []
+        for i in range(shnum):
+            fields = struct.unpack_from(header, self.data,
+                                        shoff + i * shentsize)
+            self.sections.append(fields)
+
+    def read(self, addr, size):
+        for (_, sh_type, flags, sh_addr, offset, sh_size, _, _, _, _) in self.sections:
+            if not flags & SHF_ALLOC or sh_type == SHT_NOBITS:
+                continue
+            if sh_addr <= addr and addr + size <= sh_addr + sh_size:
+                start = offset + addr - sh_addr
+                return self.data[start:start + size]
+        return None
+
+    def read_string(self, addr):
+        out = bytearray()
+        while True:
+            c = self.read(addr + len(out), 1)
+            if c is None or c == b"\0":
+                return out.decode("latin-1") if c is not None else None
+            out += c
+
+    def symbols(self):
+        for sec in self.sections:
+            if sec[1] != SHT_SYMTAB:
+                continue
+            strtab = self.sections[sec[6]]
+            for off in range(sec[4], sec[4] + sec[5], sec[9]):
+                if self.is64:
+                    name, info, _, _, value, size = struct.unpack_from(
+                        "<IBBHQQ", self.data, off)
+                else:
+                    name, value, size, info, _, _ = struct.unpack_from(
+                        "<IIIBBH", self.data, off)
+                end = self.data.index(b"\0", strtab[4] + name)
+                yield (self.data[strtab[4] + name:end].decode("latin-1"),
+                       value, size, info & 0xf)
+
+
+def load_table(elf):
+    table = {}
+    for name, value, size, kind in elf.symbols():
+        if kind != STT_OBJECT or not name.startswith("_trace_fmt"):
+            continue
+        desc = "<BB6xQ" if elf.is64 else "<BBxxI"
+        raw = elf.read(value, struct.calcsize(desc))
+        if raw is None:
+            continue
+        level, nargs, fmt = struct.unpack(desc, raw)
+        text = elf.read_string(fmt)
+        if text is not None:
+            table[value] = (level, nargs, text)
+    return table
+
+
+def format_trace(elf, fmt, args):
+    args = list(args)
+
+    def conv(m):
+        flags, width, prec, _, kind = m.groups()
+        if kind == "%":
+            return "%"
+        value = args.pop(0) if args else 0
+        spec = "%" + flags + (width or "") + ("." + prec if prec else "")
+        if kind in "di":
+            value = value - (1 << 32) if value & 0x80000000 else value
+            return (spec + "d") % value
+        if kind == "c":
+            return (spec + "c") % chr(value & 0xff)
+        if kind == "s":
+            text = elf.read_string(value)
+            return (spec + "s") % (text if text is not None else "<0x%08x>" % value)
+        if kind == "p":
+            return "0x%08x" % value
+        return (spec + kind) % value
+
+    return CONV.sub(conv, fmt)
+
+
+def decode(elf, table, dump):
+    entry = ENTRY64 if elf.is64 else ENTRY32
+    pos = 0
+    while True:
+        pos = dump.find(SYNC, pos)
+        if pos < 0 or pos + 2 + entry.size > len(dump):
+            return
+        fields = entry.unpack_from(dump, pos + 2)
+        desc = table.get(fields[0])
+        if desc is None:
+            # not a record boundary, resynchronize
+            pos += 1
+            continue
+        level, nargs, fmt = desc
+        text = format_trace(elf, fmt, fields[2:2 + nargs])
+        if fmt.startswith("-"):
+            text = "[%8u] %s" % (fields[1], text)
+        sys.stdout.write(text.replace("\r", ""))
+        pos += 2 + entry.size
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write(__doc__)
+        return 1
+    elf = Elf(argv[1])
+    table = load_table(elf)
+    if argv[2] == "--table":
+        for addr in sorted(table):
+            level, nargs, fmt = table[addr]
+            print("0x%08x %s %u %r" % (addr, LEVELS.get(level, "?"), nargs, fmt))
+        return 0
+    with open(argv[2], "rb") as f:
+        decode(elf, table, f.read())
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -61,6 +61,20 @@
 /* Number of buffer for TX */
 #define ETH_TX_BUFFERS  8
 
+/* Number of buffer for RX/TX on GMAC priority queues: the RX rings hold a
+ * maximum frame (12 units) plus headroom, as frames are screened to them */
+#define ETH_PQ_RX_BUFFERS  16
+#define ETH_PQ_TX_BUFFERS  2
+
+/* A frame that does not fit in a RX ring never reaches its end-of-frame
+ * descriptor and is dropped */
+#if ETH_RX_BUFFERS * ETH_RX_UNITSIZE < ETH_MAX_FRAME_LENGTH
+#error "ETH_RX_BUFFERS cannot hold a maximum frame"
+#endif
+#if ETH_PQ_RX_BUFFERS * ETH_RX_UNITSIZE < ETH_MAX_FRAME_LENGTH
+#error "ETH_PQ_RX_BUFFERS cannot hold a maximum frame"
+#endif
+
 #ifndef BOARD_ETH0_PHY_IDLE_TIMEOUT
 #define BOARD_ETH0_PHY_IDLE_TIMEOUT PHY_DEFAULT_TIMEOUT_IDLE
 #endif
@@ -139,6 +153,24 @@ static uint8_t eth_rx_buffer[ETH_IFACE_COUNT][ETH_RX_BUFFERS * ETH_RX_UNITSIZE];
 /** TX callbacks list */
 static ethd_callback_t eth_tx_callback[ETH_IFACE_COUNT][ETH_TX_BUFFERS];
 
+#ifdef CONFIG_HAVE_GMAC_QUEUES
+/** Priority queues TX descriptors list */
+ALIGNED(8) NOT_CACHED
+static struct _eth_desc eth_pq_txd[ETH_IFACE_COUNT][GMAC_QUEUE_COUNT - 1][ETH_PQ_TX_BUFFERS];
+
+/** Priority queues RX descriptors list */
+ALIGNED(8) NOT_CACHED
+static struct _eth_desc eth_pq_rxd[ETH_IFACE_COUNT][GMAC_QUEUE_COUNT - 1][ETH_PQ_RX_BUFFERS];
+
+/** Priority queues TX Buffers */
+CACHE_ALIGNED_DDR
+static uint8_t eth_pq_tx_buffer[ETH_IFACE_COUNT][GMAC_QUEUE_COUNT - 1][ETH_PQ_TX_BUFFERS * ETH_TX_UNITSIZE];
+
+/** Priority queues RX Buffers */
+CACHE_ALIGNED_DDR
+static uint8_t eth_pq_rx_buffer[ETH_IFACE_COUNT][GMAC_QUEUE_COUNT - 1][ETH_PQ_RX_BUFFERS * ETH_RX_UNITSIZE];
+#endif
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -212,6 +244,16 @@ void board_cfg_net(uint8_t iface, uint8_t* mac_addr, bool block)
 	ethd_setup_queue(&_ethd[iface], 0, ETH_RX_BUFFERS, eth_rx_buffer[iface], eth_rxd[iface],
 			 ETH_TX_BUFFERS, eth_tx_buffer[iface], eth_txd[iface], eth_tx_callback[iface]);
 	ethd_set_rx_callback(&_ethd[iface], 0, _eth_rx_callback);
+#ifdef CONFIG_HAVE_GMAC_QUEUES
+	{
+		int queue;
+
+		for (queue = 1; queue < GMAC_QUEUE_COUNT; queue++)
+			ethd_setup_queue(&_ethd[iface], queue,
+					 ETH_PQ_RX_BUFFERS, eth_pq_rx_buffer[iface][queue - 1], eth_pq_rxd[iface][queue - 1],
+					 ETH_PQ_TX_BUFFERS, eth_pq_tx_buffer[iface][queue - 1], eth_pq_txd[iface][queue - 1], NULL);
+	}
+#endif
 	ethd_set_mac_addr(&_ethd[iface], 0, _eth_mac_addr);
 	ethd_start(&_ethd[iface]);
 
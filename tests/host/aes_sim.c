@@ -0,0 +1,232 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "chip.h"
+
+#include "crypto/aes.h"
+#include "crypto/aes_soft.h"
+#include "crypto/aesd.h"
+#include "dma/dma.h"
+
+#include "aes_sim.h"
+#include "dma_sim.h"
+#include "host.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define DEFAULT_RUN_NS    1000
+#define DEFAULT_BLOCK_NS  200
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static struct {
+	struct _aes_sim_timing timing;
+
+	/* registers */
+	uint32_t mode;
+	uint32_t start_mode;
+	uint32_t key_size;
+	bool encrypt;
+	uint32_t key[8];
+	uint32_t key_len;
+	uint8_t counter[16];
+
+	/* run in progress */
+	bool busy;
+	uint32_t blocks;
+	uint64_t done_at;
+	uint64_t free_at;
+
+	/* a run completing: the next one starts at its end */
+	bool completing;
+
+	/** Virtual clock minus the host clock */
+	int64_t offset;
+
+	struct _aes_sim_stats stats;
+} _sim;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static void _start_hook(struct _dma_channel* channel, uint8_t src, uint8_t dest)
+{
+	uint64_t start, ns;
+	uint32_t blocks;
+
+	/* The run starts with its receive channel, the second one */
+	if (src != ID_AES)
+		return;
+
+	start = _sim.completing ? _sim.done_at : aes_sim_time_ns();
+	if (start < _sim.free_at)
+		start = _sim.free_at;
+	blocks = dma_sim_remaining(channel) / 4;
+	ns = _sim.timing.run + (uint64_t)blocks * _sim.timing.block;
+
+	_sim.busy = true;
+	_sim.blocks = blocks;
+	_sim.done_at = start + ns;
+	_sim.free_at = _sim.done_at;
+	_sim.stats.runs++;
+	_sim.stats.blocks += blocks;
+	_sim.stats.busy_ns += ns;
+
+	if (_sim.mode != AESD_MODE_CTR || _sim.start_mode != AESD_TRANS_DMA ||
+	    !_sim.encrypt)
+		_sim.stats.errors++;
+}
+
+/** Move one block through the data registers */
+static void _process_block(const struct _aes_soft_ctx* ctx)
+{
+	uint32_t in[4], ks[4], i;
+	uint16_t low;
+
+	for (i = 0; i < 4; i++) {
+		dma_sim_request(ID_AES, true, 1);
+		in[i] = AES->AES_IDATAR[0];
+	}
+
+	aes_soft_encrypt(ctx, _sim.counter, (uint8_t*)ks);
+	low = ((_sim.counter[14] << 8) | _sim.counter[15]) + 1;
+	_sim.counter[14] = low >> 8;
+	_sim.counter[15] = low & 0xff;
+
+	for (i = 0; i < 4; i++) {
+		*(volatile uint32_t*)&AES->AES_ODATAR[0] = in[i] ^ ks[i];
+		dma_sim_request(ID_AES, false, 1);
+	}
+}
+
+static void _poll_hook(void)
+{
+	struct _aes_soft_ctx ctx;
+	uint64_t now, start;
+	uint32_t i, blocks;
+
+	if (!_sim.busy)
+		return;
+
+	/* The CPU waits for the end of the run */
+	now = aes_sim_time_ns();
+	if (now < _sim.done_at) {
+		_sim.stats.wait_ns += _sim.done_at - now;
+		_sim.offset += _sim.done_at - now;
+	}
+
+	start = host_time_ns();
+	aes_soft_set_key(&ctx, (const uint8_t*)_sim.key, _sim.key_len);
+	blocks = _sim.blocks;
+	_sim.busy = false;
+
+	/* The completion callback of the last block may start the next run */
+	_sim.completing = true;
+	for (i = 0; i < blocks; i++)
+		_process_block(&ctx);
+	_sim.completing = false;
+	_sim.offset -= host_time_ns() - start;
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+void aes_soft_reset(void)
+{
+	_sim.mode = 0;
+	_sim.start_mode = 0;
+	_sim.key_size = 0;
+	_sim.encrypt = false;
+}
+
+void aes_set_op_mode(uint32_t mode)
+{
+	_sim.mode = mode;
+}
+
+void aes_set_start_mode(uint32_t mode)
+{
+	_sim.start_mode = mode;
+}
+
+void aes_set_key_size(uint32_t size)
+{
+	_sim.key_size = size;
+}
+
+void aes_encrypt_enable(bool encrypt)
+{
+	_sim.encrypt = encrypt;
+}
+
+void aes_write_key(const uint32_t* key, uint32_t len)
+{
+	memcpy(_sim.key, key, len);
+	_sim.key_len = len;
+}
+
+void aes_set_vector(const uint32_t* vector)
+{
+	memcpy(_sim.counter, vector, sizeof(_sim.counter));
+}
+
+void aes_sim_init(const struct _aes_sim_timing* timing)
+{
+	memset(&_sim, 0, sizeof(_sim));
+	if (timing) {
+		_sim.timing = *timing;
+	} else {
+		_sim.timing.run = DEFAULT_RUN_NS;
+		_sim.timing.block = DEFAULT_BLOCK_NS;
+	}
+	_sim.offset = -(int64_t)host_time_ns();
+	dma_sim_set_hooks(_start_hook, _poll_hook);
+}
+
+uint64_t aes_sim_time_ns(void)
+{
+	return host_time_ns() + _sim.offset;
+}
+
+void aes_sim_get_stats(struct _aes_sim_stats* stats)
+{
+	*stats = _sim.stats;
+}
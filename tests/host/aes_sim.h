@@ -0,0 +1,100 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Simulated AES peripheral for host tests.
+ *
+ *  aes_sim.c replaces the functions of aes.c used by aesd_stream.c (reset,
+ *  mode, key and counter setup) with a model of the peripheral in CTR mode
+ *  fed by the DMA: once both channels of a run are started, the model
+ *  pulls the input blocks from the transmit channel through AES_IDATAR,
+ *  encrypts the counter blocks with the software cipher (16-bit counter,
+ *  as the peripheral) and pushes the output through AES_ODATAR to the
+ *  receive channel.
+ *
+ *  The model runs from dma_poll(), when the run it processes is complete
+ *  on a virtual clock: runs are processed one after the other, each one
+ *  taking a setup time plus a time per block from its start (or from the
+ *  end of the previous run). The clock follows the host CPU time, minus
+ *  the time spent in the model; when the CPU polls for a run that is not
+ *  complete, the clock jumps to its end, as the CPU would wait. So
+ *  aes_sim_time_ns() measures the software as run on the host and the
+ *  peripheral as simulated, with their overlap.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _AES_SIM_H_
+#define _AES_SIM_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+/** Processing times of the peripheral, in nanoseconds */
+struct _aes_sim_timing {
+	uint32_t run;         /**< Start of a run (DMA descriptors, key setup) */
+	uint32_t block;       /**< One block, including its DMA transfers */
+};
+
+struct _aes_sim_stats {
+	uint32_t runs;
+	uint64_t blocks;
+	uint64_t busy_ns;     /**< Time the peripheral was processing */
+	uint64_t wait_ns;     /**< Time the CPU waited for the peripheral */
+	uint32_t errors;      /**< Runs started with an unsupported setup */
+};
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Reset the model and the clock and hook it to the DMA model.
+ * \param timing  Processing times, NULL for the defaults (1 us per run and
+ * 200 ns per block)
+ */
+extern void aes_sim_init(const struct _aes_sim_timing* timing);
+
+/**
+ * \brief Current time of the virtual clock, in nanoseconds.
+ */
+extern uint64_t aes_sim_time_ns(void);
+
+extern void aes_sim_get_stats(struct _aes_sim_stats* stats);
+
+#endif /* _AES_SIM_H_ */
@@ -0,0 +1,351 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <string.h>
+
+#include "chip.h"
+
+#include "callback.h"
+#include "dma/dma.h"
+
+#include "dma_sim.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+/** Blocks of a configured transfer */
+#define MAX_BLOCKS 16
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+struct _sim_channel {
+	uint8_t src;
+	uint8_t dest;
+	struct _dma_cfg cfg;
+	struct _dma_transfer_cfg blocks[MAX_BLOCKS];
+	uint32_t count;
+	uint32_t block;     /**< Current block */
+	uint32_t pos;       /**< Data transferred in the current block */
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static struct _dma_channel _channels[DMA_CHANNELS];
+
+static struct _sim_channel _sim[DMA_CHANNELS];
+
+static dma_sim_start_hook_t _start_hook;
+static dma_sim_poll_hook_t _poll_hook;
+
+static bool _polling;
+
+/** Memory to memory transfers wait for dma_poll() */
+static bool _deferred;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static void _copy(const void* src, void* dest, uint32_t width)
+{
+	switch (width) {
+	case DMA_DATA_WIDTH_BYTE:
+		*(volatile uint8_t*)dest = *(const volatile uint8_t*)src;
+		break;
+	case DMA_DATA_WIDTH_HALF_WORD:
+		*(volatile uint16_t*)dest = *(const volatile uint16_t*)src;
+		break;
+	default:
+		*(volatile uint32_t*)dest = *(const volatile uint32_t*)src;
+		break;
+	}
+}
+
+/** Move one data of the current block, true at the end of the transfer */
+static bool _transfer(struct _dma_channel* channel)
+{
+	struct _sim_channel* sim = &_sim[channel->id];
+	struct _dma_transfer_cfg* block = &sim->blocks[sim->block];
+	uint32_t width = DMA_DATA_WIDTH_IN_BYTE(sim->cfg.data_width);
+	const uint8_t* src = block->saddr;
+	uint8_t* dest = block->daddr;
+
+	if (sim->cfg.incr_saddr)
+		src += sim->pos * width;
+	if (sim->cfg.incr_daddr)
+		dest += sim->pos * width;
+	_copy(src, dest, sim->cfg.data_width);
+
+	if (++sim->pos < block->len)
+		return false;
+	if (sim->block + 1 < sim->count) {
+		sim->block++;
+		sim->pos = 0;
+		return false;
+	}
+	/* A finished transfer keeps its position, as CUBC reads 0 */
+	if (channel->loop) {
+		sim->block = 0;
+		sim->pos = 0;
+	}
+	return true;
+}
+
+/** End of the transfer, or of a lap of a looped transfer */
+static void _complete(struct _dma_channel* channel)
+{
+	if (!channel->loop)
+		channel->state = DMA_STATE_DONE;
+	callback_call(&channel->callback, NULL);
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+void dma_initialize(bool polling)
+{
+	uint32_t i;
+
+	memset(_channels, 0, sizeof(_channels));
+	memset(_sim, 0, sizeof(_sim));
+	_polling = polling;
+	for (i = 0; i < DMA_CHANNELS; i++)
+		_channels[i].id = i;
+}
+
+struct _dma_channel* dma_allocate_channel(uint8_t src, uint8_t dest)
+{
+	uint32_t i;
+
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		struct _dma_channel* channel = &_channels[i];
+
+		if (channel->state != DMA_STATE_FREE)
+			continue;
+		memset(&_sim[i], 0, sizeof(_sim[i]));
+		_sim[i].src = src;
+		_sim[i].dest = dest;
+		channel->id = i;
+		channel->loop = false;
+		channel->state = DMA_STATE_ALLOCATED;
+		return channel;
+	}
+	return NULL;
+}
+
+int dma_free_channel(struct _dma_channel* channel)
+{
+	if (channel->state == DMA_STATE_STARTED)
+		return -EBUSY;
+	channel->state = DMA_STATE_FREE;
+	return 0;
+}
+
+int dma_configure_transfer(struct _dma_channel* channel,
+			   struct _dma_cfg* cfg_dma,
+			   struct _dma_transfer_cfg* list, uint32_t list_size)
+{
+	struct _sim_channel* sim = &_sim[channel->id];
+
+	if (list_size == 0 || list_size > MAX_BLOCKS)
+		return -EINVAL;
+	if (channel->state == DMA_STATE_STARTED)
+		return -EBUSY;
+
+	sim->cfg = *cfg_dma;
+	memcpy(sim->blocks, list, list_size * sizeof(*list));
+	sim->count = list_size;
+	sim->block = 0;
+	sim->pos = 0;
+	channel->loop = cfg_dma->loop;
+	return 0;
+}
+
+int dma_set_callback(struct _dma_channel* channel, struct _callback* cb)
+{
+	if (channel->state == DMA_STATE_FREE)
+		return -EPERM;
+	else if (channel->state == DMA_STATE_STARTED)
+		return -EBUSY;
+
+	callback_copy(&channel->callback, cb);
+	return 0;
+}
+
+int dma_start_transfer(struct _dma_channel* channel)
+{
+	struct _sim_channel* sim = &_sim[channel->id];
+
+	if (channel->state == DMA_STATE_FREE)
+		return -EPERM;
+	else if (channel->state == DMA_STATE_STARTED)
+		return -EBUSY;
+
+	channel->state = DMA_STATE_STARTED;
+	sim->block = 0;
+	sim->pos = 0;
+
+	/* Memory to memory: no request to wait for */
+	if (sim->src == DMA_PERIPH_MEMORY && sim->dest == DMA_PERIPH_MEMORY) {
+		if (_deferred)
+			return 0;
+		while (!_transfer(channel));
+		_complete(channel);
+	} else if (_start_hook) {
+		_start_hook(channel, sim->src, sim->dest);
+	}
+	return 0;
+}
+
+int dma_stop_transfer(struct _dma_channel* channel)
+{
+	channel->state = DMA_STATE_ALLOCATED;
+	return 0;
+}
+
+int dma_suspend_transfer(struct _dma_channel* channel)
+{
+	channel->state = DMA_STATE_SUSPENDED;
+	return 0;
+}
+
+int dma_resume_transfer(struct _dma_channel* channel)
+{
+	channel->state = DMA_STATE_STARTED;
+	return 0;
+}
+
+int dma_reset_channel(struct _dma_channel* channel)
+{
+	if (channel->state == DMA_STATE_STARTED)
+		return -EBUSY;
+	channel->loop = false;
+	channel->state = DMA_STATE_ALLOCATED;
+	return 0;
+}
+
+bool dma_is_transfer_done(struct _dma_channel* channel)
+{
+	return ((channel->state != DMA_STATE_STARTED)
+		&& (channel->state != DMA_STATE_SUSPENDED));
+}
+
+void dma_fifo_flush(struct _dma_channel* channel)
+{
+}
+
+void dma_poll(void)
+{
+	uint32_t i;
+
+	for (i = 0; _deferred && i < DMA_CHANNELS; i++) {
+		struct _dma_channel* channel = &_channels[i];
+
+		if (channel->state != DMA_STATE_STARTED ||
+		    _sim[i].src != DMA_PERIPH_MEMORY ||
+		    _sim[i].dest != DMA_PERIPH_MEMORY)
+			continue;
+		while (!_transfer(channel));
+		_complete(channel);
+	}
+	if (_poll_hook)
+		_poll_hook();
+}
+
+bool dma_is_polling(void)
+{
+	return _polling;
+}
+
+uint32_t dma_get_transferred_data_len(struct _dma_channel* channel,
+		uint8_t chunk_size, uint32_t len)
+{
+	struct _sim_channel* sim = &_sim[channel->id];
+	uint32_t remaining = sim->blocks[sim->block].len - sim->pos;
+
+	/* The remaining microblock length, as read from CUBC */
+	return len - remaining * (1 << chunk_size);
+}
+
+uint32_t dma_sim_request(uint8_t periph, bool tx, uint32_t count)
+{
+	uint32_t i, done = 0;
+
+	for (i = 0; i < DMA_CHANNELS && done < count; i++) {
+		struct _dma_channel* channel = &_channels[i];
+		struct _sim_channel* sim = &_sim[i];
+
+		if (channel->state != DMA_STATE_STARTED)
+			continue;
+		if ((tx ? sim->dest : sim->src) != periph)
+			continue;
+		while (done < count && channel->state == DMA_STATE_STARTED) {
+			done++;
+			if (_transfer(channel))
+				_complete(channel);
+		}
+	}
+	return done;
+}
+
+uint32_t dma_sim_remaining(struct _dma_channel* channel)
+{
+	struct _sim_channel* sim = &_sim[channel->id];
+	uint32_t i, remaining;
+
+	if (channel->state != DMA_STATE_STARTED &&
+	    channel->state != DMA_STATE_SUSPENDED)
+		return 0;
+	remaining = sim->blocks[sim->block].len - sim->pos;
+	for (i = sim->block + 1; i < sim->count; i++)
+		remaining += sim->blocks[i].len;
+	return remaining;
+}
+
+void dma_sim_set_hooks(dma_sim_start_hook_t start, dma_sim_poll_hook_t poll)
+{
+	_start_hook = start;
+	_poll_hook = poll;
+}
+
+void dma_sim_set_deferred(bool deferred)
+{
+	_deferred = deferred;
+}
@@ -0,0 +1,114 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Simulated DMA controller for host tests.
+ *
+ *  dma_sim.c replaces dma.c: channels are allocated and configured through
+ *  the dma.h API, a memory to memory transfer completes as soon as it is
+ *  started, and a transfer from or to a peripheral moves one data each
+ *  time the model of the peripheral calls dma_sim_request(), as the
+ *  peripheral DMA request would. The peripheral registers are accessed
+ *  through their addresses, so trapped registers see the DMA accesses.
+ *
+ *  The end of a transfer sets the channel state to DMA_STATE_DONE and
+ *  calls the channel callback; a looped transfer calls it at the end of
+ *  each lap and starts over. The callbacks are called from the caller of
+ *  dma_sim_request() or dma_start_transfer(), as an interrupt would.
+ *
+ *  A model that moves its data in bulk rather than per request can set
+ *  hooks: one called when a channel is started, and one called by
+ *  dma_poll(), from which it serves the requests of the started channels.
+ *
+ *  In deferred mode, memory to memory transfers only run when dma_poll()
+ *  is called, as if the controller were arbitrarily slow: a caller that
+ *  touches the destination before waiting for the transfer sees stale
+ *  data.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _DMA_SIM_H_
+#define _DMA_SIM_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+struct _dma_channel;
+
+/** Hook called by dma_start_transfer() with the peripherals of the channel */
+typedef void (*dma_sim_start_hook_t)(struct _dma_channel* channel,
+		uint8_t src, uint8_t dest);
+
+/** Hook called by dma_poll() */
+typedef void (*dma_sim_poll_hook_t)(void);
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Serve the DMA requests of a peripheral.
+ * \param periph  Peripheral ID, as passed to dma_allocate_channel()
+ * \param tx      True for the transmit requests (memory to peripheral),
+ *                false for the receive requests (peripheral to memory)
+ * \param count   Number of data to transfer
+ * \return Number of data transferred, 0 if no started channel serves the
+ * request
+ */
+extern uint32_t dma_sim_request(uint8_t periph, bool tx, uint32_t count);
+
+/**
+ * \brief Number of data left in the transfer of a channel.
+ */
+extern uint32_t dma_sim_remaining(struct _dma_channel* channel);
+
+/**
+ * \brief Set the hooks of a bulk model, either can be NULL.
+ */
+extern void dma_sim_set_hooks(dma_sim_start_hook_t start,
+		dma_sim_poll_hook_t poll);
+
+/**
+ * \brief Run the memory to memory transfers at dma_poll() rather than when
+ * they are started.
+ */
+extern void dma_sim_set_deferred(bool deferred);
+
+#endif /* _DMA_SIM_H_ */
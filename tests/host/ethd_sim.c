@@ -0,0 +1,390 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include "chip.h"
+#include "board_eth.h"
+#include "ethd_sim.h"
+
+#include "mm/cache.h"
+#include "network/ethd.h"
+
+#include <string.h>
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+/** RX buffers per queue, as configured by board_eth.c */
+#define RX_BUFFERS      16
+
+/** Frames queued for transmission on all queues */
+#define TX_FRAMES       32
+
+/** Buffers of a frame sent with ethd_send_sg_nocopy() */
+#define TX_SG_MAX       8
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+/** RX descriptor, holding data from the wire once used */
+struct _rx_desc {
+	uint8_t* buffer;
+	uint32_t length;        /* frame length, in the first descriptor */
+	bool used;
+};
+
+struct _rx_queue {
+	struct _rx_desc desc[RX_BUFFERS];
+	uint32_t head;          /* next descriptor read by the driver */
+	uint32_t tail;          /* next descriptor written by the MAC */
+	uint32_t used;
+	ethd_callback_t callback;
+};
+
+struct _tx_frame {
+	uint8_t queue;
+	bool copied;
+	uint32_t count;
+	struct _eth_sg sg[TX_SG_MAX];
+	uint32_t length;
+	uint32_t sum;           /* checksum of the buffers when queued */
+	ethd_callback_t callback;
+	ALIGNED(L1_CACHE_BYTES) uint8_t data[ETH_TX_UNITSIZE];
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static const uint8_t mac_addr[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+CACHE_ALIGNED
+static uint8_t rx_buffers[ETH_QUEUE_COUNT][RX_BUFFERS][ETH_RX_UNITSIZE];
+
+static struct _rx_queue rx_queues[ETH_QUEUE_COUNT];
+
+static struct _tx_frame tx_frames[TX_FRAMES];
+static uint32_t tx_head;
+static uint32_t tx_count;
+
+static uint8_t wire[ETH_MAX_FRAME_LENGTH];
+static ethd_sim_wire_cb_t wire_cb;
+static void* wire_arg;
+
+static struct _ethd ethd;
+static struct _ethd_sim_stats stats;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/** FNV-1a over the buffers of a scatter-gather list */
+static uint32_t _checksum(const struct _eth_sg* sg, uint32_t count)
+{
+	uint32_t sum = 2166136261u;
+	uint32_t i, j;
+
+	for (i = 0; i < count; i++)
+		for (j = 0; j < sg[i].size; j++)
+			sum = (sum ^ ((const uint8_t*)sg[i].buffer)[j]) * 16777619u;
+	return sum;
+}
+
+/** Is \a buffer owned by an RX descriptor? */
+static bool _rx_owned(const void* buffer)
+{
+	uint32_t q, i;
+
+	for (q = 0; q < ETH_QUEUE_COUNT; q++)
+		for (i = 0; i < RX_BUFFERS; i++)
+			if (rx_queues[q].desc[i].buffer == buffer)
+				return true;
+	return false;
+}
+
+static uint8_t _queue_tx(uint8_t queue, const struct _eth_sg_list* sgl,
+		ethd_callback_t callback, bool copy)
+{
+	struct _tx_frame* frame;
+	uint32_t i, length = 0;
+
+	if (queue >= ETH_QUEUE_COUNT || sgl->size == 0 || sgl->size > TX_SG_MAX)
+		return ETH_PARAM;
+	for (i = 0; i < sgl->size; i++) {
+		if (!copy && !IS_CACHE_ALIGNED(sgl->entries[i].buffer))
+			return ETH_PARAM;
+		length += sgl->entries[i].size;
+	}
+	if (length > ETH_TX_UNITSIZE)
+		return ETH_PARAM;
+	if (tx_count == TX_FRAMES)
+		return ETH_TX_BUSY;
+
+	frame = &tx_frames[(tx_head + tx_count) % TX_FRAMES];
+	frame->queue = queue;
+	frame->copied = copy;
+	frame->length = length;
+	frame->callback = callback;
+	if (copy) {
+		length = 0;
+		for (i = 0; i < sgl->size; i++) {
+			memcpy(frame->data + length, sgl->entries[i].buffer,
+			       sgl->entries[i].size);
+			length += sgl->entries[i].size;
+		}
+		frame->count = 1;
+		frame->sg[0].buffer = frame->data;
+		frame->sg[0].size = length;
+		stats.tx_copied++;
+		stats.tx_copy_bytes += length;
+	} else {
+		frame->count = sgl->size;
+		memcpy(frame->sg, sgl->entries, sgl->size * sizeof(struct _eth_sg));
+		stats.tx_nocopy++;
+	}
+	frame->sum = _checksum(frame->sg, frame->count);
+	tx_count++;
+	return ETH_OK;
+}
+
+/*------------------------------------------------------------------------------
+ *         ethd functions
+ *------------------------------------------------------------------------------*/
+
+struct _ethd* board_get_eth(uint8_t iface)
+{
+	return iface == 0 ? &ethd : NULL;
+}
+
+void ethd_get_mac_addr(struct _ethd* ethd, uint8_t sa_idx, uint8_t* mac)
+{
+	memcpy(mac, mac_addr, sizeof(mac_addr));
+}
+
+void ethd_set_rx_callback(struct _ethd* ethd, uint8_t queue,
+		ethd_callback_t callback)
+{
+	if (queue < ETH_QUEUE_COUNT)
+		rx_queues[queue].callback = callback;
+}
+
+uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue,
+		const struct _eth_sg_list* sgl, ethd_callback_t callback)
+{
+	return _queue_tx(queue, sgl, callback, true);
+}
+
+uint8_t ethd_send_sg_nocopy(struct _ethd* ethd, uint8_t queue,
+		const struct _eth_sg_list* sgl, ethd_callback_t callback)
+{
+	return _queue_tx(queue, sgl, callback, false);
+}
+
+uint8_t ethd_send(struct _ethd* ethd, uint8_t queue, void* buffer,
+		uint32_t size, ethd_callback_t callback)
+{
+	struct _eth_sg sg = { .size = size, .buffer = buffer, .next = NULL };
+	struct _eth_sg_list sgl = { .size = 1, .entries = &sg };
+
+	return _queue_tx(queue, &sgl, callback, true);
+}
+
+uint8_t ethd_poll(struct _ethd* ethd, uint8_t queue, uint8_t* buffer,
+		uint32_t buffer_size, uint32_t* recv_size)
+{
+	struct _rx_queue* rxq = &rx_queues[queue];
+	struct _rx_desc* desc;
+	uint32_t length, offset, size;
+
+	if (!buffer)
+		return ETH_PARAM;
+	*recv_size = 0;
+	if (rxq->used == 0)
+		return ETH_RX_NULL;
+
+	length = rxq->desc[rxq->head].length;
+	for (offset = 0; offset < length; offset += ETH_RX_UNITSIZE) {
+		desc = &rxq->desc[rxq->head];
+		size = length - offset;
+		if (size > ETH_RX_UNITSIZE)
+			size = ETH_RX_UNITSIZE;
+		if (offset + size > buffer_size)
+			size = offset < buffer_size ? buffer_size - offset : 0;
+		memcpy(buffer + offset, desc->buffer, size);
+		stats.rx_copy_bytes += size;
+		desc->used = false;
+		rxq->head = (rxq->head + 1) % RX_BUFFERS;
+		rxq->used--;
+	}
+	stats.rx_copied++;
+	*recv_size = length;
+	return ETH_OK;
+}
+
+uint8_t ethd_poll_sg(struct _ethd* ethd, uint8_t queue,
+		struct _eth_sg_list* sgl, uint32_t* recv_size)
+{
+	struct _rx_queue* rxq = &rx_queues[queue];
+	struct _rx_desc* desc;
+	struct _eth_sg* sg;
+	uint32_t length, count, i;
+	void* spare;
+
+	*recv_size = 0;
+	if (rxq->used == 0)
+		return ETH_RX_NULL;
+
+	length = rxq->desc[rxq->head].length;
+	count = (length + ETH_RX_UNITSIZE - 1) / ETH_RX_UNITSIZE;
+	if (count > sgl->size)
+		return ETH_SIZE_TOO_SMALL;
+
+	for (i = 0; i < count; i++) {
+		desc = &rxq->desc[rxq->head];
+		sg = &sgl->entries[i];
+		spare = sg->buffer;
+		if (!IS_CACHE_ALIGNED(spare) || _rx_owned(spare))
+			stats.errors++;
+		sg->buffer = desc->buffer;
+		sg->size = length - i * ETH_RX_UNITSIZE;
+		if (sg->size > ETH_RX_UNITSIZE)
+			sg->size = ETH_RX_UNITSIZE;
+		desc->buffer = spare;
+		desc->used = false;
+		rxq->head = (rxq->head + 1) % RX_BUFFERS;
+		rxq->used--;
+	}
+	sgl->size = count;
+	stats.rx_nocopy++;
+	*recv_size = length;
+	return ETH_OK;
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+void ethd_sim_init(ethd_sim_wire_cb_t cb, void* arg)
+{
+	uint32_t q, i;
+
+	memset(rx_queues, 0, sizeof(rx_queues));
+	for (q = 0; q < ETH_QUEUE_COUNT; q++)
+		for (i = 0; i < RX_BUFFERS; i++)
+			rx_queues[q].desc[i].buffer = rx_buffers[q][i];
+	tx_head = 0;
+	tx_count = 0;
+	wire_cb = cb;
+	wire_arg = arg;
+	ethd_sim_reset_stats();
+}
+
+bool ethd_sim_receive(uint8_t queue, const void* frame, uint32_t length)
+{
+	struct _rx_queue* rxq = &rx_queues[queue];
+	struct _rx_desc* desc;
+	uint32_t count, offset, size;
+
+	count = (length + ETH_RX_UNITSIZE - 1) / ETH_RX_UNITSIZE;
+	if (length == 0 || length > ETH_MAX_FRAME_LENGTH
+			|| count > RX_BUFFERS - rxq->used) {
+		stats.rx_dropped++;
+		if (rxq->callback)
+			rxq->callback(queue, ETH_RX_RSR_BNA);
+		return false;
+	}
+
+	rxq->desc[rxq->tail].length = length;
+	for (offset = 0; offset < length; offset += size) {
+		desc = &rxq->desc[rxq->tail];
+		size = length - offset;
+		if (size > ETH_RX_UNITSIZE)
+			size = ETH_RX_UNITSIZE;
+		memcpy(desc->buffer, (const uint8_t*)frame + offset, size);
+		desc->used = true;
+		rxq->tail = (rxq->tail + 1) % RX_BUFFERS;
+		rxq->used++;
+	}
+	stats.rx_frames++;
+
+	if (rxq->callback)
+		rxq->callback(queue, ETH_RX_RSR_REC);
+	return true;
+}
+
+uint32_t ethd_sim_transmit(uint32_t count)
+{
+	struct _tx_frame* frame;
+	ethd_callback_t callback;
+	uint32_t sent, i, length;
+	uint8_t queue;
+
+	for (sent = 0; sent < count && tx_count; sent++) {
+		frame = &tx_frames[tx_head];
+		if (_checksum(frame->sg, frame->count) != frame->sum)
+			stats.errors++;
+		length = 0;
+		for (i = 0; i < frame->count; i++) {
+			memcpy(wire + length, frame->sg[i].buffer, frame->sg[i].size);
+			length += frame->sg[i].size;
+		}
+		callback = frame->callback;
+		queue = frame->queue;
+		tx_head = (tx_head + 1) % TX_FRAMES;
+		tx_count--;
+		stats.tx_frames++;
+
+		/* The slot may be reused from the callbacks */
+		if (wire_cb)
+			wire_cb(wire_arg, wire, length);
+		if (callback)
+			callback(queue, 0);
+	}
+	return sent;
+}
+
+uint32_t ethd_sim_tx_pending(void)
+{
+	return tx_count;
+}
+
+const struct _ethd_sim_stats* ethd_sim_get_stats(void)
+{
+	return &stats;
+}
+
+void ethd_sim_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
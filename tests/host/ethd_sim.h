@@ -0,0 +1,129 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Simulated ETH driver for host tests.
+ *
+ *  ethd_sim.c replaces ethd.c and board_get_eth() of board_eth.c with one
+ *  interface whose queues behave as the GMAC descriptor rings: a frame
+ *  received from the wire with ethd_sim_receive() is written into the
+ *  RX buffers of a queue, as the MAC DMA would, and the RX callback is
+ *  called; ethd_poll() copies it out, ethd_poll_sg() swaps the RX buffers
+ *  with the spare buffers of the caller. ethd_send_sg() copies the frame
+ *  into the TX buffers, ethd_send_sg_nocopy() only keeps the pointers; the
+ *  frames leave on the wire, in order, when the test calls
+ *  ethd_sim_transmit(), which hands each one to a callback of the test and
+ *  calls the TX callback of the frame.
+ *
+ *  The bytes copied by ethd_send_sg() and ethd_poll() are counted, so that
+ *  a test can tell the copies of the driver from the DMA transfers. The
+ *  buffers of a frame sent without copy are checksummed when it is queued
+ *  and when it leaves: a buffer reused before the TX callback was called
+ *  is counted as an error, and so is a spare RX buffer still owned by a
+ *  descriptor.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _ETHD_SIM_H_
+#define _ETHD_SIM_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+struct _ethd_sim_stats {
+	uint32_t tx_frames;     /**< Frames sent on the wire */
+	uint32_t tx_nocopy;     /**< Frames queued by ethd_send_sg_nocopy() */
+	uint32_t tx_copied;     /**< Frames queued by ethd_send_sg() */
+	uint64_t tx_copy_bytes; /**< Bytes copied by ethd_send_sg() */
+	uint32_t rx_frames;     /**< Frames written into the RX buffers */
+	uint32_t rx_dropped;    /**< Frames lost for lack of RX buffers */
+	uint32_t rx_nocopy;     /**< Frames taken by ethd_poll_sg() */
+	uint32_t rx_copied;     /**< Frames taken by ethd_poll() */
+	uint64_t rx_copy_bytes; /**< Bytes copied by ethd_poll() */
+	uint32_t errors;        /**< Buffers modified or owned twice */
+};
+
+/** Receives the frames sent on the wire */
+typedef void (*ethd_sim_wire_cb_t)(void* arg, const uint8_t* frame,
+		uint32_t length);
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Reset the queues, drop the frames in flight without calling their
+ * callbacks.
+ * \param wire_cb  Called with each frame sent on the wire, can be NULL
+ * \param arg      Argument of \a wire_cb
+ */
+extern void ethd_sim_init(ethd_sim_wire_cb_t wire_cb, void* arg);
+
+/**
+ * \brief Receive a frame from the wire on an RX queue and call the RX
+ * callback of the queue, as the RX interrupt would.
+ * \return false if the frame was dropped for lack of free RX buffers
+ */
+extern bool ethd_sim_receive(uint8_t queue, const void* frame,
+		uint32_t length);
+
+/**
+ * \brief Send up to \a count of the queued frames, oldest first, calling
+ * the wire callback then the TX callback of each one.
+ * \return Number of frames sent
+ */
+extern uint32_t ethd_sim_transmit(uint32_t count);
+
+/**
+ * \brief Number of frames queued for transmission.
+ */
+extern uint32_t ethd_sim_tx_pending(void);
+
+/**
+ * \brief Get the counters.
+ */
+extern const struct _ethd_sim_stats* ethd_sim_get_stats(void);
+
+/**
+ * \brief Clear the counters.
+ */
+extern void ethd_sim_reset_stats(void);
+
+#endif /* _ETHD_SIM_H_ */
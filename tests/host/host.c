@@ -0,0 +1,169 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "host.h"
+#include "irqflags.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+/** Address ranges backed by memory: internal SRAM and peripherals */
+static const struct {
+	uint32_t addr;
+	uint32_t size;
+} _host_maps[] = {
+	{ 0x00200000u, 0x00020000u },
+	{ 0xf0000000u, 0x10000000u },
+};
+
+static uint32_t _host_seed = 1;
+
+/*------------------------------------------------------------------------------
+ *         Exported variables
+ *------------------------------------------------------------------------------*/
+
+unsigned host_failures;
+
+volatile uint32_t host_irq_masked;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static int _host_compare(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+void host_init(void)
+{
+	int i;
+
+	for (i = 0; i < (int)(sizeof(_host_maps) / sizeof(_host_maps[0])); i++) {
+		void* addr = (void*)(uintptr_t)_host_maps[i].addr;
+		void* map = mmap(addr, _host_maps[i].size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+				MAP_FIXED_NOREPLACE, -1, 0);
+		if (map != addr) {
+			printf("cannot map 0x%08x-0x%08x\n",
+				(unsigned)_host_maps[i].addr,
+				(unsigned)(_host_maps[i].addr + _host_maps[i].size - 1));
+			exit(2);
+		}
+	}
+
+	host_srand(0x5eed1234u);
+}
+
+int host_report(const char* name)
+{
+	if (host_failures) {
+		printf("%s: FAILED (%u checks)\n", name, host_failures);
+		return 1;
+	}
+	printf("%s: PASSED\n", name);
+	return 0;
+}
+
+uint32_t host_rand(void)
+{
+	uint32_t x = _host_seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	_host_seed = x;
+	return x;
+}
+
+void host_srand(uint32_t seed)
+{
+	_host_seed = seed ? seed : 1;
+}
+
+uint64_t host_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+uint64_t host_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return host_time_ns();
+#endif
+}
+
+void host_summarize(uint64_t* samples, uint32_t count,
+		struct _host_summary* summary)
+{
+	uint64_t sum = 0;
+	uint32_t i;
+
+	memset(summary, 0, sizeof(*summary));
+	if (count == 0)
+		return;
+	qsort(samples, count, sizeof(*samples), _host_compare);
+	for (i = 0; i < count; i++)
+		sum += samples[i];
+	summary->min = samples[0];
+	summary->p50 = samples[count / 2];
+	summary->p99 = samples[(uint32_t)(count * 99ull / 100)];
+	summary->max = samples[count - 1];
+	summary->avg = (double)sum / count;
+}
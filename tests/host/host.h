@@ -0,0 +1,130 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Support for the host test programs.
+ *
+ *  The drivers and libraries under test are built for the host with the
+ *  SAMA5D2 chip headers. host_init() maps anonymous memory at the address
+ *  of the peripherals and of the internal SRAM, so that register accesses
+ *  through the chip.h definitions land in memory the test can inspect and
+ *  preload. The programs are linked without PIE so that their static
+ *  buffers have 32-bit addresses, as the drivers expect.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _HOST_H_
+#define _HOST_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*------------------------------------------------------------------------------
+ *         Definitions
+ *------------------------------------------------------------------------------*/
+
+/** Count a failure and report the location if cond is false */
+#define host_check(cond) do { \
+		if (!(cond)) { \
+			host_failures++; \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		} \
+	} while (0)
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+/** Distribution of a set of samples */
+struct _host_summary {
+	uint64_t min;
+	uint64_t p50;
+	uint64_t p99;
+	uint64_t max;
+	double avg;
+};
+
+/*------------------------------------------------------------------------------
+ *         Exported variables
+ *------------------------------------------------------------------------------*/
+
+/** Number of failed checks */
+extern unsigned host_failures;
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Map the peripheral and SRAM address ranges, seed the generator.
+ */
+extern void host_init(void);
+
+/**
+ * \brief Print the test result.
+ * \return Exit status of the program (0 if all checks passed)
+ */
+extern int host_report(const char* name);
+
+/**
+ * \brief Deterministic pseudo-random generator (xorshift32).
+ */
+extern uint32_t host_rand(void);
+
+/**
+ * \brief Seed host_rand().
+ */
+extern void host_srand(uint32_t seed);
+
+/**
+ * \brief Monotonic time in nanoseconds.
+ */
+extern uint64_t host_time_ns(void);
+
+/**
+ * \brief Free-running CPU cycle counter (time stamp counter on x86, the
+ * monotonic clock in nanoseconds elsewhere).
+ */
+extern uint64_t host_cycles(void);
+
+/**
+ * \brief Summarize a set of samples (e.g. latencies), sorting them in place.
+ */
+extern void host_summarize(uint64_t* samples, uint32_t count,
+		struct _host_summary* summary);
+
+#endif /* _HOST_H_ */
@@ -0,0 +1,233 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "host_mmio.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define MAX_REGIONS 8
+
+/** x86 trap flag: single step */
+#define EFLAGS_TF 0x100
+
+/** x86 page fault error code: write access */
+#define PF_WRITE 0x2
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+struct _mmio_region {
+	uintptr_t start;
+	uintptr_t end;
+	host_mmio_hook_t read;
+	host_mmio_hook_t write;
+	bool armed;
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static struct _mmio_region _regions[MAX_REGIONS];
+static int _region_count;
+
+/** Access being single-stepped */
+static struct {
+	struct _mmio_region* region;
+	uintptr_t addr;
+	bool write;
+} _pending;
+
+static volatile uint64_t _traps;
+static uint64_t _trap_cost_ns;
+
+static volatile uint32_t* _calibration;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+#if defined(__x86_64__) && defined(__linux__)
+
+static void _protect(struct _mmio_region* region, int prot)
+{
+	mprotect((void*)region->start, region->end - region->start, prot);
+}
+
+static void _segv_handler(int sig, siginfo_t* info, void* context)
+{
+	ucontext_t* uc = (ucontext_t*)context;
+	uintptr_t addr = (uintptr_t)info->si_addr;
+	int i;
+
+	for (i = 0; i < _region_count; i++)
+		if (addr >= _regions[i].start && addr < _regions[i].end)
+			break;
+	if (i == _region_count || _pending.region) {
+		/* genuine fault: let it crash */
+		signal(SIGSEGV, SIG_DFL);
+		return;
+	}
+
+	_traps++;
+	_pending.region = &_regions[i];
+	_pending.addr = addr;
+	_pending.write = (uc->uc_mcontext.gregs[REG_ERR] & PF_WRITE) != 0;
+
+	_protect(_pending.region, PROT_READ | PROT_WRITE);
+	if (!_pending.write && _pending.region->read)
+		_pending.region->read((uint32_t)addr);
+
+	/* execute the access and come back */
+	uc->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TF;
+}
+
+static void _trap_handler(int sig, siginfo_t* info, void* context)
+{
+	ucontext_t* uc = (ucontext_t*)context;
+	struct _mmio_region* region = _pending.region;
+
+	uc->uc_mcontext.gregs[REG_EFL] &= ~EFLAGS_TF;
+	if (!region)
+		return;
+
+	if (_pending.write && region->write)
+		region->write((uint32_t)_pending.addr);
+	_pending.region = NULL;
+	if (region->armed)
+		_protect(region, PROT_NONE);
+}
+
+static void _install(void)
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+	sa.sa_sigaction = _segv_handler;
+	sigaction(SIGSEGV, &sa, NULL);
+	sa.sa_sigaction = _trap_handler;
+	sigaction(SIGTRAP, &sa, NULL);
+}
+
+static bool _add_region(uint32_t addr, uint32_t size,
+		host_mmio_hook_t read, host_mmio_hook_t write)
+{
+	uintptr_t page = sysconf(_SC_PAGESIZE);
+	struct _mmio_region* region;
+
+	if (_region_count == MAX_REGIONS)
+		return false;
+	region = &_regions[_region_count++];
+	region->start = addr & ~(page - 1);
+	region->end = (addr + size + page - 1) & ~(page - 1);
+	region->read = read;
+	region->write = write;
+	region->armed = true;
+	_protect(region, PROT_NONE);
+	return true;
+}
+
+/** Measure the cost of a trap on a scratch page */
+static void _calibrate(void)
+{
+	const int count = 2000;
+	uint64_t start, traps;
+	int i;
+
+	_calibration = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if (_calibration == MAP_FAILED)
+		return;
+	_add_region((uint32_t)(uintptr_t)_calibration, 4, NULL, NULL);
+
+	traps = _traps;
+	start = host_time_ns();
+	for (i = 0; i < count; i++)
+		(void)_calibration[0];
+	_trap_cost_ns = (host_time_ns() - start) / count;
+	_traps = traps;
+}
+
+#endif /* __x86_64__ && __linux__ */
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+bool host_mmio_register(uint32_t addr, uint32_t size,
+		host_mmio_hook_t read, host_mmio_hook_t write)
+{
+#if defined(__x86_64__) && defined(__linux__)
+	if (_region_count == 0) {
+		_install();
+		_calibrate();
+	}
+	return _add_region(addr, size, read, write);
+#else
+	return false;
+#endif
+}
+
+void host_mmio_arm(uint32_t addr, bool armed)
+{
+#if defined(__x86_64__) && defined(__linux__)
+	int i;
+
+	for (i = 0; i < _region_count; i++) {
+		if (addr >= _regions[i].start && addr < _regions[i].end) {
+			_regions[i].armed = armed;
+			_protect(&_regions[i], armed ? PROT_NONE :
+					PROT_READ | PROT_WRITE);
+		}
+	}
+#endif
+}
+
+uint64_t host_mmio_overhead_ns(void)
+{
+	return _traps * _trap_cost_ns;
+}
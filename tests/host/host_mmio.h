@@ -0,0 +1,88 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Trapped register ranges for host tests.
+ *
+ *  A range registered with host_mmio_register() is made inaccessible: each
+ *  access faults, the read hook is called before the access completes and
+ *  the write hook after it, so that a model can emulate registers with side
+ *  effects (start bits, FIFOs, status updated on read). The hooks access
+ *  the backing memory directly. Only supported on x86-64 Linux hosts.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _HOST_MMIO_H_
+#define _HOST_MMIO_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+/** Hook called with the address of the access */
+typedef void (*host_mmio_hook_t)(uint32_t addr);
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Trap the accesses to the pages covering [addr, addr + size).
+ * \param read   Called before a read, can be NULL
+ * \param write  Called after a write, can be NULL
+ * \return false if trapping is not supported on this host
+ */
+extern bool host_mmio_register(uint32_t addr, uint32_t size,
+		host_mmio_hook_t read, host_mmio_hook_t write);
+
+/**
+ * \brief Enable or disable the trapping of a registered range, e.g. to only
+ * emulate a peripheral while a given function runs.
+ * \param addr   An address inside the range
+ * \param armed  True to trap the accesses
+ */
+extern void host_mmio_arm(uint32_t addr, bool armed);
+
+/**
+ * \brief Time spent handling traps so far, in nanoseconds (estimated from
+ * the number of traps), to be subtracted from measured durations.
+ */
+extern uint64_t host_mmio_overhead_ns(void);
+
+#endif /* _HOST_MMIO_H_ */
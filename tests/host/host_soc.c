@@ -0,0 +1,201 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include "chip.h"
+#include "host_soc.h"
+#include "irqflags.h"
+
+#include "irq/irq.h"
+#include "mm/cache.h"
+#include "mutex.h"
+#include "peripherals/pmc.h"
+
+#include <assert.h>
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define HANDLERS 4
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static struct {
+	irq_handler_t handler[HANDLERS];
+	void* user_arg[HANDLERS];
+	bool enabled;
+} irqs[ID_PERIPH_COUNT];
+
+static bool clocks[ID_PERIPH_COUNT];
+
+/*------------------------------------------------------------------------------
+ *         PMC
+ *------------------------------------------------------------------------------*/
+
+void pmc_configure_peripheral(uint32_t id, const struct _pmc_periph_cfg* cfg,
+		bool enable)
+{
+	assert(id < ID_PERIPH_COUNT);
+	clocks[id] = enable;
+}
+
+void pmc_enable_peripheral(uint32_t id)
+{
+	assert(id < ID_PERIPH_COUNT);
+	clocks[id] = true;
+}
+
+void pmc_disable_peripheral(uint32_t id)
+{
+	assert(id < ID_PERIPH_COUNT);
+	clocks[id] = false;
+}
+
+bool pmc_is_peripheral_enabled(uint32_t id)
+{
+	assert(id < ID_PERIPH_COUNT);
+	return clocks[id];
+}
+
+uint32_t pmc_get_peripheral_clock(uint32_t id)
+{
+	assert(id < ID_PERIPH_COUNT);
+	return HOST_SOC_PERIPH_CLOCK;
+}
+
+uint32_t pmc_get_processor_clock(void)
+{
+	return HOST_SOC_PROCESSOR_CLOCK;
+}
+
+/*------------------------------------------------------------------------------
+ *         Interrupt controller
+ *------------------------------------------------------------------------------*/
+
+void irq_add_handler(uint32_t source, irq_handler_t handler, void* user_arg)
+{
+	int i;
+
+	assert(source < ID_PERIPH_COUNT);
+	/* as irq.c, registering a handler again only updates its argument */
+	for (i = 0; i < HANDLERS; i++) {
+		if (irqs[source].handler[i] == handler) {
+			irqs[source].user_arg[i] = user_arg;
+			return;
+		}
+	}
+	for (i = 0; i < HANDLERS; i++) {
+		if (!irqs[source].handler[i]) {
+			irqs[source].handler[i] = handler;
+			irqs[source].user_arg[i] = user_arg;
+			return;
+		}
+	}
+	assert(0);
+}
+
+void irq_remove_handler(uint32_t source, irq_handler_t handler)
+{
+	int i;
+
+	assert(source < ID_PERIPH_COUNT);
+	for (i = 0; i < HANDLERS; i++)
+		if (irqs[source].handler[i] == handler)
+			irqs[source].handler[i] = NULL;
+}
+
+void irq_enable(uint32_t source)
+{
+	assert(source < ID_PERIPH_COUNT);
+	irqs[source].enabled = true;
+}
+
+void irq_disable(uint32_t source)
+{
+	assert(source < ID_PERIPH_COUNT);
+	irqs[source].enabled = false;
+}
+
+bool host_irq_raise(uint32_t source)
+{
+	uint32_t flags;
+	int i;
+
+	assert(source < ID_PERIPH_COUNT);
+	if (!irqs[source].enabled || host_irq_masked)
+		return false;
+	flags = arch_irq_save();
+	for (i = 0; i < HANDLERS; i++)
+		if (irqs[source].handler[i])
+			irqs[source].handler[i](source, irqs[source].user_arg[i]);
+	arch_irq_restore(flags);
+	return true;
+}
+
+/*------------------------------------------------------------------------------
+ *         Cache maintenance
+ *------------------------------------------------------------------------------*/
+
+void cache_invalidate_region(void* start, uint32_t length)
+{
+}
+
+void cache_clean_region(const void* start, uint32_t length)
+{
+}
+
+/*------------------------------------------------------------------------------
+ *         Mutexes
+ *------------------------------------------------------------------------------*/
+
+bool mutex_try_lock(mutex_t* mutex)
+{
+	return __sync_bool_compare_and_swap(mutex, 0, 1);
+}
+
+void mutex_lock(mutex_t* mutex)
+{
+	while (!mutex_try_lock(mutex));
+}
+
+void mutex_unlock(mutex_t* mutex)
+{
+	__sync_lock_release(mutex);
+}
+
+bool mutex_is_locked(const mutex_t* mutex)
+{
+	return *mutex != 0;
+}
@@ -0,0 +1,77 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  SoC services for host tests: the drivers under test call the PMC, the
+ *  interrupt controller, the cache maintenance and the mutex functions,
+ *  which the host replaces. Peripheral clocks are only recorded (all run
+ *  at HOST_SOC_PERIPH_CLOCK, the processor at HOST_SOC_PROCESSOR_CLOCK),
+ *  the cache operations do nothing (the host is
+ *  coherent), the mutexes use the compiler atomics, and the interrupt
+ *  handlers are kept so that a test or a model can raise an interrupt
+ *  with host_irq_raise().
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _HOST_SOC_H_
+#define _HOST_SOC_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *         Definitions
+ *------------------------------------------------------------------------------*/
+
+/** Peripheral clock: MCK/2 with a 166 MHz MCK */
+#define HOST_SOC_PERIPH_CLOCK 83000000
+
+/** Processor clock: 3 x MCK */
+#define HOST_SOC_PROCESSOR_CLOCK 498000000
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Call the handlers of an interrupt source, as the interrupt
+ * controller would.
+ * \return false if the source is disabled or interrupts are masked, in
+ * which case nothing is called
+ */
+extern bool host_irq_raise(uint32_t source);
+
+#endif /* _HOST_SOC_H_ */
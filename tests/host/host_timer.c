@@ -0,0 +1,141 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include "host_timer.h"
+#include "irqflags.h"
+#include "timer.h"
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static uint64_t now;
+
+static uint64_t alarm_deadline;
+static void (*alarm_handler)(void);
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/** Take the interrupt of the armed alarm */
+static void _fire(void)
+{
+	void (*handler)(void) = alarm_handler;
+	uint32_t flags;
+
+	alarm_handler = NULL;
+	flags = arch_irq_save();
+	handler();
+	arch_irq_restore(flags);
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+uint64_t timer_get_raw_tick(void)
+{
+	return now;
+}
+
+uint32_t timer_get_raw_freq(void)
+{
+	return HOST_TIMER_FREQ;
+}
+
+uint64_t timer_get_tick(void)
+{
+	return now * 1000 / HOST_TIMER_FREQ;
+}
+
+uint64_t timer_get_interval(uint64_t start, uint64_t end)
+{
+	if (end >= start)
+		return end - start;
+	return end + (0xffffffffffffffffu - start) + 1;
+}
+
+bool timer_set_alarm(uint64_t deadline, void (*handler)(void))
+{
+	if (deadline <= now) {
+		alarm_handler = NULL;
+		return false;
+	}
+	alarm_deadline = deadline;
+	alarm_handler = handler;
+	return true;
+}
+
+void timer_cancel_alarm(void)
+{
+	alarm_handler = NULL;
+}
+
+void host_timer_reset(void)
+{
+	now = 0;
+	alarm_handler = NULL;
+}
+
+void host_timer_advance(uint64_t ticks)
+{
+	uint64_t target = now + ticks;
+
+	while (alarm_handler && alarm_deadline <= target && !host_irq_masked) {
+		now = alarm_deadline;
+		_fire();
+	}
+	now = target;
+}
+
+bool host_timer_run(void)
+{
+	if (!alarm_handler || host_irq_masked)
+		return false;
+	if (alarm_deadline > now)
+		now = alarm_deadline;
+	_fire();
+	return true;
+}
+
+uint64_t host_timer_ticks_to_ns(uint64_t ticks)
+{
+	return (ticks / HOST_TIMER_FREQ) * 1000000000ull
+		+ (ticks % HOST_TIMER_FREQ) * 1000000000ull / HOST_TIMER_FREQ;
+}
+
+uint64_t host_timer_ns(void)
+{
+	return host_timer_ticks_to_ns(now);
+}
@@ -0,0 +1,95 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Simulated system timer for host tests.
+ *
+ *  Implements the raw counter, the millisecond tick, the intervals and the
+ *  alarm of timer.h on a virtual clock, so that the timer wheel and the
+ *  code using it run unchanged. Time only moves when the test advances it:
+ *  host_timer_advance() and host_timer_run() call the alarm handler, as the
+ *  timer interrupt would, when its deadline is crossed and interrupts are
+ *  not masked.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _HOST_TIMER_H_
+#define _HOST_TIMER_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *         Definitions
+ *------------------------------------------------------------------------------*/
+
+/** Frequency of the simulated counter: MCK/8 with a 166 MHz MCK */
+#define HOST_TIMER_FREQ 20750000
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Reset the counter to 0 and disarm the alarm.
+ */
+extern void host_timer_reset(void);
+
+/**
+ * \brief Move the counter forward, calling the alarm handler if its deadline
+ * is crossed. The handler is called at most once per deadline, with the
+ * counter set to the deadline.
+ * \param ticks  Raw timer ticks
+ */
+extern void host_timer_advance(uint64_t ticks);
+
+/**
+ * \brief Jump to the deadline of the alarm and call its handler.
+ * \return false if no alarm is armed (or interrupts are masked)
+ */
+extern bool host_timer_run(void);
+
+/**
+ * \brief Convert raw timer ticks to nanoseconds.
+ */
+extern uint64_t host_timer_ticks_to_ns(uint64_t ticks);
+
+/**
+ * \brief Current value of the counter, in nanoseconds.
+ */
+extern uint64_t host_timer_ns(void);
+
+#endif /* _HOST_TIMER_H_ */
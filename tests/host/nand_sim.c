@@ -0,0 +1,1052 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip.h"
+
+#include "nvm/nand/nand_flash.h"
+#include "nvm/nand/nand_flash_commands.h"
+#include "nvm/nand/nand_flash_dma.h"
+#include "nvm/nand/nand_flash_onfi.h"
+#include "nvm/nand/pmecc.h"
+#include "nvm/nand/pmecc_gf_512.h"
+#include "nvm/nand/pmecc_gf_1024.h"
+
+#include "host.h"
+#include "host_mmio.h"
+#include "nand_sim.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+/** Address of the data register, never accessed */
+#define DATA_ADDR 0x40000000u
+
+#define MANUFACTURER_ID 0x2c
+
+#define PARAM_PAGE_SIZE 116
+
+/** Flips remembered per page */
+#define MAX_FLIPS 64
+
+/** Reset busy time */
+#define RESET_NS 5000
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+enum _sim_output {
+	OUT_NONE,
+	OUT_ID,
+	OUT_PARAM,
+	OUT_STATUS,
+	OUT_PAGE,
+};
+
+struct _sim_flips {
+	uint16_t count;
+	uint32_t bit[MAX_FLIPS];
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static struct {
+	uint8_t ecc_type;
+	bool dma_enabled;
+} nand_cfg;
+
+static struct _nand_sim_timing timing = {
+	.read = 25000,
+	.cache_busy = 3000,
+	.program = 200000,
+	.erase = 2000000,
+	.byte = 20,
+	.correct = 40000,
+};
+
+static struct {
+	struct _nand_flash_model model;
+	bool read_cache;
+	uint32_t page_bytes;        /* data + spare */
+	uint32_t pages_per_block;
+	uint32_t blocks;
+	uint8_t col_cycles;
+	uint8_t row_cycles;
+	uint32_t endurance;
+
+	uint8_t* array;
+	bool* programmed;
+	struct _sim_flips* flips;
+	uint32_t* erase_count;
+	bool* bad;
+
+	/* command state */
+	uint8_t cmd;
+	uint8_t addr[8];
+	uint8_t naddr;
+	enum _sim_output out;
+	enum _sim_output resume;    /* output mode restored by READ_1 */
+	uint32_t out_pos;
+	uint8_t id[5];
+	uint8_t param[PARAM_PAGE_SIZE];
+	bool fail;
+
+	/* data (cache) register and the page loaded by the array */
+	uint8_t* data_reg;
+	uint32_t data_row;
+	uint32_t col;
+	uint32_t array_row;
+	uint64_t array_until;
+	uint64_t busy_until;
+
+	/* program buffer */
+	uint8_t* prog;
+	uint32_t prog_row;
+
+	uint64_t dma_until;
+	struct _nand_sim_stats stats;
+} sim;
+
+/* virtual clock */
+static uint64_t skipped_ns;
+static uint64_t sim_overhead_ns;
+static uint64_t sim_enter_ns;
+static int sim_depth;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/* Time spent in the model, including the trapped register accesses, is
+ * not counted */
+static void _enter(void)
+{
+	if (sim_depth++ == 0)
+		sim_enter_ns = host_time_ns();
+}
+
+static void _leave(void)
+{
+	if (--sim_depth == 0)
+		sim_overhead_ns += host_time_ns() - sim_enter_ns;
+}
+
+static uint64_t _now(void)
+{
+	uint64_t t = sim_depth ? sim_enter_ns : host_time_ns();
+	return t - sim_overhead_ns + skipped_ns;
+}
+
+static void _wait_until(uint64_t t)
+{
+	uint64_t now = _now();
+	if (t > now)
+		skipped_ns += t - now;
+}
+
+static uint8_t* _page(uint32_t row)
+{
+	return sim.array + (size_t)row * sim.page_bytes;
+}
+
+static bool _ready(void)
+{
+	return _now() >= sim.busy_until;
+}
+
+/*
+ * PMECC model
+ */
+
+struct _ecc_geometry {
+	uint32_t sector_size;
+	uint32_t sectors;
+	uint32_t ecc_start;         /* in the spare area */
+	uint32_t ecc_bytes;         /* per sector */
+	int32_t tt;
+	int32_t mm;
+	int32_t nn;
+	const int16_t* alpha_to;
+	const int16_t* index_of;
+};
+
+static void _ecc_geometry(struct _ecc_geometry* g)
+{
+	static const uint8_t tt[] = { 2, 4, 8, 12, 24, 32 };
+	uint32_t cfg = PMECC->PMECC_CFG;
+
+	g->sector_size = pmecc_get_sector_size();
+	g->sectors = pmecc_get_sectors_per_page();
+	g->ecc_start = pmecc_get_ecc_start_address();
+	g->ecc_bytes = pmecc_get_ecc_bytes_per_page() / g->sectors;
+	g->tt = tt[(cfg & PMECC_CFG_BCH_ERR_Msk) >> PMECC_CFG_BCH_ERR_Pos];
+	if (cfg & PMECC_CFG_SECTORSZ) {
+		g->mm = 14;
+		pmecc_get_gf_1024_tables(&g->alpha_to, &g->index_of);
+	} else {
+		g->mm = 13;
+		pmecc_get_gf_512_tables(&g->alpha_to, &g->index_of);
+	}
+	g->nn = (1 << g->mm) - 1;
+}
+
+static int16_t _gf_pow(const struct _ecc_geometry* g, int64_t e)
+{
+	e %= g->nn;
+	if (e < 0)
+		e += g->nn;
+	return g->alpha_to[e];
+}
+
+/**
+ * \brief Find the remainder (polynomial of degree < mm) whose value at
+ * alpha^syn is value, by Gaussian elimination over GF(2).
+ */
+static uint16_t _solve_remainder(const struct _ecc_geometry* g, int32_t syn,
+		int16_t value)
+{
+	uint16_t basis[16], comb[16];
+	uint16_t v, c;
+	int32_t j, bit;
+
+	memset(basis, 0, sizeof(basis));
+	for (j = 0; j < g->mm; j++) {
+		v = _gf_pow(g, (int64_t)syn * j);
+		c = 1u << j;
+		for (bit = g->mm - 1; bit >= 0 && v; bit--) {
+			if (!(v & (1u << bit)))
+				continue;
+			if (!basis[bit]) {
+				basis[bit] = v;
+				comb[bit] = c;
+				break;
+			}
+			v ^= basis[bit];
+			c ^= comb[bit];
+		}
+	}
+
+	v = value;
+	c = 0;
+	for (bit = g->mm - 1; bit >= 0; bit--) {
+		if ((v & (1u << bit)) && basis[bit]) {
+			v ^= basis[bit];
+			c ^= comb[bit];
+		}
+	}
+	return c;
+}
+
+/**
+ * \brief Set the PMECC status and remainders for the page in the data
+ * register: sectors whose ECC bytes are erased are flagged with random
+ * remainders, the others from the injected flips.
+ */
+static void _pmecc_read_page(void)
+{
+	struct _ecc_geometry g;
+	const struct _sim_flips* flips = &sim.flips[sim.data_row];
+	const uint8_t* spare = sim.data_reg + sim.model.page_size;
+	uint32_t status = 0;
+	uint32_t sector, k;
+	int32_t i;
+
+	_ecc_geometry(&g);
+
+	for (sector = 0; sector < g.sectors; sector++) {
+		volatile int16_t* remainder =
+			(volatile int16_t*)&PMECC->PMECC_REM[sector];
+		const uint8_t* ecc = spare + g.ecc_start + sector * g.ecc_bytes;
+		uint32_t pos[MAX_FLIPS];
+		int count = 0;
+
+		for (k = 0; k < g.ecc_bytes && ecc[k] == 0xff; k++);
+		if (k == g.ecc_bytes) {
+			status |= 1u << sector;
+			for (i = 0; i < g.tt; i++)
+				remainder[i] = host_rand() & g.nn;
+			continue;
+		}
+
+		/* bit positions in the codeword: data then ECC */
+		for (k = 0; k < flips->count; k++) {
+			uint32_t byte = flips->bit[k] >> 3;
+			uint32_t p;
+
+			if (byte >= sector * g.sector_size &&
+			    byte < (sector + 1) * g.sector_size) {
+				p = flips->bit[k] - sector * g.sector_size * 8;
+			} else {
+				uint32_t start = sim.model.page_size + g.ecc_start +
+					sector * g.ecc_bytes;
+				if (byte < start || byte >= start + g.ecc_bytes)
+					continue;
+				p = g.sector_size * 8 + flips->bit[k] - start * 8;
+				if (p >= g.sector_size * 8 + g.tt * g.mm)
+					continue;
+			}
+			pos[count++] = p;
+		}
+		if (!count)
+			continue;
+
+		status |= 1u << sector;
+		for (i = 0; i < g.tt; i++) {
+			int32_t syn = 2 * i + 1;
+			int16_t s = 0;
+			int j;
+			for (j = 0; j < count; j++)
+				s ^= _gf_pow(&g, (int64_t)syn * pos[j]);
+			remainder[i] = _solve_remainder(&g, syn, s);
+		}
+	}
+
+	*(volatile uint32_t*)&PMECC->PMECC_ISR = status;
+}
+
+/**
+ * \brief Fill the PMECC ECC registers after the data area of a page has
+ * been written. The value is a checksum of the sector, never erased.
+ */
+static void _pmecc_write_page(const uint8_t* data)
+{
+	struct _ecc_geometry g;
+	uint32_t sector, k;
+
+	_ecc_geometry(&g);
+
+	for (sector = 0; sector < g.sectors; sector++) {
+		volatile uint8_t* ecc =
+			(volatile uint8_t*)PMECC->PMECC_ECC[sector].PMECC_ECC;
+		uint32_t sum = sector, word;
+
+		for (k = 0; k < g.sector_size; k += 4) {
+			memcpy(&word, data + sector * g.sector_size + k, 4);
+			sum = (sum << 5 | sum >> 27) ^ word;
+		}
+		for (k = 0; k < g.ecc_bytes; k++)
+			ecc[k] = (sum >> (k & 3) * 8) & 0x7f;
+	}
+}
+
+/**
+ * \brief Error location: Chien search of the sigma polynomial over the
+ * number of bits written to PMERRLOC_EN.
+ */
+static void _pmerrloc_write(uint32_t addr)
+{
+	volatile uint32_t* el = (volatile uint32_t*)PMERRLOC->PMERRLOC_EL;
+	struct _ecc_geometry g;
+	int32_t exp[ARRAY_SIZE(PMERRLOC->PMERRLOC_SIGMA)];
+	int32_t degree, k;
+	uint32_t cfg, nbits, p, roots = 0;
+
+	if (addr == (uint32_t)&PMERRLOC->PMERRLOC_DIS) {
+		*(volatile uint32_t*)&PMERRLOC->PMERRLOC_ISR = 0;
+		return;
+	}
+	if (addr != (uint32_t)&PMERRLOC->PMERRLOC_EN)
+		return;
+
+	_enter();
+
+	cfg = PMERRLOC->PMERRLOC_CFG;
+	degree = (cfg & PMERRLOC_CFG_ERRNUM_Msk) >> PMERRLOC_CFG_ERRNUM_Pos;
+	nbits = *(volatile uint32_t*)&PMERRLOC->PMERRLOC_EN;
+	g.mm = cfg & PMERRLOC_CFG_SECTORSZ ? 14 : 13;
+	g.nn = (1 << g.mm) - 1;
+	if (g.mm == 14)
+		pmecc_get_gf_1024_tables(&g.alpha_to, &g.index_of);
+	else
+		pmecc_get_gf_512_tables(&g.alpha_to, &g.index_of);
+
+	/* exp[k]: exponent of sigma_k * alpha^(-k*p), -1 if sigma_k is 0 */
+	for (k = 0; k <= degree; k++) {
+		int16_t coef = PMERRLOC->PMERRLOC_SIGMA[k] & g.nn;
+		exp[k] = coef ? g.index_of[coef] : -1;
+	}
+
+	for (p = 0; p < nbits; p++) {
+		int16_t sum = 0;
+		for (k = 0; k <= degree; k++) {
+			if (exp[k] < 0)
+				continue;
+			sum ^= g.alpha_to[exp[k]];
+			exp[k] -= k;
+			if (exp[k] < 0)
+				exp[k] += g.nn;
+		}
+		if (!sum) {
+			if (roots < ARRAY_SIZE(PMERRLOC->PMERRLOC_EL))
+				el[roots] = p + 1;
+			roots++;
+		}
+	}
+
+	*(volatile uint32_t*)&PMERRLOC->PMERRLOC_ISR = PMERRLOC_ISR_DONE |
+		((roots << PMERRLOC_ISR_ERR_CNT_Pos) & PMERRLOC_ISR_ERR_CNT_Msk);
+
+	_leave();
+}
+
+/*
+ * Device
+ */
+
+static void _load_page(uint32_t row)
+{
+	const struct _sim_flips* flips = &sim.flips[row];
+	uint32_t k;
+
+	memcpy(sim.data_reg, _page(row), sim.page_bytes);
+	for (k = 0; k < flips->count; k++)
+		sim.data_reg[flips->bit[k] >> 3] ^= 1u << (flips->bit[k] & 7);
+	sim.data_row = row;
+	sim.col = 0;
+	sim.out = sim.resume = OUT_PAGE;
+}
+
+static void _start_read(uint32_t row)
+{
+	sim.stats.page_reads++;
+	sim.array_row = row;
+	sim.array_until = _now() + timing.read;
+	sim.busy_until = sim.array_until;
+	_load_page(row);
+}
+
+static void _read_cache(bool last)
+{
+	uint64_t start = _now();
+
+	if (start < sim.array_until)
+		start = sim.array_until;
+	sim.busy_until = start + timing.cache_busy;
+
+	sim.stats.cache_reads++;
+	_load_page(sim.array_row);
+
+	if (!last && (sim.array_row + 1) % sim.pages_per_block != 0) {
+		sim.stats.page_reads++;
+		sim.array_row++;
+		sim.array_until = sim.busy_until + timing.read;
+	} else {
+		sim.array_until = sim.busy_until;
+	}
+}
+
+static void _program(void)
+{
+	uint32_t block = sim.prog_row / sim.pages_per_block;
+	uint8_t* page = _page(sim.prog_row);
+	uint32_t i;
+
+	sim.busy_until = _now() + timing.program;
+	if (sim.bad[block]) {
+		sim.fail = true;
+		sim.stats.failures++;
+		return;
+	}
+
+	/* programming only clears bits */
+	for (i = 0; i + 8 <= sim.page_bytes; i += 8) {
+		uint64_t a, b;
+		memcpy(&a, page + i, 8);
+		memcpy(&b, sim.prog + i, 8);
+		a &= b;
+		memcpy(page + i, &a, 8);
+	}
+	for (; i < sim.page_bytes; i++)
+		page[i] &= sim.prog[i];
+	sim.programmed[sim.prog_row] = true;
+	sim.fail = false;
+	sim.stats.programs++;
+}
+
+static void _erase(uint32_t row)
+{
+	uint32_t block = row / sim.pages_per_block;
+	uint32_t first = block * sim.pages_per_block;
+	uint32_t i;
+
+	sim.busy_until = _now() + timing.erase;
+	if (!sim.bad[block] && sim.endurance &&
+	    sim.erase_count[block] >= sim.endurance)
+		sim.bad[block] = true;
+	if (sim.bad[block]) {
+		sim.fail = true;
+		sim.stats.failures++;
+		return;
+	}
+
+	for (i = 0; i < sim.pages_per_block; i++) {
+		if (sim.programmed[first + i])
+			memset(_page(first + i), 0xff, sim.page_bytes);
+		sim.programmed[first + i] = false;
+		sim.flips[first + i].count = 0;
+	}
+	sim.erase_count[block]++;
+	sim.fail = false;
+	sim.stats.erases++;
+}
+
+static uint32_t _column(void)
+{
+	uint32_t col = 0;
+	int i;
+
+	for (i = 0; i < sim.col_cycles; i++)
+		col |= sim.addr[i] << (8 * i);
+	return col;
+}
+
+static uint32_t _row(uint8_t first)
+{
+	uint32_t row = 0;
+	int i;
+
+	for (i = 0; i < sim.row_cycles; i++)
+		row |= sim.addr[first + i] << (8 * i);
+	return row % (sim.blocks * sim.pages_per_block);
+}
+
+/**
+ * \brief Handle the last address cycle of a command.
+ */
+static void _address_complete(void)
+{
+	switch (sim.cmd) {
+	case NAND_CMD_READID:
+		sim.out = OUT_ID;
+		sim.out_pos = 0;
+		if (sim.addr[0] == 0x20) {
+			memcpy(sim.id, "ONFI", 4);
+			sim.id[4] = 0;
+		} else {
+			sim.id[0] = MANUFACTURER_ID;
+			sim.id[1] = sim.model.device_id;
+			sim.id[2] = 0;
+			sim.id[3] = 0x15;   /* 2KB pages, 128KB blocks, x8 */
+			sim.id[4] = 0;
+		}
+		break;
+
+	case NAND_CMD_READ_PARAM_PAGE:
+		sim.busy_until = _now() + timing.read;
+		sim.out = sim.resume = OUT_PARAM;
+		sim.out_pos = 0;
+		break;
+
+	case NAND_CMD_WRITE_1:
+		sim.prog_row = _row(sim.col_cycles);
+		sim.col = _column();
+		memset(sim.prog, 0xff, sim.page_bytes);
+		break;
+
+	case NAND_CMD_RANDOM_IN:
+	case NAND_CMD_RANDOM_OUT:
+		sim.col = _column();
+		break;
+
+	default:
+		break;
+	}
+}
+
+static uint8_t _expected_cycles(uint8_t cmd)
+{
+	switch (cmd) {
+	case NAND_CMD_READ_1:
+	case NAND_CMD_WRITE_1:
+		return sim.col_cycles + sim.row_cycles;
+	case NAND_CMD_RANDOM_IN:
+	case NAND_CMD_RANDOM_OUT:
+		return sim.col_cycles;
+	case NAND_CMD_ERASE_1:
+		return sim.row_cycles;
+	default:
+		return 1;
+	}
+}
+
+static void _command(uint8_t command)
+{
+	sim.naddr = 0;
+
+	switch (command) {
+	case NAND_CMD_RESET:
+		sim.busy_until = _now() + RESET_NS;
+		sim.array_until = sim.busy_until;
+		sim.fail = false;
+		sim.out = sim.resume = OUT_NONE;
+		break;
+
+	case NAND_CMD_STATUS:
+		sim.out = OUT_STATUS;
+		break;
+
+	case NAND_CMD_READ_1:
+		/* also returns to data output after a status read */
+		sim.out = sim.resume;
+		break;
+
+	case NAND_CMD_READ_2:
+		if (sim.cmd == NAND_CMD_READ_1)
+			_start_read(_row(sim.col_cycles));
+		sim.col = _column();
+		break;
+
+	case NAND_CMD_READ_CACHE:
+	case NAND_CMD_READ_CACHE_END:
+		_read_cache(command == NAND_CMD_READ_CACHE_END);
+		break;
+
+	case NAND_CMD_RANDOM_OUT_2:
+		sim.out = OUT_PAGE;
+		break;
+
+	case NAND_CMD_WRITE_2:
+		if (sim.cmd == NAND_CMD_WRITE_1 || sim.cmd == NAND_CMD_RANDOM_IN)
+			_program();
+		break;
+
+	case NAND_CMD_ERASE_2:
+		if (sim.cmd == NAND_CMD_ERASE_1)
+			_erase(_row(0));
+		break;
+
+	default:
+		break;
+	}
+
+	/* commands ending a sequence do not change the current one */
+	if (command != NAND_CMD_STATUS && command != NAND_CMD_READ_2 &&
+	    command != NAND_CMD_WRITE_2 && command != NAND_CMD_ERASE_2 &&
+	    command != NAND_CMD_RANDOM_OUT_2)
+		sim.cmd = command;
+	if (command == NAND_CMD_WRITE_2 || command == NAND_CMD_ERASE_2)
+		sim.cmd = 0;
+}
+
+static uint8_t _data_out(void)
+{
+	switch (sim.out) {
+	case OUT_ID:
+		return sim.out_pos < sizeof(sim.id) ? sim.id[sim.out_pos++] : 0;
+
+	case OUT_PARAM:
+		return sim.param[sim.out_pos++ % PARAM_PAGE_SIZE];
+
+	case OUT_STATUS:
+	{
+		uint8_t status = 0;
+		if (_ready()) {
+			status |= NAND_STATUS_RDY;
+			if (_now() >= sim.array_until)
+				status |= NAND_STATUS_ARDY;
+			if (sim.fail)
+				status |= NAND_STATUS_FAIL;
+		} else {
+			/* the caller polls: skip to the end of the busy time */
+			_wait_until(sim.busy_until);
+		}
+		return status;
+	}
+
+	case OUT_PAGE:
+		if (sim.col < sim.page_bytes)
+			return sim.data_reg[sim.col++];
+		return 0xff;
+
+	default:
+		return 0xff;
+	}
+}
+
+static void _data_in(uint8_t data)
+{
+	if (sim.cmd == NAND_CMD_WRITE_1 || sim.cmd == NAND_CMD_RANDOM_IN) {
+		if (sim.col < sim.page_bytes)
+			sim.prog[sim.col] = data;
+		sim.col++;
+	}
+}
+
+static void _build_param_page(void)
+{
+	uint32_t v;
+	uint16_t h;
+
+	memset(sim.param, 0, sizeof(sim.param));
+	memcpy(sim.param, "ONFI", 4);
+	sim.param[8] = sim.read_cache ? ONFI_OPT_CMD_READ_CACHE : 0;
+	memcpy(&sim.param[32], "HOST SIM    ", 12);
+	memcpy(&sim.param[44], "NAND MODEL          ", 20);
+	sim.param[64] = MANUFACTURER_ID;
+	v = sim.model.page_size;
+	memcpy(&sim.param[80], &v, 4);
+	h = sim.model.spare_size;
+	memcpy(&sim.param[84], &h, 2);
+	v = sim.pages_per_block;
+	memcpy(&sim.param[92], &v, 4);
+	v = sim.blocks;
+	memcpy(&sim.param[96], &v, 4);
+	sim.param[100] = 1;
+	sim.param[112] = 4;
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions: simulation
+ *------------------------------------------------------------------------------*/
+
+void nand_sim_init(const struct _nand_flash_model* model, bool read_cache)
+{
+	static bool registered;
+	uint32_t pages, size;
+
+	free(sim.array);
+	free(sim.programmed);
+	free(sim.flips);
+	free(sim.erase_count);
+	free(sim.bad);
+	free(sim.data_reg);
+	free(sim.prog);
+	memset(&sim, 0, sizeof(sim));
+
+	sim.model = *model;
+	sim.read_cache = read_cache;
+	sim.page_bytes = model->page_size + model->spare_size;
+	sim.pages_per_block = model->block_size / model->page_size;
+	sim.blocks = ((uint64_t)model->device_size << 20) / model->block_size;
+	pages = sim.blocks * sim.pages_per_block;
+
+	/* same number of cycles as nand_flash_raw.c */
+	for (size = model->page_size; size > 2; size >>= 8)
+		sim.col_cycles++;
+	for (size = pages; size > 0; size >>= 8)
+		sim.row_cycles++;
+
+	sim.array = malloc((size_t)pages * sim.page_bytes);
+	sim.programmed = calloc(pages, sizeof(sim.programmed[0]));
+	sim.flips = calloc(pages, sizeof(sim.flips[0]));
+	sim.erase_count = calloc(sim.blocks, sizeof(sim.erase_count[0]));
+	sim.bad = calloc(sim.blocks, sizeof(sim.bad[0]));
+	sim.data_reg = malloc(sim.page_bytes);
+	sim.prog = malloc(sim.page_bytes);
+	memset(sim.array, 0xff, (size_t)pages * sim.page_bytes);
+	memset(sim.data_reg, 0xff, sim.page_bytes);
+
+	_build_param_page();
+
+	if (!registered) {
+		registered = host_mmio_register((uint32_t)PMERRLOC,
+				sizeof(*PMERRLOC), NULL, _pmerrloc_write);
+		host_mmio_arm((uint32_t)PMERRLOC, false);
+	}
+}
+
+void nand_sim_set_timing(const struct _nand_sim_timing* t)
+{
+	timing = *t;
+}
+
+void nand_sim_flip(uint16_t block, uint16_t page, uint32_t bit)
+{
+	struct _sim_flips* flips = &sim.flips[block * sim.pages_per_block + page];
+
+	if (flips->count < MAX_FLIPS && bit < sim.page_bytes * 8)
+		flips->bit[flips->count++] = bit;
+}
+
+void nand_sim_set_bad(uint16_t block, bool marked)
+{
+	sim.bad[block] = true;
+	if (marked) {
+		uint8_t* page = _page(block * sim.pages_per_block);
+		page[sim.model.page_size] = 0;
+		page[sim.page_bytes + sim.model.page_size] = 0;
+		sim.programmed[block * sim.pages_per_block] = true;
+		sim.programmed[block * sim.pages_per_block + 1] = true;
+	}
+}
+
+bool nand_sim_is_bad(uint16_t block)
+{
+	return sim.bad[block];
+}
+
+void nand_sim_set_endurance(uint32_t cycles)
+{
+	sim.endurance = cycles;
+}
+
+uint32_t nand_sim_erase_count(uint16_t block)
+{
+	return sim.erase_count[block];
+}
+
+const uint8_t* nand_sim_page(uint16_t block, uint16_t page)
+{
+	return _page(block * sim.pages_per_block + page);
+}
+
+const struct _nand_sim_stats* nand_sim_get_stats(void)
+{
+	return &sim.stats;
+}
+
+uint64_t nand_sim_time_ns(void)
+{
+	return _now();
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions: nand_flash.c
+ *------------------------------------------------------------------------------*/
+
+uint8_t nand_initialize(struct _nand_flash *nand)
+{
+	nand->data_addr = DATA_ADDR;
+	nand_cfg.ecc_type = ECC_NO;
+	nand_cfg.dma_enabled = false;
+	return 0;
+}
+
+void nand_write_command(const struct _nand_flash *nand, uint8_t command)
+{
+	_enter();
+	_command(command);
+	_leave();
+}
+
+void nand_write_command16(const struct _nand_flash *nand, uint16_t command)
+{
+	nand_write_command(nand, command);
+}
+
+void nand_write_address(const struct _nand_flash *nand, uint8_t address)
+{
+	_enter();
+	if (sim.naddr < sizeof(sim.addr))
+		sim.addr[sim.naddr++] = address;
+	if (sim.naddr == _expected_cycles(sim.cmd))
+		_address_complete();
+	_leave();
+}
+
+void nand_write_address16(const struct _nand_flash *nand, uint16_t address)
+{
+	nand_write_address(nand, address);
+}
+
+void nand_write_data(const struct _nand_flash *nand, uint8_t data)
+{
+	_enter();
+	_data_in(data);
+	sim.stats.bytes_in++;
+	_leave();
+}
+
+void nand_write_data16(const struct _nand_flash *nand, uint16_t data)
+{
+	nand_write_data(nand, data);
+}
+
+uint8_t nand_read_data(const struct _nand_flash *nand)
+{
+	uint8_t data;
+
+	_enter();
+	data = _data_out();
+	sim.stats.bytes_out++;
+	_leave();
+	return data;
+}
+
+uint16_t nand_read_data16(const struct _nand_flash *nand)
+{
+	return nand_read_data(nand);
+}
+
+void nand_set_ecc_type(uint8_t ecc_type)
+{
+	nand_cfg.ecc_type = ecc_type;
+}
+
+bool nand_is_using_pmecc(void)
+{
+	return nand_cfg.ecc_type == ECC_PMECC;
+}
+
+bool nand_is_using_no_ecc(void)
+{
+	return nand_cfg.ecc_type == ECC_NO;
+}
+
+void nand_set_dma_enabled(bool enabled)
+{
+	nand_cfg.dma_enabled = enabled;
+}
+
+bool nand_is_dma_enabled(void)
+{
+	return nand_cfg.dma_enabled;
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions: nand_flash_dma.c
+ *------------------------------------------------------------------------------*/
+
+uint8_t nand_dma_configure(void)
+{
+	return 0;
+}
+
+uint8_t nand_dma_write(uint32_t src_address, uint32_t dest_address,
+		uint32_t size)
+{
+	const uint8_t* src = (const uint8_t*)(uintptr_t)src_address;
+	bool pmecc;
+	uint32_t count;
+
+	_enter();
+	pmecc = nand_is_using_pmecc() && sim.col == 0 &&
+		size == sim.model.page_size &&
+		(PMECC->PMECC_CFG & PMECC_CFG_NANDWR);
+	if (sim.cmd == NAND_CMD_WRITE_1 || sim.cmd == NAND_CMD_RANDOM_IN) {
+		count = sim.col < sim.page_bytes ? sim.page_bytes - sim.col : 0;
+		if (count > size)
+			count = size;
+		memcpy(sim.prog + sim.col, src, count);
+		sim.col += size;
+	}
+	sim.stats.bytes_in += size;
+	if (pmecc)
+		_pmecc_write_page(src);
+	_leave();
+
+	skipped_ns += (uint64_t)size * timing.byte;
+	return 0;
+}
+
+uint8_t nand_dma_start_read(uint32_t src_address, uint32_t dest_address,
+		uint32_t size)
+{
+	uint8_t* dest = (uint8_t*)(uintptr_t)dest_address;
+	uint32_t col, count;
+
+	_enter();
+	col = sim.col;
+	count = col < sim.page_bytes ? sim.page_bytes - col : 0;
+	if (count > size)
+		count = size;
+	memcpy(dest, sim.data_reg + col, count);
+	memset(dest + count, 0xff, size - count);
+	sim.col += size;
+	sim.stats.bytes_out += size;
+
+	if (nand_is_using_pmecc() && col == 0 &&
+	    size >= sim.model.page_size + pmecc_get_ecc_end_address() &&
+	    !(PMECC->PMECC_CFG & PMECC_CFG_NANDWR))
+		_pmecc_read_page();
+	_leave();
+
+	sim.dma_until = _now() + (uint64_t)size * timing.byte;
+	return 0;
+}
+
+void nand_dma_wait_read(void)
+{
+	_wait_until(sim.dma_until);
+}
+
+uint8_t nand_dma_read(uint32_t src_address, uint32_t dest_address,
+		uint32_t size)
+{
+	nand_dma_start_read(src_address, dest_address, size);
+	nand_dma_wait_read();
+	return 0;
+}
+
+void nand_dma_free(void)
+{
+}
+
+/*------------------------------------------------------------------------------
+ *         Error location emulation during the PMECC correction
+ *------------------------------------------------------------------------------*/
+
+extern uint32_t __real_pmecc_correction(uint32_t pmecc_status,
+		uint32_t page_buffer);
+extern uint32_t __real_pmecc_correction_saved(
+		const struct _pmecc_remainders *saved, uint32_t page_buffer);
+
+static void _correction_start(void)
+{
+	_enter();
+	host_mmio_arm((uint32_t)PMERRLOC, true);
+}
+
+static void _correction_end(uint32_t pmecc_status)
+{
+	host_mmio_arm((uint32_t)PMERRLOC, false);
+	_leave();
+	skipped_ns += (uint64_t)__builtin_popcount(pmecc_status) * timing.correct;
+}
+
+uint32_t __wrap_pmecc_correction(uint32_t pmecc_status, uint32_t page_buffer)
+{
+	uint32_t rc;
+
+	_correction_start();
+	rc = __real_pmecc_correction(pmecc_status, page_buffer);
+	_correction_end(pmecc_status);
+	return rc;
+}
+
+uint32_t __wrap_pmecc_correction_saved(const struct _pmecc_remainders *saved,
+		uint32_t page_buffer)
+{
+	uint32_t rc;
+
+	_correction_start();
+	rc = __real_pmecc_correction_saved(saved, page_buffer);
+	_correction_end(saved->status);
+	return rc;
+}
@@ -0,0 +1,158 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Simulated NAND flash device for host tests.
+ *
+ *  nand_sim.c replaces nand_flash.c and nand_flash_dma.c: the command,
+ *  address and data accessors drive a model of an 8-bit ONFI device
+ *  (status, READ ID, parameter page, page read with optional READ CACHE,
+ *  program with random data input, block erase) and the DMA functions copy
+ *  from and to its page registers.
+ *
+ *  The PMECC is modeled at the transfer level: when a whole page is read
+ *  with the PMECC enabled, the status and remainder registers are set from
+ *  the bit flips injected in the page, and when a page is written the ECC
+ *  registers are filled. The error location peripheral is emulated while
+ *  pmecc_correction() and pmecc_correction_saved() run (the test must be
+ *  linked with --wrap for both functions).
+ *
+ *  Busy periods and transfers advance a virtual clock: waiting for the
+ *  device or for a DMA transfer skips time instead of spinning, so that
+ *  nand_sim_time_ns() measures the sequence as seen by the device. The time
+ *  spent in pmecc_correction() and pmecc_correction_saved() is replaced by
+ *  a fixed cost per flagged sector (the host decodes much faster than the
+ *  target, and the emulated registers are slow); the rest of the CPU time
+ *  is that of the host. The DMA must be enabled, the polled transfers of
+ *  nand_flash_raw.c access the data register directly.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _NAND_SIM_H_
+#define _NAND_SIM_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nvm/nand/nand_flash_model.h"
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+/** Device timings, in nanoseconds */
+struct _nand_sim_timing {
+	uint32_t read;          /**< tR, array to page register */
+	uint32_t cache_busy;    /**< tRCBSY, page register to cache register */
+	uint32_t program;       /**< tPROG */
+	uint32_t erase;         /**< tBERS */
+	uint32_t byte;          /**< Transfer time of one byte on the bus */
+	uint32_t correct;       /**< CPU time to correct a flagged sector */
+};
+
+/** Operation counters */
+struct _nand_sim_stats {
+	uint32_t page_reads;    /**< Array reads (READ PAGE and READ CACHE) */
+	uint32_t cache_reads;   /**< Pages output by READ CACHE commands */
+	uint32_t programs;
+	uint32_t erases;
+	uint32_t failures;      /**< Failed program and erase operations */
+	uint64_t bytes_in;      /**< Bytes written to the device */
+	uint64_t bytes_out;     /**< Bytes read from the device */
+};
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Create an erased device.
+ * \param model       Geometry of the device
+ * \param read_cache  Advertise READ CACHE in the ONFI parameter page
+ */
+extern void nand_sim_init(const struct _nand_flash_model* model,
+		bool read_cache);
+
+/**
+ * \brief Change the timings (default: tR 25us, tRCBSY 3us, tPROG 200us,
+ * tBERS 2ms, 20ns per byte, 40us per corrected sector).
+ */
+extern void nand_sim_set_timing(const struct _nand_sim_timing* timing);
+
+/**
+ * \brief Flip a stored bit until the block is erased.
+ * \param bit  Bit offset in the page, spare area included
+ */
+extern void nand_sim_flip(uint16_t block, uint16_t page, uint32_t bit);
+
+/**
+ * \brief Make program and erase operations fail on a block.
+ * \param marked  Also write a factory bad block marker
+ */
+extern void nand_sim_set_bad(uint16_t block, bool marked);
+
+/**
+ * \brief Tell if program or erase operations fail on a block.
+ */
+extern bool nand_sim_is_bad(uint16_t block);
+
+/**
+ * \brief Make blocks fail (and become bad) after a number of erase cycles,
+ * 0 for no limit.
+ */
+extern void nand_sim_set_endurance(uint32_t cycles);
+
+/**
+ * \brief Number of erase operations on a block.
+ */
+extern uint32_t nand_sim_erase_count(uint16_t block);
+
+/**
+ * \brief Stored content of a page (data then spare), without the flips.
+ */
+extern const uint8_t* nand_sim_page(uint16_t block, uint16_t page);
+
+/**
+ * \brief Operation counters since nand_sim_init().
+ */
+extern const struct _nand_sim_stats* nand_sim_get_stats(void);
+
+/**
+ * \brief Virtual time in nanoseconds.
+ */
+extern uint64_t nand_sim_time_ns(void);
+
+#endif /* _NAND_SIM_H_ */
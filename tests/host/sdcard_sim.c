@@ -0,0 +1,210 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include "host.h"
+#include "host_timer.h"
+#include "sdcard_sim.h"
+
+#include "libsdmmc/libsdmmc.h"
+#include "libstoragemedia/media_ramdisk.h"
+#include "timer_wheel.h"
+
+#include <string.h>
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+/** Default access times, in the range of a class 10 card in high speed
+ * mode: 25 MB/s on the bus, slower programming */
+static const struct _sdcard_sim_timing default_timing = {
+	.read = 100,
+	.read_block = 21,
+	.write = 300,
+	.write_block = 40,
+};
+
+static struct _media* card;
+static struct _sdcard_sim_timing timing;
+static struct _ramdisk_latency latency;
+static struct _sdcard_sim_stats stats;
+
+/** Host time at sdcard_sim_init() and host time spent waiting for the card */
+static uint64_t start_ns;
+static uint64_t wait_ns;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/** Let the virtual clock run until the card completes the command */
+static void _wait(void)
+{
+	uint64_t t0 = host_time_ns();
+
+	while (media_is_busy(card))
+		if (!host_timer_run())
+			break;
+	wait_ns += host_time_ns() - t0;
+}
+
+static uint8_t _read(uint32_t addr, void* data, uint32_t count)
+{
+	if (!card)
+		return SDMMC_NOT_INITIALIZED;
+	if (count == 0)
+		return SDMMC_OK;
+	latency.access_us = timing.read;
+	latency.block_us = timing.read_block;
+	if (media_read(card, addr, data, count, NULL, NULL)
+	    != MEDIA_STATUS_SUCCESS)
+		return SDMMC_PARAM;
+	_wait();
+	stats.read_cmds++;
+	stats.read_blocks += count;
+	if (count > 1)
+		stats.multi_cmds++;
+	return SDMMC_OK;
+}
+
+static uint8_t _write(uint32_t addr, const void* data, uint32_t count)
+{
+	if (!card)
+		return SDMMC_NOT_INITIALIZED;
+	if (count == 0)
+		return SDMMC_OK;
+	latency.access_us = timing.write;
+	latency.block_us = timing.write_block;
+	if (media_write(card, addr, (void*)data, count, NULL, NULL)
+	    != MEDIA_STATUS_SUCCESS)
+		return SDMMC_PARAM;
+	_wait();
+	stats.write_cmds++;
+	stats.write_blocks += count;
+	if (count > 1)
+		stats.multi_cmds++;
+	return SDMMC_OK;
+}
+
+/*------------------------------------------------------------------------------
+ *         libsdmmc functions
+ *------------------------------------------------------------------------------*/
+
+uint8_t SD_Init(sSdCard* pSd)
+{
+	return card ? SDMMC_OK : SDMMC_NOT_SUPPORTED;
+}
+
+void SD_DeInit(sSdCard* pSd)
+{
+}
+
+uint8_t SD_GetStatus(const sSdCard* pSd)
+{
+	return card ? SDMMC_OK : SDMMC_NOT_SUPPORTED;
+}
+
+uint32_t SD_GetNumberBlocks(const sSdCard* pSd)
+{
+	return card ? media_get_size(card) : 0;
+}
+
+uint32_t SD_GetBlockSize(const sSdCard* pSd)
+{
+	return card ? media_get_block_size(card) : 0;
+}
+
+uint8_t SD_ReadBlocks(sSdCard* pSd, uint32_t dwAddr, void* pData,
+		uint32_t dwNbBlocks)
+{
+	return _read(dwAddr, pData, dwNbBlocks);
+}
+
+uint8_t SD_WriteBlocks(sSdCard* pSd, uint32_t dwAddr, const void* pData,
+		uint32_t dwNbBlocks)
+{
+	return _write(dwAddr, pData, dwNbBlocks);
+}
+
+uint8_t SD_Read(sSdCard* pSd, uint32_t dwAddr, void* pData,
+		uint32_t dwNbBlocks, fSdmmcCallback fCallback, void* pArg)
+{
+	uint8_t rc = _read(dwAddr, pData, dwNbBlocks);
+
+	if (fCallback)
+		fCallback(rc, pArg);
+	return rc;
+}
+
+uint8_t SD_Write(sSdCard* pSd, uint32_t dwAddr, const void* pData,
+		uint32_t dwNbBlocks, fSdmmcCallback fCallback, void* pArg)
+{
+	uint8_t rc = _write(dwAddr, pData, dwNbBlocks);
+
+	if (fCallback)
+		fCallback(rc, pArg);
+	return rc;
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+void sdcard_sim_init(struct _media* media,
+		const struct _sdcard_sim_timing* t)
+{
+	host_timer_reset();
+	timer_wheel_init();
+
+	card = media;
+	timing = t ? *t : default_timing;
+	media_ramdisk_set_latency(card, &latency);
+	sdcard_sim_reset_stats();
+	start_ns = host_time_ns();
+	wait_ns = 0;
+}
+
+const struct _sdcard_sim_stats* sdcard_sim_get_stats(void)
+{
+	return &stats;
+}
+
+void sdcard_sim_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+uint64_t sdcard_sim_time_ns(void)
+{
+	return host_time_ns() - start_ns - wait_ns + host_timer_ns();
+}
@@ -0,0 +1,107 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Simulated SD card for host tests.
+ *
+ *  sdcard_sim.c replaces the block access functions of libsdmmc
+ *  (SD_ReadBlocks, SD_Read, SD_WriteBlocks, SD_Write and the status and
+ *  geometry getters) with a card stored in a RAM disk media. The access
+ *  time of each command is simulated with the latency of media_ramdisk,
+ *  driven by the timer wheel on the simulated system timer: waiting for a
+ *  command advances the virtual clock instead of spinning, so that
+ *  sdcard_sim_time_ns() adds the time of the card to the CPU time of the
+ *  host.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _SDCARD_SIM_H_
+#define _SDCARD_SIM_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+#include "libstoragemedia/media.h"
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+/** Access times of the card, in microseconds */
+struct _sdcard_sim_timing {
+	uint32_t read;         /**< Command and access time of a read */
+	uint32_t read_block;   /**< Transfer of a block read */
+	uint32_t write;        /**< Command and busy time of a write */
+	uint32_t write_block;  /**< Transfer and programming of a block */
+};
+
+struct _sdcard_sim_stats {
+	uint32_t read_cmds;     /**< CMD17 and CMD18 */
+	uint32_t write_cmds;    /**< CMD24 and CMD25 */
+	uint32_t multi_cmds;    /**< CMD18 and CMD25 */
+	uint32_t read_blocks;
+	uint32_t write_blocks;
+};
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Insert a card. Initializes the timer wheel on the simulated timer.
+ * \param media   RAM disk media holding the content of the card, with
+ *                512-byte blocks
+ * \param timing  Access times, NULL for the defaults (class 10 card)
+ */
+extern void sdcard_sim_init(struct _media* media,
+		const struct _sdcard_sim_timing* timing);
+
+/**
+ * \brief Get the command counters.
+ */
+extern const struct _sdcard_sim_stats* sdcard_sim_get_stats(void);
+
+/**
+ * \brief Clear the command counters.
+ */
+extern void sdcard_sim_reset_stats(void);
+
+/**
+ * \brief Time elapsed since sdcard_sim_init(): access time of the card plus
+ * CPU time of the host, in nanoseconds.
+ */
+extern uint64_t sdcard_sim_time_ns(void);
+
+#endif /* _SDCARD_SIM_H_ */
@@ -0,0 +1,176 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <string.h>
+
+#include "chip.h"
+
+#include "host_mmio.h"
+#include "host_soc.h"
+#include "trng_sim.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+/** Peripheral clock cycles per word */
+#define WORD_CYCLES 84
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static struct {
+	uint32_t seed;
+	uint64_t now;
+
+	/* registers */
+	bool enabled;
+	uint32_t imr;
+
+	/* next word of the sequence, valid from ready_at */
+	uint32_t index;
+	uint64_t ready_at;
+
+	struct _trng_sim_stats stats;
+} _sim;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/** Set a read-only register, from a hook */
+static void _set(const volatile uint32_t* reg, uint32_t value)
+{
+	*(volatile uint32_t*)reg = value;
+}
+
+static void _read_hook(uint32_t addr)
+{
+	if (addr == (uint32_t)&TRNG->TRNG_ISR) {
+		assert(_sim.enabled);
+		/* The polling loop waits for the next word */
+		if (_sim.now < _sim.ready_at) {
+			_sim.stats.polls++;
+			_sim.stats.poll_ns += _sim.ready_at - _sim.now;
+			_sim.now = _sim.ready_at;
+		}
+		_set(&TRNG->TRNG_ISR, TRNG_ISR_DATRDY);
+	} else if (addr == (uint32_t)&TRNG->TRNG_IMR) {
+		_set(&TRNG->TRNG_IMR, _sim.imr);
+	} else if (addr == (uint32_t)&TRNG->TRNG_ODATA) {
+		_set(&TRNG->TRNG_ODATA, trng_sim_value(_sim.seed, _sim.index++));
+		_sim.ready_at = _sim.now + trng_sim_word_ns();
+		_sim.stats.words++;
+	}
+}
+
+static void _write_hook(uint32_t addr)
+{
+	uint32_t value = *(volatile uint32_t*)(uintptr_t)addr;
+
+	if (addr == (uint32_t)&TRNG->TRNG_CR) {
+		if ((value & TRNG_CR_KEY_Msk) != TRNG_CR_KEY_PASSWD)
+			return;
+		if ((value & TRNG_CR_ENABLE) && !_sim.enabled)
+			_sim.ready_at = _sim.now + trng_sim_word_ns();
+		_sim.enabled = (value & TRNG_CR_ENABLE) != 0;
+	} else if (addr == (uint32_t)&TRNG->TRNG_IER) {
+		_sim.imr |= value & TRNG_IMR_DATRDY;
+	} else if (addr == (uint32_t)&TRNG->TRNG_IDR) {
+		_sim.imr &= ~value;
+	}
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+void trng_sim_init(uint32_t seed)
+{
+	static bool trapped;
+
+	memset(&_sim, 0, sizeof(_sim));
+	_sim.seed = seed;
+
+	if (!trapped) {
+		trapped = host_mmio_register((uint32_t)TRNG, sizeof(*TRNG),
+				_read_hook, _write_hook);
+		assert(trapped);
+	}
+}
+
+uint32_t trng_sim_value(uint32_t seed, uint32_t n)
+{
+	/* murmur3 finalizer of a Weyl sequence */
+	uint32_t z = seed + (n + 1) * 0x9e3779b9;
+
+	z = (z ^ (z >> 16)) * 0x85ebca6b;
+	z = (z ^ (z >> 13)) * 0xc2b2ae35;
+	return z ^ (z >> 16);
+}
+
+void trng_sim_advance(uint64_t ns)
+{
+	uint64_t end = _sim.now + ns;
+	uint32_t index;
+
+	while (_sim.enabled && (_sim.imr & TRNG_IMR_DATRDY) &&
+	       _sim.ready_at <= end) {
+		_sim.now = _sim.ready_at;
+		index = _sim.index;
+		if (!host_irq_raise(ID_TRNG))
+			break;
+		_sim.stats.irqs++;
+		/* DATRDY stays set until TRNG_ODATA is read */
+		if (_sim.index == index)
+			break;
+	}
+	_sim.now = end;
+}
+
+uint64_t trng_sim_time_ns(void)
+{
+	return _sim.now;
+}
+
+uint64_t trng_sim_word_ns(void)
+{
+	return WORD_CYCLES * 1000000000ull / HOST_SOC_PERIPH_CLOCK;
+}
+
+void trng_sim_get_stats(struct _trng_sim_stats* stats)
+{
+	*stats = _sim.stats;
+}
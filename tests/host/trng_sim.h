@@ -0,0 +1,102 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Simulated TRNG for host tests.
+ *
+ *  The registers of the TRNG are trapped: trng.c runs unchanged against a
+ *  model producing one word every 84 peripheral clock cycles once enabled.
+ *  Every read of TRNG_ODATA returns the next word of a reproducible
+ *  sequence (see trng_sim_value()), so that a test can recompute what a
+ *  consumer of the TRNG received.
+ *
+ *  Time only moves when the test calls trng_sim_advance(), which raises
+ *  the TRNG interrupt for each word produced while DATRDY is enabled, or
+ *  when TRNG_ISR is polled with no word ready: the clock then jumps to the
+ *  next word and the wait is counted as polling time.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _TRNG_SIM_H_
+#define _TRNG_SIM_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+struct _trng_sim_stats {
+	uint64_t words;         /**< Words read from TRNG_ODATA */
+	uint64_t irqs;          /**< Interrupts raised */
+	uint64_t polls;         /**< Words waited for by polling TRNG_ISR */
+	uint64_t poll_ns;       /**< Time spent waiting by polling */
+};
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Trap the TRNG registers and reset the model and the clock.
+ * \param seed  Selects the sequence of words returned by TRNG_ODATA
+ */
+extern void trng_sim_init(uint32_t seed);
+
+/**
+ * \brief Word number \a n (from 0) of the sequence selected by \a seed.
+ */
+extern uint32_t trng_sim_value(uint32_t seed, uint32_t n);
+
+/**
+ * \brief Move the clock forward, raising the interrupts falling in the
+ * interval.
+ */
+extern void trng_sim_advance(uint64_t ns);
+
+/**
+ * \brief Current time, in nanoseconds since trng_sim_init().
+ */
+extern uint64_t trng_sim_time_ns(void);
+
+/**
+ * \brief Interval between two words, in nanoseconds.
+ */
+extern uint64_t trng_sim_word_ns(void);
+
+extern void trng_sim_get_stats(struct _trng_sim_stats* stats);
+
+#endif /* _TRNG_SIM_H_ */
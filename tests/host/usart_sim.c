@@ -0,0 +1,293 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <string.h>
+
+#include "chip.h"
+
+#include "dma_sim.h"
+#include "host_mmio.h"
+#include "host_soc.h"
+#include "usart_sim.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+/** Start, 8 data and stop bits */
+#define CHAR_BITS 10
+
+/** Size of the line queue (power of two) */
+#define LINE_SIZE 65536
+
+/** Status bits cleared by RSTSTA */
+#define CSR_ERRORS (US_CSR_OVRE | US_CSR_FRAME | US_CSR_PARE)
+
+/** Timeout counter states */
+enum _sim_timeout {
+	TO_WAIT,      /**< Waiting for a character (after STTTO) */
+	TO_RUNNING,   /**< Counting, reloaded by each character */
+	TO_STOPPED,   /**< Expired, or disabled */
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static struct {
+	Usart* usart;
+	uint32_t id;
+	uint32_t baudrate;
+	uint64_t now;
+
+	/* registers */
+	uint32_t csr;
+	uint32_t imr;
+	uint32_t rhr;
+	uint32_t rtor;
+
+	enum _sim_timeout timeout;
+	uint64_t deadline;
+
+	/* line: characters received at line_start + (n + 1) * CHAR_BITS bits */
+	uint8_t queue[LINE_SIZE];
+	uint32_t head, tail;
+	uint64_t line_start;
+	uint64_t line_count;
+
+	/* an enabled status was set by a register access */
+	bool irq_pending;
+
+	struct _usart_sim_stats stats;
+} _sim;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static uint64_t _bits_ns(uint64_t bits)
+{
+	return bits * 1000000000ull / _sim.baudrate;
+}
+
+static uint64_t _next_char_time(void)
+{
+	return _sim.line_start + _bits_ns((_sim.line_count + 1) * CHAR_BITS);
+}
+
+static void _start_timeout(void)
+{
+	uint32_t to = _sim.rtor & US_RTOR_TO_Msk;
+
+	if (to == 0) {
+		_sim.timeout = TO_STOPPED;
+		return;
+	}
+	_sim.timeout = TO_RUNNING;
+	_sim.deadline = _sim.now + _bits_ns(to);
+}
+
+/** Set a read-only register, from a hook */
+static void _set(const volatile uint32_t* reg, uint32_t value)
+{
+	*(volatile uint32_t*)reg = value;
+}
+
+static void _read_hook(uint32_t addr)
+{
+	Usart* usart = _sim.usart;
+
+	if (addr == (uint32_t)&usart->US_CSR) {
+		_set(&usart->US_CSR, _sim.csr | US_CSR_TXRDY | US_CSR_TXEMPTY);
+	} else if (addr == (uint32_t)&usart->US_IMR) {
+		_set(&usart->US_IMR, _sim.imr);
+	} else if (addr == (uint32_t)&usart->US_RHR) {
+		_set(&usart->US_RHR, _sim.rhr);
+		_sim.csr &= ~US_CSR_RXRDY;
+	}
+}
+
+static void _write_hook(uint32_t addr)
+{
+	Usart* usart = _sim.usart;
+	uint32_t value = *(volatile uint32_t*)(uintptr_t)addr;
+	uint32_t enabled = _sim.imr;
+
+	if (addr == (uint32_t)&usart->US_CR) {
+		if (value & US_CR_RSTRX)
+			_sim.csr &= ~US_CSR_RXRDY;
+		if (value & US_CR_RSTSTA)
+			_sim.csr &= ~CSR_ERRORS;
+		if (value & US_CR_STTTO) {
+			_sim.csr &= ~US_CSR_TIMEOUT;
+			_sim.timeout = TO_WAIT;
+		}
+		if (value & US_CR_RETTO) {
+			_sim.csr &= ~US_CSR_TIMEOUT;
+			_start_timeout();
+		}
+	} else if (addr == (uint32_t)&usart->US_RTOR) {
+		_sim.rtor = value;
+	} else if (addr == (uint32_t)&usart->US_IER) {
+		_sim.imr |= value;
+	} else if (addr == (uint32_t)&usart->US_IDR) {
+		_sim.imr &= ~value;
+	}
+
+	/* Raised by usart_sim_advance(), not from the trap */
+	if (_sim.csr & _sim.imr & ~enabled)
+		_sim.irq_pending = true;
+}
+
+static void _raise(uint32_t set)
+{
+	if (set & _sim.imr) {
+		_sim.stats.irqs++;
+		host_irq_raise(_sim.id);
+	}
+}
+
+static void _receive(void)
+{
+	uint32_t set = US_CSR_RXRDY;
+
+	_sim.now = _next_char_time();
+	_sim.line_count++;
+
+	if (_sim.csr & US_CSR_RXRDY) {
+		_sim.csr |= US_CSR_OVRE;
+		_sim.stats.overruns++;
+		set |= US_CSR_OVRE;
+	}
+	_sim.rhr = _sim.queue[_sim.tail++ & (LINE_SIZE - 1)];
+	_sim.csr |= US_CSR_RXRDY;
+	_sim.stats.sent++;
+
+	if (_sim.timeout != TO_STOPPED)
+		_start_timeout();
+
+	/* The DMA reads US_RHR, which clears RXRDY */
+	dma_sim_request(_sim.id, false, 1);
+	_raise(set & _sim.csr);
+}
+
+static void _expire(void)
+{
+	_sim.now = _sim.deadline;
+	_sim.timeout = TO_STOPPED;
+	_sim.csr |= US_CSR_TIMEOUT;
+	_sim.stats.timeouts++;
+	_raise(US_CSR_TIMEOUT);
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+void usart_sim_init(Usart* usart, uint32_t baudrate)
+{
+	static bool trapped;
+
+	memset(&_sim, 0, sizeof(_sim));
+	_sim.usart = usart;
+	_sim.id = get_usart_id_from_addr(usart);
+	_sim.baudrate = baudrate;
+	_sim.timeout = TO_STOPPED;
+
+	if (!trapped) {
+		trapped = host_mmio_register((uint32_t)usart, sizeof(*usart),
+				_read_hook, _write_hook);
+		assert(trapped);
+	}
+}
+
+void usart_sim_send(const uint8_t* data, uint32_t len)
+{
+	uint32_t i;
+
+	assert(len <= LINE_SIZE - (_sim.head - _sim.tail));
+	if (_sim.head == _sim.tail) {
+		/* idle line: start now, or after the last character */
+		uint64_t end = _sim.line_start + _bits_ns(_sim.line_count * CHAR_BITS);
+		_sim.line_start = end > _sim.now ? end : _sim.now;
+		_sim.line_count = 0;
+	}
+	for (i = 0; i < len; i++)
+		_sim.queue[_sim.head++ & (LINE_SIZE - 1)] = data[i];
+}
+
+uint32_t usart_sim_pending(void)
+{
+	return _sim.head - _sim.tail;
+}
+
+void usart_sim_advance(uint64_t ns)
+{
+	uint64_t end = _sim.now + ns;
+
+	if (_sim.irq_pending) {
+		_sim.irq_pending = false;
+		_raise(_sim.csr);
+	}
+
+	for (;;) {
+		bool rx = _sim.head != _sim.tail;
+		bool to = _sim.timeout == TO_RUNNING;
+		uint64_t t_rx = rx ? _next_char_time() : UINT64_MAX;
+		uint64_t t_to = to ? _sim.deadline : UINT64_MAX;
+
+		if (t_rx <= t_to && t_rx <= end)
+			_receive();
+		else if (t_to < t_rx && t_to <= end)
+			_expire();
+		else
+			break;
+	}
+	_sim.now = end;
+}
+
+uint64_t usart_sim_time_ns(void)
+{
+	return _sim.now;
+}
+
+uint64_t usart_sim_char_ns(void)
+{
+	return _bits_ns(CHAR_BITS);
+}
+
+void usart_sim_get_stats(struct _usart_sim_stats* stats)
+{
+	*stats = _sim.stats;
+}
@@ -0,0 +1,114 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Simulated USART receiver for host tests.
+ *
+ *  The registers of the USART are trapped: usart.c and usartd.c run
+ *  unchanged against a model of the receive side (holding register,
+ *  RXRDY, overrun, receiver timeout with STTTO and RETTO, interrupt mask)
+ *  while the transmitter is always ready. The characters queued with
+ *  usart_sim_send() arrive back to back on the line at the configured
+ *  baudrate (8 data bits, 1 stop bit); each one is offered to the DMA
+ *  model with dma_sim_request() and the interrupt handlers are called when
+ *  an enabled status is set.
+ *
+ *  Time only moves when the test calls usart_sim_advance(), which stands
+ *  for the CPU time spent by the application: the characters and
+ *  timeouts falling in the interval are processed in order.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _USART_SIM_H_
+#define _USART_SIM_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+#include "chip.h"
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+struct _usart_sim_stats {
+	uint64_t sent;          /**< Characters received from the line */
+	uint64_t overruns;      /**< Characters lost in the holding register */
+	uint32_t timeouts;      /**< Receiver timeouts */
+	uint32_t irqs;          /**< Interrupts raised */
+};
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Trap the registers of a USART and reset the model and the clock.
+ * To be called before usartd_configure().
+ * \param usart     USART instance
+ * \param baudrate  Bit rate of the line
+ */
+extern void usart_sim_init(Usart* usart, uint32_t baudrate);
+
+/**
+ * \brief Queue characters on the line. They follow the characters already
+ * queued, or start now if the line is idle.
+ */
+extern void usart_sim_send(const uint8_t* data, uint32_t len);
+
+/**
+ * \brief Number of characters queued and not yet received.
+ */
+extern uint32_t usart_sim_pending(void);
+
+/**
+ * \brief Move the clock forward, receiving the characters and raising the
+ * interrupts falling in the interval.
+ */
+extern void usart_sim_advance(uint64_t ns);
+
+/**
+ * \brief Current time, in nanoseconds since usart_sim_init().
+ */
+extern uint64_t usart_sim_time_ns(void);
+
+/**
+ * \brief Duration of a character on the line, in nanoseconds.
+ */
+extern uint64_t usart_sim_char_ns(void);
+
+extern void usart_sim_get_stats(struct _usart_sim_stats* stats);
+
+#endif /* _USART_SIM_H_ */
@@ -0,0 +1,287 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include "host_timer.h"
+#include "usbd_sim.h"
+
+#include "timer_wheel.h"
+#include "usb/device/usbd.h"
+
+#include <string.h>
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define NUM_ENDPOINTS   16
+
+/** Host transfers queued per OUT endpoint */
+#define OUT_QUEUE       4
+
+/** Size of the bulk packets at high speed */
+#define PACKET_SIZE     512
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+struct _endpoint {
+	bool halted;
+
+	/* Transfer of the device */
+	bool busy;
+	bool started;
+	bool in;
+	uint8_t* data;
+	uint32_t length;
+	uint32_t done;
+	usbd_xfer_cb_t callback;
+	void* callback_arg;
+	struct _timer_event event;
+
+	/* Transfers queued by the host */
+	const uint8_t* out[OUT_QUEUE];
+	uint32_t out_length[OUT_QUEUE];
+	uint32_t out_head;
+	uint32_t out_count;
+	uint32_t out_offset;
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static const struct _usbd_sim_timing default_timing = {
+	.bytes_per_us = 40,
+	.xfer_us = 5,
+};
+
+static struct _usbd_sim_timing timing;
+static struct _usbd_sim_stats stats;
+
+static usbd_sim_in_cb_t host_in;
+static void* host_in_arg;
+
+static struct _endpoint endpoints[NUM_ENDPOINTS];
+
+/** End of the last transfer scheduled on the bus, in nanoseconds */
+static uint64_t bus_free_ns;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static struct _endpoint* _get(uint8_t endpoint)
+{
+	return &endpoints[endpoint % NUM_ENDPOINTS];
+}
+
+/** Occupy the bus for \a length bytes and arm the completion */
+static void _schedule(struct _endpoint* ep, uint32_t length)
+{
+	uint64_t now = host_timer_ns();
+	uint64_t start = bus_free_ns > now ? bus_free_ns : now;
+
+	bus_free_ns = start + (uint64_t)timing.xfer_us * 1000
+		+ (uint64_t)length * 1000 / timing.bytes_per_us;
+	ep->done = length;
+	ep->started = true;
+	timer_wheel_add(&ep->event, (uint32_t)((bus_free_ns - now + 999) / 1000), 0);
+}
+
+/** Start the pending read of an OUT endpoint if the host sent data */
+static void _start_out(struct _endpoint* ep)
+{
+	uint32_t length;
+
+	if (!ep->busy || ep->started || ep->out_count == 0)
+		return;
+	length = ep->out_length[ep->out_head] - ep->out_offset;
+	if (length > ep->length)
+		length = ep->length;
+	_schedule(ep, length);
+}
+
+static int _complete(void* arg, void* arg2)
+{
+	struct _endpoint* ep = (struct _endpoint*)arg;
+	uint8_t endpoint = (uint8_t)(ep - endpoints);
+	usbd_xfer_cb_t callback = ep->callback;
+	uint32_t done = ep->done;
+
+	if (ep->in) {
+		stats.in_xfers++;
+		stats.in_bytes += done;
+		if (host_in)
+			host_in(host_in_arg, endpoint, ep->data, done);
+	} else {
+		memcpy(ep->data, ep->out[ep->out_head] + ep->out_offset, done);
+		ep->out_offset += done;
+		if (ep->out_offset == ep->out_length[ep->out_head]) {
+			ep->out_head = (ep->out_head + 1) % OUT_QUEUE;
+			ep->out_count--;
+			ep->out_offset = 0;
+		}
+		stats.out_xfers++;
+		stats.out_bytes += done;
+	}
+
+	ep->busy = false;
+	ep->started = false;
+	if (callback)
+		callback(ep->callback_arg, USBD_STATUS_SUCCESS, done,
+				ep->length - done);
+	return 0;
+}
+
+static uint8_t _transfer(uint8_t endpoint, bool in, void* data,
+		uint32_t length, usbd_xfer_cb_t callback, void* callback_arg)
+{
+	struct _endpoint* ep = _get(endpoint);
+
+	if (ep->busy || ep->halted)
+		return USBD_STATUS_LOCKED;
+
+	ep->busy = true;
+	ep->started = false;
+	ep->in = in;
+	ep->data = (uint8_t*)data;
+	ep->length = length;
+	ep->callback = callback;
+	ep->callback_arg = callback_arg;
+	if (in)
+		_schedule(ep, length);
+	else
+		_start_out(ep);
+	return USBD_STATUS_SUCCESS;
+}
+
+/*------------------------------------------------------------------------------
+ *         usbd functions
+ *------------------------------------------------------------------------------*/
+
+uint8_t usbd_write(uint8_t endpoint, const void *data, uint32_t length,
+		usbd_xfer_cb_t callback, void *callback_arg)
+{
+	return _transfer(endpoint, true, (void*)data, length,
+			callback, callback_arg);
+}
+
+uint8_t usbd_read(uint8_t endpoint, void *data, uint32_t length,
+		usbd_xfer_cb_t callback, void *callback_arg)
+{
+	return _transfer(endpoint, false, data, length,
+			callback, callback_arg);
+}
+
+uint16_t usbd_get_data_size(uint8_t endpoint)
+{
+	struct _endpoint* ep = _get(endpoint);
+	uint32_t length;
+
+	if (ep->out_count == 0)
+		return 0;
+	length = ep->out_length[ep->out_head] - ep->out_offset;
+	return length > PACKET_SIZE ? PACKET_SIZE : length;
+}
+
+uint8_t usbd_stall(uint8_t endpoint)
+{
+	return USBD_STATUS_SUCCESS;
+}
+
+void usbd_halt(uint8_t endpoint)
+{
+	_get(endpoint)->halted = true;
+	stats.halts++;
+}
+
+void usbd_unhalt(uint8_t endpoint)
+{
+	_get(endpoint)->halted = false;
+}
+
+bool usbd_is_halted(uint8_t endpoint)
+{
+	return _get(endpoint)->halted;
+}
+
+uint8_t usbd_get_state(void)
+{
+	return USBD_STATE_CONFIGURED;
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+void usbd_sim_init(const struct _usbd_sim_timing* t,
+		usbd_sim_in_cb_t in_cb, void* arg)
+{
+	uint32_t i;
+
+	for (i = 0; i < NUM_ENDPOINTS; i++)
+		timer_wheel_cancel(&endpoints[i].event);
+	memset(endpoints, 0, sizeof(endpoints));
+	for (i = 0; i < NUM_ENDPOINTS; i++)
+		timer_event_init(&endpoints[i].event, _complete, &endpoints[i]);
+
+	timing = t ? *t : default_timing;
+	host_in = in_cb;
+	host_in_arg = arg;
+	bus_free_ns = 0;
+	usbd_sim_reset_stats();
+}
+
+bool usbd_sim_host_out(uint8_t endpoint, const void* data, uint32_t length)
+{
+	struct _endpoint* ep = _get(endpoint);
+
+	if (ep->out_count == OUT_QUEUE || length == 0)
+		return false;
+	ep->out[(ep->out_head + ep->out_count) % OUT_QUEUE] = data;
+	ep->out_length[(ep->out_head + ep->out_count) % OUT_QUEUE] = length;
+	ep->out_count++;
+	_start_out(ep);
+	return true;
+}
+
+const struct _usbd_sim_stats* usbd_sim_get_stats(void)
+{
+	return &stats;
+}
+
+void usbd_sim_reset_stats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
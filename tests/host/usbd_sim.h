@@ -0,0 +1,117 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Simulated USB device port for host tests.
+ *
+ *  usbd_sim.c replaces the bulk endpoint functions of usbd.c (usbd_read,
+ *  usbd_write, usbd_get_data_size and the halt functions) with a port
+ *  always in the configured state and connected to a host played by the
+ *  test: usbd_sim_host_out() queues the transfers the host sends on an OUT
+ *  endpoint, and the data the device writes on an IN endpoint is handed to
+ *  a callback of the test.
+ *
+ *  Transfers share one bus of fixed bandwidth and complete from the timer
+ *  wheel on the simulated system timer, with a fixed cost per transfer for
+ *  the setup and the completion interrupt, so that a class driver polled
+ *  from the main loop of the test runs against USB timings in virtual
+ *  time.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _USBD_SIM_H_
+#define _USBD_SIM_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+/** Timings of the bus */
+struct _usbd_sim_timing {
+	uint32_t bytes_per_us;  /**< Bulk bandwidth */
+	uint32_t xfer_us;       /**< Setup and completion of each transfer */
+};
+
+struct _usbd_sim_stats {
+	uint32_t out_xfers;     /**< usbd_read() transfers completed */
+	uint32_t in_xfers;      /**< usbd_write() transfers completed */
+	uint64_t out_bytes;
+	uint64_t in_bytes;
+	uint32_t halts;         /**< usbd_halt() calls */
+};
+
+/** Receives the data of a completed IN transfer */
+typedef void (*usbd_sim_in_cb_t)(void* arg, uint8_t endpoint,
+		const uint8_t* data, uint32_t length);
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Reset the endpoints. The timer wheel must be initialized.
+ * \param timing  Bus timings, NULL for the defaults (high speed, 40 MB/s)
+ * \param in_cb   Called with the data of each IN transfer
+ * \param arg     Argument of \a in_cb
+ */
+extern void usbd_sim_init(const struct _usbd_sim_timing* timing,
+		usbd_sim_in_cb_t in_cb, void* arg);
+
+/**
+ * \brief Queue a transfer sent by the host on an OUT endpoint.
+ *
+ * A device read completes with the data of one host transfer at most, as
+ * if it ended with a short packet. The data is not copied and must stay
+ * valid until it has been read by the device.
+ * \return false if the queue of the endpoint is full or \a length is 0
+ */
+extern bool usbd_sim_host_out(uint8_t endpoint, const void* data,
+		uint32_t length);
+
+/**
+ * \brief Get the transfer counters.
+ */
+extern const struct _usbd_sim_stats* usbd_sim_get_stats(void);
+
+/**
+ * \brief Clear the transfer counters.
+ */
+extern void usbd_sim_reset_stats(void);
+
+#endif /* _USBD_SIM_H_ */
@@ -0,0 +1,641 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  AES CTR streaming engine and GCM (aesd_stream.c) on a simulated AES
+ *  peripheral: known-answer tests (FIPS-197, SP 800-38A CTR, GCM test
+ *  cases), then comparison against a plain reference implementation on
+ *  random messages split in random fragments, with the peripheral
+ *  counter wrapping inside a message. The reference uses the software
+ *  block cipher and a bit-serial GHASH.
+ *
+ *  The benchmark reports GCM packets/s for 64 B, 512 B and 4 KB packets
+ *  with the hardware and software selection and in software only, and
+ *  chained 64 B CTR packets. The software runs on the host, the
+ *  peripheral is simulated (see aes_sim.h).
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <string.h>
+
+#include "chip.h"
+
+#include "crypto/aes_soft.h"
+#include "crypto/aesd.h"
+#include "crypto/aesd_stream.h"
+#include "dma/dma.h"
+#include "mm/cache.h"
+
+#include "intmath.h"
+
+#include "aes_sim.h"
+#include "host.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define MAX_MESSAGE     (64 * 1024)
+
+#define RANDOM_MESSAGES 400
+
+/** Packets of the benchmark, kept in distinct buffers */
+#define BENCH_BUFFER    (256 * 1024)
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+struct _gcm_vector {
+	const char* key;
+	const char* iv;
+	const char* aad;
+	const char* plain;
+	const char* cipher;
+	const char* tag;
+};
+
+/*------------------------------------------------------------------------------
+ *         Local constants
+ *------------------------------------------------------------------------------*/
+
+/* GCM test cases 2, 3, 4, 6, 14 and 16 of McGrew and Viega */
+static const struct _gcm_vector gcm_vectors[] = {
+	{
+		"00000000000000000000000000000000",
+		"000000000000000000000000",
+		"",
+		"00000000000000000000000000000000",
+		"0388dace60b6a392f328c2b971b2fe78",
+		"ab6e47d42cec13bdf53a67b21257bddf",
+	},
+	{
+		"feffe9928665731c6d6a8f9467308308",
+		"cafebabefacedbaddecaf888",
+		"",
+		"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+		"1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255",
+		"42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+		"21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091473f5985",
+		"4d5c2af327cd64a62cf35abd2ba6fab4",
+	},
+	{
+		"feffe9928665731c6d6a8f9467308308",
+		"cafebabefacedbaddecaf888",
+		"feedfacedeadbeeffeedfacedeadbeefabaddad2",
+		"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+		"1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+		"42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+		"21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091",
+		"5bc94fbc3221a5db94fae95ae7121a47",
+	},
+	{
+		"feffe9928665731c6d6a8f9467308308",
+		"9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728"
+		"c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57a637b39b",
+		"feedfacedeadbeeffeedfacedeadbeefabaddad2",
+		"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+		"1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+		"8ce24998625615b603a033aca13fb894be9112a5c3a211a8ba262a3cca7e2ca7"
+		"01e4a9a4fba43c90ccdcb281d48c7c6fd62875d2aca417034c34aee5",
+		"619cc5aefffe0bfa462af43c1699d050",
+	},
+	{
+		"0000000000000000000000000000000000000000000000000000000000000000",
+		"000000000000000000000000",
+		"",
+		"00000000000000000000000000000000",
+		"cea7403d4d606b6e074ec5d3baf39d18",
+		"d0d1c8a799996bf0265b98b5d48ab919",
+	},
+	{
+		"feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+		"cafebabefacedbaddecaf888",
+		"feedfacedeadbeeffeedfacedeadbeefabaddad2",
+		"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+		"1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+		"522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+		"8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662",
+		"76fc6ece0f4e1768cddf8853bb2d551b",
+	},
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static struct _aesd_desc desc;
+
+static struct _aesd_gcm gcm;
+static struct _aesd_stream stream;
+
+CACHE_ALIGNED static uint8_t msg_in[MAX_MESSAGE + 64];
+CACHE_ALIGNED static uint8_t msg_out[MAX_MESSAGE + 64];
+CACHE_ALIGNED static uint8_t msg_ref[MAX_MESSAGE + 64];
+CACHE_ALIGNED static uint8_t msg_back[MAX_MESSAGE + 64];
+
+CACHE_ALIGNED static uint8_t bench_in[BENCH_BUFFER];
+CACHE_ALIGNED static uint8_t bench_out[BENCH_BUFFER];
+
+/*------------------------------------------------------------------------------
+ *         Reference implementation
+ *------------------------------------------------------------------------------*/
+
+static void ref_inc32(uint8_t* counter)
+{
+	int i;
+
+	for (i = 15; i >= 12; i--)
+		if (++counter[i] != 0)
+			break;
+}
+
+static void ref_ctr(const struct _aes_soft_ctx* ctx, const uint8_t* icb,
+		const uint8_t* in, uint8_t* out, uint32_t len)
+{
+	uint8_t counter[16], ks[16];
+	uint32_t i;
+
+	memcpy(counter, icb, 16);
+	for (i = 0; i < len; i++) {
+		if ((i % 16) == 0) {
+			aes_soft_encrypt(ctx, counter, ks);
+			ref_inc32(counter);
+		}
+		out[i] = in[i] ^ ks[i % 16];
+	}
+}
+
+/* x = x * h in GF(2^128), bit by bit (SP 800-38D, algorithm 1) */
+static void ref_gmult(uint8_t* x, const uint8_t* h)
+{
+	uint8_t z[16], v[16];
+	int i, j, lsb;
+
+	memset(z, 0, 16);
+	memcpy(v, h, 16);
+	for (i = 0; i < 128; i++) {
+		if (x[i / 8] & (0x80 >> (i % 8)))
+			for (j = 0; j < 16; j++)
+				z[j] ^= v[j];
+		lsb = v[15] & 1;
+		for (j = 15; j > 0; j--)
+			v[j] = (v[j] >> 1) | (v[j - 1] << 7);
+		v[0] >>= 1;
+		if (lsb)
+			v[0] ^= 0xe1;
+	}
+	memcpy(x, z, 16);
+}
+
+/* y = GHASH of data, zero-padded to a whole block */
+static void ref_ghash(uint8_t* y, const uint8_t* h, const uint8_t* data,
+		uint32_t len)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++) {
+		y[i % 16] ^= data[i];
+		if ((i % 16) == 15 || i == len - 1)
+			ref_gmult(y, h);
+	}
+}
+
+static void ref_gcm(const uint8_t* key, uint32_t key_len,
+		const uint8_t* iv, uint32_t iv_len,
+		const uint8_t* aad, uint32_t aad_len,
+		const uint8_t* in, uint8_t* out, uint32_t len,
+		bool encrypt, uint8_t* tag)
+{
+	struct _aes_soft_ctx ctx;
+	uint8_t h[16], j0[16], y[16], lengths[16], icb[16];
+	int i;
+
+	aes_soft_set_key(&ctx, key, key_len);
+	memset(h, 0, 16);
+	aes_soft_encrypt(&ctx, h, h);
+
+	memset(j0, 0, 16);
+	if (iv_len == 12) {
+		memcpy(j0, iv, 12);
+		j0[15] = 1;
+	} else {
+		ref_ghash(j0, h, iv, iv_len);
+		memset(lengths, 0, 16);
+		for (i = 0; i < 8; i++)
+			lengths[15 - i] = (uint8_t)(((uint64_t)iv_len * 8) >> (8 * i));
+		ref_ghash(j0, h, lengths, 16);
+	}
+
+	memcpy(icb, j0, 16);
+	ref_inc32(icb);
+	ref_ctr(&ctx, icb, in, out, len);
+
+	/* S = GHASH(A || 0^v || C || 0^u || [len(A)]64 || [len(C)]64) */
+	memset(y, 0, 16);
+	ref_ghash(y, h, aad, aad_len);
+	ref_ghash(y, h, encrypt ? out : in, len);
+	for (i = 0; i < 8; i++) {
+		lengths[7 - i] = (uint8_t)(((uint64_t)aad_len * 8) >> (8 * i));
+		lengths[15 - i] = (uint8_t)(((uint64_t)len * 8) >> (8 * i));
+	}
+	ref_ghash(y, h, lengths, 16);
+
+	aes_soft_encrypt(&ctx, j0, tag);
+	for (i = 0; i < 16; i++)
+		tag[i] ^= y[i];
+}
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static uint32_t unhex(uint8_t* out, const char* hex)
+{
+	uint32_t len = 0;
+	unsigned v;
+
+	while (hex[0] && hex[1]) {
+		sscanf(hex, "%2x", &v);
+		out[len++] = (uint8_t)v;
+		hex += 2;
+	}
+	return len;
+}
+
+static void set_key(const uint8_t* key, uint32_t len, bool encrypt)
+{
+	memset(desc.cfg.key, 0, sizeof(desc.cfg.key));
+	memcpy(desc.cfg.key, key, len);
+	desc.cfg.key_size = len == 16 ? AESD_AES128 :
+		len == 24 ? AESD_AES192 : AESD_AES256;
+	desc.cfg.encrypt = encrypt;
+}
+
+static void random_bytes(uint8_t* data, uint32_t len)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++)
+		data[i] = (uint8_t)host_rand();
+}
+
+/** Size of the next fragment of a random split */
+static uint32_t fragment(uint32_t left)
+{
+	uint32_t len;
+
+	switch (host_rand() % 4) {
+	case 0:
+		len = 1 + host_rand() % 15;
+		break;
+	case 1:
+		len = 16 + host_rand() % 112;
+		break;
+	case 2:
+		len = 32 * (1 + host_rand() % 64);
+		break;
+	default:
+		len = 1 + host_rand() % 4096;
+		break;
+	}
+	return min_u32(len, left);
+}
+
+/** GCM on the driver with the message split in random fragments */
+static int driver_gcm(const uint8_t* iv, uint32_t iv_len,
+		const uint8_t* aad, uint32_t aad_len,
+		const uint8_t* in, uint8_t* out, uint32_t len,
+		uint8_t* tag, bool split)
+{
+	uint32_t n, done = 0;
+	int err;
+
+	err = aesd_gcm_init(&gcm, &desc, iv, iv_len);
+	if (err < 0)
+		return err;
+	while (aad_len > 0) {
+		n = split ? fragment(aad_len) : aad_len;
+		aesd_gcm_update_aad(&gcm, aad, n);
+		aad += n;
+		aad_len -= n;
+	}
+	while (done < len) {
+		n = split ? fragment(len - done) : len - done;
+		aesd_gcm_update(&gcm, in + done, out + done, n);
+		done += n;
+	}
+	if (desc.cfg.encrypt)
+		return aesd_gcm_finish(&gcm, tag, 16);
+	return aesd_gcm_verify(&gcm, tag, 16);
+}
+
+static void test_known_answers(void)
+{
+	static const char* fips197[][2] = {
+		{ "000102030405060708090a0b0c0d0e0f",
+		  "69c4e0d86a7b0430d8cdb78070b4c55a" },
+		{ "000102030405060708090a0b0c0d0e0f1011121314151617",
+		  "dda97ca4864cdfe06eaf70a0ec0d7191" },
+		{ "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+		  "8ea2b7ca516745bfeafc49904b496089" },
+	};
+	struct _aes_soft_ctx ctx;
+	uint8_t key[32], iv[64], aad[32], plain[64], cipher[64], out[64];
+	uint8_t tag[16], expected[16];
+	uint32_t i, key_len, iv_len, aad_len, len;
+
+	printf("aes_gcm: known answers\n");
+
+	/* FIPS-197 appendix C */
+	unhex(plain, "00112233445566778899aabbccddeeff");
+	for (i = 0; i < ARRAY_SIZE(fips197); i++) {
+		key_len = unhex(key, fips197[i][0]);
+		unhex(expected, fips197[i][1]);
+		host_check(aes_soft_set_key(&ctx, key, key_len) == 0);
+		aes_soft_encrypt(&ctx, plain, out);
+		host_check(memcmp(out, expected, 16) == 0);
+	}
+	host_check(aes_soft_set_key(&ctx, key, 20) == -EINVAL);
+
+	/* SP 800-38A F.5.1, CTR-AES128: reference and driver stream */
+	key_len = unhex(key, "2b7e151628aed2a6abf7158809cf4f3c");
+	unhex(iv, "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+	len = unhex(msg_in, "6bc1bee22e409f96e93d7e117393172a"
+		"ae2d8a571e03ac9c9eb76fac45af8e5130c81c46a35ce411e5fbc1191a0a52ef"
+		"f69f2445df4f9b17ad2b417be66c3710");
+	unhex(cipher, "874d6191b620e3261bef6864990db6ce"
+		"9806f66b7970fdff8617187bb9fffdff5ae4df3edbd5d35e5b4f09020db03eab"
+		"1e031dda2fbe03d1792170a0f3009cee");
+	aes_soft_set_key(&ctx, key, key_len);
+	ref_ctr(&ctx, iv, msg_in, out, len);
+	host_check(memcmp(out, cipher, len) == 0);
+
+	set_key(key, key_len, true);
+	aesd_stream_init(&stream, &desc, iv);
+	aesd_stream_set_threshold(&stream, 0);
+	aesd_stream_update(&stream, msg_in, msg_out, len);
+	aesd_stream_wait(&stream);
+	host_check(stream.stats.hw_bytes == len);
+	aesd_stream_finish(&stream);
+	host_check(memcmp(msg_out, cipher, len) == 0);
+
+	/* GCM test cases: reference, driver in software, driver with the
+	 * peripheral for the aligned blocks */
+	for (i = 0; i < ARRAY_SIZE(gcm_vectors); i++) {
+		const struct _gcm_vector* v = &gcm_vectors[i];
+
+		key_len = unhex(key, v->key);
+		iv_len = unhex(iv, v->iv);
+		aad_len = unhex(aad, v->aad);
+		len = unhex(plain, v->plain);
+		unhex(cipher, v->cipher);
+		unhex(expected, v->tag);
+
+		ref_gcm(key, key_len, iv, iv_len, aad, aad_len, plain, out, len,
+			true, tag);
+		host_check(memcmp(out, cipher, len) == 0);
+		host_check(memcmp(tag, expected, 16) == 0);
+
+		set_key(key, key_len, true);
+		memcpy(msg_in, plain, len);
+		host_check(driver_gcm(iv, iv_len, aad, aad_len, msg_in, msg_out,
+			len, tag, false) == 0);
+		host_check(memcmp(msg_out, cipher, len) == 0);
+		host_check(memcmp(tag, expected, 16) == 0);
+
+		set_key(key, key_len, false);
+		memcpy(msg_in, cipher, len);
+		host_check(driver_gcm(iv, iv_len, aad, aad_len, msg_in, msg_out,
+			len, expected, false) == 0);
+		host_check(memcmp(msg_out, plain, len) == 0);
+		expected[i] ^= 0x01;
+		host_check(driver_gcm(iv, iv_len, aad, aad_len, msg_in, msg_out,
+			len, expected, false) == -EBADMSG);
+	}
+}
+
+/** Random messages, keys, IVs and splits against the reference */
+static void test_random_gcm(void)
+{
+	struct _aes_sim_stats sim;
+	uint8_t key[32], iv[64], aad[64], tag[16], ref_tag[16];
+	uint32_t i, key_len, iv_len, aad_len, len, off;
+	uint64_t hw = 0, sw = 0;
+	bool ok = true;
+
+	printf("aes_gcm: random messages against the reference\n");
+
+	for (i = 0; i < RANDOM_MESSAGES; i++) {
+		key_len = 16 + 8 * (host_rand() % 3);
+		iv_len = host_rand() % 4 ? 12 : 1 + host_rand() % 64;
+		aad_len = host_rand() % 65;
+		len = host_rand() % 2 ? host_rand() % 1024 :
+			host_rand() % MAX_MESSAGE;
+		/* input word-aligned or not, output cache-aligned or not */
+		off = host_rand() % 4 ? 0 : host_rand() % 64;
+		random_bytes(key, key_len);
+		random_bytes(iv, iv_len);
+		random_bytes(aad, aad_len);
+		random_bytes(msg_in + off, len);
+
+		ref_gcm(key, key_len, iv, iv_len, aad, aad_len, msg_in + off,
+			msg_ref, len, true, ref_tag);
+
+		set_key(key, key_len, true);
+		if (driver_gcm(iv, iv_len, aad, aad_len, msg_in + off, msg_out + off,
+				len, tag, true) != 0)
+			ok = false;
+		if (memcmp(msg_out + off, msg_ref, len) || memcmp(tag, ref_tag, 16))
+			ok = false;
+		hw += gcm.stream.stats.hw_bytes;
+		sw += gcm.stream.stats.sw_bytes;
+
+		set_key(key, key_len, false);
+		if (driver_gcm(iv, iv_len, aad, aad_len, msg_out + off, msg_back + off,
+				len, tag, true) != 0)
+			ok = false;
+		if (memcmp(msg_back + off, msg_in + off, len))
+			ok = false;
+		tag[host_rand() % 16] ^= 1 << (host_rand() % 8);
+		if (driver_gcm(iv, iv_len, aad, aad_len, msg_out + off, msg_back + off,
+				len, tag, true) != -EBADMSG)
+			ok = false;
+	}
+	aes_sim_get_stats(&sim);
+	host_check(ok);
+	host_check(hw > 0 && sw > 0);
+	host_check(sim.errors == 0);
+	printf("  %u messages, %llu bytes by the peripheral, %llu in software\n",
+		RANDOM_MESSAGES, (unsigned long long)hw, (unsigned long long)sw);
+}
+
+/** CTR stream with the 16-bit and 32-bit counters wrapping */
+static void test_counter_wrap(uint32_t start)
+{
+	struct _aes_soft_ctx ctx;
+	uint8_t key[16], icb[16];
+	uint32_t n, done = 0, len = MAX_MESSAGE;
+
+	random_bytes(key, sizeof(key));
+	random_bytes(icb, 12);
+	icb[12] = start >> 24;
+	icb[13] = start >> 16;
+	icb[14] = start >> 8;
+	icb[15] = start;
+	random_bytes(msg_in, len);
+
+	aes_soft_set_key(&ctx, key, sizeof(key));
+	ref_ctr(&ctx, icb, msg_in, msg_ref, len);
+
+	set_key(key, sizeof(key), true);
+	host_check(aesd_stream_init(&stream, &desc, icb) == 0);
+	host_check(aesd_stream_init(&stream, &desc, icb) == -EBUSY);
+	while (done < len) {
+		n = fragment(len - done);
+		aesd_stream_update(&stream, msg_in + done, msg_out + done, n);
+		done += n;
+	}
+	aesd_stream_finish(&stream);
+	host_check(memcmp(msg_out, msg_ref, len) == 0);
+	host_check(stream.stats.hw_bytes + stream.stats.sw_bytes == len);
+	host_check(stream.stats.hw_bytes > 0);
+	printf("  counter from 0x%08x: %u runs, %u bytes by the peripheral\n",
+		(unsigned)start, (unsigned)stream.stats.runs,
+		(unsigned)stream.stats.hw_bytes);
+}
+
+static void bench_gcm(uint32_t size, bool software)
+{
+	struct _aes_sim_stats sim0, sim1;
+	uint8_t key[16], iv[12], aad[16], tag[16];
+	uint32_t count = 4 * 1024 * 1024 / size, i, off = 0;
+	uint64_t t0, t1, hw = 0;
+
+	if (count > 20000)
+		count = 20000;
+	random_bytes(key, sizeof(key));
+	random_bytes(iv, sizeof(iv));
+	random_bytes(aad, sizeof(aad));
+	random_bytes(bench_in, BENCH_BUFFER);
+	set_key(key, sizeof(key), true);
+
+	aes_sim_get_stats(&sim0);
+	t0 = aes_sim_time_ns();
+	for (i = 0; i < count; i++) {
+		iv[11]++;
+		aesd_gcm_init(&gcm, &desc, iv, sizeof(iv));
+		if (software)
+			aesd_stream_set_threshold(&gcm.stream, UINT32_MAX);
+		aesd_gcm_update_aad(&gcm, aad, sizeof(aad));
+		aesd_gcm_update(&gcm, bench_in + off, bench_out + off, size);
+		aesd_gcm_finish(&gcm, tag, sizeof(tag));
+		hw += gcm.stream.stats.hw_bytes;
+		off = (off + size) % BENCH_BUFFER;
+	}
+	t1 = aes_sim_time_ns();
+	aes_sim_get_stats(&sim1);
+
+	printf("  GCM %4u B %-9s %9.0f packets/s %7.1f MB/s, %3u%% hardware, "
+		"%.1f%% waiting\n", (unsigned)size,
+		software ? "software" : "auto",
+		count * 1e9 / (t1 - t0), (double)count * size * 1e3 / (t1 - t0),
+		(unsigned)(hw * 100 / ((uint64_t)count * size)),
+		(sim1.wait_ns - sim0.wait_ns) * 100.0 / (t1 - t0));
+}
+
+/** Many 64 B packets encrypted on one CTR stream, chained in DMA runs */
+static void bench_ctr_chained(uint32_t size)
+{
+	struct _aes_sim_stats sim0, sim1;
+	uint8_t key[16], icb[16];
+	uint32_t count = BENCH_BUFFER / size, i;
+	uint64_t t0, t1;
+
+	random_bytes(key, sizeof(key));
+	memset(icb, 0, sizeof(icb));
+	set_key(key, sizeof(key), true);
+
+	aes_sim_get_stats(&sim0);
+	t0 = aes_sim_time_ns();
+	aesd_stream_init(&stream, &desc, icb);
+	for (i = 0; i < count; i++)
+		aesd_stream_update(&stream, bench_in + i * size,
+			bench_out + i * size, size);
+	aesd_stream_finish(&stream);
+	t1 = aes_sim_time_ns();
+	aes_sim_get_stats(&sim1);
+
+	printf("  CTR %4u B chained %9.0f packets/s %7.1f MB/s, "
+		"%.1f packets per run\n", (unsigned)size,
+		count * 1e9 / (t1 - t0), (double)count * size * 1e3 / (t1 - t0),
+		(double)count / (sim1.runs - sim0.runs));
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	static const uint32_t sizes[] = { 64, 512, 4096 };
+	uint32_t i;
+
+	host_init();
+	dma_initialize(false);
+	aes_sim_init(NULL);
+	desc.xfer.dma.tx.channel = dma_allocate_channel(DMA_PERIPH_MEMORY, ID_AES);
+	desc.xfer.dma.rx.channel = dma_allocate_channel(ID_AES, DMA_PERIPH_MEMORY);
+
+	test_known_answers();
+	test_random_gcm();
+
+	printf("aes_gcm: CTR stream across counter wraps\n");
+	test_counter_wrap(0x0000fff0u);
+	test_counter_wrap(0xfffffff0u);
+	test_counter_wrap(host_rand());
+
+	printf("aes_gcm: throughput\n");
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		bench_gcm(sizes[i], false);
+		bench_gcm(sizes[i], true);
+	}
+	bench_ctr_chained(64);
+	bench_ctr_chained(512);
+
+	return host_report("aes_gcm");
+}
@@ -0,0 +1,814 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Sample-rate converter (audio_src.c) and stream mixer (audio_mixer.c).
+ *
+ *  A stereo test tone is saved as a WAV file, read back through the header
+ *  check of wav.c, converted from 44.1 kHz to 48 kHz and saved again, then
+ *  the THD+N of the converted file is measured: the residual after a least
+ *  squares fit of the tone and of a DC offset is the noise and distortion
+ *  added by the conversion. The measurement is repeated in memory for
+ *  several rate pairs and tone frequencies.
+ *
+ *  The mixer is fed by a simulated USB producer, one packet per
+ *  millisecond, whose clock drifts from the output clock: the feedback must
+ *  hold the mean ratio on the drift without under- or overrun. The ratio
+ *  hunts around it with the beat between packets and periods, so the THD+N
+ *  is measured there with a frequency fitted per 100 ms window. Gains,
+ *  saturation and the restart after an underrun are checked, then the cost
+ *  of the converter and of the mixer is reported in host CPU cycles per
+ *  output frame.
+ *
+ *  "test_audio in.wav out.wav [rate]" converts a 16-bit PCM file instead
+ *  (to 48000 Hz by default).
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "compiler.h"
+#include "errno.h"
+#include "intmath.h"
+#include "wav.h"
+
+#include "audio/audio_mixer.h"
+#include "audio/audio_src.h"
+
+#include "host.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+/** Longest signal analysed, in frames */
+#define MAX_FRAMES      50000
+
+/** Test tones at -6 dBFS */
+#define AMPLITUDE       16384.0
+
+/** Output frames left out of the analysis (start of the filter) */
+#define SKIP_FRAMES     256
+
+/** Input frames per call of the converter, 1 ms at 48 kHz */
+#define PACKET_FRAMES   48
+
+/** Mixer setup of the usb_audio_speaker example */
+#define STREAM_FRAMES   1024
+#define PERIOD_FRAMES   96
+
+#define DRIFT_SECONDS   30
+
+/** Tone of the drift test */
+#define FREQ            1000.0
+
+/** Most tones at once in a fit */
+#define MAX_TONES       2
+
+#define BENCH_ROUNDS    5
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+struct _rates {
+	uint32_t in;
+	uint32_t out;
+};
+
+struct _drift {
+	uint32_t rate;
+	int32_t ppm;
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static const struct _rates conversions[] = {
+	{ 44100, 48000 },
+	{ 48000, 48000 },
+	{ 32000, 48000 },
+	{ 16000, 48000 },
+	{ 8000, 48000 },
+	{ 48000, 44100 },
+};
+
+static const uint32_t tones[] = { 100, 1000, 5000, 10000, 15000, 18000 };
+
+static const struct _drift drifts[] = {
+	{ 48000, 500 },
+	{ 48000, -500 },
+	{ 44100, 200 },
+};
+
+static int16_t in_buf[MAX_FRAMES * AUDIO_SRC_MAX_CHANNELS];
+static int16_t out_buf[MAX_FRAMES * AUDIO_SRC_MAX_CHANNELS];
+
+static struct _audio_src src;
+static struct _audio_mixer mixer;
+static int16_t rings[AUDIO_MIXER_MAX_STREAMS][STREAM_FRAMES * AUDIO_SRC_MAX_CHANNELS];
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/** Sine of frequency freq[c] on channel c */
+static void tone(int16_t* data, uint32_t frames, uint8_t channels,
+		uint32_t rate, const double* freq, double amplitude)
+{
+	uint32_t i, c;
+
+	for (i = 0; i < frames; i++)
+		for (c = 0; c < channels; c++)
+			data[i * channels + c] = (int16_t)lrint(amplitude *
+					sin(2 * M_PI * freq[c] * i / rate));
+}
+
+static bool wav_save(const char* path, const int16_t* data, uint32_t frames,
+		uint8_t channels, uint32_t rate)
+{
+	struct _wav_header header;
+	uint32_t size = frames * channels * sizeof(int16_t);
+	FILE* f;
+	bool ok;
+
+	memcpy(&header.chunk_id, "RIFF", 4);
+	header.chunk_size = sizeof(header) - 8 + size;
+	memcpy(&header.format, "WAVE", 4);
+	memcpy(&header.subchunk1_id, "fmt ", 4);
+	header.subchunk1_size = 16;
+	header.audio_format = 1;
+	header.num_channels = channels;
+	header.sample_rate = rate;
+	header.byte_rate = rate * channels * sizeof(int16_t);
+	header.block_align = channels * sizeof(int16_t);
+	header.bits_per_sample = 16;
+	memcpy(&header.subchunk2_id, "data", 4);
+	header.subchunk2_size = size;
+
+	f = fopen(path, "wb");
+	if (!f)
+		return false;
+	ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+		fwrite(data, 1, size, f) == size;
+	return fclose(f) == 0 && ok;
+}
+
+/** Load a 16-bit PCM WAV file.
+ * \return the frames (to free), NULL if the file is not supported */
+static int16_t* wav_load(const char* path, struct _wav_header* header,
+		uint32_t* frames)
+{
+	int16_t* data = NULL;
+	FILE* f;
+
+	f = fopen(path, "rb");
+	if (!f)
+		return NULL;
+	if (fread(header, sizeof(*header), 1, f) == 1 &&
+	    wav_is_valid(header) && header->audio_format == 1 &&
+	    header->bits_per_sample == 16 && header->num_channels >= 1 &&
+	    header->num_channels <= AUDIO_SRC_MAX_CHANNELS &&
+	    !memcmp(&header->subchunk2_id, "data", 4)) {
+		*frames = header->subchunk2_size / header->block_align;
+		data = malloc(*frames * header->block_align + 1);
+		if (data && fread(data, header->block_align, *frames, f) != *frames) {
+			free(data);
+			data = NULL;
+		}
+	}
+	fclose(f);
+	return data;
+}
+
+/** Run the converter one packet at a time, as a stream would.
+ * \return Number of output frames */
+static uint32_t convert(struct _audio_src* s, const int16_t* in,
+		uint32_t in_frames, int16_t* out, uint32_t out_max,
+		uint64_t* cycles)
+{
+	uint32_t consumed = 0, produced = 0, n, used;
+	uint64_t t0, spent = 0;
+
+	while (consumed < in_frames && produced < out_max) {
+		n = min_u32(PACKET_FRAMES, in_frames - consumed);
+		used = n;
+		t0 = host_cycles();
+		produced += audio_src_process(s, in + consumed * s->channels,
+				&used, out + produced * s->channels,
+				out_max - produced);
+		spent += host_cycles() - t0;
+		consumed += used;
+	}
+	if (cycles)
+		*cycles = spent;
+	return produced;
+}
+
+/** Convert a WAV file, used by the test and from the command line */
+static bool wav_convert(const char* in_path, const char* out_path,
+		uint32_t rate)
+{
+	struct _wav_header header;
+	int16_t *in, *out;
+	uint32_t frames, out_frames;
+	bool ok = false;
+
+	in = wav_load(in_path, &header, &frames);
+	if (!in) {
+		printf("%s: not a 16-bit PCM WAV file\n", in_path);
+		return false;
+	}
+	if (audio_src_init(&src, header.num_channels, header.sample_rate,
+			   rate) < 0) {
+		printf("%s: cannot convert %u Hz to %u Hz\n", in_path,
+				(unsigned)header.sample_rate, (unsigned)rate);
+	} else {
+		out_frames = (uint32_t)((uint64_t)frames * rate /
+				header.sample_rate) + 1;
+		out = malloc(out_frames * header.block_align);
+		if (out) {
+			out_frames = convert(&src, in, frames, out, out_frames,
+					NULL);
+			ok = wav_save(out_path, out, out_frames,
+					header.num_channels, rate);
+			free(out);
+		}
+	}
+	free(in);
+	return ok;
+}
+
+/** Solve the normal equations of the fit in place (m unknowns) */
+static void solve(double a[][2 * MAX_TONES + 2], uint32_t m)
+{
+	uint32_t i, j, k, p;
+	double t;
+
+	for (i = 0; i < m; i++) {
+		for (p = i, j = i + 1; j < m; j++)
+			if (fabs(a[j][i]) > fabs(a[p][i]))
+				p = j;
+		for (k = 0; k <= m; k++) {
+			t = a[i][k];
+			a[i][k] = a[p][k];
+			a[p][k] = t;
+		}
+		for (j = 0; j < m; j++) {
+			if (j == i)
+				continue;
+			t = a[j][i] / a[i][i];
+			for (k = i; k <= m; k++)
+				a[j][k] -= t * a[i][k];
+		}
+	}
+	for (i = 0; i < m; i++)
+		a[i][m] /= a[i][i];
+}
+
+/**
+ * THD+N of a signal made of \a count tones of angular frequencies \a w
+ * (radians per frame): power of the residual after a least squares fit of
+ * the tones and of a DC offset, relative to the power of the tones.
+ * \param amplitude  Receives the amplitude of each tone
+ * \return THD+N in dB
+ */
+static double thdn(const int16_t* y, uint32_t stride, uint32_t frames,
+		const double* w, uint32_t count, double* amplitude)
+{
+	double a[2 * MAX_TONES + 1][2 * MAX_TONES + 2];
+	double basis[2 * MAX_TONES + 1];
+	double fit, noise = 0, signal = 0;
+	const uint32_t m = 2 * count + 1;
+	uint32_t i, j, k;
+
+	memset(a, 0, sizeof(a));
+	for (i = 0; i < frames; i++) {
+		basis[0] = 1.0;
+		for (k = 0; k < count; k++) {
+			basis[1 + 2 * k] = sin(w[k] * i);
+			basis[2 + 2 * k] = cos(w[k] * i);
+		}
+		for (j = 0; j < m; j++) {
+			for (k = 0; k < m; k++)
+				a[j][k] += basis[j] * basis[k];
+			a[j][m] += basis[j] * y[i * stride];
+		}
+	}
+	solve(a, m);
+
+	for (i = 0; i < frames; i++) {
+		fit = 0;
+		for (k = 0; k < count; k++)
+			fit += a[1 + 2 * k][m] * sin(w[k] * i) +
+				a[2 + 2 * k][m] * cos(w[k] * i);
+		signal += fit * fit;
+		fit += a[0][m];
+		noise += (y[i * stride] - fit) * (y[i * stride] - fit);
+	}
+	for (k = 0; k < count; k++)
+		amplitude[k] = hypot(a[1 + 2 * k][m], a[2 + 2 * k][m]);
+	return 10 * log10(noise / signal);
+}
+
+/**
+ * Least squares fit of c + a sin(w t) + b cos(w t), t centered on the
+ * window; with \a m = 4 the frequency is fitted too, linearized around the
+ * previous estimate \a x[1], \a x[2] (four-parameter sine fit of IEEE 1057).
+ * \param x  Receives c, a, b and the correction of \a w
+ */
+static void fit_sine(const int16_t* y, uint32_t stride, uint32_t window,
+		double w, uint32_t m, double x[4])
+{
+	double a[2 * MAX_TONES + 1][2 * MAX_TONES + 2];
+	double basis[4], t;
+	uint32_t i, j, k;
+
+	memset(a, 0, sizeof(a));
+	for (i = 0; i < window; i++) {
+		t = (double)i - window / 2;
+		basis[0] = 1.0;
+		basis[1] = sin(w * t);
+		basis[2] = cos(w * t);
+		basis[3] = t * (x[1] * basis[2] - x[2] * basis[1]);
+		for (j = 0; j < m; j++) {
+			for (k = 0; k < m; k++)
+				a[j][k] += basis[j] * basis[k];
+			a[j][m] += basis[j] * y[i * stride];
+		}
+	}
+	solve(a, m);
+	for (j = 0; j < m; j++)
+		x[j] = a[j][m];
+}
+
+/**
+ * THD+N of a tone whose frequency wanders slowly, as with the ratio of an
+ * adaptive converter: the frequency is fitted in each window, which keeps
+ * the wander slower than the window out of the residual, as the tracking
+ * notch of an audio analyzer does.
+ * \param w       Initial angular frequency, radians per frame
+ * \param window  Frames per window
+ * \param wander  Receives the peak frequency deviation from \a w, relative
+ * \return THD+N in dB
+ */
+static double thdn_tracking(const int16_t* y, uint32_t stride, uint32_t frames,
+		double w, uint32_t window, double* wander)
+{
+	const double w0 = w;
+	double x[4], fit, t, noise = 0, signal = 0;
+	uint32_t start, i, it;
+
+	*wander = 0;
+	for (start = 0; start + window <= frames; start += window) {
+		const int16_t* win = &y[start * stride];
+
+		x[1] = x[2] = 0;
+		fit_sine(win, stride, window, w, 3, x);
+		for (it = 0; it < 4; it++) {
+			fit_sine(win, stride, window, w, 4, x);
+			w += x[3];
+		}
+		fit_sine(win, stride, window, w, 3, x);
+		if (fabs(w / w0 - 1) > *wander)
+			*wander = fabs(w / w0 - 1);
+
+		for (i = 0; i < window; i++) {
+			t = (double)i - window / 2;
+			fit = x[1] * sin(w * t) + x[2] * cos(w * t);
+			signal += fit * fit;
+			fit += x[0] - win[i * stride];
+			noise += fit * fit;
+		}
+	}
+	return 10 * log10(noise / signal);
+}
+
+/** Angular frequency, at the output of a converter, of a tone at the input */
+static double out_omega(const struct _audio_src* s, double freq, uint32_t rate)
+{
+	return 2 * M_PI * freq / rate * s->step / AUDIO_SRC_ONE;
+}
+
+static double db(double ratio)
+{
+	return 20 * log10(ratio);
+}
+
+static void test_wav(void)
+{
+	const double freq[2] = { 1000, 3000 };
+	char in_path[] = "/tmp/audio_in_XXXXXX";
+	char out_path[] = "/tmp/audio_out_XXXXXX";
+	struct _wav_header header;
+	int16_t* data;
+	uint32_t frames, c;
+	double w, amplitude, noise;
+	int fd;
+
+	printf("audio: WAV files\n");
+
+	fd = mkstemp(in_path);
+	close(fd);
+	fd = mkstemp(out_path);
+	close(fd);
+
+	tone(in_buf, 44100, 2, 44100, freq, AMPLITUDE);
+	host_check(wav_save(in_path, in_buf, 44100, 2, 44100));
+	host_check(wav_convert(in_path, out_path, 48000));
+
+	data = wav_load(out_path, &header, &frames);
+	host_check(data != NULL);
+	if (data) {
+		host_check(header.sample_rate == 48000);
+		host_check(header.num_channels == 2);
+		host_check(frames >= 48000 - AUDIO_SRC_TAPS && frames <= 48001);
+		for (c = 0; c < 2; c++) {
+			w = out_omega(&src, freq[c], 44100);
+			noise = thdn(data + SKIP_FRAMES * 2 + c, 2,
+					frames - SKIP_FRAMES, &w, 1, &amplitude);
+			printf("  44100 Hz to 48000 Hz, %u Hz tone: THD+N %.1f dB,"
+					" gain %+.3f dB\n", (unsigned)freq[c], noise,
+					db(amplitude / AMPLITUDE));
+			host_check(noise < -80.0);
+			host_check(fabs(db(amplitude / AMPLITUDE)) < 0.05);
+		}
+		free(data);
+	}
+
+	/* wav.c rejects what is not a WAV file */
+	memcpy(&header.format, "AVI ", 4);
+	host_check(!wav_is_valid(&header));
+
+	unlink(in_path);
+	unlink(out_path);
+}
+
+static void test_thdn(void)
+{
+	uint32_t i, j, frames, limit;
+	double freq[1], w, noise, amplitude;
+	char line[16];
+
+	printf("audio: THD+N at -6 dBFS, dB\n");
+	printf("  %-16s", "tone (Hz)");
+	for (j = 0; j < ARRAY_SIZE(tones); j++)
+		printf(" %7u", (unsigned)tones[j]);
+	printf("\n");
+
+	for (i = 0; i < ARRAY_SIZE(conversions); i++) {
+		const struct _rates* r = &conversions[i];
+
+		snprintf(line, sizeof(line), "%u to %u", (unsigned)r->in,
+				(unsigned)r->out);
+		printf("  %-16s", line);
+		/* flat part of the passband of the filter, and of the output */
+		limit = min_u32(r->in, r->out) * 7 / 20;
+		for (j = 0; j < ARRAY_SIZE(tones); j++) {
+			if (tones[j] > limit) {
+				printf(" %7s", "-");
+				continue;
+			}
+			freq[0] = tones[j];
+			tone(in_buf, r->in, 1, r->in, freq, AMPLITUDE);
+			host_check(audio_src_init(&src, 1, r->in, r->out) == 0);
+			frames = convert(&src, in_buf, r->in, out_buf,
+					MAX_FRAMES, NULL);
+			w = out_omega(&src, freq[0], r->in);
+			noise = thdn(out_buf + SKIP_FRAMES, 1,
+					frames - SKIP_FRAMES, &w, 1, &amplitude);
+			printf(" %7.1f", noise);
+			host_check(noise < (tones[j] <= 1000 ? -80.0 : -70.0));
+			host_check(fabs(db(amplitude / AMPLITUDE)) < 0.1);
+		}
+		printf("\n");
+	}
+}
+
+/** Mixer fed at in_rate * (1 + ppm) by 1 ms packets, rendered by periods at
+ * 48 kHz */
+static void test_drift_case(const struct _drift* d)
+{
+	const double speed = 1.0 + d->ppm * 1e-6;
+	const uint32_t periods = DRIFT_SECONDS * 48000 / PERIOD_FRAMES;
+	const uint32_t kept = MAX_FRAMES / PERIOD_FRAMES;
+	struct _audio_mixer_stats stats;
+	uint64_t packet = 0, produced = 0, level_sum = 0;
+	uint32_t period, i, n, level, level_min = UINT32_MAX, level_max = 0;
+	int32_t ppm_sum = 0, ppm_count = 0;
+	int32_t ppm_min = INT32_MAX, ppm_max = INT32_MIN;
+	double t_packet, t_period, noise, wander;
+	int16_t packet_buf[PACKET_FRAMES * 2];
+	int16_t period_buf[PERIOD_FRAMES * 2];
+
+	host_check(audio_mixer_init(&mixer, 2, 48000) == 0);
+	host_check(audio_mixer_stream_open(&mixer, 0, rings[0], STREAM_FRAMES,
+			d->rate) == 0);
+
+	for (period = 0; period < periods; period++) {
+		/* packets received before the end of the period */
+		t_period = (period + 1) * (double)PERIOD_FRAMES / 48000;
+		for (;;) {
+			t_packet = (packet + 1) * 1e-3 / speed;
+			if (t_packet > t_period)
+				break;
+			/* 44 or 45 frames per packet at 44.1 kHz */
+			n = (uint32_t)((packet + 1) * d->rate / 1000 -
+					packet * d->rate / 1000);
+			for (i = 0; i < n; i++)
+				packet_buf[2 * i] = packet_buf[2 * i + 1] =
+					(int16_t)lrint(AMPLITUDE * sin(2 * M_PI *
+					FREQ * (produced + i) / d->rate));
+			audio_mixer_stream_write(&mixer, 0, packet_buf, n);
+			produced += n;
+			packet++;
+		}
+
+		audio_mixer_render(&mixer, period_buf, PERIOD_FRAMES);
+		if (period >= periods - kept)
+			memcpy(out_buf + (period - (periods - kept)) *
+					PERIOD_FRAMES * 2, period_buf,
+					sizeof(period_buf));
+
+		/* statistics over the last 10 s, once settled */
+		if (t_period >= DRIFT_SECONDS - 10) {
+			audio_mixer_stream_get_stats(&mixer, 0, &stats);
+			level = audio_mixer_stream_level(&mixer, 0);
+			level_min = min_u32(level_min, level);
+			level_max = max_u32(level_max, level);
+			level_sum += level;
+			ppm_sum += stats.ppm;
+			if (stats.ppm < ppm_min)
+				ppm_min = stats.ppm;
+			if (stats.ppm > ppm_max)
+				ppm_max = stats.ppm;
+			ppm_count++;
+		}
+	}
+
+	audio_mixer_stream_get_stats(&mixer, 0, &stats);
+	/* the ratio keeps hunting around the drift, with the beat between
+	 * packets and periods: fit the tone per 100 ms window */
+	noise = thdn_tracking(out_buf, 2, kept * PERIOD_FRAMES,
+			2 * M_PI * FREQ * speed / 48000, 4800, &wander);
+
+	printf("  %u Hz %+4d ppm: ratio %+5.1f ppm (%+d..%+d),"
+			" level %u..%u (avg %u),"
+			" THD+N %.1f dB (tracking, wander %.0f ppm),"
+			" %u underruns, %u overruns\n",
+			(unsigned)d->rate, (int)d->ppm,
+			(double)ppm_sum / ppm_count, (int)(ppm_min - d->ppm),
+			(int)(ppm_max - d->ppm), (unsigned)level_min,
+			(unsigned)level_max,
+			(unsigned)(level_sum / ppm_count), noise, wander * 1e6,
+			(unsigned)stats.underruns, (unsigned)stats.overruns);
+
+	host_check(fabs((double)ppm_sum / ppm_count - d->ppm) < 10);
+	host_check(stats.underruns == 0 && stats.overruns == 0);
+	host_check(level_min > STREAM_FRAMES / 4 &&
+			level_max < STREAM_FRAMES * 3 / 4);
+	host_check(noise < -45.0);
+}
+
+static void test_drift(void)
+{
+	uint32_t i;
+
+	printf("audio: clock drift, 1 ms packets in, %u-frame periods out\n",
+			PERIOD_FRAMES);
+	for (i = 0; i < ARRAY_SIZE(drifts); i++)
+		test_drift_case(&drifts[i]);
+}
+
+static void test_mixer(void)
+{
+	const double freq[2] = { 1000, 3000 };
+	const uint32_t prefill = STREAM_FRAMES / 2;
+	const uint32_t periods = (MAX_FRAMES - prefill) / PERIOD_FRAMES;
+	int16_t period[PERIOD_FRAMES];
+	struct _audio_mixer_stats stats;
+	double w[2], amplitude[2], noise;
+	uint32_t i, p, st;
+	bool ok;
+
+	printf("audio: mixer\n");
+
+	host_check(audio_mixer_init(&mixer, 0, 48000) == -EINVAL);
+	host_check(audio_mixer_init(&mixer, 1, 48000) == 0);
+	host_check(audio_mixer_stream_open(&mixer, AUDIO_MIXER_MAX_STREAMS,
+			rings[0], STREAM_FRAMES, 48000) == -EINVAL);
+	host_check(audio_mixer_stream_open(&mixer, 0, rings[0], 1000,
+			48000) == -EINVAL);
+	/* downsampling is limited to 1.1 */
+	host_check(audio_mixer_stream_open(&mixer, 0, rings[0], STREAM_FRAMES,
+			53000) == -EINVAL);
+	host_check(audio_mixer_stream_open(&mixer, 0, rings[0], STREAM_FRAMES,
+			52800) == 0);
+
+	/* two tones with gains of -6 dB and -12 dB */
+	for (st = 0; st < 2; st++) {
+		tone(in_buf + st * MAX_FRAMES, MAX_FRAMES, 1, 48000, &freq[st],
+				AMPLITUDE);
+		host_check(audio_mixer_stream_open(&mixer, st, rings[st],
+				STREAM_FRAMES, 48000) == 0);
+		/* fixed ratio: the summing and the gains alone are measured */
+		audio_src_set_feedback(&mixer.streams[st].src, 0, 0, 0);
+		audio_mixer_stream_set_gain(&mixer, st,
+				AUDIO_MIXER_GAIN_UNITY >> (st + 1));
+		audio_mixer_stream_write(&mixer, st, in_buf + st * MAX_FRAMES,
+				prefill);
+	}
+	for (p = 0; p < periods; p++) {
+		for (st = 0; st < 2; st++)
+			audio_mixer_stream_write(&mixer, st, in_buf +
+					st * MAX_FRAMES + prefill +
+					p * PERIOD_FRAMES, PERIOD_FRAMES);
+		audio_mixer_render(&mixer, out_buf + p * PERIOD_FRAMES,
+				PERIOD_FRAMES);
+	}
+	for (st = 0; st < 2; st++)
+		w[st] = 2 * M_PI * freq[st] / 48000;
+	noise = thdn(out_buf + SKIP_FRAMES, 1,
+			periods * PERIOD_FRAMES - SKIP_FRAMES, w, 2, amplitude);
+	printf("  1 kHz at -6 dB + 3 kHz at -12 dB: %+.3f dB, %+.3f dB,"
+			" THD+N %.1f dB\n", db(amplitude[0] / AMPLITUDE),
+			db(amplitude[1] / AMPLITUDE), noise);
+	host_check(fabs(db(amplitude[0] / AMPLITUDE) + 6.02) < 0.05);
+	host_check(fabs(db(amplitude[1] / AMPLITUDE) + 12.04) < 0.05);
+	host_check(noise < -80.0);
+
+	/* the sum saturates instead of wrapping around */
+	for (i = 0; i < MAX_FRAMES; i++)
+		in_buf[i] = 30000;
+	for (st = 0; st < 2; st++) {
+		audio_mixer_stream_open(&mixer, st, rings[st], STREAM_FRAMES,
+				48000);
+		audio_mixer_stream_write(&mixer, st, in_buf, prefill);
+	}
+	for (p = 0, ok = true; p < 20; p++) {
+		for (st = 0; st < 2; st++)
+			audio_mixer_stream_write(&mixer, st, in_buf,
+					PERIOD_FRAMES);
+		audio_mixer_render(&mixer, period, PERIOD_FRAMES);
+		for (i = 0; i < PERIOD_FRAMES; i++)
+			if (p * PERIOD_FRAMES + i >= SKIP_FRAMES &&
+			    period[i] != INT16_MAX)
+				ok = false;
+	}
+	host_check(ok);
+	printf("  2 x 30000 at unity gain: %s\n", ok ? "saturated" : "FAILED");
+
+	/* an underrun plays silence until the ring is half full again */
+	for (p = 0; p < STREAM_FRAMES / PERIOD_FRAMES; p++)
+		audio_mixer_render(&mixer, period, PERIOD_FRAMES);
+	audio_mixer_stream_get_stats(&mixer, 0, &stats);
+	host_check(stats.underruns == 1);
+	for (i = 0, ok = true; i < PERIOD_FRAMES; i++)
+		ok = ok && period[i] == 0;
+	host_check(ok);
+	audio_mixer_stream_write(&mixer, 0, in_buf, prefill - 1);
+	audio_mixer_render(&mixer, period, PERIOD_FRAMES);
+	host_check(period[PERIOD_FRAMES - 1] == 0);
+	host_check(audio_mixer_stream_level(&mixer, 0) == prefill - 1);
+	audio_mixer_stream_write(&mixer, 0, in_buf, 1);
+	audio_mixer_render(&mixer, period, PERIOD_FRAMES);
+	host_check(period[PERIOD_FRAMES - 1] != 0);
+	printf("  underrun: %u, restart at %u frames\n",
+			(unsigned)stats.underruns, (unsigned)prefill);
+
+	/* flush from the producer side, done by the next render */
+	audio_mixer_stream_flush(&mixer, 0);
+	host_check(audio_mixer_stream_level(&mixer, 0) != 0);
+	audio_mixer_render(&mixer, period, PERIOD_FRAMES);
+	host_check(audio_mixer_stream_level(&mixer, 0) == 0);
+	host_check(period[PERIOD_FRAMES - 1] == 0);
+}
+
+static void test_cycles(void)
+{
+	const double freq[2] = { 1000, 3000 };
+	static const struct {
+		uint8_t channels;
+		uint32_t in;
+		uint32_t out;
+	} cases[] = {
+		{ 1, 44100, 48000 },
+		{ 2, 44100, 48000 },
+		{ 2, 48000, 48000 },
+		{ 2, 48000, 44100 },
+		{ 2, 16000, 48000 },
+	};
+	int16_t period[PERIOD_FRAMES * 2];
+	uint64_t cycles, best;
+	uint32_t i, r, frames, streams, st, p, periods;
+
+	printf("audio: host cycles per output frame\n");
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		tone(in_buf, cases[i].in / 2, cases[i].channels, cases[i].in,
+				freq, AMPLITUDE);
+		best = UINT64_MAX;
+		for (r = 0; r < BENCH_ROUNDS; r++) {
+			audio_src_init(&src, cases[i].channels, cases[i].in,
+					cases[i].out);
+			frames = convert(&src, in_buf, cases[i].in / 2, out_buf,
+					MAX_FRAMES, &cycles);
+			if (cycles < best)
+				best = cycles;
+		}
+		printf("  src %u ch %5u to %5u Hz %8.1f cycles"
+				" (%.1f per sample)\n",
+				(unsigned)cases[i].channels, (unsigned)cases[i].in,
+				(unsigned)cases[i].out, (double)best / frames,
+				(double)best / frames / cases[i].channels);
+	}
+
+	/* stereo 44.1 kHz streams mixed to 48 kHz, by periods */
+	tone(in_buf, MAX_FRAMES / 2, 2, 44100, freq, AMPLITUDE);
+	periods = 48000 / 2 / PERIOD_FRAMES;
+	for (streams = 1; streams <= AUDIO_MIXER_MAX_STREAMS; streams *= 2) {
+		best = UINT64_MAX;
+		for (r = 0; r < BENCH_ROUNDS; r++) {
+			audio_mixer_init(&mixer, 2, 48000);
+			for (st = 0; st < streams; st++) {
+				audio_mixer_stream_open(&mixer, st, rings[st],
+						STREAM_FRAMES, 44100);
+				audio_mixer_stream_write(&mixer, st, in_buf,
+						STREAM_FRAMES / 2);
+			}
+			cycles = 0;
+			for (p = 0; p < periods; p++) {
+				for (st = 0; st < streams; st++)
+					audio_mixer_stream_write(&mixer, st,
+						in_buf + 2 * (p * 88 % 4096), 88);
+				cycles -= host_cycles();
+				audio_mixer_render(&mixer, period,
+						PERIOD_FRAMES);
+				cycles += host_cycles();
+			}
+			if (cycles < best)
+				best = cycles;
+		}
+		printf("  mixer %u stream%s 44100 to 48000 Hz %8.1f cycles\n",
+				(unsigned)streams, streams > 1 ? "s" : " ",
+				(double)best / (periods * PERIOD_FRAMES));
+	}
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(int argc, char** argv)
+{
+	if (argc >= 3)
+		return wav_convert(argv[1], argv[2],
+				argc > 3 ? atoi(argv[3]) : 48000) ? 0 : 1;
+
+	host_init();
+
+	test_wav();
+	test_thdn();
+	test_drift();
+	test_mixer();
+	test_cycles();
+
+	return host_report("audio");
+}
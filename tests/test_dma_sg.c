@@ -0,0 +1,387 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Linked list items of the DMA driver: random configure, complete and
+ *  free sequences on several channels, with lists of random lengths
+ *  (including looped lists and lists larger than the free items), checking
+ *  the content of every list, that no item is shared, and that no item
+ *  is lost between the pool, the channel caches and the lists. Reports the
+ *  latency of building and releasing lists, in host cycles.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip.h"
+#include "compiler.h"
+
+#include "dma/dma.h"
+#include "dma/xdmac.h"
+
+#include "host.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define CHANNELS        8
+
+/** Items given with dma_sg_add_pool(), in addition to the built-in pool */
+#define EXTRA_ITEMS     1024
+
+#define MAX_LIST        512
+
+#define STRESS_OPS      200000
+
+/** Size classes of the latency report */
+#define SMALL_LIST      DMA_SG_CHANNEL_CACHE_SIZE
+#define MEDIUM_LIST     128
+
+/** Same layout as the private struct _dma_sg_desc of dma.c */
+#define ITEM(d)         ((struct _xdmac_desc_view1*)(d))
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static uint8_t extra[EXTRA_ITEMS * sizeof(struct _xdmac_desc_view1)];
+
+static struct _dma_channel* channels[CHANNELS];
+
+static struct _dma_transfer_cfg cfgs[MAX_LIST];
+
+/** Total number of items */
+static uint32_t total;
+
+/** Latency samples, in host cycles */
+static uint64_t lat_config[3][STRESS_OPS];
+static uint32_t lat_config_count[3];
+static uint64_t lat_release[STRESS_OPS];
+static uint32_t lat_release_count;
+
+/** Item addresses, for the duplicate check */
+static uintptr_t owned[DMA_SG_ITEM_POOL_SIZE + EXTRA_ITEMS];
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/** Random list length: mostly short lists, a few very long ones */
+static uint32_t random_length(void)
+{
+	uint32_t r = host_rand() % 100;
+
+	if (r < 70)
+		return 1 + host_rand() % SMALL_LIST;
+	else if (r < 95)
+		return SMALL_LIST + 1 + host_rand() % (MEDIUM_LIST - SMALL_LIST);
+	return MEDIUM_LIST + 1 + host_rand() % (MAX_LIST - MEDIUM_LIST);
+}
+
+static uint32_t size_class(uint32_t length)
+{
+	return length <= SMALL_LIST ? 0 : length <= MEDIUM_LIST ? 1 : 2;
+}
+
+/** Items not in the shared pool */
+static uint32_t held_items(void)
+{
+	uint32_t i, held = 0;
+
+	for (i = 0; i < CHANNELS; i++)
+		held += channels[i]->sg_count + channels[i]->sg_cache_count;
+	return held;
+}
+
+/** Check a list built from cfgs[] */
+static bool check_list(struct _dma_channel* channel, uint32_t length,
+		bool loop)
+{
+	struct _xdmac_desc_view1* item = ITEM(channel->sg_list);
+	uint32_t i;
+
+	if (channel->sg_count != length)
+		return false;
+	for (i = 0; i < length; i++) {
+		if (!item || item->mbr_sa != cfgs[i].saddr
+		    || item->mbr_da != cfgs[i].daddr
+		    || (item->mbr_ubc & XDMA_UBC_UBLEN_Msk) != cfgs[i].len)
+			return false;
+		if (i == length - 1) {
+			if (ITEM(channel->sg_tail) != item)
+				return false;
+			if (!loop && (item->mbr_ubc & XDMA_UBC_NDE_FETCH_EN))
+				return false;
+		}
+		item = item->mbr_nda;
+	}
+	return item == (loop ? ITEM(channel->sg_list) : NULL);
+}
+
+static int compare(const void* a, const void* b)
+{
+	uintptr_t x = *(const uintptr_t*)a;
+	uintptr_t y = *(const uintptr_t*)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/** Check that the lists and the caches of the channels share no item */
+static bool check_owners(void)
+{
+	struct _xdmac_desc_view1* item;
+	uint32_t i, j, n = 0;
+
+	for (i = 0; i < CHANNELS; i++) {
+		item = ITEM(channels[i]->sg_list);
+		for (j = 0; j < channels[i]->sg_count; j++) {
+			owned[n++] = (uintptr_t)item;
+			item = item->mbr_nda;
+		}
+		item = ITEM(channels[i]->sg_cache);
+		for (j = 0; j < channels[i]->sg_cache_count; j++) {
+			owned[n++] = (uintptr_t)item;
+			item = item->mbr_nda;
+		}
+	}
+	qsort(owned, n, sizeof(owned[0]), compare);
+	for (i = 1; i < n; i++)
+		if (owned[i] == owned[i - 1])
+			return false;
+	return true;
+}
+
+/** Configure a transfer of a random list on a channel */
+static int configure(struct _dma_channel* channel)
+{
+	struct _dma_cfg cfg = {
+		.data_width = DMA_DATA_WIDTH_WORD,
+		.chunk_size = DMA_CHUNK_SIZE_1,
+		.incr_saddr = true,
+		.incr_daddr = true,
+		.loop = host_rand() % 10 == 0,
+	};
+	uint32_t i, length = random_length(), available;
+	uint64_t t0, t1;
+	int err;
+
+	for (i = 0; i < length; i++) {
+		cfgs[i].saddr = (const void*)(uintptr_t)(0x20000000u + (host_rand() & ~3u) % 0x1000000u);
+		cfgs[i].daddr = (void*)(uintptr_t)(0x21000000u + (host_rand() & ~3u) % 0x1000000u);
+		cfgs[i].len = 1 + host_rand() % XDMAC_MAX_BLOCK_LEN;
+	}
+
+	/* the previous list of the channel is released first */
+	available = dma_sg_get_free_count() + channel->sg_count +
+		channel->sg_cache_count;
+
+	t0 = host_cycles();
+	err = dma_configure_transfer(channel, &cfg, cfgs, length);
+	t1 = host_cycles();
+
+	if (length == 1 && !cfg.loop) {
+		/* single block, no linked list */
+		host_check(err == 0);
+		host_check(channel->sg_list == NULL && channel->sg_count == 0);
+		return err;
+	}
+	if (length > available) {
+		host_check(err == -ENOMEM);
+		host_check(channel->sg_list == NULL && channel->sg_count == 0);
+		return err;
+	}
+	host_check(err == 0);
+	host_check(check_list(channel, length, cfg.loop));
+	i = size_class(length);
+	lat_config[i][lat_config_count[i]++] = (t1 - t0) / length;
+	return err;
+}
+
+/** Complete the transfer of a channel and release its list */
+static void release(struct _dma_channel* channel)
+{
+	uint64_t t0, t1;
+
+	/* as done by the interrupt handler at the end of the transfer */
+	channel->state = DMA_STATE_DONE;
+
+	t0 = host_cycles();
+	host_check(dma_reset_channel(channel) == 0);
+	t1 = host_cycles();
+
+	host_check(channel->sg_list == NULL && channel->sg_count == 0);
+	host_check(channel->sg_cache_count <= DMA_SG_CHANNEL_CACHE_SIZE);
+	lat_release[lat_release_count++] = t1 - t0;
+}
+
+static void print_latency(const char* name, uint64_t* samples,
+		uint32_t count)
+{
+	struct _host_summary s;
+
+	host_summarize(samples, count, &s);
+	printf("  %-28s %7u calls, p50 %4u, p99 %5u, max %7u\n", name,
+		(unsigned)count, (unsigned)s.p50, (unsigned)s.p99,
+		(unsigned)s.max);
+}
+
+static void stress(void)
+{
+	struct _dma_channel* channel;
+	uint32_t i, c, r, enomem = 0, lost = 0;
+
+	printf("dma_sg: %u random operations on %u channels, %u items\n",
+		STRESS_OPS, CHANNELS, (unsigned)total);
+
+	for (i = 0; i < STRESS_OPS; i++) {
+		c = host_rand() % CHANNELS;
+		channel = channels[c];
+		r = host_rand() % 100;
+		if (r < 55) {
+			if (configure(channel) == -ENOMEM)
+				enomem++;
+		} else if (r < 98) {
+			release(channel);
+		} else {
+			/* give the cache back to the pool */
+			channel->state = DMA_STATE_DONE;
+			host_check(dma_free_channel(channel) == 0);
+			host_check(channel->sg_list == NULL);
+			host_check(channel->sg_cache_count == 0);
+			channels[c] = dma_allocate_channel(DMA_PERIPH_MEMORY,
+					DMA_PERIPH_MEMORY);
+			host_check(channels[c] != NULL);
+			if (!channels[c])
+				return;
+		}
+		if (dma_sg_get_free_count() + held_items() != total)
+			lost++;
+		if (i % 1000 == 0)
+			host_check(check_owners());
+	}
+	host_check(lost == 0);
+	host_check(check_owners());
+	host_check(enomem > 0);
+	printf("  %u lists larger than the free items rejected\n", enomem);
+
+	printf("dma_sg: latency (host cycles per item when building)\n");
+	print_latency("build, 1-16 items", lat_config[0], lat_config_count[0]);
+	print_latency("build, 17-128 items", lat_config[1], lat_config_count[1]);
+	print_latency("build, 129-512 items", lat_config[2], lat_config_count[2]);
+	print_latency("release (whole list)", lat_release, lat_release_count);
+}
+
+/** Repeat the same transfer on one channel: items come from its cache
+ * when the list is short enough, from the pool otherwise */
+static void bench_repeat(uint32_t length)
+{
+	struct _dma_cfg cfg = {
+		.data_width = DMA_DATA_WIDTH_WORD,
+		.chunk_size = DMA_CHUNK_SIZE_1,
+		.incr_saddr = true,
+		.incr_daddr = true,
+	};
+	struct _dma_channel* channel = channels[0];
+	uint32_t i, pool;
+	uint64_t t0;
+
+	for (i = 0; i < length; i++) {
+		cfgs[i].saddr = (const void*)(uintptr_t)(0x20000000u + i * 0x1000u);
+		cfgs[i].daddr = (void*)(uintptr_t)(0x21000000u + i * 0x1000u);
+		cfgs[i].len = XDMAC_MAX_BLOCK_LEN;
+	}
+	host_check(dma_configure_transfer(channel, &cfg, cfgs, length) == 0);
+	release(channel);
+	pool = dma_sg_get_free_count();
+
+	t0 = host_cycles();
+	for (i = 0; i < 10000; i++) {
+		dma_configure_transfer(channel, &cfg, cfgs, length);
+		channel->state = DMA_STATE_DONE;
+		dma_reset_channel(channel);
+	}
+	printf("  %3u items: %6.1f host cycles per item%s\n", (unsigned)length,
+		(double)(host_cycles() - t0) / 10000 / length,
+		length <= DMA_SG_CHANNEL_CACHE_SIZE ? " (channel cache)" : "");
+
+	/* short lists never touch the shared pool */
+	if (length <= DMA_SG_CHANNEL_CACHE_SIZE)
+		host_check(dma_sg_get_free_count() == pool);
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	uint32_t i;
+
+	host_init();
+
+	dma_initialize(true);
+	total = DMA_SG_ITEM_POOL_SIZE + dma_sg_add_pool(extra, sizeof(extra));
+	host_check(total == DMA_SG_ITEM_POOL_SIZE + EXTRA_ITEMS);
+	host_check(dma_sg_get_free_count() == total);
+
+	for (i = 0; i < CHANNELS; i++) {
+		channels[i] = dma_allocate_channel(DMA_PERIPH_MEMORY,
+				DMA_PERIPH_MEMORY);
+		host_check(channels[i] != NULL);
+		if (!channels[i])
+			return host_report("dma_sg");
+	}
+
+	stress();
+
+	printf("dma_sg: repeated transfers on one channel\n");
+	bench_repeat(4);
+	bench_repeat(16);
+	bench_repeat(64);
+	bench_repeat(512);
+
+	/* everything back in the pool */
+	for (i = 0; i < CHANNELS; i++) {
+		channels[i]->state = DMA_STATE_DONE;
+		host_check(dma_free_channel(channels[i]) == 0);
+	}
+	host_check(dma_sg_get_free_count() == total);
+
+	return host_report("dma_sg");
+}
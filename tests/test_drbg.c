@@ -0,0 +1,535 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  TRNG-seeded CTR_DRBG (drbg.c) and xoshiro128** rand() on a simulated
+ *  TRNG.
+ *
+ *  The DRBG output is compared with a plain SP 800-90A CTR_DRBG (AES-256,
+ *  no derivation function) seeded with the same TRNG words, across
+ *  reseeds and requests split at the 64 KB limit. The entropy pool is
+ *  checked to fill from the interrupt, to stop it once full and to fall
+ *  back to polling when a reseed finds it too low. Both generators then
+ *  go through frequency, runs, byte chi-square and serial correlation
+ *  tests, which are first shown to reject poor sources.
+ *
+ *  The benchmark reports random_bytes() throughput per request size and
+ *  the cost of random_u32() and rand() calls on the host.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <math.h>
+#include <string.h>
+
+#include "chip.h"
+
+#include "crypto/aes_soft.h"
+#include "crypto/drbg.h"
+
+#include "rand.h"
+
+#include "host.h"
+#include "trng_sim.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define SEED_WORDS      12
+
+/* Largest generate request of drbg.c */
+#define MAX_REQUEST     (64 * 1024)
+
+#define STATS_BYTES     (4 * 1024 * 1024)
+
+/** Bound on the normal deviates of the statistical tests */
+#define MAX_Z           4.5
+
+/** Chi-square with 255 degrees of freedom, 0.01% and 99.99% quantiles */
+#define CHI2_MIN        171.0
+#define CHI2_MAX        339.0
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+struct _ref_drbg {
+	struct _aes_soft_ctx aes;
+	uint8_t v[16];
+	uint32_t reseed_counter;
+	uint32_t seed;          /* TRNG sequence */
+	uint32_t words;         /* TRNG words consumed */
+	uint32_t reseeds;
+};
+
+struct _stats_result {
+	double monobit_z;
+	double runs_z;
+	double chi2;
+	double serial_z;
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static struct _ref_drbg ref;
+
+static uint8_t buffer[STATS_BYTES];
+static uint8_t expected[3 * MAX_REQUEST];
+
+static uint32_t client_values;
+static uint32_t client_errors;
+
+/*------------------------------------------------------------------------------
+ *         Reference implementation
+ *------------------------------------------------------------------------------*/
+
+static void ref_increment(void)
+{
+	int i;
+
+	for (i = 15; i >= 0; i--)
+		if (++ref.v[i] != 0)
+			break;
+}
+
+/* CTR_DRBG_Update (SP 800-90A 10.2.1.2) */
+static void ref_update(const uint8_t* provided)
+{
+	uint8_t temp[48];
+	int i;
+
+	for (i = 0; i < 48; i += 16) {
+		ref_increment();
+		aes_soft_encrypt(&ref.aes, ref.v, &temp[i]);
+	}
+	if (provided)
+		for (i = 0; i < 48; i++)
+			temp[i] ^= provided[i];
+	aes_soft_set_key(&ref.aes, temp, 32);
+	memcpy(ref.v, &temp[32], 16);
+}
+
+/* Next seed from the TRNG, little-endian words */
+static void ref_seed(void)
+{
+	uint8_t seed[48];
+	uint32_t i, word;
+
+	for (i = 0; i < SEED_WORDS; i++) {
+		word = trng_sim_value(ref.seed, ref.words++);
+		memcpy(&seed[4 * i], &word, 4);
+	}
+	ref_update(seed);
+	ref.reseed_counter = 1;
+}
+
+static void ref_instantiate(uint32_t seed)
+{
+	uint8_t key[32];
+
+	memset(&ref, 0, sizeof(ref));
+	ref.seed = seed;
+	memset(key, 0, sizeof(key));
+	aes_soft_set_key(&ref.aes, key, sizeof(key));
+	ref_seed();
+}
+
+/* CTR_DRBG_Generate (SP 800-90A 10.2.1.5.1), reseeding when due */
+static void ref_generate(uint8_t* out, uint32_t len)
+{
+	uint8_t block[16];
+	uint32_t n;
+
+	if (ref.reseed_counter >= DRBG_RESEED_INTERVAL) {
+		ref_seed();
+		ref.reseeds++;
+	}
+	while (len > 0) {
+		ref_increment();
+		aes_soft_encrypt(&ref.aes, ref.v, block);
+		n = len < 16 ? len : 16;
+		memcpy(out, block, n);
+		out += n;
+		len -= n;
+	}
+	ref_update(NULL);
+	ref.reseed_counter++;
+}
+
+static void ref_random_bytes(uint8_t* out, uint32_t len)
+{
+	uint32_t n;
+
+	while (len > 0) {
+		n = len < MAX_REQUEST ? len : MAX_REQUEST;
+		ref_generate(out, n);
+		out += n;
+		len -= n;
+	}
+}
+
+/*------------------------------------------------------------------------------
+ *         Statistical tests
+ *------------------------------------------------------------------------------*/
+
+/** Frequency, runs (SP 800-22 2.1 and 2.3), byte chi-square and lag-1
+ * byte serial correlation, as normal deviates or chi-square value */
+static void stats_run(const uint8_t* data, uint32_t len,
+		struct _stats_result* result)
+{
+	static uint32_t counts[256];
+	double n = len * 8.0, pi, runs, expected_count, diff, chi2 = 0.0;
+	double sx = 0.0, sxx = 0.0, sxy = 0.0;
+	uint64_t ones = 0, transitions = 0;
+	uint32_t i, bits, prev;
+
+	memset(counts, 0, sizeof(counts));
+	prev = data[0] & 1;
+	for (i = 0; i < len; i++) {
+		counts[data[i]]++;
+		ones += __builtin_popcount(data[i]);
+		/* bit transitions inside the byte and with the previous one */
+		bits = data[i] | (prev << 8);
+		transitions += __builtin_popcount((bits ^ (bits >> 1)) & 0xff);
+		prev = data[i] & 1;
+
+		sx += data[i];
+		sxx += (double)data[i] * data[i];
+		if (i > 0)
+			sxy += (double)data[i - 1] * data[i];
+	}
+
+	result->monobit_z = (2.0 * ones - n) / sqrt(n);
+
+	pi = ones / n;
+	runs = transitions + 1;
+	result->runs_z = (runs - 2.0 * n * pi * (1.0 - pi)) /
+		(2.0 * sqrt(2.0 * n) * pi * (1.0 - pi));
+
+	expected_count = len / 256.0;
+	for (i = 0; i < 256; i++) {
+		diff = counts[i] - expected_count;
+		chi2 += diff * diff / expected_count;
+	}
+	result->chi2 = chi2;
+
+	/* Knuth's serial correlation coefficient, about N(0, 1/len) */
+	result->serial_z = (len * sxy - sx * sx) / (len * sxx - sx * sx) *
+		sqrt((double)len);
+}
+
+static bool stats_pass(const struct _stats_result* r)
+{
+	return fabs(r->monobit_z) < MAX_Z && fabs(r->runs_z) < MAX_Z &&
+	       r->chi2 > CHI2_MIN && r->chi2 < CHI2_MAX &&
+	       fabs(r->serial_z) < MAX_Z;
+}
+
+static void stats_print(const char* name, const struct _stats_result* r)
+{
+	printf("  %-20s monobit z %6.2f, runs z %6.2f, chi2 %6.1f, "
+		"serial z %6.2f\n", name, r->monobit_z, r->runs_z, r->chi2,
+		r->serial_z);
+}
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/** Random request size, sometimes above the 64 KB limit */
+static uint32_t request_size(void)
+{
+	switch (host_rand() % 8) {
+	case 0:
+		return host_rand() % 4;
+	case 1:
+		return MAX_REQUEST + host_rand() % (2 * MAX_REQUEST);
+	case 2:
+	case 3:
+		return 1 + host_rand() % 4096;
+	default:
+		return 1 + host_rand() % 64;
+	}
+}
+
+static void test_reference(uint32_t seed)
+{
+	struct _drbg_stats stats;
+	uint32_t i, len, requests = 0;
+	bool ok = true;
+
+	trng_sim_init(seed);
+	drbg_init();
+	ref_instantiate(seed);
+
+	/* Requests paced or back to back, so that some reseeds poll */
+	for (i = 0; i < 3000; i++) {
+		len = request_size();
+		random_bytes(buffer, len);
+		ref_random_bytes(expected, len);
+		if (memcmp(buffer, expected, len))
+			ok = false;
+		/* empty requests do not count */
+		requests += (len + MAX_REQUEST - 1) / MAX_REQUEST;
+		if (host_rand() % 2)
+			trng_sim_advance(host_rand() % 20000);
+	}
+	drbg_get_stats(&stats);
+	host_check(ok);
+	host_check(stats.reseeds == ref.reseeds);
+	host_check(stats.reseeds == (requests - 1) / DRBG_RESEED_INTERVAL);
+	printf("  seed 0x%08x: %u requests, %u bytes, %u reseeds, %u polled\n",
+		(unsigned)seed, (unsigned)requests, (unsigned)stats.generated,
+		(unsigned)stats.reseeds, (unsigned)stats.late_reseeds);
+}
+
+/** Requests until the next reseed, without time for the pool to refill */
+static void burst_to_reseed(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < DRBG_RESEED_INTERVAL; i++)
+		random_bytes(buffer, 16);
+}
+
+static void test_pool(void)
+{
+	struct _drbg_stats stats;
+	struct _trng_sim_stats sim, sim1;
+	uint32_t seeds, i;
+
+	printf("drbg: entropy pool\n");
+
+	trng_sim_init(1);
+	drbg_init();
+	trng_sim_get_stats(&sim);
+	host_check(sim.words == SEED_WORDS && sim.irqs == 0);
+
+	/* The interrupt stops once the pool is full */
+	trng_sim_advance(1000000);
+	trng_sim_get_stats(&sim);
+	host_check(sim.irqs == DRBG_POOL_WORDS);
+	host_check(sim.words == SEED_WORDS + DRBG_POOL_WORDS);
+
+	/* Reseeds take the pool until it is too low, then read the rest
+	 * of the seed by polling */
+	seeds = DRBG_POOL_WORDS / SEED_WORDS;
+	for (i = 0; i <= seeds; i++)
+		burst_to_reseed();
+	drbg_get_stats(&stats);
+	trng_sim_get_stats(&sim1);
+	host_check(stats.reseeds == seeds + 1);
+	host_check(stats.late_reseeds == 1);
+	host_check(sim1.words - sim.words ==
+		SEED_WORDS - DRBG_POOL_WORDS % SEED_WORDS);
+	printf("  %u reseeds from a full pool, then %u words polled in %llu ns\n",
+		(unsigned)seeds, (unsigned)(sim1.words - sim.words),
+		(unsigned long long)(sim1.poll_ns - sim.poll_ns));
+
+	/* Paced requests never poll */
+	for (i = 0; i < 4 * DRBG_RESEED_INTERVAL; i++) {
+		random_bytes(buffer, 16);
+		trng_sim_advance(1000);
+	}
+	drbg_get_stats(&stats);
+	host_check(stats.reseeds == seeds + 5);
+	host_check(stats.late_reseeds == 1);
+}
+
+static void client_callback(uint32_t value, void* arg)
+{
+	uint32_t* index = (uint32_t*)arg;
+
+	if (value != trng_sim_value(2, (*index)++))
+		client_errors++;
+	client_values++;
+}
+
+static void test_client(void)
+{
+	struct _trng_sim_stats sim0, sim1;
+	uint32_t index = SEED_WORDS;
+	uint64_t duration = 1000000;
+
+	printf("drbg: raw TRNG values forwarded to a client\n");
+
+	trng_sim_init(2);
+	drbg_init();
+	drbg_set_trng_callback(client_callback, &index);
+
+	/* The interrupt stays enabled for the client */
+	trng_sim_advance(duration);
+	trng_sim_get_stats(&sim0);
+	host_check(sim0.irqs == duration / trng_sim_word_ns());
+	host_check(client_values == sim0.irqs && client_errors == 0);
+
+	/* Reseeds still come from the pool */
+	burst_to_reseed();
+	random_bytes(buffer, 16);
+	trng_sim_get_stats(&sim1);
+	host_check(sim1.polls == sim0.polls);
+
+	/* The DRBG stops the interrupt again once the client is gone */
+	drbg_set_trng_callback(NULL, NULL);
+	trng_sim_advance(duration);
+	trng_sim_get_stats(&sim0);
+	trng_sim_advance(duration);
+	trng_sim_get_stats(&sim1);
+	host_check(sim1.irqs == sim0.irqs);
+	printf("  %u values in %llu us\n", (unsigned)client_values,
+		(unsigned long long)(duration / 1000));
+}
+
+static void test_statistics(void)
+{
+	struct _stats_result r;
+	uint32_t i, value;
+
+	printf("drbg: statistical tests on %u bytes\n", STATS_BYTES);
+
+	/* The tests reject a biased source, and a too regular one */
+	for (i = 0; i < STATS_BYTES; i++)
+		buffer[i] = (uint8_t)host_rand() | ((host_rand() % 100) < 3 ? 1 : 0);
+	stats_run(buffer, STATS_BYTES, &r);
+	stats_print("biased (bit 0 +3%)", &r);
+	host_check(!stats_pass(&r));
+	for (i = 0; i < STATS_BYTES; i++)
+		buffer[i] = (uint8_t)(i * 167);
+	stats_run(buffer, STATS_BYTES, &r);
+	stats_print("byte counter", &r);
+	host_check(!stats_pass(&r));
+
+	trng_sim_init(3);
+	drbg_init();
+	random_bytes(buffer, STATS_BYTES);
+	stats_run(buffer, STATS_BYTES, &r);
+	stats_print("random_bytes()", &r);
+	host_check(stats_pass(&r));
+
+	for (i = 0; i < STATS_BYTES; i += 16)
+		random_bytes(&buffer[i], 16);
+	stats_run(buffer, STATS_BYTES, &r);
+	stats_print("random_bytes(16)", &r);
+	host_check(stats_pass(&r));
+
+	srand(0x1234);
+	for (i = 0; i < STATS_BYTES; i += 4) {
+		value = rand();
+		memcpy(&buffer[i], &value, 4);
+	}
+	stats_run(buffer, STATS_BYTES, &r);
+	stats_print("rand()", &r);
+	host_check(stats_pass(&r));
+
+	/* Low byte only, the weak part of an LCG */
+	for (i = 0; i < STATS_BYTES; i++)
+		buffer[i] = (uint8_t)rand();
+	stats_run(buffer, STATS_BYTES, &r);
+	stats_print("rand() & 0xff", &r);
+	host_check(stats_pass(&r));
+
+	/* srand() restarts the sequence, seed 0 included */
+	srand(0);
+	value = rand();
+	host_check(value != 0 || rand() != 0);
+	srand(0);
+	host_check(rand() == value);
+}
+
+static void bench_random_bytes(uint32_t size)
+{
+	uint32_t count = 16 * 1024 * 1024 / (size + 64), i;
+	uint64_t t0, t1;
+
+	t0 = host_time_ns();
+	for (i = 0; i < count; i++)
+		random_bytes(buffer, size);
+	t1 = host_time_ns();
+	printf("  random_bytes(%5u) %8.0f ns/call %7.1f MB/s\n", (unsigned)size,
+		(double)(t1 - t0) / count, (double)count * size * 1e3 / (t1 - t0));
+}
+
+static void bench(void)
+{
+	static const uint32_t sizes[] = { 4, 16, 64, 256, 4096, 65536 };
+	volatile uint32_t sink = 0;
+	uint32_t count, i;
+	uint64_t t0, t1;
+
+	printf("drbg: throughput\n");
+
+	trng_sim_init(4);
+	drbg_init();
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		bench_random_bytes(sizes[i]);
+
+	count = 1000000;
+	t0 = host_time_ns();
+	for (i = 0; i < count; i++)
+		sink ^= random_u32();
+	t1 = host_time_ns();
+	printf("  random_u32()        %8.1f ns/call\n", (double)(t1 - t0) / count);
+
+	count = 100000000;
+	t0 = host_time_ns();
+	for (i = 0; i < count; i++)
+		sink ^= rand();
+	t1 = host_time_ns();
+	printf("  rand()              %8.2f ns/call\n", (double)(t1 - t0) / count);
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	host_init();
+
+	printf("drbg: against the reference CTR_DRBG\n");
+	test_reference(0);
+	test_reference(0xdeadbeef);
+	test_reference(host_rand());
+
+	test_pool();
+	test_client();
+	test_statistics();
+	bench();
+
+	return host_report("drbg");
+}
@@ -0,0 +1,750 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  lwIP network interface (ethif.c) on a simulated ETH driver.
+ *
+ *  Frames of random length are received from the wire and sent by the
+ *  interface, and every frame is checked against its sequence number and
+ *  length, in order, when it reaches the input function of the netif or
+ *  the wire:
+ *  - received frames must be taken with ethd_poll_sg(), never copied, and
+ *    handed to lwIP as chains of custom pbufs;
+ *  - frames sent from cache aligned custom pbufs, of up to ETHIF_TX_SG_MAX
+ *    buffers, must go to ethd_send_sg_nocopy() without copy; their pbufs
+ *    must be held while the frame is queued and released once its TX
+ *    callback has been called. The buffers are poisoned when freed, so
+ *    that a frame released early leaves the wire corrupted;
+ *  - the custom pbufs of the received frames must go back to the RX pool
+ *    when freed: holding every received frame, the interface must always
+ *    stop at ETHIF_RX_PBUF_COUNT frames, and deliver the next one as soon
+ *    as they are freed;
+ *  - received frames sent back by the input function (an echo) must not
+ *    be copied either when they fit in ETHIF_TX_SG_MAX RX buffers.
+ *
+ *  The bytes copied by the driver per frame are reported for reception,
+ *  for transmission from pbufs and for transmission of PBUF_REF pbufs,
+ *  which are still copied into the TX buffers of the driver, as every frame
+ *  was before.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "compiler.h"
+#include "mm/cache.h"
+#include "network/ethd.h"
+
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "netif/ethif.h"
+
+#include "host.h"
+#include "ethd_sim.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define HEADER_SIZE     14
+#define MIN_FRAME       60
+#define MAX_FRAME       (HEADER_SIZE + 1500)
+
+/** Frames of the random tests */
+#define RANDOM_FRAMES   5000
+
+/** Rounds of the RX pool test */
+#define POOL_ROUNDS     20
+
+/** Buffers of the frames sent by the test */
+#define APP_BUFFERS     96
+
+/** Frames per length of the copy counts */
+#define COPY_FRAMES     1000
+
+/** Sequence numbers remembered for the length checks */
+#define SEQ_HISTORY     4096
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+/** What the input function does with the received frames */
+enum _input_mode {
+	INPUT_FREE,
+	INPUT_HOLD,
+	INPUT_ECHO,
+};
+
+/** Buffer of a frame sent by the test, poisoned when freed */
+struct _app_buf {
+	struct pbuf_custom pc; /* must be first */
+	uint8_t* data;
+	uint16_t len;
+	bool busy;
+	uint32_t seq;
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static const uint8_t local_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static const uint8_t peer_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+static struct netif netif;
+
+static enum _input_mode input_mode;
+static bool checks = true;
+
+/** Next sequence number, and length of the recent frames */
+static uint32_t next_seq;
+static uint16_t lengths[SEQ_HISTORY];
+
+/** Frames received from the wire, in order */
+static uint32_t rx_fifo[SEQ_HISTORY];
+static uint32_t rx_head;
+static uint32_t rx_tail;
+static uint32_t rx_errors;
+
+/** Frames queued by the interface, in sending order */
+static uint32_t tx_fifo[SEQ_HISTORY];
+static uint32_t tx_head;
+static uint32_t tx_tail;
+static uint32_t tx_errors;
+
+/** Frames echoed that span more than ETHIF_TX_SG_MAX buffers */
+static uint32_t echo_merged;
+
+static struct pbuf* held[ETHIF_RX_PBUF_COUNT + 1];
+static uint32_t held_count;
+
+CACHE_ALIGNED
+static uint8_t app_data[APP_BUFFERS][ETH_TX_UNITSIZE];
+static struct _app_buf app[APP_BUFFERS];
+
+static uint8_t frame[ETH_MAX_FRAME_LENGTH];
+static uint8_t copy[ETH_MAX_FRAME_LENGTH];
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static uint32_t rand_length(uint32_t min, uint32_t max)
+{
+	return min + host_rand() % (max - min + 1);
+}
+
+/** Write a frame to or from the interface */
+static uint32_t build(uint8_t* buf, uint32_t seq, uint32_t length,
+		bool to_netif)
+{
+	uint32_t i;
+
+	memcpy(buf, to_netif ? local_mac : peer_mac, 6);
+	memcpy(buf + 6, to_netif ? peer_mac : local_mac, 6);
+	buf[12] = 0x08; /* IPv4 */
+	buf[13] = 0x00;
+	memcpy(buf + HEADER_SIZE, &seq, 4);
+	for (i = HEADER_SIZE + 4; i < length; i++)
+		buf[i] = (uint8_t)(seq * 7 + i * 13);
+	lengths[seq % SEQ_HISTORY] = length;
+	return length;
+}
+
+/** Check a frame, return its sequence number or -1 */
+static int32_t check(const uint8_t* buf, uint32_t length, bool to_netif)
+{
+	uint32_t seq, i;
+
+	if (length < MIN_FRAME)
+		return -1;
+	if (memcmp(buf, to_netif ? local_mac : peer_mac, 6)
+			|| memcmp(buf + 6, to_netif ? peer_mac : local_mac, 6)
+			|| buf[12] != 0x08 || buf[13] != 0x00)
+		return -1;
+	memcpy(&seq, buf + HEADER_SIZE, 4);
+	if (lengths[seq % SEQ_HISTORY] != length)
+		return -1;
+	for (i = HEADER_SIZE + 4; i < length; i++)
+		if (buf[i] != (uint8_t)(seq * 7 + i * 13))
+			return -1;
+	return (int32_t)seq;
+}
+
+static void tx_queued(uint32_t seq)
+{
+	tx_fifo[tx_tail % SEQ_HISTORY] = seq;
+	tx_tail++;
+}
+
+/** Sequence number of the oldest frame not on the wire yet */
+static uint32_t tx_unsent(void)
+{
+	return tx_head == tx_tail ? next_seq : tx_fifo[tx_head % SEQ_HISTORY];
+}
+
+/** The wire, checking the frames sent by the interface */
+static void wire(void* arg, const uint8_t* data, uint32_t length)
+{
+	/* frames of lwIP itself (ARP) */
+	if (length < HEADER_SIZE || data[12] != 0x08 || data[13] != 0x00)
+		return;
+	if (!checks) {
+		tx_head++;
+		return;
+	}
+	if (tx_head == tx_tail
+			|| check(data, length, false) != (int32_t)tx_fifo[tx_head % SEQ_HISTORY])
+		tx_errors++;
+	tx_head++;
+}
+
+/** Input function of the netif, called with the frames of type IPv4 */
+static err_t input(struct pbuf* p, struct netif* inp)
+{
+	struct pbuf* q;
+	uint32_t length, buffers = 0, seq;
+	err_t err;
+
+	/* ethif_input() stripped the Ethernet header, which is still in the
+	 * PBUF_REF buffer */
+	pbuf_header_force(p, HEADER_SIZE);
+	length = p->tot_len;
+	for (q = p; q != NULL; q = q->next) {
+		if (!(q->flags & PBUF_FLAG_IS_CUSTOM))
+			rx_errors++;
+		buffers++;
+	}
+	seq = rx_fifo[rx_head % SEQ_HISTORY];
+	if (rx_head == rx_tail)
+		rx_errors++;
+	else if (checks) {
+		pbuf_copy_partial(p, copy, length, 0);
+		if (check(copy, length, true) != (int32_t)seq)
+			rx_errors++;
+	}
+	rx_head++;
+
+	switch (input_mode) {
+	case INPUT_HOLD:
+		held[held_count++] = p;
+		break;
+
+	case INPUT_ECHO:
+		/* swap the addresses in place and send the same buffers */
+		memcpy(copy, p->payload, 6);
+		memcpy(p->payload, (uint8_t*)p->payload + 6, 6);
+		memcpy((uint8_t*)p->payload + 6, copy, 6);
+		if (buffers > ETHIF_TX_SG_MAX)
+			echo_merged++;
+		err = netif.linkoutput(&netif, p);
+		if (err == ERR_OK)
+			tx_queued(seq);
+		else
+			tx_errors++;
+		pbuf_free(p);
+		break;
+
+	default:
+		pbuf_free(p);
+		break;
+	}
+	return ERR_OK;
+}
+
+/** Poll the interface until it has no more frames to deliver */
+static void poll_all(void)
+{
+	uint32_t count;
+
+	do {
+		count = rx_head;
+		ethif_poll(&netif);
+	} while (rx_head != count);
+}
+
+/** Receive a frame from the wire, polling the interface if the ETH queue
+ * is full. Returns false if the frame could not be received. */
+static bool receive(uint32_t length, uint32_t* overruns)
+{
+	uint32_t seq = next_seq;
+
+	if (checks)
+		build(frame, seq, length, true);
+	if (!ethd_sim_receive(0, frame, length)) {
+		(*overruns)++;
+		poll_all();
+		if (!ethd_sim_receive(0, frame, length))
+			return false;
+	}
+	rx_fifo[rx_tail % SEQ_HISTORY] = seq;
+	rx_tail++;
+	next_seq++;
+	return true;
+}
+
+static void app_free(struct pbuf* p)
+{
+	struct _app_buf* ab = (struct _app_buf*)p;
+
+	memset(ab->data, 0xdd, ab->len);
+	ab->busy = false;
+}
+
+static struct _app_buf* app_alloc(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < APP_BUFFERS; i++) {
+		if (!app[i].busy) {
+			app[i].busy = true;
+			return &app[i];
+		}
+	}
+	return NULL;
+}
+
+static struct pbuf* app_wrap(struct _app_buf* ab, uint32_t size, uint32_t seq)
+{
+	ab->len = size;
+	ab->seq = seq;
+	ab->pc.custom_free_function = app_free;
+	return pbuf_alloced_custom(PBUF_RAW, size, PBUF_REF, &ab->pc,
+			ab->data, ETH_TX_UNITSIZE);
+}
+
+/** Wrap a frame into a chain of custom pbufs of the test buffers */
+static struct pbuf* app_chain(const uint8_t* buf, uint32_t length,
+		uint32_t segments, uint32_t seq)
+{
+	struct pbuf *p = NULL, *q;
+	struct _app_buf* ab;
+	uint32_t offset = 0, size, i;
+
+	for (i = 0; i < segments; i++) {
+		size = i == segments - 1 ? length - offset
+			: rand_length(1, (length - offset) - (segments - 1 - i));
+		ab = app_alloc();
+		if (ab == NULL) {
+			if (p)
+				pbuf_free(p);
+			return NULL;
+		}
+		memcpy(ab->data, buf + offset, size);
+		q = app_wrap(ab, size, seq);
+		if (p)
+			pbuf_cat(p, q);
+		else
+			p = q;
+		offset += size;
+	}
+	return p;
+}
+
+/** The buffers of the frames not sent yet must be held, those of the
+ * frames sent must be released once the interface has been polled */
+static bool app_check(bool polled)
+{
+	uint32_t unsent = tx_unsent();
+	uint32_t i;
+
+	for (i = 0; i < APP_BUFFERS; i++) {
+		if (!app[i].busy && app[i].seq >= unsent)
+			return false;
+		if (polled && app[i].busy && app[i].seq < unsent)
+			return false;
+	}
+	return true;
+}
+
+static void stats_check_nocopy(const struct _ethif_stats* stats)
+{
+	const struct _ethd_sim_stats* sim = ethd_sim_get_stats();
+
+	host_check(stats->rx_copied == 0 && sim->rx_copied == 0);
+	host_check(sim->rx_copy_bytes == 0);
+	host_check(sim->errors == 0);
+}
+
+static void test_rx(void)
+{
+	struct _ethif_stats before, stats;
+	uint32_t i, burst, frames = 0, overruns = 0, buffers = 0;
+	bool ok = true;
+
+	printf("ethif: random frames received\n");
+
+	input_mode = INPUT_FREE;
+	ethif_get_stats(&netif, &before);
+	ethd_sim_reset_stats();
+	rx_errors = 0;
+
+	while (frames < RANDOM_FRAMES && ok) {
+		burst = rand_length(1, 12);
+		for (i = 0; i < burst && ok; i++) {
+			uint32_t length = rand_length(MIN_FRAME, MAX_FRAME);
+			ok = receive(length, &overruns);
+			buffers += (length + ETH_RX_UNITSIZE - 1) / ETH_RX_UNITSIZE;
+			frames++;
+		}
+		poll_all();
+	}
+	ethif_get_stats(&netif, &stats);
+	host_check(ok);
+	host_check(rx_errors == 0);
+	host_check(rx_head == rx_tail);
+	host_check(stats.rx_nocopy - before.rx_nocopy == frames);
+	host_check(ethd_sim_get_stats()->rx_nocopy == frames);
+	host_check(stats.queues[0].overruns - before.queues[0].overruns == overruns);
+	stats_check_nocopy(&stats);
+
+	printf("  %u frames in %u buffers, %u overruns: %s\n",
+			(unsigned)frames, (unsigned)buffers, (unsigned)overruns,
+			ok && rx_errors == 0 ? "ok" : "FAILED");
+	printf("  %u bytes copied\n",
+			(unsigned)ethd_sim_get_stats()->rx_copy_bytes);
+}
+
+/** Receive frames while holding them, return the number held when the
+ * interface stopped delivering */
+static uint32_t fill_pool(void)
+{
+	uint32_t overruns = 0, count;
+
+	input_mode = INPUT_HOLD;
+	held_count = 0;
+	do {
+		count = rx_head;
+		if (!receive(rand_length(MIN_FRAME, ETH_RX_UNITSIZE), &overruns))
+			break;
+		poll_all();
+	} while (rx_head != count && held_count <= ETHIF_RX_PBUF_COUNT);
+	host_check(overruns == 0);
+	return held_count;
+}
+
+/** Free the held frames in random order */
+static void release_pool(void)
+{
+	struct pbuf* p;
+	uint32_t i, j;
+
+	for (i = held_count; i > 1; i--) {
+		j = host_rand() % i;
+		p = held[j];
+		held[j] = held[i - 1];
+		held[i - 1] = p;
+	}
+	for (i = 0; i < held_count; i++)
+		pbuf_free(held[i]);
+	held_count = 0;
+	input_mode = INPUT_FREE;
+}
+
+static void test_rx_pool(void)
+{
+	struct _ethif_stats stats;
+	uint32_t round, i, j, count, overruns = 0;
+	uint32_t min = UINT32_MAX, max = 0;
+	bool distinct = true;
+
+	printf("ethif: RX pool\n");
+
+	ethd_sim_reset_stats();
+	rx_errors = 0;
+
+	for (round = 0; round < POOL_ROUNDS; round++) {
+		count = fill_pool();
+		if (count < min)
+			min = count;
+		if (count > max)
+			max = count;
+
+		/* no buffer lent twice */
+		for (i = 0; i < held_count; i++)
+			for (j = i + 1; j < held_count; j++)
+				if (held[i]->payload == held[j]->payload)
+					distinct = false;
+
+		/* the frame left in the ETH queue comes in once freed */
+		release_pool();
+		count = rx_head;
+		poll_all();
+		host_check(rx_head == count + 1);
+
+		/* and long frames in between, back to the pool as chains */
+		for (i = 0; i < 100; i++) {
+			host_check(receive(rand_length(MIN_FRAME, MAX_FRAME), &overruns));
+			if (host_rand() % 4 == 0)
+				poll_all();
+		}
+		poll_all();
+	}
+	ethif_get_stats(&netif, &stats);
+	host_check(min == ETHIF_RX_PBUF_COUNT && max == ETHIF_RX_PBUF_COUNT);
+	host_check(distinct);
+	host_check(rx_errors == 0);
+	host_check(rx_head == rx_tail);
+	stats_check_nocopy(&stats);
+
+	printf("  %u rounds, %u..%u frames held of %u buffers, %u overruns:"
+			" %s\n", POOL_ROUNDS, (unsigned)min, (unsigned)max,
+			ETHIF_RX_PBUF_COUNT, (unsigned)overruns,
+			min == max && distinct ? "ok" : "FAILED");
+}
+
+static void test_tx(void)
+{
+	struct _ethif_stats before, stats;
+	const struct _ethd_sim_stats* sim = ethd_sim_get_stats();
+	struct pbuf* p;
+	uint32_t i, j, burst, length, frames = 0, busy = 0, reclaim_errors = 0;
+	err_t err;
+
+	printf("ethif: random frames sent\n");
+
+	ethif_get_stats(&netif, &before);
+	ethd_sim_reset_stats();
+	tx_errors = 0;
+
+	while (frames < RANDOM_FRAMES) {
+		burst = rand_length(1, 24);
+		for (i = 0; i < burst; i++) {
+			length = build(frame, next_seq, rand_length(MIN_FRAME, MAX_FRAME), false);
+			p = app_chain(frame, length, rand_length(1, ETHIF_TX_SG_MAX), next_seq);
+			if (p == NULL)
+				break;
+			err = netif.linkoutput(&netif, p);
+			pbuf_free(p);
+			if (err == ERR_OK) {
+				tx_queued(next_seq++);
+				frames++;
+			} else {
+				host_check(err == ERR_BUF);
+				busy++;
+				/* released at once, the number is used again */
+				for (j = 0; j < APP_BUFFERS; j++)
+					if (!app[j].busy && app[j].seq == next_seq)
+						app[j].seq = 0;
+			}
+		}
+
+		/* send some, the pbufs of the others are still needed */
+		ethd_sim_transmit(host_rand() % (ethd_sim_tx_pending() + 1));
+		if (!app_check(false))
+			reclaim_errors++;
+		ethif_poll(&netif);
+		if (!app_check(true))
+			reclaim_errors++;
+	}
+	ethd_sim_transmit(ethd_sim_tx_pending());
+	ethif_poll(&netif);
+	ethif_get_stats(&netif, &stats);
+
+	host_check(tx_errors == 0);
+	host_check(tx_head == tx_tail);
+	host_check(reclaim_errors == 0);
+	host_check(app_check(true));
+	for (i = 0; i < APP_BUFFERS; i++)
+		host_check(!app[i].busy);
+	host_check(stats.tx_nocopy - before.tx_nocopy == frames);
+	host_check(stats.tx_copied == before.tx_copied);
+	host_check(sim->tx_nocopy == frames && sim->tx_copied == 0);
+	host_check(sim->tx_copy_bytes == 0);
+	host_check(sim->errors == 0);
+
+	printf("  %u frames of 1 to %u pbufs, %u refused with the queue full:"
+			" %s\n", (unsigned)frames, ETHIF_TX_SG_MAX, (unsigned)busy,
+			tx_errors == 0 && reclaim_errors == 0 ? "ok" : "FAILED");
+	printf("  %u bytes copied\n", (unsigned)sim->tx_copy_bytes);
+}
+
+static void test_echo(void)
+{
+	struct _ethif_stats before, stats;
+	const struct _ethd_sim_stats* sim = ethd_sim_get_stats();
+	uint32_t i, burst, frames = 0, overruns = 0, max_length;
+	uint32_t pass;
+
+	printf("ethif: echo\n");
+
+	for (pass = 0; pass < 2; pass++) {
+		/* up to ETHIF_TX_SG_MAX RX buffers, then any length */
+		max_length = pass ? MAX_FRAME : ETHIF_TX_SG_MAX * ETH_RX_UNITSIZE;
+		ethif_get_stats(&netif, &before);
+		ethd_sim_reset_stats();
+		rx_errors = tx_errors = 0;
+		echo_merged = 0;
+		input_mode = INPUT_ECHO;
+		frames = 0;
+
+		/* one frame at a time when merged frames fill the heap */
+		while (frames < RANDOM_FRAMES) {
+			burst = pass ? 1 : rand_length(1, 8);
+			for (i = 0; i < burst; i++) {
+				host_check(receive(rand_length(MIN_FRAME, max_length), &overruns));
+				frames++;
+			}
+			poll_all();
+			ethd_sim_transmit(ethd_sim_tx_pending());
+		}
+		ethif_poll(&netif);
+		ethif_get_stats(&netif, &stats);
+		input_mode = INPUT_FREE;
+
+		host_check(rx_errors == 0 && tx_errors == 0);
+		host_check(tx_head == tx_tail);
+		host_check(sim->tx_frames == frames);
+		host_check(stats.tx_nocopy - before.tx_nocopy == frames - echo_merged);
+		host_check(stats.tx_copied - before.tx_copied == echo_merged);
+		host_check(sim->tx_copied <= echo_merged);
+		stats_check_nocopy(&stats);
+		if (pass == 0)
+			host_check(echo_merged == 0 && sim->tx_copy_bytes == 0);
+
+		printf("  %u frames of %u to %u bytes, %u merged: %s\n",
+				(unsigned)frames, MIN_FRAME, (unsigned)max_length,
+				(unsigned)echo_merged,
+				rx_errors == 0 && tx_errors == 0 ? "ok" : "FAILED");
+	}
+
+	/* the echoed buffers went back to the RX pool */
+	host_check(fill_pool() == ETHIF_RX_PBUF_COUNT);
+	release_pool();
+	poll_all();
+}
+
+/** Bytes copied by the driver per frame, for each path */
+static void test_copies(void)
+{
+	static const uint32_t frame_lengths[] = { MIN_FRAME, 512, MAX_FRAME };
+	const struct _ethd_sim_stats* sim = ethd_sim_get_stats();
+	struct pbuf* p;
+	uint64_t rx, nocopy, ref;
+	uint32_t i, n, length, overruns = 0;
+
+	printf("ethif: bytes copied per frame\n");
+	printf("  %6s %6s %9s %9s\n", "length", "rx", "tx pbuf", "tx ref");
+
+	checks = false;
+	build(frame, 0, MAX_FRAME, true);
+	input_mode = INPUT_FREE;
+	for (i = 0; i < ARRAY_SIZE(frame_lengths); i++) {
+		length = frame_lengths[i];
+
+		ethd_sim_reset_stats();
+		for (n = 0; n < COPY_FRAMES; n++) {
+			receive(length, &overruns);
+			ethif_poll(&netif);
+		}
+		host_check(sim->rx_nocopy == COPY_FRAMES);
+		rx = sim->rx_copy_bytes;
+
+		ethd_sim_reset_stats();
+		for (n = 0; n < COPY_FRAMES; n++) {
+			p = app_wrap(app_alloc(), length, next_seq);
+			netif.linkoutput(&netif, p);
+			pbuf_free(p);
+			tx_queued(next_seq++);
+			ethd_sim_transmit(1);
+			ethif_poll(&netif);
+		}
+		host_check(sim->tx_frames == COPY_FRAMES);
+		nocopy = sim->tx_copy_bytes;
+
+		/* PBUF_REF payloads may change once sent, so they are copied */
+		ethd_sim_reset_stats();
+		for (n = 0; n < COPY_FRAMES; n++) {
+			p = pbuf_alloc(PBUF_RAW, length, PBUF_REF);
+			p->payload = app_data[0];
+			netif.linkoutput(&netif, p);
+			pbuf_free(p);
+			tx_queued(next_seq++);
+			ethd_sim_transmit(1);
+			ethif_poll(&netif);
+		}
+		host_check(sim->tx_frames == COPY_FRAMES);
+		ref = sim->tx_copy_bytes;
+
+		host_check(rx == 0 && nocopy == 0);
+		host_check(ref == (uint64_t)length * COPY_FRAMES);
+		printf("  %6u %6u %9u %9u\n", (unsigned)length,
+				(unsigned)(rx / COPY_FRAMES),
+				(unsigned)(nocopy / COPY_FRAMES),
+				(unsigned)(ref / COPY_FRAMES));
+	}
+	host_check(overruns == 0);
+	checks = true;
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	ip4_addr_t ipaddr, netmask, gw;
+	uint32_t i;
+
+	host_init();
+
+	for (i = 0; i < APP_BUFFERS; i++)
+		app[i].data = app_data[i];
+
+	ethd_sim_init(wire, NULL);
+	lwip_init();
+	IP4_ADDR(&ipaddr, 192, 168, 1, 3);
+	IP4_ADDR(&netmask, 255, 255, 255, 0);
+	IP4_ADDR(&gw, 192, 168, 1, 2);
+	netif_add(&netif, &ipaddr, &netmask, &gw, NULL, ethif_init, input);
+	netif_set_default(&netif);
+	netif_set_up(&netif);
+	host_check(memcmp(netif.hwaddr, local_mac, 6) == 0);
+
+	/* gratuitous ARP */
+	ethd_sim_transmit(ethd_sim_tx_pending());
+	ethif_poll(&netif);
+
+	test_rx();
+	test_rx_pool();
+	test_tx();
+	test_echo();
+	test_copies();
+
+	return host_report("ethif");
+}
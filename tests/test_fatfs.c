@@ -0,0 +1,355 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  FatFs over sdmmc_ff.c on a simulated SD card (media_ramdisk with the
+ *  access times of a class 10 card): throughput of sequential and random
+ *  file accesses at several cluster sizes, in virtual time, with the number
+ *  of card commands. The file content is checked on every read.
+ *
+ *  Built twice: test_fatfs with the sector cache of sdmmc_ff.c (read-ahead
+ *  and write coalescing), test_fatfs_nocache with SDMMC_FF_CACHE_SECTORS=0.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "compiler.h"
+
+#include "fatfs/src/ff.h"
+#include "libsdmmc/libsdmmc.h"
+#include "libstoragemedia/media.h"
+#include "libstoragemedia/media_private.h"
+#include "libstoragemedia/media_ramdisk.h"
+
+#include "host.h"
+#include "sdcard_sim.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define BLOCK_SIZE      512
+/** Sized so that no cluster size gives a cluster count close to the
+ * FAT12/FAT16/FAT32 limits, which f_mkfs() rejects */
+#define DISK_SIZE       (192 * 1024 * 1024)
+
+#define FILE_SIZE       (16 * 1024 * 1024)
+
+/** Unit of the content model and of the random accesses */
+#define CHUNK_SIZE      4096
+#define NUM_CHUNKS      (FILE_SIZE / CHUNK_SIZE)
+
+#define RANDOM_WRITES   1000
+#define RANDOM_READS    2000
+
+#define CLMT_SIZE       64
+
+#ifndef SDMMC_FF_CACHE_SECTORS
+#define SDMMC_FF_CACHE_SECTORS 32
+#endif
+
+#if SDMMC_FF_CACHE_SECTORS > 0
+#define TEST_NAME       "fatfs"
+#else
+#define TEST_NAME       "fatfs_nocache"
+#endif
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+/** Cluster sizes to format with, in bytes */
+static const uint32_t cluster_sizes[] = { 1024, 4096, 16384, 32768 };
+
+ALIGNED(BLOCK_SIZE) static uint8_t disk[DISK_SIZE];
+
+static struct _media media;
+static sSdCard lib;
+
+static FATFS fs;
+static FIL file;
+static DWORD clmt[CLMT_SIZE];
+
+/** Generation of the content of each chunk of the file */
+static uint32_t versions[NUM_CHUNKS];
+
+static uint8_t io[32768];
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/* Refer to sdmmc_ff.c */
+bool SD_GetInstance(uint8_t index, sSdCard **holder);
+
+bool SD_GetInstance(uint8_t index, sSdCard **holder)
+{
+	if (index != 0)
+		return false;
+	*holder = &lib;
+	return true;
+}
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/** Content of the file at a given offset, for the current chunk version */
+static void fill(uint8_t* data, uint32_t offset, uint32_t size)
+{
+	uint32_t i, w;
+
+	for (i = 0; i < size; i += 4) {
+		w = (offset + i) * 2654435761u ^
+			versions[(offset + i) / CHUNK_SIZE] * 40503u;
+		memcpy(data + i, &w, 4);
+	}
+}
+
+static bool check(const uint8_t* data, uint32_t offset, uint32_t size)
+{
+	uint32_t i, w;
+
+	for (i = 0; i < size; i += 4) {
+		w = (offset + i) * 2654435761u ^
+			versions[(offset + i) / CHUNK_SIZE] * 40503u;
+		if (memcmp(data + i, &w, 4))
+			return false;
+	}
+	return true;
+}
+
+static double mb_s(uint64_t bytes, uint64_t ns)
+{
+	return ns ? bytes * 1e3 / ns : 0.0;
+}
+
+static void size_name(char* name, size_t len, const char* what,
+		uint32_t size)
+{
+	if (size >= 1024)
+		snprintf(name, len, "%s %uKB", what, (unsigned)(size / 1024));
+	else
+		snprintf(name, len, "%s %uB", what, (unsigned)size);
+}
+
+static void report(const char* name, uint64_t bytes, uint64_t ns)
+{
+	const struct _sdcard_sim_stats* stats = sdcard_sim_get_stats();
+
+	printf("  %-22s %7.2f MB/s, %6u commands (%u multiple-block)\n",
+		name, mb_s(bytes, ns), stats->read_cmds + stats->write_cmds,
+		stats->multi_cmds);
+}
+
+static bool format(uint32_t cluster_size)
+{
+	static const char* const types[] = { "", "FAT12", "FAT16", "FAT32", "exFAT" };
+	FRESULT res;
+
+	res = f_mount(&fs, "0:", 0);
+	if (res == FR_OK)
+		res = f_mkfs("0:", 1, cluster_size);
+	if (res == FR_OK)
+		res = f_mount(&fs, "0:", 1);
+	host_check(res == FR_OK);
+	if (res != FR_OK)
+		return false;
+	host_check(fs.csize * BLOCK_SIZE == cluster_size);
+	printf(TEST_NAME ": %u KB clusters, %s, cache %u sectors\n",
+		(unsigned)(cluster_size / 1024),
+		fs.fs_type <= FS_EXFAT ? types[fs.fs_type] : "?",
+		SDMMC_FF_CACHE_SECTORS);
+	return true;
+}
+
+/** Write the whole file sequentially, size bytes at a time */
+static void bench_write(uint32_t size)
+{
+	char name[32];
+	uint64_t t0;
+	uint32_t offset;
+	UINT bw;
+	FRESULT res;
+
+	for (offset = 0; offset < NUM_CHUNKS; offset++)
+		versions[offset]++;
+
+	sdcard_sim_reset_stats();
+	t0 = sdcard_sim_time_ns();
+	res = f_open(&file, "0:bench.bin", FA_WRITE | FA_OPEN_ALWAYS);
+	for (offset = 0; res == FR_OK && offset < FILE_SIZE; offset += size) {
+		fill(io, offset, size);
+		res = f_write(&file, io, size, &bw);
+		if (res == FR_OK && bw != size)
+			res = FR_DENIED;
+	}
+	if (res == FR_OK)
+		res = f_close(&file);
+	host_check(res == FR_OK);
+	size_name(name, sizeof(name), "sequential write", size);
+	report(name, FILE_SIZE, sdcard_sim_time_ns() - t0);
+
+#if SDMMC_FF_CACHE_SECTORS > 0
+	/* single sectors coalesced into multiple-block writes */
+	if (size == BLOCK_SIZE)
+		host_check(sdcard_sim_get_stats()->write_cmds <
+			FILE_SIZE / BLOCK_SIZE / 8);
+#endif
+}
+
+/** Read the whole file sequentially, size bytes at a time */
+static void bench_read(uint32_t size)
+{
+	char name[32];
+	uint64_t t0;
+	uint32_t offset;
+	UINT br;
+	FRESULT res;
+	bool ok = true;
+
+	sdcard_sim_reset_stats();
+	t0 = sdcard_sim_time_ns();
+	res = f_open(&file, "0:bench.bin", FA_READ);
+	for (offset = 0; res == FR_OK && offset < FILE_SIZE; offset += size) {
+		res = f_read(&file, io, size, &br);
+		if (res == FR_OK && br != size)
+			res = FR_DENIED;
+		if (res == FR_OK && !check(io, offset, size))
+			ok = false;
+	}
+	if (res == FR_OK)
+		res = f_close(&file);
+	host_check(res == FR_OK);
+	host_check(ok);
+	size_name(name, sizeof(name), "sequential read", size);
+	report(name, FILE_SIZE, sdcard_sim_time_ns() - t0);
+
+#if SDMMC_FF_CACHE_SECTORS > 0
+	/* single sectors served from the read-ahead */
+	if (size == BLOCK_SIZE)
+		host_check(sdcard_sim_get_stats()->read_cmds <
+			FILE_SIZE / BLOCK_SIZE / 8);
+#endif
+}
+
+/** Read or rewrite random chunks of the file, following the FAT chain on
+ * each seek or using a cluster link map. Returns the number of commands. */
+static uint32_t bench_random(bool write, bool fast_seek)
+{
+	const struct _sdcard_sim_stats* stats = sdcard_sim_get_stats();
+	char name[32];
+	uint64_t t0;
+	uint32_t i, chunk, ops = write ? RANDOM_WRITES : RANDOM_READS;
+	UINT bx;
+	FRESULT res;
+	bool ok = true;
+
+	sdcard_sim_reset_stats();
+	t0 = sdcard_sim_time_ns();
+	res = f_open(&file, "0:bench.bin",
+		write ? FA_WRITE | FA_OPEN_EXISTING : FA_READ);
+	if (res == FR_OK && fast_seek) {
+		file.cltbl = clmt;
+		clmt[0] = CLMT_SIZE;
+		res = f_lseek(&file, CREATE_LINKMAP);
+	}
+	for (i = 0; res == FR_OK && i < ops; i++) {
+		chunk = host_rand() % NUM_CHUNKS;
+		res = f_lseek(&file, chunk * CHUNK_SIZE);
+		if (res != FR_OK)
+			break;
+		if (write) {
+			versions[chunk]++;
+			fill(io, chunk * CHUNK_SIZE, CHUNK_SIZE);
+			res = f_write(&file, io, CHUNK_SIZE, &bx);
+		} else {
+			res = f_read(&file, io, CHUNK_SIZE, &bx);
+			if (res == FR_OK && !check(io, chunk * CHUNK_SIZE, CHUNK_SIZE))
+				ok = false;
+		}
+		if (res == FR_OK && bx != CHUNK_SIZE)
+			res = FR_DENIED;
+	}
+	if (res == FR_OK)
+		res = f_close(&file);
+	host_check(res == FR_OK);
+	host_check(ok);
+	snprintf(name, sizeof(name), "random %s 4KB%s",
+		write ? "write" : "read", fast_seek ? " (clmt)" : "");
+	report(name, (uint64_t)ops * CHUNK_SIZE, sdcard_sim_time_ns() - t0);
+	return stats->read_cmds + stats->write_cmds;
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	uint32_t i, walk, fast;
+
+	host_init();
+
+	media_ramdisk_init(&media, (uint32_t)disk / BLOCK_SIZE,
+			DISK_SIZE / BLOCK_SIZE, BLOCK_SIZE);
+	sdcard_sim_init(&media, NULL);
+
+	for (i = 0; i < ARRAY_SIZE(cluster_sizes); i++) {
+		if (!format(cluster_sizes[i]))
+			continue;
+		memset(versions, 0, sizeof(versions));
+		bench_write(BLOCK_SIZE);
+		bench_write(sizeof(io));
+		bench_read(BLOCK_SIZE);
+		bench_read(sizeof(io));
+		bench_random(true, false);
+		bench_random(true, true);
+		walk = bench_random(false, false);
+		fast = bench_random(false, true);
+		/* no FAT sector read on seek with the link map: one command per
+		 * cluster at most, plus the directory and the walk of the FAT
+		 * (at least 128 entries per sector) building the link map */
+		host_check(fast < walk);
+		host_check(fast <= RANDOM_READS * ((CHUNK_SIZE +
+			cluster_sizes[i] - 1) / cluster_sizes[i]) +
+			FILE_SIZE / cluster_sizes[i] / 128 + 32);
+		f_mount(NULL, "0:", 0);
+	}
+
+	return host_report(TEST_NAME);
+}
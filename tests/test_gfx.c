@@ -0,0 +1,1036 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  2D drawing library (gfx.c), in 16, 24 and 32 bpp.
+ *
+ *  Random primitives, with coordinates partly outside the surface, are
+ *  drawn on a surface with an odd width (so that rows are padded) by the
+ *  CPU, and on a second surface where fills and blits go to the DMA job
+ *  engine. After each primitive:
+ *  - fills, pixels, rectangles, blits and text must match a reference
+ *    model exactly, blending must be within rounding of the exact blend,
+ *    lines and circles must only touch pixels on their outline or disc;
+ *  - every pixel changed since the last gfx_present() must lie in a dirty
+ *    rectangle, and the row padding and the bytes after the buffer must be
+ *    left alone;
+ *  - at each frame, the DMA surface must hold the same pixels as the CPU
+ *    one.
+ *  The DMA pass is run twice: with transfers completing when started, and
+ *  with transfers completing only when waited for, which catches a CPU
+ *  access to an area still being written by the DMA.
+ *
+ *  On an 800x480 panel, a typical HMI update (a label, a progress bar and
+ *  an indicator) reports the bytes cleaned from the cache by gfx_present()
+ *  against the size of the frame buffer, then the primitives per second of
+ *  the CPU paths are reported for each pixel size, with the per-pixel
+ *  memcpy() fill of the former lcd_draw.c as a reference. The DMA model
+ *  does not time its transfers, so the DMA paths are not benchmarked.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip.h"
+#include "compiler.h"
+
+#include "dma/dma.h"
+#include "dma/dma_job.h"
+#include "gfx/gfx.h"
+
+#include "font.h"
+
+#include "dma_sim.h"
+#include "host.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+/** Random test surface, rows of 203 pixels are padded in 16 and 24 bpp */
+#define TEST_WIDTH      203
+#define TEST_HEIGHT     77
+
+#define RANDOM_OPS      2000
+
+/** Margin of the random coordinates around the surface */
+#define MARGIN          40
+
+/** Size from which the DMA surface hands fills and blits to the DMA */
+#define DMA_THRESHOLD   64
+
+#define GUARD_WORDS     16
+#define GUARD           0xdeadbeef
+#define PADDING         0xa5
+
+#define PANEL_WIDTH     800
+#define PANEL_HEIGHT    480
+
+#define IMAGE_WIDTH     256
+#define IMAGE_HEIGHT    160
+
+#define HMI_FRAMES      100
+
+/** Minimum duration of a benchmark measurement */
+#define BENCH_NS        20000000ull
+
+#define BUFFER_WORDS(w, h) (((w) * 4 * (h)) / 4 + GUARD_WORDS)
+
+enum {
+	OP_FILL,
+	OP_FILL_RECT,
+	OP_PIXEL,
+	OP_HLINE,
+	OP_VLINE,
+	OP_RECT,
+	OP_LINE,
+	OP_CIRCLE,
+	OP_FILL_CIRCLE,
+	OP_ROUNDED_RECT,
+	OP_FILL_ROUNDED_RECT,
+	OP_BLEND_RECT,
+	OP_BLIT,
+	OP_BLIT_ARGB,
+	OP_CHAR,
+	OP_STRING,
+	OP_COUNT,
+};
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+struct _op {
+	uint8_t type;
+	int32_t x, y, w, h, r;  /* w, h are the end point of a line */
+	uint32_t color;
+	uint32_t bg_color;
+	uint8_t alpha;
+	bool opaque;
+	uint32_t src_stride;    /* In bytes, in pixels for OP_BLIT_ARGB */
+	char text[16];
+};
+
+struct _bench {
+	const char* name;
+	uint32_t pixels;        /* Pixels per primitive, 0 for lines */
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static const uint8_t bpps[] = { 16, 24, 32 };
+
+static const struct _bench benches[] = {
+	{ "fill 800x480", PANEL_WIDTH * PANEL_HEIGHT },
+	{ "fill_rect 100x100", 100 * 100 },
+	{ "  per-pixel memcpy", 100 * 100 },
+	{ "hline 200", 200 },
+	{ "vline 200", 200 },
+	{ "line 200x120", 0 },
+	{ "rect 100x100", 396 },
+	{ "circle r50", 0 },
+	{ "fill_circle r50", 0 },
+	{ "fill_rounded 200x60 r12", 0 },
+	{ "blend_rect 100x100", 100 * 100 },
+	{ "blit 64x64", 64 * 64 },
+	{ "blit_argb 64x64", 64 * 64 },
+	{ "string 16 chars", 0 },
+};
+
+static uint32_t cpu_buf[BUFFER_WORDS(TEST_WIDTH, TEST_HEIGHT)];
+static uint32_t dma_buf[BUFFER_WORDS(TEST_WIDTH, TEST_HEIGHT)];
+
+/** Raw pixels of the reference model, before the last primitive, and as
+ * last presented */
+static uint32_t model[TEST_WIDTH * TEST_HEIGHT];
+static uint32_t before[TEST_WIDTH * TEST_HEIGHT];
+static uint32_t shown[TEST_WIDTH * TEST_HEIGHT];
+
+static uint32_t panel_buf[BUFFER_WORDS(PANEL_WIDTH, PANEL_HEIGHT)];
+
+/** Image in the format of the surface, and ARGB image */
+static uint32_t image[IMAGE_WIDTH * IMAGE_HEIGHT];
+static uint32_t image_argb[IMAGE_WIDTH * IMAGE_HEIGHT];
+
+static struct _gfx_surface cpu_surface;
+static struct _gfx_surface dma_surface;
+
+static void render_8x8(const struct _gfx_font* font, uint8_t c, uint32_t* rows);
+
+static const struct _gfx_font font = {
+	8, 8, 1, 0x20, 0x7F, pCharset8x8, render_8x8
+};
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/** Glyph of the 8x8 font of the lcd example: one byte per row, LSB on the
+ * left */
+static void render_8x8(const struct _gfx_font* font, uint8_t c, uint32_t* rows)
+{
+	const uint8_t* glyph = (const uint8_t*)font->data + (c - font->first) * 8;
+	uint32_t row;
+
+	for (row = 0; row < 8; row++)
+		rows[row] = glyph[row];
+}
+
+static int32_t imin(int32_t a, int32_t b)
+{
+	return a < b ? a : b;
+}
+
+static int32_t imax(int32_t a, int32_t b)
+{
+	return a > b ? a : b;
+}
+
+static int32_t rand_range(int32_t min, int32_t max)
+{
+	return min + (int32_t)(host_rand() % (uint32_t)(max - min + 1));
+}
+
+static uint32_t pixel_mask(uint8_t bpp)
+{
+	return bpp == 32 ? 0xffffffff : (1u << bpp) - 1;
+}
+
+/** Independent conversion of a 0xAARRGGBB color to a raw pixel */
+static uint32_t to_raw(uint8_t bpp, uint32_t color)
+{
+	uint32_t r = (color >> 16) & 0xff, g = (color >> 8) & 0xff, b = color & 0xff;
+
+	if (bpp == 16)
+		return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+	return color & pixel_mask(bpp);
+}
+
+static uint32_t load(const struct _gfx_surface* s, int32_t x, int32_t y)
+{
+	const uint8_t* p = s->buffer + y * s->stride + x * (s->bpp >> 3);
+
+	switch (s->bpp) {
+	case 16:
+		return p[0] | (p[1] << 8);
+	case 24:
+		return p[0] | (p[1] << 8) | (p[2] << 16);
+	default:
+		return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+}
+
+static void read_surface(const struct _gfx_surface* s, uint32_t* pixels)
+{
+	int32_t x, y;
+
+	for (y = 0; y < s->height; y++)
+		for (x = 0; x < s->width; x++)
+			pixels[y * s->width + x] = load(s, x, y);
+}
+
+static void model_put(int32_t x, int32_t y, uint32_t pixel)
+{
+	if (x >= 0 && y >= 0 && x < TEST_WIDTH && y < TEST_HEIGHT)
+		model[y * TEST_WIDTH + x] = pixel;
+}
+
+static void model_fill(int32_t x, int32_t y, int32_t w, int32_t h,
+		uint32_t pixel)
+{
+	int32_t i, j;
+
+	for (j = y; j < y + h; j++)
+		for (i = x; i < x + w; i++)
+			model_put(i, j, pixel);
+}
+
+static void model_text(const struct _op* op, uint8_t bpp)
+{
+	const uint32_t fg = to_raw(bpp, op->color);
+	const uint32_t bg = to_raw(bpp, op->bg_color);
+	int32_t x = op->x, y = op->y, row, col;
+	const char* c;
+
+	for (c = op->text; *c; c++) {
+		uint32_t rows[GFX_GLYPH_MAX_HEIGHT] = { 0 };
+
+		if (*c == '\n') {
+			x = op->x;
+			y += font.height + font.char_space;
+			continue;
+		}
+		render_8x8(&font, *c, rows);
+		for (row = 0; row < font.height; row++)
+			for (col = 0; col < font.width; col++)
+				if ((rows[row] >> col) & 1)
+					model_put(x + col, y + row, fg);
+				else if (op->opaque)
+					model_put(x + col, y + row, bg);
+		x += font.width + font.char_space;
+	}
+}
+
+/** Channel widths of a raw pixel, from the least significant */
+static uint32_t channels(uint8_t bpp, uint8_t* widths)
+{
+	if (bpp == 16) {
+		widths[0] = 5;
+		widths[1] = 6;
+		widths[2] = 5;
+		return 3;
+	}
+	widths[0] = widths[1] = widths[2] = widths[3] = 8;
+	return bpp / 8;
+}
+
+/**
+ * Largest difference, in units of the channels, between a blended pixel
+ * and the exact blend of \a src over \a dst with opacity \a alpha.
+ */
+static int32_t blend_error(uint8_t bpp, uint32_t got, uint32_t dst,
+		uint32_t src, uint8_t alpha)
+{
+	uint8_t widths[4];
+	uint32_t count = channels(bpp, widths), i, shift = 0;
+	int32_t error = 0;
+
+	for (i = 0; i < count; i++) {
+		uint32_t mask = (1u << widths[i]) - 1;
+		double d = (dst >> shift) & mask, s = (src >> shift) & mask;
+		double exact = d + (s - d) * alpha / 255.0;
+		int32_t e = abs((int32_t)((got >> shift) & mask) - (int32_t)lrint(exact));
+
+		error = imax(error, e);
+		shift += widths[i];
+	}
+	return error;
+}
+
+static void random_op(struct _op* op, uint8_t bpp)
+{
+	const uint32_t bytes = bpp >> 3;
+	uint32_t i, len;
+
+	memset(op, 0, sizeof(*op));
+	do {
+		op->type = host_rand() % OP_COUNT;
+	} while (op->type == OP_FILL && (host_rand() % 8));
+
+	op->x = rand_range(-MARGIN, TEST_WIDTH + MARGIN);
+	op->y = rand_range(-MARGIN, TEST_HEIGHT + MARGIN);
+	if (host_rand() % 4) {
+		op->w = rand_range(-2, 160);
+		op->h = rand_range(-2, 100);
+	} else {
+		op->w = rand_range(0, 8);
+		op->h = rand_range(0, 8);
+	}
+	if (host_rand() % 8 == 0) {
+		/* whole rows */
+		op->x = 0;
+		op->w = TEST_WIDTH;
+	}
+	op->r = rand_range(-2, 50);
+	op->color = host_rand();
+	op->bg_color = host_rand();
+	op->opaque = host_rand() & 1;
+	switch (host_rand() % 4) {
+	case 0:
+		op->alpha = 0;
+		break;
+	case 1:
+		op->alpha = 0xff;
+		break;
+	default:
+		op->alpha = host_rand();
+		break;
+	}
+
+	switch (op->type) {
+	case OP_LINE:
+		op->w = rand_range(-MARGIN, TEST_WIDTH + MARGIN);
+		op->h = (host_rand() % 8) ? rand_range(-MARGIN, TEST_HEIGHT + MARGIN) : op->y;
+		break;
+	case OP_BLIT:
+	case OP_BLIT_ARGB:
+		op->w = imin(imax(op->w, 0), IMAGE_WIDTH);
+		op->h = imin(imax(op->h, 0), IMAGE_HEIGHT);
+		op->src_stride = (host_rand() & 1) && op->w ? op->w : IMAGE_WIDTH;
+		if (op->type == OP_BLIT)
+			op->src_stride *= bytes;
+		break;
+	case OP_CHAR:
+	case OP_STRING:
+		len = op->type == OP_CHAR ? 1 : rand_range(1, sizeof(op->text) - 1);
+		for (i = 0; i < len; i++)
+			op->text[i] = (op->type == OP_STRING && host_rand() % 8 == 0) ?
+				'\n' : rand_range(0x20, 0x7e);
+		break;
+	}
+}
+
+static void draw_op(struct _gfx_surface* s, const struct _op* op)
+{
+	switch (op->type) {
+	case OP_FILL:
+		gfx_fill(s, op->color);
+		break;
+	case OP_FILL_RECT:
+		gfx_fill_rect(s, op->x, op->y, op->w, op->h, op->color);
+		break;
+	case OP_PIXEL:
+		gfx_draw_pixel(s, op->x, op->y, op->color);
+		break;
+	case OP_HLINE:
+		gfx_draw_hline(s, op->x, op->y, op->w, op->color);
+		break;
+	case OP_VLINE:
+		gfx_draw_vline(s, op->x, op->y, op->h, op->color);
+		break;
+	case OP_RECT:
+		gfx_draw_rect(s, op->x, op->y, op->w, op->h, op->color);
+		break;
+	case OP_LINE:
+		gfx_draw_line(s, op->x, op->y, op->w, op->h, op->color);
+		break;
+	case OP_CIRCLE:
+		gfx_draw_circle(s, op->x, op->y, op->r, op->color);
+		break;
+	case OP_FILL_CIRCLE:
+		gfx_fill_circle(s, op->x, op->y, op->r, op->color);
+		break;
+	case OP_ROUNDED_RECT:
+		gfx_draw_rounded_rect(s, op->x, op->y, op->w, op->h, op->r,
+				op->color);
+		break;
+	case OP_FILL_ROUNDED_RECT:
+		gfx_fill_rounded_rect(s, op->x, op->y, op->w, op->h, op->r,
+				op->color);
+		break;
+	case OP_BLEND_RECT:
+		gfx_blend_rect(s, op->x, op->y, op->w, op->h, op->color,
+				op->alpha);
+		break;
+	case OP_BLIT:
+		gfx_blit(s, op->x, op->y, image, op->src_stride, op->w, op->h);
+		break;
+	case OP_BLIT_ARGB:
+		gfx_blit_argb(s, op->x, op->y, image_argb, op->src_stride,
+				op->w, op->h);
+		break;
+	case OP_CHAR:
+		gfx_draw_char(s, &font, op->x, op->y, op->text[0], op->color,
+				op->bg_color, op->opaque);
+		break;
+	case OP_STRING:
+		gfx_draw_string(s, &font, op->x, op->y, op->text, op->color,
+				op->bg_color, op->opaque);
+		break;
+	}
+}
+
+/**
+ * Update the model for the primitives it reproduces exactly.
+ * \return false for the other primitives
+ */
+static bool model_op(const struct _op* op, uint8_t bpp)
+{
+	const uint32_t pixel = to_raw(bpp, op->color);
+	const uint32_t bytes = bpp >> 3;
+	int32_t i, j;
+
+	switch (op->type) {
+	case OP_FILL:
+		model_fill(0, 0, TEST_WIDTH, TEST_HEIGHT, pixel);
+		return true;
+	case OP_FILL_RECT:
+		model_fill(op->x, op->y, op->w, op->h, pixel);
+		return true;
+	case OP_PIXEL:
+		model_put(op->x, op->y, pixel);
+		return true;
+	case OP_HLINE:
+		model_fill(op->x, op->y, op->w, 1, pixel);
+		return true;
+	case OP_VLINE:
+		model_fill(op->x, op->y, 1, op->h, pixel);
+		return true;
+	case OP_RECT:
+		if (op->w <= 0 || op->h <= 0)
+			return true;
+		model_fill(op->x, op->y, op->w, 1, pixel);
+		model_fill(op->x, op->y + op->h - 1, op->w, 1, pixel);
+		model_fill(op->x, op->y, 1, op->h, pixel);
+		model_fill(op->x + op->w - 1, op->y, 1, op->h, pixel);
+		return true;
+	case OP_BLEND_RECT:
+		if (op->alpha == 0xff)
+			model_fill(op->x, op->y, op->w, op->h, pixel);
+		return op->alpha == 0 || op->alpha == 0xff;
+	case OP_BLIT:
+		for (j = 0; j < op->h; j++)
+			for (i = 0; i < op->w; i++) {
+				const uint8_t* p = (const uint8_t*)image +
+					j * op->src_stride + i * bytes;
+				uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) |
+					((uint32_t)p[3] << 24);
+
+				model_put(op->x + i, op->y + j, v & pixel_mask(bpp));
+			}
+		return true;
+	case OP_CHAR:
+	case OP_STRING:
+		model_text(op, bpp);
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Check the pixels changed by a primitive the model does not reproduce
+ * exactly.
+ * \param after Pixels of the surface after the primitive
+ * \return Number of wrong pixels
+ */
+static uint32_t check_op(const struct _op* op, uint8_t bpp,
+		const uint32_t* after)
+{
+	const uint32_t pixel = to_raw(bpp, op->color);
+	uint32_t errors = 0, changed = 0;
+	int32_t x, y, dx, dy;
+	double d, len;
+
+	for (y = 0; y < TEST_HEIGHT; y++) {
+		for (x = 0; x < TEST_WIDTH; x++) {
+			const uint32_t i = y * TEST_WIDTH + x;
+			const bool inside = x >= op->x && x < op->x + op->w &&
+			                    y >= op->y && y < op->y + op->h;
+			bool ok = true;
+
+			if (after[i] != before[i])
+				changed++;
+			dx = x - op->x;
+			dy = y - op->y;
+			switch (op->type) {
+			case OP_LINE:
+				/* distance to the segment */
+				len = hypot(op->w - op->x, op->h - op->y);
+				d = len ? fabs((double)dx * (op->h - op->y) -
+				               (double)dy * (op->w - op->x)) / len :
+				    hypot(dx, dy);
+				if (after[i] != before[i])
+					ok = after[i] == pixel && d < 1.0 &&
+					     x >= imin(op->x, op->w) &&
+					     x <= imax(op->x, op->w) &&
+					     y >= imin(op->y, op->h) &&
+					     y <= imax(op->y, op->h);
+				if ((x == op->x && y == op->y) ||
+				    (x == op->w && y == op->h))
+					ok = ok && after[i] == pixel;
+				break;
+			case OP_CIRCLE:
+				d = hypot(dx, dy);
+				if (after[i] != before[i])
+					ok = after[i] == pixel && fabs(d - op->r) < 1.0;
+				if (op->r >= 0 && ((abs(dx) == op->r && dy == 0) ||
+				                   (dx == 0 && abs(dy) == op->r)))
+					ok = ok && after[i] == pixel;
+				break;
+			case OP_FILL_CIRCLE:
+				d = hypot(dx, dy);
+				if (after[i] != before[i])
+					ok = after[i] == pixel && d < op->r + 1.0;
+				if (d <= op->r - 1.0)
+					ok = ok && after[i] == pixel;
+				break;
+			case OP_ROUNDED_RECT:
+			case OP_FILL_ROUNDED_RECT:
+				if (after[i] != before[i])
+					ok = after[i] == pixel && inside;
+				if (op->type == OP_FILL_ROUNDED_RECT && inside) {
+					int32_t r = imax(0, imin(op->r,
+						imin(op->w, op->h) / 2));
+
+					/* the cross between the corners */
+					if ((dx >= r && dx < op->w - r) ||
+					    (dy >= r && dy < op->h - r))
+						ok = ok && after[i] == pixel;
+				}
+				break;
+			case OP_BLEND_RECT:
+				if (inside)
+					ok = blend_error(bpp, after[i], before[i],
+						pixel | (bpp == 32 ? 0xff000000 : 0),
+						op->alpha) <= (bpp == 16 ? 2 : 1);
+				else
+					ok = after[i] == before[i];
+				break;
+			case OP_BLIT_ARGB:
+				if (inside) {
+					uint32_t c = image_argb[dy * op->src_stride + dx];
+					uint8_t a = c >> 24;
+
+					if (a == 0)
+						ok = after[i] == before[i];
+					else if (a == 0xff)
+						ok = after[i] == to_raw(bpp, c);
+					else
+						ok = blend_error(bpp, after[i],
+							before[i], to_raw(bpp, c) |
+							(bpp == 32 ? 0xff000000 : 0),
+							a) <= (bpp == 16 ? 2 : 1);
+				} else {
+					ok = after[i] == before[i];
+				}
+				break;
+			}
+			if (!ok)
+				errors++;
+		}
+	}
+
+	/* a line touches one pixel per step of its major axis */
+	if (op->type == OP_LINE)
+		if (changed > (uint32_t)imax(abs(op->w - op->x),
+				abs(op->h - op->y)) + 1)
+			errors++;
+	return errors;
+}
+
+/** Changed pixels outside the dirty rectangles */
+static uint32_t check_dirty(const struct _gfx_surface* s, const uint32_t* now)
+{
+	uint32_t errors = 0, i;
+	int32_t x, y;
+
+	for (i = 0; i < s->num_dirty; i++) {
+		const struct _gfx_rect* r = &s->dirty[i];
+
+		if (r->x < 0 || r->y < 0 || r->x + r->w > s->width ||
+		    r->y + r->h > s->height)
+			errors++;
+	}
+	for (y = 0; y < s->height; y++) {
+		for (x = 0; x < s->width; x++) {
+			bool covered = false;
+
+			if (now[y * s->width + x] == shown[y * s->width + x])
+				continue;
+			for (i = 0; i < s->num_dirty && !covered; i++) {
+				const struct _gfx_rect* r = &s->dirty[i];
+
+				covered = x >= r->x && x < r->x + r->w &&
+				          y >= r->y && y < r->y + r->h;
+			}
+			if (!covered)
+				errors++;
+		}
+	}
+	return errors;
+}
+
+/** Bytes modified in the row padding (if \a padding) and after the buffer */
+static uint32_t check_guards(const struct _gfx_surface* s,
+		const uint32_t* buffer, bool padding)
+{
+	const uint32_t row = s->width * (s->bpp >> 3);
+	uint32_t errors = 0, i, y;
+
+	for (i = 0; i < GUARD_WORDS; i++)
+		if (buffer[s->stride * s->height / 4 + i] != GUARD)
+			errors++;
+	for (y = 0; padding && y < s->height; y++)
+		for (i = row; i < s->stride; i++)
+			if (s->buffer[y * s->stride + i] != PADDING)
+				errors++;
+	return errors;
+}
+
+static void init_buffer(struct _gfx_surface* s, uint32_t* buffer,
+		uint16_t width, uint16_t height, uint8_t bpp)
+{
+	uint32_t i;
+
+	host_check(gfx_init_surface(s, buffer, width, height, bpp) == 0);
+	memset(buffer, PADDING, s->stride * height);
+	for (i = 0; i < GUARD_WORDS; i++)
+		buffer[s->stride * height / 4 + i] = GUARD;
+}
+
+static void test_surface(void)
+{
+	struct _gfx_surface s;
+	uint32_t i;
+
+	printf("gfx: surfaces and pixel formats\n");
+
+	host_check(gfx_init_surface(&s, NULL, 10, 10, 16) == -EINVAL);
+	host_check(gfx_init_surface(&s, (uint8_t*)cpu_buf + 2, 10, 10, 16) == -EINVAL);
+	host_check(gfx_init_surface(&s, cpu_buf, 0, 10, 16) == -EINVAL);
+	host_check(gfx_init_surface(&s, cpu_buf, 10, 0, 16) == -EINVAL);
+	host_check(gfx_init_surface(&s, cpu_buf, 10, 10, 8) == -EINVAL);
+	host_check(gfx_init_canvas(&s, NULL) == -EINVAL);
+
+	host_check(gfx_init_surface(&s, cpu_buf, TEST_WIDTH, TEST_HEIGHT, 16) == 0);
+	host_check(s.stride == 408);
+	host_check(gfx_pixel(&s, 0xffff0000) == 0xf800);
+	host_check(gfx_pixel(&s, 0xff00ff00) == 0x07e0);
+	host_check(gfx_pixel(&s, 0xff0000ff) == 0x001f);
+	host_check(gfx_pixel(&s, 0x00808080) == 0x8410);
+	host_check(gfx_init_surface(&s, cpu_buf, TEST_WIDTH, TEST_HEIGHT, 24) == 0);
+	host_check(s.stride == 612);
+	host_check(gfx_pixel(&s, 0x12345678) == 0x345678);
+	host_check(gfx_init_surface(&s, cpu_buf, TEST_WIDTH, TEST_HEIGHT, 32) == 0);
+	host_check(s.stride == 812);
+	host_check(gfx_pixel(&s, 0x12345678) == 0x12345678);
+
+	for (i = 0; i < 1000; i++) {
+		uint32_t color = host_rand();
+
+		host_check(gfx_pixel(&s, color) == to_raw(32, color));
+		s.bpp = 16;
+		host_check(gfx_pixel(&s, color) == to_raw(16, color));
+		s.bpp = 32;
+	}
+
+	/* reading back, outside too */
+	init_buffer(&s, cpu_buf, TEST_WIDTH, TEST_HEIGHT, 24);
+	gfx_draw_pixel(&s, 5, 7, 0xff123456);
+	host_check(gfx_read_pixel(&s, 5, 7) == 0x123456);
+	host_check(gfx_read_pixel(&s, -1, 7) == 0);
+	host_check(gfx_read_pixel(&s, TEST_WIDTH, 7) == 0);
+	host_check(s.num_dirty == 1 && s.dirty[0].x == 5 && s.dirty[0].y == 7 &&
+			s.dirty[0].w == 1 && s.dirty[0].h == 1);
+	gfx_present(&s);
+	host_check(s.num_dirty == 0 && s.stats.presents == 1);
+	host_check(check_guards(&s, cpu_buf, true) == 0);
+}
+
+static void test_random(uint8_t bpp, bool deferred)
+{
+	struct _gfx_stats cpu_stats, dma_stats;
+	uint32_t model_errors = 0, dirty_errors = 0, guard_errors = 0;
+	uint32_t dma_errors = 0, modeled = 0, i, j;
+	bool ok;
+	static uint32_t after[TEST_WIDTH * TEST_HEIGHT];
+	static uint32_t dma_pixels[TEST_WIDTH * TEST_HEIGHT];
+	struct _op op;
+
+	dma_sim_set_deferred(deferred);
+	init_buffer(&cpu_surface, cpu_buf, TEST_WIDTH, TEST_HEIGHT, bpp);
+	init_buffer(&dma_surface, dma_buf, TEST_WIDTH, TEST_HEIGHT, bpp);
+	gfx_enable_dma(&dma_surface, true, DMA_THRESHOLD);
+	gfx_flush_glyph_cache();
+	for (i = 0; i < ARRAY_SIZE(image); i++) {
+		image[i] = host_rand();
+		image_argb[i] = host_rand();
+		/* mostly transparent or opaque, as in icons */
+		j = host_rand() % 4;
+		if (j < 2)
+			image_argb[i] = j ? image_argb[i] | 0xff000000 :
+				image_argb[i] & 0x00ffffff;
+	}
+
+	read_surface(&cpu_surface, model);
+	memcpy(shown, model, sizeof(shown));
+
+	for (i = 0; i < RANDOM_OPS; i++) {
+		random_op(&op, bpp);
+		memcpy(before, model, sizeof(before));
+
+		draw_op(&cpu_surface, &op);
+		draw_op(&dma_surface, &op);
+
+		read_surface(&cpu_surface, after);
+		if (model_op(&op, bpp)) {
+			modeled++;
+			ok = memcmp(model, after, sizeof(model)) == 0;
+		} else {
+			ok = check_op(&op, bpp, after) == 0;
+		}
+		if (!ok && model_errors++ == 0)
+			printf("  primitive %u: type %u at %d,%d size %dx%d r %d"
+					" alpha %u is wrong\n", (unsigned)i, op.type,
+					(int)op.x, (int)op.y, (int)op.w, (int)op.h,
+					(int)op.r, op.alpha);
+		memcpy(model, after, sizeof(model));
+
+		if (check_dirty(&cpu_surface, after))
+			dirty_errors++;
+		guard_errors += check_guards(&cpu_surface, cpu_buf, true);
+
+		/* DMA jobs stay in flight until the next frame, or until a
+		 * primitive touches their area */
+		if (host_rand() % 8 == 0 || i == RANDOM_OPS - 1) {
+			gfx_sync(&dma_surface);
+			read_surface(&dma_surface, dma_pixels);
+			if (memcmp(dma_pixels, after, sizeof(after)))
+				dma_errors++;
+			if (check_dirty(&dma_surface, dma_pixels))
+				dirty_errors++;
+			/* the DMA may have written the row padding */
+			guard_errors += check_guards(&dma_surface, dma_buf, false);
+
+			gfx_present(&cpu_surface);
+			gfx_present(&dma_surface);
+			memcpy(shown, after, sizeof(shown));
+		}
+	}
+
+	gfx_get_stats(&cpu_surface, &cpu_stats);
+	gfx_get_stats(&dma_surface, &dma_stats);
+	printf("  %u bpp, DMA %s: %u primitives (%u modeled), %u DMA jobs,"
+			" %u glyph hits / %u misses, %u model, %u dirty,"
+			" %u guard, %u DMA errors\n",
+			bpp, deferred ? "deferred" : "immediate",
+			(unsigned)RANDOM_OPS, (unsigned)modeled,
+			(unsigned)dma_stats.dma_jobs,
+			(unsigned)cpu_stats.glyph_hits,
+			(unsigned)cpu_stats.glyph_misses,
+			(unsigned)model_errors, (unsigned)dirty_errors,
+			(unsigned)guard_errors, (unsigned)dma_errors);
+	host_check(model_errors == 0);
+	host_check(dirty_errors == 0);
+	host_check(guard_errors == 0);
+	host_check(dma_errors == 0);
+	host_check(cpu_stats.dma_jobs == 0 && dma_stats.dma_jobs > 0);
+	host_check(cpu_stats.glyph_hits > 0);
+	gfx_enable_dma(&dma_surface, false, 0);
+}
+
+static void test_present(uint8_t bpp)
+{
+	struct _gfx_surface s;
+	struct _gfx_stats stats;
+	char label[32];
+	uint32_t frame, bar = 0, size, rects = 0;
+
+	init_buffer(&s, panel_buf, PANEL_WIDTH, PANEL_HEIGHT, bpp);
+	gfx_fill(&s, 0xff202020);
+	gfx_fill_rect(&s, 0, 0, PANEL_WIDTH, 40, 0xff004080);
+	gfx_draw_string(&s, &font, 16, 16, "Motor control", 0xffffffff, 0,
+			false);
+	gfx_draw_rounded_rect(&s, 30, 180, 620, 40, 8, 0xffc0c0c0);
+	gfx_present(&s);
+	gfx_reset_stats(&s);
+
+	/* a label, a progress bar and a blinking indicator per frame */
+	for (frame = 0; frame < HMI_FRAMES; frame++) {
+		snprintf(label, sizeof(label), "Speed %5u rpm",
+				(unsigned)(1000 + frame * 37));
+		gfx_draw_string(&s, &font, 40, 100, label, 0xffffffff,
+				0xff202020, true);
+		if (bar >= 600) {
+			gfx_fill_rect(&s, 40, 192, 600, 16, 0xff202020);
+			bar = 0;
+		}
+		gfx_fill_rect(&s, 40 + bar, 192, 6, 16, 0xff00c000);
+		bar += 6;
+		gfx_fill_circle(&s, 760, 20, 8,
+				(frame & 1) ? 0xff00ff00 : 0xff404040);
+		rects += s.num_dirty;
+		gfx_present(&s);
+	}
+
+	gfx_get_stats(&s, &stats);
+	size = s.stride * s.height;
+	printf("  %u bpp: %u dirty rectangles, %6.0f bytes cleaned per frame"
+			" of %u (%.2f%%)\n", bpp,
+			(unsigned)(rects / HMI_FRAMES),
+			(double)stats.cleaned / HMI_FRAMES, (unsigned)size,
+			100.0 * stats.cleaned / HMI_FRAMES / size);
+	host_check(stats.presents == HMI_FRAMES);
+	host_check(stats.cleaned / HMI_FRAMES < size / 50);
+}
+
+/** The fill of the former lcd_draw.c: one memcpy() per pixel */
+static void fill_per_pixel(struct _gfx_surface* s, int32_t x, int32_t y,
+		int32_t w, int32_t h, uint32_t color)
+{
+	const uint32_t bytes = s->bpp >> 3;
+	const uint32_t pixel = gfx_pixel(s, color);
+	int32_t i, j;
+
+	for (j = y; j < y + h; j++)
+		for (i = x; i < x + w; i++)
+			memcpy(s->buffer + j * s->stride + i * bytes, &pixel, bytes);
+}
+
+/** Primitive \a i of benchmark \a bench, in the order of benches[] */
+static void bench_op(struct _gfx_surface* s, uint32_t bench, uint32_t i)
+{
+	const int32_t x = i * 97 % 500, y = i * 61 % 300;
+	const uint32_t color = 0xff000000 | (i * 0x010305);
+
+	switch (bench) {
+	case 0:
+		gfx_fill(s, color);
+		break;
+	case 1:
+		gfx_fill_rect(s, x, y, 100, 100, color);
+		break;
+	case 2:
+		fill_per_pixel(s, x, y, 100, 100, color);
+		break;
+	case 3:
+		gfx_draw_hline(s, x, y, 200, color);
+		break;
+	case 4:
+		gfx_draw_vline(s, x, y, 200, color);
+		break;
+	case 5:
+		gfx_draw_line(s, x, y, x + 200, y + 120, color);
+		break;
+	case 6:
+		gfx_draw_rect(s, x, y, 100, 100, color);
+		break;
+	case 7:
+		gfx_draw_circle(s, x + 50, y + 50, 50, color);
+		break;
+	case 8:
+		gfx_fill_circle(s, x + 50, y + 50, 50, color);
+		break;
+	case 9:
+		gfx_fill_rounded_rect(s, x, y, 200, 60, 12, color);
+		break;
+	case 10:
+		gfx_blend_rect(s, x, y, 100, 100, color, 0x80);
+		break;
+	case 11:
+		gfx_blit(s, x, y, image, IMAGE_WIDTH * (s->bpp >> 3), 64, 64);
+		break;
+	case 12:
+		gfx_blit_argb(s, x, y, image_argb, IMAGE_WIDTH, 64, 64);
+		break;
+	case 13:
+		gfx_draw_string(s, &font, x, y, "0123456789ABCDEF", color, 0,
+				false);
+		break;
+	}
+	if ((i & 63) == 63)
+		gfx_present(s);
+}
+
+/** Primitives per second of a benchmark */
+static double bench_rate(struct _gfx_surface* s, uint32_t bench)
+{
+	uint64_t start, elapsed;
+	uint32_t n, i;
+
+	for (n = 4;; n *= 2) {
+		start = host_time_ns();
+		for (i = 0; i < n; i++)
+			bench_op(s, bench, i);
+		elapsed = host_time_ns() - start;
+		if (elapsed >= BENCH_NS)
+			return n * 1e9 / elapsed;
+	}
+}
+
+static void test_bench(void)
+{
+	struct _gfx_surface s;
+	double rate[ARRAY_SIZE(benches)][ARRAY_SIZE(bpps)];
+	uint32_t b, i;
+
+	printf("gfx: CPU primitives per second on %ux%u, thousands\n",
+			PANEL_WIDTH, PANEL_HEIGHT);
+	printf("  %-24s", "primitive");
+	for (i = 0; i < ARRAY_SIZE(bpps); i++)
+		printf(" %6u bpp", bpps[i]);
+	printf("\n");
+
+	for (i = 0; i < ARRAY_SIZE(bpps); i++) {
+		init_buffer(&s, panel_buf, PANEL_WIDTH, PANEL_HEIGHT, bpps[i]);
+		for (b = 0; b < ARRAY_SIZE(benches); b++)
+			rate[b][i] = bench_rate(&s, b);
+	}
+
+	for (b = 0; b < ARRAY_SIZE(benches); b++) {
+		printf("  %-24s", benches[b].name);
+		for (i = 0; i < ARRAY_SIZE(bpps); i++)
+			printf(" %10.1f", rate[b][i] / 1000);
+		printf("\n");
+	}
+	printf("  %-24s", "fill_rect Mpixel/s");
+	for (i = 0; i < ARRAY_SIZE(bpps); i++)
+		printf(" %10.0f", rate[1][i] * benches[1].pixels / 1e6);
+	printf("\n  %-24s", "  speedup over memcpy");
+	for (i = 0; i < ARRAY_SIZE(bpps); i++) {
+		printf(" %10.1f", rate[1][i] / rate[2][i]);
+		host_check(rate[1][i] > 1.5 * rate[2][i]);
+	}
+	printf("\n");
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	uint32_t i;
+
+	host_init();
+	dma_initialize(true);
+	host_check(dma_job_initialize(DMA_JOB_MAX_CHANNELS) > 0);
+	/* every job through the DMA model, however small */
+	dma_job_set_cpu_threshold(0);
+
+	test_surface();
+
+	printf("gfx: random primitives, CPU against model and DMA\n");
+	for (i = 0; i < ARRAY_SIZE(bpps); i++) {
+		test_random(bpps[i], false);
+		test_random(bpps[i], true);
+	}
+
+	printf("gfx: dirty rectangles, HMI update on %ux%u\n",
+			PANEL_WIDTH, PANEL_HEIGHT);
+	for (i = 0; i < ARRAY_SIZE(bpps); i++)
+		test_present(bpps[i]);
+
+	test_bench();
+
+	return host_report("gfx");
+}
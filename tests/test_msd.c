@@ -0,0 +1,462 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  READ (10) and WRITE (10) through the MSD class driver (msdd_state_machine
+ *  and sbc_methods.c) on a simulated high speed port, over a RAM disk with
+ *  the access times of a slow media. The test plays the USB host: it sends
+ *  the CBW and the data, checks the data and the CSW, and polls the state
+ *  machine from its main loop every microsecond of virtual time.
+ *
+ *  For each media timing and command length, the throughput is compared
+ *  with the time the same chunks take without overlapping the media access
+ *  with the USB transfer, and the stall counters of the I/O FIFO tell which
+ *  side of the ping-pong waited: nullCnt when the consumer found the
+ *  buffer empty, fullCnt when the producer found it full.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "compiler.h"
+#include "intmath.h"
+
+#include "libstoragemedia/media.h"
+#include "libstoragemedia/media_private.h"
+#include "libstoragemedia/media_ramdisk.h"
+#include "timer_wheel.h"
+#include "usb/device/msd/msd.h"
+#include "usb/device/msd/msd_lun.h"
+#include "usb/device/msd/msdd_state_machine.h"
+#include "usb/device/msd/sbc.h"
+
+#include "host.h"
+#include "host_timer.h"
+#include "usbd_sim.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define BLOCK_SIZE      512
+#define DISK_SIZE       (16 * 1024 * 1024)
+#define DISK_BLOCKS     (DISK_SIZE / BLOCK_SIZE)
+
+/** I/O buffer of the LUN, as MSD_BUFFER_SIZE in the usb_mass_storage
+ * example: two 32 KB slots */
+#define BUFFER_SIZE     (128 * BLOCK_SIZE)
+
+/** Longest command, in blocks */
+#define MAX_BLOCKS      256
+
+#define EP_OUT          1
+#define EP_IN           2
+
+/** Period of the main loop */
+#define POLL_TICKS      (HOST_TIMER_FREQ / 1000000)
+
+#define TIMEOUT_NS      1000000000ull
+
+/** Data moved by each benchmark */
+#define BENCH_BYTES     (2 * 1024 * 1024)
+
+#define RANDOM_COMMANDS 400
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+struct _profile {
+	const char* name;
+	uint32_t access_us;
+	uint32_t block_us;
+};
+
+struct _monitor {
+	uint32_t commands;
+	uint64_t bytes;
+	uint32_t null_cnt;
+	uint32_t full_cnt;
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+/** Media timings, compared with the 40 MB/s of the bus */
+static const struct _profile profiles[] = {
+	{ "fast", 20, 2 },          /* 200 MB/s */
+	{ "balanced", 50, 12 },     /* 40 MB/s */
+	{ "slow", 300, 40 },        /* 12 MB/s */
+};
+
+static const uint32_t bench_blocks[] = { 8, 32, 128, 256 };
+
+ALIGNED(BLOCK_SIZE) static uint8_t disk[DISK_SIZE];
+ALIGNED(L1_CACHE_BYTES) static uint8_t io_buffer[BUFFER_SIZE];
+
+static struct _media media;
+static struct _ramdisk_latency latency;
+static MSDLun lun;
+static MSDDriver driver;
+
+static struct _usbd_sim_timing bus = {
+	.bytes_per_us = 40,
+	.xfer_us = 5,
+};
+
+/** Last command reported by the data monitor, per direction */
+static struct _monitor monitor[2];
+
+/* Host side */
+static MSCbw cbw;
+static MSCsw csw;
+static bool csw_received;
+static uint32_t tag;
+static uint8_t host_tx[MAX_BLOCKS * BLOCK_SIZE];
+static uint8_t host_rx[MAX_BLOCKS * BLOCK_SIZE];
+static uint32_t rx_length;
+static uint32_t rx_expected;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static void data_monitor(uint8_t flow_direction, uint32_t data_length,
+		uint32_t fifo_null_count, uint32_t fifo_full_count)
+{
+	struct _monitor* m = &monitor[flow_direction ? 1 : 0];
+
+	m->commands++;
+	m->bytes += data_length;
+	m->null_cnt = fifo_null_count;
+	m->full_cnt = fifo_full_count;
+}
+
+static void host_in(void* arg, uint8_t endpoint, const uint8_t* data,
+		uint32_t length)
+{
+	host_check(endpoint == EP_IN);
+	if (rx_length < rx_expected) {
+		host_check(rx_length + length <= rx_expected);
+		memcpy(host_rx + rx_length, data,
+				min_u32(length, rx_expected - rx_length));
+		rx_length += length;
+	} else {
+		host_check(length == MSD_CSW_SIZE && !csw_received);
+		memcpy(&csw, data, MSD_CSW_SIZE);
+		csw_received = true;
+	}
+}
+
+static void fill(uint8_t* data, uint32_t size)
+{
+	uint32_t i, w;
+
+	for (i = 0; i < size; i += 4) {
+		w = host_rand();
+		memcpy(data + i, &w, 4);
+	}
+}
+
+/** Send a command and run the device until its CSW is received.
+ * \return the CSW status, 0xff on timeout */
+static uint8_t command(const uint8_t* cdb, uint8_t cdb_length, bool in,
+		uint32_t length)
+{
+	uint64_t deadline;
+
+	memset(&cbw, 0, sizeof(cbw));
+	cbw.dCBWSignature = MSD_CBW_SIGNATURE;
+	cbw.dCBWTag = ++tag;
+	cbw.dCBWDataTransferLength = length;
+	cbw.bmCBWFlags = in ? MSD_CBW_DEVICE_TO_HOST : 0;
+	cbw.bCBWCBLength = cdb_length;
+	memcpy(cbw.pCommand, cdb, cdb_length);
+
+	rx_length = 0;
+	rx_expected = in ? length : 0;
+	csw_received = false;
+	usbd_sim_host_out(EP_OUT, &cbw, MSD_CBW_SIZE);
+	if (!in && length)
+		usbd_sim_host_out(EP_OUT, host_tx, length);
+
+	deadline = host_timer_ns() + TIMEOUT_NS;
+	while (!csw_received && host_timer_ns() < deadline) {
+		msdd_state_machine(&driver);
+		host_timer_advance(POLL_TICKS);
+	}
+
+	host_check(csw_received);
+	if (!csw_received)
+		return 0xff;
+	host_check(csw.dCSWSignature == MSD_CSW_SIGNATURE);
+	host_check(csw.dCSWTag == tag);
+	host_check(rx_length == rx_expected);
+	return csw.bCSWStatus;
+}
+
+static uint8_t rw10(bool read, uint32_t lba, uint32_t blocks)
+{
+	uint8_t cdb[10] = { read ? SBC_READ_10 : SBC_WRITE_10 };
+
+	cdb[2] = (uint8_t)(lba >> 24);
+	cdb[3] = (uint8_t)(lba >> 16);
+	cdb[4] = (uint8_t)(lba >> 8);
+	cdb[5] = (uint8_t)lba;
+	cdb[7] = (uint8_t)(blocks >> 8);
+	cdb[8] = (uint8_t)blocks;
+	return command(cdb, sizeof(cdb), read, blocks * BLOCK_SIZE);
+}
+
+/** READ (10) or WRITE (10) checking the data and the status */
+static bool transfer(bool read, uint32_t lba, uint32_t blocks)
+{
+	uint8_t status;
+	bool ok;
+
+	if (!read)
+		fill(host_tx, blocks * BLOCK_SIZE);
+	status = rw10(read, lba, blocks);
+	host_check(status == MSD_CSW_COMMAND_PASSED);
+	host_check(csw.dCSWDataResidue == 0);
+	if (read)
+		ok = !memcmp(host_rx, disk + lba * BLOCK_SIZE, blocks * BLOCK_SIZE);
+	else
+		ok = !memcmp(disk + lba * BLOCK_SIZE, host_tx, blocks * BLOCK_SIZE);
+	host_check(ok);
+	return ok && status == MSD_CSW_COMMAND_PASSED;
+}
+
+static void set_profile(const struct _profile* profile)
+{
+	if (profile) {
+		latency.access_us = profile->access_us;
+		latency.block_us = profile->block_us;
+		media_ramdisk_set_latency(&media, &latency);
+	} else {
+		media_ramdisk_set_latency(&media, NULL);
+	}
+}
+
+/** Time of a command without overlap: each chunk read from the media then
+ * sent, or received then written, plus the CBW and the CSW. The resolution
+ * of the timer wheel and the polling period are left out, which makes
+ * single chunk commands look slower than serial. */
+static uint64_t serial_ns(const struct _profile* profile, uint32_t length,
+		uint32_t chunk)
+{
+	uint64_t ns = 2 * (uint64_t)bus.xfer_us * 1000 +
+		(MSD_CBW_SIZE + MSD_CSW_SIZE) * 1000ull / bus.bytes_per_us;
+	uint32_t offset, size;
+
+	for (offset = 0; offset < length; offset += size) {
+		size = min_u32(chunk, length - offset);
+		ns += (profile->access_us +
+			(uint64_t)profile->block_us * size / BLOCK_SIZE) * 1000;
+		ns += (uint64_t)bus.xfer_us * 1000 +
+			(uint64_t)size * 1000 / bus.bytes_per_us;
+	}
+	return ns;
+}
+
+static double mb_s(uint64_t bytes, uint64_t ns)
+{
+	return ns ? bytes * 1e3 / ns : 0.0;
+}
+
+static void test_setup(void)
+{
+	uint8_t tur[6] = { SBC_TEST_UNIT_READY };
+	uint8_t capacity[10] = { SBC_READ_CAPACITY_10 };
+
+	printf("msd: setup\n");
+
+	/* unit attention on the first command after the media change */
+	host_check(command(tur, sizeof(tur), false, 0) == MSD_CSW_COMMAND_FAILED);
+	host_check(command(tur, sizeof(tur), false, 0) == MSD_CSW_COMMAND_PASSED);
+
+	host_check(command(capacity, sizeof(capacity), true, 8) ==
+			MSD_CSW_COMMAND_PASSED);
+	host_check(host_rx[0] == (uint8_t)((DISK_BLOCKS - 1) >> 24));
+	host_check(host_rx[1] == (uint8_t)((DISK_BLOCKS - 1) >> 16));
+	host_check(host_rx[2] == (uint8_t)((DISK_BLOCKS - 1) >> 8));
+	host_check(host_rx[3] == (uint8_t)(DISK_BLOCKS - 1));
+	host_check(host_rx[6] == (BLOCK_SIZE >> 8) && host_rx[7] == 0);
+
+	printf("  ready, %u blocks of %u bytes\n",
+			(unsigned)DISK_BLOCKS, (unsigned)BLOCK_SIZE);
+}
+
+/** Random commands on every media timing, including the memory mapped
+ * transfers of the RAM disk without latency */
+static void test_random(void)
+{
+	uint32_t i, lba, blocks, reads = 0, writes = 0;
+	const struct _profile* profile;
+	bool read, ok = true;
+
+	printf("msd: random commands\n");
+
+	for (i = 0; i < RANDOM_COMMANDS && ok; i++) {
+		profile = host_rand() % 4 ? &profiles[host_rand() % ARRAY_SIZE(profiles)] : NULL;
+		set_profile(profile);
+		read = host_rand() & 1;
+		blocks = 1 + host_rand() % MAX_BLOCKS;
+		lba = host_rand() % (DISK_BLOCKS - blocks + 1);
+		ok = transfer(read, lba, blocks);
+		if (read)
+			reads++;
+		else
+			writes++;
+		host_check(monitor[read].bytes == blocks * BLOCK_SIZE);
+		monitor[read].bytes = 0;
+	}
+	host_check(usbd_sim_get_stats()->halts == 0);
+	printf("  %u reads, %u writes of 1 to %u blocks: %s\n",
+			(unsigned)reads, (unsigned)writes, MAX_BLOCKS,
+			ok ? "ok" : "FAILED");
+}
+
+/** Sequential commands of one length, returns the time in nanoseconds and
+ * the stall counters summed over the commands */
+static uint64_t run(const struct _profile* profile, bool read,
+		uint32_t blocks, struct _monitor* total, uint64_t* serial)
+{
+	uint32_t lba = 0, count = BENCH_BYTES / (blocks * BLOCK_SIZE);
+	uint64_t t0;
+
+	memset(total, 0, sizeof(*total));
+	*serial = 0;
+	t0 = host_timer_ns();
+	while (count--) {
+		if (!transfer(read, lba, blocks))
+			break;
+		total->commands++;
+		total->bytes += blocks * BLOCK_SIZE;
+		total->null_cnt += monitor[read].null_cnt;
+		total->full_cnt += monitor[read].full_cnt;
+		if (profile)
+			*serial += serial_ns(profile, blocks * BLOCK_SIZE,
+					lun.ioFifo.chunkSize);
+		lba += blocks;
+	}
+	return host_timer_ns() - t0;
+}
+
+static void bench(bool read)
+{
+	struct _monitor total;
+	uint64_t ns, serial;
+	uint32_t i, j;
+	double speedup;
+
+	printf("msd: %s (10), %u MB/s bus\n", read ? "READ" : "WRITE",
+			(unsigned)bus.bytes_per_us);
+
+	set_profile(NULL);
+	ns = run(NULL, read, MAX_BLOCKS, &total, &serial);
+	printf("  %-9s %3uKB %7.2f MB/s  (memory mapped, one transfer)\n",
+			"ramdisk", MAX_BLOCKS * BLOCK_SIZE / 1024,
+			mb_s(total.bytes, ns));
+	host_check(total.null_cnt == 0 && total.full_cnt == 0);
+
+	for (i = 0; i < ARRAY_SIZE(profiles); i++) {
+		set_profile(&profiles[i]);
+		for (j = 0; j < ARRAY_SIZE(bench_blocks); j++) {
+			ns = run(&profiles[i], read, bench_blocks[j], &total,
+					&serial);
+			speedup = (double)serial / ns;
+			printf("  %-9s %3uKB %7.2f MB/s  x%.2f vs serial,"
+					" null %5.2f full %5.2f per command\n",
+					profiles[i].name,
+					(unsigned)(bench_blocks[j] * BLOCK_SIZE / 1024),
+					mb_s(total.bytes, ns), speedup,
+					(double)total.null_cnt / total.commands,
+					(double)total.full_cnt / total.commands);
+
+			/* the bus is the limit whatever the media */
+			host_check(mb_s(total.bytes, ns) <= bus.bytes_per_us);
+			if (bench_blocks[j] * BLOCK_SIZE >= 2 * MSDIO_MIN_CHUNK_SIZE)
+				host_check(speedup > 1.0);
+			if (bench_blocks[j] != MAX_BLOCKS)
+				continue;
+
+			/* 4 chunks: the side that waits is the fastest one */
+			if (!strcmp(profiles[i].name, "fast")) {
+				host_check(read ? total.full_cnt > 0 : total.null_cnt > 0);
+				host_check(read ? total.null_cnt == 0 : total.full_cnt == 0);
+			} else if (!strcmp(profiles[i].name, "slow")) {
+				host_check(read ? total.null_cnt > 0 : total.full_cnt > 0);
+				host_check(read ? total.full_cnt == 0 : total.null_cnt == 0);
+			} else {
+				host_check(speedup > 1.4);
+			}
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	host_init();
+	host_timer_reset();
+	timer_wheel_init();
+
+	fill(disk, DISK_SIZE);
+	media_ramdisk_init(&media, (uint32_t)disk / BLOCK_SIZE,
+			DISK_BLOCKS, BLOCK_SIZE);
+	lun_init(&lun, &media, io_buffer, BUFFER_SIZE, 0, 0, 0, 0,
+			data_monitor);
+
+	usbd_sim_init(&bus, host_in, NULL);
+	memset(&driver, 0, sizeof(driver));
+	driver.commandState.pipeIN = EP_IN;
+	driver.commandState.pipeOUT = EP_OUT;
+	driver.luns = &lun;
+	driver.maxLun = 0;
+	driver.state = MSDD_STATE_READ_CBW;
+
+	test_setup();
+	test_random();
+	bench(true);
+	bench(false);
+
+	return host_report("msd");
+}
@@ -0,0 +1,422 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  NAND flash translation layer (media_nandflash) on the simulated device:
+ *  random sector writes and reads checked against a model of the content
+ *  across flushes, remounts, factory and grown bad blocks and damaged meta
+ *  data; throughput of sequential and random accesses in virtual time, and
+ *  an endurance run reporting the write amplification and the spread of the
+ *  erase counts until the first block wears out.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "chip.h"
+
+#include "libstoragemedia/media.h"
+#include "libstoragemedia/media_private.h"
+#include "libstoragemedia/media_nandflash.h"
+#include "nvm/nand/nand_flash.h"
+#include "nvm/nand/nand_flash_ecc.h"
+#include "nvm/nand/nand_flash_raw.h"
+#include "nvm/nand/pmecc.h"
+
+#include "host.h"
+#include "nand_sim.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define PAGE_SIZE       2048
+#define SPARE_SIZE      64
+#define PAGES_PER_BLOCK 64
+#define NUM_BLOCKS      128
+#define ECC_T           4
+
+#define SECTOR_SIZE     MEDIA_NANDFLASH_SECTOR_SIZE
+#define MAX_SECTORS     (NUM_BLOCKS * PAGES_PER_BLOCK * (PAGE_SIZE / SECTOR_SIZE))
+
+/** Longest access of the random workloads, in sectors */
+#define MAX_RUN         16
+
+#define CHECK_OPS       20000
+
+/** Endurance run: partition and cycles before a block wears out */
+#define WEAR_FIRST_BLOCK 64
+#define WEAR_BLOCKS      32
+#define WEAR_CYCLES      100
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static const struct _nand_flash_model _model = {
+	.device_id = 0x73,
+	.data_bus_width = 8,
+	.device_size = 16,
+	.page_size = PAGE_SIZE,
+	.spare_size = SPARE_SIZE,
+	.block_size = PAGES_PER_BLOCK * PAGE_SIZE,
+};
+
+static struct _nand_flash nand;
+static struct _media media;
+static struct _nand_ftl ftl;
+
+static uint32_t map[NUM_BLOCKS * PAGES_PER_BLOCK];
+static uint8_t buffers[MEDIA_NANDFLASH_BUFFER_SIZE(PAGE_SIZE, SPARE_SIZE)];
+
+/** Version of each sector, 0 if never written */
+static uint32_t versions[MAX_SECTORS];
+
+static uint8_t io[MAX_RUN * SECTOR_SIZE];
+static uint8_t big[64 * SECTOR_SIZE];
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Content of a sector for a version, all 0xff for version 0.
+ */
+static void fill_sector(uint8_t* data, uint32_t sector, uint32_t version)
+{
+	uint32_t x = sector * 0x9e3779b1u ^ version * 0x85ebca6bu;
+	uint32_t i;
+
+	if (!version) {
+		memset(data, 0xff, SECTOR_SIZE);
+		return;
+	}
+	for (i = 0; i < SECTOR_SIZE; i += 4) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		memcpy(data + i, &x, 4);
+	}
+}
+
+static bool check_sectors(const uint8_t* data, uint32_t sector, uint32_t count)
+{
+	uint8_t expected[SECTOR_SIZE];
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		fill_sector(expected, sector + i, versions[sector + i]);
+		if (memcmp(data + i * SECTOR_SIZE, expected, SECTOR_SIZE))
+			return false;
+	}
+	return true;
+}
+
+static void setup_nand(void)
+{
+	nand_sim_init(&_model, false);
+	nand_initialize(&nand);
+	host_check(nand_raw_initialize(&nand, &_model) == 0);
+	nand_set_ecc_type(ECC_PMECC);
+	nand_set_dma_enabled(true);
+	host_check(pmecc_initialize(0, ECC_T, PAGE_SIZE, SPARE_SIZE, 0, 0) == 0);
+}
+
+static bool mount(uint16_t first_block, uint16_t num_blocks)
+{
+	return media_nandflash_initialize(&media, &ftl, &nand, first_block,
+			num_blocks, map, buffers) == 0;
+}
+
+static bool write_run(uint32_t sector, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		fill_sector(io + i * SECTOR_SIZE, sector + i, ++versions[sector + i]);
+	return media_write(&media, sector, io, count, NULL, NULL) ==
+		MEDIA_STATUS_SUCCESS;
+}
+
+static bool verify_all(void)
+{
+	uint32_t size = media_get_size(&media);
+	uint32_t sector, count;
+	bool ok = true;
+
+	for (sector = 0; sector < size; sector += count) {
+		count = size - sector < 64 ? size - sector : 64;
+		if (media_read(&media, sector, big, count, NULL, NULL) !=
+				MEDIA_STATUS_SUCCESS ||
+		    !check_sectors(big, sector, count))
+			ok = false;
+	}
+	return ok;
+}
+
+/**
+ * \brief Damage the first meta data copy of the page holding a sector.
+ */
+static void damage_meta(uint32_t sector)
+{
+	uint32_t offset;
+	uint32_t ppage = map[sector / (PAGE_SIZE / SECTOR_SIZE)];
+
+	nand_ecc_get_meta_area(&nand, &offset);
+	nand_sim_flip(ppage / PAGES_PER_BLOCK, ppage % PAGES_PER_BLOCK,
+			(PAGE_SIZE + offset) * 8 + host_rand() % 32);
+}
+
+static void check_consistency(void)
+{
+	struct _nand_ftl_stats stats;
+	uint32_t size, op, reads = 0, bad_reads = 0;
+	uint16_t grown;
+
+	printf("nand_ftl: random accesses, remounts, bad blocks\n");
+
+	setup_nand();
+	nand_sim_set_bad(37, true);
+	host_check(mount(0, NUM_BLOCKS));
+	host_check(media_nandflash_format(&media) == MEDIA_STATUS_SUCCESS);
+	size = media_get_size(&media);
+	memset(versions, 0, sizeof(versions));
+
+	for (op = 0; op < CHECK_OPS; op++) {
+		uint32_t count = 1 + host_rand() % MAX_RUN;
+		uint32_t sector = host_rand() % (size - count);
+
+		if (host_rand() % 4) {
+			host_check(write_run(sector, count));
+		} else {
+			reads++;
+			if (media_read(&media, sector, io, count, NULL, NULL) !=
+					MEDIA_STATUS_SUCCESS ||
+			    !check_sectors(io, sector, count))
+				bad_reads++;
+		}
+
+		if (op % 16 == 0)
+			media_handler(&media);
+		if (op % 500 == 0)
+			host_check(media_flush(&media) == MEDIA_STATUS_SUCCESS);
+
+		/* a block of the log goes bad */
+		if (op == CHECK_OPS / 2) {
+			grown = ftl.active;
+			nand_sim_set_bad(grown, false);
+		}
+	}
+	host_check(bad_reads == 0);
+	host_check(media_flush(&media) == MEDIA_STATUS_SUCCESS);
+	host_check(verify_all());
+
+	media_nandflash_get_stats(&media, &stats);
+	host_check(stats.bad_blocks == 2);
+	printf("  %u operations (%u reads), %u bad blocks, WA %.2f\n",
+		CHECK_OPS, reads, stats.bad_blocks,
+		(double)stats.pages_written * (PAGE_SIZE / SECTOR_SIZE) /
+		stats.sectors_written);
+
+	/* remount: the mapping is rebuilt from the meta data, damaged copies
+	 * are repaired */
+	damage_meta(0);
+	damage_meta(size / 2);
+	damage_meta(size - 1);
+	host_check(mount(0, NUM_BLOCKS));
+	host_check(media_get_size(&media) == size);
+	host_check(verify_all());
+	media_nandflash_get_stats(&media, &stats);
+	host_check(stats.meta_repaired >= 3);
+	host_check(stats.bad_blocks >= 1);
+
+	/* the repaired block is rewritten in the background */
+	for (op = 0; op < 4; op++)
+		media_handler(&media);
+	host_check(write_run(0, MAX_RUN));
+	host_check(media_flush(&media) == MEDIA_STATUS_SUCCESS);
+	host_check(mount(0, NUM_BLOCKS));
+	host_check(verify_all());
+	printf("  remount: %u meta data copies repaired, content verified\n",
+		stats.meta_repaired);
+}
+
+static double mb_s(uint64_t bytes, uint64_t ns)
+{
+	return bytes * 1e3 / ns;
+}
+
+static void bench_throughput(void)
+{
+	struct _nand_ftl_stats before, after;
+	uint64_t start;
+	uint32_t size, sector, n;
+
+	printf("nand_ftl: throughput (tR 25us, tPROG 200us, tBERS 2ms)\n");
+
+	setup_nand();
+	host_check(mount(0, NUM_BLOCKS));
+	host_check(media_nandflash_format(&media) == MEDIA_STATUS_SUCCESS);
+	size = media_get_size(&media);
+	memset(versions, 0, sizeof(versions));
+
+	/* sequential write of the whole media, 32KB at a time */
+	memset(big, 0x5a, sizeof(big));
+	media_nandflash_get_stats(&media, &before);
+	start = nand_sim_time_ns();
+	for (sector = 0; sector + 64 <= size; sector += 64)
+		media_write(&media, sector, big, 64, NULL, NULL);
+	media_flush(&media);
+	media_nandflash_get_stats(&media, &after);
+	printf("  sequential write   %6.2f MB/s, WA %.2f\n",
+		mb_s((uint64_t)sector * SECTOR_SIZE, nand_sim_time_ns() - start),
+		(double)(after.pages_written - before.pages_written) *
+		(PAGE_SIZE / SECTOR_SIZE) /
+		(after.sectors_written - before.sectors_written));
+
+	start = nand_sim_time_ns();
+	for (sector = 0; sector + 64 <= size; sector += 64)
+		media_read(&media, sector, big, 64, NULL, NULL);
+	printf("  sequential read    %6.2f MB/s\n",
+		mb_s((uint64_t)sector * SECTOR_SIZE, nand_sim_time_ns() - start));
+
+	/* random 4KB writes on the full media */
+	media_nandflash_get_stats(&media, &before);
+	start = nand_sim_time_ns();
+	for (n = 0; n < 8000; n++) {
+		sector = (host_rand() % (size / 8)) * 8;
+		media_write(&media, sector, big, 8, NULL, NULL);
+		if (n % 64 == 0)
+			media_handler(&media);
+	}
+	media_flush(&media);
+	media_nandflash_get_stats(&media, &after);
+	printf("  random 4KB write   %6.2f MB/s, WA %.2f\n",
+		mb_s((uint64_t)n * 8 * SECTOR_SIZE, nand_sim_time_ns() - start),
+		(double)(after.pages_written - before.pages_written) *
+		(PAGE_SIZE / SECTOR_SIZE) /
+		(after.sectors_written - before.sectors_written));
+
+	start = nand_sim_time_ns();
+	for (n = 0; n < 8000; n++) {
+		sector = host_rand() % size;
+		media_read(&media, sector, big, 1, NULL, NULL);
+	}
+	printf("  random 512B read   %6.2f MB/s\n",
+		mb_s((uint64_t)n * SECTOR_SIZE, nand_sim_time_ns() - start));
+}
+
+/**
+ * \brief Fill the media, then rewrite mostly a hot tenth of it until the
+ * first block wears out.
+ */
+static void bench_endurance(void)
+{
+	struct _nand_ftl_stats stats;
+	uint64_t host_sectors = 0, capacity;
+	uint32_t size, sector, sum = 0, n = 0;
+	uint16_t b, min = 0xffff, max = 0;
+	bool ok = true;
+
+	printf("nand_ftl: endurance, %u blocks of %u cycles, 90%% of the writes "
+		"on 10%% of the data\n", WEAR_BLOCKS, WEAR_CYCLES);
+
+	setup_nand();
+	nand_sim_set_endurance(WEAR_CYCLES);
+	host_check(mount(WEAR_FIRST_BLOCK, WEAR_BLOCKS));
+	host_check(media_nandflash_format(&media) == MEDIA_STATUS_SUCCESS);
+	size = media_get_size(&media);
+	memset(versions, 0, sizeof(versions));
+
+	for (sector = 0; sector + MAX_RUN <= size; sector += MAX_RUN)
+		host_check(write_run(sector, MAX_RUN));
+
+	do {
+		uint32_t count = 1 + host_rand() % 8;
+		if (host_rand() % 10)
+			sector = host_rand() % (size / 10 - count);
+		else
+			sector = host_rand() % (size - count);
+		ok = write_run(sector, count);
+		host_sectors += count;
+		if (++n % 16 == 0)
+			media_handler(&media);
+		if (n % 256 == 0)
+			ok = ok && media_flush(&media) == MEDIA_STATUS_SUCCESS;
+		media_nandflash_get_stats(&media, &stats);
+	} while (ok && stats.bad_blocks == 0);
+
+	host_check(ok);
+	media_flush(&media);
+	host_check(verify_all());
+
+	for (b = 0; b < WEAR_BLOCKS; b++) {
+		uint32_t count = nand_sim_erase_count(WEAR_FIRST_BLOCK + b);
+		sum += count;
+		if (count < min)
+			min = count;
+		if (count > max)
+			max = count;
+	}
+
+	/* data the partition could take with no amplification and perfect
+	 * wear leveling */
+	capacity = (uint64_t)WEAR_BLOCKS * WEAR_CYCLES * (PAGES_PER_BLOCK - 1) *
+		(PAGE_SIZE / SECTOR_SIZE);
+	media_nandflash_get_stats(&media, &stats);
+	printf("  %.1f MB written by the host (%.1f%% of the ideal), WA %.2f\n",
+		host_sectors * SECTOR_SIZE / 1e6, host_sectors * 100.0 / capacity,
+		(double)stats.pages_written * (PAGE_SIZE / SECTOR_SIZE) /
+		stats.sectors_written);
+	printf("  erase counts min %u avg %.1f max %u\n",
+		min, (double)sum / WEAR_BLOCKS, max);
+	host_check(max - min <= 80);
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	host_init();
+
+	check_consistency();
+	bench_throughput();
+	bench_endurance();
+
+	return host_report("nand_ftl");
+}
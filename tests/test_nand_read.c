@@ -0,0 +1,393 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Pipelined NAND page reads (nand_ecc_read_pages()) on the simulated
+ *  device: data and error reporting compared with nand_ecc_read_page() for
+ *  both buffer layouts, with and without READ CACHE, with correctable and
+ *  uncorrectable bit flips, aborted sequences and erased pages; then the
+ *  read throughput of the serial and pipelined sequences in virtual time.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "chip.h"
+
+#include "nvm/nand/nand_flash.h"
+#include "nvm/nand/nand_flash_ecc.h"
+#include "nvm/nand/nand_flash_onfi.h"
+#include "nvm/nand/nand_flash_raw.h"
+#include "nvm/nand/pmecc.h"
+
+#include "host.h"
+#include "nand_sim.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define PAGE_SIZE       2048
+#define SPARE_SIZE      64
+#define PAGES_PER_BLOCK 64
+#define SECTOR_SIZE     512
+#define SECTORS         (PAGE_SIZE / SECTOR_SIZE)
+#define ECC_T           8
+
+#define TEST_BLOCKS     4
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+/** Pages reported to the callback */
+struct _read_ctx {
+	uint16_t block;
+	uint16_t next_page;
+	int abort_page;
+	unsigned reported;
+	unsigned out_of_order;
+	unsigned errors;
+	unsigned mismatches;
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static const struct _nand_flash_model _model = {
+	.device_id = 0x73,
+	.data_bus_width = 8,
+	.device_size = 16,
+	.page_size = PAGE_SIZE,
+	.spare_size = SPARE_SIZE,
+	.block_size = PAGES_PER_BLOCK * PAGE_SIZE,
+};
+
+static struct _nand_flash nand;
+
+static uint8_t expected[TEST_BLOCKS][PAGES_PER_BLOCK][PAGE_SIZE];
+
+/* data followed by the ECC bytes */
+static uint8_t linear[PAGES_PER_BLOCK][PAGE_SIZE + SPARE_SIZE];
+static uint8_t ping_pong[2][PAGE_SIZE + SPARE_SIZE];
+static uint8_t single[PAGE_SIZE + SPARE_SIZE];
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static void setup(bool read_cache)
+{
+	uint8_t rc;
+
+	nand_sim_init(&_model, read_cache);
+	nand_initialize(&nand);
+	rc = nand_raw_initialize(&nand, &_model);
+	host_check(rc == 0);
+	host_check(nand_onfi_device_detect(&nand));
+	host_check(nand_onfi_has_read_cache() == read_cache);
+
+	nand_set_ecc_type(ECC_PMECC);
+	nand_set_dma_enabled(true);
+	rc = pmecc_initialize(0, ECC_T, PAGE_SIZE, SPARE_SIZE, 0, 0);
+	host_check(rc == 0);
+}
+
+/**
+ * \brief Write random pages to the test blocks.
+ */
+static void write_blocks(void)
+{
+	uint16_t block, page;
+	uint32_t i;
+
+	for (block = 0; block < TEST_BLOCKS; block++) {
+		host_check(nand_raw_erase_block(&nand, block + 1) == 0);
+		for (page = 0; page < PAGES_PER_BLOCK; page++) {
+			uint8_t* data = expected[block][page];
+			for (i = 0; i < PAGE_SIZE; i++)
+				data[i] = host_rand();
+			memcpy(single, data, PAGE_SIZE);
+			host_check(nand_ecc_write_page(&nand, block + 1, page,
+					single, NULL) == 0);
+		}
+	}
+}
+
+/**
+ * \brief Flip count distinct bits of a sector, in its data or its ECC
+ * bytes.
+ */
+static void inject(uint16_t block, uint16_t page, uint32_t sector, int count)
+{
+	const uint32_t ecc_bytes = pmecc_get_ecc_bytes_per_page() / SECTORS;
+	const uint32_t ecc_start = PAGE_SIZE + pmecc_get_ecc_start_address() +
+		sector * ecc_bytes;
+	uint32_t bits[2 * ECC_T + 1];
+	int i, k;
+
+	for (i = 0; i < count; i++) {
+		do {
+			if (host_rand() % 16)
+				bits[i] = sector * SECTOR_SIZE * 8 +
+					host_rand() % (SECTOR_SIZE * 8);
+			else
+				bits[i] = ecc_start * 8 +
+					host_rand() % (ecc_bytes * 8);
+			for (k = 0; k < i && bits[k] != bits[i]; k++);
+		} while (k < i);
+		nand_sim_flip(block, page, bits[i]);
+	}
+}
+
+static int _page_read(void* arg, void* arg2)
+{
+	struct _read_ctx* ctx = (struct _read_ctx*)arg;
+	struct _nand_ecc_page_status* status =
+		(struct _nand_ecc_page_status*)arg2;
+
+	ctx->reported++;
+	if (status->block != ctx->block || status->page != ctx->next_page)
+		ctx->out_of_order++;
+	ctx->next_page = status->page + 1;
+
+	if (status->error)
+		ctx->errors++;
+	else if (memcmp(status->data, expected[ctx->block - 1][status->page],
+			PAGE_SIZE))
+		ctx->mismatches++;
+
+	return status->page == ctx->abort_page ? 1 : 0;
+}
+
+static uint8_t read_pages(uint16_t block, uint16_t page, uint16_t count,
+		bool linear_layout, int abort_page, struct _read_ctx* ctx)
+{
+	struct _nand_ecc_read_req req;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->block = block;
+	ctx->next_page = page;
+	ctx->abort_page = abort_page;
+
+	memset(&req, 0, sizeof(req));
+	req.block = block;
+	req.page = page;
+	req.count = count;
+	if (linear_layout) {
+		req.buffer[0] = linear[0];
+		req.buffer[1] = linear[1];
+		req.stride = 2 * sizeof(linear[0]);
+	} else {
+		req.buffer[0] = ping_pong[0];
+		req.buffer[1] = ping_pong[1];
+		req.stride = 0;
+	}
+	callback_set(&req.callback, _page_read, ctx);
+
+	return nand_ecc_read_pages(&nand, &req);
+}
+
+/**
+ * \brief Read whole blocks with correctable errors in both layouts; every
+ * page must be reported in order and match the written data and the serial
+ * read.
+ */
+static void check_correctable(bool read_cache)
+{
+	struct _read_ctx ctx;
+	uint16_t block, page;
+	uint32_t sector;
+	unsigned flipped = 0;
+
+	setup(read_cache);
+	write_blocks();
+
+	for (block = 1; block <= TEST_BLOCKS; block++) {
+		for (page = 0; page < PAGES_PER_BLOCK; page++) {
+			for (sector = 0; sector < SECTORS; sector++) {
+				int count = host_rand() % 3 ? 0 : host_rand() % (ECC_T + 1);
+				inject(block, page, sector, count);
+				flipped += count;
+			}
+		}
+	}
+
+	for (block = 1; block <= TEST_BLOCKS; block++) {
+		bool linear_layout = block & 1;
+		uint8_t rc;
+
+		rc = read_pages(block, 0, PAGES_PER_BLOCK, linear_layout, -1, &ctx);
+		host_check(rc == 0);
+		host_check(ctx.reported == PAGES_PER_BLOCK);
+		host_check(ctx.out_of_order == 0);
+		host_check(ctx.errors == 0);
+		host_check(ctx.mismatches == 0);
+
+		if (linear_layout) {
+			for (page = 0; page < PAGES_PER_BLOCK; page++) {
+				rc = nand_ecc_read_page(&nand, block, page, single, NULL);
+				host_check(rc == 0);
+				host_check(!memcmp(single, linear[page], PAGE_SIZE));
+			}
+		}
+
+		/* partial sequences, starting inside the block */
+		rc = read_pages(block, 7, 1, linear_layout, -1, &ctx);
+		host_check(rc == 0 && ctx.reported == 1 && ctx.mismatches == 0);
+		rc = read_pages(block, 61, 3, linear_layout, -1, &ctx);
+		host_check(rc == 0 && ctx.reported == 3 && ctx.mismatches == 0);
+	}
+
+	printf("  read cache %-3s: %u pages, %u flipped bits corrected\n",
+		read_cache ? "on" : "off",
+		TEST_BLOCKS * PAGES_PER_BLOCK * 2, flipped);
+}
+
+/**
+ * \brief An uncorrectable page and an abort from the callback end the
+ * sequence; the device must be usable afterwards.
+ */
+static void check_termination(bool read_cache)
+{
+	struct _read_ctx ctx;
+	uint8_t rc;
+
+	setup(read_cache);
+	write_blocks();
+
+	/* pages after the corrupted one are not reported */
+	inject(2, 5, 1, 2 * ECC_T);
+	rc = read_pages(2, 0, 16, false, -1, &ctx);
+	host_check(rc == NAND_ERROR_CORRUPTEDDATA);
+	host_check(ctx.reported == 6);
+	host_check(ctx.errors == 1);
+	host_check(ctx.mismatches == 0);
+	rc = nand_ecc_read_page(&nand, 2, 5, single, NULL);
+	host_check(rc == NAND_ERROR_CORRUPTEDDATA);
+
+	rc = read_pages(2, 6, 10, true, -1, &ctx);
+	host_check(rc == 0 && ctx.reported == 10 && ctx.mismatches == 0);
+
+	/* abort */
+	rc = read_pages(3, 0, PAGES_PER_BLOCK, true, 3, &ctx);
+	host_check(rc == NAND_ERROR_ABORTED);
+	host_check(ctx.reported == 4);
+	host_check(ctx.errors == 0 && ctx.mismatches == 0);
+
+	rc = read_pages(3, 0, PAGES_PER_BLOCK, false, -1, &ctx);
+	host_check(rc == 0 && ctx.reported == PAGES_PER_BLOCK);
+	host_check(ctx.mismatches == 0);
+
+	/* erased pages read as 0xff without errors */
+	host_check(nand_raw_erase_block(&nand, 4) == 0);
+	memset(expected[3], 0xff, sizeof(expected[3]));
+	rc = read_pages(4, 0, 8, true, -1, &ctx);
+	host_check(rc == 0 && ctx.reported == 8);
+	host_check(ctx.errors == 0 && ctx.mismatches == 0);
+	rc = nand_ecc_read_page(&nand, 4, 0, single, NULL);
+	host_check(rc == 0);
+	host_check(!memcmp(single, expected[3][0], PAGE_SIZE));
+}
+
+/**
+ * \brief Read throughput over a block in virtual time.
+ * \param errors  Flipped bits per sector
+ */
+static void bench(int errors)
+{
+	static const char* const names[] = {
+		"serial", "pipelined", "pipelined + read cache",
+	};
+	double ref = 0;
+	int mode;
+
+	printf("  %d flipped bits per sector:\n", errors);
+
+	for (mode = 0; mode < 3; mode++) {
+		struct _read_ctx ctx;
+		uint64_t start, elapsed;
+		uint16_t page;
+		uint32_t sector;
+		double pages_s;
+
+		setup(mode == 2);
+		write_blocks();
+		for (page = 0; page < PAGES_PER_BLOCK; page++)
+			for (sector = 0; sector < SECTORS; sector++)
+				inject(1, page, sector, errors);
+
+		start = nand_sim_time_ns();
+		if (mode == 0) {
+			for (page = 0; page < PAGES_PER_BLOCK; page++)
+				nand_ecc_read_page(&nand, 1, page, linear[page], NULL);
+		} else {
+			read_pages(1, 0, PAGES_PER_BLOCK, true, -1, &ctx);
+			host_check(ctx.mismatches == 0);
+		}
+		elapsed = nand_sim_time_ns() - start;
+
+		pages_s = PAGES_PER_BLOCK * 1e9 / elapsed;
+		if (mode == 0)
+			ref = pages_s;
+		printf("    %-22s %7.0f pages/s %6.2f MB/s (x%.2f)\n",
+			names[mode], pages_s, pages_s * PAGE_SIZE / 1e6,
+			pages_s / ref);
+	}
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	host_init();
+
+	printf("nand_read: pipelined reads versus single page reads\n");
+	check_correctable(false);
+	check_correctable(true);
+	check_termination(false);
+	check_termination(true);
+
+	printf("nand_read: throughput, tR 25us, 20ns/byte, 40us/corrected sector\n");
+	bench(0);
+	bench(2);
+	bench(ECC_T);
+
+	return host_report("nand_read");
+}
@@ -0,0 +1,545 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  PMECC correction: bit-exact comparison against the original bit-serial
+ *  syndrome computation and Berlekamp-Massey decoder on random error
+ *  patterns, and decoding throughput per number of errors.
+ *
+ *  The PMECC remainders are computed from the injected error pattern and
+ *  loaded in the remainder registers; the error location peripheral is
+ *  preloaded with the injected positions so that pmecc_correction() can
+ *  complete. The sigma polynomial written by the driver is compared with
+ *  the reference decoder and its roots checked against the pattern.
+ *
+ *  The throughput of pmecc_correction() includes the (simulated) error
+ *  location and the bit flips; the reference figure only covers the
+ *  syndromes and sigma.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip.h"
+
+#include "nvm/nand/pmecc.h"
+#include "nvm/nand/pmecc_gf_512.h"
+#include "nvm/nand/pmecc_gf_1024.h"
+
+#include "host.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define REF_NB_ERROR_MAX (ARRAY_SIZE(PMERRLOC->PMERRLOC_EL) + 1)
+
+#define PAGE_SIZE       2048
+#define SPARE_SIZE      224
+#define TRIALS          3000
+#define BENCH_SECTORS   20000
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+/** State of the reference decoder, as in the original driver */
+struct _ref_desc {
+	int32_t tt;
+	int32_t mm;
+	int32_t nn;
+	const int16_t *alpha_to;
+	const int16_t *index_of;
+	int16_t partial_syn[2 * REF_NB_ERROR_MAX];
+	int16_t si[2 * REF_NB_ERROR_MAX];
+	int16_t smu[REF_NB_ERROR_MAX + 2][2 * REF_NB_ERROR_MAX + 1];
+	int16_t lmu[REF_NB_ERROR_MAX + 1];
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static const struct {
+	uint8_t sector_size;   /* 0: 512 bytes, 1: 1024 bytes */
+	uint8_t tt;
+} _configs[] = {
+	{ 0, 2 }, { 0, 4 }, { 0, 8 }, { 0, 12 }, { 0, 24 }, { 0, 32 },
+	{ 1, 24 }, { 1, 32 },
+};
+
+static struct _ref_desc ref;
+
+static uint8_t page[PAGE_SIZE];
+static uint8_t expected[PAGE_SIZE];
+
+/*------------------------------------------------------------------------------
+ *         Reference decoder
+ *------------------------------------------------------------------------------*/
+
+static void ref_substitute(void)
+{
+	int32_t i, j;
+	int16_t *si;
+	int16_t *partial_syn = ref.partial_syn;
+	const int16_t *alpha_to = ref.alpha_to;
+	const int16_t *index_of = ref.index_of;
+
+	memset(ref.si, 0, sizeof(ref.si));
+	si = ref.si;
+
+	for (i = 1; i <= 2 * ref.tt - 1; i = i + 2) {
+		si[i] = 0;
+		for (j = 0; j < ref.mm; j++) {
+			if (partial_syn[i] & ((uint16_t)0x1 << j))
+				si[i] = alpha_to[(i * j)] ^ si[i];
+		}
+	}
+	for (i = 2; i <= 2 * ref.tt; i = i + 2) {
+		j = i / 2;
+		if (si[j] == 0) {
+			si[i] = 0;
+		} else {
+			si[i] = alpha_to[(2 * index_of[si[j]]) % ref.nn];
+		}
+	}
+}
+
+/* Berlekamp-Massey as in the original driver */
+static void ref_get_sigma(void)
+{
+	uint32_t dmu_0_count;
+	int32_t i, j, k;
+	int16_t *lmu = ref.lmu;
+	int16_t *si = ref.si;
+	int16_t tt = ref.tt;
+
+	int32_t mu[REF_NB_ERROR_MAX + 1]; /* mu */
+	int32_t dmu[REF_NB_ERROR_MAX + 1]; /* discrepancy */
+	int32_t delta[REF_NB_ERROR_MAX + 1]; /* delta order */
+	int32_t ro; /* index of largest delta */
+	int32_t largest;
+	int32_t diff;
+
+	dmu_0_count = 0;
+
+	/* -- First Row -- */
+
+	/* Mu */
+	mu[0]  = -1;
+	/* Actually -1/2 */
+	/* Sigma(x) set to 1 */
+
+	for (i = 0; i < (2 * REF_NB_ERROR_MAX + 1); i++)
+		ref.smu[0][i] = 0;
+	ref.smu[0][0] = 1;
+
+	/* discrepancy set to 1 */
+	dmu[0] = 1;
+
+	/* polynom order set to 0 */
+	lmu[0] = 0;
+
+	/* delta set to -1 */
+	delta[0]  = (mu[0] * 2 - lmu[0]) >> 1;
+
+	/* -- Second Row -- */
+
+	/* Mu */
+	mu[1] = 0;
+
+	/* Sigma(x) set to 1 */
+	for (i = 0; i < (2 * REF_NB_ERROR_MAX + 1); i++)
+		ref.smu[1][i] = 0;
+	ref.smu[1][0] = 1;
+
+	/* discrepancy set to S1 */
+	dmu[1] = si[1];
+
+	/* polynom order set to 0 */
+	lmu[1] = 0;
+
+	/* delta set to 0 */
+	delta[1]  = (mu[1] * 2 - lmu[1]) >> 1;
+
+	/* Init the Sigma(x) last row */
+	for (i = 0; i < (2 * REF_NB_ERROR_MAX + 1); i++)
+		ref.smu[tt + 1][i] = 0;
+
+	for (i = 1; i <= tt; i++) {
+		mu[i+1] = i << 1;
+
+		/* Compute Sigma (Mu+1) */
+		/* And L(mu) */
+		/* check if discrepancy is set to 0 */
+		if ( dmu[i] == 0) {
+			dmu_0_count++;
+			if ((tt - (lmu[i] >> 1) - 1) & 0x1) {
+				if (dmu_0_count == (uint32_t)((tt - (lmu[i] >> 1) - 1) / 2) + 2) {
+					for (j = 0; j <= (lmu[i] >> 1) + 1; j++)
+						ref.smu[tt+1][j] = ref.smu[i][j];
+					lmu[tt + 1] = lmu[i];
+					return;
+				}
+			} else {
+				if (dmu_0_count == (uint32_t)((tt - (lmu[i] >> 1) - 1) / 2) + 1) {
+					for (j = 0; j <= (lmu[i] >> 1) + 1; j++)
+						ref.smu[tt + 1][j] = ref.smu[i][j];
+					lmu[tt + 1] = lmu[i];
+					return;
+				}
+			}
+
+			/* copy polynom */
+			for (j = 0; j <= (lmu[i] >> 1); j++)
+				ref.smu[i + 1][j] = ref.smu[i][j];
+
+			/* copy previous polynom order to the next */
+			lmu[i + 1] = lmu[i];
+		} else {
+			/* find largest delta with dmu != 0 */
+			ro = 0;
+			largest = -1;
+			for (j = 0; j < i; j++) {
+				if (dmu[j]) {
+					if (delta[j] > largest) {
+						largest = delta[j];
+						ro = j;
+					}
+				}
+			}
+
+			/* compute difference */
+			diff = (mu[i] - mu[ro]);
+
+			/* Compute degree of the new smu polynomial */
+			if ((lmu[i] >> 1) > ((lmu[ro] >> 1) + diff))
+				lmu[i + 1] = lmu[i];
+			else
+				lmu[i + 1] = ((lmu[ro] >> 1) + diff) * 2;
+
+			/* Init smu[i+1] with 0 */
+			for (k = 0; k < (2 * REF_NB_ERROR_MAX + 1); k++)
+				ref.smu[i+1][k] = 0;
+
+			/* Compute smu[i+1] */
+			for (k = 0; k <= (lmu[ro] >> 1); k++) {
+				if (ref.smu[ro][k] && dmu[i])
+					ref.smu[i + 1][k + diff] = ref.alpha_to[(ref.index_of[dmu[i]] +
+							(ref.nn - ref.index_of[dmu[ro]]) +
+							ref.index_of[ref.smu[ro][k]]) % ref.nn];
+			}
+			for (k = 0; k <= (lmu[i] >> 1); k++)
+				ref.smu[i+1][k] ^= ref.smu[i][k];
+		}
+
+		/*************************************************/
+		/*      End Compute Sigma (Mu+1)                 */
+		/*      And L(mu)                                */
+		/*************************************************/
+		/* In either case compute delta */
+		delta[i + 1] = (mu[i + 1] * 2 - lmu[i + 1]) >> 1;
+
+		/* Do not compute discrepancy for the last iteration */
+		if (i < tt) {
+			for (k = 0 ; k <= (lmu[i + 1] >> 1); k++) {
+				if (k == 0)
+					dmu[i + 1] = si[2 * (i - 1) + 3];
+				/* check if one operand of the multiplier is null, its index is -1 */
+				else if (ref.smu[i+1][k] && si[2 * (i - 1) + 3 - k])
+					dmu[i + 1] = ref.alpha_to[(ref.index_of[ref.smu[i + 1][k]] +
+							ref.index_of[si[2 * (i - 1) + 3 - k]]) % ref.nn] ^ dmu[i + 1];
+			}
+		}
+	}
+}
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static int16_t gf_pow(int32_t e)
+{
+	e %= ref.nn;
+	if (e < 0)
+		e += ref.nn;
+	return ref.alpha_to[e];
+}
+
+/**
+ * \brief Find the remainder r (mm bits) whose evaluation at alpha^syn is
+ * value, i.e. the XOR of alpha^(syn*j) over the bits j set in r.
+ */
+static bool solve_remainder(int32_t syn, int16_t value, uint16_t *rem)
+{
+	uint16_t basis[16], comb[16];
+	uint16_t v, c;
+	int32_t j, bit;
+
+	memset(basis, 0, sizeof(basis));
+	for (j = 0; j < ref.mm; j++) {
+		v = gf_pow(syn * j);
+		c = 1u << j;
+		for (bit = ref.mm - 1; bit >= 0 && v; bit--) {
+			if (!(v & (1u << bit)))
+				continue;
+			if (!basis[bit]) {
+				basis[bit] = v;
+				comb[bit] = c;
+				break;
+			}
+			v ^= basis[bit];
+			c ^= comb[bit];
+		}
+	}
+
+	v = value;
+	c = 0;
+	for (bit = ref.mm - 1; bit >= 0; bit--) {
+		if ((v & (1u << bit)) && basis[bit]) {
+			v ^= basis[bit];
+			c ^= comb[bit];
+		}
+	}
+	*rem = c;
+	return v == 0;
+}
+
+/**
+ * \brief Pick count distinct bit positions among nbits.
+ */
+static void pick_positions(uint32_t *pos, int count, uint32_t nbits)
+{
+	int i, k;
+
+	for (i = 0; i < count; i++) {
+		do {
+			pos[i] = host_rand() % nbits;
+			for (k = 0; k < i && pos[k] != pos[i]; k++);
+		} while (k < i);
+	}
+}
+
+/**
+ * \brief Load the PMECC remainders of a sector and the error location
+ * results for the error pattern pos[0..count-1].
+ */
+static void load_sector(uint32_t sector, const uint32_t *pos, int count)
+{
+	volatile int16_t *remainder =
+		(volatile int16_t*)&PMECC->PMECC_REM[sector];
+	volatile uint32_t *el = (volatile uint32_t*)PMERRLOC->PMERRLOC_EL;
+	int32_t i;
+	int k;
+
+	for (i = 0; i < ref.tt; i++) {
+		int32_t syn = 2 * i + 1;
+		int16_t s = 0;
+		uint16_t rem;
+
+		for (k = 0; k < count; k++)
+			s ^= gf_pow(syn * (int32_t)pos[k]);
+		if (!solve_remainder(syn, s, &rem)) {
+			printf("no remainder for syndrome %d\n", (int)syn);
+			exit(2);
+		}
+		remainder[i] = rem;
+		ref.partial_syn[syn] = rem;
+	}
+
+	for (k = 0; k < count && k < (int)ARRAY_SIZE(PMERRLOC->PMERRLOC_EL); k++)
+		el[k] = pos[k] + 1;
+	*(volatile uint32_t*)&PMERRLOC->PMERRLOC_ISR = PMERRLOC_ISR_DONE |
+		(((uint32_t)count << PMERRLOC_ISR_ERR_CNT_Pos) & PMERRLOC_ISR_ERR_CNT_Msk);
+}
+
+/**
+ * \brief Evaluate the sigma polynomial written to PMERRLOC at alpha^e.
+ */
+static int16_t eval_sigma(int32_t degree, int32_t e)
+{
+	int16_t sum = 0;
+	int32_t k;
+
+	for (k = 0; k <= degree; k++) {
+		int16_t coef = PMERRLOC->PMERRLOC_SIGMA[k];
+		if (coef)
+			sum ^= gf_pow(ref.index_of[coef] + k * e);
+	}
+	return sum;
+}
+
+static void setup(uint8_t sector_size, uint8_t tt)
+{
+	uint8_t rc;
+
+	rc = pmecc_initialize(sector_size, tt, PAGE_SIZE, SPARE_SIZE, 0, 0);
+	host_check(rc == 0);
+
+	memset(&ref, 0, sizeof(ref));
+	ref.tt = tt;
+	ref.mm = sector_size ? 14 : 13;
+	ref.nn = (1 << ref.mm) - 1;
+	if (sector_size)
+		pmecc_get_gf_1024_tables(&ref.alpha_to, &ref.index_of);
+	else
+		pmecc_get_gf_512_tables(&ref.alpha_to, &ref.index_of);
+}
+
+static void check_config(uint8_t sector_size, uint8_t tt)
+{
+	const uint32_t sector_bytes = sector_size ? 1024 : 512;
+	const uint32_t nbits = sector_bytes * 8 + tt * (sector_size ? 14 : 13);
+	uint32_t pos[40];
+	int trial, count;
+	unsigned mismatches = 0;
+
+	setup(sector_size, tt);
+
+	for (trial = 0; trial < TRIALS; trial++) {
+		struct _pmecc_remainders saved;
+		uint32_t sector = host_rand() % (PAGE_SIZE / sector_bytes);
+		uint8_t *base = page + sector * sector_bytes;
+		int32_t degree, k;
+		uint32_t rc;
+
+		count = 1 + host_rand() % (tt + 2);
+		pick_positions(pos, count, nbits);
+
+		for (k = 0; k < PAGE_SIZE; k++)
+			expected[k] = host_rand();
+		memcpy(page, expected, sizeof(page));
+		for (k = 0; k < count; k++)
+			if (pos[k] < sector_bytes * 8)
+				base[pos[k] >> 3] ^= 1 << (pos[k] & 7);
+
+		load_sector(sector, pos, count);
+		ref_substitute();
+		ref_get_sigma();
+
+		/* alternately decode from the registers and from saved
+		 * remainders */
+		if (trial & 1) {
+			pmecc_save_remainders(1u << sector, &saved);
+			memset((void*)&PMECC->PMECC_REM[sector], 0,
+					sizeof(PMECC->PMECC_REM[sector]));
+			rc = pmecc_correction_saved(&saved, (uint32_t)page);
+		} else {
+			rc = pmecc_correction(1u << sector, (uint32_t)page);
+		}
+
+		/* sigma must match the reference decoder bit for bit */
+		degree = ref.lmu[ref.tt + 1] >> 1;
+		for (k = 0; k <= degree; k++)
+			if (PMERRLOC->PMERRLOC_SIGMA[k] !=
+					(uint32_t)(uint16_t)ref.smu[ref.tt + 1][k])
+				break;
+		if (k <= degree ||
+				(PMERRLOC->PMERRLOC_CFG & PMERRLOC_CFG_ERRNUM_Msk) !=
+				PMERRLOC_CFG_ERRNUM(degree))
+			mismatches++;
+
+		if (count <= tt) {
+			host_check(degree == count);
+			for (k = 0; k < count; k++)
+				host_check(eval_sigma(degree, -(int32_t)pos[k]) == 0);
+			host_check(rc == 0);
+			host_check(memcmp(page, expected, sizeof(page)) == 0);
+		}
+	}
+
+	host_check(mismatches == 0);
+	printf("  %4u-byte sectors, t=%2u: %d patterns, %u mismatches\n",
+		(unsigned)sector_bytes, tt, TRIALS, mismatches);
+}
+
+static void bench_config(uint8_t sector_size, uint8_t tt)
+{
+	const uint32_t sector_bytes = sector_size ? 1024 : 512;
+	const uint32_t nbits = sector_bytes * 8 + tt * (sector_size ? 14 : 13);
+	static const int counts[] = { 1, 2, 3, 4, 8, 12, 24, 32 };
+	uint32_t pos[40];
+	unsigned i;
+
+	setup(sector_size, tt);
+	printf("  %4u-byte sectors, t=%2u:\n", (unsigned)sector_bytes, tt);
+
+	for (i = 0; i < ARRAY_SIZE(counts) && counts[i] <= tt; i++) {
+		uint64_t start, new_ns, ref_ns;
+		int n;
+
+		pick_positions(pos, counts[i], nbits);
+		load_sector(0, pos, counts[i]);
+
+		start = host_time_ns();
+		for (n = 0; n < BENCH_SECTORS; n++) {
+			ref_substitute();
+			ref_get_sigma();
+		}
+		ref_ns = host_time_ns() - start;
+
+		start = host_time_ns();
+		for (n = 0; n < BENCH_SECTORS; n++)
+			pmecc_correction(1, (uint32_t)page);
+		new_ns = host_time_ns() - start;
+
+		printf("    %2d errors: %9.0f sectors/s (reference %9.0f sectors/s)\n",
+			counts[i], BENCH_SECTORS * 1e9 / new_ns,
+			BENCH_SECTORS * 1e9 / ref_ns);
+	}
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	unsigned i;
+
+	host_init();
+
+	printf("pmecc: sigma versus the reference decoder\n");
+	for (i = 0; i < ARRAY_SIZE(_configs); i++)
+		check_config(_configs[i].sector_size, _configs[i].tt);
+
+	printf("pmecc: decoding throughput\n");
+	for (i = 0; i < ARRAY_SIZE(_configs); i++)
+		bench_config(_configs[i].sector_size, _configs[i].tt);
+
+	return host_report("pmecc");
+}
@@ -0,0 +1,450 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Unit tests of the ring buffer (utils/ring.c): single and bulk accesses
+ *  against a model, wraparound of the buffer and of the free-running
+ *  indexes, zero-copy reserve/commit and acquire/release, watermarks, and a
+ *  producer and a consumer running concurrently in two threads. Reports the
+ *  throughput of the ring and of the RING_* index macros it replaces.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include "compiler.h"
+#include "ring.h"
+
+#include "host.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define RING_SIZE       256
+
+#define MODEL_OPS       200000
+
+/** Elements exchanged by the concurrent tests */
+#define THREAD_ELEMS    (4 * 1000 * 1000)
+
+/** Bytes moved by the single-thread benchmarks */
+#define BENCH_BYTES     (256 * 1024 * 1024)
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+/** Element with an odd size, to catch element size arithmetic errors */
+struct _elem3 {
+	uint8_t b[3];
+};
+
+struct _thread_arg {
+	struct _ring* ring;
+	bool zero_copy;
+	uint32_t errors;
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static uint8_t storage[RING_SIZE * 8];
+
+static uint8_t in[RING_SIZE * 2 * 8];
+static uint8_t out[RING_SIZE * 2 * 8];
+
+/** Model of the content: sequence numbers of the queued elements */
+static uint32_t model_head, model_tail;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static uint32_t xorshift(uint32_t* state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/** Element number n, elem_size bytes */
+static void make_elem(uint8_t* elem, uint32_t n, uint32_t elem_size)
+{
+	uint32_t i;
+
+	for (i = 0; i < elem_size; i++)
+		elem[i] = (uint8_t)(n * 7 + i * 13 + (n >> 8));
+}
+
+static bool check_elem(const uint8_t* elem, uint32_t n, uint32_t elem_size)
+{
+	uint8_t expected[8];
+
+	make_elem(expected, n, elem_size);
+	return memcmp(elem, expected, elem_size) == 0;
+}
+
+static void test_init(void)
+{
+	struct _ring ring;
+	uint32_t v = 0;
+
+	printf("ring: init, single elements, full and empty\n");
+
+	host_check(ring_init(&ring, storage, 0, 1) == -EINVAL);
+	host_check(ring_init(&ring, storage, 12, 1) == -EINVAL);
+	host_check(ring_init(&ring, storage, 16, 0) == -EINVAL);
+	host_check(ring_init(&ring, NULL, 16, 1) == -EINVAL);
+	host_check(ring_init(&ring, storage, 1, 4) == 0);
+	host_check(ring_push(&ring, &v));
+	host_check(!ring_push(&ring, &v));
+	host_check(ring_init(&ring, storage, 16, 4) == 0);
+
+	host_check(ring_is_empty(&ring) && ring_space(&ring) == 16);
+	host_check(!ring_pop(&ring, &v) && !ring_peek(&ring, &v));
+
+	/* all the slots are usable */
+	for (v = 0; v < 16; v++)
+		host_check(ring_push(&ring, &v));
+	host_check(ring_is_full(&ring) && ring_count(&ring) == 16);
+	host_check(!ring_push(&ring, &v));
+	host_check(ring_push_n(&ring, &v, 1) == 0);
+
+	host_check(ring_peek(&ring, &v) && v == 0);
+	for (v = 0; v < 16; v++) {
+		uint32_t x = ~0u;
+		host_check(ring_pop(&ring, &x) && x == v);
+	}
+	host_check(ring_is_empty(&ring));
+	host_check(ring.peak == 16);
+
+	ring_reset(&ring);
+	host_check(ring_is_empty(&ring) && ring.peak == 0);
+}
+
+/** Random bulk and single accesses checked against the model */
+static void test_model(uint32_t elem_size, uint32_t start)
+{
+	struct _ring ring;
+	uint32_t i, j, n, done;
+	const void* rptr;
+	void* wptr;
+	bool ok = true;
+
+	host_check(ring_init(&ring, storage, RING_SIZE, elem_size) == 0);
+
+	/* start close to the wraparound of the free-running indexes */
+	ring.head = ring.tail = start;
+	model_head = model_tail = 0;
+
+	for (i = 0; i < MODEL_OPS; i++) {
+		switch (host_rand() % 6) {
+		case 0:
+			n = host_rand() % (2 * RING_SIZE);
+			for (j = 0; j < n; j++)
+				make_elem(in + j * elem_size, model_head + j, elem_size);
+			done = ring_push_n(&ring, in, n);
+			if (done != min_u32(n, RING_SIZE - (model_head - model_tail)))
+				ok = false;
+			model_head += done;
+			break;
+		case 1:
+			n = host_rand() % (2 * RING_SIZE);
+			done = ring_pop_n(&ring, out, n);
+			if (done != min_u32(n, model_head - model_tail))
+				ok = false;
+			for (j = 0; j < done; j++)
+				if (!check_elem(out + j * elem_size, model_tail + j, elem_size))
+					ok = false;
+			model_tail += done;
+			break;
+		case 2:
+			make_elem(in, model_head, elem_size);
+			if (ring_push(&ring, in))
+				model_head++;
+			else if (model_head - model_tail != RING_SIZE)
+				ok = false;
+			break;
+		case 3:
+			if (ring_pop(&ring, out)) {
+				if (!check_elem(out, model_tail, elem_size))
+					ok = false;
+				model_tail++;
+			} else if (model_head != model_tail) {
+				ok = false;
+			}
+			break;
+		case 4:
+			/* contiguous free area, up to the end of the buffer */
+			n = ring_write_reserve(&ring, &wptr);
+			if (n == 0 && model_head - model_tail != RING_SIZE)
+				ok = false;
+			if (n > RING_SIZE - (model_head - model_tail))
+				ok = false;
+			if ((uint8_t*)wptr + n * elem_size > storage + RING_SIZE * elem_size)
+				ok = false;
+			n = n ? host_rand() % (n + 1) : 0;
+			for (j = 0; j < n; j++)
+				make_elem((uint8_t*)wptr + j * elem_size, model_head + j,
+					elem_size);
+			ring_write_commit(&ring, n);
+			model_head += n;
+			break;
+		case 5:
+			n = ring_read_acquire(&ring, &rptr);
+			if (n == 0 && model_head != model_tail)
+				ok = false;
+			if (n > model_head - model_tail)
+				ok = false;
+			n = n ? host_rand() % (n + 1) : 0;
+			for (j = 0; j < n; j++)
+				if (!check_elem((const uint8_t*)rptr + j * elem_size,
+						model_tail + j, elem_size))
+					ok = false;
+			ring_read_release(&ring, n);
+			model_tail += n;
+			break;
+		}
+		if (ring_count(&ring) != model_head - model_tail)
+			ok = false;
+	}
+	host_check(ok);
+	printf("  %u-byte elements, indexes from 0x%08x: %u elements through\n",
+		(unsigned)elem_size, (unsigned)start, (unsigned)model_tail);
+}
+
+static void test_watermarks(void)
+{
+	struct _ring ring;
+	uint8_t v = 0;
+	uint32_t i;
+
+	printf("ring: watermarks\n");
+
+	host_check(ring_init(&ring, storage, 64, 1) == 0);
+	ring_set_watermarks(&ring, 8, 48);
+	host_check(ring_is_low(&ring) && !ring_is_high(&ring));
+	for (i = 0; i < 8; i++)
+		ring_push(&ring, &v);
+	host_check(ring_is_low(&ring));
+	ring_push(&ring, &v);
+	host_check(!ring_is_low(&ring) && !ring_is_high(&ring));
+	for (i = 9; i < 47; i++)
+		ring_push(&ring, &v);
+	host_check(!ring_is_high(&ring));
+	ring_push(&ring, &v);
+	host_check(ring_is_high(&ring));
+	ring_pop_n(&ring, in, 40);
+	host_check(ring_is_low(&ring) && ring.peak == 48);
+}
+
+static void* producer(void* arg)
+{
+	struct _thread_arg* t = (struct _thread_arg*)arg;
+	uint32_t seq = 0, seed = 0x1234567u, buf[64], i, n, room;
+	uint32_t* wptr;
+
+	while (seq < THREAD_ELEMS) {
+		if (t->zero_copy) {
+			room = ring_write_reserve(t->ring, (void**)&wptr);
+			n = min_u32(room, 1 + xorshift(&seed) % 64);
+			n = min_u32(n, THREAD_ELEMS - seq);
+			for (i = 0; i < n; i++)
+				wptr[i] = seq + i;
+			ring_write_commit(t->ring, n);
+		} else {
+			n = min_u32(1 + xorshift(&seed) % 64, THREAD_ELEMS - seq);
+			for (i = 0; i < n; i++)
+				buf[i] = seq + i;
+			n = ring_push_n(t->ring, buf, n);
+		}
+		/* let the other thread run when there is a single core */
+		if (n == 0)
+			sched_yield();
+		seq += n;
+	}
+	return NULL;
+}
+
+static void* consumer(void* arg)
+{
+	struct _thread_arg* t = (struct _thread_arg*)arg;
+	uint32_t seq = 0, seed = 0x7654321u, buf[64], i, n;
+	const uint32_t* rptr;
+
+	while (seq < THREAD_ELEMS) {
+		if (t->zero_copy) {
+			n = ring_read_acquire(t->ring, (const void**)&rptr);
+			n = min_u32(n, 1 + xorshift(&seed) % 64);
+			for (i = 0; i < n; i++)
+				if (rptr[i] != seq + i)
+					t->errors++;
+			ring_read_release(t->ring, n);
+		} else {
+			n = ring_pop_n(t->ring, buf, 1 + xorshift(&seed) % 64);
+			for (i = 0; i < n; i++)
+				if (buf[i] != seq + i)
+					t->errors++;
+		}
+		if (n == 0)
+			sched_yield();
+		seq += n;
+	}
+	return NULL;
+}
+
+/** One producer and one consumer thread exchanging sequence numbers */
+static void test_threads(bool zero_copy)
+{
+	struct _ring ring;
+	struct _thread_arg arg = { &ring, zero_copy, 0 };
+	pthread_t prod, cons;
+	uint64_t t0, t1;
+
+	host_check(ring_init(&ring, storage, RING_SIZE, sizeof(uint32_t)) == 0);
+
+	t0 = host_time_ns();
+	host_check(pthread_create(&cons, NULL, consumer, &arg) == 0);
+	host_check(pthread_create(&prod, NULL, producer, &arg) == 0);
+	pthread_join(prod, NULL);
+	pthread_join(cons, NULL);
+	t1 = host_time_ns();
+
+	host_check(arg.errors == 0);
+	host_check(ring_is_empty(&ring));
+	printf("  %-28s %7.1f Melem/s, %u errors\n",
+		zero_copy ? "reserve/commit, 2 threads" : "push_n/pop_n, 2 threads",
+		THREAD_ELEMS * 1e3 / (t1 - t0), (unsigned)arg.errors);
+}
+
+static void bench_bulk(uint32_t chunk)
+{
+	struct _ring ring;
+	uint64_t t0, t1, bytes = 0;
+
+	ring_init(&ring, storage, RING_SIZE * 8, 1);
+	t0 = host_time_ns();
+	while (bytes < BENCH_BYTES) {
+		ring_push_n(&ring, in, chunk);
+		bytes += ring_pop_n(&ring, out, chunk);
+	}
+	t1 = host_time_ns();
+	printf("  push_n/pop_n %4u bytes      %7.1f MB/s\n", (unsigned)chunk,
+		bytes * 1e3 / (t1 - t0));
+}
+
+static void bench_single(void)
+{
+	struct _ring ring;
+	uint64_t t0, t1, i;
+	uint8_t v = 0;
+
+	ring_init(&ring, storage, RING_SIZE, 1);
+	t0 = host_time_ns();
+	for (i = 0; i < BENCH_BYTES / 16; i++) {
+		ring_push(&ring, &v);
+		ring_pop(&ring, &v);
+	}
+	t1 = host_time_ns();
+	printf("  push/pop 1 byte              %7.1f MB/s\n",
+		BENCH_BYTES / 16 * 1e3 / (t1 - t0));
+}
+
+/** The byte FIFO the drivers built with the RING_* macros */
+static void bench_macros(void)
+{
+	static volatile uint8_t fifo[RING_SIZE];
+	volatile int head = 0, tail = 0;
+	uint64_t t0, t1, i;
+	uint8_t v = 0;
+
+	t0 = host_time_ns();
+	for (i = 0; i < BENCH_BYTES / 16; i++) {
+		if (RING_SPACE(head, tail, RING_SIZE)) {
+			fifo[head] = v;
+			RING_INC(head, RING_SIZE);
+		}
+		if (RING_CNT(head, tail, RING_SIZE)) {
+			v += fifo[tail];
+			RING_INC(tail, RING_SIZE);
+		}
+	}
+	t1 = host_time_ns();
+	printf("  RING_* macros 1 byte         %7.1f MB/s\n",
+		BENCH_BYTES / 16 * 1e3 / (t1 - t0));
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	host_init();
+
+	test_init();
+
+	printf("ring: random accesses against a model\n");
+	test_model(1, 0);
+	test_model(sizeof(struct _elem3), 0);
+	test_model(8, 0);
+	test_model(4, 0xffffff00u);
+	test_model(sizeof(struct _elem3), 0x7fffffc0u);
+
+	test_watermarks();
+
+	printf("ring: concurrent producer and consumer\n");
+	test_threads(false);
+	test_threads(true);
+
+	printf("ring: single-thread throughput\n");
+	bench_macros();
+	bench_single();
+	bench_bulk(16);
+	bench_bulk(256);
+	bench_bulk(1024);
+
+	return host_report("ring");
+}
@@ -0,0 +1,386 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Timer wheel (timer_wheel.c) on the simulated system timer.
+ *
+ *  Random sequences of adds, cancels and time steps, with callbacks
+ *  re-adding or cancelling their own event, check that no callback is
+ *  early, late by more than a wheel tick, or called after a cancel, and
+ *  that periodic events keep their period. Delays cover every level of
+ *  the wheel, up to an hour.
+ *
+ *  The benchmark loads the wheel with millions of one-shot events and
+ *  reports the host cost of add, cancel and expiry against the number of
+ *  pending events, and the distribution of the lateness of one-shot and
+ *  periodic callbacks, with the number of alarms programmed.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "compiler.h"
+#include "timer.h"
+#include "timer_wheel.h"
+
+#include "host.h"
+#include "host_timer.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define RANDOM_EVENTS   20000
+#define RANDOM_STEPS    1000000
+
+#define SCALE_EVENTS    (2 * 1024 * 1024)
+
+#define PERIODIC_EVENTS 1000
+#define PERIODIC_NS     500000000ull
+#define PERIODIC_SAMPLES (8 * 1024 * 1024)
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+struct _sim_event {
+	struct _timer_event event;
+	bool pending;           /* as seen by the test */
+	uint32_t period_us;
+	uint64_t due_ns;        /* not to be called before */
+	uint64_t last_ns;       /* previous call of a periodic event */
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static struct _sim_event sim_events[RANDOM_EVENTS];
+
+static struct {
+	uint64_t calls;
+	uint32_t early;
+	uint32_t late;
+	uint32_t not_pending;
+	uint32_t period_errors;
+} sim;
+
+static uint64_t tick_ns;
+
+static struct _timer_event* scale_events;
+static uint64_t* samples;
+static uint32_t sample_count;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/** Log-uniform delay between 1 us and max_us */
+static uint32_t random_delay(uint32_t max_us)
+{
+	uint32_t bits = 1 + host_rand() % (32 - __builtin_clz(max_us));
+	uint32_t delay = host_rand() & ((1u << (bits - 1)) * 2 - 1);
+
+	return delay < 1 ? 1 : (delay > max_us ? max_us : delay);
+}
+
+static uint32_t random_period(void)
+{
+	return 50 + host_rand() % 100000;
+}
+
+static void sim_add(struct _sim_event* e, uint32_t delay_us, uint32_t period_us)
+{
+	timer_wheel_add(&e->event, delay_us, period_us);
+	e->pending = true;
+	e->period_us = period_us;
+	e->due_ns = host_timer_ns() + delay_us * 1000ull;
+	e->last_ns = 0;
+}
+
+static void sim_cancel(struct _sim_event* e)
+{
+	timer_wheel_cancel(&e->event);
+	e->pending = false;
+}
+
+static int sim_callback(void* arg, void* arg2)
+{
+	struct _sim_event* e = (struct _sim_event*)arg;
+	uint64_t now = host_timer_ns();
+	int64_t error;
+
+	sim.calls++;
+	if (arg2 != &e->event || !e->pending)
+		sim.not_pending++;
+	/* 1 ns of slack for the conversion of raw ticks */
+	if (now + 1 < e->due_ns)
+		sim.early++;
+
+	if (e->period_us) {
+		/* each period is rounded up to a raw tick, and each call to the
+		 * next wheel tick */
+		if (e->last_ns) {
+			error = (int64_t)(now - e->last_ns) - e->period_us * 1000ll;
+			if (error <= -(int64_t)tick_ns || error > (int64_t)tick_ns + 100)
+				sim.period_errors++;
+		}
+		e->last_ns = now;
+	} else {
+		if (now > e->due_ns + tick_ns + 100)
+			sim.late++;
+		e->pending = false;
+	}
+
+	/* callbacks may re-add or cancel their own event */
+	switch (host_rand() % 16) {
+	case 0:
+		sim_add(e, random_delay(100000), 0);
+		break;
+	case 1:
+		sim_add(e, random_delay(100000), random_period());
+		break;
+	case 2:
+		if (e->period_us)
+			sim_cancel(e);
+		break;
+	}
+	return 0;
+}
+
+static void test_random(void)
+{
+	struct _timer_wheel_stats stats;
+	struct _sim_event* e;
+	uint32_t i, op, pending = 0;
+	bool left = false;
+
+	printf("timer_wheel: random adds, cancels and time steps\n");
+
+	for (i = 0; i < RANDOM_EVENTS; i++)
+		timer_event_init(&sim_events[i].event, sim_callback, &sim_events[i]);
+
+	for (i = 0; i < RANDOM_STEPS; i++) {
+		e = &sim_events[host_rand() % RANDOM_EVENTS];
+		op = host_rand() % 16;
+		if (op < 6)
+			sim_add(e, random_delay(host_rand() % 8 ? 1000000 : 3600000000u), 0);
+		else if (op < 8)
+			sim_add(e, random_delay(1000000), random_period());
+		else if (op < 11)
+			sim_cancel(e);
+		else
+			host_timer_advance(host_rand() % 2000);
+		if (e->pending != timer_event_pending(&e->event))
+			left = true;
+	}
+
+	/* Stop the periodic events, the one-shot ones then all run */
+	for (i = 0; i < RANDOM_EVENTS; i++)
+		if (sim_events[i].period_us)
+			sim_cancel(&sim_events[i]);
+	while (host_timer_run()) {
+		for (i = 0; i < RANDOM_EVENTS; i++)
+			if (sim_events[i].period_us)
+				sim_cancel(&sim_events[i]);
+	}
+	for (i = 0; i < RANDOM_EVENTS; i++)
+		if (sim_events[i].pending || timer_event_pending(&sim_events[i].event))
+			pending++;
+
+	timer_wheel_get_stats(&stats);
+	host_check(!left);
+	host_check(pending == 0);
+	host_check(sim.early == 0 && sim.late == 0 && sim.not_pending == 0);
+	host_check(sim.period_errors == 0);
+	host_check(stats.fired == sim.calls);
+	host_check(stats.overruns == 0);
+	printf("  %llu callbacks over %.0f s, late by %u us at most "
+		"(wheel tick %u ns)\n", (unsigned long long)sim.calls,
+		host_timer_ns() / 1e9, (unsigned)stats.late_max,
+		(unsigned)stats.resolution);
+}
+
+static int scale_callback(void* arg, void* arg2)
+{
+	struct _timer_event* event = (struct _timer_event*)arg2;
+
+	if (sample_count < SCALE_EVENTS)
+		samples[sample_count++] = timer_get_raw_tick() - event->deadline;
+	return 0;
+}
+
+static void print_summary(const char* name, uint64_t* values, uint32_t count)
+{
+	struct _host_summary s;
+
+	host_summarize(values, count, &s);
+	printf("  %-22s p50 %6.2f us, p99 %6.2f us, max %6.2f us\n", name,
+		host_timer_ticks_to_ns(s.p50) / 1e3,
+		host_timer_ticks_to_ns(s.p99) / 1e3,
+		host_timer_ticks_to_ns(s.max) / 1e3);
+}
+
+/** Host time of one add, with 'pending' events already in the wheel */
+static void bench_add(uint32_t pending)
+{
+	uint32_t i, n = 100000;
+	uint64_t t0, t1, t2;
+
+	for (i = 0; i < pending; i++)
+		timer_wheel_add(&scale_events[i], random_delay(100000000), 0);
+	t0 = host_time_ns();
+	for (i = 0; i < n; i++)
+		timer_wheel_add(&scale_events[pending + i],
+				random_delay(100000000), 0);
+	t1 = host_time_ns();
+	for (i = 0; i < n; i++)
+		timer_wheel_cancel(&scale_events[pending + i]);
+	t2 = host_time_ns();
+	for (i = 0; i < pending; i++)
+		timer_wheel_cancel(&scale_events[i]);
+
+	printf("  %8u pending: add %5.1f ns, cancel %5.1f ns\n",
+		(unsigned)pending, (double)(t1 - t0) / n, (double)(t2 - t1) / n);
+}
+
+static void test_scale(void)
+{
+	static const uint32_t pending[] = { 1000, 100000, SCALE_EVENTS - 100000 };
+	struct _timer_wheel_stats stats;
+	uint32_t i, alarms = 0;
+	uint64_t t0, t1, t2, start_ns;
+
+	printf("timer_wheel: %u one-shot events\n", SCALE_EVENTS);
+
+	scale_events = calloc(SCALE_EVENTS, sizeof(*scale_events));
+	samples = calloc(PERIODIC_SAMPLES, sizeof(*samples));
+	for (i = 0; i < SCALE_EVENTS; i++)
+		timer_event_init(&scale_events[i], scale_callback, NULL);
+
+	for (i = 0; i < ARRAY_SIZE(pending); i++)
+		bench_add(pending[i]);
+
+	/* All the events, from 1 us to 1000 s, until the wheel is empty */
+	timer_wheel_reset_stats();
+	start_ns = host_timer_ns();
+	t0 = host_time_ns();
+	for (i = 0; i < SCALE_EVENTS; i++)
+		timer_wheel_add(&scale_events[i], random_delay(1000000000), 0);
+	t1 = host_time_ns();
+	sample_count = 0;
+	while (host_timer_run())
+		alarms++;
+	t2 = host_time_ns();
+
+	timer_wheel_get_stats(&stats);
+	host_check(stats.fired == SCALE_EVENTS && sample_count == SCALE_EVENTS);
+	printf("  add %.1f ns, expiry %.1f ns per event (host), %u alarms "
+		"over %.0f s\n", (double)(t1 - t0) / SCALE_EVENTS,
+		(double)(t2 - t1) / SCALE_EVENTS, (unsigned)alarms,
+		(host_timer_ns() - start_ns) / 1e9);
+	print_summary("one-shot lateness", samples, sample_count);
+	host_check(host_timer_ticks_to_ns(samples[sample_count - 1]) <=
+		stats.resolution);
+}
+
+static int periodic_callback(void* arg, void* arg2)
+{
+	struct _timer_event* event = (struct _timer_event*)arg2;
+	uint64_t now = timer_get_raw_tick();
+
+	/* lateness against the deadline before it moved to the next period */
+	if (sample_count < PERIODIC_SAMPLES)
+		samples[sample_count++] = now - (event->deadline - event->period);
+	return 0;
+}
+
+static void test_periodic(void)
+{
+	static const uint32_t periods[] = { 100, 1000, 10000 };
+	struct _timer_wheel_stats stats;
+	uint64_t end_ns = host_timer_ns() + PERIODIC_NS;
+	uint32_t i, alarms = 0;
+
+	printf("timer_wheel: %u periodic events for %.1f s\n", PERIODIC_EVENTS,
+		PERIODIC_NS / 1e9);
+
+	timer_wheel_reset_stats();
+	sample_count = 0;
+	for (i = 0; i < PERIODIC_EVENTS; i++) {
+		timer_event_init(&scale_events[i], periodic_callback, NULL);
+		timer_wheel_add(&scale_events[i], 1 + host_rand() % 10000,
+				periods[i % ARRAY_SIZE(periods)]);
+	}
+	while (host_timer_ns() < end_ns && host_timer_run())
+		alarms++;
+	for (i = 0; i < PERIODIC_EVENTS; i++)
+		timer_wheel_cancel(&scale_events[i]);
+
+	timer_wheel_get_stats(&stats);
+	host_check(stats.overruns == 0);
+	printf("  %u callbacks, %u alarms (a %u ns periodic tick would take "
+		"%.0f)\n", (unsigned)stats.fired, (unsigned)alarms,
+		(unsigned)stats.resolution, (double)PERIODIC_NS / stats.resolution);
+	print_summary("periodic lateness", samples, sample_count);
+	host_check(host_timer_ticks_to_ns(samples[sample_count - 1]) <=
+		stats.resolution);
+
+	free(samples);
+	free(scale_events);
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	struct _timer_wheel_stats stats;
+
+	host_init();
+	host_timer_reset();
+	timer_wheel_init();
+	timer_wheel_get_stats(&stats);
+	tick_ns = stats.resolution;
+
+	test_random();
+	test_scale();
+	test_periodic();
+
+	return host_report("timer_wheel");
+}
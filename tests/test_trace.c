@@ -0,0 +1,552 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Deferred traces (trace.c with CONFIG_TRACE_DEFERRED) and the host
+ *  decoder scripts/trace_decode.py.
+ *
+ *  The traces drained with trace_flush() are compared with the same
+ *  formats printed directly, and a binary trace_dump() of them, with
+ *  garbage inserted between records, is decoded by the script from the
+ *  symbol table of this program. The ring is checked to drop and count
+ *  the entries it cannot hold, and to lose nothing with several producer
+ *  threads and a concurrent consumer.
+ *
+ *  The benchmark reports the cycles per trace call, deferred or printed
+ *  immediately, and the cost of draining an entry.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#include "host.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define SAMPLE_ROUNDS   20
+
+#define THREADS         4
+#define THREAD_TRACES   100000
+
+#define BENCH_BATCH     128
+#define BENCH_BATCHES   2000
+
+/** Console bit rate used to estimate the cost of printing immediately */
+#define CONSOLE_BAUDRATE 115200
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+/** Entry as sent by trace_dump() on this host, after the two sync bytes */
+struct _dump_entry {
+	const struct _trace_fmt* fmt;
+	uint32_t timestamp;
+	uint32_t args[TRACE_DEFERRED_MAX_ARGS];
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static volatile uint64_t tick;
+
+/* console output of trace_dump() */
+static uint8_t console[1024 * 1024];
+static uint32_t console_len;
+static bool console_capture;
+
+static char expected[64 * 1024];
+static char output[64 * 1024];
+
+static const char* const names[] = { "sdmmc", "usb", "lcd" };
+
+/* threads test */
+static volatile bool producers_done;
+static uint32_t received[THREADS];
+static uint32_t order_errors;
+static uint32_t unknown_entries;
+static const struct _trace_fmt* thread_fmt;
+
+/*------------------------------------------------------------------------------
+ *         Stubs
+ *------------------------------------------------------------------------------*/
+
+uint64_t timer_get_tick(void)
+{
+	return tick;
+}
+
+void console_put_char(char c)
+{
+	if (console_capture && console_len < sizeof(console))
+		console[console_len++] = (uint8_t)c;
+}
+
+void console_panic_flush(void)
+{
+}
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/** Redirect stdout to a file, returns the descriptor to restore */
+static int stdout_to(const char* path)
+{
+	int saved, fd;
+
+	fflush(stdout);
+	saved = dup(STDOUT_FILENO);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	dup2(fd, STDOUT_FILENO);
+	close(fd);
+	return saved;
+}
+
+static void stdout_restore(int saved)
+{
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+}
+
+static uint32_t read_file(const char* path, char* buffer, uint32_t size)
+{
+	int fd = open(path, O_RDONLY);
+	ssize_t len;
+
+	if (fd < 0)
+		return 0;
+	len = read(fd, buffer, size - 1);
+	close(fd);
+	if (len < 0)
+		len = 0;
+	buffer[len] = '\0';
+	return (uint32_t)len;
+}
+
+/** Traces of every level and argument count, and their expected text */
+static char* log_samples(char* p, uint32_t i)
+{
+	tick = 1000 * i;
+	trace_info("no argument\r\n");
+	p += sprintf(p, "[%8u] -I- no argument\r\n", (unsigned)tick);
+
+	tick++;
+	trace_info("boot %u\r\n", i);
+	p += sprintf(p, "[%8u] -I- boot %u\r\n", (unsigned)tick, i);
+
+	trace_warning("temperature %d mC\r\n", -7 * (int)i);
+	p += sprintf(p, "[%8u] -W- temperature %d mC\r\n", (unsigned)tick,
+		-7 * (int)i);
+
+	trace_error("reg 0x%08x = %x\r\n", 0xf8000000u + i, 3 * i);
+	p += sprintf(p, "[%8u] -E- reg 0x%08x = %x\r\n", (unsigned)tick,
+		0xf8000000u + i, 3 * i);
+
+	tick++;
+	trace_info("%s: %c%c\r\n", names[i % 3], 'o', 'k');
+	p += sprintf(p, "[%8u] -I- %s: %c%c\r\n", (unsigned)tick,
+		names[i % 3], 'o', 'k');
+
+	trace_info("%u %u %u %u %u %u\r\n", i, i + 1, i + 2, i + 3, i + 4, i + 5);
+	p += sprintf(p, "[%8u] -I- %u %u %u %u %u %u\r\n", (unsigned)tick,
+		i, i + 1, i + 2, i + 3, i + 4, i + 5);
+
+	trace_info_wp("  %5u|%-4d|\r\n", i, -(int)i);
+	p += sprintf(p, "  %5u|%-4d|\r\n", i, -(int)i);
+	return p;
+}
+
+static void test_flush(void)
+{
+	char path[] = "/tmp/test_trace_XXXXXX";
+	struct _trace_stats stats0, stats1;
+	char* p = expected;
+	uint32_t i;
+	int fd, saved;
+
+	printf("trace: deferred traces\n");
+
+	fd = mkstemp(path);
+	close(fd);
+
+	trace_get_stats(&stats0);
+	for (i = 0; i < SAMPLE_ROUNDS; i++)
+		p = log_samples(p, i);
+	trace_get_stats(&stats1);
+	host_check(stats1.logged - stats0.logged == 7 * SAMPLE_ROUNDS);
+
+	/* Nothing is printed until the ring is drained */
+	saved = stdout_to(path);
+	host_check(trace_flush() == 7 * SAMPLE_ROUNDS);
+	host_check(trace_flush() == 0);
+	stdout_restore(saved);
+	read_file(path, output, sizeof(output));
+	host_check(strcmp(output, expected) == 0);
+
+	/* Seven arguments do not fit an entry: printed immediately */
+	saved = stdout_to(path);
+	trace_info("%u %u %u %u %u %u %u\r\n", 1, 2, 3, 4, 5, 6, 7);
+	stdout_restore(saved);
+	read_file(path, output, sizeof(output));
+	host_check(strcmp(output, "-I- 1 2 3 4 5 6 7\r\n") == 0);
+	trace_get_stats(&stats0);
+	host_check(stats0.logged == stats1.logged);
+
+	/* Disabled at runtime */
+	trace_level = TRACE_LEVEL_WARNING;
+	trace_info("hidden %u\r\n", 1);
+	trace_warning("shown %u\r\n", 2);
+	trace_level = TRACE_LEVEL;
+	saved = stdout_to(path);
+	host_check(trace_flush() == 1);
+	stdout_restore(saved);
+
+	unlink(path);
+}
+
+static void test_full(void)
+{
+	struct _trace_stats stats0, stats1;
+	uint32_t i;
+
+	printf("trace: full ring\n");
+
+	trace_get_stats(&stats0);
+	for (i = 0; i < TRACE_DEFERRED_ENTRIES + 10; i++)
+		trace_info("entry %u\r\n", i);
+	trace_get_stats(&stats1);
+	host_check(stats1.logged - stats0.logged == TRACE_DEFERRED_ENTRIES);
+	host_check(stats1.dropped - stats0.dropped == 10);
+
+	console_capture = true;
+	console_len = 0;
+	host_check(trace_dump() == TRACE_DEFERRED_ENTRIES);
+	console_capture = false;
+	host_check(console_len ==
+		TRACE_DEFERRED_ENTRIES * (2 + sizeof(struct _dump_entry)));
+	trace_get_stats(&stats1);
+	host_check(stats1.peak == TRACE_DEFERRED_ENTRIES);
+}
+
+static void test_decoder(void)
+{
+	char dump[] = "/tmp/test_trace_XXXXXX";
+	char elf[1024], command[4096];
+	static const uint8_t garbage[] = { 0x00, 0xa5, 0x5a, 0x12, 0xa5, 0xa5 };
+	char* p = expected;
+	uint32_t i, len;
+	ssize_t n;
+	FILE* f;
+	int fd;
+
+	printf("trace: binary dump decoded by trace_decode.py\n");
+
+	n = readlink("/proc/self/exe", elf, sizeof(elf) - 1);
+	host_check(n > 0);
+	elf[n > 0 ? n : 0] = '\0';
+
+	/* Records separated by bytes the decoder has to skip */
+	console_capture = true;
+	console_len = 0;
+	for (i = 0; i < SAMPLE_ROUNDS; i++) {
+		p = log_samples(p, i);
+		trace_dump();
+		memcpy(&console[console_len], garbage, i % sizeof(garbage));
+		console_len += i % sizeof(garbage);
+	}
+	console_capture = false;
+
+	fd = mkstemp(dump);
+	host_check(write(fd, console, console_len) == console_len);
+	close(fd);
+
+	/* The decoder drops the carriage returns */
+	for (i = 0, len = 0; expected[i]; i++)
+		if (expected[i] != '\r')
+			expected[len++] = expected[i];
+	expected[len] = '\0';
+
+	snprintf(command, sizeof(command), "python3 %s %s %s 2>&1",
+		TRACE_DECODE, elf, dump);
+	f = popen(command, "r");
+	len = f ? fread(output, 1, sizeof(output) - 1, f) : 0;
+	output[len] = '\0';
+	if (!f || pclose(f) != 0) {
+		printf("  skipped, python3 %s failed: %s\n", TRACE_DECODE, output);
+	} else {
+		host_check(strcmp(output, expected) == 0);
+		printf("  %u records decoded\n", 7 * SAMPLE_ROUNDS);
+
+		snprintf(command, sizeof(command), "python3 %s %s --table",
+			TRACE_DECODE, elf);
+		f = popen(command, "r");
+		len = fread(output, 1, sizeof(output) - 1, f);
+		output[len] = '\0';
+		pclose(f);
+		host_check(strstr(output, " W 1 '-W- temperature %d mC\\r\\n'"));
+	}
+	unlink(dump);
+}
+
+/** Check the entries dumped so far, thread number and sequence */
+static void parse_console(uint32_t* next)
+{
+	struct _dump_entry entry;
+	uint32_t pos, thread;
+
+	for (pos = 0; pos + 2 + sizeof(entry) <= console_len;
+	     pos += 2 + sizeof(entry)) {
+		memcpy(&entry, &console[pos + 2], sizeof(entry));
+		if (console[pos] != 0xa5 || console[pos + 1] != 0x5a ||
+		    entry.fmt != thread_fmt || entry.args[0] >= THREADS) {
+			unknown_entries++;
+			continue;
+		}
+		thread = entry.args[0];
+		if (entry.args[1] < next[thread])
+			order_errors++;
+		next[thread] = entry.args[1] + 1;
+		received[thread]++;
+	}
+	console_len = 0;
+}
+
+static void* producer(void* arg)
+{
+	uint32_t thread = (uint32_t)(uintptr_t)arg;
+	uint32_t i;
+
+	for (i = 0; i < THREAD_TRACES; i++) {
+		trace_info("thread %u seq %u\r\n", thread, i);
+		if ((i % 64) == 63)
+			sched_yield();
+	}
+	return NULL;
+}
+
+static void* consumer(void* arg)
+{
+	uint32_t next[THREADS] = { 0 };
+	bool done;
+
+	do {
+		done = producers_done;
+		console_capture = true;
+		trace_dump();
+		console_capture = false;
+		parse_console(next);
+		sched_yield();
+	} while (!done);
+	return NULL;
+}
+
+static void test_threads(void)
+{
+	struct _trace_stats stats0, stats1;
+	pthread_t producers[THREADS], drain;
+	uint32_t i, total = 0, logged, dropped;
+	char path[] = "/tmp/test_trace_XXXXXX";
+	int fd, saved;
+
+	printf("trace: %u producer threads, one consumer\n", THREADS);
+
+	/* Descriptor of the call site in producer() */
+	fd = mkstemp(path);
+	close(fd);
+	saved = stdout_to(path);
+	trace_flush();
+	stdout_restore(saved);
+	console_capture = true;
+	console_len = 0;
+	producer((void*)(uintptr_t)THREADS);
+	trace_dump();
+	console_capture = false;
+	memcpy(&thread_fmt, &console[2], sizeof(thread_fmt));
+	trace_dump();
+	unlink(path);
+
+	trace_get_stats(&stats0);
+	console_len = 0;
+	producers_done = false;
+	pthread_create(&drain, NULL, consumer, NULL);
+	for (i = 0; i < THREADS; i++)
+		pthread_create(&producers[i], NULL, producer, (void*)(uintptr_t)i);
+	for (i = 0; i < THREADS; i++)
+		pthread_join(producers[i], NULL);
+	producers_done = true;
+	pthread_join(drain, NULL);
+	trace_get_stats(&stats1);
+
+	for (i = 0; i < THREADS; i++)
+		total += received[i];
+	logged = stats1.logged - stats0.logged;
+	dropped = stats1.dropped - stats0.dropped;
+	host_check(order_errors == 0 && unknown_entries == 0);
+	host_check(total == logged);
+	host_check(logged + dropped == THREADS * THREAD_TRACES);
+	printf("  %u traces: %u received, %u dropped, peak %u entries\n",
+		THREADS * THREAD_TRACES, (unsigned)total, (unsigned)dropped,
+		(unsigned)stats1.peak);
+}
+
+/*------------------------------------------------------------------------------
+ *         Benchmark
+ *------------------------------------------------------------------------------*/
+
+enum _bench_case {
+	BENCH_DEFERRED_0,
+	BENCH_DEFERRED_2,
+	BENCH_DEFERRED_6,
+	BENCH_DISABLED,
+	BENCH_IMMEDIATE,
+	BENCH_FORMAT,
+};
+
+static const char* const bench_names[] = {
+	"deferred, no argument",
+	"deferred, 2 arguments",
+	"deferred, 6 arguments",
+	"disabled at runtime",
+	"printed immediately",
+	"formatted (snprintf)",
+};
+
+static void bench_call(enum _bench_case c, uint32_t i)
+{
+	char line[128];
+
+	switch (c) {
+	case BENCH_DEFERRED_0:
+		trace_info("sample\r\n");
+		break;
+	case BENCH_DEFERRED_2:
+	case BENCH_DISABLED:
+		trace_info("sample %u at 0x%08x\r\n", i, 0x20000000u + i);
+		break;
+	case BENCH_DEFERRED_6:
+		trace_info("%u %u %u %u %u %u\r\n", i, i, i, i, i, i);
+		break;
+	case BENCH_IMMEDIATE:
+		trace_info("%u %u %u %u %u %u %u\r\n", i, i, i, i, i, i, i);
+		break;
+	case BENCH_FORMAT:
+		snprintf(line, sizeof(line), "-I- sample %u at 0x%08x\r\n",
+			i, 0x20000000u + i);
+		__asm__ volatile("" : : "r"(line) : "memory");
+		break;
+	}
+}
+
+static void bench(void)
+{
+	static uint64_t samples[BENCH_BATCHES];
+	struct _host_summary summary;
+	uint64_t t0;
+	uint32_t c, b, i;
+	int saved;
+
+	printf("trace: cycles per call (host)\n");
+
+	/* stdout of the immediate and drained traces goes nowhere */
+	saved = stdout_to("/dev/null");
+	for (c = BENCH_DEFERRED_0; c <= BENCH_FORMAT; c++) {
+		trace_level = c == BENCH_DISABLED ? TRACE_LEVEL_WARNING : TRACE_LEVEL;
+		for (b = 0; b < BENCH_BATCHES; b++) {
+			t0 = host_cycles();
+			for (i = 0; i < BENCH_BATCH; i++)
+				bench_call(c, i);
+			samples[b] = host_cycles() - t0;
+			trace_dump();
+		}
+		host_summarize(samples, BENCH_BATCHES, &summary);
+		dprintf(saved, "  %-24s %8.1f cycles\n", bench_names[c],
+			(double)summary.p50 / BENCH_BATCH);
+	}
+	trace_level = TRACE_LEVEL;
+
+	/* Draining: formatted, or binary on the console */
+	for (c = 0; c < 2; c++) {
+		for (b = 0; b < BENCH_BATCHES; b++) {
+			for (i = 0; i < BENCH_BATCH; i++)
+				bench_call(BENCH_DEFERRED_2, i);
+			t0 = host_cycles();
+			if (c == 0)
+				trace_flush();
+			else
+				trace_dump();
+			samples[b] = host_cycles() - t0;
+		}
+		host_summarize(samples, BENCH_BATCHES, &summary);
+		dprintf(saved, "  %-24s %8.1f cycles per entry\n",
+			c == 0 ? "trace_flush()" : "trace_dump()",
+			(double)summary.p50 / BENCH_BATCH);
+	}
+	stdout_restore(saved);
+
+	/* What the deferred call avoids in the caller's context */
+	printf("  a 34-character line printed immediately holds the caller "
+		"%.0f us at %u baud\n", 34 * 10 * 1e6 / CONSOLE_BAUDRATE,
+		CONSOLE_BAUDRATE);
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	host_init();
+
+	test_flush();
+	test_full();
+	test_decoder();
+	test_threads();
+	bench();
+
+	return host_report("trace");
+}
@@ -0,0 +1,363 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2016, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Loopback test of the continuous receive mode of usartd on a simulated
+ *  USART and DMA controller. A sender streams a numbered byte pattern in
+ *  bursts, with idle gaps longer than the receiver timeout, while the
+ *  application polls every millisecond, spends a fixed CPU time per byte
+ *  and is sometimes blocked for several milliseconds. At each baudrate
+ *  the test checks that every byte either reaches the application in
+ *  order or is counted as dropped, reports the sustained throughput and
+ *  the drops, and compares with one-shot DMA transfers re-armed by the
+ *  application.
+ *
+ *------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "chip.h"
+
+#include "callback.h"
+#include "dma/dma.h"
+#include "mm/cache.h"
+#include "serial/usart.h"
+#include "serial/usartd.h"
+
+#include "dma_sim.h"
+#include "host.h"
+#include "usart_sim.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+#define IFACE           0
+
+/** Receive buffer of the continuous mode */
+#define STREAM_SIZE     2048
+
+/** Buffer of the one-shot transfers */
+#define ONESHOT_SIZE    256
+
+/** Simulated duration of each run */
+#define RUN_NS          1000000000ull
+
+/** Receiver timeout of the descriptor, in ms */
+#define TIMEOUT_MS      1
+
+/** Application: poll period, CPU time per byte, blocking periods */
+#define POLL_NS         1000000u
+#define BYTE_NS         50u
+#define STALL_NS        5000000u
+#define STALL_PERCENT   1
+
+/** Granularity of the application sleep, to wake up on a callback */
+#define SLEEP_STEP_NS   50000u
+
+/** Sender: bursts of 16 to 4096 bytes, a quarter followed by a gap */
+#define BURST_MIN       16
+#define BURST_MAX       4096
+#define GAP_MIN_NS      2000000u
+#define GAP_MAX_NS      5000000u
+
+/*------------------------------------------------------------------------------
+ *         Local types
+ *------------------------------------------------------------------------------*/
+
+struct _run {
+	uint64_t sent;
+	uint64_t delivered;
+	uint32_t dropped;
+	uint32_t errors;
+	uint32_t overruns;
+	uint32_t callbacks;
+	uint64_t ns;
+	uint64_t get_calls;
+	uint64_t get_host_ns;
+};
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static struct _usart_desc usart_desc = {
+	.addr           = FLEXUSART0,
+	.mode           = US_MR_CHMODE_NORMAL | US_MR_PAR_NO | US_MR_CHRL_8_BIT,
+	.transfer_mode  = USARTD_MODE_DMA,
+	.timeout        = TIMEOUT_MS,
+};
+
+CACHE_ALIGNED static uint8_t stream_buffer[STREAM_SIZE];
+CACHE_ALIGNED static uint8_t oneshot_buffer[ONESHOT_SIZE];
+
+static const uint32_t baudrates[] = { 115200, 1000000, 3000000, 6000000 };
+
+/** Sender state */
+static struct {
+	uint64_t sent;
+	uint64_t total;
+	uint64_t next_burst;
+} line;
+
+static volatile bool wakeup;
+static volatile uint32_t callbacks;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static uint8_t pattern(uint64_t n)
+{
+	return (uint8_t)(((uint32_t)n * 0x9e3779b1u) >> 24);
+}
+
+static int _wakeup_callback(void* arg, void* arg2)
+{
+	callbacks++;
+	wakeup = true;
+	return 0;
+}
+
+static void configure(uint32_t baudrate)
+{
+	static bool configured;
+
+	usart_sim_init(usart_desc.addr, baudrate);
+	usart_desc.baudrate = baudrate;
+	if (!configured) {
+		dma_initialize(false);
+		usartd_configure(IFACE, &usart_desc);
+		configured = true;
+	} else {
+		usart_configure(usart_desc.addr, usart_desc.mode, baudrate);
+		usart_set_rx_timeout(usart_desc.addr, baudrate, usart_desc.timeout);
+	}
+
+	/* a second of traffic at full rate, less with the gaps */
+	memset(&line, 0, sizeof(line));
+	line.total = baudrate / 10;
+	host_srand(baudrate);
+	wakeup = false;
+	callbacks = 0;
+}
+
+/** Queue the next bursts of the sender */
+static void feed(void)
+{
+	uint8_t burst[BURST_MAX];
+	uint32_t i, len;
+
+	while (line.sent < line.total && usart_sim_pending() < BURST_MAX &&
+	       usart_sim_time_ns() >= line.next_burst) {
+		len = BURST_MIN + host_rand() % (BURST_MAX - BURST_MIN + 1);
+		if (len > line.total - line.sent)
+			len = line.total - line.sent;
+		for (i = 0; i < len; i++)
+			burst[i] = pattern(line.sent + i);
+		usart_sim_send(burst, len);
+		line.sent += len;
+		if (host_rand() % 4 == 0)
+			line.next_burst = usart_sim_time_ns() +
+				usart_sim_pending() * usart_sim_char_ns() +
+				GAP_MIN_NS + host_rand() % (GAP_MAX_NS - GAP_MIN_NS);
+	}
+}
+
+/** Wait for the next poll or a callback, sometimes blocked */
+static void sleep(void)
+{
+	uint32_t t;
+
+	if (host_rand() % 100 < STALL_PERCENT) {
+		usart_sim_advance(STALL_NS);
+		return;
+	}
+	for (t = 0; t < POLL_NS && !wakeup; t += SLEEP_STEP_NS)
+		usart_sim_advance(SLEEP_STEP_NS);
+	wakeup = false;
+}
+
+static bool finished(void)
+{
+	return line.sent == line.total && usart_sim_pending() == 0 &&
+		usart_sim_time_ns() >= line.next_burst;
+}
+
+static void run_stream(uint32_t baudrate, struct _run* run)
+{
+	struct _usartd_stream_stats stats;
+	struct _usart_sim_stats sim;
+	struct _callback cb;
+	const uint8_t* data;
+	uint64_t t0, settle = 0;
+	uint32_t i, n;
+
+	configure(baudrate);
+	memset(run, 0, sizeof(*run));
+
+	callback_set(&cb, _wakeup_callback, NULL);
+	host_check(usartd_start_rx_stream(IFACE, stream_buffer + 1, STREAM_SIZE, &cb) ==
+		USARTD_ERROR_INVALID);
+	host_check(usartd_start_rx_stream(IFACE, stream_buffer, STREAM_SIZE - 32, &cb) ==
+		USARTD_ERROR_INVALID);
+	host_check(usartd_start_rx_stream(IFACE, stream_buffer, STREAM_SIZE, &cb) ==
+		USARTD_SUCCESS);
+	host_check(usartd_start_rx_stream(IFACE, stream_buffer, STREAM_SIZE, &cb) ==
+		USARTD_ERROR_LOCK);
+
+	/* run until all sent and a few receiver timeouts more */
+	while (settle < 4 * POLL_NS) {
+		feed();
+		for (;;) {
+			t0 = host_time_ns();
+			n = usartd_rx_stream_get(IFACE, &data);
+			usartd_rx_stream_get_stats(IFACE, &stats);
+			run->get_host_ns += host_time_ns() - t0;
+			run->get_calls++;
+			if (n == 0)
+				break;
+			for (i = 0; i < n; i++)
+				if (data[i] != pattern(run->delivered + stats.dropped + i))
+					run->errors++;
+			usart_sim_advance(n * BYTE_NS);
+			usartd_rx_stream_release(IFACE, n);
+			run->delivered += n;
+		}
+		if (finished())
+			settle += POLL_NS;
+		sleep();
+	}
+	usartd_rx_stream_get_stats(IFACE, &stats);
+	usartd_stop_rx_stream(IFACE);
+	host_check(!usartd_rx_is_busy(IFACE));
+
+	usart_sim_get_stats(&sim);
+	run->sent = line.sent;
+	run->dropped = stats.dropped;
+	run->overruns = stats.overruns;
+	run->callbacks = callbacks;
+	run->ns = usart_sim_time_ns();
+
+	host_check(sim.sent == line.total);
+	host_check(stats.received == line.total);
+	host_check(run->delivered + run->dropped == line.total);
+	host_check(run->errors == 0);
+	host_check(run->overruns == 0);
+	host_check(run->callbacks > 0);
+}
+
+static void run_oneshot(uint32_t baudrate, struct _run* run)
+{
+	struct _usart_sim_stats sim;
+	struct _callback cb;
+	struct _buffer buf = {
+		.data = oneshot_buffer,
+		.size = ONESHOT_SIZE,
+		.attr = USARTD_BUF_ATTR_READ,
+	};
+	uint64_t settle = 0;
+	bool armed = false;
+
+	configure(baudrate);
+	memset(run, 0, sizeof(*run));
+
+	callback_set(&cb, _wakeup_callback, NULL);
+	while (settle < 4 * POLL_NS) {
+		feed();
+		if (!usartd_rx_is_busy(IFACE)) {
+			/* process the data and re-arm */
+			if (armed) {
+				usart_sim_advance(usart_desc.rx.transferred * BYTE_NS);
+				run->delivered += usart_desc.rx.transferred;
+			}
+			host_check(usartd_transfer(IFACE, &buf, &cb) == USARTD_SUCCESS);
+			armed = true;
+		}
+		if (finished())
+			settle += POLL_NS;
+		sleep();
+	}
+	usart_sim_get_stats(&sim);
+	run->sent = line.sent;
+	run->overruns = sim.overruns;
+	run->callbacks = callbacks;
+	run->ns = usart_sim_time_ns();
+
+	host_check(sim.sent == line.total);
+	host_check(run->delivered <= line.total);
+}
+
+/*------------------------------------------------------------------------------
+ *         Main
+ *------------------------------------------------------------------------------*/
+
+int main(void)
+{
+	struct _run stream, oneshot;
+	uint32_t i;
+
+	host_init();
+
+	printf("usart_stream: %u-byte ring, %u us poll, %u ns/byte, "
+		"%u%% of %u ms stalls\n", STREAM_SIZE, POLL_NS / 1000, BYTE_NS,
+		STALL_PERCENT, STALL_NS / 1000000);
+	for (i = 0; i < ARRAY_SIZE(baudrates); i++) {
+		run_stream(baudrates[i], &stream);
+		run_oneshot(baudrates[i], &oneshot);
+
+		printf("  %7u baud: line %6.1f KB/s\n", (unsigned)baudrates[i],
+			baudrates[i] / 10 / 1e3);
+		printf("    stream:  %6.1f KB/s, %7u of %7u bytes dropped, "
+			"%u idle callbacks, %.0f host ns per get\n",
+			stream.delivered * 1e6 / stream.ns,
+			(unsigned)stream.dropped, (unsigned)stream.sent,
+			(unsigned)stream.callbacks,
+			(double)stream.get_host_ns / stream.get_calls);
+		printf("    one-shot %6.1f KB/s, %7u of %7u bytes lost, "
+			"%u overruns\n",
+			oneshot.delivered * 1e6 / oneshot.ns,
+			(unsigned)(oneshot.sent - oneshot.delivered),
+			(unsigned)oneshot.sent, (unsigned)oneshot.overruns);
+
+		/* a stall only overflows the ring above 3 Mbaud */
+		if (baudrates[i] <= 3000000)
+			host_check(stream.dropped == 0);
+		host_check(stream.dropped < oneshot.sent - oneshot.delivered);
+	}
+
+	return host_report("usart_stream");
+}
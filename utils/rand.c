@@ -41,7 +41,29 @@
  *         Global Variables
  *------------------------------------------------------------------------------*/
 
-static uint32_t _rand_next = 1;
+/* xoshiro128** state, must not be all zero */
+static uint32_t _rand_state[4] = {
+	0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b,
+};
+
+/*------------------------------------------------------------------------------
+ *         Local Functions
+ *------------------------------------------------------------------------------*/
+
+static inline uint32_t _rotl(uint32_t x, uint32_t k)
+{
+	return (x << k) | (x >> (32 - k));
+}
+
+/* Expands a seed into well-mixed state words (murmur3 finalizer) */
+static uint32_t _rand_splitmix(uint32_t* x)
+{
+	uint32_t z = (*x += 0x9e3779b9);
+
+	z = (z ^ (z >> 16)) * 0x85ebca6b;
+	z = (z ^ (z >> 13)) * 0xc2b2ae35;
+	return z ^ (z >> 16);
+}
 
 /*------------------------------------------------------------------------------
  *         Exported Functions
@@ -50,19 +72,35 @@ static uint32_t _rand_next = 1;
 /**
  *  Initialize the seed for rand generator.
  *
- *  \param dwSeed rand initiation seed
+ *  \param seed rand initiation seed
  */
 void srand(uint32_t seed)
 {
-	_rand_next = seed;
+	uint32_t i;
+
+	for (i = 0; i < 4; i++)
+		_rand_state[i] = _rand_splitmix(&seed);
+
+	/* The all-zero state is a fixed point */
+	if (!(_rand_state[0] | _rand_state[1] | _rand_state[2] | _rand_state[3]))
+		_rand_state[0] = 1;
 }
 
 /**
- *  Return a random number, maxinum assumed to be 65536
+ *  Return a 32-bit pseudo-random number (xoshiro128**).
+ *  Fast and statistically sound, but not suitable for cryptographic use.
  */
 uint32_t rand(void)
 {
-	_rand_next = _rand_next * 1103515245 + 12345;
+	const uint32_t result = _rotl(_rand_state[1] * 5, 7) * 9;
+	const uint32_t t = _rand_state[1] << 9;
+
+	_rand_state[2] ^= _rand_state[0];
+	_rand_state[3] ^= _rand_state[1];
+	_rand_state[1] ^= _rand_state[2];
+	_rand_state[0] ^= _rand_state[3];
+	_rand_state[2] ^= t;
+	_rand_state[3] = _rotl(_rand_state[3], 11);
 
-	return (uint32_t)(_rand_next / 131072) % 65536;
+	return result;
 }
@@ -31,7 +31,9 @@
  *  \file
  *
  *  \section Purpose
- *  Small function for gererating random number.
+ *  Fast non-cryptographic pseudo-random number generator (xoshiro128**).
+ *  Use random_bytes() from crypto/drbg.h for keys, nonces or sequence
+ *  numbers.
  *
  *------------------------------------------------------------------------------*/
 
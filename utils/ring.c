@@ -0,0 +1,233 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2015, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "barriers.h"
+#include "compiler.h"
+#include "errno.h"
+#include "intmath.h"
+#include "ring.h"
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+static inline uint8_t* _ring_slot(const struct _ring* ring, uint32_t index)
+{
+	return ring->buffer + (index & ring->mask) * ring->elem_size;
+}
+
+/**
+ * \brief Copy elements into the ring starting at index, in at most two parts
+ */
+static void _ring_copy_in(struct _ring* ring, uint32_t index, const uint8_t* src, uint32_t count)
+{
+	uint32_t first = min_u32(count, ring->size - (index & ring->mask));
+
+	memcpy(_ring_slot(ring, index), src, first * ring->elem_size);
+	if (first < count)
+		memcpy(ring->buffer, src + first * ring->elem_size,
+		       (count - first) * ring->elem_size);
+}
+
+/**
+ * \brief Copy elements out of the ring starting at index, in at most two parts
+ */
+static void _ring_copy_out(const struct _ring* ring, uint32_t index, uint8_t* dst, uint32_t count)
+{
+	uint32_t first = min_u32(count, ring->size - (index & ring->mask));
+
+	memcpy(dst, _ring_slot(ring, index), first * ring->elem_size);
+	if (first < count)
+		memcpy(dst + first * ring->elem_size, ring->buffer,
+		       (count - first) * ring->elem_size);
+}
+
+/**
+ * \brief Publish a new head (producer side)
+ */
+static inline void _ring_publish(struct _ring* ring, uint32_t head)
+{
+	uint32_t count;
+
+	/* element data must be visible before the new head */
+	dmb();
+	ring->head = head;
+
+	count = head - ring->tail;
+	if (count > ring->peak)
+		ring->peak = count;
+}
+
+/**
+ * \brief Release slots to the producer (consumer side)
+ */
+static inline void _ring_release(struct _ring* ring, uint32_t tail)
+{
+	/* element data must be read before the slots are handed back */
+	dmb();
+	ring->tail = tail;
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+int ring_init(struct _ring* ring, void* buffer, uint32_t size, uint32_t elem_size)
+{
+	if (!buffer || !IS_POWER_OF_TWO(size) || elem_size == 0)
+		return -EINVAL;
+
+	ring->buffer = (uint8_t*)buffer;
+	ring->size = size;
+	ring->mask = size - 1;
+	ring->elem_size = elem_size;
+	ring->low_watermark = 0;
+	ring->high_watermark = size;
+	ring_reset(ring);
+
+	return 0;
+}
+
+void ring_reset(struct _ring* ring)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	ring->peak = 0;
+}
+
+void ring_set_watermarks(struct _ring* ring, uint32_t low, uint32_t high)
+{
+	ring->low_watermark = low;
+	ring->high_watermark = high;
+}
+
+bool ring_push(struct _ring* ring, const void* elem)
+{
+	uint32_t head = ring->head;
+
+	if (head - ring->tail >= ring->size)
+		return false;
+
+	/* slots freed by the consumer must not be overwritten early */
+	dmb();
+	memcpy(_ring_slot(ring, head), elem, ring->elem_size);
+	_ring_publish(ring, head + 1);
+	return true;
+}
+
+uint32_t ring_push_n(struct _ring* ring, const void* elems, uint32_t count)
+{
+	uint32_t head = ring->head;
+
+	count = min_u32(count, ring->size - (head - ring->tail));
+	if (count == 0)
+		return 0;
+
+	/* slots freed by the consumer must not be overwritten early */
+	dmb();
+	_ring_copy_in(ring, head, (const uint8_t*)elems, count);
+	_ring_publish(ring, head + count);
+	return count;
+}
+
+uint32_t ring_write_reserve(struct _ring* ring, void** ptr)
+{
+	uint32_t head = ring->head;
+	uint32_t space = ring->size - (head - ring->tail);
+
+	dmb();
+	*ptr = _ring_slot(ring, head);
+	return min_u32(space, ring->size - (head & ring->mask));
+}
+
+void ring_write_commit(struct _ring* ring, uint32_t count)
+{
+	_ring_publish(ring, ring->head + count);
+}
+
+bool ring_pop(struct _ring* ring, void* elem)
+{
+	uint32_t tail = ring->tail;
+
+	if (ring->head == tail)
+		return false;
+
+	/* read the element only after observing the head */
+	dmb();
+	memcpy(elem, _ring_slot(ring, tail), ring->elem_size);
+	_ring_release(ring, tail + 1);
+	return true;
+}
+
+bool ring_peek(struct _ring* ring, void* elem)
+{
+	uint32_t tail = ring->tail;
+
+	if (ring->head == tail)
+		return false;
+
+	dmb();
+	memcpy(elem, _ring_slot(ring, tail), ring->elem_size);
+	return true;
+}
+
+uint32_t ring_pop_n(struct _ring* ring, void* elems, uint32_t count)
+{
+	uint32_t tail = ring->tail;
+
+	count = min_u32(count, ring->head - tail);
+	if (count == 0)
+		return 0;
+
+	dmb();
+	_ring_copy_out(ring, tail, (uint8_t*)elems, count);
+	_ring_release(ring, tail + count);
+	return count;
+}
+
+uint32_t ring_read_acquire(struct _ring* ring, const void** ptr)
+{
+	uint32_t tail = ring->tail;
+	uint32_t count = ring->head - tail;
+
+	dmb();
+	*ptr = _ring_slot(ring, tail);
+	return min_u32(count, ring->size - (tail & ring->mask));
+}
+
+void ring_read_release(struct _ring* ring, uint32_t count)
+{
+	_ring_release(ring, ring->tail + count);
+}
@@ -27,13 +27,42 @@
  * ----------------------------------------------------------------------------
  */
 
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Single-producer / single-consumer ring buffer.
+ *
+ *  The ring holds a power-of-two number of fixed-size elements. Head and
+ *  tail are free-running counters: the producer only writes the head, the
+ *  consumer only writes the tail, so one producer and one consumer (e.g. an
+ *  interrupt handler and the main loop) can share a ring without locking.
+ *  All slots are usable.
+ *
+ *  Zero-copy access is available through ring_write_reserve() /
+ *  ring_write_commit() and ring_read_acquire() / ring_read_release(), which
+ *  return the contiguous area up to the end of the buffer, suitable for a
+ *  DMA transfer.
+ *
+ *------------------------------------------------------------------------------*/
+
 #ifndef _RING_H_
 #define _RING_H_
 
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "intmath.h"
 
 /*------------------------------------------------------------------------------
- *         Exported functions
+ *         Index macros
+ *
+ *  Helpers for rings managed directly through head/tail indexes, where one
+ *  slot is always left free (used by the network drivers).
  *------------------------------------------------------------------------------*/
 
 /** Return count in buffer */
@@ -78,4 +107,145 @@
 /** Clear circular buffer */
 #define RING_CLEAR(head, tail) ((head) = (tail) = 0)
 
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+struct _ring {
+	uint8_t* buffer;          /**< Element storage */
+	uint32_t size;            /**< Capacity in elements (power of two) */
+	uint32_t mask;            /**< size - 1 */
+	uint32_t elem_size;       /**< Size of an element in bytes */
+	volatile uint32_t head;   /**< Free-running write index (producer) */
+	volatile uint32_t tail;   /**< Free-running read index (consumer) */
+	uint32_t low_watermark;   /**< Fill level considered low */
+	uint32_t high_watermark;  /**< Fill level considered high */
+	uint32_t peak;            /**< Highest fill level seen by the producer */
+};
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize a ring
+ *
+ * \param ring       Pointer to the ring
+ * \param buffer     Storage for \a size elements of \a elem_size bytes
+ * \param size       Number of elements, must be a power of two
+ * \param elem_size  Size of one element in bytes
+ * \return 0 on success, -EINVAL if the size is not a power of two
+ */
+extern int ring_init(struct _ring* ring, void* buffer, uint32_t size, uint32_t elem_size);
+
+/**
+ * \brief Empty a ring. Must not race with the producer or the consumer.
+ */
+extern void ring_reset(struct _ring* ring);
+
+/**
+ * \brief Set the fill levels reported by ring_is_low() and ring_is_high()
+ */
+extern void ring_set_watermarks(struct _ring* ring, uint32_t low, uint32_t high);
+
+/** Number of elements in the ring */
+static inline uint32_t ring_count(const struct _ring* ring)
+{
+	return ring->head - ring->tail;
+}
+
+/** Number of free element slots */
+static inline uint32_t ring_space(const struct _ring* ring)
+{
+	return ring->size - ring_count(ring);
+}
+
+static inline bool ring_is_empty(const struct _ring* ring)
+{
+	return ring->head == ring->tail;
+}
+
+static inline bool ring_is_full(const struct _ring* ring)
+{
+	return ring_count(ring) == ring->size;
+}
+
+/** True when the fill level is at or below the low watermark */
+static inline bool ring_is_low(const struct _ring* ring)
+{
+	return ring_count(ring) <= ring->low_watermark;
+}
+
+/** True when the fill level is at or above the high watermark */
+static inline bool ring_is_high(const struct _ring* ring)
+{
+	return ring_count(ring) >= ring->high_watermark;
+}
+
+/*
+ * Producer side
+ */
+
+/**
+ * \brief Append one element
+ * \return true if the element was queued, false if the ring is full
+ */
+extern bool ring_push(struct _ring* ring, const void* elem);
+
+/**
+ * \brief Append up to \a count elements
+ * \return Number of elements queued
+ */
+extern uint32_t ring_push_n(struct _ring* ring, const void* elems, uint32_t count);
+
+/**
+ * \brief Get the contiguous free area at the head of the ring
+ *
+ * \param ring  Pointer to the ring
+ * \param ptr   Receives the address of the first free slot
+ * \return Number of contiguous free slots (may be less than ring_space())
+ */
+extern uint32_t ring_write_reserve(struct _ring* ring, void** ptr);
+
+/**
+ * \brief Publish \a count elements written in the reserved area
+ */
+extern void ring_write_commit(struct _ring* ring, uint32_t count);
+
+/*
+ * Consumer side
+ */
+
+/**
+ * \brief Remove one element
+ * \return true if an element was copied to \a elem, false if the ring is empty
+ */
+extern bool ring_pop(struct _ring* ring, void* elem);
+
+/**
+ * \brief Copy the oldest element without removing it
+ * \return true if an element was copied to \a elem, false if the ring is empty
+ */
+extern bool ring_peek(struct _ring* ring, void* elem);
+
+/**
+ * \brief Remove up to \a count elements
+ * \return Number of elements copied to \a elems
+ */
+extern uint32_t ring_pop_n(struct _ring* ring, void* elems, uint32_t count);
+
+/**
+ * \brief Get the contiguous filled area at the tail of the ring
+ *
+ * \param ring  Pointer to the ring
+ * \param ptr   Receives the address of the oldest element
+ * \return Number of contiguous elements (may be less than ring_count())
+ */
+extern uint32_t ring_read_acquire(struct _ring* ring, const void** ptr);
+
+/**
+ * \brief Release \a count elements obtained with ring_read_acquire()
+ */
+extern void ring_read_release(struct _ring* ring, uint32_t count);
+
 #endif /* _RING_H_ */
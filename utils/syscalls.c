@@ -100,6 +100,7 @@ void _kill(int pid, int sig)
 extern void _exit(int status);
 void _exit(int status)
 {
+	console_panic_flush();
 	printf("Program terminated with status %d.\n", status);
 	while (1) ;
 }
@@ -132,13 +133,12 @@ int _read(int file, char *ptr, int len)
 extern int _write(int file, char *ptr, int len);
 int _write(int file, char *ptr, int len)
 {
-	int i;
+	/* characters dropped by a full console TX buffer are accounted in the
+	 * console statistics, reporting a short write would set the error
+	 * flag of the stream */
+	console_write(ptr, len);
 
-	for (i = 0; i < len; i++, ptr++) {
-		console_put_char(*ptr);
-	}
-
-	return i;
+	return len;
 }
 
 extern int _close(int file);
@@ -47,8 +47,20 @@ struct _timer {
 	uint8_t channel;
 	uint32_t channel_freq;
 	volatile uint32_t upper;
+#ifndef CONFIG_TIMER_POLLING
+	uint64_t alarm;
+	void (*volatile alarm_handler)(void);
+#endif
 };
 
+/*----------------------------------------------------------------------------
+ *         Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** Delay, in TC ticks, used to raise again an RA compare interrupt whose
+ * status was consumed outside of the interrupt handler */
+#define TIMER_ALARM_REARM 16
+
 /*----------------------------------------------------------------------------
  *         Local variables
  *----------------------------------------------------------------------------*/
@@ -65,6 +77,14 @@ static void timer_update_upper_tick_counter(void)
 	uint32_t status = tc_get_status(_timer.tc, _timer.channel);
 	if ((status & TC_SR_COVFS) == TC_SR_COVFS)
 		_timer.upper++;
+#ifndef CONFIG_TIMER_POLLING
+	/* reading the status register cleared a pending alarm interrupt:
+	 * raise it again in a few ticks */
+	if ((status & TC_SR_CPAS) == TC_SR_CPAS && _timer.alarm_handler) {
+		uint32_t ra = tc_get_cv(_timer.tc, _timer.channel) + TIMER_ALARM_REARM;
+		tc_set_ra_rb_rc(_timer.tc, _timer.channel, &ra, NULL, NULL);
+	}
+#endif
 }
 
 static uint32_t timer_get_upper_tick_counter(void)
@@ -73,18 +93,6 @@ static uint32_t timer_get_upper_tick_counter(void)
 	return _timer.upper;
 }
 
-#ifndef CONFIG_TIMER_POLLING
-
-/**
- *  \brief Handler for timer interrupt.
- */
-static void timer_irq_handler(uint32_t source, void* user_arg)
-{
-	timer_update_upper_tick_counter();
-}
-
-#endif /* !CONFIG_TIMER_POLLING */
-
 static uint64_t _timer_get_tick(void)
 {
 	uint32_t upper, lower;
@@ -97,6 +105,47 @@ static uint64_t _timer_get_tick(void)
 	return (((uint64_t)upper) << TC_CHANNEL_SIZE) | lower;
 }
 
+#ifndef CONFIG_TIMER_POLLING
+
+/**
+ *  \brief Disarm the alarm and return its handler if its deadline is reached.
+ */
+static void (*timer_check_alarm(void))(void)
+{
+	void (*handler)(void) = _timer.alarm_handler;
+
+	if (!handler)
+		return NULL;
+
+	if (_timer_get_tick() < _timer.alarm) {
+		/* RA matches the low bits of the deadline, this was an
+		 * earlier match or a re-armed interrupt */
+		uint32_t ra = (uint32_t)_timer.alarm;
+		tc_set_ra_rb_rc(_timer.tc, _timer.channel, &ra, NULL, NULL);
+		return NULL;
+	}
+
+	_timer.alarm_handler = NULL;
+	tc_disable_it(_timer.tc, _timer.channel, TC_IDR_CPAS);
+	return handler;
+}
+
+/**
+ *  \brief Handler for timer interrupt.
+ */
+static void timer_irq_handler(uint32_t source, void* user_arg)
+{
+	void (*handler)(void);
+
+	timer_update_upper_tick_counter();
+
+	handler = timer_check_alarm();
+	if (handler)
+		handler();
+}
+
+#endif /* !CONFIG_TIMER_POLLING */
+
 /*----------------------------------------------------------------------------
  *         Exported Functions
  *----------------------------------------------------------------------------*/
@@ -122,6 +171,49 @@ void timer_configure(Tc* tc, uint8_t channel, uint32_t clock_source)
 	tc_start(tc, channel);
 }
 
+uint64_t timer_get_raw_tick(void)
+{
+	if (!_timer.channel_freq)
+		return 0;
+	return _timer_get_tick();
+}
+
+uint32_t timer_get_raw_freq(void)
+{
+	return _timer.channel_freq;
+}
+
+#ifndef CONFIG_TIMER_POLLING
+
+bool timer_set_alarm(uint64_t deadline, void (*handler)(void))
+{
+	uint32_t flags = arch_irq_save();
+	uint32_t ra = (uint32_t)deadline;
+	bool armed = true;
+
+	_timer.alarm = deadline;
+	_timer.alarm_handler = handler;
+	tc_set_ra_rb_rc(_timer.tc, _timer.channel, &ra, NULL, NULL);
+	tc_enable_it(_timer.tc, _timer.channel, TC_IER_CPAS);
+
+	/* the counter may have reached the deadline while programming */
+	if (_timer_get_tick() >= deadline) {
+		timer_cancel_alarm();
+		armed = false;
+	}
+
+	arch_irq_restore(flags);
+	return armed;
+}
+
+void timer_cancel_alarm(void)
+{
+	_timer.alarm_handler = NULL;
+	tc_disable_it(_timer.tc, _timer.channel, TC_IDR_CPAS);
+}
+
+#endif /* !CONFIG_TIMER_POLLING */
+
 uint64_t timer_get_interval(uint64_t start, uint64_t end)
 {
 	if (end >= start)
@@ -154,6 +246,9 @@ void timer_sleep(uint64_t count)
 
 uint64_t timer_get_tick(void)
 {
+	/* not configured yet (e.g. early traces) */
+	if (!_timer.channel_freq)
+		return 0;
 	return (_timer_get_tick() * 1000) / _timer.channel_freq;
 }
 
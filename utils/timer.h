@@ -34,6 +34,7 @@
  *         Headers
  *----------------------------------------------------------------------------*/
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "board.h"
@@ -105,6 +106,38 @@ extern uint64_t timer_get_interval(uint64_t start, uint64_t end);
  */
 extern uint64_t timer_get_tick(void);
 
+/**
+ * \brief Returns the raw timer counter, in TC ticks
+ */
+extern uint64_t timer_get_raw_tick(void);
+
+/**
+ * \brief Returns the frequency of the raw timer counter, in Hz
+ */
+extern uint32_t timer_get_raw_freq(void);
+
+#ifndef CONFIG_TIMER_POLLING
+
+/**
+ * \brief Call a handler from the timer interrupt when the raw timer counter
+ * reaches a deadline, using the RA compare of the timer channel.
+ *
+ * There is a single alarm, setting it replaces the previous one.
+ *
+ * \param deadline Raw timer counter value (see timer_get_raw_tick())
+ * \param handler  Function called from the timer interrupt
+ * \return false if the deadline is already reached, in which case the alarm
+ * is not armed and the handler will not be called
+ */
+extern bool timer_set_alarm(uint64_t deadline, void (*handler)(void));
+
+/**
+ * \brief Disarm the alarm set by timer_set_alarm()
+ */
+extern void timer_cancel_alarm(void);
+
+#endif /* !CONFIG_TIMER_POLLING */
+
 /**
  *  \brief Wait for at least count seconds.
  */
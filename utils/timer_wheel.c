@@ -0,0 +1,408 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2015, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*----------------------------------------------------------------------------
+ *         Headers
+ *----------------------------------------------------------------------------*/
+
+#include "compiler.h"
+#include "irqflags.h"
+#include "timer.h"
+#include "timer_wheel.h"
+
+#include <assert.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------
+ *         Local definitions
+ *----------------------------------------------------------------------------*/
+
+#define WHEEL_LEVELS 5
+#define WHEEL_BITS   6
+#define WHEEL_SIZE   (1u << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SIZE - 1)
+
+/** Longest delay the wheel holds directly, longer events are re-inserted */
+#define WHEEL_RANGE  (1ull << (WHEEL_LEVELS * WHEEL_BITS))
+
+#define WHEEL_NEVER  UINT64_MAX
+
+/*----------------------------------------------------------------------------
+ *         Local types
+ *----------------------------------------------------------------------------*/
+
+struct _timer_wheel {
+	struct _timer_event* slots[WHEEL_LEVELS][WHEEL_SIZE];
+	uint64_t bitmap[WHEEL_LEVELS];
+
+	/** Next wheel tick to process */
+	uint64_t clk;
+
+	/** Wheel tick the alarm is programmed for */
+	uint64_t alarm;
+
+	/** Wheel tick = 2^shift raw timer ticks */
+	uint8_t shift;
+
+	/** Raw timer ticks per microsecond, 32.32 fixed point */
+	uint64_t raw_per_us;
+
+	bool busy;
+
+	struct {
+		uint32_t fired;
+		uint32_t overruns;
+		uint64_t late_max;
+		uint64_t late_total;
+	} stats;
+};
+
+/*----------------------------------------------------------------------------
+ *         Local variables
+ *----------------------------------------------------------------------------*/
+
+static struct _timer_wheel wheel;
+
+/*----------------------------------------------------------------------------
+ *         Local functions
+ *----------------------------------------------------------------------------*/
+
+static inline uint32_t _ctz32(uint32_t x)
+{
+	return 31 - CLZ(x & -x);
+}
+
+/** Index of the first set bit of a non-zero bitmap, starting from bit
+ * 'start' and wrapping around */
+static uint32_t _next_bit(uint64_t bits, uint32_t start)
+{
+	uint64_t rotated = start ? (bits >> start) | (bits << (64 - start)) : bits;
+
+	if ((uint32_t)rotated)
+		return _ctz32((uint32_t)rotated);
+	return 32 + _ctz32((uint32_t)(rotated >> 32));
+}
+
+static uint64_t _us_to_raw(uint32_t us)
+{
+	uint64_t raw = us * (wheel.raw_per_us >> 32);
+
+	/* rounded up, events never fire early */
+	return raw + ((us * (wheel.raw_per_us & 0xffffffffu) + 0xffffffffu) >> 32);
+}
+
+static uint32_t _raw_to_us(uint64_t raw)
+{
+	return (uint32_t)((raw * 1000000ull) / timer_get_raw_freq());
+}
+
+static void _wheel_insert(struct _timer_event* event)
+{
+	uint64_t expires = event->expires;
+	uint64_t delta;
+	uint32_t level, slot;
+
+	if (expires < wheel.clk)
+		expires = wheel.clk;
+	delta = expires - wheel.clk;
+	if (delta >= WHEEL_RANGE) {
+		/* re-inserted from the last level until in range */
+		expires = wheel.clk + WHEEL_RANGE - 1;
+		delta = WHEEL_RANGE - 1;
+	}
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++)
+		if (delta < (1ull << (WHEEL_BITS * (level + 1))))
+			break;
+	slot = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+	event->level = level;
+	event->slot = slot;
+	event->next = wheel.slots[level][slot];
+	if (event->next)
+		event->next->pprev = &event->next;
+	event->pprev = &wheel.slots[level][slot];
+	wheel.slots[level][slot] = event;
+	wheel.bitmap[level] |= 1ull << slot;
+}
+
+static void _wheel_remove(struct _timer_event* event)
+{
+	*event->pprev = event->next;
+	if (event->next)
+		event->next->pprev = event->pprev;
+	if (!wheel.slots[event->level][event->slot])
+		wheel.bitmap[event->level] &= ~(1ull << event->slot);
+	event->next = NULL;
+	event->pprev = NULL;
+}
+
+/** Detach the whole list of a slot */
+static struct _timer_event* _wheel_take_slot(uint32_t level, uint32_t slot)
+{
+	struct _timer_event* list = wheel.slots[level][slot];
+
+	wheel.slots[level][slot] = NULL;
+	wheel.bitmap[level] &= ~(1ull << slot);
+	return list;
+}
+
+/**
+ * \brief Return the first wheel tick, from wheel.clk, at which a level 0
+ * slot has to be run or a slot of an upper level has to be cascaded.
+ */
+static uint64_t _wheel_next_event(void)
+{
+	uint64_t next = WHEEL_NEVER;
+	uint32_t level;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		uint32_t shift = WHEEL_BITS * level;
+		uint64_t first, tick;
+
+		if (!wheel.bitmap[level])
+			continue;
+
+		/* slots of this level are visited at multiples of 2^shift */
+		first = (wheel.clk + (1ull << shift) - 1) >> shift;
+		tick = (first + _next_bit(wheel.bitmap[level],
+				first & WHEEL_MASK)) << shift;
+		if (tick < next)
+			next = tick;
+	}
+	return next;
+}
+
+static void _wheel_cascade(uint64_t tick)
+{
+	uint32_t level;
+
+	for (level = 1; level < WHEEL_LEVELS; level++) {
+		struct _timer_event* event;
+		uint32_t shift = WHEEL_BITS * level;
+
+		if (tick & ((1ull << shift) - 1))
+			break;
+
+		event = _wheel_take_slot(level, (tick >> shift) & WHEEL_MASK);
+		while (event) {
+			struct _timer_event* next = event->next;
+			_wheel_insert(event);
+			event = next;
+		}
+	}
+}
+
+static void _wheel_fire(struct _timer_event* event, uint64_t now)
+{
+	uint64_t late = now - event->deadline;
+
+	wheel.stats.fired++;
+	wheel.stats.late_total += late;
+	if (late > wheel.stats.late_max)
+		wheel.stats.late_max = late;
+
+	if (event->period) {
+		/* keep the phase, skipping the periods already missed */
+		event->deadline += event->period;
+		if (event->deadline <= now) {
+			uint64_t missed = (now - event->deadline) / event->period + 1;
+			wheel.stats.overruns += missed;
+			event->deadline += missed * event->period;
+		}
+		event->expires = (event->deadline + (1ull << wheel.shift) - 1) >> wheel.shift;
+		_wheel_insert(event);
+	}
+}
+
+/**
+ * \brief Run the events expired at the given raw timer tick.
+ * Called with interrupts disabled, enables them around the callbacks.
+ */
+static void _wheel_run(uint64_t now, uint32_t* flags)
+{
+	uint64_t tick;
+
+	while (wheel.clk <= (now >> wheel.shift)) {
+		tick = _wheel_next_event();
+		if (tick > (now >> wheel.shift)) {
+			/* nothing happens until now, jump ahead */
+			wheel.clk = (now >> wheel.shift) + 1;
+			break;
+		}
+		wheel.clk = tick;
+		_wheel_cascade(tick);
+
+		/* callbacks may add events in the slot being run */
+		while (wheel.slots[0][tick & WHEEL_MASK]) {
+			struct _timer_event* event = wheel.slots[0][tick & WHEEL_MASK];
+			_wheel_remove(event);
+			_wheel_fire(event, now);
+			arch_irq_restore(*flags);
+			callback_call(&event->callback, event);
+			*flags = arch_irq_save();
+		}
+		wheel.clk = tick + 1;
+	}
+}
+
+#ifndef CONFIG_TIMER_POLLING
+
+static void _wheel_alarm(void);
+
+/**
+ * \brief Program the timer alarm for the next wheel event.
+ * \return false if that event is already due
+ */
+static bool _wheel_schedule(void)
+{
+	wheel.alarm = _wheel_next_event();
+	if (wheel.alarm == WHEEL_NEVER) {
+		timer_cancel_alarm();
+		return true;
+	}
+	return timer_set_alarm(wheel.alarm << wheel.shift, _wheel_alarm);
+}
+
+static void _wheel_alarm(void)
+{
+	uint32_t flags = arch_irq_save();
+
+	wheel.busy = true;
+	do {
+		_wheel_run(timer_get_raw_tick(), &flags);
+	} while (!_wheel_schedule());
+	wheel.busy = false;
+
+	arch_irq_restore(flags);
+}
+
+#endif /* !CONFIG_TIMER_POLLING */
+
+/*----------------------------------------------------------------------------
+ *         Exported functions
+ *----------------------------------------------------------------------------*/
+
+void timer_wheel_init(void)
+{
+	uint32_t freq = timer_get_raw_freq();
+	uint64_t ticks = ((uint64_t)freq * TIMER_WHEEL_RESOLUTION_US) / 1000000;
+
+	assert(freq);
+
+	memset(&wheel, 0, sizeof(wheel));
+	while (ticks >= 2) {
+		wheel.shift++;
+		ticks >>= 1;
+	}
+	wheel.raw_per_us = ((uint64_t)freq << 32) / 1000000;
+	wheel.clk = timer_get_raw_tick() >> wheel.shift;
+	wheel.alarm = WHEEL_NEVER;
+}
+
+void timer_event_init(struct _timer_event* event,
+		callback_method_t method, void* arg)
+{
+	memset(event, 0, sizeof(*event));
+	callback_set(&event->callback, method, arg);
+}
+
+void timer_wheel_add(struct _timer_event* event, uint32_t delay_us,
+		uint32_t period_us)
+{
+	uint32_t flags = arch_irq_save();
+
+	if (event->pprev)
+		_wheel_remove(event);
+
+	event->deadline = timer_get_raw_tick() + _us_to_raw(delay_us);
+	event->period = (uint32_t)_us_to_raw(period_us);
+	event->expires = (event->deadline + (1ull << wheel.shift) - 1) >> wheel.shift;
+	_wheel_insert(event);
+
+#ifndef CONFIG_TIMER_POLLING
+	/* wake up earlier if needed, callbacks adding events are followed by a
+	 * reschedule anyway */
+	if (event->expires < wheel.alarm && !wheel.busy) {
+		uint64_t deadline = event->expires << wheel.shift;
+
+		wheel.alarm = event->expires;
+		while (!timer_set_alarm(deadline, _wheel_alarm))
+			deadline = timer_get_raw_tick() + (1u << wheel.shift);
+	}
+#endif
+
+	arch_irq_restore(flags);
+}
+
+void timer_wheel_cancel(struct _timer_event* event)
+{
+	uint32_t flags = arch_irq_save();
+
+	/* the alarm is left as is, waking up for nothing is harmless */
+	if (event->pprev)
+		_wheel_remove(event);
+
+	arch_irq_restore(flags);
+}
+
+void timer_wheel_poll(void)
+{
+	uint32_t flags = arch_irq_save();
+
+	if (!wheel.busy) {
+		wheel.busy = true;
+		_wheel_run(timer_get_raw_tick(), &flags);
+		wheel.busy = false;
+	}
+
+	arch_irq_restore(flags);
+}
+
+void timer_wheel_get_stats(struct _timer_wheel_stats* stats)
+{
+	uint32_t flags = arch_irq_save();
+
+	stats->fired = wheel.stats.fired;
+	stats->overruns = wheel.stats.overruns;
+	stats->late_max = _raw_to_us(wheel.stats.late_max);
+	stats->late_avg = wheel.stats.fired ?
+		_raw_to_us(wheel.stats.late_total / wheel.stats.fired) : 0;
+	stats->resolution = (uint32_t)((1000000000ull << wheel.shift) /
+			timer_get_raw_freq());
+
+	arch_irq_restore(flags);
+}
+
+void timer_wheel_reset_stats(void)
+{
+	uint32_t flags = arch_irq_save();
+	memset(&wheel.stats, 0, sizeof(wheel.stats));
+	arch_irq_restore(flags);
+}
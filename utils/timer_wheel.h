@@ -0,0 +1,159 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2015, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  Software timers on top of the system timer.
+ *
+ *  Timer events are kept in a hierarchical timer wheel (5 levels of 64
+ *  slots), so adding and cancelling an event is O(1) whatever the number of
+ *  pending events. The wheel is tickless: the RA compare of the system timer
+ *  channel is programmed to the next event, so no periodic interrupt is
+ *  needed and the CPU can stay in cpu_idle() until then.
+ *
+ *  Callbacks are called from the timer interrupt, with the event as second
+ *  argument. An event may be added again or cancelled from its callback.
+ *
+ *  With CONFIG_TIMER_POLLING, no interrupt is used and the application
+ *  must call timer_wheel_poll() periodically.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+/*----------------------------------------------------------------------------
+ *         Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "callback.h"
+
+/*----------------------------------------------------------------------------
+ *         Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Target resolution of the wheel, in microseconds. The effective
+ * resolution is the largest power of two of timer ticks not above it. */
+#ifndef TIMER_WHEEL_RESOLUTION_US
+#define TIMER_WHEEL_RESOLUTION_US 10
+#endif
+
+/*----------------------------------------------------------------------------
+ *         Type definitions
+ *----------------------------------------------------------------------------*/
+
+struct _timer_event {
+	struct _timer_event*  next;
+	struct _timer_event** pprev;  /**< NULL when the event is not pending */
+	uint64_t deadline;            /**< Raw timer ticks */
+	uint64_t expires;             /**< Wheel ticks */
+	uint32_t period;              /**< Raw timer ticks, 0 for one-shot */
+	uint8_t  level;
+	uint8_t  slot;
+	struct _callback callback;
+};
+
+struct _timer_wheel_stats {
+	uint32_t fired;       /**< Callbacks called */
+	uint32_t overruns;    /**< Periods skipped by late periodic events */
+	uint32_t late_max;    /**< Worst callback lateness, in microseconds */
+	uint32_t late_avg;    /**< Average callback lateness, in microseconds */
+	uint32_t resolution;  /**< Wheel tick, in nanoseconds */
+};
+
+/*----------------------------------------------------------------------------
+ *         Global functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize the timer wheel. Must be called after timer_configure().
+ */
+extern void timer_wheel_init(void);
+
+/**
+ * \brief Initialize a timer event.
+ *
+ * \param event   Event to initialize
+ * \param method  Callback, called with arg and the event
+ * \param arg     Callback argument
+ */
+extern void timer_event_init(struct _timer_event* event,
+		callback_method_t method, void* arg);
+
+/**
+ * \brief Schedule an event, rescheduling it if it is already pending.
+ *
+ * The callback is never called before the delay has elapsed.
+ *
+ * \param event     Initialized event
+ * \param delay_us  Delay before the first call, in microseconds
+ * \param period_us Period of the following calls in microseconds, 0 for a
+ *                  one-shot event
+ */
+extern void timer_wheel_add(struct _timer_event* event, uint32_t delay_us,
+		uint32_t period_us);
+
+/**
+ * \brief Cancel a pending event. Does nothing if it is not pending.
+ */
+extern void timer_wheel_cancel(struct _timer_event* event);
+
+/**
+ * \brief Tell if an event is pending.
+ */
+static inline bool timer_event_pending(const struct _timer_event* event)
+{
+	return event->pprev != NULL;
+}
+
+/**
+ * \brief Call the callbacks of the expired events.
+ *
+ * Only needed with CONFIG_TIMER_POLLING, the timer interrupt does it
+ * otherwise.
+ */
+extern void timer_wheel_poll(void);
+
+/**
+ * \brief Get the statistics of the timer wheel.
+ */
+extern void timer_wheel_get_stats(struct _timer_wheel_stats* stats);
+
+/**
+ * \brief Clear the statistics of the timer wheel.
+ */
+extern void timer_wheel_reset_stats(void);
+
+#endif /* TIMER_WHEEL_H_ */
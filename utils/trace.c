@@ -38,9 +38,199 @@
 #include "serial/console.h"
 #include "gpio/pio.h"
 
+#ifdef CONFIG_TRACE_DEFERRED
+#include "barriers.h"
+#include "irqflags.h"
+#include "timer.h"
+
+#include <stdarg.h>
+#include <string.h>
+#endif
+
 /*------------------------------------------------------------------------------
  *         Internal variables
  *------------------------------------------------------------------------------*/
 
 /** Current trace level */
 uint32_t trace_level = TRACE_LEVEL;
+
+#ifdef CONFIG_TRACE_DEFERRED
+
+/*------------------------------------------------------------------------------
+ *         Deferred traces
+ *------------------------------------------------------------------------------*/
+
+/* The ring accepts several producers (main loop and interrupt handlers): an
+ * entry is reserved by advancing the head, filled, then published by writing
+ * its descriptor pointer. The consumer stops at the first entry that is
+ * reserved but not yet published. */
+
+/** Ring entry, its fmt field is written last and marks the entry valid */
+struct _trace_entry {
+	const struct _trace_fmt* volatile fmt;
+	uint32_t timestamp;
+	uint32_t args[TRACE_DEFERRED_MAX_ARGS];
+};
+
+#if (TRACE_DEFERRED_ENTRIES & (TRACE_DEFERRED_ENTRIES - 1)) != 0
+#error TRACE_DEFERRED_ENTRIES must be a power of two
+#endif
+
+static struct _trace_entry trace_ring[TRACE_DEFERRED_ENTRIES];
+
+/** Free-running index of the next entry to reserve (producers) */
+static volatile uint32_t trace_head;
+
+/** Free-running index of the next entry to drain (consumer) */
+static volatile uint32_t trace_tail;
+
+static struct _trace_stats trace_stats;
+
+/**
+ * \brief Reserve a ring entry, from any context.
+ * \return false if the ring is full
+ */
+static bool _trace_reserve(uint32_t* index)
+{
+#if defined(CONFIG_ARCH_ARMV7A) || defined(CONFIG_ARCH_ARMV7M)
+	uint32_t head = trace_head;
+
+	do {
+		if (head - trace_tail >= TRACE_DEFERRED_ENTRIES)
+			return false;
+	} while (!__atomic_compare_exchange_n(&trace_head, &head, head + 1,
+			true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	*index = head;
+	return true;
+#else
+	/* no exclusive load/store on ARMv5TE */
+	uint32_t flags = arch_irq_save();
+	uint32_t head = trace_head;
+	bool ok = head - trace_tail < TRACE_DEFERRED_ENTRIES;
+
+	if (ok)
+		trace_head = head + 1;
+	arch_irq_restore(flags);
+	*index = head;
+	return ok;
+#endif
+}
+
+/**
+ * \brief Increment a statistics counter, from any context.
+ */
+static void _trace_count(volatile uint32_t* counter)
+{
+#if defined(CONFIG_ARCH_ARMV7A) || defined(CONFIG_ARCH_ARMV7M)
+	__atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+#else
+	uint32_t flags = arch_irq_save();
+	(*counter)++;
+	arch_irq_restore(flags);
+#endif
+}
+
+/**
+ * \brief Take the oldest valid entry from the ring.
+ * \return false if no entry is ready
+ */
+static bool _trace_take(struct _trace_entry* entry)
+{
+	uint32_t tail = trace_tail;
+	struct _trace_entry* slot;
+	uint32_t pending;
+
+	if (tail == trace_head)
+		return false;
+
+	/* reserved but not yet written, possibly by a preempted context */
+	slot = &trace_ring[tail & (TRACE_DEFERRED_ENTRIES - 1)];
+	entry->fmt = slot->fmt;
+	if (!entry->fmt)
+		return false;
+	dmb();
+	entry->timestamp = slot->timestamp;
+	memcpy(entry->args, slot->args, sizeof(entry->args));
+
+	pending = trace_head - tail;
+	if (pending > trace_stats.peak)
+		trace_stats.peak = pending;
+
+	slot->fmt = NULL;
+	dmb();
+	trace_tail = tail + 1;
+	return true;
+}
+
+void trace_log(const struct _trace_fmt* fmt, ...)
+{
+	struct _trace_entry* slot;
+	uint32_t index;
+	va_list ap;
+	int i;
+
+	if (!_trace_reserve(&index)) {
+		_trace_count(&trace_stats.dropped);
+		return;
+	}
+
+	slot = &trace_ring[index & (TRACE_DEFERRED_ENTRIES - 1)];
+	slot->timestamp = (uint32_t)timer_get_tick();
+	va_start(ap, fmt);
+	for (i = 0; i < fmt->nargs; i++)
+		slot->args[i] = va_arg(ap, uint32_t);
+	va_end(ap);
+	dmb();
+	slot->fmt = fmt;
+	_trace_count(&trace_stats.logged);
+}
+
+int trace_flush(void)
+{
+	struct _trace_entry entry;
+	int count = 0;
+
+	while (_trace_take(&entry)) {
+		/* timestamp prefixed traces, not continuation (_wp) ones */
+		if (entry.fmt->fmt[0] == '-')
+			printf("[%8u] ", (unsigned)entry.timestamp);
+		printf(entry.fmt->fmt, entry.args[0], entry.args[1],
+		       entry.args[2], entry.args[3], entry.args[4],
+		       entry.args[5]);
+		count++;
+	}
+	return count;
+}
+
+int trace_dump(void)
+{
+	struct _trace_entry entry;
+	const uint8_t* data;
+	int count = 0;
+	int i;
+
+	while (_trace_take(&entry)) {
+		console_put_char(0xA5);
+		console_put_char(0x5A);
+		data = (const uint8_t*)&entry;
+		for (i = 0; i < sizeof(entry); i++)
+			console_put_char(data[i]);
+		count++;
+	}
+	return count;
+}
+
+void trace_get_stats(struct _trace_stats* stats)
+{
+	*stats = trace_stats;
+}
+
+#endif /* CONFIG_TRACE_DEFERRED */
+
+void trace_fatal_flush(void)
+{
+#ifdef CONFIG_TRACE_DEFERRED
+	trace_flush();
+#endif
+	console_panic_flush();
+}
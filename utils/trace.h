@@ -57,6 +57,18 @@
  *     but which indicates there is a problem with the code.
  *  -# trace_fatal (1): Indicates a major error which prevents the program from going
  *     any further. Program will stop after the fatal trace message is displayed.
+ *
+ *  \par Deferred traces
+ *  When CONFIG_TRACE_DEFERRED is defined, trace_debug(), trace_info(),
+ *  trace_warning() and trace_error() do not format anything: they store the
+ *  address of a static format descriptor, a timestamp and up to
+ *  TRACE_DEFERRED_MAX_ARGS raw 32-bit arguments in a ring buffer, which is safe
+ *  to use from interrupt handlers. The application drains the ring from its
+ *  main loop or idle task, either formatted with trace_flush() or in binary
+ *  with trace_dump() for decoding on the host with scripts/trace_decode.py.
+ *  Arguments must be integers, characters or pointers (strings are printed
+ *  when the ring is drained, so they must still be valid then). Traces with
+ *  more arguments, and trace_fatal(), are printed immediately.
  */
 
 #ifndef _TRACE_H_
@@ -86,6 +98,37 @@
 #define TRACE_LEVEL TRACE_LEVEL_INFO
 #endif
 
+#ifdef CONFIG_TRACE_DEFERRED
+
+/** Number of entries of the deferred trace ring (power of two) */
+#ifndef TRACE_DEFERRED_ENTRIES
+#define TRACE_DEFERRED_ENTRIES 256
+#endif
+
+/** Maximum number of arguments of a deferred trace */
+#define TRACE_DEFERRED_MAX_ARGS 6
+
+/* ------------------------------------------------------------------------------
+ *         Exported types
+ * ----------------------------------------------------------------------------*/
+
+/** Static descriptor of a deferred trace call site, its address is the ID
+ * stored in the ring */
+struct _trace_fmt {
+	uint8_t level;
+	uint8_t nargs;
+	const char* fmt;
+};
+
+/** Statistics of the deferred trace ring */
+struct _trace_stats {
+	uint32_t logged;   /**< Entries stored */
+	uint32_t dropped;  /**< Entries lost because the ring was full */
+	uint32_t peak;     /**< Highest number of pending entries seen */
+};
+
+#endif /* CONFIG_TRACE_DEFERRED */
+
 /* ------------------------------------------------------------------------------
  *         Exported variables
  * ----------------------------------------------------------------------------*/
@@ -97,6 +140,117 @@ extern uint32_t trace_level;
  *         Exported functions
  * ----------------------------------------------------------------------------*/
 
+/**
+ * \brief Print the pending traces and drain the console synchronously,
+ * before a fatal trace.
+ */
+extern void trace_fatal_flush(void);
+
+#ifdef CONFIG_TRACE_DEFERRED
+
+/**
+ * \brief Store a deferred trace in the ring (used by the trace_* macros).
+ * \param fmt  Descriptor of the call site
+ * \param ...  fmt->nargs arguments, as uint32_t
+ */
+extern void trace_log(const struct _trace_fmt* fmt, ...);
+
+/**
+ * \brief Format and print the pending deferred traces.
+ *
+ * Must be called from a single context, typically the main loop or an idle
+ * hook, with interrupts enabled.
+ *
+ * \return the number of traces printed
+ */
+extern int trace_flush(void);
+
+/**
+ * \brief Send the pending deferred traces in binary on the console.
+ *
+ * Each trace is sent as the two bytes 0xA5 0x5A followed by the 32-byte
+ * little-endian entry: descriptor address, timestamp in ms and the
+ * arguments. See scripts/trace_decode.py.
+ *
+ * \return the number of traces sent
+ */
+extern int trace_dump(void);
+
+/**
+ * \brief Get the statistics of the deferred trace ring.
+ */
+extern void trace_get_stats(struct _trace_stats* stats);
+
+#define _TRACE_ARG(x) \
+	({ __typeof__((x) + 0) _trace_arg = (x); \
+	   (uint32_t)(uintptr_t)_trace_arg; })
+
+#define _TRACE_NARGS(...) \
+	_TRACE_NARGS_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, \
+		      4, 3, 2, 1, 0)
+#define _TRACE_NARGS_(f, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, \
+		      _13, _14, _15, _16, n, ...) n
+
+#define _TRACE_OUT(level, prefix, ...) \
+	_TRACE_OUT_N(_TRACE_NARGS(__VA_ARGS__), level, prefix, __VA_ARGS__)
+#define _TRACE_OUT_N(n, ...) _TRACE_OUT_N_(n, __VA_ARGS__)
+#define _TRACE_OUT_N_(n, ...) _TRACE_LOG_##n(__VA_ARGS__)
+
+#define _TRACE_SITE(level, n, prefix, f) \
+	static const struct _trace_fmt _trace_fmt = { level, n, prefix f }
+
+#define _TRACE_LOG_0(level, prefix, f) \
+	do { _TRACE_SITE(level, 0, prefix, f); \
+	     trace_log(&_trace_fmt); } while (0)
+#define _TRACE_LOG_1(level, prefix, f, a) \
+	do { _TRACE_SITE(level, 1, prefix, f); \
+	     trace_log(&_trace_fmt, _TRACE_ARG(a)); } while (0)
+#define _TRACE_LOG_2(level, prefix, f, a, b) \
+	do { _TRACE_SITE(level, 2, prefix, f); \
+	     trace_log(&_trace_fmt, _TRACE_ARG(a), _TRACE_ARG(b)); } while (0)
+#define _TRACE_LOG_3(level, prefix, f, a, b, c) \
+	do { _TRACE_SITE(level, 3, prefix, f); \
+	     trace_log(&_trace_fmt, _TRACE_ARG(a), _TRACE_ARG(b), \
+		       _TRACE_ARG(c)); } while (0)
+#define _TRACE_LOG_4(level, prefix, f, a, b, c, d) \
+	do { _TRACE_SITE(level, 4, prefix, f); \
+	     trace_log(&_trace_fmt, _TRACE_ARG(a), _TRACE_ARG(b), \
+		       _TRACE_ARG(c), _TRACE_ARG(d)); } while (0)
+#define _TRACE_LOG_5(level, prefix, f, a, b, c, d, e) \
+	do { _TRACE_SITE(level, 5, prefix, f); \
+	     trace_log(&_trace_fmt, _TRACE_ARG(a), _TRACE_ARG(b), \
+		       _TRACE_ARG(c), _TRACE_ARG(d), _TRACE_ARG(e)); } while (0)
+#define _TRACE_LOG_6(level, prefix, f, a, b, c, d, e, g) \
+	do { _TRACE_SITE(level, 6, prefix, f); \
+	     trace_log(&_trace_fmt, _TRACE_ARG(a), _TRACE_ARG(b), \
+		       _TRACE_ARG(c), _TRACE_ARG(d), _TRACE_ARG(e), \
+		       _TRACE_ARG(g)); } while (0)
+
+/* too many arguments for an entry: print immediately */
+#define _TRACE_SYNC(level, prefix, ...) printf(prefix __VA_ARGS__)
+#define _TRACE_LOG_7  _TRACE_SYNC
+#define _TRACE_LOG_8  _TRACE_SYNC
+#define _TRACE_LOG_9  _TRACE_SYNC
+#define _TRACE_LOG_10 _TRACE_SYNC
+#define _TRACE_LOG_11 _TRACE_SYNC
+#define _TRACE_LOG_12 _TRACE_SYNC
+#define _TRACE_LOG_13 _TRACE_SYNC
+#define _TRACE_LOG_14 _TRACE_SYNC
+#define _TRACE_LOG_15 _TRACE_SYNC
+#define _TRACE_LOG_16 _TRACE_SYNC
+
+/* fatal traces are printed after the pending ones */
+#define _TRACE_FATAL(...) \
+	do { trace_fatal_flush(); printf(__VA_ARGS__); } while (0)
+
+#else /* !CONFIG_TRACE_DEFERRED */
+
+#define _TRACE_OUT(level, prefix, ...) printf(prefix __VA_ARGS__)
+#define _TRACE_FATAL(...) \
+	do { trace_fatal_flush(); printf(__VA_ARGS__); } while (0)
+
+#endif /* CONFIG_TRACE_DEFERRED */
+
 /**
  *  Outputs a formatted string using 'printf' if the log level is high
  *  enough. Can be disabled by defining TRACE_LEVEL=0 during compilation.
@@ -105,9 +259,9 @@ extern uint32_t trace_level;
 
 #if (TRACE_LEVEL >= 1)
 #define trace_fatal(...) \
-	do { if (trace_level >= TRACE_LEVEL_FATAL) printf("-F- " __VA_ARGS__); while (1) ; } while (0)
+	do { if (trace_level >= TRACE_LEVEL_FATAL) _TRACE_FATAL("-F- " __VA_ARGS__); while (1) ; } while (0)
 #define trace_fatal_wp(...) \
-	do { if (trace_level >= TRACE_LEVEL_FATAL) printf(__VA_ARGS__); while (1) ; } while (0)
+	do { if (trace_level >= TRACE_LEVEL_FATAL) _TRACE_FATAL(__VA_ARGS__); while (1) ; } while (0)
 #else
 #define trace_fatal(...) \
 	do {} while (1)
@@ -117,9 +271,9 @@ extern uint32_t trace_level;
 
 #if (TRACE_LEVEL >= 2)
 #define trace_error(...) \
-	do { if (trace_level >= TRACE_LEVEL_ERROR) printf("-E- " __VA_ARGS__); } while (0)
+	do { if (trace_level >= TRACE_LEVEL_ERROR) _TRACE_OUT(TRACE_LEVEL_ERROR, "-E- ", __VA_ARGS__); } while (0)
 #define trace_error_wp(...) \
-	do { if (trace_level >= TRACE_LEVEL_ERROR) printf(__VA_ARGS__); } while (0)
+	do { if (trace_level >= TRACE_LEVEL_ERROR) _TRACE_OUT(TRACE_LEVEL_ERROR, , __VA_ARGS__); } while (0)
 #else
 #define trace_error(...) ((void)0)
 #define trace_error_wp(...) ((void)0)
@@ -127,9 +281,9 @@ extern uint32_t trace_level;
 
 #if (TRACE_LEVEL >= 3)
 #define trace_warning(...) \
-	do { if (trace_level >= TRACE_LEVEL_WARNING) printf("-W- " __VA_ARGS__); } while (0)
+	do { if (trace_level >= TRACE_LEVEL_WARNING) _TRACE_OUT(TRACE_LEVEL_WARNING, "-W- ", __VA_ARGS__); } while (0)
 #define trace_warning_wp(...) \
-	do { if (trace_level >= TRACE_LEVEL_WARNING) printf(__VA_ARGS__); } while (0)
+	do { if (trace_level >= TRACE_LEVEL_WARNING) _TRACE_OUT(TRACE_LEVEL_WARNING, , __VA_ARGS__); } while (0)
 #else
 #define trace_warning(...) ((void)0)
 #define trace_warning_wp(...) ((void)0)
@@ -137,9 +291,9 @@ extern uint32_t trace_level;
 
 #if (TRACE_LEVEL >= 4)
 #define trace_info(...) \
-	do { if (trace_level >= TRACE_LEVEL_INFO) printf("-I- " __VA_ARGS__); } while (0)
+	do { if (trace_level >= TRACE_LEVEL_INFO) _TRACE_OUT(TRACE_LEVEL_INFO, "-I- ", __VA_ARGS__); } while (0)
 #define trace_info_wp(...) \
-	do { if (trace_level >= TRACE_LEVEL_INFO) printf(__VA_ARGS__); } while (0)
+	do { if (trace_level >= TRACE_LEVEL_INFO) _TRACE_OUT(TRACE_LEVEL_INFO, , __VA_ARGS__); } while (0)
 #else
 #define trace_info(...) ((void)0)
 #define trace_info_wp(...) ((void)0)
@@ -147,9 +301,9 @@ extern uint32_t trace_level;
 
 #if (TRACE_LEVEL >= 5)
 #define trace_debug(...) \
-	do { if (trace_level >= TRACE_LEVEL_DEBUG) printf("-D- " __FILE__ ":" STRINGIFY(__LINE__) " " __VA_ARGS__); } while (0)
+	do { if (trace_level >= TRACE_LEVEL_DEBUG) _TRACE_OUT(TRACE_LEVEL_DEBUG, "-D- " __FILE__ ":" STRINGIFY(__LINE__) " ", __VA_ARGS__); } while (0)
 #define trace_debug_wp(...) \
-	do { if (trace_level >= TRACE_LEVEL_DEBUG) printf(__VA_ARGS__); } while (0)
+	do { if (trace_level >= TRACE_LEVEL_DEBUG) _TRACE_OUT(TRACE_LEVEL_DEBUG, , __VA_ARGS__); } while (0)
 #else
 #define trace_debug(...) ((void)0)
 #define trace_debug_wp(...) ((void)0)